@@ -36,7 +36,12 @@ CHAR strZHelpText[] =
         "\n"
         "Changes the current directory based on a heuristic match.\n"
         "\n"
-        "Z [-license] <directory>\n";
+        "Z [-license] [-l] <directory>\n"
+        "\n"
+        "   -l             List the directories known to the command\n"
+        "\n"
+        "If YORIZFILE is set, directories are remembered in this file across\n"
+        "sessions.\n";
 
 /**
  Display usage text to the user.
@@ -53,55 +58,212 @@ ZHelp()
 }
 
 /**
- The number of recent directories to remember in memory.
+ The maximum number of directories to remember.  Once this is exceeded, the
+ directories with the lowest combination of frequency and recency of use are
+ discarded.
+ */
+#define Z_MAX_STORED_DIRS (32768)
+
+/**
+ The total number of hits across all remembered directories which triggers
+ each directory's hit count to be reduced, so that directories used heavily
+ in the past don't permanently outrank directories used recently.
+ */
+#define Z_MAX_TOTAL_HITS (Z_MAX_STORED_DIRS * 4)
+
+/**
+ The number of records that can exist beyond twice the number of remembered
+ directories before the store is compacted.
+ */
+#define Z_COMPACT_MINIMUM_RECORDS (256)
+
+/**
+ The number of characters in each substring used to index directory names.
+ A user specification shorter than this is compared against every
+ directory.
+ */
+#define Z_GRAM_LENGTH (3)
+
+/**
+ The number of buckets in the substring index.  Substrings which hash to the
+ same bucket share a list of directories, and any directory which does not
+ really match is discarded when directories are scored.
+ */
+#define Z_GRAM_BUCKET_COUNT (4096)
+
+/**
+ The number of buckets in hash tables used to find directories by name.
+ Note the hash is 16 bits, so there's no point making this larger than 64Kb.
+ */
+#define Z_DIRECTORY_HASH_BUCKETS (4096)
+
+/**
+ The score awarded for each level of quality of a match between the user
+ specification and a directory name.  This is equivalent to eight hits on a
+ directory within the last hour.
+ */
+#define Z_SCORE_UNIT (64)
+
+/**
+ The maximum hit count for a single directory.  Recent hits are worth eight
+ times as much as old ones, so this keeps the score from use plus the best
+ match bonus below the score given to a directory which the user specified
+ explicitly.
+ */
+#define Z_MAX_DIRECTORY_HITS (Z_SCORE_UNIT)
+
+/**
+ The high 32 bits of the offset within the store file of a byte that is
+ locked by any shell accessing the file.  This is far beyond the end of the
+ file, so it serializes shells without preventing the file being read.
+ */
+#define Z_STORE_LOCK_OFFSET_HIGH (0x7FFFFFFF)
+
+/**
+ The text at the beginning of a compacted store file.  This is followed by a
+ generation number which changes each time the file is compacted, so other
+ shells can detect that records they have read have been rewritten.
  */
-#define Z_MAX_RECENT_DIRS (64)
+#define Z_STORE_HEADER "#yoriz|"
 
 /**
- A linked list element corresponding to a remembered directory.
+ A remembered directory.
  */
-typedef struct _Z_RECENT_DIRECTORY {
+typedef struct _Z_DIRECTORY {
 
     /**
-     List element across the set of remembered directories.  Corresponds
-     to ZRecentDirectories.RecentDirList .
+     The entry for this directory within ZStore.DirectoryTable .
      */
-    YORI_LIST_ENTRY ListEntry;
+    YORI_HASH_ENTRY HashEntry;
 
     /**
      The fully qualified name of the remembered directory.
      */
     YORI_STRING DirectoryName;
 
+    /**
+     The time the directory was last used, in seconds since 1601.
+     */
+    LONGLONG LastAccessTime;
+
     /**
      The number of times the directory has been encountered.
      */
     DWORD HitCount;
-} Z_RECENT_DIRECTORY, *PZ_RECENT_DIRECTORY;
+
+    /**
+     The index of this directory within ZStore.Directories .
+     */
+    DWORD Index;
+} Z_DIRECTORY, *PZ_DIRECTORY;
 
 /**
- The head of the list of recent directories.
+ A list of directories whose names contain a substring which hashes to a
+ common value.
  */
-typedef struct _Z_RECENT_DIRECTORIES {
+typedef struct _Z_GRAM_BUCKET {
+
     /**
-     The head of the list of recent directories.
+     An array of indexes into ZStore.Directories, in ascending order.
      */
-    YORI_LIST_ENTRY RecentDirList;
+    PDWORD DirectoryIndexes;
 
     /**
-     The number of items currently in the list of recent directories, so we
-     can efficiently know when it's time to trim the list.
+     The number of elements populated in DirectoryIndexes.
      */
-    DWORD RecentDirCount;
+    DWORD Count;
 
     /**
-     A monotonically increasing number corresponding to attempts to add items
-     into the recent list.  Periodically this will trigger logic to trim the
-     HitCount on all existing entries to prevent them counting to infinity.
+     The number of elements allocated in DirectoryIndexes.
      */
-    DWORD MonotonicAddAttempt;
+    DWORD Allocated;
+} Z_GRAM_BUCKET, *PZ_GRAM_BUCKET;
 
-} Z_RECENT_DIRECTORIES, *PZ_RECENT_DIRECTORIES;
+/**
+ The set of directories known to the module, and the state of the file they
+ are persisted in.
+ */
+typedef struct _Z_DIRECTORY_STORE {
+
+    /**
+     A hash table of directories, indexed by directory name.
+     */
+    PYORI_HASH_TABLE DirectoryTable;
+
+    /**
+     An array of directories.  Directories which have been removed leave a
+     NULL entry until the array is compacted.
+     */
+    PZ_DIRECTORY *Directories;
+
+    /**
+     The number of elements populated in Directories.
+     */
+    DWORD DirectoriesPopulated;
+
+    /**
+     The number of elements allocated in Directories.
+     */
+    DWORD DirectoriesAllocated;
+
+    /**
+     The number of directories that are currently remembered.
+     */
+    DWORD DirectoryCount;
+
+    /**
+     The sum of the hit counts of all remembered directories.
+     */
+    DWORD TotalHits;
+
+    /**
+     The number of records which make up the current state.  When this is
+     sufficiently larger than the number of directories, the store is
+     compacted.
+     */
+    DWORD RecordCount;
+
+    /**
+     The generation of the store file that records have been read from.
+     */
+    DWORD Generation;
+
+    /**
+     The offset within the store file that records have been read up to.
+     */
+    LARGE_INTEGER ReadOffset;
+
+    /**
+     A handle to the store file, if one is configured and currently open.
+     */
+    HANDLE FileHandle;
+
+    /**
+     A handle to the store file opened for append access only, so records
+     written by concurrent shells are each placed at the end of the file
+     without overwriting each other.
+     */
+    HANDLE AppendHandle;
+
+    /**
+     TRUE if the store file is locked, indicating no other shell can modify
+     it.  If the file could not be locked, the store is not compacted.
+     */
+    BOOL FileLocked;
+
+    /**
+     TRUE if the substring index could not be fully populated due to
+     allocation failure, indicating every directory must be examined.
+     */
+    BOOL IndexIncomplete;
+
+    /**
+     The substring index, used to find the directories which may contain a
+     user specification.
+     */
+    Z_GRAM_BUCKET Grams[Z_GRAM_BUCKET_COUNT];
+
+} Z_DIRECTORY_STORE, *PZ_DIRECTORY_STORE;
 
 /**
  A directory name that matches the user's search criteria.  This structure
@@ -111,148 +273,1081 @@ typedef struct _Z_RECENT_DIRECTORIES {
  */
 typedef struct _Z_SCOREBOARD_ENTRY {
 
-    /**
-     The name of the directory.  Note that while the array is being
-     constructed this string is not referenced, but still contains a
-     populated MemoryToFree value so that it can be referenced and returned
-     to the caller if it's the best match.
-     */
-    YORI_STRING DirectoryName;
+    /**
+     The entry for this match within the hash table of matches, used to
+     detect the same directory being found more than once.  The key of this
+     entry holds a reference on the directory name.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The name of the directory.  Note this string is not referenced, but
+     still contains a populated MemoryToFree value, and the reference held
+     by the key of HashEntry keeps it valid while the scoreboard exists.
+     */
+    YORI_STRING DirectoryName;
+
+    /**
+     The remembered directory that this match refers to, or NULL if the
+     match refers to a parent of a remembered directory or a directory
+     resolved from the user specification.
+     */
+    PZ_DIRECTORY Directory;
+
+    /**
+     The score for this entry.  Entries which have been found not to exist
+     have a score of zero.
+     */
+    DWORD Score;
+} Z_SCOREBOARD_ENTRY, *PZ_SCOREBOARD_ENTRY;
+
+/**
+ The set of directories known to the module.
+ */
+Z_DIRECTORY_STORE ZStore;
+
+/**
+ Set to TRUE once the command has been invoked once to keep the module loaded.
+ */
+BOOL ZCallbacksRegistered;
+
+/**
+ Return the current time in seconds since 1601.
+
+ @return The current time.
+ */
+LONGLONG
+ZGetCurrentTime()
+{
+    SYSTEMTIME CurrentSystemTime;
+    FILETIME CurrentFileTime;
+    LARGE_INTEGER CurrentTime;
+
+    GetSystemTime(&CurrentSystemTime);
+    SystemTimeToFileTime(&CurrentSystemTime, &CurrentFileTime);
+    CurrentTime.LowPart = CurrentFileTime.dwLowDateTime;
+    CurrentTime.HighPart = CurrentFileTime.dwHighDateTime;
+
+    return CurrentTime.QuadPart / (10 * 1000 * 1000);
+}
+
+/**
+ Calculate a score for a directory based on how frequently and how recently
+ it has been used.
+
+ @param Directory Pointer to the directory.
+
+ @param CurrentTime The current time, in seconds since 1601.
+
+ @return The score for the directory.
+ */
+DWORD
+ZGetFrecency(
+    __in PZ_DIRECTORY Directory,
+    __in LONGLONG CurrentTime
+    )
+{
+    LONGLONG Age;
+
+    Age = CurrentTime - Directory->LastAccessTime;
+    if (Age < 60 * 60) {
+        return Directory->HitCount * 8;
+    } else if (Age < 24 * 60 * 60) {
+        return Directory->HitCount * 4;
+    } else if (Age < 7 * 24 * 60 * 60) {
+        return Directory->HitCount * 2;
+    }
+
+    return Directory->HitCount;
+}
+
+/**
+ Return the substring index bucket for a substring.  Since directory names
+ are matched case insensitively, the substring is hashed case insensitively.
+
+ @param Chars Pointer to a substring which is Z_GRAM_LENGTH characters long.
+
+ @return The bucket within the substring index.
+ */
+PZ_GRAM_BUCKET
+ZGetGramBucket(
+    __in LPTSTR Chars
+    )
+{
+    DWORD Hash;
+    DWORD Index;
+
+    Hash = 0;
+    for (Index = 0; Index < Z_GRAM_LENGTH; Index++) {
+        Hash = Hash * 31 + YoriLibUpcaseChar(Chars[Index]);
+    }
+
+    return &ZStore.Grams[Hash % Z_GRAM_BUCKET_COUNT];
+}
+
+/**
+ Add a directory to the substring index.  The directory must have a higher
+ index than any directory already in the substring index.
+
+ @param Directory Pointer to the directory to add.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+ZIndexDirectory(
+    __in PZ_DIRECTORY Directory
+    )
+{
+    PZ_GRAM_BUCKET Bucket;
+    PDWORD NewIndexes;
+    DWORD NewAllocated;
+    DWORD Offset;
+
+    for (Offset = 0; Offset + Z_GRAM_LENGTH <= Directory->DirectoryName.LengthInChars; Offset++) {
+        Bucket = ZGetGramBucket(&Directory->DirectoryName.StartOfString[Offset]);
+
+        //
+        //  If the directory contains multiple substrings in this bucket,
+        //  only record it once.
+        //
+
+        if (Bucket->Count > 0 &&
+            Bucket->DirectoryIndexes[Bucket->Count - 1] == Directory->Index) {
+
+            continue;
+        }
+
+        if (Bucket->Count == Bucket->Allocated) {
+            NewAllocated = Bucket->Allocated * 2;
+            if (NewAllocated == 0) {
+                NewAllocated = 8;
+            }
+
+            NewIndexes = YoriLibMalloc(NewAllocated * sizeof(DWORD));
+            if (NewIndexes == NULL) {
+                return FALSE;
+            }
+
+            if (Bucket->Count > 0) {
+                memcpy(NewIndexes, Bucket->DirectoryIndexes, Bucket->Count * sizeof(DWORD));
+            }
+
+            if (Bucket->DirectoryIndexes != NULL) {
+                YoriLibFree(Bucket->DirectoryIndexes);
+            }
+
+            Bucket->DirectoryIndexes = NewIndexes;
+            Bucket->Allocated = NewAllocated;
+        }
+
+        Bucket->DirectoryIndexes[Bucket->Count] = Directory->Index;
+        Bucket->Count++;
+    }
+
+    return TRUE;
+}
+
+/**
+ Free the substring index.
+ */
+VOID
+ZFreeGramIndex()
+{
+    DWORD Index;
+
+    for (Index = 0; Index < Z_GRAM_BUCKET_COUNT; Index++) {
+        if (ZStore.Grams[Index].DirectoryIndexes != NULL) {
+            YoriLibFree(ZStore.Grams[Index].DirectoryIndexes);
+        }
+        ZStore.Grams[Index].DirectoryIndexes = NULL;
+        ZStore.Grams[Index].Count = 0;
+        ZStore.Grams[Index].Allocated = 0;
+    }
+}
+
+/**
+ Remove any directories which are no longer remembered from the array of
+ directories, and regenerate the substring index to refer to the new
+ array.
+ */
+VOID
+ZRebuildGramIndex()
+{
+    DWORD ReadIndex;
+    DWORD WriteIndex;
+    PZ_DIRECTORY Directory;
+
+    ZFreeGramIndex();
+    ZStore.IndexIncomplete = FALSE;
+
+    WriteIndex = 0;
+    for (ReadIndex = 0; ReadIndex < ZStore.DirectoriesPopulated; ReadIndex++) {
+        Directory = ZStore.Directories[ReadIndex];
+        if (Directory == NULL) {
+            continue;
+        }
+
+        Directory->Index = WriteIndex;
+        ZStore.Directories[WriteIndex] = Directory;
+        WriteIndex++;
+
+        if (!ZStore.IndexIncomplete && !ZIndexDirectory(Directory)) {
+            ZStore.IndexIncomplete = TRUE;
+        }
+    }
+
+    ASSERT(WriteIndex == ZStore.DirectoryCount);
+    ZStore.DirectoriesPopulated = WriteIndex;
+}
+
+/**
+ Add a new directory to the store, with no hits.
+
+ @param DirectoryName Pointer to the fully qualified directory name to add.
+
+ @return Pointer to the new directory, or NULL on allocation failure.
+ */
+PZ_DIRECTORY
+ZAddDirectory(
+    __in PYORI_STRING DirectoryName
+    )
+{
+    PZ_DIRECTORY Directory;
+    PZ_DIRECTORY *NewDirectories;
+    DWORD NewAllocated;
+
+    if (ZStore.DirectoryTable == NULL) {
+        ZStore.DirectoryTable = YoriLibAllocateHashTable(Z_DIRECTORY_HASH_BUCKETS);
+        if (ZStore.DirectoryTable == NULL) {
+            return NULL;
+        }
+    }
+
+    if (ZStore.DirectoriesPopulated == ZStore.DirectoriesAllocated) {
+        NewAllocated = ZStore.DirectoriesAllocated * 2;
+        if (NewAllocated == 0) {
+            NewAllocated = 1024;
+        }
+
+        NewDirectories = YoriLibMalloc(NewAllocated * sizeof(PZ_DIRECTORY));
+        if (NewDirectories == NULL) {
+            return NULL;
+        }
+
+        if (ZStore.DirectoriesPopulated > 0) {
+            memcpy(NewDirectories, ZStore.Directories, ZStore.DirectoriesPopulated * sizeof(PZ_DIRECTORY));
+        }
+
+        if (ZStore.Directories != NULL) {
+            YoriLibFree(ZStore.Directories);
+        }
+
+        ZStore.Directories = NewDirectories;
+        ZStore.DirectoriesAllocated = NewAllocated;
+    }
+
+    Directory = YoriLibReferencedMalloc(sizeof(Z_DIRECTORY) + (DirectoryName->LengthInChars + 1) * sizeof(TCHAR));
+    if (Directory == NULL) {
+        return NULL;
+    }
+
+    YoriLibReference(Directory);
+    Directory->DirectoryName.MemoryToFree = Directory;
+    Directory->DirectoryName.StartOfString = (LPWSTR)(Directory + 1);
+    Directory->DirectoryName.LengthAllocated = DirectoryName->LengthInChars + 1;
+    Directory->DirectoryName.LengthInChars = DirectoryName->LengthInChars;
+
+    memcpy(Directory->DirectoryName.StartOfString, DirectoryName->StartOfString, DirectoryName->LengthInChars * sizeof(TCHAR));
+    Directory->DirectoryName.StartOfString[DirectoryName->LengthInChars] = '\0';
+
+    Directory->HitCount = 0;
+    Directory->LastAccessTime = 0;
+    Directory->Index = ZStore.DirectoriesPopulated;
+
+    ZStore.Directories[ZStore.DirectoriesPopulated] = Directory;
+    ZStore.DirectoriesPopulated++;
+    ZStore.DirectoryCount++;
+
+    YoriLibHashInsertByKey(ZStore.DirectoryTable, &Directory->DirectoryName, Directory, &Directory->HashEntry);
+
+    if (!ZStore.IndexIncomplete && !ZIndexDirectory(Directory)) {
+        ZStore.IndexIncomplete = TRUE;
+    }
+
+    return Directory;
+}
+
+/**
+ Remove a directory from the store.  Any substring index entries referring
+ to the directory are left in place, and ignored, until the index is
+ rebuilt.
+
+ @param Directory Pointer to the directory to remove.
+ */
+VOID
+ZRemoveDirectory(
+    __in PZ_DIRECTORY Directory
+    )
+{
+    YoriLibHashRemoveByEntry(&Directory->HashEntry);
+    ZStore.Directories[Directory->Index] = NULL;
+    ZStore.DirectoryCount--;
+    ZStore.TotalHits -= Directory->HitCount;
+    YoriLibFreeStringContents(&Directory->DirectoryName);
+    YoriLibDereference(Directory);
+}
+
+/**
+ Discard all remembered directories.  This is used when the module is
+ unloaded or when the store file has been rewritten by another shell.
+ */
+VOID
+ZResetStore()
+{
+    DWORD Index;
+
+    for (Index = 0; Index < ZStore.DirectoriesPopulated; Index++) {
+        if (ZStore.Directories[Index] != NULL) {
+            ZRemoveDirectory(ZStore.Directories[Index]);
+        }
+    }
+
+    if (ZStore.Directories != NULL) {
+        YoriLibFree(ZStore.Directories);
+        ZStore.Directories = NULL;
+    }
+
+    ZFreeGramIndex();
+
+    ASSERT(ZStore.DirectoryCount == 0);
+    ZStore.DirectoriesPopulated = 0;
+    ZStore.DirectoriesAllocated = 0;
+    ZStore.TotalHits = 0;
+    ZStore.RecordCount = 0;
+    ZStore.Generation = 0;
+    ZStore.ReadOffset.QuadPart = 0;
+    ZStore.IndexIncomplete = FALSE;
+}
+
+/**
+ Apply a record to the set of remembered directories.  A record with a
+ nonzero hit count adds hits to a directory, and a record with a zero hit
+ count indicates the directory should be forgotten.
+
+ @param DirectoryName Pointer to the fully qualified directory name.
+
+ @param HitCount The number of hits to add to the directory, or zero to
+        remove the directory.
+
+ @param AccessTime The time the directory was used, in seconds since 1601.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+ZApplyRecord(
+    __in PYORI_STRING DirectoryName,
+    __in DWORD HitCount,
+    __in LONGLONG AccessTime
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+    PZ_DIRECTORY Directory;
+
+    ZStore.RecordCount++;
+
+    Directory = NULL;
+    if (ZStore.DirectoryTable != NULL) {
+        HashEntry = YoriLibHashLookupByKey(ZStore.DirectoryTable, DirectoryName);
+        if (HashEntry != NULL) {
+            Directory = HashEntry->Context;
+        }
+    }
+
+    if (HitCount == 0) {
+        if (Directory != NULL) {
+            ZRemoveDirectory(Directory);
+        }
+        return TRUE;
+    }
+
+    if (Directory == NULL) {
+        Directory = ZAddDirectory(DirectoryName);
+        if (Directory == NULL) {
+            return FALSE;
+        }
+    }
+
+    if (HitCount > Z_MAX_DIRECTORY_HITS - Directory->HitCount) {
+        HitCount = Z_MAX_DIRECTORY_HITS - Directory->HitCount;
+    }
+
+    Directory->HitCount += HitCount;
+    ZStore.TotalHits += HitCount;
+    if (AccessTime > Directory->LastAccessTime) {
+        Directory->LastAccessTime = AccessTime;
+    }
+
+    return TRUE;
+}
+
+/**
+ Parse a line from the store file and apply it to the set of remembered
+ directories.  Each line consists of a hit count, an access time, and a
+ directory name, seperated by pipe characters.
+
+ @param Line Pointer to the line to parse.
+
+ @return TRUE to indicate success, FALSE to indicate failure or that the
+         line could not be parsed.
+ */
+BOOL
+ZApplyRecordLine(
+    __in PYORI_STRING Line
+    )
+{
+    YORI_STRING Remaining;
+    LONGLONG HitCount;
+    LONGLONG AccessTime;
+    DWORD CharsConsumed;
+
+    YoriLibInitEmptyString(&Remaining);
+    Remaining.StartOfString = Line->StartOfString;
+    Remaining.LengthInChars = Line->LengthInChars;
+
+    if (!YoriLibStringToNumber(&Remaining, FALSE, &HitCount, &CharsConsumed) ||
+        CharsConsumed == 0 ||
+        CharsConsumed >= Remaining.LengthInChars ||
+        Remaining.StartOfString[CharsConsumed] != '|') {
+
+        return FALSE;
+    }
+
+    Remaining.StartOfString += CharsConsumed + 1;
+    Remaining.LengthInChars -= CharsConsumed + 1;
+
+    if (!YoriLibStringToNumber(&Remaining, FALSE, &AccessTime, &CharsConsumed) ||
+        CharsConsumed == 0 ||
+        CharsConsumed >= Remaining.LengthInChars ||
+        Remaining.StartOfString[CharsConsumed] != '|') {
+
+        return FALSE;
+    }
+
+    Remaining.StartOfString += CharsConsumed + 1;
+    Remaining.LengthInChars -= CharsConsumed + 1;
+
+    if (HitCount < 0 || Remaining.LengthInChars == 0) {
+        return FALSE;
+    }
+
+    if (HitCount > Z_MAX_DIRECTORY_HITS) {
+        HitCount = Z_MAX_DIRECTORY_HITS;
+    }
+
+    return ZApplyRecord(&Remaining, (DWORD)HitCount, AccessTime);
+}
+
+/**
+ Resolve the name of the store file, if the user has requested directories
+ be remembered across sessions by configuring the YORIZFILE environment
+ variable.
+
+ @param FilePath On successful completion, populated with the full path to
+        the store file.  If no store file is configured, this is returned
+        as an empty string.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+ZGetStoreFileName(
+    __out PYORI_STRING FilePath
+    )
+{
+    YORI_STRING UserFileName;
+
+    YoriLibInitEmptyString(FilePath);
+    YoriLibInitEmptyString(&UserFileName);
+
+    if (!YoriLibAllocateAndGetEnvironmentVariable(_T("YORIZFILE"), &UserFileName)) {
+        return FALSE;
+    }
+
+    if (UserFileName.LengthInChars == 0) {
+        return TRUE;
+    }
+
+    if (!YoriLibUserStringToSingleFilePath(&UserFileName, TRUE, FilePath)) {
+        YoriLibFreeStringContents(&UserFileName);
+        return FALSE;
+    }
+
+    YoriLibFreeStringContents(&UserFileName);
+    return TRUE;
+}
+
+/**
+ Read the generation number from the header of the store file.  A file
+ without a header has never been compacted, which is generation zero.
+
+ @param FileHandle Handle to the store file.
+
+ @return The generation of the store file.
+ */
+DWORD
+ZReadStoreGeneration(
+    __in HANDLE FileHandle
+    )
+{
+    CHAR Header[32];
+    DWORD HeaderLength;
+    DWORD BytesRead;
+    DWORD Index;
+    DWORD Generation;
+
+    HeaderLength = sizeof(Z_STORE_HEADER) - 1;
+
+    SetFilePointer(FileHandle, 0, NULL, FILE_BEGIN);
+    if (!ReadFile(FileHandle, Header, sizeof(Header), &BytesRead, NULL) ||
+        BytesRead < HeaderLength ||
+        memcmp(Header, Z_STORE_HEADER, HeaderLength) != 0) {
+
+        return 0;
+    }
+
+    Generation = 0;
+    for (Index = HeaderLength; Index < BytesRead; Index++) {
+        if (Header[Index] < '0' || Header[Index] > '9') {
+            break;
+        }
+        Generation = Generation * 10 + Header[Index] - '0';
+    }
+
+    return Generation;
+}
+
+/**
+ Read any records from the store file which have not already been applied.
+ If the file has been compacted since it was last read, all remembered
+ directories are discarded and the entire file is read.
+
+ @param FileHandle Handle to the store file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+ZRefreshStore(
+    __in HANDLE FileHandle
+    )
+{
+    LARGE_INTEGER FileSize;
+    LARGE_INTEGER ReadOffset;
+    LARGE_INTEGER BytesToRead;
+    DWORD Generation;
+    DWORD BytesRead;
+    DWORD BytesToParse;
+    DWORD CharsNeeded;
+    DWORD Index;
+    DWORD LineStart;
+    PUCHAR Buffer;
+    YORI_STRING Text;
+    YORI_STRING Line;
+
+    FileSize.LowPart = GetFileSize(FileHandle, (PDWORD)&FileSize.HighPart);
+    if (FileSize.LowPart == INVALID_FILE_SIZE && GetLastError() != NO_ERROR) {
+        return FALSE;
+    }
+
+    Generation = ZReadStoreGeneration(FileHandle);
+    if (Generation != ZStore.Generation ||
+        FileSize.QuadPart < ZStore.ReadOffset.QuadPart) {
+
+        ZResetStore();
+        ZStore.Generation = Generation;
+    }
+
+    BytesToRead.QuadPart = FileSize.QuadPart - ZStore.ReadOffset.QuadPart;
+    if (BytesToRead.QuadPart == 0) {
+        return TRUE;
+    }
+
+    if (BytesToRead.HighPart != 0) {
+        return FALSE;
+    }
+
+    Buffer = YoriLibMalloc(BytesToRead.LowPart);
+    if (Buffer == NULL) {
+        return FALSE;
+    }
+
+    ReadOffset.QuadPart = ZStore.ReadOffset.QuadPart;
+    SetFilePointer(FileHandle, ReadOffset.LowPart, &ReadOffset.HighPart, FILE_BEGIN);
+    if (!ReadFile(FileHandle, Buffer, BytesToRead.LowPart, &BytesRead, NULL)) {
+        YoriLibFree(Buffer);
+        return FALSE;
+    }
+
+    //
+    //  Only parse complete lines.  Anything after the final newline is
+    //  being written by another shell and will be read next time.
+    //
+
+    for (BytesToParse = BytesRead; BytesToParse > 0; BytesToParse--) {
+        if (Buffer[BytesToParse - 1] == '\n') {
+            break;
+        }
+    }
+
+    if (BytesToParse == 0) {
+        YoriLibFree(Buffer);
+        return TRUE;
+    }
+
+    CharsNeeded = YoriLibGetMultibyteInputSizeNeeded((LPCSTR)Buffer, BytesToParse);
+    if (!YoriLibAllocateString(&Text, CharsNeeded)) {
+        YoriLibFree(Buffer);
+        return FALSE;
+    }
+
+    YoriLibMultibyteInput((LPCSTR)Buffer, BytesToParse, Text.StartOfString, CharsNeeded);
+    Text.LengthInChars = CharsNeeded;
+    YoriLibFree(Buffer);
+
+    YoriLibInitEmptyString(&Line);
+    LineStart = 0;
+    for (Index = 0; Index < Text.LengthInChars; Index++) {
+        if (Text.StartOfString[Index] != '\n') {
+            continue;
+        }
+
+        Line.StartOfString = &Text.StartOfString[LineStart];
+        Line.LengthInChars = Index - LineStart;
+        if (Line.LengthInChars > 0 && Line.StartOfString[Line.LengthInChars - 1] == '\r') {
+            Line.LengthInChars--;
+        }
+
+        if (Line.LengthInChars > 0 && Line.StartOfString[0] != '#') {
+            ZApplyRecordLine(&Line);
+        }
+
+        LineStart = Index + 1;
+    }
+
+    YoriLibFreeStringContents(&Text);
+    ZStore.ReadOffset.QuadPart = ZStore.ReadOffset.QuadPart + BytesToParse;
+    return TRUE;
+}
+
+/**
+ Write text to the store file, either by appending it to the end of the file
+ or by replacing the entire contents of the file.
+
+ @param FileHandle Handle to the store file.  When appending, this handle
+        must be opened for append access only.
+
+ @param Text Pointer to the text to write.
+
+ @param ReplaceContents If TRUE, the text replaces the contents of the file.
+        If FALSE, the text is appended to the end of the file.
+
+ @param EndOffset On successful completion, populated with the offset of the
+        end of the text within the file.  This is only populated if
+        ReplaceContents is TRUE.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+ZWriteStoreText(
+    __in HANDLE FileHandle,
+    __in PYORI_STRING Text,
+    __in BOOL ReplaceContents,
+    __out PLARGE_INTEGER EndOffset
+    )
+{
+    LPSTR Buffer;
+    DWORD BytesNeeded;
+    DWORD BytesWritten;
+
+    BytesNeeded = YoriLibGetMultibyteOutputSizeNeeded(Text->StartOfString, Text->LengthInChars);
+    Buffer = YoriLibMalloc(BytesNeeded);
+    if (Buffer == NULL) {
+        return FALSE;
+    }
+
+    YoriLibMultibyteOutput(Text->StartOfString, Text->LengthInChars, Buffer, BytesNeeded);
+
+    EndOffset->QuadPart = 0;
+    if (ReplaceContents) {
+        SetFilePointer(FileHandle, 0, NULL, FILE_BEGIN);
+    }
+
+    if (!WriteFile(FileHandle, Buffer, BytesNeeded, &BytesWritten, NULL) ||
+        BytesWritten != BytesNeeded) {
+
+        YoriLibFree(Buffer);
+        return FALSE;
+    }
+
+    YoriLibFree(Buffer);
+
+    if (ReplaceContents) {
+        EndOffset->QuadPart = BytesWritten;
+        if (!SetEndOfFile(FileHandle)) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Decrease each HitCount by 1/4th of its current value.  This keeps
+ HitCounts relatively low while still maintaining a measurable difference
+ between entries hit a lot and entries rarely hit.
+ */
+VOID
+ZReduceHitCounts()
+{
+    DWORD Index;
+    PZ_DIRECTORY Directory;
+
+    for (Index = 0; Index < ZStore.DirectoriesPopulated; Index++) {
+        Directory = ZStore.Directories[Index];
+        if (Directory != NULL) {
+            ZStore.TotalHits -= (Directory->HitCount >> 2);
+            Directory->HitCount -= (Directory->HitCount >> 2);
+            ASSERT(Directory->HitCount > 0);
+        }
+    }
+}
+
+/**
+ Reduce the hit counts of remembered directories if they have grown large,
+ and forget the least useful directories if too many are remembered.
+
+ @param CurrentTime The current time, in seconds since 1601.
+ */
+VOID
+ZAgeStore(
+    __in LONGLONG CurrentTime
+    )
+{
+    DWORD Index;
+    DWORD Threshold;
+    PZ_DIRECTORY Directory;
+
+    if (ZStore.TotalHits > Z_MAX_TOTAL_HITS) {
+        ZReduceHitCounts();
+    }
+
+    Threshold = 1;
+    while (ZStore.DirectoryCount > Z_MAX_STORED_DIRS) {
+        for (Index = 0; Index < ZStore.DirectoriesPopulated; Index++) {
+            Directory = ZStore.Directories[Index];
+            if (Directory != NULL && ZGetFrecency(Directory, CurrentTime) <= Threshold) {
+                ZRemoveDirectory(Directory);
+            }
+        }
+        Threshold = Threshold * 2;
+    }
+}
+
+/**
+ Compact the set of remembered directories.  Hit counts are reduced and
+ excess directories are forgotten, the substring index is rebuilt, and if a
+ store file is open and locked, it is rewritten to contain one record per
+ remembered directory.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+ZCompactStore()
+{
+    YORI_STRING Text;
+    LARGE_INTEGER EndOffset;
+    PZ_DIRECTORY Directory;
+    DWORD CharsNeeded;
+    DWORD Generation;
+    DWORD Index;
+    int CharsWritten;
+
+    ZAgeStore(ZGetCurrentTime());
+    ZRebuildGramIndex();
+    ZStore.RecordCount = ZStore.DirectoryCount;
+
+    if (ZStore.FileHandle == NULL) {
+        return TRUE;
+    }
+
+    if (!ZStore.FileLocked) {
+        return FALSE;
+    }
+
+    //
+    //  Each record needs space for two numbers, two seperators, and a
+    //  newline in addition to the directory name.
+    //
 
-    /**
-     The score for this entry.
-     */
-    DWORD Score;
-} Z_SCOREBOARD_ENTRY, *PZ_SCOREBOARD_ENTRY;
+    CharsNeeded = sizeof(Z_STORE_HEADER) + 16;
+    for (Index = 0; Index < ZStore.DirectoriesPopulated; Index++) {
+        CharsNeeded += ZStore.Directories[Index]->DirectoryName.LengthInChars + 40;
+    }
 
-/**
- The set of recent directories known to the module.
- */
-Z_RECENT_DIRECTORIES ZRecentDirectories;
+    if (!YoriLibAllocateString(&Text, CharsNeeded)) {
+        return FALSE;
+    }
 
-/**
- Set to TRUE once the command has been invoked once to keep the module loaded.
- */
-BOOL ZCallbacksRegistered;
+    Generation = ZStore.Generation + 1;
+    Text.LengthInChars = YoriLibSPrintfS(Text.StartOfString, Text.LengthAllocated, _T("%hs%i\n"), Z_STORE_HEADER, Generation);
+    for (Index = 0; Index < ZStore.DirectoriesPopulated; Index++) {
+        Directory = ZStore.Directories[Index];
+        CharsWritten = YoriLibSPrintfS(&Text.StartOfString[Text.LengthInChars],
+                                       Text.LengthAllocated - Text.LengthInChars,
+                                       _T("%i|%lli|%y\n"),
+                                       Directory->HitCount,
+                                       Directory->LastAccessTime,
+                                       &Directory->DirectoryName);
+        if (CharsWritten < 0) {
+            YoriLibFreeStringContents(&Text);
+            return FALSE;
+        }
+        Text.LengthInChars += CharsWritten;
+    }
+
+    if (!ZWriteStoreText(ZStore.FileHandle, &Text, TRUE, &EndOffset)) {
+        YoriLibFreeStringContents(&Text);
+        return FALSE;
+    }
+
+    YoriLibFreeStringContents(&Text);
+    ZStore.Generation = Generation;
+    ZStore.ReadOffset.QuadPart = EndOffset.QuadPart;
+    return TRUE;
+}
 
 /**
- Display the current known list of recent directories in order of most
- recently used to least recently used with their corresponding hit count.
+ Compact the store if it has grown beyond its limits, either because too
+ many records have accumulated relative to the number of directories, too
+ many directories are remembered, or hit counts have grown large enough to
+ be reduced.  This is checked when the store is loaded rather than as each
+ hit is recorded, so the decision depends only on the contents of the store
+ and not on how many hits any single process has recorded.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
-ZListStack()
+ZCompactStoreIfNeeded()
 {
-    PYORI_LIST_ENTRY ListEntry;
-    PZ_RECENT_DIRECTORY FoundRecentDir;
+    if (ZStore.RecordCount > ZStore.DirectoryCount * 2 + Z_COMPACT_MINIMUM_RECORDS ||
+        ZStore.DirectoryCount > Z_MAX_STORED_DIRS ||
+        ZStore.TotalHits > Z_MAX_TOTAL_HITS) {
 
-    ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, NULL);
-    while (ListEntry != NULL) {
-        FoundRecentDir = CONTAINING_RECORD(ListEntry, Z_RECENT_DIRECTORY, ListEntry);
-        ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, ListEntry);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y HitCount %i\n"), &FoundRecentDir->DirectoryName, FoundRecentDir->HitCount);
+        return ZCompactStore();
     }
+
     return TRUE;
 }
 
 /**
- Check the recent directories for a match to DirectoryName.  If a match is
- found, promote it to be the most recent entry and update its HitCount.
- If no match is found, add a new match, potentially evicting the least
- recently used match.
-
- @param DirectoryName Pointer to the fully qualified directory name to add.
+ Open the store file, if one is configured, lock it, and read any records
+ which other shells have written to it.  If the lock was obtained, the store
+ is compacted if it has grown beyond its limits.  If no store file is
+ configured, directories are only remembered in memory.
 
- @return TRUE if the entry was successfully added, FALSE if it was not.
+ @return TRUE to indicate success, FALSE to indicate failure.  On failure,
+         directories continue to be remembered in memory.
  */
 BOOL
-ZAddDirectoryToRecent(
-    __in PYORI_STRING DirectoryName
-    )
+ZOpenStore()
 {
-    PYORI_LIST_ENTRY ListEntry;
-    PZ_RECENT_DIRECTORY FoundRecentDir;
+    YORI_STRING FilePath;
+    HANDLE FileHandle;
+    HANDLE AppendHandle;
+    DWORD Attempts;
+
+    ZStore.FileHandle = NULL;
+    ZStore.AppendHandle = NULL;
+    ZStore.FileLocked = FALSE;
+
+    if (!ZGetStoreFileName(&FilePath)) {
+        return FALSE;
+    }
 
-    if (ZRecentDirectories.RecentDirList.Next == NULL) {
-        YoriLibInitializeListHead(&ZRecentDirectories.RecentDirList);
+    if (FilePath.LengthInChars == 0) {
+        return ZCompactStoreIfNeeded();
     }
 
     //
-    //  If this attempt to add is a multiple of 1/4th of the size of the
-    //  list, decrease each HitCount by 1/4th of its current value.
-    //  This math isn't completely perfect, but it will tend to keep
-    //  HitCounts relatively low while still maintaining a measurable
-    //  difference between entries hit a lot and entries rarely hit.
+    //  Records are found by looking for single byte newlines, which doesn't
+    //  work for UTF16, so in that case directories are only remembered in
+    //  memory.
     //
 
-    ZRecentDirectories.MonotonicAddAttempt++;
-    if ((ZRecentDirectories.MonotonicAddAttempt % (Z_MAX_RECENT_DIRS >> 2)) == 0) {
-        ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, NULL);
-        while (ListEntry != NULL) {
-            FoundRecentDir = CONTAINING_RECORD(ListEntry, Z_RECENT_DIRECTORY, ListEntry);
-            ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, ListEntry);
-            FoundRecentDir->HitCount -= (FoundRecentDir->HitCount >> 2);
-            ASSERT(FoundRecentDir->HitCount > 0);
-        }
+    if (YoriLibGetMultibyteInputEncoding() == CP_UTF16) {
+        YoriLibFreeStringContents(&FilePath);
+        ZCompactStoreIfNeeded();
+        return FALSE;
     }
 
-    //
-    //  Check if the new directory already exists in the recent directory
-    //  list, update its position to be head of the list, increase its
-    //  HitCount, and return.
-    //
+    FileHandle = CreateFile(FilePath.StartOfString,
+                            GENERIC_READ | GENERIC_WRITE,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
 
-    ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, NULL);
-    while (ListEntry != NULL) {
-        FoundRecentDir = CONTAINING_RECORD(ListEntry, Z_RECENT_DIRECTORY, ListEntry);
-        if (YoriLibCompareStringInsensitive(DirectoryName, &FoundRecentDir->DirectoryName) == 0) {
-            YoriLibRemoveListItem(&FoundRecentDir->ListEntry);
-            YoriLibInsertList(&ZRecentDirectories.RecentDirList, &FoundRecentDir->ListEntry);
-            FoundRecentDir->HitCount++;
-            return TRUE;
-        }
-        ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, ListEntry);
+    if (FileHandle == NULL || FileHandle == INVALID_HANDLE_VALUE) {
+        YoriLibFreeStringContents(&FilePath);
+        return FALSE;
+    }
+
+    AppendHandle = CreateFile(FilePath.StartOfString,
+                              FILE_APPEND_DATA,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              NULL,
+                              OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL,
+                              NULL);
+
+    YoriLibFreeStringContents(&FilePath);
+
+    if (AppendHandle == NULL || AppendHandle == INVALID_HANDLE_VALUE) {
+        CloseHandle(FileHandle);
+        return FALSE;
     }
 
     //
-    //  Since it's not in the list, evict the oldest entry if the list has
-    //  reached its maximum size.
+    //  If another shell holds the lock for a long time, continue without
+    //  it.  Records are still appended, but the file is not compacted.
     //
 
-    if (ZRecentDirectories.RecentDirCount >= Z_MAX_RECENT_DIRS) {
-        ListEntry = YoriLibGetPreviousListEntry(&ZRecentDirectories.RecentDirList, NULL);
-        FoundRecentDir = CONTAINING_RECORD(ListEntry, Z_RECENT_DIRECTORY, ListEntry);
-        YoriLibRemoveListItem(&FoundRecentDir->ListEntry);
-        YoriLibFreeStringContents(&FoundRecentDir->DirectoryName);
-        YoriLibDereference(FoundRecentDir);
-        ZRecentDirectories.RecentDirCount--;
+    for (Attempts = 0; Attempts < 100; Attempts++) {
+        if (LockFile(FileHandle, 0, Z_STORE_LOCK_OFFSET_HIGH, 1, 0)) {
+            ZStore.FileLocked = TRUE;
+            break;
+        }
+        if (GetLastError() != ERROR_LOCK_VIOLATION) {
+            break;
+        }
+        Sleep(10);
     }
 
+    ZStore.FileHandle = FileHandle;
+    ZStore.AppendHandle = AppendHandle;
+    ZRefreshStore(FileHandle);
+
     //
-    //  Attempt to insert a new entry corresponding to this directory.
+    //  Only compact while holding the lock, since compaction rewrites the
+    //  file and reduces hit counts which other shells also read.
     //
 
-    FoundRecentDir = YoriLibReferencedMalloc(sizeof(Z_RECENT_DIRECTORY) + (DirectoryName->LengthInChars + 1) * sizeof(TCHAR));
-    if (FoundRecentDir == NULL) {
-        return FALSE;
+    if (ZStore.FileLocked) {
+        ZCompactStoreIfNeeded();
+    }
+    return TRUE;
+}
+
+/**
+ Unlock and close the store file, if it is open.
+ */
+VOID
+ZCloseStore()
+{
+    if (ZStore.FileHandle != NULL) {
+        if (ZStore.FileLocked) {
+            UnlockFile(ZStore.FileHandle, 0, Z_STORE_LOCK_OFFSET_HIGH, 1, 0);
+            ZStore.FileLocked = FALSE;
+        }
+        CloseHandle(ZStore.FileHandle);
+        ZStore.FileHandle = NULL;
+        CloseHandle(ZStore.AppendHandle);
+        ZStore.AppendHandle = NULL;
     }
+}
+
+/**
+ Record a hit on a directory, or that a directory should be forgotten.  If
+ a store file is open, the record is appended to it.  Any compaction this
+ makes necessary is performed the next time the store is loaded.
+
+ @param DirectoryName Pointer to the fully qualified directory name.
+
+ @param HitCount The number of hits to record, or zero to forget the
+        directory.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+ZAddRecord(
+    __in PYORI_STRING DirectoryName,
+    __in DWORD HitCount
+    )
+{
+    YORI_STRING Text;
+    LARGE_INTEGER EndOffset;
+    LONGLONG CurrentTime;
+    BOOL Result;
+
+    CurrentTime = ZGetCurrentTime();
+
+    if (ZStore.FileHandle != NULL) {
+        YoriLibInitEmptyString(&Text);
+        if (YoriLibYPrintf(&Text, _T("%i|%lli|%y\n"), HitCount, CurrentTime, DirectoryName) < 0) {
+            return FALSE;
+        }
+
+        Result = ZWriteStoreText(ZStore.AppendHandle, &Text, FALSE, &EndOffset);
+        YoriLibFreeStringContents(&Text);
+        if (!Result) {
+            return FALSE;
+        }
+
+        //
+        //  If the file is not locked, other shells may have appended
+        //  records which have not been read yet.  This record will be read
+        //  along with them next time.
+        //
+
+        if (!ZStore.FileLocked) {
+            return TRUE;
+        }
+
+        //
+        //  Other shells may have appended records before this one, so read
+        //  everything up to and including this record.
+        //
 
-    YoriLibReference(FoundRecentDir);
-    FoundRecentDir->DirectoryName.MemoryToFree = FoundRecentDir;
-    FoundRecentDir->DirectoryName.StartOfString = (LPWSTR)(FoundRecentDir + 1);
-    FoundRecentDir->DirectoryName.LengthAllocated = DirectoryName->LengthInChars + 1;
-    FoundRecentDir->DirectoryName.LengthInChars = DirectoryName->LengthInChars;
+        if (!ZRefreshStore(ZStore.FileHandle)) {
+            return FALSE;
+        }
 
-    memcpy(FoundRecentDir->DirectoryName.StartOfString, DirectoryName->StartOfString, (DirectoryName->LengthInChars + 1) * sizeof(TCHAR));
+    } else if (!ZApplyRecord(DirectoryName, HitCount, CurrentTime)) {
+        return FALSE;
+    }
 
-    FoundRecentDir->HitCount = 1;
+    return TRUE;
+}
 
-    YoriLibInsertList(&ZRecentDirectories.RecentDirList, &FoundRecentDir->ListEntry);
-    ZRecentDirectories.RecentDirCount++;
+/**
+ Display the current known list of directories with their corresponding hit
+ count.
 
-    ASSERT(ZRecentDirectories.RecentDirCount <= Z_MAX_RECENT_DIRS);
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+ZListStack()
+{
+    DWORD Index;
+    PZ_DIRECTORY Directory;
 
+    ZOpenStore();
+    for (Index = 0; Index < ZStore.DirectoriesPopulated; Index++) {
+        Directory = ZStore.Directories[Index];
+        if (Directory != NULL) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y HitCount %i\n"), &Directory->DirectoryName, Directory->HitCount);
+        }
+    }
+    ZCloseStore();
     return TRUE;
 }
 
@@ -263,16 +1358,10 @@ VOID
 YORI_BUILTIN_FN
 ZNotifyUnload()
 {
-    PYORI_LIST_ENTRY ListEntry;
-    PZ_RECENT_DIRECTORY FoundRecentDir;
-
-    ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, NULL);
-    while (ListEntry != NULL) {
-        FoundRecentDir = CONTAINING_RECORD(ListEntry, Z_RECENT_DIRECTORY, ListEntry);
-        ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, ListEntry);
-        YoriLibRemoveListItem(&FoundRecentDir->ListEntry);
-        YoriLibFreeStringContents(&FoundRecentDir->DirectoryName);
-        YoriLibDereference(FoundRecentDir);
+    ZResetStore();
+    if (ZStore.DirectoryTable != NULL) {
+        YoriLibFreeEmptyHashTable(ZStore.DirectoryTable);
+        ZStore.DirectoryTable = NULL;
     }
 }
 
@@ -347,11 +1436,181 @@ ZResolveSpecificationToFullPath(
     return TRUE;
 }
 
+/**
+ Determine whether a remembered directory matches the user specification,
+ and if so, assign it a score and add it to the scoreboard.  If the same
+ directory is already on the scoreboard, the scores are combined instead.
+
+ @param UserSpecification Pointer to the user specification to match against.
+
+ @param Directory Pointer to the remembered directory to check.
+
+ @param CurrentTime The current time, in seconds since 1601.
+
+ @param Entries Pointer to the scoreboard array.
+
+ @param EntryTable Pointer to a hash table of the entries on the scoreboard,
+        indexed by directory name.
+
+ @param EntriesPopulated Pointer to the number of entries on the scoreboard.
+        This is incremented if an entry is added.
+ */
+VOID
+ZScoreDirectory(
+    __in PYORI_STRING UserSpecification,
+    __in PZ_DIRECTORY Directory,
+    __in LONGLONG CurrentTime,
+    __in PZ_SCOREBOARD_ENTRY Entries,
+    __in PYORI_HASH_TABLE EntryTable,
+    __inout PDWORD EntriesPopulated
+    )
+{
+    YORI_STRING FinalComponent;
+    YORI_STRING TrailingPortion;
+    YORI_STRING StringToAdd;
+    PYORI_HASH_ENTRY HashEntry;
+    PZ_SCOREBOARD_ENTRY Entry;
+    DWORD ScoreForThisEntry;
+    DWORD OffsetOfMatch;
+    BOOL SeperatorBefore;
+    BOOL SeperatorAfter;
+    BOOL AddThisEntry;
+    BOOL FoundAsParentOnly;
+
+    AddThisEntry = FALSE;
+    FoundAsParentOnly = FALSE;
+
+    //
+    //  Calculate a rough score for this entry.
+    //
+
+    ScoreForThisEntry = ZGetFrecency(Directory, CurrentTime);
+
+    //
+    //  Determine if it's a match and we should add it.
+    //
+
+    YoriLibInitEmptyString(&FinalComponent);
+    YoriLibInitEmptyString(&TrailingPortion);
+    FinalComponent.StartOfString = YoriLibFindRightMostCharacter(&Directory->DirectoryName, '\\');
+
+    if (Directory->DirectoryName.LengthInChars >= UserSpecification->LengthInChars) {
+        TrailingPortion.StartOfString = &Directory->DirectoryName.StartOfString[Directory->DirectoryName.LengthInChars - UserSpecification->LengthInChars];
+        TrailingPortion.LengthInChars = UserSpecification->LengthInChars;
+    }
+    OffsetOfMatch = 0;
+
+    //
+    //  If it's a complete match of the final component, big bonus points.
+    //  If it's a match up to the end of the string, moderate bonus points.
+    //  If it's somewhere in the final component, small bonus points.
+    //
+
+    if (FinalComponent.StartOfString != NULL) {
+        FinalComponent.StartOfString++;
+        FinalComponent.LengthInChars = Directory->DirectoryName.LengthInChars - (DWORD)(FinalComponent.StartOfString - Directory->DirectoryName.StartOfString);
+
+        if (YoriLibCompareStringInsensitive(&FinalComponent, UserSpecification) == 0) {
+            ScoreForThisEntry += Z_SCORE_UNIT * 4;
+            AddThisEntry = TRUE;
+        } else if (TrailingPortion.LengthInChars > 0 &&
+                   YoriLibCompareStringInsensitive(&TrailingPortion, UserSpecification) == 0) {
+            ScoreForThisEntry += Z_SCORE_UNIT * 2;
+            AddThisEntry = TRUE;
+        } else if (YoriLibFindFirstMatchingSubstringInsensitive(&FinalComponent, 1, UserSpecification, NULL) != NULL) {
+
+            ScoreForThisEntry += Z_SCORE_UNIT;
+            AddThisEntry = TRUE;
+        }
+    }
+
+    YoriLibInitEmptyString(&StringToAdd);
+    StringToAdd.MemoryToFree = Directory->DirectoryName.MemoryToFree;
+    if (AddThisEntry) {
+        StringToAdd.StartOfString = Directory->DirectoryName.StartOfString;
+        StringToAdd.LengthInChars = Directory->DirectoryName.LengthInChars;
+    }
+
+    //
+    //  If it's in the string but not the final component, add it, but
+    //  no bonus points.  If the user specification refers to a parent
+    //  component, add up to that component only.
+    //
+
+    if (!AddThisEntry &&
+        UserSpecification->LengthInChars > 0 &&
+        YoriLibFindFirstMatchingSubstringInsensitive(&Directory->DirectoryName, 1, UserSpecification, &OffsetOfMatch) != NULL) {
+
+        SeperatorBefore = FALSE;
+        SeperatorAfter = FALSE;
+
+        if (OffsetOfMatch == 0 ||
+            YoriLibIsSep(UserSpecification->StartOfString[0]) ||
+            YoriLibIsSep(Directory->DirectoryName.StartOfString[OffsetOfMatch - 1])) {
+            SeperatorBefore = TRUE;
+        }
+
+        if (OffsetOfMatch + UserSpecification->LengthInChars == Directory->DirectoryName.LengthInChars ||
+            YoriLibIsSep(UserSpecification->StartOfString[UserSpecification->LengthInChars - 1]) ||
+            YoriLibIsSep(Directory->DirectoryName.StartOfString[OffsetOfMatch + UserSpecification->LengthInChars])) {
+            SeperatorAfter = TRUE;
+        }
+
+        StringToAdd.StartOfString = Directory->DirectoryName.StartOfString;
+        if (SeperatorBefore && SeperatorAfter) {
+            StringToAdd.LengthInChars = OffsetOfMatch + UserSpecification->LengthInChars;
+        } else {
+            StringToAdd.LengthInChars = Directory->DirectoryName.LengthInChars;
+        }
+        AddThisEntry = TRUE;
+        FoundAsParentOnly = TRUE;
+    }
+
+    if (!AddThisEntry) {
+        return;
+    }
+
+    //
+    //  If the currently found directory has already been added by the
+    //  fully resolved user specification or an earlier parent match,
+    //  don't add it twice.  If it's a high quality match, such as
+    //  against a user specification or final component, add the scores
+    //  together.  Don't do this if the match was against a parent
+    //  component, because many entries may have the same ancestors but
+    //  that doesn't imply they have the quality of all children
+    //  combined.
+    //
+
+    HashEntry = YoriLibHashLookupByKey(EntryTable, &StringToAdd);
+    if (HashEntry != NULL) {
+        if (!FoundAsParentOnly) {
+            Entry = HashEntry->Context;
+            Entry->Score += ScoreForThisEntry;
+        }
+        return;
+    }
+
+    //
+    //  Add it with the calculated score.
+    //
+
+    Entry = &Entries[*EntriesPopulated];
+    memcpy(&Entry->DirectoryName, &StringToAdd, sizeof(YORI_STRING));
+    Entry->Score = ScoreForThisEntry;
+    Entry->Directory = NULL;
+    if (StringToAdd.LengthInChars == Directory->DirectoryName.LengthInChars) {
+        Entry->Directory = Directory;
+    }
+    YoriLibHashInsertByKey(EntryTable, &Entry->DirectoryName, Entry, &Entry->HashEntry);
+    (*EntriesPopulated)++;
+}
+
 /**
  Take any fully resolved path based on the user specification, and any
  recent directories that match the user specification, heuristically assign
- each directory with a score, and return the entry with the highest score.
- If nothing matches the user specification, returns FALSE.
+ each directory with a score, and return the entry with the highest score
+ that still exists.  Remembered directories which no longer exist are
+ forgotten.  If nothing matches the user specification, returns FALSE.
 
  @param UserSpecification Pointer to the user specification to match against.
 
@@ -373,32 +1632,62 @@ ZBuildScoreboardAndSelectBest(
     )
 {
     PZ_SCOREBOARD_ENTRY Entries;
-    PYORI_LIST_ENTRY ListEntry;
-    PZ_RECENT_DIRECTORY FoundRecentDir;
-    YORI_STRING FinalComponent;
-    YORI_STRING TrailingPortion;
-    YORI_STRING StringToAdd;
+    PYORI_HASH_TABLE EntryTable;
+    PZ_GRAM_BUCKET Bucket;
+    PZ_GRAM_BUCKET SmallestBucket;
+    PZ_DIRECTORY Directory;
+    PDWORD CandidateIndexes;
+    DWORD CandidateCount;
+    DWORD BucketCount;
     DWORD EntriesPopulated;
     DWORD Index;
-    DWORD ScoreForThisEntry;
     DWORD BestScore;
     DWORD BestIndex;
-    DWORD OffsetOfMatch;
-    BOOL SeperatorBefore;
-    BOOL SeperatorAfter;
-    BOOL AddThisEntry;
-    BOOL FoundAsParentOnly;
+    DWORD LastError;
+    LONGLONG CurrentTime;
+    BOOL Found;
 
     //
-    //  Allocate enough entries for everything we know about, including all
-    //  history and the currently resolved full path
+    //  Every match must contain the user specification, so if it's long
+    //  enough to be indexed, only the directories containing its least
+    //  common substring need to be checked.  Otherwise check everything.
     //
 
-    Entries = YoriLibMalloc(sizeof(Z_SCOREBOARD_ENTRY) * (Z_MAX_RECENT_DIRS + 1));
+    CandidateIndexes = NULL;
+    CandidateCount = ZStore.DirectoriesPopulated;
+    if (!ZStore.IndexIncomplete && UserSpecification->LengthInChars >= Z_GRAM_LENGTH) {
+        SmallestBucket = NULL;
+        for (Index = 0; Index + Z_GRAM_LENGTH <= UserSpecification->LengthInChars; Index++) {
+            Bucket = ZGetGramBucket(&UserSpecification->StartOfString[Index]);
+            if (SmallestBucket == NULL || Bucket->Count < SmallestBucket->Count) {
+                SmallestBucket = Bucket;
+            }
+        }
+        CandidateIndexes = SmallestBucket->DirectoryIndexes;
+        CandidateCount = SmallestBucket->Count;
+    }
+
+    //
+    //  Allocate enough entries for every candidate, plus the currently
+    //  resolved full path
+    //
+
+    Entries = YoriLibMalloc(sizeof(Z_SCOREBOARD_ENTRY) * (CandidateCount + 1));
     if (Entries == NULL) {
         return FALSE;
     }
 
+    BucketCount = CandidateCount / 4 + 1;
+    if (BucketCount > Z_DIRECTORY_HASH_BUCKETS) {
+        BucketCount = Z_DIRECTORY_HASH_BUCKETS;
+    }
+
+    EntryTable = YoriLibAllocateHashTable(BucketCount);
+    if (EntryTable == NULL) {
+        YoriLibFree(Entries);
+        return FALSE;
+    }
+
     EntriesPopulated = 0;
 
     //
@@ -410,180 +1699,89 @@ ZBuildScoreboardAndSelectBest(
 
     if (FullMatchToUserSpec->LengthInChars > 0) {
         memcpy(&Entries[EntriesPopulated].DirectoryName, FullMatchToUserSpec, sizeof(YORI_STRING));
-        Entries[EntriesPopulated].Score = Z_MAX_RECENT_DIRS * 16;
+        Entries[EntriesPopulated].Score = Z_SCORE_UNIT * 16;
+        Entries[EntriesPopulated].Directory = NULL;
+        YoriLibHashInsertByKey(EntryTable, &Entries[EntriesPopulated].DirectoryName, &Entries[EntriesPopulated], &Entries[EntriesPopulated].HashEntry);
         EntriesPopulated++;
     }
 
-    Index = Z_MAX_RECENT_DIRS;
-    ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, NULL);
-    while (ListEntry != NULL) {
-        FoundRecentDir = CONTAINING_RECORD(ListEntry, Z_RECENT_DIRECTORY, ListEntry);
-        ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, ListEntry);
-        AddThisEntry = FALSE;
-        FoundAsParentOnly = FALSE;
-
-        //
-        //  Calculate a rough score for this entry.
-        //
-
-        ScoreForThisEntry = Index * (Z_MAX_RECENT_DIRS / 8);
-        ScoreForThisEntry += FoundRecentDir->HitCount * (Z_MAX_RECENT_DIRS / 8);
-
-        //
-        //  Determine if it's a match and we should add it.
-        //
-
-        YoriLibInitEmptyString(&FinalComponent);
-        YoriLibInitEmptyString(&TrailingPortion);
-        FinalComponent.StartOfString = YoriLibFindRightMostCharacter(&FoundRecentDir->DirectoryName, '\\');
+    CurrentTime = ZGetCurrentTime();
+    for (Index = 0; Index < CandidateCount; Index++) {
+        if (CandidateIndexes != NULL) {
+            Directory = ZStore.Directories[CandidateIndexes[Index]];
+        } else {
+            Directory = ZStore.Directories[Index];
+        }
 
-        if (FoundRecentDir->DirectoryName.LengthInChars >= UserSpecification->LengthInChars) {
-            TrailingPortion.StartOfString = &FoundRecentDir->DirectoryName.StartOfString[FoundRecentDir->DirectoryName.LengthInChars - UserSpecification->LengthInChars];
-            TrailingPortion.LengthInChars = UserSpecification->LengthInChars;
+        if (Directory != NULL) {
+            ZScoreDirectory(UserSpecification, Directory, CurrentTime, Entries, EntryTable, &EntriesPopulated);
         }
-        OffsetOfMatch = 0;
+    }
 
-        //
-        //  If it's a complete match of the final component, big bonus points.
-        //  If it's a match up to the end of the string, moderate bonus points.
-        //  If it's somewhere in the final component, small bonus points.
-        //
+    //
+    //  Find the highest score.  Remembered directories may have been
+    //  deleted since they were used, so check that it exists, and if not,
+    //  forget it and move to the next highest score.  If nothing is left,
+    //  we can't find anything that the user would be happy with, so do
+    //  nothing.
+    //
 
-        if (FinalComponent.StartOfString != NULL) {
-            FinalComponent.StartOfString++;
-            FinalComponent.LengthInChars = FoundRecentDir->DirectoryName.LengthInChars - (DWORD)(FinalComponent.StartOfString - FoundRecentDir->DirectoryName.StartOfString);
-
-            if (YoriLibCompareStringInsensitive(&FinalComponent, UserSpecification) == 0) {
-                ScoreForThisEntry += Z_MAX_RECENT_DIRS * 4;
-                AddThisEntry = TRUE;
-            } else if (TrailingPortion.LengthInChars > 0 &&
-                       YoriLibCompareStringInsensitive(&TrailingPortion, UserSpecification) == 0) {
-                ScoreForThisEntry += Z_MAX_RECENT_DIRS * 2;
-                AddThisEntry = TRUE;
-            } else if (YoriLibFindFirstMatchingSubstringInsensitive(&FinalComponent, 1, UserSpecification, NULL) != NULL) {
-
-                ScoreForThisEntry += Z_MAX_RECENT_DIRS;
-                AddThisEntry = TRUE;
+    Found = FALSE;
+    while (TRUE) {
+        BestScore = 0;
+        BestIndex = 0;
+        for (Index = 0; Index < EntriesPopulated; Index++) {
+            if (Entries[Index].Score > BestScore) {
+                BestScore = Entries[Index].Score;
+                BestIndex = Index;
             }
         }
 
-        YoriLibInitEmptyString(&StringToAdd);
-        if (AddThisEntry) {
-            StringToAdd.StartOfString = FoundRecentDir->DirectoryName.StartOfString;
-            StringToAdd.LengthInChars = FoundRecentDir->DirectoryName.LengthInChars;
+        if (BestScore == 0) {
+            break;
         }
 
         //
-        //  If it's in the string but not the final component, add it, but
-        //  no bonus points.  If the user specification refers to a parent
-        //  component, add up to that component only.
+        //  Return the highest score match as a referenced string.  Perform
+        //  a new allocation for this to ensure it's NULL terminated at the
+        //  correct point.
         //
 
-        if (!AddThisEntry &&
-            UserSpecification->LengthInChars > 0 &&
-            YoriLibFindFirstMatchingSubstringInsensitive(&FoundRecentDir->DirectoryName, 1, UserSpecification, &OffsetOfMatch) != NULL) {
-
-            SeperatorBefore = FALSE;
-            SeperatorAfter = FALSE;
-
-            if (OffsetOfMatch == 0 ||
-                YoriLibIsSep(UserSpecification->StartOfString[0]) ||
-                YoriLibIsSep(FoundRecentDir->DirectoryName.StartOfString[OffsetOfMatch - 1])) {
-                SeperatorBefore = TRUE;
-            }
-
-            if (OffsetOfMatch + UserSpecification->LengthInChars == FoundRecentDir->DirectoryName.LengthInChars ||
-                YoriLibIsSep(UserSpecification->StartOfString[UserSpecification->LengthInChars - 1]) ||
-                YoriLibIsSep(FoundRecentDir->DirectoryName.StartOfString[OffsetOfMatch + UserSpecification->LengthInChars])) {
-                SeperatorAfter = TRUE;
-            }
-
-            StringToAdd.StartOfString = FoundRecentDir->DirectoryName.StartOfString;
-            if (SeperatorBefore && SeperatorAfter) {
-                StringToAdd.LengthInChars = OffsetOfMatch + UserSpecification->LengthInChars;
-            } else {
-                StringToAdd.LengthInChars = FoundRecentDir->DirectoryName.LengthInChars;
-            }
-            AddThisEntry = TRUE;
-            FoundAsParentOnly = TRUE;
+        if (!YoriLibAllocateString(BestMatch, Entries[BestIndex].DirectoryName.LengthInChars + 1)) {
+            break;
         }
+        memcpy(BestMatch->StartOfString, Entries[BestIndex].DirectoryName.StartOfString, Entries[BestIndex].DirectoryName.LengthInChars * sizeof(TCHAR));
+        BestMatch->LengthInChars = Entries[BestIndex].DirectoryName.LengthInChars;
+        BestMatch->StartOfString[BestMatch->LengthInChars] = '\0';
 
-        //
-        //  If the currently found directory has already been added by the
-        //  fully resolved user specification or an earlier parent match,
-        //  don't add it twice.  If it's a high quality match, such as
-        //  against a user specification or final component, add the scores
-        //  together.  Don't do this if the match was against a parent
-        //  component, because many entries may have the same ancestors but
-        //  that doesn't imply they have the quality of all children
-        //  combined.
-        //
-
-        if (AddThisEntry) {
-            for (BestIndex = 0; BestIndex < EntriesPopulated; BestIndex++) {
-                if (YoriLibCompareStringInsensitive(&Entries[BestIndex].DirectoryName, &StringToAdd) == 0) {
-
-                    if (!FoundAsParentOnly) {
-                        Entries[BestIndex].Score += ScoreForThisEntry;
-                    }
-                    AddThisEntry = FALSE;
-                    break;
-                }
-            }
+        if (GetFileAttributes(BestMatch->StartOfString) != (DWORD)-1) {
+            Found = TRUE;
+            break;
         }
 
-        //
-        //  If we should add it, go add it with the calculated score.
-        //
+        LastError = GetLastError();
+        if (Entries[BestIndex].Directory != NULL &&
+            (LastError == ERROR_FILE_NOT_FOUND || LastError == ERROR_PATH_NOT_FOUND)) {
 
-        if (AddThisEntry) {
-            memcpy(&Entries[EntriesPopulated].DirectoryName, &StringToAdd, sizeof(YORI_STRING));
-            Entries[EntriesPopulated].Score = ScoreForThisEntry;
-            EntriesPopulated++;
+            ZAddRecord(&Entries[BestIndex].Directory->DirectoryName, 0);
+            Entries[BestIndex].Directory = NULL;
         }
-        if (Index > 0) {
-            Index--;
-        }
-    }
 
-    //
-    //  If we have no matches, then we can't find anything that the user
-    //  would be happy with, so do nothing.
-    //
-
-    if (EntriesPopulated == 0) {
-        YoriLibFree(Entries);
-        return FALSE;
+        Entries[BestIndex].Score = 0;
+        YoriLibFreeStringContents(BestMatch);
     }
 
     //
-    //  Find the highest score.
+    //  Free the scoreboard.
     //
 
-    BestScore = 0;
-    BestIndex = 0;
     for (Index = 0; Index < EntriesPopulated; Index++) {
-        if (BestScore == 0 || Entries[Index].Score > BestScore) {
-            BestScore = Entries[Index].Score;
-            BestIndex = Index;
-        }
-    }
-
-    //
-    //  Return the highest score match as a referenced string, and free
-    //  the scoreboard.  Perform a new allocation for this to ensure it's
-    //  NULL terminated at the correct point.
-    //
-
-    if (!YoriLibAllocateString(BestMatch, Entries[BestIndex].DirectoryName.LengthInChars + 1)) {
-        return FALSE;
+        YoriLibHashRemoveByEntry(&Entries[Index].HashEntry);
     }
-    memcpy(BestMatch->StartOfString, Entries[BestIndex].DirectoryName.StartOfString, Entries[BestIndex].DirectoryName.LengthInChars * sizeof(TCHAR));
-    BestMatch->LengthInChars = Entries[BestIndex].DirectoryName.LengthInChars;
-    BestMatch->StartOfString[BestMatch->LengthInChars] = '\0';
-
+    YoriLibFreeEmptyHashTable(EntryTable);
     YoriLibFree(Entries);
-    return TRUE;
+
+    return Found;
 }
 
 /**
@@ -698,8 +1896,11 @@ YoriCmd_Z(
         return EXIT_FAILURE;
     }
 
+    ZOpenStore();
+
     if (!ZBuildScoreboardAndSelectBest(UserSpecification, &FullyResolvedUserSpecification, &BestMatch)) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("z: could not determine appropriate directory\n"));
+        ZCloseStore();
         YoriLibFreeStringContents(&OldCurrentDirectory);
         YoriLibFreeStringContents(&FullyResolvedUserSpecification);
         return EXIT_FAILURE;
@@ -707,8 +1908,9 @@ YoriCmd_Z(
 
     YoriLibFreeStringContents(&FullyResolvedUserSpecification);
 
-    ZAddDirectoryToRecent(&OldCurrentDirectory);
-    ZAddDirectoryToRecent(&BestMatch);
+    ZAddRecord(&OldCurrentDirectory, 1);
+    ZAddRecord(&BestMatch, 1);
+    ZCloseStore();
 
     Result = SetCurrentDirectory(BestMatch.StartOfString);
     if (!Result) {
@@ -71,10 +71,10 @@ typedef struct _CAB_MATCH_ITEM {
     YORI_LIST_ENTRY MatchList;
 
     /**
-     A string describing the object to match, which may include
+     The compiled form of the object to match, which may include
      wildcards.
      */
-    YORI_STRING MatchCriteria;
+    YORI_LIB_FILE_MATCH_EXPRESSION MatchCriteria;
 } CAB_MATCH_ITEM, *PCAB_MATCH_ITEM;
 
 /**
@@ -140,18 +140,17 @@ CabCreateAddMatch(
     )
 {
     PCAB_MATCH_ITEM MatchItem;
-    MatchItem = YoriLibReferencedMalloc(sizeof(CAB_MATCH_ITEM) + (NewCriteria->LengthInChars + 1) * sizeof(TCHAR));
+    MatchItem = YoriLibReferencedMalloc(sizeof(CAB_MATCH_ITEM));
 
     if (MatchItem == NULL) {
         return FALSE;
     }
 
     ZeroMemory(MatchItem, sizeof(CAB_MATCH_ITEM));
-    MatchItem->MatchCriteria.StartOfString = (LPTSTR)(MatchItem + 1);
-    MatchItem->MatchCriteria.LengthInChars = NewCriteria->LengthInChars;
-    MatchItem->MatchCriteria.LengthAllocated = NewCriteria->LengthInChars + 1;
-    memcpy(MatchItem->MatchCriteria.StartOfString, NewCriteria->StartOfString, MatchItem->MatchCriteria.LengthInChars * sizeof(TCHAR));
-    MatchItem->MatchCriteria.StartOfString[MatchItem->MatchCriteria.LengthInChars] = '\0';
+    if (!YoriLibCompileFileMatchExpression(NewCriteria, &MatchItem->MatchCriteria)) {
+        YoriLibDereference(MatchItem);
+        return FALSE;
+    }
     YoriLibAppendList(List, &MatchItem->MatchList);
     return TRUE;
 }
@@ -174,6 +173,7 @@ CabCreateFreeMatchLists(
     while (ListEntry != NULL) {
         MatchItem = CONTAINING_RECORD(ListEntry, CAB_MATCH_ITEM, MatchList);
         YoriLibRemoveListItem(&MatchItem->MatchList);
+        YoriLibFreeFileMatchExpression(&MatchItem->MatchCriteria);
         YoriLibDereference(MatchItem);
         ListEntry = YoriLibGetNextListEntry(&CreateContext->ExcludeList, NULL);
     }
@@ -182,6 +182,7 @@ CabCreateFreeMatchLists(
     while (ListEntry != NULL) {
         MatchItem = CONTAINING_RECORD(ListEntry, CAB_MATCH_ITEM, MatchList);
         YoriLibRemoveListItem(&MatchItem->MatchList);
+        YoriLibFreeFileMatchExpression(&MatchItem->MatchCriteria);
         YoriLibDereference(MatchItem);
         ListEntry = YoriLibGetNextListEntry(&CreateContext->IncludeList, NULL);
     }
@@ -211,12 +212,12 @@ CabCreateShouldExclude(
     ListEntry = YoriLibGetNextListEntry(&CreateContext->ExcludeList, NULL);
     while (ListEntry != NULL) {
         MatchItem = CONTAINING_RECORD(ListEntry, CAB_MATCH_ITEM, MatchList);
-        if (YoriLibDoesFileMatchExpression(RelativePath, &MatchItem->MatchCriteria)) {
+        if (YoriLibDoesFileMatchCompiledExpression(RelativePath, &MatchItem->MatchCriteria)) {
 
             ListEntry = YoriLibGetNextListEntry(&CreateContext->IncludeList, NULL);
             while (ListEntry != NULL) {
                 MatchItem = CONTAINING_RECORD(ListEntry, CAB_MATCH_ITEM, MatchList);
-                if (YoriLibDoesFileMatchExpression(RelativePath, &MatchItem->MatchCriteria)) {
+                if (YoriLibDoesFileMatchCompiledExpression(RelativePath, &MatchItem->MatchCriteria)) {
                     return FALSE;
                 }
                 ListEntry = YoriLibGetNextListEntry(&CreateContext->IncludeList, ListEntry);
@@ -92,10 +92,10 @@ typedef struct _COPY_EXCLUDE_ITEM {
     YORI_LIST_ENTRY ExcludeList;
 
     /**
-     A string describing the object to exclude, which may include
+     The compiled form of the object to exclude, which may include
      wildcards.
      */
-    YORI_STRING ExcludeCriteria;
+    YORI_LIB_FILE_MATCH_EXPRESSION ExcludeCriteria;
 } COPY_EXCLUDE_ITEM, *PCOPY_EXCLUDE_ITEM;
 
 /**
@@ -108,6 +108,13 @@ typedef struct _COPY_CONTEXT {
      */
     YORI_STRING Dest;
 
+    /**
+     Information about Dest, when it is a directory, allowing the names of
+     each object to be resolved against it without reparsing it.  Only
+     meaningful if DestParentValid is TRUE.
+     */
+    YORI_LIB_FULL_PATH_PARENT DestParent;
+
     /**
      Files matching any of the exclude rules will not be copied.
      */
@@ -181,6 +188,11 @@ typedef struct _COPY_CONTEXT {
      */
     BOOLEAN DestinationIsDevice;
 
+    /**
+     If TRUE, DestParent has been initialized from Dest.
+     */
+    BOOLEAN DestParentValid;
+
     /**
      If TRUE, output is generated for each object copied.
      */
@@ -205,18 +217,17 @@ CopyAddExclude(
     )
 {
     PCOPY_EXCLUDE_ITEM ExcludeItem;
-    ExcludeItem = YoriLibReferencedMalloc(sizeof(COPY_EXCLUDE_ITEM) + (NewCriteria->LengthInChars + 1) * sizeof(TCHAR));
+    ExcludeItem = YoriLibReferencedMalloc(sizeof(COPY_EXCLUDE_ITEM));
 
     if (ExcludeItem == NULL) {
         return FALSE;
     }
 
     ZeroMemory(ExcludeItem, sizeof(COPY_EXCLUDE_ITEM));
-    ExcludeItem->ExcludeCriteria.StartOfString = (LPTSTR)(ExcludeItem + 1);
-    ExcludeItem->ExcludeCriteria.LengthInChars = NewCriteria->LengthInChars;
-    ExcludeItem->ExcludeCriteria.LengthAllocated = NewCriteria->LengthInChars + 1;
-    memcpy(ExcludeItem->ExcludeCriteria.StartOfString, NewCriteria->StartOfString, ExcludeItem->ExcludeCriteria.LengthInChars * sizeof(TCHAR));
-    ExcludeItem->ExcludeCriteria.StartOfString[ExcludeItem->ExcludeCriteria.LengthInChars] = '\0';
+    if (!YoriLibCompileFileMatchExpression(NewCriteria, &ExcludeItem->ExcludeCriteria)) {
+        YoriLibDereference(ExcludeItem);
+        return FALSE;
+    }
     YoriLibAppendList(&CopyContext->ExcludeList, &ExcludeItem->ExcludeList);
     return TRUE;
 }
@@ -239,6 +250,7 @@ CopyFreeExcludes(
     while (ListEntry != NULL) {
         ExcludeItem = CONTAINING_RECORD(ListEntry, COPY_EXCLUDE_ITEM, ExcludeList);
         YoriLibRemoveListItem(&ExcludeItem->ExcludeList);
+        YoriLibFreeFileMatchExpression(&ExcludeItem->ExcludeCriteria);
         YoriLibDereference(ExcludeItem);
         ListEntry = YoriLibGetNextListEntry(&CopyContext->ExcludeList, NULL);
     }
@@ -276,6 +288,20 @@ CopyBuildDestinationPath(
     if (CopyContext->DestAttributes & FILE_ATTRIBUTE_DIRECTORY) {
         YORI_STRING DestWithFile;
 
+        //
+        //  If the destination is already a full path, resolve the relative
+        //  path against it directly into the returned buffer.
+        //
+
+        if (CopyContext->DestParentValid) {
+            if (YoriLibAllocateString(FullDest, CopyContext->Dest.LengthInChars + 1 + RelativePathFromSource->LengthInChars + 1)) {
+                if (YoriLibFullPathResolveChild(&CopyContext->DestParent, RelativePathFromSource, FullDest, NULL)) {
+                    return TRUE;
+                }
+                YoriLibFreeStringContents(FullDest);
+            }
+        }
+
         if (!YoriLibAllocateString(&DestWithFile, CopyContext->Dest.LengthInChars + 1 + RelativePathFromSource->LengthInChars + 1)) {
             return FALSE;
         }
@@ -326,7 +352,7 @@ CopyShouldExclude(
     ListEntry = YoriLibGetNextListEntry(&CopyContext->ExcludeList, NULL);
     while (ListEntry != NULL) {
         ExcludeItem = CONTAINING_RECORD(ListEntry, COPY_EXCLUDE_ITEM, ExcludeList);
-        if (YoriLibDoesFileMatchExpression(RelativeSourcePath, &ExcludeItem->ExcludeCriteria)) {
+        if (YoriLibDoesFileMatchCompiledExpression(RelativeSourcePath, &ExcludeItem->ExcludeCriteria)) {
             return TRUE;
         }
         ListEntry = YoriLibGetNextListEntry(&CopyContext->ExcludeList, ListEntry);
@@ -565,9 +591,6 @@ CopyAsDumbDataMove(
     __in PYORI_STRING DestFile
     )
 {
-    PVOID Buffer;
-    DWORD BytesCopied;
-    DWORD BufferSize;
     HANDLE SourceHandle;
     HANDLE DestHandle;
     DWORD LastError;
@@ -617,32 +640,26 @@ CopyAsDumbDataMove(
         return FALSE;
     }
 
-    BufferSize = 64 * 1024;
-    Buffer = YoriLibMalloc(BufferSize);
-    if (Buffer == NULL) {
+    //
+    //  The size of a device can't be determined from its handle, so copy
+    //  until the source indicates there is no more data.
+    //
+
+    if (!YoriLibCopyRange(SourceHandle,
+                          YORI_LIB_COPY_RANGE_CURRENT_OFFSET,
+                          DestHandle,
+                          YORI_LIB_COPY_RANGE_CURRENT_OFFSET,
+                          YORI_LIB_COPY_RANGE_TO_END)) {
+
+        LastError = GetLastError();
+        ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Write to destination failed: %y: %s"), DestFile, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
         CloseHandle(SourceHandle);
         CloseHandle(DestHandle);
         return FALSE;
     }
 
-    while (ReadFile(SourceHandle, Buffer, BufferSize, &BytesCopied, NULL)) {
-        if (BytesCopied == 0) {
-            break;
-        }
-
-        if (!WriteFile(DestHandle, Buffer, BytesCopied, &BytesCopied, NULL)) {
-            LastError = GetLastError();
-            ErrText = YoriLibGetWinErrorText(LastError);
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Write to destination failed: %y: %s"), DestFile, ErrText);
-            YoriLibFreeWinErrorText(ErrText);
-            YoriLibFree(Buffer);
-            CloseHandle(SourceHandle);
-            CloseHandle(DestHandle);
-            return FALSE;
-        }
-    }
-
-    YoriLibFree(Buffer);
     CloseHandle(SourceHandle);
     CloseHandle(DestHandle);
     return TRUE;
@@ -1098,6 +1115,12 @@ ENTRYPOINT(
         }
     }
 
+    if ((CopyContext.DestAttributes & FILE_ATTRIBUTE_DIRECTORY) &&
+        YoriLibIsPathPrefixed(&CopyContext.Dest)) {
+
+        CopyContext.DestParentValid = YoriLibFullPathInitializeParent(&CopyContext.Dest, &CopyContext.DestParent);
+    }
+
     if (CopyContext.CompressDest) {
         if (!YoriLibInitializeCompressContext(&CopyContext.CompressContext, CompressionAlgorithm)) {
             CopyFreeCopyContext(&CopyContext);
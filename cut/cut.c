@@ -35,12 +35,12 @@ CHAR strCutHelpText[] =
         "\n"
         "Outputs a portion of an input buffer of text.\n"
         "\n"
-        "CUT [-license] [-b] [-s] [-f n] [-d <delimiter chars>] [-o n] [-l n] [file]\n"
+        "CUT [-license] [-b] [-s] [-f n[,n-m...]] [-d <delimiter chars>] [-o n] [-l n] [file]\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
         "   -o             The offset in bytes to cut from the line or field\n"
         "   -l             The length in bytes to cut from the line or field\n"
-        "   -f n           The field number to cut\n"
+        "   -f n[,n-m...]  The field numbers or ranges to cut, starting from zero\n"
         "   -d             The set of characters which delimit fields, default comma\n"
         "   -s             Match files from all subdirectories\n"
         ;
@@ -59,6 +59,39 @@ CutHelp()
     return TRUE;
 }
 
+/**
+ The size of the buffer used to read and write raw bytes when processing
+ input that does not require transcoding.
+ */
+#define CUT_BYTE_BUFFER_SIZE (64 * 1024)
+
+/**
+ A bit in the byte lookup table indicating that the byte delimits fields.
+ */
+#define CUT_BYTE_DELIMITER      0x01
+
+/**
+ A bit in the byte lookup table indicating that the byte terminates a line.
+ */
+#define CUT_BYTE_LINE_END       0x02
+
+/**
+ A range of fields to output.  Both values are inclusive.
+ */
+typedef struct _CUT_FIELD_RANGE {
+
+    /**
+     The first field in the range.
+     */
+    DWORD FirstField;
+
+    /**
+     The last field in the range.  (DWORD)-1 indicates the range continues
+     to the end of the line.
+     */
+    DWORD LastField;
+} CUT_FIELD_RANGE, *PCUT_FIELD_RANGE;
+
 /**
  Context describing the operations to perform on each file found.
  */
@@ -83,13 +116,45 @@ typedef struct _CUT_CONTEXT {
     LPTSTR FieldSeperator;
 
     /**
-     For a field delimited stream, indicates the field number that should
-     be output.
+     For a field delimited stream, an array of ranges indicating the fields
+     that should be output.
+     */
+    PCUT_FIELD_RANGE FieldRanges;
+
+    /**
+     The number of elements in the FieldRanges array.
+     */
+    DWORD FieldRangeCount;
+
+    /**
+     The highest field number that can be output.  Once this field has been
+     processed, the remainder of the line can be skipped.
      */
-    DWORD FieldOfInterest;
+    DWORD LastFieldOfInterest;
 
     /**
-     Indicates the offset of the line or field, in bytes, that is of interest.
+     TRUE if the input can be processed as raw bytes without transcoding.
+     This is possible when the input and output encodings match, the
+     encoding is UTF-8 or uses a single byte per character, all delimiters
+     are ASCII, and output is not going to a console.
+     */
+    BOOL ByteMode;
+
+    /**
+     TRUE if byte mode processing is operating on UTF-8, where a character
+     may occupy more than one byte.  Offsets and lengths are specified in
+     characters, so must be translated to bytes.
+     */
+    BOOL ByteModeUtf8;
+
+    /**
+     For byte mode processing, a table indicating for each byte value
+     whether it delimits a field or terminates a line.
+     */
+    UCHAR ByteTable[256];
+
+    /**
+     Indicates the offset of the line or field, in characters, that is of interest.
      */
     DWORD DesiredOffset;
 
@@ -111,9 +176,397 @@ typedef struct _CUT_CONTEXT {
 
 } CUT_CONTEXT, *PCUT_CONTEXT;
 
+/**
+ Add a range of fields to the set of fields to output.
+
+ @param CutContext The context to add the range to.
+
+ @param Range The range of fields to add.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+CutAddFieldRange(
+    __inout PCUT_CONTEXT CutContext,
+    __in PCUT_FIELD_RANGE Range
+    )
+{
+    PCUT_FIELD_RANGE NewRanges;
+
+    NewRanges = YoriLibMalloc((CutContext->FieldRangeCount + 1) * sizeof(CUT_FIELD_RANGE));
+    if (NewRanges == NULL) {
+        return FALSE;
+    }
+
+    if (CutContext->FieldRangeCount > 0) {
+        memcpy(NewRanges, CutContext->FieldRanges, CutContext->FieldRangeCount * sizeof(CUT_FIELD_RANGE));
+        YoriLibFree(CutContext->FieldRanges);
+    }
+
+    NewRanges[CutContext->FieldRangeCount].FirstField = Range->FirstField;
+    NewRanges[CutContext->FieldRangeCount].LastField = Range->LastField;
+    CutContext->FieldRanges = NewRanges;
+    CutContext->FieldRangeCount++;
+
+    if (Range->LastField > CutContext->LastFieldOfInterest) {
+        CutContext->LastFieldOfInterest = Range->LastField;
+    }
+
+    return TRUE;
+}
+
+/**
+ Parse a list of fields specified by the user, such as "1,3,7-9" or "4-",
+ and add each of them to the set of fields to output.
+
+ @param CutContext The context to add the fields to.
+
+ @param FieldList The string specified by the user.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+CutParseFieldList(
+    __inout PCUT_CONTEXT CutContext,
+    __in PYORI_STRING FieldList
+    )
+{
+    YORI_STRING Remaining;
+    CUT_FIELD_RANGE Range;
+    LONGLONG Temp;
+    DWORD CharsConsumed;
+
+    YoriLibInitEmptyString(&Remaining);
+    Remaining.StartOfString = FieldList->StartOfString;
+    Remaining.LengthInChars = FieldList->LengthInChars;
+
+    while (TRUE) {
+
+        //
+        //  Each element must start with a number.  Check for the digit
+        //  explicitly since the number parser would otherwise treat the
+        //  range seperator as a negative sign.
+        //
+
+        if (Remaining.LengthInChars == 0 ||
+            Remaining.StartOfString[0] < '0' ||
+            Remaining.StartOfString[0] > '9') {
+
+            return FALSE;
+        }
+
+        if (!YoriLibStringToNumber(&Remaining, FALSE, &Temp, &CharsConsumed) ||
+            CharsConsumed == 0) {
+
+            return FALSE;
+        }
+
+        Range.FirstField = (DWORD)Temp;
+        Range.LastField = Range.FirstField;
+        Remaining.StartOfString += CharsConsumed;
+        Remaining.LengthInChars -= CharsConsumed;
+
+        if (Remaining.LengthInChars > 0 && Remaining.StartOfString[0] == '-') {
+            Remaining.StartOfString++;
+            Remaining.LengthInChars--;
+
+            if (Remaining.LengthInChars == 0 ||
+                Remaining.StartOfString[0] == ',') {
+
+                Range.LastField = (DWORD)-1;
+            } else {
+                if (Remaining.StartOfString[0] < '0' ||
+                    Remaining.StartOfString[0] > '9') {
+
+                    return FALSE;
+                }
+
+                if (!YoriLibStringToNumber(&Remaining, FALSE, &Temp, &CharsConsumed) ||
+                    CharsConsumed == 0) {
+
+                    return FALSE;
+                }
+
+                Range.LastField = (DWORD)Temp;
+                Remaining.StartOfString += CharsConsumed;
+                Remaining.LengthInChars -= CharsConsumed;
+
+                if (Range.LastField < Range.FirstField) {
+                    return FALSE;
+                }
+            }
+        }
+
+        if (!CutAddFieldRange(CutContext, &Range)) {
+            return FALSE;
+        }
+
+        if (Remaining.LengthInChars == 0) {
+            break;
+        }
+
+        if (Remaining.StartOfString[0] != ',') {
+            return FALSE;
+        }
+
+        Remaining.StartOfString++;
+        Remaining.LengthInChars--;
+    }
+
+    return TRUE;
+}
+
+/**
+ Free any allocations within the cut context.
+
+ @param CutContext The context to free.
+ */
+VOID
+CutFreeContext(
+    __in PCUT_CONTEXT CutContext
+    )
+{
+    if (CutContext->FieldRanges != NULL) {
+        YoriLibFree(CutContext->FieldRanges);
+        CutContext->FieldRanges = NULL;
+    }
+    CutContext->FieldRangeCount = 0;
+}
+
+/**
+ Determine whether input can be processed as raw bytes, and if so, build the
+ table used to locate delimiters and line endings.
+
+ @param CutContext The context to update.
+ */
+VOID
+CutPrepareByteMode(
+    __inout PCUT_CONTEXT CutContext
+    )
+{
+    DWORD Encoding;
+    DWORD ConsoleMode;
+    DWORD Index;
+    CPINFO CpInfo;
+
+    CutContext->ByteMode = FALSE;
+    CutContext->ByteModeUtf8 = FALSE;
+
+    //
+    //  If output is going to the console, let the output routines
+    //  translate it.
+    //
+
+    if (GetConsoleMode(GetStdHandle(STD_OUTPUT_HANDLE), &ConsoleMode)) {
+        return;
+    }
+
+    Encoding = YoriLibGetMultibyteInputEncoding();
+    if (Encoding != YoriLibGetMultibyteOutputEncoding() ||
+        Encoding == CP_UTF16) {
+
+        return;
+    }
+
+    if (Encoding != CP_UTF8) {
+        if (!GetCPInfo(Encoding, &CpInfo) || CpInfo.MaxCharSize != 1) {
+            return;
+        }
+    }
+
+    //
+    //  UTF-8 never uses bytes below 0x80 within a multibyte sequence, so
+    //  ASCII delimiters can be found without decoding.
+    //
+
+    ZeroMemory(CutContext->ByteTable, sizeof(CutContext->ByteTable));
+    for (Index = 0; CutContext->FieldSeperator[Index] != '\0'; Index++) {
+        if (CutContext->FieldSeperator[Index] >= 0x80) {
+            return;
+        }
+        CutContext->ByteTable[CutContext->FieldSeperator[Index]] |= CUT_BYTE_DELIMITER;
+    }
+
+    CutContext->ByteTable['\r'] |= CUT_BYTE_LINE_END;
+    CutContext->ByteTable['\n'] |= CUT_BYTE_LINE_END;
+    CutContext->ByteMode = TRUE;
+    if (Encoding == CP_UTF8) {
+        CutContext->ByteModeUtf8 = TRUE;
+    }
+}
+
+/**
+ Return TRUE if the specified field should be output.
+
+ @param CutContext The context describing the fields to output.
+
+ @param FieldIndex The field number, starting from zero.
+
+ @return TRUE if the field should be output, FALSE if not.
+ */
+BOOL
+CutIsFieldSelected(
+    __in PCUT_CONTEXT CutContext,
+    __in DWORD FieldIndex
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < CutContext->FieldRangeCount; Index++) {
+        if (FieldIndex >= CutContext->FieldRanges[Index].FirstField &&
+            FieldIndex <= CutContext->FieldRanges[Index].LastField) {
+
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Apply the user's requested offset and length to a line or field.
+
+ @param CutContext The context describing the offset and length.
+
+ @param Length The length of the line or field.
+
+ @param Offset On completion, updated to contain the offset within the line
+        or field to output.
+
+ @param SubsetLength On completion, updated to contain the number of
+        characters to output.  This can be zero.
+ */
+VOID
+CutApplyOffsetAndLength(
+    __in PCUT_CONTEXT CutContext,
+    __in DWORD Length,
+    __out PDWORD Offset,
+    __out PDWORD SubsetLength
+    )
+{
+    *Offset = 0;
+    *SubsetLength = 0;
+
+    if (Length > CutContext->DesiredOffset) {
+        *Offset = CutContext->DesiredOffset;
+        *SubsetLength = Length - CutContext->DesiredOffset;
+
+        if (CutContext->DesiredLength != 0 &&
+            *SubsetLength > CutContext->DesiredLength) {
+
+            *SubsetLength = CutContext->DesiredLength;
+        }
+    }
+}
+
+/**
+ Find the byte offset within UTF-8 data that follows a number of
+ characters.  Characters are counted the same way as when the data is
+ converted to the native encoding, so a character outside the basic
+ multilingual plane counts as two.
+
+ @param Data Pointer to the UTF-8 data.
+
+ @param Length The number of bytes in the data.
+
+ @param Start The byte offset to start counting from.
+
+ @param CharCount The number of characters to skip.
+
+ @return The byte offset after the characters, or Length if the data
+         contains fewer characters.
+ */
+DWORD
+CutSkipUtf8Chars(
+    __in PUCHAR Data,
+    __in DWORD Length,
+    __in DWORD Start,
+    __in DWORD CharCount
+    )
+{
+    DWORD Index;
+    DWORD CharsFound;
+
+    Index = Start;
+    CharsFound = 0;
+    while (Index < Length && CharsFound < CharCount) {
+        if (Data[Index] >= 0xF0) {
+            CharsFound += 2;
+        } else if ((Data[Index] & 0xC0) != 0x80) {
+            CharsFound++;
+        }
+        Index++;
+
+        //
+        //  Skip the continuation bytes of the character.
+        //
+
+        while (Index < Length && (Data[Index] & 0xC0) == 0x80) {
+            Index++;
+        }
+    }
+
+    return Index;
+}
+
+/**
+ Apply the user's requested offset and length to a line or field of raw
+ bytes.  The offset and length are in characters, so for UTF-8 they are
+ translated to bytes, allowing the result to be the same as if the line had
+ been converted to the native encoding.
+
+ @param CutContext The context describing the offset and length.
+
+ @param Data Pointer to the bytes in the line or field.
+
+ @param Length The number of bytes in the line or field.
+
+ @param Offset On completion, updated to contain the offset within the line
+        or field to output, in bytes.
+
+ @param SubsetLength On completion, updated to contain the number of bytes
+        to output.  This can be zero.
+ */
+VOID
+CutApplyOffsetAndLengthToBytes(
+    __in PCUT_CONTEXT CutContext,
+    __in PUCHAR Data,
+    __in DWORD Length,
+    __out PDWORD Offset,
+    __out PDWORD SubsetLength
+    )
+{
+    DWORD End;
+
+    if (!CutContext->ByteModeUtf8) {
+        CutApplyOffsetAndLength(CutContext, Length, Offset, SubsetLength);
+        return;
+    }
+
+    *Offset = 0;
+    *SubsetLength = 0;
+
+    if (CutContext->DesiredOffset == 0 && CutContext->DesiredLength == 0) {
+        *SubsetLength = Length;
+        return;
+    }
+
+    End = CutSkipUtf8Chars(Data, Length, 0, CutContext->DesiredOffset);
+    if (End < Length) {
+        *Offset = End;
+        if (CutContext->DesiredLength != 0) {
+            End = CutSkipUtf8Chars(Data, Length, *Offset, CutContext->DesiredLength);
+        } else {
+            End = Length;
+        }
+        *SubsetLength = End - *Offset;
+    }
+}
+
 /**
  Process an incoming stream from a single handle, applying the user requested
- actions.
+ actions, by converting each line into a string in the native character
+ encoding.
 
  @param hSource The source handle containing data to process.
 
@@ -122,68 +575,477 @@ typedef struct _CUT_CONTEXT {
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
-CutFilterHandle(
+CutFilterHandleChars(
     __in HANDLE hSource,
     __in PCUT_CONTEXT CutContext
     )
 {
-    YORI_STRING MatchingSubset;
     PVOID LineContext = NULL;
     YORI_STRING LineString;
+    YORI_STRING MatchingSubset;
+    YORI_STRING OutputLine;
+    YORI_STRING Field;
+    DWORD Offset;
+    DWORD SubsetLength;
+    DWORD Remaining;
+    DWORD FieldIndex;
+    DWORD SelectedFields;
+    DWORD PendingSeperators;
+    BOOL Result = TRUE;
 
     YoriLibInitEmptyString(&LineString);
+    YoriLibInitEmptyString(&OutputLine);
 
     while (TRUE) {
         if (!YoriLibReadLineToString(&LineString, &LineContext, hSource)) {
             break;
         }
 
-        YoriLibInitEmptyString(&MatchingSubset);
+        if (!CutContext->FieldDelimited) {
+            CutApplyOffsetAndLength(CutContext, LineString.LengthInChars, &Offset, &SubsetLength);
+            if (SubsetLength > 0) {
+                YoriLibInitEmptyString(&MatchingSubset);
+                MatchingSubset.StartOfString = &LineString.StartOfString[Offset];
+                MatchingSubset.LengthInChars = SubsetLength;
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &MatchingSubset);
+            }
+            continue;
+        }
+
+        //
+        //  The output contains at most every character in the line plus a
+        //  seperator for every field.
+        //
+
+        if (OutputLine.LengthAllocated < LineString.LengthInChars * 2 + 1) {
+            YoriLibFreeStringContents(&OutputLine);
+            if (!YoriLibAllocateString(&OutputLine, LineString.LengthInChars * 2 + 1)) {
+                Result = FALSE;
+                break;
+            }
+        }
+        OutputLine.LengthInChars = 0;
+
+        //
+        //  Seperators between selected fields are only written once a later
+        //  selected field has contents, so a line with no selected contents
+        //  is suppressed as it was when only one field could be selected.
+        //
+
+        YoriLibInitEmptyString(&Field);
+        Field.StartOfString = LineString.StartOfString;
+        Field.LengthInChars = LineString.LengthInChars;
+        FieldIndex = 0;
+        SelectedFields = 0;
+        PendingSeperators = 0;
+        while (TRUE) {
+            Remaining = Field.LengthInChars;
+            Field.LengthInChars = YoriLibCountStringNotContainingChars(&Field, CutContext->FieldSeperator);
+
+            if (CutIsFieldSelected(CutContext, FieldIndex)) {
+                if (SelectedFields > 0) {
+                    PendingSeperators++;
+                }
+                SelectedFields++;
+                CutApplyOffsetAndLength(CutContext, Field.LengthInChars, &Offset, &SubsetLength);
+                if (SubsetLength > 0) {
+                    for (; PendingSeperators > 0; PendingSeperators--) {
+                        OutputLine.StartOfString[OutputLine.LengthInChars] = CutContext->FieldSeperator[0];
+                        OutputLine.LengthInChars++;
+                    }
+                    memcpy(&OutputLine.StartOfString[OutputLine.LengthInChars],
+                           &Field.StartOfString[Offset],
+                           SubsetLength * sizeof(TCHAR));
+                    OutputLine.LengthInChars += SubsetLength;
+                }
+            }
+
+            if (Field.LengthInChars == Remaining ||
+                FieldIndex >= CutContext->LastFieldOfInterest) {
+
+                break;
+            }
+
+            Field.StartOfString = &Field.StartOfString[Field.LengthInChars + 1];
+            Field.LengthInChars = Remaining - Field.LengthInChars - 1;
+            FieldIndex++;
+        }
+
+        if (OutputLine.LengthInChars > 0) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &OutputLine);
+        }
+    }
+
+    YoriLibLineReadClose(LineContext);
+    YoriLibFreeStringContents(&LineString);
+    YoriLibFreeStringContents(&OutputLine);
+
+    return Result;
+}
 
-        MatchingSubset.StartOfString = LineString.StartOfString;
-        MatchingSubset.LengthInChars = LineString.LengthInChars;
+/**
+ A buffer of bytes waiting to be written to standard output.
+ */
+typedef struct _CUT_BYTE_OUTPUT {
 
-        if (CutContext->FieldDelimited) {
-            DWORD CurrentField = 0;
+    /**
+     Handle to standard output.
+     */
+    HANDLE hTarget;
 
-            for (CurrentField = 0; CurrentField <= CutContext->FieldOfInterest; CurrentField++) {
-                DWORD CharsBeforeSeperator;
+    /**
+     The buffer of bytes to write.
+     */
+    PUCHAR Buffer;
 
-                CharsBeforeSeperator = YoriLibCountStringNotContainingChars(&MatchingSubset, CutContext->FieldSeperator);
-                if (CurrentField == CutContext->FieldOfInterest) {
-                    MatchingSubset.LengthInChars = CharsBeforeSeperator;
-                } else {
-                    MatchingSubset.LengthInChars -= CharsBeforeSeperator;
-                    if (MatchingSubset.LengthInChars == 0) {
-                        break;
+    /**
+     The number of bytes in the buffer that have not yet been written.
+     */
+    DWORD BytesInBuffer;
+
+    /**
+     Set to TRUE if a write has failed, indicating no further output can be
+     written.
+     */
+    BOOL WriteFailed;
+} CUT_BYTE_OUTPUT, *PCUT_BYTE_OUTPUT;
+
+/**
+ Write any buffered bytes to standard output.
+
+ @param Output The output buffer to flush.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+CutFlushBytes(
+    __inout PCUT_BYTE_OUTPUT Output
+    )
+{
+    DWORD BytesWritten;
+    DWORD Offset;
+
+    Offset = 0;
+    while (Offset < Output->BytesInBuffer && !Output->WriteFailed) {
+        if (!WriteFile(Output->hTarget, &Output->Buffer[Offset], Output->BytesInBuffer - Offset, &BytesWritten, NULL) ||
+            BytesWritten == 0) {
+
+            Output->WriteFailed = TRUE;
+        }
+        Offset += BytesWritten;
+    }
+
+    Output->BytesInBuffer = 0;
+    return !Output->WriteFailed;
+}
+
+/**
+ Append bytes to the output buffer, writing the buffer to standard output if
+ it becomes full.
+
+ @param Output The output buffer to append to.
+
+ @param Data Pointer to the bytes to append.
+
+ @param Length The number of bytes to append.
+ */
+VOID
+CutAppendBytes(
+    __inout PCUT_BYTE_OUTPUT Output,
+    __in PUCHAR Data,
+    __in DWORD Length
+    )
+{
+    DWORD BytesThisPass;
+
+    while (Length > 0 && !Output->WriteFailed) {
+        if (Output->BytesInBuffer == CUT_BYTE_BUFFER_SIZE) {
+            CutFlushBytes(Output);
+        }
+
+        BytesThisPass = CUT_BYTE_BUFFER_SIZE - Output->BytesInBuffer;
+        if (BytesThisPass > Length) {
+            BytesThisPass = Length;
+        }
+
+        memcpy(&Output->Buffer[Output->BytesInBuffer], Data, BytesThisPass);
+        Output->BytesInBuffer += BytesThisPass;
+        Data += BytesThisPass;
+        Length -= BytesThisPass;
+    }
+}
+
+/**
+ Process a single line of raw bytes, appending the requested subset of the
+ line to the output buffer.
+
+ @param CutContext The context that describes the actions to perform.
+
+ @param Line Pointer to the bytes in the line, excluding the line ending.
+
+ @param Length The number of bytes in the line.
+
+ @param Output The output buffer to append to.
+ */
+VOID
+CutProcessByteLine(
+    __in PCUT_CONTEXT CutContext,
+    __in PUCHAR Line,
+    __in DWORD Length,
+    __inout PCUT_BYTE_OUTPUT Output
+    )
+{
+    DWORD Offset;
+    DWORD SubsetLength;
+    DWORD Index;
+    DWORD FieldStart;
+    DWORD FieldIndex;
+    DWORD SelectedFields;
+    DWORD PendingSeperators;
+    UCHAR Seperator;
+    BOOL ContentFound;
+
+    ContentFound = FALSE;
+    if (!CutContext->FieldDelimited) {
+        CutApplyOffsetAndLengthToBytes(CutContext, Line, Length, &Offset, &SubsetLength);
+        if (SubsetLength > 0) {
+            CutAppendBytes(Output, &Line[Offset], SubsetLength);
+            ContentFound = TRUE;
+        }
+    } else {
+        Seperator = (UCHAR)CutContext->FieldSeperator[0];
+        FieldIndex = 0;
+        FieldStart = 0;
+        SelectedFields = 0;
+        PendingSeperators = 0;
+        Index = 0;
+        while (TRUE) {
+
+            //
+            //  Skip over everything that isn't a delimiter with a single
+            //  table lookup per byte.
+            //
+
+            while (Index < Length &&
+                   (CutContext->ByteTable[Line[Index]] & CUT_BYTE_DELIMITER) == 0) {
+                Index++;
+            }
+
+            if (CutIsFieldSelected(CutContext, FieldIndex)) {
+                if (SelectedFields > 0) {
+                    PendingSeperators++;
+                }
+                SelectedFields++;
+                CutApplyOffsetAndLengthToBytes(CutContext, &Line[FieldStart], Index - FieldStart, &Offset, &SubsetLength);
+                if (SubsetLength > 0) {
+                    for (; PendingSeperators > 0; PendingSeperators--) {
+                        CutAppendBytes(Output, &Seperator, 1);
                     }
-                    MatchingSubset.LengthInChars -= 1;
-                    MatchingSubset.StartOfString = &MatchingSubset.StartOfString[CharsBeforeSeperator + 1];
+                    CutAppendBytes(Output, &Line[FieldStart + Offset], SubsetLength);
+                    ContentFound = TRUE;
                 }
             }
+
+            if (Index == Length ||
+                FieldIndex >= CutContext->LastFieldOfInterest) {
+
+                break;
+            }
+
+            Index++;
+            FieldIndex++;
+            FieldStart = Index;
+        }
+    }
+
+    if (ContentFound) {
+        CutAppendBytes(Output, (PUCHAR)"\r\n", 2);
+    }
+}
+
+/**
+ Process an incoming stream from a single handle, applying the user requested
+ actions, by operating on the raw bytes of the stream without transcoding.
+ This can only be used if CutPrepareByteMode has indicated that the input
+ and output encodings allow it.
+
+ @param hSource The source handle containing data to process.
+
+ @param CutContext The context that describes the actions to perform.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+CutFilterHandleBytes(
+    __in HANDLE hSource,
+    __in PCUT_CONTEXT CutContext
+    )
+{
+    CUT_BYTE_OUTPUT Output;
+    PUCHAR ReadBuffer;
+    PUCHAR NewBuffer;
+    DWORD ReadBufferSize;
+    DWORD BytesInBuffer;
+    DWORD BytesRead;
+    DWORD LineStart;
+    DWORD Index;
+    BOOL EndOfStream;
+    BOOL BomChecked;
+    BOOL SkipLineFeed;
+
+    ReadBufferSize = CUT_BYTE_BUFFER_SIZE;
+    ReadBuffer = YoriLibMalloc(ReadBufferSize);
+    if (ReadBuffer == NULL) {
+        return FALSE;
+    }
+
+    ZeroMemory(&Output, sizeof(Output));
+    Output.hTarget = GetStdHandle(STD_OUTPUT_HANDLE);
+    Output.Buffer = YoriLibMalloc(CUT_BYTE_BUFFER_SIZE);
+    if (Output.Buffer == NULL) {
+        YoriLibFree(ReadBuffer);
+        return FALSE;
+    }
+
+    BytesInBuffer = 0;
+    Index = 0;
+    EndOfStream = FALSE;
+    BomChecked = FALSE;
+    SkipLineFeed = FALSE;
+
+    while (!EndOfStream && !Output.WriteFailed) {
+
+        //
+        //  If a single line fills the buffer, grow the buffer so the line
+        //  can be processed in one piece.
+        //
+
+        if (BytesInBuffer == ReadBufferSize) {
+            NewBuffer = YoriLibMalloc(ReadBufferSize * 2);
+            if (NewBuffer == NULL) {
+                break;
+            }
+            memcpy(NewBuffer, ReadBuffer, BytesInBuffer);
+            YoriLibFree(ReadBuffer);
+            ReadBuffer = NewBuffer;
+            ReadBufferSize = ReadBufferSize * 2;
+        }
+
+        if (!ReadFile(hSource, &ReadBuffer[BytesInBuffer], ReadBufferSize - BytesInBuffer, &BytesRead, NULL) ||
+            BytesRead == 0) {
+
+            EndOfStream = TRUE;
+            BytesRead = 0;
         }
-        if (MatchingSubset.LengthInChars > CutContext->DesiredOffset) {
-            MatchingSubset.StartOfString = &MatchingSubset.StartOfString[CutContext->DesiredOffset];
-            MatchingSubset.LengthInChars = MatchingSubset.LengthInChars - CutContext->DesiredOffset;
+        BytesInBuffer += BytesRead;
+        LineStart = 0;
 
-            if (CutContext->DesiredLength != 0 &&
-                MatchingSubset.LengthInChars > CutContext->DesiredLength) {
+        //
+        //  Wait until enough bytes have arrived to tell whether the stream
+        //  starts with a UTF-8 byte order mark.
+        //
 
-                MatchingSubset.LengthInChars = CutContext->DesiredLength;
+        if (!BomChecked) {
+            if (BytesInBuffer < 3 && !EndOfStream) {
+                continue;
+            }
+            BomChecked = TRUE;
+            if (BytesInBuffer >= 3 &&
+                ReadBuffer[0] == 0xEF &&
+                ReadBuffer[1] == 0xBB &&
+                ReadBuffer[2] == 0xBF) {
+
+                LineStart = 3;
+                Index = 3;
             }
-        } else {
-            MatchingSubset.LengthInChars = 0;
         }
 
-        if (MatchingSubset.LengthInChars > 0) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &MatchingSubset);
+        //
+        //  If the previous buffer ended in a carriage return, a line feed at
+        //  the start of this buffer belongs to the same line ending.
+        //
+
+        if (SkipLineFeed && BytesInBuffer > 0) {
+            SkipLineFeed = FALSE;
+            if (ReadBuffer[0] == '\n') {
+                LineStart = 1;
+                Index = 1;
+            }
         }
+
+        while (TRUE) {
+            while (Index < BytesInBuffer &&
+                   (CutContext->ByteTable[ReadBuffer[Index]] & CUT_BYTE_LINE_END) == 0) {
+                Index++;
+            }
+
+            if (Index == BytesInBuffer) {
+                break;
+            }
+
+            CutProcessByteLine(CutContext, &ReadBuffer[LineStart], Index - LineStart, &Output);
+
+            if (ReadBuffer[Index] == '\r') {
+                if (Index + 1 < BytesInBuffer) {
+                    if (ReadBuffer[Index + 1] == '\n') {
+                        Index++;
+                    }
+                } else {
+                    SkipLineFeed = TRUE;
+                }
+            }
+            Index++;
+            LineStart = Index;
+        }
+
+        if (EndOfStream) {
+            if (LineStart < BytesInBuffer) {
+                CutProcessByteLine(CutContext, &ReadBuffer[LineStart], BytesInBuffer - LineStart, &Output);
+            }
+            break;
+        }
+
+        //
+        //  Move any partial line to the front of the buffer.  The bytes in
+        //  it have already been scanned, so resume scanning after them.
+        //
+
+        if (LineStart > 0) {
+            memmove(ReadBuffer, &ReadBuffer[LineStart], BytesInBuffer - LineStart);
+            BytesInBuffer -= LineStart;
+        }
+        Index = BytesInBuffer;
     }
 
-    YoriLibLineReadClose(LineContext);
-    YoriLibFreeStringContents(&LineString);
+    CutFlushBytes(&Output);
 
-    return TRUE;
+    YoriLibFree(Output.Buffer);
+    YoriLibFree(ReadBuffer);
+
+    return !Output.WriteFailed;
+}
+
+/**
+ Process an incoming stream from a single handle, applying the user requested
+ actions.
+
+ @param hSource The source handle containing data to process.
+
+ @param CutContext The context that describes the actions to perform.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+CutFilterHandle(
+    __in HANDLE hSource,
+    __in PCUT_CONTEXT CutContext
+    )
+{
+    if (CutContext->ByteMode) {
+        return CutFilterHandleBytes(hSource, CutContext);
+    }
+
+    return CutFilterHandleChars(hSource, CutContext);
 }
 
 /**
@@ -350,9 +1212,11 @@ ENTRYPOINT(
 
             if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("?")) == 0) {
                 CutHelp();
+                CutFreeContext(&CutContext);
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("license")) == 0) {
                 YoriLibDisplayMitLicense(_T("2017-2019"));
+                CutFreeContext(&CutContext);
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("b")) == 0) {
                 BasicEnumeration = TRUE;
@@ -375,9 +1239,8 @@ ENTRYPOINT(
                 }
             } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("f")) == 0) {
                 if (ArgC > i + 1) {
-                    if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &Temp, &CharsConsumed)) {
+                    if (CutParseFieldList(&CutContext, &ArgV[i + 1])) {
                         CutContext.FieldDelimited = TRUE;
-                        CutContext.FieldOfInterest = (DWORD)Temp;
                         ArgumentUnderstood = TRUE;
                         i++;
                     }
@@ -411,6 +1274,17 @@ ENTRYPOINT(
         CutContext.FieldSeperator = _T(",");
     }
 
+    if (CutContext.FieldDelimited && CutContext.FieldRangeCount == 0) {
+        CUT_FIELD_RANGE FirstFieldOnly;
+        FirstFieldOnly.FirstField = 0;
+        FirstFieldOnly.LastField = 0;
+        if (!CutAddFieldRange(&CutContext, &FirstFieldOnly)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    CutPrepareByteMode(&CutContext);
+
 #if YORI_BUILTIN
     YoriLibCancelEnable();
 #endif
@@ -421,7 +1295,10 @@ ENTRYPOINT(
             return EXIT_FAILURE;
         }
         hSource = GetStdHandle(STD_INPUT_HANDLE);
-        CutFilterHandle(hSource, &CutContext);
+        if (!CutFilterHandle(hSource, &CutContext)) {
+            CutFreeContext(&CutContext);
+            return EXIT_FAILURE;
+        }
     } else {
         DWORD MatchFlags = YORILIB_FILEENUM_RETURN_FILES;
         if (CutContext.Recursive) {
@@ -454,9 +1331,11 @@ ENTRYPOINT(
 
         if (CutContext.FilesFound == 0) {
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("cut: no matching files found\n"));
+            CutFreeContext(&CutContext);
             return EXIT_FAILURE;
         }
     }
+    CutFreeContext(&CutContext);
     return EXIT_SUCCESS;
 }
 
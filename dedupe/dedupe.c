@@ -0,0 +1,1188 @@
+/**
+ * @file dedupe/dedupe.c
+ *
+ * Yori find files with duplicate contents
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "dedupe.h"
+
+/**
+ Help text to display to the user.
+ */
+const
+CHAR strDedupeHelpText[] =
+        "\n"
+        "Find files with identical contents.\n"
+        "\n"
+        "DEDUPE [-license] [-a <algorithm>] [-b] [-l] [-s] <file>...\n"
+        "\n"
+        "   -a <algorithm> Specify the hash algorithm. Supported algorithms:\n"
+        "                    MD5, SHA1, SHA256, SHA384, or SHA512.  MD5 and\n"
+        "                    SHA1 cannot be used with -l\n"
+        "   -b             Use basic search criteria for files only\n"
+        "   -l             Replace duplicates with hard links to a single copy\n"
+        "                    after comparing their contents.  Linked files\n"
+        "                    share the attributes and timestamps of that copy\n"
+        "   -s             Search files in subdirectories\n";
+
+/**
+ Display usage text to the user.
+ */
+BOOL
+DedupeHelp()
+{
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Dedupe %i.%02i\n"), DEDUPE_VER_MAJOR, DEDUPE_VER_MINOR);
+#if YORI_BUILD_ID
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Build %i\n"), YORI_BUILD_ID);
+#endif
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%hs"), strDedupeHelpText);
+    return TRUE;
+}
+
+/**
+ The number of bytes at the start of each file to hash when looking for
+ candidate duplicates.  Only files whose leading bytes match are hashed in
+ full.
+ */
+#define DEDUPE_PARTIAL_LENGTH (64 * 1024)
+
+/**
+ The number of bytes to read at a time when hashing an entire file.
+ */
+#define DEDUPE_READ_BUFFER_LENGTH (1024 * 1024)
+
+/**
+ The maximum number of threads to use when hashing files.
+ */
+#define DEDUPE_MAX_THREADS 16
+
+/**
+ Context passed to the callback which is invoked for each file found.
+ */
+typedef struct _DEDUPE_CONTEXT {
+
+    /**
+     TRUE if file enumeration is being performed recursively; FALSE if it is
+     in one directory only.
+     */
+    BOOL Recursive;
+
+    /**
+     TRUE if duplicates should be replaced with hard links.
+     */
+    BOOL CreateLinks;
+
+    /**
+     The hash algorithm provider.
+     */
+    YORI_LIB_FILE_HASH_ALGORITHM Algorithm;
+
+    /**
+     An array of every file found.
+     */
+    PDEDUPE_FILE *Files;
+
+    /**
+     The number of elements in the Files array.
+     */
+    DWORD FileCount;
+
+    /**
+     The number of elements allocated in the Files array.
+     */
+    DWORD FilesAllocated;
+
+    /**
+     Records the total number of files processed within a single command line
+     argument.
+     */
+    LONGLONG FilesFoundThisArg;
+
+    /**
+     The number of sets of files with identical contents.
+     */
+    DWORD DuplicateSets;
+
+    /**
+     The number of files which are duplicates of another file.
+     */
+    DWORD DuplicateFiles;
+
+    /**
+     The number of bytes used by duplicate copies of data.
+     */
+    DWORDLONG WastedBytes;
+
+    /**
+     The number of bytes freed by replacing duplicates with hard links.
+     */
+    DWORDLONG ReclaimedBytes;
+
+} DEDUPE_CONTEXT, *PDEDUPE_CONTEXT;
+
+/**
+ A set of files to hash, which is shared between worker threads.
+ */
+typedef struct _DEDUPE_HASH_JOB {
+
+    /**
+     Pointer to the dedupe context.
+     */
+    PDEDUPE_CONTEXT DedupeContext;
+
+    /**
+     The array of files to hash.
+     */
+    PDEDUPE_FILE *Files;
+
+    /**
+     The number of elements in the Files array.
+     */
+    DWORD Count;
+
+    /**
+     The index of the next file to hash.
+     */
+    DWORD NextFile;
+
+    /**
+     TRUE to hash the leading block of each file, FALSE to hash the entire
+     file.
+     */
+    BOOL Partial;
+
+    /**
+     A mutex protecting NextFile.
+     */
+    HANDLE Mutex;
+
+} DEDUPE_HASH_JOB, *PDEDUPE_HASH_JOB;
+
+/**
+ Hash a single file.
+
+ @param Job Pointer to the hash job.
+
+ @param File Pointer to the file to hash.  On successful completion, the
+        file's hash and flags are updated.
+
+ @param ScratchBuffer Pointer to scratch space for the hash algorithm.
+
+ @param ReadBuffer Pointer to a buffer to read file data into.
+
+ @param ReadBufferLength The number of bytes in ReadBuffer.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+DedupeHashFile(
+    __in PDEDUPE_HASH_JOB Job,
+    __inout PDEDUPE_FILE File,
+    __in PVOID ScratchBuffer,
+    __in PVOID ReadBuffer,
+    __in DWORD ReadBufferLength
+    )
+{
+    PYORI_LIB_FILE_HASH_ALGORITHM Algorithm;
+    BY_HANDLE_FILE_INFORMATION FileInfo;
+    HANDLE FileHandle;
+    DWORDLONG BytesExpected;
+    DWORDLONG BytesHashed;
+    DWORD LastError;
+    LPTSTR ErrText;
+    BOOL Result;
+
+    Algorithm = &Job->DedupeContext->Algorithm;
+
+    FileHandle = CreateFile(File->FilePath.StartOfString,
+                            GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        LastError = GetLastError();
+        ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("dedupe: open of %y failed: %s"), &File->FilePath, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        return FALSE;
+    }
+
+    Result = FALSE;
+
+    if (Job->Partial) {
+
+        //
+        //  Capture the identity of the file so hard links aren't mistaken
+        //  for duplicates, and check it hasn't changed size since it was
+        //  enumerated.
+        //
+
+        if (!GetFileInformationByHandle(FileHandle, &FileInfo) ||
+            ((((DWORDLONG)FileInfo.nFileSizeHigh) << 32) | FileInfo.nFileSizeLow) != File->FileSize) {
+
+            CloseHandle(FileHandle);
+            return FALSE;
+        }
+
+        File->VolumeSerialNumber = FileInfo.dwVolumeSerialNumber;
+        File->FileId = (((DWORDLONG)FileInfo.nFileIndexHigh) << 32) | FileInfo.nFileIndexLow;
+
+        BytesExpected = File->FileSize;
+        if (BytesExpected > DEDUPE_PARTIAL_LENGTH) {
+            BytesExpected = DEDUPE_PARTIAL_LENGTH;
+        }
+
+        if (YoriLibFileHashStream(Algorithm, FileHandle, BytesExpected, ScratchBuffer, ReadBuffer, ReadBufferLength, File->PartialHash, &BytesHashed) &&
+            BytesHashed == BytesExpected) {
+
+            File->Flags |= DEDUPE_FILE_PARTIAL_HASHED;
+
+            //
+            //  If the leading block is the whole file, it doesn't need to be
+            //  hashed again.
+            //
+
+            if (BytesExpected == File->FileSize) {
+                memcpy(File->FullHash, File->PartialHash, Algorithm->HashLength);
+                File->Flags |= DEDUPE_FILE_FULL_HASHED;
+            }
+            Result = TRUE;
+        }
+    } else {
+        if (YoriLibFileHashStream(Algorithm, FileHandle, (DWORDLONG)-1, ScratchBuffer, ReadBuffer, ReadBufferLength, File->FullHash, &BytesHashed) &&
+            BytesHashed == File->FileSize) {
+
+            File->Flags |= DEDUPE_FILE_FULL_HASHED;
+            Result = TRUE;
+        }
+    }
+
+    CloseHandle(FileHandle);
+    return Result;
+}
+
+/**
+ A worker thread which hashes files from a hash job until none remain.
+
+ @param Context Pointer to the hash job.
+
+ @return Zero.  Files which could not be hashed are marked as failed.
+ */
+DWORD WINAPI
+DedupeHashWorker(
+    __in PVOID Context
+    )
+{
+    PDEDUPE_HASH_JOB Job = (PDEDUPE_HASH_JOB)Context;
+    PDEDUPE_FILE File;
+    PVOID ScratchBuffer;
+    PVOID ReadBuffer;
+    DWORD ReadBufferLength;
+
+    ReadBufferLength = DEDUPE_READ_BUFFER_LENGTH;
+    if (Job->Partial) {
+        ReadBufferLength = DEDUPE_PARTIAL_LENGTH;
+    }
+
+    ScratchBuffer = YoriLibMalloc(Job->DedupeContext->Algorithm.ScratchBufferLength);
+    ReadBuffer = YoriLibMalloc(ReadBufferLength);
+
+    if (ScratchBuffer != NULL && ReadBuffer != NULL) {
+        while (TRUE) {
+
+            WaitForSingleObject(Job->Mutex, INFINITE);
+            if (Job->NextFile >= Job->Count || YoriLibIsOperationCancelled()) {
+                ReleaseMutex(Job->Mutex);
+                break;
+            }
+            File = Job->Files[Job->NextFile];
+            Job->NextFile++;
+            ReleaseMutex(Job->Mutex);
+
+            if (!DedupeHashFile(Job, File, ScratchBuffer, ReadBuffer, ReadBufferLength)) {
+                File->Flags |= DEDUPE_FILE_FAILED;
+            }
+        }
+    }
+
+    if (ScratchBuffer != NULL) {
+        YoriLibFree(ScratchBuffer);
+    }
+    if (ReadBuffer != NULL) {
+        YoriLibFree(ReadBuffer);
+    }
+
+    return 0;
+}
+
+/**
+ Hash a set of files, using multiple threads where more than one file exists
+ and the system has more than one processor.  The calling thread also hashes
+ files.
+
+ @param DedupeContext Pointer to the dedupe context.
+
+ @param Files The array of files to hash.
+
+ @param Count The number of elements in the array.
+
+ @param Partial TRUE to hash the leading block of each file, FALSE to hash
+        each file in full.
+
+ @return TRUE to indicate success, FALSE to indicate failure.  Individual
+         files which cannot be hashed are marked as failed and do not cause
+         this function to fail.
+ */
+BOOL
+DedupeHashFiles(
+    __in PDEDUPE_CONTEXT DedupeContext,
+    __in PDEDUPE_FILE *Files,
+    __in DWORD Count,
+    __in BOOL Partial
+    )
+{
+    HANDLE Threads[DEDUPE_MAX_THREADS];
+    DEDUPE_HASH_JOB Job;
+    DWORD ThreadCount;
+    DWORD MaxThreads;
+    DWORD ThreadId;
+    DWORD Index;
+    DWORD Flag;
+    SYSTEM_INFO SystemInfo;
+
+    if (Count == 0) {
+        return TRUE;
+    }
+
+    Job.DedupeContext = DedupeContext;
+    Job.Files = Files;
+    Job.Count = Count;
+    Job.NextFile = 0;
+    Job.Partial = Partial;
+    Job.Mutex = CreateMutex(NULL, FALSE, NULL);
+    if (Job.Mutex == NULL) {
+        return FALSE;
+    }
+
+    GetSystemInfo(&SystemInfo);
+    MaxThreads = SystemInfo.dwNumberOfProcessors;
+    if (MaxThreads > DEDUPE_MAX_THREADS) {
+        MaxThreads = DEDUPE_MAX_THREADS;
+    }
+    if (MaxThreads > Count) {
+        MaxThreads = Count;
+    }
+
+    //
+    //  The current thread is one of the workers, so only create threads
+    //  beyond the first.
+    //
+
+    ThreadCount = 0;
+    while (ThreadCount + 1 < MaxThreads) {
+        Threads[ThreadCount] = CreateThread(NULL, 0, DedupeHashWorker, &Job, 0, &ThreadId);
+        if (Threads[ThreadCount] == NULL) {
+            break;
+        }
+        ThreadCount++;
+    }
+
+    DedupeHashWorker(&Job);
+
+    if (ThreadCount > 0) {
+        WaitForMultipleObjects(ThreadCount, Threads, TRUE, INFINITE);
+        for (Index = 0; Index < ThreadCount; Index++) {
+            CloseHandle(Threads[Index]);
+        }
+    }
+
+    CloseHandle(Job.Mutex);
+
+    //
+    //  Anything that wasn't reached, due to cancellation or allocation
+    //  failure, cannot be compared.
+    //
+
+    Flag = DEDUPE_FILE_FULL_HASHED;
+    if (Partial) {
+        Flag = DEDUPE_FILE_PARTIAL_HASHED;
+    }
+
+    for (Index = 0; Index < Count; Index++) {
+        if ((Files[Index]->Flags & Flag) == 0) {
+            Files[Index]->Flags |= DEDUPE_FILE_FAILED;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Open a file which is about to be replaced or linked to, preventing it from
+ being written while it is open.  The file can still be renamed.
+
+ @param File Pointer to the file to open.
+
+ @return Handle to the file, or INVALID_HANDLE_VALUE on failure.
+ */
+HANDLE
+DedupeOpenForLink(
+    __in PDEDUPE_FILE File
+    )
+{
+    HANDLE FileHandle;
+    DWORD LastError;
+    LPTSTR ErrText;
+
+    FileHandle = CreateFile(File->FilePath.StartOfString,
+                            GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        LastError = GetLastError();
+        ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("dedupe: open of %y failed: %s"), &File->FilePath, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+    }
+
+    return FileHandle;
+}
+
+/**
+ Check that two files have identical contents by comparing every byte,
+ so that a file is never replaced because of a hash collision or because it
+ was modified after it was hashed.
+
+ @param Keep Pointer to the file to retain.
+
+ @param KeepHandle Handle to the file to retain.
+
+ @param Duplicate Pointer to the file to replace.
+
+ @param DuplicateHandle Handle to the file to replace.
+
+ @return TRUE if the files are the size that was hashed and have identical
+         contents, FALSE if they differ or could not be read.
+ */
+BOOL
+DedupeCompareContents(
+    __in PDEDUPE_FILE Keep,
+    __in HANDLE KeepHandle,
+    __in PDEDUPE_FILE Duplicate,
+    __in HANDLE DuplicateHandle
+    )
+{
+    BY_HANDLE_FILE_INFORMATION FileInfo;
+    PUCHAR KeepBuffer;
+    PUCHAR DuplicateBuffer;
+    DWORD KeepBytesRead;
+    DWORD DuplicateBytesRead;
+    DWORDLONG BytesCompared;
+    BOOL Result;
+
+    if (!GetFileInformationByHandle(KeepHandle, &FileInfo) ||
+        ((((DWORDLONG)FileInfo.nFileSizeHigh) << 32) | FileInfo.nFileSizeLow) != Keep->FileSize) {
+
+        return FALSE;
+    }
+
+    if (!GetFileInformationByHandle(DuplicateHandle, &FileInfo) ||
+        ((((DWORDLONG)FileInfo.nFileSizeHigh) << 32) | FileInfo.nFileSizeLow) != Duplicate->FileSize ||
+        Keep->FileSize != Duplicate->FileSize) {
+
+        return FALSE;
+    }
+
+    KeepBuffer = YoriLibMalloc(DEDUPE_PARTIAL_LENGTH * 2);
+    if (KeepBuffer == NULL) {
+        return FALSE;
+    }
+    DuplicateBuffer = KeepBuffer + DEDUPE_PARTIAL_LENGTH;
+
+    Result = TRUE;
+    BytesCompared = 0;
+    while (BytesCompared < Keep->FileSize) {
+        if (!ReadFile(KeepHandle, KeepBuffer, DEDUPE_PARTIAL_LENGTH, &KeepBytesRead, NULL) ||
+            !ReadFile(DuplicateHandle, DuplicateBuffer, DEDUPE_PARTIAL_LENGTH, &DuplicateBytesRead, NULL) ||
+            KeepBytesRead == 0 ||
+            KeepBytesRead != DuplicateBytesRead ||
+            memcmp(KeepBuffer, DuplicateBuffer, KeepBytesRead) != 0) {
+
+            Result = FALSE;
+            break;
+        }
+        BytesCompared += KeepBytesRead;
+    }
+
+    YoriLibFree(KeepBuffer);
+    return Result;
+}
+
+/**
+ Replace a file with a hard link to another file with identical contents.
+ Both files are held open without write sharing while their contents are
+ compared and the link is created, so neither can change in between.  The
+ file is renamed out of the way first so it can be restored if the link
+ cannot be created.
+
+ @param Keep Pointer to the file to retain.
+
+ @param Duplicate Pointer to the file to replace.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+DedupeReplaceWithLink(
+    __in PDEDUPE_FILE Keep,
+    __in PDEDUPE_FILE Duplicate
+    )
+{
+    YORI_STRING TempName;
+    HANDLE KeepHandle;
+    HANDLE DuplicateHandle;
+    DWORD LastError;
+    LPTSTR ErrText;
+
+    KeepHandle = DedupeOpenForLink(Keep);
+    if (KeepHandle == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    DuplicateHandle = DedupeOpenForLink(Duplicate);
+    if (DuplicateHandle == INVALID_HANDLE_VALUE) {
+        CloseHandle(KeepHandle);
+        return FALSE;
+    }
+
+    if (!DedupeCompareContents(Keep, KeepHandle, Duplicate, DuplicateHandle)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("dedupe: %y does not match %y, not linked\n"), &Duplicate->FilePath, &Keep->FilePath);
+        CloseHandle(DuplicateHandle);
+        CloseHandle(KeepHandle);
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&TempName);
+    if (YoriLibYPrintf(&TempName, _T("%y.dedupe"), &Duplicate->FilePath) < 0 ||
+        TempName.StartOfString == NULL) {
+
+        CloseHandle(DuplicateHandle);
+        CloseHandle(KeepHandle);
+        return FALSE;
+    }
+
+    if (!MoveFile(Duplicate->FilePath.StartOfString, TempName.StartOfString)) {
+        LastError = GetLastError();
+        CloseHandle(DuplicateHandle);
+        CloseHandle(KeepHandle);
+        ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("dedupe: rename of %y failed: %s"), &Duplicate->FilePath, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        YoriLibFreeStringContents(&TempName);
+        return FALSE;
+    }
+
+    if (!DllKernel32.pCreateHardLinkW(Duplicate->FilePath.StartOfString, Keep->FilePath.StartOfString, NULL)) {
+        LastError = GetLastError();
+        MoveFile(TempName.StartOfString, Duplicate->FilePath.StartOfString);
+        CloseHandle(DuplicateHandle);
+        CloseHandle(KeepHandle);
+        ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("dedupe: link of %y failed: %s"), &Duplicate->FilePath, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        YoriLibFreeStringContents(&TempName);
+        return FALSE;
+    }
+
+    CloseHandle(DuplicateHandle);
+    CloseHandle(KeepHandle);
+
+    //
+    //  The link is in place, so failing to delete the renamed copy only
+    //  means space isn't reclaimed.
+    //
+
+    if (!DeleteFile(TempName.StartOfString)) {
+        SetFileAttributes(TempName.StartOfString, FILE_ATTRIBUTE_NORMAL);
+        if (!DeleteFile(TempName.StartOfString)) {
+            LastError = GetLastError();
+            ErrText = YoriLibGetWinErrorText(LastError);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("dedupe: delete of %y failed: %s"), &TempName, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+        }
+    }
+
+    YoriLibFreeStringContents(&TempName);
+    return TRUE;
+}
+
+/**
+ Report a set of files with identical contents, and replace duplicates with
+ hard links if requested.
+
+ @param DedupeContext Pointer to the dedupe context.
+
+ @param Files The array of files with identical contents.
+
+ @param Count The number of elements in the array.
+ */
+VOID
+DedupeProcessDuplicateSet(
+    __in PDEDUPE_CONTEXT DedupeContext,
+    __inout PDEDUPE_FILE *Files,
+    __in DWORD Count
+    )
+{
+    DWORD Distinct;
+    DWORD Index;
+    DWORD End;
+    BOOL Linked;
+    YORI_STRING DisplayPath;
+    YORI_STRING SizeString;
+    TCHAR SizeStringBuffer[10];
+    LARGE_INTEGER FileSize;
+
+    //
+    //  Hard links to the same data are not duplicates, so if every file is
+    //  the same data there's nothing to report.
+    //
+
+    Distinct = DedupeCountDistinctFiles(Files, Count);
+    if (Distinct < 2) {
+        return;
+    }
+
+    DedupeContext->DuplicateSets++;
+    DedupeContext->DuplicateFiles += Distinct - 1;
+    DedupeContext->WastedBytes += (Distinct - 1) * Files[0]->FileSize;
+
+    YoriLibInitEmptyString(&SizeString);
+    SizeString.StartOfString = SizeStringBuffer;
+    SizeString.LengthAllocated = sizeof(SizeStringBuffer)/sizeof(SizeStringBuffer[0]);
+    FileSize.QuadPart = Files[0]->FileSize;
+    YoriLibFileSizeToString(&SizeString, &FileSize);
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%i copies of %y:\n"), Distinct, &SizeString);
+
+    YoriLibInitEmptyString(&DisplayPath);
+    for (Index = 0; Index < Count; Index++) {
+        if (YoriLibUnescapePath(&Files[Index]->FilePath, &DisplayPath)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  %y\n"), &DisplayPath);
+        } else {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  %y\n"), &Files[Index]->FilePath);
+        }
+    }
+    YoriLibFreeStringContents(&DisplayPath);
+
+    //
+    //  Files are ordered so that links to the same data are adjacent.  Keep
+    //  the first, and link every file that refers to different data to it.
+    //  Space is reclaimed once every link to a copy has been replaced.
+    //
+
+    if (DedupeContext->CreateLinks) {
+        Index = DedupeFindRunEnd(Files, 0, Count, DedupeCompareFileId, 0);
+        while (Index < Count) {
+            End = DedupeFindRunEnd(Files, Index, Count, DedupeCompareFileId, 0);
+            Linked = TRUE;
+            for (; Index < End; Index++) {
+                if (Files[0]->VolumeSerialNumber != Files[Index]->VolumeSerialNumber ||
+                    !DedupeReplaceWithLink(Files[0], Files[Index])) {
+
+                    Linked = FALSE;
+                }
+            }
+            if (Linked) {
+                DedupeContext->ReclaimedBytes += Files[0]->FileSize;
+            }
+        }
+    }
+}
+
+/**
+ A callback that is invoked when a file is found.
+
+ @param FilePath Pointer to the file path that was found.
+
+ @param FileInfo Information about the file.  This can be NULL if the file
+        was not found by enumeration.
+
+ @param Depth Indicates the recursion depth.
+
+ @param Context Pointer to the dedupe context.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+DedupeFileFoundCallback(
+    __in PYORI_STRING FilePath,
+    __in_opt PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    PDEDUPE_CONTEXT DedupeContext = (PDEDUPE_CONTEXT)Context;
+    WIN32_FIND_DATA LocalFileInfo;
+    PDEDUPE_FILE File;
+    PDEDUPE_FILE *NewFiles;
+    DWORD NewAllocated;
+    DWORD HashLength;
+    DWORDLONG FileSize;
+
+    UNREFERENCED_PARAMETER(Depth);
+
+    ASSERT(YoriLibIsStringNullTerminated(FilePath));
+
+    if (FileInfo == NULL) {
+        if (!YoriLibUpdateFindDataFromFileInformation(&LocalFileInfo, FilePath->StartOfString, FALSE)) {
+            return TRUE;
+        }
+        FileInfo = &LocalFileInfo;
+    }
+
+    DedupeContext->FilesFoundThisArg++;
+
+    //
+    //  Empty files have nothing to reclaim, and links are not followed so
+    //  that their targets aren't linked to.
+    //
+
+    if (FileInfo->dwFileAttributes & (FILE_ATTRIBUTE_DIRECTORY | FILE_ATTRIBUTE_REPARSE_POINT)) {
+        return TRUE;
+    }
+
+    FileSize = (((DWORDLONG)FileInfo->nFileSizeHigh) << 32) | FileInfo->nFileSizeLow;
+    if (FileSize == 0) {
+        return TRUE;
+    }
+
+    if (DedupeContext->FileCount >= DedupeContext->FilesAllocated) {
+        NewAllocated = DedupeContext->FilesAllocated * 2;
+        if (NewAllocated < 1024) {
+            NewAllocated = 1024;
+        }
+        NewFiles = YoriLibMalloc(NewAllocated * sizeof(PDEDUPE_FILE));
+        if (NewFiles == NULL) {
+            return FALSE;
+        }
+        if (DedupeContext->Files != NULL) {
+            memcpy(NewFiles, DedupeContext->Files, DedupeContext->FileCount * sizeof(PDEDUPE_FILE));
+            YoriLibFree(DedupeContext->Files);
+        }
+        DedupeContext->Files = NewFiles;
+        DedupeContext->FilesAllocated = NewAllocated;
+    }
+
+    //
+    //  Allocate the file, its hashes and its path together.
+    //
+
+    HashLength = DedupeContext->Algorithm.HashLength;
+    File = YoriLibMalloc(sizeof(DEDUPE_FILE) + 2 * HashLength + (FilePath->LengthInChars + 1) * sizeof(TCHAR));
+    if (File == NULL) {
+        return FALSE;
+    }
+
+    ZeroMemory(File, sizeof(DEDUPE_FILE));
+    File->FileSize = FileSize;
+    File->PartialHash = (PUCHAR)(File + 1);
+    File->FullHash = File->PartialHash + HashLength;
+
+    YoriLibInitEmptyString(&File->FilePath);
+    File->FilePath.StartOfString = (LPTSTR)(File->FullHash + HashLength);
+    File->FilePath.LengthInChars = FilePath->LengthInChars;
+    File->FilePath.LengthAllocated = FilePath->LengthInChars + 1;
+    memcpy(File->FilePath.StartOfString, FilePath->StartOfString, FilePath->LengthInChars * sizeof(TCHAR));
+    File->FilePath.StartOfString[FilePath->LengthInChars] = '\0';
+
+    DedupeContext->Files[DedupeContext->FileCount] = File;
+    DedupeContext->FileCount++;
+
+    return TRUE;
+}
+
+/**
+ A callback that is invoked when a directory cannot be successfully enumerated.
+
+ @param FilePath Pointer to the file path that could not be enumerated.
+
+ @param ErrorCode The Win32 error code describing the failure.
+
+ @param Depth Recursion depth, ignored in this application.
+
+ @param Context Pointer to the context block indicating whether the
+        enumeration was recursive.  Recursive enumerates do not complain
+        if a matching file is not in every single directory, because
+        common usage expects files to be in a subset of directories only.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+DedupeFileEnumerateErrorCallback(
+    __in PYORI_STRING FilePath,
+    __in DWORD ErrorCode,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    YORI_STRING UnescapedFilePath;
+    BOOL Result = FALSE;
+    PDEDUPE_CONTEXT DedupeContext = (PDEDUPE_CONTEXT)Context;
+
+    UNREFERENCED_PARAMETER(Depth);
+
+    YoriLibInitEmptyString(&UnescapedFilePath);
+    if (!YoriLibUnescapePath(FilePath, &UnescapedFilePath)) {
+        UnescapedFilePath.StartOfString = FilePath->StartOfString;
+        UnescapedFilePath.LengthInChars = FilePath->LengthInChars;
+    }
+
+    if (ErrorCode == ERROR_FILE_NOT_FOUND || ErrorCode == ERROR_PATH_NOT_FOUND) {
+        if (!DedupeContext->Recursive) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("File or directory not found: %y\n"), &UnescapedFilePath);
+        }
+        Result = TRUE;
+    } else {
+        LPTSTR ErrText = YoriLibGetWinErrorText(ErrorCode);
+        YORI_STRING DirName;
+        LPTSTR FilePart;
+        YoriLibInitEmptyString(&DirName);
+        DirName.StartOfString = UnescapedFilePath.StartOfString;
+        FilePart = YoriLibFindRightMostCharacter(&UnescapedFilePath, '\\');
+        if (FilePart != NULL) {
+            DirName.LengthInChars = (DWORD)(FilePart - DirName.StartOfString);
+        } else {
+            DirName.LengthInChars = UnescapedFilePath.LengthInChars;
+        }
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Enumerate of %y failed: %s"), &DirName, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+    }
+    YoriLibFreeStringContents(&UnescapedFilePath);
+    return Result;
+}
+
+/**
+ Find duplicates among every file that has been found.  Files are grouped
+ by size, then by a hash of their leading block, and finally by a hash of
+ their full contents, so each stage only examines files which could still
+ be duplicates.
+
+ @param DedupeContext Pointer to the dedupe context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+DedupeFindDuplicates(
+    __in PDEDUPE_CONTEXT DedupeContext
+    )
+{
+    PDEDUPE_FILE *Candidates;
+    PDEDUPE_FILE *NeedFullHash;
+    DWORD CandidateCount;
+    DWORD NeedFullHashCount;
+    DWORD HashLength;
+    DWORD Index;
+    DWORD End;
+
+    if (DedupeContext->FileCount < 2) {
+        return TRUE;
+    }
+
+    HashLength = DedupeContext->Algorithm.HashLength;
+    Candidates = YoriLibMalloc(DedupeContext->FileCount * sizeof(PDEDUPE_FILE) * 2);
+    if (Candidates == NULL) {
+        return FALSE;
+    }
+    NeedFullHash = Candidates + DedupeContext->FileCount;
+
+    memcpy(Candidates, DedupeContext->Files, DedupeContext->FileCount * sizeof(PDEDUPE_FILE));
+    CandidateCount = DedupeRemoveUnique(Candidates, DedupeContext->FileCount, DedupeCompareSize, HashLength);
+
+    DedupeHashFiles(DedupeContext, Candidates, CandidateCount, TRUE);
+    CandidateCount = DedupeRemoveUnique(Candidates, CandidateCount, DedupeComparePartialHash, HashLength);
+
+    NeedFullHashCount = 0;
+    for (Index = 0; Index < CandidateCount; Index++) {
+        if ((Candidates[Index]->Flags & DEDUPE_FILE_FULL_HASHED) == 0) {
+            NeedFullHash[NeedFullHashCount] = Candidates[Index];
+            NeedFullHashCount++;
+        }
+    }
+
+    DedupeHashFiles(DedupeContext, NeedFullHash, NeedFullHashCount, FALSE);
+    CandidateCount = DedupeRemoveUnique(Candidates, CandidateCount, DedupeCompareFullHash, HashLength);
+
+    if (YoriLibIsOperationCancelled()) {
+        YoriLibFree(Candidates);
+        return FALSE;
+    }
+
+    Index = 0;
+    while (Index < CandidateCount) {
+        End = DedupeFindRunEnd(Candidates, Index, CandidateCount, DedupeCompareFullHash, HashLength);
+        DedupeProcessDuplicateSet(DedupeContext, &Candidates[Index], End - Index);
+        Index = End;
+    }
+
+    YoriLibFree(Candidates);
+    return TRUE;
+}
+
+/**
+ Cleanup any internal allocations within the dedupe context.  The context
+ itself is a stack allocation and is not freed.
+
+ @param DedupeContext Pointer to the dedupe context to clean up.
+ */
+VOID
+DedupeCleanupContext(
+    __in PDEDUPE_CONTEXT DedupeContext
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < DedupeContext->FileCount; Index++) {
+        YoriLibFree(DedupeContext->Files[Index]);
+    }
+
+    if (DedupeContext->Files != NULL) {
+        YoriLibFree(DedupeContext->Files);
+        DedupeContext->Files = NULL;
+    }
+    DedupeContext->FileCount = 0;
+    DedupeContext->FilesAllocated = 0;
+
+    YoriLibFileHashCloseAlgorithm(&DedupeContext->Algorithm);
+}
+
+#ifdef YORI_BUILTIN
+/**
+ The main entrypoint for the dedupe builtin command.
+ */
+#define ENTRYPOINT YoriCmd_DEDUPE
+#else
+/**
+ The main entrypoint for the dedupe standalone application.
+ */
+#define ENTRYPOINT ymain
+#endif
+
+/**
+ The main entrypoint for the dedupe cmdlet.
+
+ @param ArgC The number of arguments.
+
+ @param ArgV An array of arguments.
+
+ @return Exit code of the process, typically zero for success and nonzero
+         for failure.
+ */
+DWORD
+ENTRYPOINT(
+    __in DWORD ArgC,
+    __in YORI_STRING ArgV[]
+    )
+{
+    BOOL ArgumentUnderstood;
+    DWORD i;
+    DWORD StartArg = 0;
+    DWORD MatchFlags;
+    BOOL BasicEnumeration = FALSE;
+    DEDUPE_CONTEXT DedupeContext;
+    YORI_STRING Arg;
+    YORI_STRING SizeString;
+    TCHAR SizeStringBuffer[10];
+    LARGE_INTEGER Size;
+    LPTSTR Algorithm = _T("SHA256");
+    BOOL WeakAlgorithm = FALSE;
+    LONG Status;
+
+    ZeroMemory(&DedupeContext, sizeof(DedupeContext));
+
+    for (i = 1; i < ArgC; i++) {
+
+        ArgumentUnderstood = FALSE;
+        ASSERT(YoriLibIsStringNullTerminated(&ArgV[i]));
+
+        if (YoriLibIsCommandLineOption(&ArgV[i], &Arg)) {
+
+            if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("?")) == 0) {
+                DedupeHelp();
+                return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("license")) == 0) {
+                YoriLibDisplayMitLicense(_T("2026"));
+                return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("a")) == 0) {
+                if (i + 1 < ArgC) {
+                    if (YoriLibCompareStringWithLiteralInsensitive(&ArgV[i + 1], _T("MD5")) == 0) {
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                        Algorithm = _T("MD5");
+                        WeakAlgorithm = TRUE;
+                    } else if (YoriLibCompareStringWithLiteralInsensitive(&ArgV[i + 1], _T("SHA1")) == 0) {
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                        Algorithm = _T("SHA1");
+                        WeakAlgorithm = TRUE;
+                    } else if (YoriLibCompareStringWithLiteralInsensitive(&ArgV[i + 1], _T("SHA256")) == 0) {
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                        Algorithm = _T("SHA256");
+                        WeakAlgorithm = FALSE;
+                    } else if (YoriLibCompareStringWithLiteralInsensitive(&ArgV[i + 1], _T("SHA384")) == 0) {
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                        Algorithm = _T("SHA384");
+                        WeakAlgorithm = FALSE;
+                    } else if (YoriLibCompareStringWithLiteralInsensitive(&ArgV[i + 1], _T("SHA512")) == 0) {
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                        Algorithm = _T("SHA512");
+                        WeakAlgorithm = FALSE;
+                    } else {
+                        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("dedupe: algorithm not recognized.  Supported algorithms are MD5, SHA1, SHA256, SHA384, and SHA512\n"));
+                        return EXIT_FAILURE;
+                    }
+                }
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("b")) == 0) {
+                BasicEnumeration = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("l")) == 0) {
+                DedupeContext.CreateLinks = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("s")) == 0) {
+                DedupeContext.Recursive = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("-")) == 0) {
+                StartArg = i + 1;
+                ArgumentUnderstood = TRUE;
+                break;
+            }
+        } else {
+            ArgumentUnderstood = TRUE;
+            StartArg = i;
+            break;
+        }
+
+        if (!ArgumentUnderstood) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Argument not understood, ignored: %y\n"), &ArgV[i]);
+        }
+    }
+
+    if (StartArg == 0 || StartArg == ArgC) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("dedupe: missing argument\n"));
+        return EXIT_FAILURE;
+    }
+
+    if (DedupeContext.CreateLinks && DllKernel32.pCreateHardLinkW == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("dedupe: OS support not present\n"));
+        return EXIT_FAILURE;
+    }
+
+    //
+    //  Collisions can be constructed for MD5 and SHA1, so don't allow them
+    //  to decide which files are replaced.
+    //
+
+    if (DedupeContext.CreateLinks && WeakAlgorithm) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("dedupe: -l requires SHA256, SHA384, or SHA512\n"));
+        return EXIT_FAILURE;
+    }
+
+    Status = YoriLibFileHashOpenAlgorithm(Algorithm, &DedupeContext.Algorithm);
+    if (Status != 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("dedupe: algorithm provider not functional, status 0x%08x\n"), Status);
+        return EXIT_FAILURE;
+    }
+
+#if YORI_BUILTIN
+    YoriLibCancelEnable();
+#endif
+
+    MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_DIRECTORY_CONTENTS;
+    if (BasicEnumeration) {
+        MatchFlags |= YORILIB_FILEENUM_BASIC_EXPANSION;
+    }
+    if (DedupeContext.Recursive) {
+        MatchFlags |= YORILIB_FILEENUM_RECURSE_AFTER_RETURN | YORILIB_FILEENUM_RECURSE_PRESERVE_WILD;
+    }
+
+    for (i = StartArg; i < ArgC; i++) {
+
+        DedupeContext.FilesFoundThisArg = 0;
+
+        if (!YoriLibForEachFile(&ArgV[i],
+                                MatchFlags,
+                                0,
+                                DedupeFileFoundCallback,
+                                DedupeFileEnumerateErrorCallback,
+                                &DedupeContext) &&
+            YoriLibIsOperationCancelled()) {
+
+            DedupeCleanupContext(&DedupeContext);
+            return EXIT_FAILURE;
+        }
+
+        if (DedupeContext.FilesFoundThisArg == 0) {
+            YORI_STRING FullPath;
+            YoriLibInitEmptyString(&FullPath);
+            if (YoriLibUserStringToSingleFilePath(&ArgV[i], TRUE, &FullPath)) {
+                DedupeFileFoundCallback(&FullPath, NULL, 0, &DedupeContext);
+                YoriLibFreeStringContents(&FullPath);
+            }
+        }
+    }
+
+    if (!DedupeFindDuplicates(&DedupeContext)) {
+        DedupeCleanupContext(&DedupeContext);
+        return EXIT_FAILURE;
+    }
+
+    YoriLibInitEmptyString(&SizeString);
+    SizeString.StartOfString = SizeStringBuffer;
+    SizeString.LengthAllocated = sizeof(SizeStringBuffer)/sizeof(SizeStringBuffer[0]);
+    Size.QuadPart = DedupeContext.WastedBytes;
+    YoriLibFileSizeToString(&SizeString, &Size);
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%i duplicate sets, %i duplicate files, %y wasted\n"), DedupeContext.DuplicateSets, DedupeContext.DuplicateFiles, &SizeString);
+
+    if (DedupeContext.CreateLinks) {
+        Size.QuadPart = DedupeContext.ReclaimedBytes;
+        YoriLibFileSizeToString(&SizeString, &Size);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y reclaimed\n"), &SizeString);
+    }
+
+    DedupeCleanupContext(&DedupeContext);
+
+    return EXIT_SUCCESS;
+}
+
+// vim:sw=4:ts=4:et:
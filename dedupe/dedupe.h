@@ -0,0 +1,166 @@
+/**
+ * @file dedupe/dedupe.h
+ *
+ * Yori find files with duplicate contents
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ Indicates the PartialHash member of a file is valid.
+ */
+#define DEDUPE_FILE_PARTIAL_HASHED 0x0001
+
+/**
+ Indicates the FullHash member of a file is valid.
+ */
+#define DEDUPE_FILE_FULL_HASHED    0x0002
+
+/**
+ Indicates the file could not be hashed, so it should not be considered a
+ duplicate of anything.
+ */
+#define DEDUPE_FILE_FAILED         0x0004
+
+/**
+ Information about a single file which may be a duplicate.
+ */
+typedef struct _DEDUPE_FILE {
+
+    /**
+     The full path to the file.
+     */
+    YORI_STRING FilePath;
+
+    /**
+     The size of the file, in bytes.
+     */
+    DWORDLONG FileSize;
+
+    /**
+     The file's unique identifier within its volume.  Files with the same
+     identifier and volume serial number are hard links to the same data,
+     which is not wasted space.  This is valid once the file is hashed.
+     */
+    DWORDLONG FileId;
+
+    /**
+     The serial number of the volume containing the file.  This is valid
+     once the file is hashed.
+     */
+    DWORD VolumeSerialNumber;
+
+    /**
+     A combination of DEDUPE_FILE_* flags.
+     */
+    DWORD Flags;
+
+    /**
+     Pointer to the hash of the leading block of the file.
+     */
+    PUCHAR PartialHash;
+
+    /**
+     Pointer to the hash of the entire file.
+     */
+    PUCHAR FullHash;
+
+} DEDUPE_FILE, *PDEDUPE_FILE;
+
+/**
+ A prototype for a function which compares two files.
+
+ @param Left Pointer to the first file.
+
+ @param Right Pointer to the second file.
+
+ @param HashLength The number of bytes in each hash.
+
+ @return Less than zero if Left should be ordered first, greater than zero
+         if Right should be ordered first, or zero if they are equal.
+ */
+typedef int DEDUPE_COMPARE_FN(PDEDUPE_FILE Left, PDEDUPE_FILE Right, DWORD HashLength);
+
+/**
+ A pointer to a function which compares two files.
+ */
+typedef DEDUPE_COMPARE_FN *PDEDUPE_COMPARE_FN;
+
+int
+DedupeCompareSize(
+    __in PDEDUPE_FILE Left,
+    __in PDEDUPE_FILE Right,
+    __in DWORD HashLength
+    );
+
+int
+DedupeComparePartialHash(
+    __in PDEDUPE_FILE Left,
+    __in PDEDUPE_FILE Right,
+    __in DWORD HashLength
+    );
+
+int
+DedupeCompareFullHash(
+    __in PDEDUPE_FILE Left,
+    __in PDEDUPE_FILE Right,
+    __in DWORD HashLength
+    );
+
+int
+DedupeCompareFileId(
+    __in PDEDUPE_FILE Left,
+    __in PDEDUPE_FILE Right,
+    __in DWORD HashLength
+    );
+
+VOID
+DedupeSortFiles(
+    __inout PDEDUPE_FILE *Files,
+    __in DWORD Count,
+    __in PDEDUPE_COMPARE_FN Compare,
+    __in DWORD HashLength
+    );
+
+DWORD
+DedupeRemoveUnique(
+    __inout PDEDUPE_FILE *Files,
+    __in DWORD Count,
+    __in PDEDUPE_COMPARE_FN Compare,
+    __in DWORD HashLength
+    );
+
+DWORD
+DedupeFindRunEnd(
+    __in PDEDUPE_FILE *Files,
+    __in DWORD Start,
+    __in DWORD Count,
+    __in PDEDUPE_COMPARE_FN Compare,
+    __in DWORD HashLength
+    );
+
+DWORD
+DedupeCountDistinctFiles(
+    __inout PDEDUPE_FILE *Files,
+    __in DWORD Count
+    );
+
+// vim:sw=4:ts=4:et:
@@ -0,0 +1,369 @@
+/**
+ * @file dedupe/group.c
+ *
+ * Yori find files with duplicate contents.  This module orders and groups
+ * files by their size and hashes.
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "dedupe.h"
+
+/**
+ Compare two files by size.  Larger files are ordered first, since they
+ have the most space to reclaim.
+
+ @param Left Pointer to the first file.
+
+ @param Right Pointer to the second file.
+
+ @param HashLength The number of bytes in each hash, ignored by this
+        comparison.
+
+ @return Less than zero if Left should be ordered first, greater than zero
+         if Right should be ordered first, or zero if they are equal.
+ */
+int
+DedupeCompareSize(
+    __in PDEDUPE_FILE Left,
+    __in PDEDUPE_FILE Right,
+    __in DWORD HashLength
+    )
+{
+    UNREFERENCED_PARAMETER(HashLength);
+
+    if (Left->FileSize > Right->FileSize) {
+        return -1;
+    } else if (Left->FileSize < Right->FileSize) {
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ Compare two files by size and then by the hash of their leading block.
+
+ @param Left Pointer to the first file.
+
+ @param Right Pointer to the second file.
+
+ @param HashLength The number of bytes in each hash.
+
+ @return Less than zero if Left should be ordered first, greater than zero
+         if Right should be ordered first, or zero if they are equal.
+ */
+int
+DedupeComparePartialHash(
+    __in PDEDUPE_FILE Left,
+    __in PDEDUPE_FILE Right,
+    __in DWORD HashLength
+    )
+{
+    int Result;
+
+    Result = DedupeCompareSize(Left, Right, HashLength);
+    if (Result != 0) {
+        return Result;
+    }
+
+    return memcmp(Left->PartialHash, Right->PartialHash, HashLength);
+}
+
+/**
+ Compare two files by size and then by the hash of their entire contents.
+
+ @param Left Pointer to the first file.
+
+ @param Right Pointer to the second file.
+
+ @param HashLength The number of bytes in each hash.
+
+ @return Less than zero if Left should be ordered first, greater than zero
+         if Right should be ordered first, or zero if they are equal.
+ */
+int
+DedupeCompareFullHash(
+    __in PDEDUPE_FILE Left,
+    __in PDEDUPE_FILE Right,
+    __in DWORD HashLength
+    )
+{
+    int Result;
+
+    Result = DedupeCompareSize(Left, Right, HashLength);
+    if (Result != 0) {
+        return Result;
+    }
+
+    return memcmp(Left->FullHash, Right->FullHash, HashLength);
+}
+
+/**
+ Compare two files by their volume and identifier within the volume, so that
+ hard links to the same data are ordered together.
+
+ @param Left Pointer to the first file.
+
+ @param Right Pointer to the second file.
+
+ @param HashLength The number of bytes in each hash, ignored by this
+        comparison.
+
+ @return Less than zero if Left should be ordered first, greater than zero
+         if Right should be ordered first, or zero if they are equal.
+ */
+int
+DedupeCompareFileId(
+    __in PDEDUPE_FILE Left,
+    __in PDEDUPE_FILE Right,
+    __in DWORD HashLength
+    )
+{
+    UNREFERENCED_PARAMETER(HashLength);
+
+    if (Left->VolumeSerialNumber < Right->VolumeSerialNumber) {
+        return -1;
+    } else if (Left->VolumeSerialNumber > Right->VolumeSerialNumber) {
+        return 1;
+    }
+
+    if (Left->FileId < Right->FileId) {
+        return -1;
+    } else if (Left->FileId > Right->FileId) {
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ Move an element down a heap until both of its children are ordered before
+ it.
+
+ @param Files The array of files forming the heap.
+
+ @param Index The element to move.
+
+ @param Count The number of elements in the heap.
+
+ @param Compare The function to compare files with.
+
+ @param HashLength The number of bytes in each hash.
+ */
+VOID
+DedupeSiftDown(
+    __inout PDEDUPE_FILE *Files,
+    __in DWORD Index,
+    __in DWORD Count,
+    __in PDEDUPE_COMPARE_FN Compare,
+    __in DWORD HashLength
+    )
+{
+    DWORD Child;
+    PDEDUPE_FILE Swap;
+
+    while (Index < Count / 2) {
+        Child = Index * 2 + 1;
+        if (Child + 1 < Count &&
+            Compare(Files[Child], Files[Child + 1], HashLength) < 0) {
+
+            Child++;
+        }
+
+        if (Compare(Files[Index], Files[Child], HashLength) >= 0) {
+            break;
+        }
+
+        Swap = Files[Index];
+        Files[Index] = Files[Child];
+        Files[Child] = Swap;
+        Index = Child;
+    }
+}
+
+/**
+ Sort an array of files.  This uses a heap sort, which needs no additional
+ memory or recursion regardless of the number of files.
+
+ @param Files The array of files to sort.
+
+ @param Count The number of elements in the array.
+
+ @param Compare The function to compare files with.
+
+ @param HashLength The number of bytes in each hash.
+ */
+VOID
+DedupeSortFiles(
+    __inout PDEDUPE_FILE *Files,
+    __in DWORD Count,
+    __in PDEDUPE_COMPARE_FN Compare,
+    __in DWORD HashLength
+    )
+{
+    DWORD Index;
+    PDEDUPE_FILE Swap;
+
+    if (Count < 2) {
+        return;
+    }
+
+    for (Index = Count / 2; Index > 0; Index--) {
+        DedupeSiftDown(Files, Index - 1, Count, Compare, HashLength);
+    }
+
+    for (Index = Count - 1; Index > 0; Index--) {
+        Swap = Files[0];
+        Files[0] = Files[Index];
+        Files[Index] = Swap;
+        DedupeSiftDown(Files, 0, Index, Compare, HashLength);
+    }
+}
+
+/**
+ Find the end of a run of files which compare as equal.
+
+ @param Files The sorted array of files.
+
+ @param Start The index of the first file in the run.
+
+ @param Count The number of elements in the array.
+
+ @param Compare The function that the array was sorted with.
+
+ @param HashLength The number of bytes in each hash.
+
+ @return The index of the first file after the run.
+ */
+DWORD
+DedupeFindRunEnd(
+    __in PDEDUPE_FILE *Files,
+    __in DWORD Start,
+    __in DWORD Count,
+    __in PDEDUPE_COMPARE_FN Compare,
+    __in DWORD HashLength
+    )
+{
+    DWORD End;
+
+    End = Start + 1;
+    while (End < Count && Compare(Files[Start], Files[End], HashLength) == 0) {
+        End++;
+    }
+
+    return End;
+}
+
+/**
+ Sort an array of files and remove any file which is not equal to at least
+ one other file.  Files which could not be hashed are also removed.  Removed
+ files are not freed, since they remain owned by the caller.
+
+ @param Files The array of files.  On completion, the array contains the
+        remaining files, sorted.
+
+ @param Count The number of elements in the array.
+
+ @param Compare The function to compare files with.
+
+ @param HashLength The number of bytes in each hash.
+
+ @return The number of files remaining in the array.
+ */
+DWORD
+DedupeRemoveUnique(
+    __inout PDEDUPE_FILE *Files,
+    __in DWORD Count,
+    __in PDEDUPE_COMPARE_FN Compare,
+    __in DWORD HashLength
+    )
+{
+    DWORD Index;
+    DWORD End;
+    DWORD Remaining;
+
+    Remaining = 0;
+    for (Index = 0; Index < Count; Index++) {
+        if ((Files[Index]->Flags & DEDUPE_FILE_FAILED) == 0) {
+            Files[Remaining] = Files[Index];
+            Remaining++;
+        }
+    }
+    Count = Remaining;
+
+    DedupeSortFiles(Files, Count, Compare, HashLength);
+
+    Remaining = 0;
+    Index = 0;
+    while (Index < Count) {
+        End = DedupeFindRunEnd(Files, Index, Count, Compare, HashLength);
+        if (End - Index > 1) {
+            while (Index < End) {
+                Files[Remaining] = Files[Index];
+                Remaining++;
+                Index++;
+            }
+        }
+        Index = End;
+    }
+
+    return Remaining;
+}
+
+/**
+ Order a set of files with identical contents so that hard links to the
+ same data are adjacent, and count how many distinct copies of the data
+ exist.
+
+ @param Files The array of files with identical contents.  On completion,
+        this is sorted by volume and file identifier.
+
+ @param Count The number of elements in the array.
+
+ @return The number of distinct copies of the data.
+ */
+DWORD
+DedupeCountDistinctFiles(
+    __inout PDEDUPE_FILE *Files,
+    __in DWORD Count
+    )
+{
+    DWORD Index;
+    DWORD Distinct;
+
+    if (Count == 0) {
+        return 0;
+    }
+
+    DedupeSortFiles(Files, Count, DedupeCompareFileId, 0);
+
+    Distinct = 1;
+    for (Index = 1; Index < Count; Index++) {
+        if (DedupeCompareFileId(Files[Index - 1], Files[Index], 0) != 0) {
+            Distinct++;
+        }
+    }
+
+    return Distinct;
+}
+
+// vim:sw=4:ts=4:et:
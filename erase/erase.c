@@ -35,10 +35,11 @@ CHAR strEraseHelpText[] =
         "\n"
         "Delete one or more files.\n"
         "\n"
-        "ERASE [-license] [-b] [-r] [-s] <file> [<file>...]\n"
+        "ERASE [-license] [-b] [-d] [-r] [-s] <file> [<file>...]\n"
         "\n"
         "   --             Treat all further arguments as files to delete\n"
         "   -b             Use basic search criteria for files only\n"
+        "   -d             Remove matching directories once they are empty\n"
         "   -r             Send files to the recycle bin\n"
         "   -s             Erase all files matching the pattern in all subdirectories\n";
 
@@ -56,6 +57,55 @@ EraseHelp()
     return TRUE;
 }
 
+/**
+ The maximum number of threads to use when erasing files concurrently.
+ */
+#define ERASE_MAX_THREADS 8
+
+/**
+ The maximum number of files to erase as a single unit of work.
+ */
+#define ERASE_BATCH_FILE_COUNT 256
+
+/**
+ The number of characters of file paths that a single unit of work can hold.
+ This is large enough to hold the longest possible path.
+ */
+#define ERASE_BATCH_BUFFER_LENGTH (64 * 1024)
+
+/**
+ A set of paths to erase, which is processed as a single unit of work.
+ */
+typedef struct _ERASE_BATCH {
+
+    /**
+     The link for this batch within a list of batches.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The number of valid elements in the Files array.
+     */
+    DWORD FileCount;
+
+    /**
+     The number of characters of Buffer that are in use.
+     */
+    DWORD BufferUsed;
+
+    /**
+     The paths to erase.  Each refers to a NULL terminated string within
+     Buffer.
+     */
+    YORI_STRING Files[ERASE_BATCH_FILE_COUNT];
+
+    /**
+     Storage for the paths to erase.
+     */
+    TCHAR Buffer[ERASE_BATCH_BUFFER_LENGTH];
+
+} ERASE_BATCH, *PERASE_BATCH;
+
 /**
  A structure passed to each file found.
  */
@@ -66,13 +116,537 @@ typedef struct _ERASE_CONTEXT {
      */
     BOOL RecycleBin;
 
+    /**
+     TRUE if matching directories should be removed once their contents have
+     been erased.
+     */
+    BOOL RemoveDirectories;
+
+    /**
+     Set to TRUE if the file system has rejected a request to delete with
+     POSIX semantics, so that later files go straight to DeleteFile.
+     */
+    BOOL PosixDeleteUnsupported;
+
+    /**
+     Set to TRUE if the file system has rejected a request to delete with
+     POSIX semantics ignoring the read only attribute, but may support
+     POSIX semantics without it.
+     */
+    BOOL IgnoreReadOnlyUnsupported;
+
+    /**
+     TRUE once enumeration has finished and no more batches will be queued.
+     */
+    BOOL EnumerationComplete;
+
     /**
      The number of files found.
      */
     DWORDLONG FilesFound;
 
+    /**
+     The batch that files are currently being added to.
+     */
+    PERASE_BATCH CurrentBatch;
+
+    /**
+     A list of batches which are waiting to be processed by a worker thread.
+     */
+    YORI_LIST_ENTRY PendingBatches;
+
+    /**
+     A list of batches of directories to remove once all files have been
+     erased.  Directories are added in the order they are enumerated, which
+     returns subdirectories before their parents.
+     */
+    YORI_LIST_ENTRY DirectoryBatches;
+
+    /**
+     A mutex protecting PendingBatches and EnumerationComplete.
+     */
+    HANDLE Mutex;
+
+    /**
+     A semaphore which is signalled for each batch added to PendingBatches,
+     and once for each worker thread when enumeration is complete.
+     */
+    HANDLE WorkAvailable;
+
+    /**
+     A semaphore limiting the number of batches that can be waiting for a
+     worker thread, so enumeration doesn't consume unbounded memory when it
+     runs ahead of deletion.
+     */
+    HANDLE SlotAvailable;
+
+    /**
+     The number of worker threads.  If zero, batches are processed on the
+     enumerating thread as they are filled.
+     */
+    DWORD ThreadCount;
+
+    /**
+     Handles to the worker threads.
+     */
+    HANDLE Threads[ERASE_MAX_THREADS];
+
 } ERASE_CONTEXT, *PERASE_CONTEXT;
 
+/**
+ Delete a file or an empty directory.  Where the system supports it, this
+ deletes with POSIX semantics so the name is removed immediately even if
+ another process has the file open, which allows the parent directory to be
+ removed without waiting for that handle to close.
+
+ @param EraseContext Pointer to the erase context.
+
+ @param FilePath Pointer to the path of the object to delete.
+
+ @param Directory TRUE if the object is a directory, FALSE if it is a file.
+
+ @return A Win32 error code, NO_ERROR to indicate success.
+ */
+DWORD
+EraseDeleteObject(
+    __in PERASE_CONTEXT EraseContext,
+    __in PYORI_STRING FilePath,
+    __in BOOL Directory
+    )
+{
+    FILE_DISPOSITION_INFO_EX DispositionInfo;
+    HANDLE FileHandle;
+    DWORD Err;
+    DWORD OldAttributes;
+    DWORD NewAttributes;
+
+    if (DllKernel32.pSetFileInformationByHandle != NULL &&
+        !EraseContext->PosixDeleteUnsupported) {
+
+        FileHandle = CreateFile(FilePath->StartOfString,
+                                DELETE,
+                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                NULL,
+                                OPEN_EXISTING,
+                                FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_REPARSE_POINT,
+                                NULL);
+
+        if (FileHandle != INVALID_HANDLE_VALUE) {
+            DispositionInfo.Flags = FILE_DISPOSITION_FLAG_DELETE |
+                                    FILE_DISPOSITION_FLAG_POSIX_SEMANTICS;
+            if (!EraseContext->IgnoreReadOnlyUnsupported) {
+                DispositionInfo.Flags |= FILE_DISPOSITION_FLAG_IGNORE_READONLY_ATTRIBUTE;
+            }
+
+            if (DllKernel32.pSetFileInformationByHandle(FileHandle, FileDispositionInfoEx, &DispositionInfo, sizeof(DispositionInfo))) {
+                CloseHandle(FileHandle);
+                return NO_ERROR;
+            }
+            Err = GetLastError();
+
+            //
+            //  Some systems support POSIX semantics but not ignoring the
+            //  read only attribute.  Try again without it, and if that
+            //  works, stop asking for it.  A read only file will then fail
+            //  with access denied, and is handled below.
+            //
+
+            if (Err == ERROR_INVALID_PARAMETER &&
+                !EraseContext->IgnoreReadOnlyUnsupported) {
+
+                DispositionInfo.Flags = FILE_DISPOSITION_FLAG_DELETE |
+                                        FILE_DISPOSITION_FLAG_POSIX_SEMANTICS;
+
+                if (DllKernel32.pSetFileInformationByHandle(FileHandle, FileDispositionInfoEx, &DispositionInfo, sizeof(DispositionInfo))) {
+                    EraseContext->IgnoreReadOnlyUnsupported = TRUE;
+                    CloseHandle(FileHandle);
+                    return NO_ERROR;
+                }
+                Err = GetLastError();
+                if (Err != ERROR_INVALID_PARAMETER) {
+                    EraseContext->IgnoreReadOnlyUnsupported = TRUE;
+                }
+            }
+
+            //
+            //  Older systems and some file systems don't understand this
+            //  request.  Stop trying it and fall back to a regular delete.
+            //
+
+            CloseHandle(FileHandle);
+            if (Err == ERROR_INVALID_PARAMETER ||
+                Err == ERROR_INVALID_FUNCTION ||
+                Err == ERROR_NOT_SUPPORTED) {
+
+                EraseContext->PosixDeleteUnsupported = TRUE;
+            } else if (Err == ERROR_DIR_NOT_EMPTY) {
+                return Err;
+            }
+        }
+    }
+
+    Err = NO_ERROR;
+    if (Directory) {
+        if (!RemoveDirectory(FilePath->StartOfString)) {
+            Err = GetLastError();
+        }
+    } else {
+        if (!DeleteFile(FilePath->StartOfString)) {
+            Err = GetLastError();
+        }
+    }
+
+    //
+    //  If it fails with access denied, try to remove any readonly, hidden or
+    //  system attributes which might be getting in the way, then try the
+    //  delete again.
+    //
+
+    if (Err == ERROR_ACCESS_DENIED) {
+        OldAttributes = GetFileAttributes(FilePath->StartOfString);
+        NewAttributes = OldAttributes & ~(FILE_ATTRIBUTE_READONLY | FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM);
+
+        if (OldAttributes != NewAttributes) {
+            SetFileAttributes(FilePath->StartOfString, NewAttributes);
+
+            Err = NO_ERROR;
+
+            if (Directory) {
+                if (!RemoveDirectory(FilePath->StartOfString)) {
+                    Err = GetLastError();
+                }
+            } else {
+                if (!DeleteFile(FilePath->StartOfString)) {
+                    Err = GetLastError();
+                }
+            }
+
+            if (Err != NO_ERROR) {
+                SetFileAttributes(FilePath->StartOfString, OldAttributes);
+            }
+        }
+    }
+
+    return Err;
+}
+
+/**
+ Allocate a batch with no files in it.
+
+ @return Pointer to the batch, or NULL on allocation failure.
+ */
+PERASE_BATCH
+EraseAllocateBatch()
+{
+    PERASE_BATCH Batch;
+
+    Batch = YoriLibMalloc(sizeof(ERASE_BATCH));
+    if (Batch == NULL) {
+        return NULL;
+    }
+
+    Batch->FileCount = 0;
+    Batch->BufferUsed = 0;
+    return Batch;
+}
+
+/**
+ Add a path to a batch if there is room for it.
+
+ @param Batch Pointer to the batch.
+
+ @param FilePath Pointer to the path to add.
+
+ @return TRUE if the path was added, FALSE if the batch is full.
+ */
+BOOL
+EraseAddToBatch(
+    __inout PERASE_BATCH Batch,
+    __in PYORI_STRING FilePath
+    )
+{
+    PYORI_STRING BatchPath;
+
+    if (Batch->FileCount >= ERASE_BATCH_FILE_COUNT ||
+        FilePath->LengthInChars >= ERASE_BATCH_BUFFER_LENGTH - Batch->BufferUsed) {
+
+        return FALSE;
+    }
+
+    BatchPath = &Batch->Files[Batch->FileCount];
+    YoriLibInitEmptyString(BatchPath);
+    BatchPath->StartOfString = &Batch->Buffer[Batch->BufferUsed];
+    BatchPath->LengthInChars = FilePath->LengthInChars;
+    BatchPath->LengthAllocated = FilePath->LengthInChars + 1;
+    memcpy(BatchPath->StartOfString, FilePath->StartOfString, FilePath->LengthInChars * sizeof(TCHAR));
+    BatchPath->StartOfString[FilePath->LengthInChars] = '\0';
+
+    Batch->BufferUsed += BatchPath->LengthAllocated;
+    Batch->FileCount++;
+    return TRUE;
+}
+
+/**
+ Erase every file in a batch.  If the user requested the recycle bin, the
+ whole batch is recycled in one operation.  If that fails, each file that
+ remains is recycled individually, and only files that can't be recycled are
+ deleted directly.
+
+ @param EraseContext Pointer to the erase context.
+
+ @param Batch Pointer to the batch of files to erase.
+ */
+VOID
+EraseProcessBatch(
+    __in PERASE_CONTEXT EraseContext,
+    __in PERASE_BATCH Batch
+    )
+{
+    DWORD Index;
+    DWORD Err;
+    LPTSTR ErrText;
+    BOOL RecycleEach;
+
+    if (YoriLibIsOperationCancelled()) {
+        return;
+    }
+
+    RecycleEach = FALSE;
+    if (EraseContext->RecycleBin) {
+        if (YoriLibRecycleBinFiles(Batch->FileCount, Batch->Files)) {
+            return;
+        }
+        RecycleEach = TRUE;
+    }
+
+    for (Index = 0; Index < Batch->FileCount; Index++) {
+
+        //
+        //  If the batch couldn't be recycled, some files may have been
+        //  recycled anyway, so skip those that no longer exist.  The
+        //  others should still go to the recycle bin unless they can't.
+        //
+
+        if (RecycleEach) {
+            if (GetFileAttributes(Batch->Files[Index].StartOfString) == (DWORD)-1) {
+                continue;
+            }
+
+            if (YoriLibRecycleBinFile(&Batch->Files[Index])) {
+                continue;
+            }
+        }
+
+        Err = EraseDeleteObject(EraseContext, &Batch->Files[Index], FALSE);
+        if (Err != NO_ERROR) {
+            ErrText = YoriLibGetWinErrorText(Err);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("erase: delete of %y failed: %s"), &Batch->Files[Index], ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+        }
+    }
+}
+
+/**
+ A worker thread which erases batches of files until enumeration is
+ complete and no batches remain.
+
+ @param Context Pointer to the erase context.
+
+ @return Zero.
+ */
+DWORD WINAPI
+EraseWorker(
+    __in PVOID Context
+    )
+{
+    PERASE_CONTEXT EraseContext = (PERASE_CONTEXT)Context;
+    PYORI_LIST_ENTRY ListEntry;
+    PERASE_BATCH Batch;
+
+    while (TRUE) {
+
+        WaitForSingleObject(EraseContext->WorkAvailable, INFINITE);
+        WaitForSingleObject(EraseContext->Mutex, INFINITE);
+        ListEntry = YoriLibGetNextListEntry(&EraseContext->PendingBatches, NULL);
+        if (ListEntry == NULL) {
+            ASSERT(EraseContext->EnumerationComplete);
+            ReleaseMutex(EraseContext->Mutex);
+            break;
+        }
+        YoriLibRemoveListItem(ListEntry);
+        ReleaseMutex(EraseContext->Mutex);
+        ReleaseSemaphore(EraseContext->SlotAvailable, 1, NULL);
+
+        Batch = CONTAINING_RECORD(ListEntry, ERASE_BATCH, ListEntry);
+        EraseProcessBatch(EraseContext, Batch);
+        YoriLibFree(Batch);
+    }
+
+    return 0;
+}
+
+/**
+ Create worker threads to erase files.  If threads cannot be created, files
+ are erased on the enumerating thread instead.
+
+ @param EraseContext Pointer to the erase context.
+
+ @param MaxThreads The number of worker threads to create.
+ */
+VOID
+EraseStartWorkers(
+    __inout PERASE_CONTEXT EraseContext,
+    __in DWORD MaxThreads
+    )
+{
+    DWORD ThreadId;
+
+    EraseContext->ThreadCount = 0;
+    if (MaxThreads > ERASE_MAX_THREADS) {
+        MaxThreads = ERASE_MAX_THREADS;
+    }
+
+    if (MaxThreads == 0) {
+        return;
+    }
+
+    EraseContext->Mutex = CreateMutex(NULL, FALSE, NULL);
+    EraseContext->WorkAvailable = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+    EraseContext->SlotAvailable = CreateSemaphore(NULL, MaxThreads * 2, MaxThreads * 2, NULL);
+
+    if (EraseContext->Mutex != NULL &&
+        EraseContext->WorkAvailable != NULL &&
+        EraseContext->SlotAvailable != NULL) {
+
+        while (EraseContext->ThreadCount < MaxThreads) {
+            EraseContext->Threads[EraseContext->ThreadCount] = CreateThread(NULL, 0, EraseWorker, EraseContext, 0, &ThreadId);
+            if (EraseContext->Threads[EraseContext->ThreadCount] == NULL) {
+                break;
+            }
+            EraseContext->ThreadCount++;
+        }
+    }
+}
+
+/**
+ Process a full batch of files, either by handing it to a worker thread or
+ by erasing its files on the current thread.
+
+ @param EraseContext Pointer to the erase context.
+
+ @param Batch Pointer to the batch.  This is freed once processed, so the
+        caller should not refer to it after this call.
+ */
+VOID
+EraseSubmitBatch(
+    __in PERASE_CONTEXT EraseContext,
+    __in PERASE_BATCH Batch
+    )
+{
+    if (EraseContext->ThreadCount == 0) {
+        EraseProcessBatch(EraseContext, Batch);
+        YoriLibFree(Batch);
+        return;
+    }
+
+    WaitForSingleObject(EraseContext->SlotAvailable, INFINITE);
+    WaitForSingleObject(EraseContext->Mutex, INFINITE);
+    YoriLibAppendList(&EraseContext->PendingBatches, &Batch->ListEntry);
+    ReleaseMutex(EraseContext->Mutex);
+    ReleaseSemaphore(EraseContext->WorkAvailable, 1, NULL);
+}
+
+/**
+ Process any partially filled batch, wait for worker threads to erase all
+ files, and clean up the worker threads.
+
+ @param EraseContext Pointer to the erase context.
+ */
+VOID
+EraseStopWorkers(
+    __inout PERASE_CONTEXT EraseContext
+    )
+{
+    DWORD Index;
+
+    if (EraseContext->CurrentBatch != NULL) {
+        if (EraseContext->CurrentBatch->FileCount > 0) {
+            EraseSubmitBatch(EraseContext, EraseContext->CurrentBatch);
+        } else {
+            YoriLibFree(EraseContext->CurrentBatch);
+        }
+        EraseContext->CurrentBatch = NULL;
+    }
+
+    if (EraseContext->ThreadCount > 0) {
+        WaitForSingleObject(EraseContext->Mutex, INFINITE);
+        EraseContext->EnumerationComplete = TRUE;
+        ReleaseMutex(EraseContext->Mutex);
+        ReleaseSemaphore(EraseContext->WorkAvailable, EraseContext->ThreadCount, NULL);
+
+        WaitForMultipleObjects(EraseContext->ThreadCount, EraseContext->Threads, TRUE, INFINITE);
+        for (Index = 0; Index < EraseContext->ThreadCount; Index++) {
+            CloseHandle(EraseContext->Threads[Index]);
+        }
+        EraseContext->ThreadCount = 0;
+    }
+
+    if (EraseContext->Mutex != NULL) {
+        CloseHandle(EraseContext->Mutex);
+        EraseContext->Mutex = NULL;
+    }
+    if (EraseContext->WorkAvailable != NULL) {
+        CloseHandle(EraseContext->WorkAvailable);
+        EraseContext->WorkAvailable = NULL;
+    }
+    if (EraseContext->SlotAvailable != NULL) {
+        CloseHandle(EraseContext->SlotAvailable);
+        EraseContext->SlotAvailable = NULL;
+    }
+}
+
+/**
+ Remove directories found during enumeration.  This occurs once all files
+ have been erased, and directories are processed in the order they were
+ found, so each directory is removed after its subdirectories.  Directories
+ which still contain objects that did not match are left in place.
+
+ @param EraseContext Pointer to the erase context.
+ */
+VOID
+EraseRemoveDirectories(
+    __inout PERASE_CONTEXT EraseContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PERASE_BATCH Batch;
+    DWORD Index;
+    DWORD Err;
+    LPTSTR ErrText;
+
+    ListEntry = YoriLibGetNextListEntry(&EraseContext->DirectoryBatches, NULL);
+    while (ListEntry != NULL) {
+        YoriLibRemoveListItem(ListEntry);
+        Batch = CONTAINING_RECORD(ListEntry, ERASE_BATCH, ListEntry);
+
+        for (Index = 0; Index < Batch->FileCount; Index++) {
+            if (YoriLibIsOperationCancelled()) {
+                break;
+            }
+
+            Err = EraseDeleteObject(EraseContext, &Batch->Files[Index], TRUE);
+            if (Err != NO_ERROR && Err != ERROR_DIR_NOT_EMPTY) {
+                ErrText = YoriLibGetWinErrorText(Err);
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("erase: rmdir of %y failed: %s"), &Batch->Files[Index], ErrText);
+                YoriLibFreeWinErrorText(ErrText);
+            }
+        }
+
+        YoriLibFree(Batch);
+        ListEntry = YoriLibGetNextListEntry(&EraseContext->DirectoryBatches, NULL);
+    }
+}
+
 /**
  A callback that is invoked when a file is found that matches a search criteria
  specified in the set of strings to enumerate.
@@ -96,63 +670,62 @@ EraseFileFoundCallback(
     __in PVOID Context
     )
 {
-    DWORD Err;
-    LPTSTR ErrText;
-    BOOLEAN FileDeleted;
     PERASE_CONTEXT EraseContext = (PERASE_CONTEXT)Context;
+    PYORI_LIST_ENTRY ListEntry;
+    PERASE_BATCH Batch;
 
     UNREFERENCED_PARAMETER(Depth);
 
     ASSERT(YoriLibIsStringNullTerminated(FilePath));
 
-    FileDeleted = FALSE;
-    if ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+    //
+    //  Directories are queued to be removed after all files have been
+    //  erased.
+    //
+
+    if (FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+        if (!EraseContext->RemoveDirectories) {
+            return TRUE;
+        }
 
         EraseContext->FilesFound++;
 
-        //
-        //  If the user wanted it deleted via the recycle bin, try that.
-        //
+        Batch = NULL;
+        ListEntry = YoriLibGetPreviousListEntry(&EraseContext->DirectoryBatches, NULL);
+        if (ListEntry != NULL) {
+            Batch = CONTAINING_RECORD(ListEntry, ERASE_BATCH, ListEntry);
+        }
 
-        if (EraseContext->RecycleBin) {
-            if (YoriLibRecycleBinFile(FilePath)) {
-                FileDeleted = TRUE;
+        if (Batch == NULL || !EraseAddToBatch(Batch, FilePath)) {
+            Batch = EraseAllocateBatch();
+            if (Batch == NULL) {
+                return FALSE;
             }
+            YoriLibAppendList(&EraseContext->DirectoryBatches, &Batch->ListEntry);
+            EraseAddToBatch(Batch, FilePath);
         }
+        return TRUE;
+    }
 
-        //
-        //  If the user didn't ask for recycle bin or if that failed, delete
-        //  directly.
-        //
+    EraseContext->FilesFound++;
 
-        if (!FileDeleted && !DeleteFile(FilePath->StartOfString)) {
-            Err = GetLastError();
-            if (Err == ERROR_ACCESS_DENIED) {
-                DWORD OldAttributes = GetFileAttributes(FilePath->StartOfString);
-                DWORD NewAttributes = OldAttributes & ~(FILE_ATTRIBUTE_READONLY | FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM);
-        
-                if (OldAttributes != NewAttributes) {
-                    SetFileAttributes(FilePath->StartOfString, NewAttributes);
-        
-                    Err = NO_ERROR;
-        
-                    if (!DeleteFile(FilePath->StartOfString)) {
-                        Err = GetLastError();
-                    }
-        
-                    if (Err != NO_ERROR) {
-                        SetFileAttributes(FilePath->StartOfString, OldAttributes);
-                    }
-                }
-            }
+    if (EraseContext->CurrentBatch != NULL &&
+        EraseAddToBatch(EraseContext->CurrentBatch, FilePath)) {
 
-            if (Err != NO_ERROR) {
-                ErrText = YoriLibGetWinErrorText(Err);
-                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("erase: delete of %y failed: %s"), FilePath, ErrText);
-                YoriLibFreeWinErrorText(ErrText);
-            }
-        }
+        return TRUE;
     }
+
+    if (EraseContext->CurrentBatch != NULL) {
+        EraseSubmitBatch(EraseContext, EraseContext->CurrentBatch);
+        EraseContext->CurrentBatch = NULL;
+    }
+
+    EraseContext->CurrentBatch = EraseAllocateBatch();
+    if (EraseContext->CurrentBatch == NULL) {
+        return FALSE;
+    }
+
+    EraseAddToBatch(EraseContext->CurrentBatch, FilePath);
     return TRUE;
 }
 
@@ -245,10 +818,14 @@ ENTRYPOINT(
     BOOL BasicEnumeration;
     DWORD StartArg = 0;
     DWORD i;
+    DWORD ThreadCount;
     ERASE_CONTEXT Context;
     YORI_STRING Arg;
+    SYSTEM_INFO SystemInfo;
 
     ZeroMemory(&Context, sizeof(Context));
+    YoriLibInitializeListHead(&Context.PendingBatches);
+    YoriLibInitializeListHead(&Context.DirectoryBatches);
     Recursive = FALSE;
     BasicEnumeration = FALSE;
 
@@ -268,6 +845,9 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("b")) == 0) {
                 BasicEnumeration = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("d")) == 0) {
+                Context.RemoveDirectories = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("r")) == 0) {
                 Context.RecycleBin = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -300,6 +880,25 @@ ENTRYPOINT(
     YoriLibCancelEnable();
 #endif
 
+    YoriLibLoadKernel32Functions();
+
+    //
+    //  When erasing a tree, enumeration and deletion overlap, with files
+    //  deleted on worker threads.  Shell serializes recycle bin updates, so
+    //  recycling only needs one worker.
+    //
+
+    ThreadCount = 0;
+    if (Recursive) {
+        GetSystemInfo(&SystemInfo);
+        ThreadCount = SystemInfo.dwNumberOfProcessors;
+        if (Context.RecycleBin) {
+            ThreadCount = 1;
+        }
+    }
+
+    EraseStartWorkers(&Context, ThreadCount);
+
     MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_DIRECTORY_CONTENTS;
     if (Recursive) {
         MatchFlags |= YORILIB_FILEENUM_RECURSE_BEFORE_RETURN | YORILIB_FILEENUM_RECURSE_PRESERVE_WILD;
@@ -307,17 +906,27 @@ ENTRYPOINT(
     if (BasicEnumeration) {
         MatchFlags |= YORILIB_FILEENUM_BASIC_EXPANSION;
     }
+    if (Context.RemoveDirectories) {
+        MatchFlags |= YORILIB_FILEENUM_RETURN_DIRECTORIES;
+    }
 
     for (i = StartArg; i < ArgC; i++) {
 
-        YoriLibForEachStream(&ArgV[i],
-                             MatchFlags,
-                             0,
-                             EraseFileFoundCallback,
-                             EraseFileEnumerateErrorCallback,
-                             &Context);
+        if (!YoriLibForEachStream(&ArgV[i],
+                                  MatchFlags,
+                                  0,
+                                  EraseFileFoundCallback,
+                                  EraseFileEnumerateErrorCallback,
+                                  &Context) &&
+            YoriLibIsOperationCancelled()) {
+
+            break;
+        }
     }
 
+    EraseStopWorkers(&Context);
+    EraseRemoveDirectories(&Context);
+
     if (Context.FilesFound == 0) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("erase: no matching files found\n"));
         return EXIT_FAILURE;
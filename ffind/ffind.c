@@ -0,0 +1,813 @@
+/**
+ * @file ffind/ffind.c
+ *
+ * Yori find files on a volume by name using the change journal
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "ffind.h"
+
+/**
+ Help text to display to the user.
+ */
+const
+CHAR strFfindHelpText[] =
+        "\n"
+        "Find files anywhere on an NTFS volume by name using the change journal.\n"
+        "\n"
+        "FFIND [-license] [-f <criteria>] [-i <index file>] [-u] <volume> [<pattern>]\n"
+        "\n"
+        "   -f             Only display files matching the specified criteria\n"
+        "   -i             Load the index from a file, update it from the change\n"
+        "                    journal, and save it back to the file\n"
+        "   -u             Update the index file without searching\n"
+        "\n"
+        " Reading the change journal requires administrative privilege.\n"
+        " If no pattern is specified, all files are displayed.\n";
+
+/**
+ Display usage text to the user.
+ */
+BOOL
+FfindHelp()
+{
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Ffind %i.%02i\n"), FFIND_VER_MAJOR, FFIND_VER_MINOR);
+#if YORI_BUILD_ID
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Build %i\n"), YORI_BUILD_ID);
+#endif
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%hs"), strFfindHelpText);
+
+    //
+    //  Display supported options and operators
+    //
+
+    YoriLibFileFiltHelp();
+    return TRUE;
+}
+
+/**
+ The size of the buffer used to receive USN records from the file system.
+ */
+#define FFIND_USN_BUFFER_SIZE (64 * 1024)
+
+/**
+ The version 0 form of the input to FSCTL_ENUM_USN_DATA.  Later versions are
+ not understood by older systems, and this version is sufficient to return
+ version 2 records on all of them.
+ */
+typedef struct _FFIND_MFT_ENUM_DATA {
+
+    /**
+     The file reference number to resume enumeration from.
+     */
+    DWORDLONG StartFileReferenceNumber;
+
+    /**
+     Only return files whose most recent USN is at least this value.
+     */
+    LONGLONG LowUsn;
+
+    /**
+     Only return files whose most recent USN is at most this value.
+     */
+    LONGLONG HighUsn;
+
+} FFIND_MFT_ENUM_DATA;
+
+/**
+ The version 0 form of the input to FSCTL_READ_USN_JOURNAL.
+ */
+typedef struct _FFIND_READ_USN_JOURNAL_DATA {
+
+    /**
+     The USN to start reading from.
+     */
+    LONGLONG StartUsn;
+
+    /**
+     The set of reasons to return records for.
+     */
+    DWORD ReasonMask;
+
+    /**
+     If TRUE, only return records generated when a file is closed.
+     */
+    DWORD ReturnOnlyOnClose;
+
+    /**
+     The time to wait for more records.  Not used since BytesToWaitFor is
+     zero.
+     */
+    DWORDLONG Timeout;
+
+    /**
+     The number of bytes of records to wait for.  Zero indicates the
+     request should return immediately.
+     */
+    DWORDLONG BytesToWaitFor;
+
+    /**
+     The identifier of the journal which is expected to be active.
+     */
+    DWORDLONG UsnJournalID;
+
+} FFIND_READ_USN_JOURNAL_DATA;
+
+/**
+ Context passed to the callback which is invoked for each matching record.
+ */
+typedef struct _FFIND_CONTEXT {
+
+    /**
+     The volume name, without a trailing backslash, used as a prefix for
+     every path.
+     */
+    YORI_STRING VolumeName;
+
+    /**
+     A buffer used to construct the full path to each match.
+     */
+    YORI_STRING FullPath;
+
+    /**
+     A buffer used to construct the path to display for each match.
+     */
+    YORI_STRING DisplayPath;
+
+    /**
+     Filter criteria to apply to each match.  Files which do not meet the
+     criteria are not displayed.
+     */
+    YORI_LIB_FILE_FILTER Filter;
+
+    /**
+     The number of files displayed.
+     */
+    DWORD FilesFound;
+
+} FFIND_CONTEXT, *PFFIND_CONTEXT;
+
+/**
+ Apply each record in a buffer returned from FSCTL_ENUM_USN_DATA or
+ FSCTL_READ_USN_JOURNAL to the index.  Each buffer starts with the USN or
+ file reference number to resume from, followed by the records.
+
+ @param Index Pointer to the index to update.
+
+ @param Buffer Pointer to the buffer returned from the file system.
+
+ @param BytesReturned The number of bytes in the buffer.
+ */
+VOID
+FfindApplyUsnRecords(
+    __inout PFFIND_INDEX Index,
+    __in PUCHAR Buffer,
+    __in DWORD BytesReturned
+    )
+{
+    DWORD Offset;
+    PUSN_RECORD Record;
+    YORI_STRING Name;
+
+    YoriLibInitEmptyString(&Name);
+    Offset = sizeof(DWORDLONG);
+
+    while (Offset + FIELD_OFFSET(USN_RECORD, FileName) <= BytesReturned) {
+        Record = (PUSN_RECORD)(Buffer + Offset);
+        if (Record->RecordLength < FIELD_OFFSET(USN_RECORD, FileName) ||
+            Record->RecordLength > BytesReturned - Offset) {
+
+            break;
+        }
+
+        //
+        //  Only version 2 records are understood.  A rename generates a
+        //  record for the old name followed by one for the new name, so
+        //  the old name can be ignored.
+        //
+
+        if (Record->MajorVersion == 2 &&
+            (DWORD)Record->FileNameOffset + Record->FileNameLength <= Record->RecordLength) {
+
+            if (Record->Reason & USN_REASON_FILE_DELETE) {
+                FfindIndexDelete(Index, Record->FileReferenceNumber);
+            } else if ((Record->Reason & USN_REASON_RENAME_OLD_NAME) == 0) {
+                Name.StartOfString = (LPTSTR)((PUCHAR)Record + Record->FileNameOffset);
+                Name.LengthInChars = Record->FileNameLength / sizeof(WCHAR);
+                FfindIndexUpsert(Index, Record->FileReferenceNumber, Record->ParentFileReferenceNumber, &Name, Record->FileAttributes);
+            }
+        }
+
+        Offset += Record->RecordLength;
+    }
+}
+
+/**
+ Populate an empty index with every file on the volume by enumerating the
+ MFT.
+
+ @param VolumeHandle A handle to the volume.
+
+ @param Index Pointer to the index to populate.
+
+ @param HighUsn The highest USN to return records for.
+
+ @param Buffer Pointer to a buffer of FFIND_USN_BUFFER_SIZE bytes to receive
+        records.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+FfindBuildIndexFromVolume(
+    __in HANDLE VolumeHandle,
+    __inout PFFIND_INDEX Index,
+    __in LONGLONG HighUsn,
+    __in PUCHAR Buffer
+    )
+{
+    FFIND_MFT_ENUM_DATA EnumData;
+    DWORD BytesReturned;
+    DWORD Err;
+    LPTSTR ErrText;
+
+    EnumData.StartFileReferenceNumber = 0;
+    EnumData.LowUsn = 0;
+    EnumData.HighUsn = HighUsn;
+
+    while (DeviceIoControl(VolumeHandle, FSCTL_ENUM_USN_DATA, &EnumData, sizeof(EnumData), Buffer, FFIND_USN_BUFFER_SIZE, &BytesReturned, NULL)) {
+        if (BytesReturned < sizeof(DWORDLONG)) {
+            break;
+        }
+        FfindApplyUsnRecords(Index, Buffer, BytesReturned);
+        EnumData.StartFileReferenceNumber = *(PDWORDLONG)Buffer;
+    }
+
+    //
+    //  The enumerate completes by failing with end of file.
+    //
+
+    Err = GetLastError();
+    if (Err != ERROR_HANDLE_EOF && Err != ERROR_SUCCESS) {
+        ErrText = YoriLibGetWinErrorText(Err);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ffind: could not enumerate volume: %s"), ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Apply every change recorded in the change journal since the index was last
+ updated.
+
+ @param VolumeHandle A handle to the volume.
+
+ @param Index Pointer to the index to update.  On successful completion, the
+        index's NextUsn is updated to reflect the changes applied.
+
+ @param JournalData Information about the active change journal.
+
+ @param Buffer Pointer to a buffer of FFIND_USN_BUFFER_SIZE bytes to receive
+        records.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+FfindUpdateIndexFromJournal(
+    __in HANDLE VolumeHandle,
+    __inout PFFIND_INDEX Index,
+    __in PUSN_JOURNAL_DATA JournalData,
+    __in PUCHAR Buffer
+    )
+{
+    FFIND_READ_USN_JOURNAL_DATA ReadData;
+    DWORD BytesReturned;
+    DWORDLONG NextUsn;
+    LPTSTR ErrText;
+
+    ZeroMemory(&ReadData, sizeof(ReadData));
+    ReadData.StartUsn = Index->NextUsn;
+    ReadData.ReasonMask = (DWORD)-1;
+    ReadData.UsnJournalID = JournalData->UsnJournalID;
+
+    while ((DWORDLONG)ReadData.StartUsn < JournalData->NextUsn) {
+        if (!DeviceIoControl(VolumeHandle, FSCTL_READ_USN_JOURNAL, &ReadData, sizeof(ReadData), Buffer, FFIND_USN_BUFFER_SIZE, &BytesReturned, NULL)) {
+            ErrText = YoriLibGetWinErrorText(GetLastError());
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ffind: could not read change journal: %s"), ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            return FALSE;
+        }
+
+        if (BytesReturned < sizeof(DWORDLONG)) {
+            break;
+        }
+
+        FfindApplyUsnRecords(Index, Buffer, BytesReturned);
+        NextUsn = *(PDWORDLONG)Buffer;
+        if (NextUsn <= (DWORDLONG)ReadData.StartUsn) {
+            break;
+        }
+        ReadData.StartUsn = NextUsn;
+    }
+
+    Index->NextUsn = ReadData.StartUsn;
+    return TRUE;
+}
+
+/**
+ Load a previously saved index from a file.
+
+ @param FileName The full path to the index file.
+
+ @param Index Pointer to an empty index to populate.
+
+ @return TRUE if the index was loaded, FALSE if the file does not exist or
+         is not a valid index.
+ */
+BOOL
+FfindLoadIndex(
+    __in PYORI_STRING FileName,
+    __inout PFFIND_INDEX Index
+    )
+{
+    HANDLE FileHandle;
+    DWORD FileSizeHigh;
+    DWORD FileSize;
+    DWORD BytesRead;
+    PVOID Buffer;
+    BOOL Result;
+
+    FileHandle = CreateFile(FileName->StartOfString,
+                            GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    FileSize = GetFileSize(FileHandle, &FileSizeHigh);
+    if (FileSizeHigh != 0 || FileSize == (DWORD)-1 || FileSize == 0) {
+        CloseHandle(FileHandle);
+        return FALSE;
+    }
+
+    Buffer = YoriLibMalloc(FileSize);
+    if (Buffer == NULL) {
+        CloseHandle(FileHandle);
+        return FALSE;
+    }
+
+    Result = FALSE;
+    if (ReadFile(FileHandle, Buffer, FileSize, &BytesRead, NULL) &&
+        BytesRead == FileSize) {
+
+        Result = FfindIndexDeserialize(Index, Buffer, FileSize);
+    }
+
+    YoriLibFree(Buffer);
+    CloseHandle(FileHandle);
+    return Result;
+}
+
+/**
+ Save an index to a file.
+
+ @param FileName The full path to the index file.
+
+ @param Index Pointer to the index to save.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+FfindSaveIndex(
+    __in PYORI_STRING FileName,
+    __in PFFIND_INDEX Index
+    )
+{
+    HANDLE FileHandle;
+    DWORD BufferLength;
+    DWORD BytesWritten;
+    PVOID Buffer;
+    BOOL Result;
+    LPTSTR ErrText;
+
+    if (!FfindIndexSerialize(Index, &Buffer, &BufferLength)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ffind: index too large to save\n"));
+        return FALSE;
+    }
+
+    FileHandle = CreateFile(FileName->StartOfString,
+                            GENERIC_WRITE,
+                            FILE_SHARE_DELETE,
+                            NULL,
+                            CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        ErrText = YoriLibGetWinErrorText(GetLastError());
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ffind: could not open %y: %s"), FileName, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        YoriLibFree(Buffer);
+        return FALSE;
+    }
+
+    Result = TRUE;
+    if (!WriteFile(FileHandle, Buffer, BufferLength, &BytesWritten, NULL) ||
+        BytesWritten != BufferLength) {
+
+        ErrText = YoriLibGetWinErrorText(GetLastError());
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ffind: could not write %y: %s"), FileName, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        Result = FALSE;
+    }
+
+    YoriLibFree(Buffer);
+    CloseHandle(FileHandle);
+    return Result;
+}
+
+/**
+ Determine the file reference number of the root directory of a volume, so
+ that paths can be constructed up to it.
+
+ @param VolumeName The name of the volume, without a trailing backslash.
+
+ @param RootFrn On successful completion, updated to contain the file
+        reference number of the root directory.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+FfindGetRootFrn(
+    __in PYORI_STRING VolumeName,
+    __out PDWORDLONG RootFrn
+    )
+{
+    YORI_STRING RootName;
+    HANDLE RootHandle;
+    BY_HANDLE_FILE_INFORMATION FileInfo;
+    BOOL Result;
+
+    YoriLibInitEmptyString(&RootName);
+    if (YoriLibYPrintf(&RootName, _T("%y\\"), VolumeName) < 0 ||
+        RootName.StartOfString == NULL) {
+
+        return FALSE;
+    }
+
+    RootHandle = CreateFile(RootName.StartOfString,
+                            FILE_READ_ATTRIBUTES,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_FLAG_BACKUP_SEMANTICS,
+                            NULL);
+
+    YoriLibFreeStringContents(&RootName);
+    if (RootHandle == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    Result = GetFileInformationByHandle(RootHandle, &FileInfo);
+    CloseHandle(RootHandle);
+    if (!Result) {
+        return FALSE;
+    }
+
+    *RootFrn = ((DWORDLONG)FileInfo.nFileIndexHigh << 32) | FileInfo.nFileIndexLow;
+    return TRUE;
+}
+
+/**
+ A callback invoked for each record in the index which matches the search
+ pattern.
+
+ @param Index Pointer to the index.
+
+ @param RecordIndex The index of the matching record.
+
+ @param Context Pointer to the ffind context.
+
+ @return TRUE to continue searching, FALSE to stop.
+ */
+BOOL
+FfindDisplayMatch(
+    __in PFFIND_INDEX Index,
+    __in DWORD RecordIndex,
+    __in PVOID Context
+    )
+{
+    PFFIND_CONTEXT FfindContext = (PFFIND_CONTEXT)Context;
+    WIN32_FIND_DATA FindData;
+
+    if (!FfindIndexBuildPath(Index, RecordIndex, &FfindContext->VolumeName, &FfindContext->FullPath)) {
+        return TRUE;
+    }
+
+    //
+    //  The index only knows names and attributes, so evaluating filter
+    //  criteria requires opening each candidate.  This is only done for
+    //  files that already match the pattern.
+    //
+
+    if (FfindContext->Filter.NumberCriteria > 0) {
+        if (!YoriLibUpdateFindDataFromFileInformation(&FindData, FfindContext->FullPath.StartOfString, TRUE)) {
+            return TRUE;
+        }
+        if (!YoriLibFileFiltCheckFilterMatch(&FfindContext->Filter, &FfindContext->FullPath, &FindData)) {
+            return TRUE;
+        }
+    }
+
+    if (!YoriLibUnescapePath(&FfindContext->FullPath, &FfindContext->DisplayPath)) {
+        return TRUE;
+    }
+
+    FfindContext->FilesFound++;
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &FfindContext->DisplayPath);
+    return TRUE;
+}
+
+#ifdef YORI_BUILTIN
+/**
+ The main entrypoint for the ffind builtin command.
+ */
+#define ENTRYPOINT YoriCmd_FFIND
+#else
+/**
+ The main entrypoint for the ffind standalone application.
+ */
+#define ENTRYPOINT ymain
+#endif
+
+/**
+ The main entrypoint for the ffind cmdlet.
+
+ @param ArgC The number of arguments.
+
+ @param ArgV An array of arguments.
+
+ @return Exit code of the process, zero indicating success or nonzero on
+         failure.
+ */
+DWORD
+ENTRYPOINT(
+    __in DWORD ArgC,
+    __in YORI_STRING ArgV[]
+    )
+{
+    BOOL ArgumentUnderstood;
+    BOOL UpdateOnly = FALSE;
+    BOOL IndexLoaded = FALSE;
+    DWORD i;
+    DWORD StartArg = 0;
+    DWORD BytesReturned;
+    DWORD Result = EXIT_FAILURE;
+    HANDLE VolumeHandle = INVALID_HANDLE_VALUE;
+    PUCHAR Buffer = NULL;
+    PYORI_STRING IndexFileArg = NULL;
+    YORI_STRING IndexFileName;
+    YORI_STRING FullPathName;
+    YORI_STRING Arg;
+    YORI_LIB_FILE_MATCH_EXPRESSION Expression;
+    PYORI_LIB_FILE_MATCH_EXPRESSION QueryExpression = NULL;
+    USN_JOURNAL_DATA JournalData;
+    DWORDLONG RootFrn;
+    FFIND_INDEX Index;
+    FFIND_CONTEXT FfindContext;
+    LPTSTR ErrText;
+
+    ZeroMemory(&FfindContext, sizeof(FfindContext));
+    YoriLibInitEmptyString(&IndexFileName);
+    YoriLibInitEmptyString(&FullPathName);
+    FfindIndexInitialize(&Index);
+
+    for (i = 1; i < ArgC; i++) {
+
+        ArgumentUnderstood = FALSE;
+        ASSERT(YoriLibIsStringNullTerminated(&ArgV[i]));
+
+        if (YoriLibIsCommandLineOption(&ArgV[i], &Arg)) {
+
+            if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("?")) == 0) {
+                FfindHelp();
+                Result = EXIT_SUCCESS;
+                goto cleanup_and_exit;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("license")) == 0) {
+                YoriLibDisplayMitLicense(_T("2026"));
+                Result = EXIT_SUCCESS;
+                goto cleanup_and_exit;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("f")) == 0) {
+                if (i + 1 < ArgC) {
+                    YORI_STRING ErrorSubstring;
+                    YoriLibInitEmptyString(&ErrorSubstring);
+
+                    if (!YoriLibFileFiltParseFilterString(&FfindContext.Filter, &ArgV[i + 1], &ErrorSubstring)) {
+                        if (ErrorSubstring.LengthInChars > 0) {
+                            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ffind: error parsing filter string '%y' at '%y'\n"), &ArgV[i + 1], &ErrorSubstring);
+                        } else {
+                            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ffind: error parsing filter string '%y'\n"), &ArgV[i + 1]);
+                        }
+                        goto cleanup_and_exit;
+                    }
+                    i++;
+                    ArgumentUnderstood = TRUE;
+                }
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("i")) == 0) {
+                if (i + 1 < ArgC) {
+                    IndexFileArg = &ArgV[i + 1];
+                    i++;
+                    ArgumentUnderstood = TRUE;
+                }
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("u")) == 0) {
+                UpdateOnly = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("-")) == 0) {
+                StartArg = i + 1;
+                ArgumentUnderstood = TRUE;
+                break;
+            }
+        } else {
+            ArgumentUnderstood = TRUE;
+            StartArg = i;
+            break;
+        }
+
+        if (!ArgumentUnderstood) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Argument not understood, ignored: %y\n"), &ArgV[i]);
+        }
+    }
+
+    if (StartArg == 0 || StartArg >= ArgC) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ffind: missing argument\n"));
+        goto cleanup_and_exit;
+    }
+
+    if (UpdateOnly && IndexFileArg == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ffind: -u requires an index file\n"));
+        goto cleanup_and_exit;
+    }
+
+    if (StartArg + 1 < ArgC) {
+        if (!YoriLibCompileFileMatchExpression(&ArgV[StartArg + 1], &Expression)) {
+            goto cleanup_and_exit;
+        }
+        QueryExpression = &Expression;
+    }
+
+    if (IndexFileArg != NULL &&
+        !YoriLibUserStringToSingleFilePath(IndexFileArg, TRUE, &IndexFileName)) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ffind: failed to resolve %y\n"), IndexFileArg);
+        goto cleanup_and_exit;
+    }
+
+    //
+    //  Translate the user's path into a volume, and open it.
+    //
+
+    if (!YoriLibUserStringToSingleFilePath(&ArgV[StartArg], TRUE, &FullPathName) ||
+        !YoriLibGetVolumePathName(&FullPathName, &FfindContext.VolumeName)) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ffind: failed to resolve volume %y\n"), &ArgV[StartArg]);
+        goto cleanup_and_exit;
+    }
+
+    if (!FfindGetRootFrn(&FfindContext.VolumeName, &RootFrn)) {
+        ErrText = YoriLibGetWinErrorText(GetLastError());
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ffind: could not open root of %y: %s"), &FfindContext.VolumeName, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        goto cleanup_and_exit;
+    }
+
+    VolumeHandle = CreateFile(FfindContext.VolumeName.StartOfString,
+                              GENERIC_READ,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              NULL,
+                              OPEN_EXISTING,
+                              0,
+                              NULL);
+
+    if (VolumeHandle == INVALID_HANDLE_VALUE) {
+        ErrText = YoriLibGetWinErrorText(GetLastError());
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ffind: could not open volume %y: %s"), &FfindContext.VolumeName, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        goto cleanup_and_exit;
+    }
+
+    if (!DeviceIoControl(VolumeHandle, FSCTL_QUERY_USN_JOURNAL, NULL, 0, &JournalData, sizeof(JournalData), &BytesReturned, NULL)) {
+        ErrText = YoriLibGetWinErrorText(GetLastError());
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ffind: could not query change journal on %y: %s"), &FfindContext.VolumeName, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        goto cleanup_and_exit;
+    }
+
+    Buffer = YoriLibMalloc(FFIND_USN_BUFFER_SIZE);
+    if (Buffer == NULL) {
+        goto cleanup_and_exit;
+    }
+
+    //
+    //  A saved index can be brought up to date if it describes the same
+    //  volume and journal, and the journal still contains every change since
+    //  it was saved.  Otherwise it is discarded and rebuilt.
+    //
+
+    if (IndexFileName.StartOfString != NULL &&
+        FfindLoadIndex(&IndexFileName, &Index)) {
+
+        if (Index.RootFrn == RootFrn &&
+            Index.JournalId == JournalData.UsnJournalID &&
+            Index.NextUsn >= JournalData.FirstUsn &&
+            Index.NextUsn <= JournalData.NextUsn) {
+
+            IndexLoaded = TRUE;
+        } else {
+            FfindIndexCleanup(&Index);
+        }
+    }
+
+    if (!IndexLoaded) {
+        Index.RootFrn = RootFrn;
+        Index.JournalId = JournalData.UsnJournalID;
+        Index.NextUsn = JournalData.NextUsn;
+        if (!FfindBuildIndexFromVolume(VolumeHandle, &Index, (LONGLONG)JournalData.NextUsn, Buffer)) {
+            goto cleanup_and_exit;
+        }
+    }
+
+    //
+    //  Apply anything that changed since the index was saved, or while the
+    //  volume was being enumerated.  Changes made during enumeration may
+    //  already be reflected, but applying them again in order gives the
+    //  same result.
+    //
+
+    if (!DeviceIoControl(VolumeHandle, FSCTL_QUERY_USN_JOURNAL, NULL, 0, &JournalData, sizeof(JournalData), &BytesReturned, NULL) ||
+        !FfindUpdateIndexFromJournal(VolumeHandle, &Index, &JournalData, Buffer)) {
+
+        goto cleanup_and_exit;
+    }
+
+    if (IndexFileName.StartOfString != NULL &&
+        !FfindSaveIndex(&IndexFileName, &Index)) {
+
+        goto cleanup_and_exit;
+    }
+
+    if (!UpdateOnly) {
+        FfindIndexQuery(&Index, QueryExpression, FfindDisplayMatch, &FfindContext);
+    }
+
+    Result = EXIT_SUCCESS;
+
+cleanup_and_exit:
+
+    if (VolumeHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(VolumeHandle);
+    }
+    if (Buffer != NULL) {
+        YoriLibFree(Buffer);
+    }
+    if (QueryExpression != NULL) {
+        YoriLibFreeFileMatchExpression(QueryExpression);
+    }
+    FfindIndexCleanup(&Index);
+    YoriLibFileFiltFreeFilter(&FfindContext.Filter);
+    YoriLibFreeStringContents(&FfindContext.VolumeName);
+    YoriLibFreeStringContents(&FfindContext.FullPath);
+    YoriLibFreeStringContents(&FfindContext.DisplayPath);
+    YoriLibFreeStringContents(&FullPathName);
+    YoriLibFreeStringContents(&IndexFileName);
+
+    return Result;
+}
+
+// vim:sw=4:ts=4:et:
@@ -0,0 +1,329 @@
+/**
+ * @file ffind/ffind.h
+ *
+ * Yori volume wide file name index
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ A value used in place of a record index to indicate that no record is
+ present.
+ */
+#define FFIND_NO_RECORD ((DWORD)-1)
+
+/**
+ Indicates that a record slot is not in use and is on the free list.
+ */
+#define FFIND_RECORD_FREE 0x0001
+
+/**
+ The maximum number of parent directories that will be followed when
+ constructing a path.  This prevents a damaged index from looping forever.
+ */
+#define FFIND_MAX_DEPTH 256
+
+/**
+ The signature at the start of a persisted index, 'FFIX'.
+ */
+#define FFIND_INDEX_SIGNATURE 0x58494646
+
+/**
+ The version of the persisted index format.
+ */
+#define FFIND_INDEX_VERSION 1
+
+/**
+ A single file or directory within the index.  Names are not stored in the
+ record itself but in a single pool of characters owned by the index, so
+ that each record is a small fixed size.
+ */
+typedef struct _FFIND_RECORD {
+
+    /**
+     The file reference number of the file or directory.
+     */
+    DWORDLONG Frn;
+
+    /**
+     The file reference number of the directory containing this entry.
+     */
+    DWORDLONG ParentFrn;
+
+    /**
+     The offset, in characters, of the name of this entry within the index's
+     name pool.
+     */
+    DWORD NameOffset;
+
+    /**
+     The attributes of the file or directory when it was last seen.
+     */
+    DWORD Attributes;
+
+    /**
+     The next record in the same hash bucket, or the next free record if
+     this record is on the free list.  This value is not meaningful in a
+     persisted index.
+     */
+    DWORD HashNext;
+
+    /**
+     The length of the name, in characters.
+     */
+    WORD NameLength;
+
+    /**
+     Flags for the record, including FFIND_RECORD_FREE.
+     */
+    WORD Flags;
+
+} FFIND_RECORD, *PFFIND_RECORD;
+
+/**
+ The header of a persisted index.  This is followed by RecordCount records
+ and then NameChars characters of names.
+ */
+typedef struct _FFIND_INDEX_HEADER {
+
+    /**
+     Must be FFIND_INDEX_SIGNATURE.
+     */
+    DWORD Signature;
+
+    /**
+     Must be FFIND_INDEX_VERSION.
+     */
+    DWORD Version;
+
+    /**
+     The size of this header, in bytes.
+     */
+    DWORD HeaderSize;
+
+    /**
+     The size of each record, in bytes.
+     */
+    DWORD RecordSize;
+
+    /**
+     The size of each character in the name pool, in bytes.
+     */
+    DWORD CharSize;
+
+    /**
+     The number of records following the header.
+     */
+    DWORD RecordCount;
+
+    /**
+     The number of characters in the name pool.
+     */
+    DWORD NameChars;
+
+    /**
+     Reserved for future use, must be zero.
+     */
+    DWORD Reserved;
+
+    /**
+     The file reference number of the root directory of the volume.
+     */
+    DWORDLONG RootFrn;
+
+    /**
+     The identifier of the change journal that the index was synchronized
+     against.
+     */
+    DWORDLONG JournalId;
+
+    /**
+     The next change journal USN which has not yet been applied to the
+     index.
+     */
+    DWORDLONG NextUsn;
+
+} FFIND_INDEX_HEADER, *PFFIND_INDEX_HEADER;
+
+/**
+ An in memory index of every name on a volume.
+ */
+typedef struct _FFIND_INDEX {
+
+    /**
+     An array of records.  Some of these may be free.
+     */
+    PFFIND_RECORD Records;
+
+    /**
+     The number of elements in the Records array which have ever been used.
+     */
+    DWORD RecordCount;
+
+    /**
+     The number of elements allocated in the Records array.
+     */
+    DWORD RecordsAllocated;
+
+    /**
+     The number of records which are currently in use.
+     */
+    DWORD LiveCount;
+
+    /**
+     The first record on the free list, or FFIND_NO_RECORD if the free list
+     is empty.
+     */
+    DWORD FreeList;
+
+    /**
+     A pool of characters containing the names of all records.  Names are not
+     NULL terminated.
+     */
+    LPTSTR Names;
+
+    /**
+     The number of characters used in the Names pool.
+     */
+    DWORD NameChars;
+
+    /**
+     The number of characters allocated in the Names pool.
+     */
+    DWORD NamesAllocated;
+
+    /**
+     The number of characters in the Names pool which are no longer referenced
+     by any record because the record was deleted or renamed.
+     */
+    DWORD NameCharsUnused;
+
+    /**
+     An array of hash buckets, each containing the index of the first record
+     whose file reference number hashes to that bucket.
+     */
+    PDWORD Buckets;
+
+    /**
+     The number of hash buckets.  This is always a power of two.
+     */
+    DWORD BucketCount;
+
+    /**
+     The file reference number of the root directory of the volume.
+     */
+    DWORDLONG RootFrn;
+
+    /**
+     The identifier of the change journal that the index is synchronized
+     against.
+     */
+    DWORDLONG JournalId;
+
+    /**
+     The next change journal USN which has not yet been applied to the index.
+     */
+    DWORDLONG NextUsn;
+
+} FFIND_INDEX, *PFFIND_INDEX;
+
+/**
+ A prototype for a callback function to invoke for each record that matches
+ a query.
+
+ @param Index Pointer to the index being queried.
+
+ @param RecordIndex The index of the matching record.
+
+ @param Context Pointer to the context supplied to the query.
+
+ @return TRUE to continue the query, FALSE to stop it.
+ */
+typedef BOOL FFIND_QUERY_CALLBACK(PFFIND_INDEX Index, DWORD RecordIndex, PVOID Context);
+
+/**
+ A pointer to a callback function to invoke for each record that matches a
+ query.
+ */
+typedef FFIND_QUERY_CALLBACK *PFFIND_QUERY_CALLBACK;
+
+VOID
+FfindIndexInitialize(
+    __out PFFIND_INDEX Index
+    );
+
+VOID
+FfindIndexCleanup(
+    __inout PFFIND_INDEX Index
+    );
+
+DWORD
+FfindIndexLookup(
+    __in PFFIND_INDEX Index,
+    __in DWORDLONG Frn
+    );
+
+BOOL
+FfindIndexUpsert(
+    __inout PFFIND_INDEX Index,
+    __in DWORDLONG Frn,
+    __in DWORDLONG ParentFrn,
+    __in PYORI_STRING Name,
+    __in DWORD Attributes
+    );
+
+BOOL
+FfindIndexDelete(
+    __inout PFFIND_INDEX Index,
+    __in DWORDLONG Frn
+    );
+
+BOOL
+FfindIndexBuildPath(
+    __in PFFIND_INDEX Index,
+    __in DWORD RecordIndex,
+    __in PYORI_STRING Prefix,
+    __inout PYORI_STRING Path
+    );
+
+DWORD
+FfindIndexQuery(
+    __in PFFIND_INDEX Index,
+    __in_opt PYORI_LIB_FILE_MATCH_EXPRESSION Expression,
+    __in PFFIND_QUERY_CALLBACK Callback,
+    __in PVOID Context
+    );
+
+BOOL
+FfindIndexSerialize(
+    __in PFFIND_INDEX Index,
+    __out PVOID *Buffer,
+    __out PDWORD BufferLength
+    );
+
+BOOL
+FfindIndexDeserialize(
+    __inout PFFIND_INDEX Index,
+    __in PVOID Buffer,
+    __in DWORD BufferLength
+    );
+
+// vim:sw=4:ts=4:et:
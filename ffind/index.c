@@ -0,0 +1,877 @@
+/**
+ * @file ffind/index.c
+ *
+ * Yori volume wide file name index.  This module maintains the index in
+ * memory, queries it, and converts it to and from a persisted form.  It
+ * does not interact with the file system directly, so records can come
+ * from a volume or be generated synthetically.
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "ffind.h"
+
+/**
+ The number of records, hash buckets and name characters to allocate when an
+ index is first populated.
+ */
+#define FFIND_INITIAL_ALLOCATION 4096
+
+/**
+ Return the hash bucket for a file reference number.  The low bits of a file
+ reference number are an index into the MFT, which is densely allocated, so
+ they are used directly after folding in the sequence number.
+
+ @param Index Pointer to the index.
+
+ @param Frn The file reference number.
+
+ @return The hash bucket index.
+ */
+DWORD
+FfindIndexHashFrn(
+    __in PFFIND_INDEX Index,
+    __in DWORDLONG Frn
+    )
+{
+    DWORD Hash;
+
+    Hash = (DWORD)Frn ^ (DWORD)(Frn >> 40);
+    return Hash & (Index->BucketCount - 1);
+}
+
+/**
+ Initialize an index so that it contains no records.
+
+ @param Index Pointer to the index to initialize.
+ */
+VOID
+FfindIndexInitialize(
+    __out PFFIND_INDEX Index
+    )
+{
+    ZeroMemory(Index, sizeof(FFIND_INDEX));
+    Index->FreeList = FFIND_NO_RECORD;
+}
+
+/**
+ Free all memory associated with an index and return it to an empty state.
+
+ @param Index Pointer to the index to clean up.
+ */
+VOID
+FfindIndexCleanup(
+    __inout PFFIND_INDEX Index
+    )
+{
+    if (Index->Records != NULL) {
+        YoriLibFree(Index->Records);
+    }
+    if (Index->Names != NULL) {
+        YoriLibFree(Index->Names);
+    }
+    if (Index->Buckets != NULL) {
+        YoriLibFree(Index->Buckets);
+    }
+    FfindIndexInitialize(Index);
+}
+
+/**
+ Reallocate the hash buckets to the specified size and reinsert every record
+ which is in use.
+
+ @param Index Pointer to the index.
+
+ @param BucketCount The new number of buckets.  This must be a power of two.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+BOOL
+FfindIndexRehash(
+    __inout PFFIND_INDEX Index,
+    __in DWORD BucketCount
+    )
+{
+    PDWORD NewBuckets;
+    DWORD RecordIndex;
+    DWORD Bucket;
+    PFFIND_RECORD Record;
+
+    if (BucketCount >= (DWORD)-1 / sizeof(DWORD)) {
+        return FALSE;
+    }
+
+    NewBuckets = YoriLibMalloc(BucketCount * sizeof(DWORD));
+    if (NewBuckets == NULL) {
+        return FALSE;
+    }
+
+    if (Index->Buckets != NULL) {
+        YoriLibFree(Index->Buckets);
+    }
+    Index->Buckets = NewBuckets;
+    Index->BucketCount = BucketCount;
+
+    for (Bucket = 0; Bucket < BucketCount; Bucket++) {
+        NewBuckets[Bucket] = FFIND_NO_RECORD;
+    }
+
+    for (RecordIndex = 0; RecordIndex < Index->RecordCount; RecordIndex++) {
+        Record = &Index->Records[RecordIndex];
+        if (Record->Flags & FFIND_RECORD_FREE) {
+            continue;
+        }
+        Bucket = FfindIndexHashFrn(Index, Record->Frn);
+        Record->HashNext = NewBuckets[Bucket];
+        NewBuckets[Bucket] = RecordIndex;
+    }
+
+    return TRUE;
+}
+
+/**
+ Ensure the records array has space for at least one more record.
+
+ @param Index Pointer to the index.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+BOOL
+FfindIndexGrowRecords(
+    __inout PFFIND_INDEX Index
+    )
+{
+    PFFIND_RECORD NewRecords;
+    DWORD NewAllocated;
+
+    if (Index->RecordCount < Index->RecordsAllocated) {
+        return TRUE;
+    }
+
+    NewAllocated = Index->RecordsAllocated * 2;
+    if (NewAllocated == 0) {
+        NewAllocated = FFIND_INITIAL_ALLOCATION;
+    }
+
+    if (NewAllocated >= (DWORD)-1 / sizeof(FFIND_RECORD) ||
+        NewAllocated == FFIND_NO_RECORD) {
+
+        return FALSE;
+    }
+
+    NewRecords = YoriLibMalloc(NewAllocated * sizeof(FFIND_RECORD));
+    if (NewRecords == NULL) {
+        return FALSE;
+    }
+
+    if (Index->Records != NULL) {
+        memcpy(NewRecords, Index->Records, Index->RecordCount * sizeof(FFIND_RECORD));
+        YoriLibFree(Index->Records);
+    }
+
+    Index->Records = NewRecords;
+    Index->RecordsAllocated = NewAllocated;
+    return TRUE;
+}
+
+/**
+ Ensure the name pool has space for the specified number of additional
+ characters.  If much of the pool is no longer referenced, names are moved
+ to the front of the pool rather than growing it.
+
+ @param Index Pointer to the index.
+
+ @param CharsNeeded The number of additional characters required.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+BOOL
+FfindIndexGrowNames(
+    __inout PFFIND_INDEX Index,
+    __in DWORD CharsNeeded
+    )
+{
+    LPTSTR NewNames;
+    DWORD NewAllocated;
+    DWORD CharsRequired;
+    DWORD NewChars;
+    DWORD RecordIndex;
+    PFFIND_RECORD Record;
+
+    if (Index->NameChars + CharsNeeded <= Index->NamesAllocated) {
+        return TRUE;
+    }
+
+    //
+    //  If at least half of the pool is unused, compact into an allocation
+    //  of the same size.  Otherwise double it.
+    //
+
+    CharsRequired = Index->NameChars - Index->NameCharsUnused + CharsNeeded;
+    if (CharsRequired < CharsNeeded) {
+        return FALSE;
+    }
+
+    NewAllocated = Index->NamesAllocated;
+    if (Index->NameCharsUnused < Index->NameChars / 2 ||
+        CharsRequired > NewAllocated) {
+
+        if (NewAllocated < FFIND_INITIAL_ALLOCATION) {
+            NewAllocated = FFIND_INITIAL_ALLOCATION / 2;
+        }
+        do {
+            if (NewAllocated >= (DWORD)-1 / sizeof(TCHAR) / 2) {
+                return FALSE;
+            }
+            NewAllocated = NewAllocated * 2;
+        } while (NewAllocated < CharsRequired);
+    }
+
+    if (NewAllocated >= (DWORD)-1 / sizeof(TCHAR)) {
+        return FALSE;
+    }
+
+    NewNames = YoriLibMalloc(NewAllocated * sizeof(TCHAR));
+    if (NewNames == NULL) {
+        return FALSE;
+    }
+
+    NewChars = 0;
+    for (RecordIndex = 0; RecordIndex < Index->RecordCount; RecordIndex++) {
+        Record = &Index->Records[RecordIndex];
+        if ((Record->Flags & FFIND_RECORD_FREE) || Record->NameLength == 0) {
+            continue;
+        }
+        memcpy(&NewNames[NewChars], &Index->Names[Record->NameOffset], Record->NameLength * sizeof(TCHAR));
+        Record->NameOffset = NewChars;
+        NewChars += Record->NameLength;
+    }
+
+    if (Index->Names != NULL) {
+        YoriLibFree(Index->Names);
+    }
+
+    Index->Names = NewNames;
+    Index->NamesAllocated = NewAllocated;
+    Index->NameChars = NewChars;
+    Index->NameCharsUnused = 0;
+    return TRUE;
+}
+
+/**
+ Find the record describing a file reference number.
+
+ @param Index Pointer to the index.
+
+ @param Frn The file reference number to find.
+
+ @return The index of the record, or FFIND_NO_RECORD if the file reference
+         number is not in the index.
+ */
+DWORD
+FfindIndexLookup(
+    __in PFFIND_INDEX Index,
+    __in DWORDLONG Frn
+    )
+{
+    DWORD RecordIndex;
+
+    if (Index->BucketCount == 0) {
+        return FFIND_NO_RECORD;
+    }
+
+    RecordIndex = Index->Buckets[FfindIndexHashFrn(Index, Frn)];
+    while (RecordIndex != FFIND_NO_RECORD) {
+        if (Index->Records[RecordIndex].Frn == Frn) {
+            return RecordIndex;
+        }
+        RecordIndex = Index->Records[RecordIndex].HashNext;
+    }
+
+    return FFIND_NO_RECORD;
+}
+
+/**
+ Allocate a record for a file reference number which is not currently in the
+ index and insert it into its hash bucket.  The caller is expected to fill in
+ everything other than the file reference number.
+
+ @param Index Pointer to the index.
+
+ @param Frn The file reference number of the new record.
+
+ @return The index of the new record, or FFIND_NO_RECORD on allocation
+         failure.
+ */
+DWORD
+FfindIndexAllocateRecord(
+    __inout PFFIND_INDEX Index,
+    __in DWORDLONG Frn
+    )
+{
+    DWORD RecordIndex;
+    DWORD Bucket;
+    PFFIND_RECORD Record;
+
+    //
+    //  Keep the hash table at least as large as the number of records, so
+    //  chains remain short.
+    //
+
+    if (Index->LiveCount >= Index->BucketCount) {
+        Bucket = Index->BucketCount * 2;
+        if (Bucket < FFIND_INITIAL_ALLOCATION) {
+            Bucket = FFIND_INITIAL_ALLOCATION;
+        }
+        if (!FfindIndexRehash(Index, Bucket)) {
+            return FFIND_NO_RECORD;
+        }
+    }
+
+    if (Index->FreeList != FFIND_NO_RECORD) {
+        RecordIndex = Index->FreeList;
+        Index->FreeList = Index->Records[RecordIndex].HashNext;
+    } else {
+        if (!FfindIndexGrowRecords(Index)) {
+            return FFIND_NO_RECORD;
+        }
+        RecordIndex = Index->RecordCount;
+        Index->RecordCount++;
+    }
+
+    Record = &Index->Records[RecordIndex];
+    ZeroMemory(Record, sizeof(FFIND_RECORD));
+    Record->Frn = Frn;
+
+    Bucket = FfindIndexHashFrn(Index, Frn);
+    Record->HashNext = Index->Buckets[Bucket];
+    Index->Buckets[Bucket] = RecordIndex;
+    Index->LiveCount++;
+
+    return RecordIndex;
+}
+
+/**
+ Add a file or directory to the index, or update it if it is already
+ present.  A file with multiple hard links is recorded under the most
+ recent name supplied.
+
+ @param Index Pointer to the index.
+
+ @param Frn The file reference number of the file or directory.
+
+ @param ParentFrn The file reference number of the parent directory.
+
+ @param Name The name of the file or directory within its parent.
+
+ @param Attributes The attributes of the file or directory.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+FfindIndexUpsert(
+    __inout PFFIND_INDEX Index,
+    __in DWORDLONG Frn,
+    __in DWORDLONG ParentFrn,
+    __in PYORI_STRING Name,
+    __in DWORD Attributes
+    )
+{
+    DWORD RecordIndex;
+    PFFIND_RECORD Record;
+
+    if (Name->LengthInChars == 0 || Name->LengthInChars > 0xFFFF) {
+        return FALSE;
+    }
+
+    RecordIndex = FfindIndexLookup(Index, Frn);
+    if (RecordIndex == FFIND_NO_RECORD) {
+        RecordIndex = FfindIndexAllocateRecord(Index, Frn);
+        if (RecordIndex == FFIND_NO_RECORD) {
+            return FALSE;
+        }
+    } else {
+        Record = &Index->Records[RecordIndex];
+
+        //
+        //  If the name hasn't changed, leave it where it is.  If the new
+        //  name fits over the old one, reuse its space.
+        //
+
+        if (Record->NameLength == Name->LengthInChars &&
+            memcmp(&Index->Names[Record->NameOffset], Name->StartOfString, Name->LengthInChars * sizeof(TCHAR)) == 0) {
+
+            Record->ParentFrn = ParentFrn;
+            Record->Attributes = Attributes;
+            return TRUE;
+        }
+
+        if (Name->LengthInChars <= Record->NameLength) {
+            memcpy(&Index->Names[Record->NameOffset], Name->StartOfString, Name->LengthInChars * sizeof(TCHAR));
+            Index->NameCharsUnused += Record->NameLength - Name->LengthInChars;
+            Record->NameLength = (WORD)Name->LengthInChars;
+            Record->ParentFrn = ParentFrn;
+            Record->Attributes = Attributes;
+            return TRUE;
+        }
+
+        Index->NameCharsUnused += Record->NameLength;
+        Record->NameLength = 0;
+    }
+
+    //
+    //  Growing the name pool may move names, but it does not move records.
+    //
+
+    if (!FfindIndexGrowNames(Index, Name->LengthInChars)) {
+        Record = &Index->Records[RecordIndex];
+        if (Record->NameLength == 0) {
+            FfindIndexDelete(Index, Frn);
+        }
+        return FALSE;
+    }
+
+    Record = &Index->Records[RecordIndex];
+    Record->ParentFrn = ParentFrn;
+    Record->Attributes = Attributes;
+    Record->NameOffset = Index->NameChars;
+    Record->NameLength = (WORD)Name->LengthInChars;
+    memcpy(&Index->Names[Index->NameChars], Name->StartOfString, Name->LengthInChars * sizeof(TCHAR));
+    Index->NameChars += Name->LengthInChars;
+
+    return TRUE;
+}
+
+/**
+ Remove a file or directory from the index.
+
+ @param Index Pointer to the index.
+
+ @param Frn The file reference number of the file or directory to remove.
+
+ @return TRUE if the record was found and removed, FALSE if it was not
+         present.
+ */
+BOOL
+FfindIndexDelete(
+    __inout PFFIND_INDEX Index,
+    __in DWORDLONG Frn
+    )
+{
+    DWORD Bucket;
+    DWORD RecordIndex;
+    PDWORD Link;
+    PFFIND_RECORD Record;
+
+    if (Index->BucketCount == 0) {
+        return FALSE;
+    }
+
+    Bucket = FfindIndexHashFrn(Index, Frn);
+    Link = &Index->Buckets[Bucket];
+    RecordIndex = *Link;
+    while (RecordIndex != FFIND_NO_RECORD) {
+        Record = &Index->Records[RecordIndex];
+        if (Record->Frn == Frn) {
+            *Link = Record->HashNext;
+            Index->NameCharsUnused += Record->NameLength;
+            Record->NameLength = 0;
+            Record->Flags = FFIND_RECORD_FREE;
+            Record->HashNext = Index->FreeList;
+            Index->FreeList = RecordIndex;
+            Index->LiveCount--;
+            return TRUE;
+        }
+        Link = &Record->HashNext;
+        RecordIndex = *Link;
+    }
+
+    return FALSE;
+}
+
+/**
+ Construct the full path to a record by following its parent directories
+ up to the root of the volume.
+
+ @param Index Pointer to the index.
+
+ @param RecordIndex The record to construct a path for.
+
+ @param Prefix The string to place before the path, typically describing the
+        volume.  This should not end in a path separator.
+
+ @param Path On input, an initialized string which may contain an existing
+        allocation.  On successful completion, updated to contain the full
+        path.  This will be reallocated if it is not large enough.
+
+ @return TRUE to indicate success, FALSE if the record cannot be traced to
+         the root of the volume or on allocation failure.
+ */
+BOOL
+FfindIndexBuildPath(
+    __in PFFIND_INDEX Index,
+    __in DWORD RecordIndex,
+    __in PYORI_STRING Prefix,
+    __inout PYORI_STRING Path
+    )
+{
+    DWORD Chain[FFIND_MAX_DEPTH];
+    DWORD Depth;
+    DWORD CharsNeeded;
+    DWORD Current;
+    PFFIND_RECORD Record;
+
+    Depth = 0;
+    Current = RecordIndex;
+    CharsNeeded = Prefix->LengthInChars + 1;
+
+    //
+    //  Walk up to the root, remembering each component.  Anything whose
+    //  parent isn't known isn't reachable from the root, such as files
+    //  beneath metadata directories, so no path is returned for it.
+    //
+
+    while (TRUE) {
+        Record = &Index->Records[Current];
+        if (Record->Frn == Index->RootFrn) {
+            break;
+        }
+        if (Depth == FFIND_MAX_DEPTH) {
+            return FALSE;
+        }
+        Chain[Depth] = Current;
+        Depth++;
+        CharsNeeded += Record->NameLength + 1;
+        if (Record->ParentFrn == Index->RootFrn) {
+            break;
+        }
+        Current = FfindIndexLookup(Index, Record->ParentFrn);
+        if (Current == FFIND_NO_RECORD) {
+            return FALSE;
+        }
+    }
+
+    if (Path->LengthAllocated < CharsNeeded) {
+        YoriLibFreeStringContents(Path);
+        if (!YoriLibAllocateString(Path, CharsNeeded + MAX_PATH)) {
+            return FALSE;
+        }
+    }
+
+    memcpy(Path->StartOfString, Prefix->StartOfString, Prefix->LengthInChars * sizeof(TCHAR));
+    Path->LengthInChars = Prefix->LengthInChars;
+
+    if (Depth == 0) {
+        Path->StartOfString[Path->LengthInChars] = '\\';
+        Path->LengthInChars++;
+    }
+
+    while (Depth > 0) {
+        Depth--;
+        Record = &Index->Records[Chain[Depth]];
+        Path->StartOfString[Path->LengthInChars] = '\\';
+        Path->LengthInChars++;
+        memcpy(&Path->StartOfString[Path->LengthInChars], &Index->Names[Record->NameOffset], Record->NameLength * sizeof(TCHAR));
+        Path->LengthInChars += Record->NameLength;
+    }
+
+    Path->StartOfString[Path->LengthInChars] = '\0';
+    return TRUE;
+}
+
+/**
+ Invoke a callback for every record whose name matches an expression.
+
+ @param Index Pointer to the index.
+
+ @param Expression Optionally points to a compiled expression to compare
+        each name against.  If NULL, every record matches.
+
+ @param Callback The function to invoke for each match.
+
+ @param Context Context to pass to the callback.
+
+ @return The number of records which matched.
+ */
+DWORD
+FfindIndexQuery(
+    __in PFFIND_INDEX Index,
+    __in_opt PYORI_LIB_FILE_MATCH_EXPRESSION Expression,
+    __in PFFIND_QUERY_CALLBACK Callback,
+    __in PVOID Context
+    )
+{
+    DWORD RecordIndex;
+    DWORD MatchCount;
+    PFFIND_RECORD Record;
+    YORI_STRING Name;
+
+    YoriLibInitEmptyString(&Name);
+    MatchCount = 0;
+
+    for (RecordIndex = 0; RecordIndex < Index->RecordCount; RecordIndex++) {
+        Record = &Index->Records[RecordIndex];
+        if (Record->Flags & FFIND_RECORD_FREE) {
+            continue;
+        }
+
+        if (Expression != NULL) {
+            Name.StartOfString = &Index->Names[Record->NameOffset];
+            Name.LengthInChars = Record->NameLength;
+            if (!YoriLibDoesFileMatchCompiledExpression(&Name, Expression)) {
+                continue;
+            }
+        }
+
+        MatchCount++;
+        if (!Callback(Index, RecordIndex, Context)) {
+            break;
+        }
+    }
+
+    return MatchCount;
+}
+
+/**
+ Convert an index into a single buffer suitable for writing to a file.
+ Records which are not in use and names which are not referenced are not
+ included.
+
+ @param Index Pointer to the index.
+
+ @param Buffer On successful completion, updated to point to a newly
+        allocated buffer containing the index.  The caller should free this
+        with YoriLibFree.
+
+ @param BufferLength On successful completion, updated to contain the length
+        of the buffer, in bytes.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+FfindIndexSerialize(
+    __in PFFIND_INDEX Index,
+    __out PVOID *Buffer,
+    __out PDWORD BufferLength
+    )
+{
+    DWORDLONG Length;
+    DWORD NameChars;
+    DWORD RecordIndex;
+    DWORD OutputIndex;
+    PFFIND_INDEX_HEADER Header;
+    PFFIND_RECORD Records;
+    PFFIND_RECORD Record;
+    LPTSTR Names;
+
+    NameChars = Index->NameChars - Index->NameCharsUnused;
+    Length = sizeof(FFIND_INDEX_HEADER);
+    Length += (DWORDLONG)Index->LiveCount * sizeof(FFIND_RECORD);
+    Length += (DWORDLONG)NameChars * sizeof(TCHAR);
+
+    if (Length >= (DWORD)-1) {
+        return FALSE;
+    }
+
+    Header = YoriLibMalloc((DWORD)Length);
+    if (Header == NULL) {
+        return FALSE;
+    }
+
+    ZeroMemory(Header, sizeof(FFIND_INDEX_HEADER));
+    Header->Signature = FFIND_INDEX_SIGNATURE;
+    Header->Version = FFIND_INDEX_VERSION;
+    Header->HeaderSize = sizeof(FFIND_INDEX_HEADER);
+    Header->RecordSize = sizeof(FFIND_RECORD);
+    Header->CharSize = sizeof(TCHAR);
+    Header->RecordCount = Index->LiveCount;
+    Header->NameChars = NameChars;
+    Header->RootFrn = Index->RootFrn;
+    Header->JournalId = Index->JournalId;
+    Header->NextUsn = Index->NextUsn;
+
+    Records = (PFFIND_RECORD)(Header + 1);
+    Names = (LPTSTR)(Records + Index->LiveCount);
+
+    OutputIndex = 0;
+    NameChars = 0;
+    for (RecordIndex = 0; RecordIndex < Index->RecordCount; RecordIndex++) {
+        Record = &Index->Records[RecordIndex];
+        if (Record->Flags & FFIND_RECORD_FREE) {
+            continue;
+        }
+        Records[OutputIndex].Frn = Record->Frn;
+        Records[OutputIndex].ParentFrn = Record->ParentFrn;
+        Records[OutputIndex].NameOffset = NameChars;
+        Records[OutputIndex].Attributes = Record->Attributes;
+        Records[OutputIndex].HashNext = 0;
+        Records[OutputIndex].NameLength = Record->NameLength;
+        Records[OutputIndex].Flags = 0;
+        memcpy(&Names[NameChars], &Index->Names[Record->NameOffset], Record->NameLength * sizeof(TCHAR));
+        NameChars += Record->NameLength;
+        OutputIndex++;
+    }
+
+    ASSERT(OutputIndex == Index->LiveCount);
+    ASSERT(NameChars == Header->NameChars);
+
+    *Buffer = Header;
+    *BufferLength = (DWORD)Length;
+    return TRUE;
+}
+
+/**
+ Load an index from a buffer previously generated with FfindIndexSerialize.
+ The buffer is validated before use, so a damaged or truncated file results
+ in failure rather than an inconsistent index.
+
+ @param Index Pointer to an initialized, empty index to populate.
+
+ @param Buffer Pointer to the persisted index.
+
+ @param BufferLength The length of the buffer, in bytes.
+
+ @return TRUE to indicate success, FALSE to indicate that the buffer is not a
+         valid index or on allocation failure.
+ */
+BOOL
+FfindIndexDeserialize(
+    __inout PFFIND_INDEX Index,
+    __in PVOID Buffer,
+    __in DWORD BufferLength
+    )
+{
+    PFFIND_INDEX_HEADER Header;
+    PFFIND_RECORD Records;
+    PFFIND_RECORD Record;
+    LPTSTR Names;
+    DWORDLONG Length;
+    DWORD RecordIndex;
+    DWORD BucketCount;
+    DWORD NameChars;
+
+    ASSERT(Index->RecordCount == 0);
+
+    if (BufferLength < sizeof(FFIND_INDEX_HEADER)) {
+        return FALSE;
+    }
+
+    Header = (PFFIND_INDEX_HEADER)Buffer;
+    if (Header->Signature != FFIND_INDEX_SIGNATURE ||
+        Header->Version != FFIND_INDEX_VERSION ||
+        Header->HeaderSize != sizeof(FFIND_INDEX_HEADER) ||
+        Header->RecordSize != sizeof(FFIND_RECORD) ||
+        Header->CharSize != sizeof(TCHAR) ||
+        Header->Reserved != 0 ||
+        Header->RecordCount == FFIND_NO_RECORD) {
+
+        return FALSE;
+    }
+
+    Length = sizeof(FFIND_INDEX_HEADER);
+    Length += (DWORDLONG)Header->RecordCount * sizeof(FFIND_RECORD);
+    Length += (DWORDLONG)Header->NameChars * sizeof(TCHAR);
+    if (Length != BufferLength) {
+        return FALSE;
+    }
+
+    Records = (PFFIND_RECORD)(Header + 1);
+    Names = (LPTSTR)(Records + Header->RecordCount);
+
+    //
+    //  Allocate everything up front, with a power of two number of buckets
+    //  at least as large as the number of records.
+    //
+
+    BucketCount = FFIND_INITIAL_ALLOCATION;
+    while (BucketCount < Header->RecordCount) {
+        BucketCount = BucketCount * 2;
+    }
+
+    Index->RecordsAllocated = Header->RecordCount;
+    if (Index->RecordsAllocated < FFIND_INITIAL_ALLOCATION) {
+        Index->RecordsAllocated = FFIND_INITIAL_ALLOCATION;
+    }
+    Index->NamesAllocated = Header->NameChars;
+    if (Index->NamesAllocated < FFIND_INITIAL_ALLOCATION) {
+        Index->NamesAllocated = FFIND_INITIAL_ALLOCATION;
+    }
+
+    Index->Records = YoriLibMalloc(Index->RecordsAllocated * sizeof(FFIND_RECORD));
+    Index->Names = YoriLibMalloc(Index->NamesAllocated * sizeof(TCHAR));
+    if (Index->Records == NULL ||
+        Index->Names == NULL ||
+        !FfindIndexRehash(Index, BucketCount)) {
+
+        FfindIndexCleanup(Index);
+        return FALSE;
+    }
+
+    memcpy(Index->Names, Names, Header->NameChars * sizeof(TCHAR));
+    Index->NameChars = Header->NameChars;
+
+    //
+    //  Names are written in record order, so each record's name must
+    //  immediately follow the previous one.  This ensures no two records
+    //  share characters.
+    //
+
+    NameChars = 0;
+
+    for (RecordIndex = 0; RecordIndex < Header->RecordCount; RecordIndex++) {
+        Record = &Records[RecordIndex];
+        if (Record->Flags != 0 ||
+            Record->NameLength == 0 ||
+            Record->NameOffset != NameChars ||
+            Record->NameLength > Header->NameChars - NameChars ||
+            FfindIndexLookup(Index, Record->Frn) != FFIND_NO_RECORD) {
+
+            FfindIndexCleanup(Index);
+            return FALSE;
+        }
+
+        if (FfindIndexAllocateRecord(Index, Record->Frn) != RecordIndex) {
+            FfindIndexCleanup(Index);
+            return FALSE;
+        }
+
+        Index->Records[RecordIndex].ParentFrn = Record->ParentFrn;
+        Index->Records[RecordIndex].NameOffset = Record->NameOffset;
+        Index->Records[RecordIndex].NameLength = Record->NameLength;
+        Index->Records[RecordIndex].Attributes = Record->Attributes;
+        NameChars += Record->NameLength;
+    }
+
+    if (NameChars != Header->NameChars) {
+        FfindIndexCleanup(Index);
+        return FALSE;
+    }
+
+    Index->RootFrn = Header->RootFrn;
+    Index->JournalId = Header->JournalId;
+    Index->NextUsn = Header->NextUsn;
+
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
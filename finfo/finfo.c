@@ -78,6 +78,12 @@ typedef struct _FINFO_CONTEXT {
      */
     LONGLONG FilesFoundThisArg;
 
+    /**
+     Buffered output stream used to combine per file results into larger
+     writes.
+     */
+    YORI_LIB_OUTPUT_BUFFER Output;
+
 } FINFO_CONTEXT, *PFINFO_CONTEXT;
 
 /**
@@ -1427,7 +1433,7 @@ FInfoFileFoundCallback(
     YoriLibInitEmptyString(&DisplayString);
     YoriLibExpandCommandVariables(&FInfoContext->FormatString, '$', TRUE, FInfoExpandVariables, FInfoContext, &DisplayString);
     if (DisplayString.StartOfString != NULL) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
+        YoriLibOutputBufferString(&FInfoContext->Output, &DisplayString);
         YoriLibFreeStringContents(&DisplayString);
     }
 
@@ -1556,6 +1562,12 @@ ENTRYPOINT(
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("finfo: missing argument\n"));
         return EXIT_FAILURE;
     } else {
+        if (!YoriLibOutputBufferInitialize(&FInfoContext.Output, YORI_LIB_OUTPUT_STDOUT)) {
+            YoriLibOutputBufferCleanup(&FInfoContext.Output);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("finfo: out of memory\n"));
+            return EXIT_FAILURE;
+        }
+
         MatchFlags = YORILIB_FILEENUM_RETURN_FILES;
 
         if (ReturnDirectories) {
@@ -1585,6 +1597,9 @@ ENTRYPOINT(
                 }
             }
         }
+
+        YoriLibOutputBufferCleanup(&FInfoContext.Output);
+        YoriLibFreePeMetadataCache();
     }
 
     if (FInfoContext.FilesFound == 0) {
@@ -37,7 +37,8 @@ const
 CHAR strForHelpText[] =
         "Enumerates through a list of strings or files.\n"
         "\n"
-        "FOR [-license] [-b] [-c] [-d] [-i <criteria>] [-p n] [-r] <var> in (<list>)\n"
+        "FOR [-license] [-b] [-c] [-d] [-i <criteria>] [-o] [-p n] [-r] [-s]\n"
+        "    <var> in (<list>)\n"
         "    do <cmd>\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
@@ -45,8 +46,10 @@ CHAR strForHelpText[] =
         "   -d             Match directories rather than files\n"
         "   -i <criteria>  Only treat match files if they meet criteria, see below\n"
         "   -l             Use (start,step,end) notation for the list\n"
+        "   -o             Buffer the output of each command and display it in order\n"
         "   -p <n>         Execute with <n> concurrent processes\n"
         "   -r             Look for matches in subdirectories under the current directory\n"
+        "   -s             Display a summary of the time taken by commands\n"
         "\n"
         " The -i option will match files only if they meet criteria.  This is a\n"
         " semicolon delimited list of entries matching the following form:\n"
@@ -74,6 +77,82 @@ ForHelp()
     return TRUE;
 }
 
+/**
+ The number of slowest commands to report when displaying a summary.
+ */
+#define FOR_SLOWEST_ITEM_COUNT (10)
+
+/**
+ The number of milliseconds to wait for a completion port notification before
+ checking each running process.  Notifications are not guaranteed to be
+ delivered, so this ensures a lost notification can only delay, not hang,
+ execution.
+ */
+#define FOR_POLL_INTERVAL (1000)
+
+/**
+ The size of each block to copy when displaying the buffered output of a
+ command.
+ */
+#define FOR_OUTPUT_COPY_SIZE (64 * 1024)
+
+/**
+ Information about a single command that has been launched and has not yet
+ been retired.
+ */
+typedef struct _FOR_EXEC_ITEM {
+
+    /**
+     The list entry for this item within the exec context's list of items.
+     Items are in the order they were launched.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The match that was substituted into the command.
+     */
+    YORI_STRING Match;
+
+    /**
+     A handle to the process executing the command.
+     */
+    HANDLE ProcessHandle;
+
+    /**
+     A handle to a temporary file containing the output of the command, if
+     output is being displayed in order.  NULL otherwise.
+     */
+    HANDLE OutputFile;
+
+    /**
+     The process ID of the process executing the command.
+     */
+    DWORD ProcessId;
+
+    /**
+     TRUE once the process executing the command has terminated.
+     */
+    BOOL Completed;
+
+} FOR_EXEC_ITEM, *PFOR_EXEC_ITEM;
+
+/**
+ A command that took a long time to execute, remembered in order to display
+ a summary.
+ */
+typedef struct _FOR_SLOW_ITEM {
+
+    /**
+     The match that was substituted into the command.
+     */
+    YORI_STRING Match;
+
+    /**
+     The wall time that the command took to execute, in milliseconds.
+     */
+    LONGLONG WallTimeInMs;
+} FOR_SLOW_ITEM, *PFOR_SLOW_ITEM;
+
 /**
  State about the currently running processes as well as information required
  to launch any new processes from this program.
@@ -85,6 +164,17 @@ typedef struct _FOR_EXEC_CONTEXT {
      */
     BOOL InvokeCmd;
 
+    /**
+     If TRUE, the output of each command is buffered and displayed in the
+     order that commands were launched.
+     */
+    BOOL OrderedOutput;
+
+    /**
+     If TRUE, display the wall time of commands once execution completes.
+     */
+    BOOL DisplaySummary;
+
     /**
      The string that might be found in ArgV which should be changed to contain
      the value of any match.
@@ -115,10 +205,55 @@ typedef struct _FOR_EXEC_CONTEXT {
     DWORD CurrentConcurrentCount;
 
     /**
-     An array of handles with CurrentConcurrentCount number of valid
-     elements.  These correspond to processes that are currently running.
+     A list of commands which have been launched and not yet retired.  A
+     command is retired once it has completed and, if output is being
+     displayed in order, its output has been displayed.
+     */
+    YORI_LIST_ENTRY Items;
+
+    /**
+     A job object containing each launched process, so that the completion
+     port is notified when any of them exit.  NULL if job objects are not
+     supported, in which case processes are waited on directly, which
+     limits concurrency to MAXIMUM_WAIT_OBJECTS.
+     */
+    HANDLE Job;
+
+    /**
+     A completion port receiving notifications about processes within Job.
+     */
+    HANDLE CompletionPort;
+
+    /**
+     TRUE once any process has been successfully assigned to Job.
      */
-    PHANDLE HandleArray;
+    BOOL JobAssignmentSucceeded;
+
+    /**
+     The directory to create temporary files in when buffering output.
+     */
+    YORI_STRING TempPath;
+
+    /**
+     The number of commands which have completed.
+     */
+    DWORD CompletedCount;
+
+    /**
+     The total wall time of all commands which have completed, in
+     milliseconds.
+     */
+    LONGLONG TotalWallTimeInMs;
+
+    /**
+     The number of elements populated in Slowest.
+     */
+    DWORD SlowestCount;
+
+    /**
+     The slowest commands, in descending order of wall time.
+     */
+    FOR_SLOW_ITEM Slowest[FOR_SLOWEST_ITEM_COUNT];
 
     /**
      A list of criteria to filter matches against.
@@ -127,6 +262,327 @@ typedef struct _FOR_EXEC_CONTEXT {
 
 } FOR_EXEC_CONTEXT, *PFOR_EXEC_CONTEXT;
 
+/**
+ Prepare to track processes via a job object and completion port.  If this
+ is not supported by the host OS, processes are waited on directly.
+
+ @param ExecContext Pointer to the for exec context.
+ */
+VOID
+ForInitializeCompletionPort(
+    __in PFOR_EXEC_CONTEXT ExecContext
+    )
+{
+    if (DllKernel32.pCreateIoCompletionPort == NULL ||
+        DllKernel32.pGetQueuedCompletionStatus == NULL) {
+
+        return;
+    }
+
+    ExecContext->Job = YoriLibCreateJobObject();
+    if (ExecContext->Job == NULL) {
+        return;
+    }
+
+    ExecContext->CompletionPort = DllKernel32.pCreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+    if (ExecContext->CompletionPort == NULL) {
+        CloseHandle(ExecContext->Job);
+        ExecContext->Job = NULL;
+        return;
+    }
+
+    //
+    //  Only the processes launched by this program need to be in the job.
+    //  Let anything they launch be outside of it so it can use its own job
+    //  objects on systems without nested jobs.
+    //
+
+    YoriLibAllowSilentJobObjectBreakaway(ExecContext->Job);
+
+    if (!YoriLibAssociateJobObjectWithCompletionPort(ExecContext->Job, ExecContext->CompletionPort, ExecContext)) {
+        CloseHandle(ExecContext->CompletionPort);
+        CloseHandle(ExecContext->Job);
+        ExecContext->CompletionPort = NULL;
+        ExecContext->Job = NULL;
+    }
+}
+
+/**
+ Stop tracking processes via a job object and completion port, and wait on
+ processes directly instead.  This limits concurrency to the number of
+ objects that can be waited on at once.
+
+ @param ExecContext Pointer to the for exec context.
+ */
+VOID
+ForCloseCompletionPort(
+    __in PFOR_EXEC_CONTEXT ExecContext
+    )
+{
+    if (ExecContext->Job != NULL) {
+        CloseHandle(ExecContext->Job);
+        ExecContext->Job = NULL;
+    }
+
+    if (ExecContext->CompletionPort != NULL) {
+        CloseHandle(ExecContext->CompletionPort);
+        ExecContext->CompletionPort = NULL;
+    }
+
+    if (ExecContext->TargetConcurrentCount > MAXIMUM_WAIT_OBJECTS) {
+        ExecContext->TargetConcurrentCount = MAXIMUM_WAIT_OBJECTS;
+    }
+}
+
+/**
+ Display the buffered output of a command and close the file containing it.
+
+ @param Item Pointer to the command whose output should be displayed.
+ */
+VOID
+ForOutputBufferedItem(
+    __in PFOR_EXEC_ITEM Item
+    )
+{
+    PUCHAR Buffer;
+    DWORD BytesRead;
+    DWORD BytesWritten;
+    HANDLE OutputHandle;
+
+    Buffer = YoriLibMalloc(FOR_OUTPUT_COPY_SIZE);
+    if (Buffer != NULL) {
+        OutputHandle = GetStdHandle(STD_OUTPUT_HANDLE);
+        SetFilePointer(Item->OutputFile, 0, NULL, FILE_BEGIN);
+        while (ReadFile(Item->OutputFile, Buffer, FOR_OUTPUT_COPY_SIZE, &BytesRead, NULL) &&
+               BytesRead > 0) {
+
+            if (!WriteFile(OutputHandle, Buffer, BytesRead, &BytesWritten, NULL)) {
+                break;
+            }
+        }
+        YoriLibFree(Buffer);
+    }
+
+    CloseHandle(Item->OutputFile);
+    Item->OutputFile = NULL;
+}
+
+/**
+ Free a command which has been retired.
+
+ @param Item Pointer to the command to free.
+ */
+VOID
+ForFreeItem(
+    __in PFOR_EXEC_ITEM Item
+    )
+{
+    if (Item->OutputFile != NULL) {
+        CloseHandle(Item->OutputFile);
+    }
+    if (Item->ProcessHandle != NULL) {
+        CloseHandle(Item->ProcessHandle);
+    }
+    YoriLibFreeStringContents(&Item->Match);
+    YoriLibDereference(Item);
+}
+
+/**
+ Record the wall time of a completed command so that it can be included in
+ the summary.
+
+ @param ExecContext Pointer to the for exec context.
+
+ @param Item Pointer to the command which has completed.
+ */
+VOID
+ForRecordItemTime(
+    __in PFOR_EXEC_CONTEXT ExecContext,
+    __in PFOR_EXEC_ITEM Item
+    )
+{
+    FILETIME ftCreationTime;
+    FILETIME ftExitTime;
+    FILETIME ftKernelTime;
+    FILETIME ftUserTime;
+    LARGE_INTEGER CreationTime;
+    LARGE_INTEGER ExitTime;
+    LONGLONG WallTimeInMs;
+    DWORD Index;
+
+    if (!GetProcessTimes(Item->ProcessHandle, &ftCreationTime, &ftExitTime, &ftKernelTime, &ftUserTime)) {
+        return;
+    }
+
+    CreationTime.LowPart = ftCreationTime.dwLowDateTime;
+    CreationTime.HighPart = ftCreationTime.dwHighDateTime;
+    ExitTime.LowPart = ftExitTime.dwLowDateTime;
+    ExitTime.HighPart = ftExitTime.dwHighDateTime;
+
+    WallTimeInMs = (ExitTime.QuadPart - CreationTime.QuadPart) / (10 * 1000);
+    ExecContext->TotalWallTimeInMs += WallTimeInMs;
+
+    //
+    //  Find where this command belongs in the list of slowest commands.  If
+    //  it's faster than all of them and the list is full, it's not
+    //  interesting.
+    //
+
+    for (Index = 0; Index < ExecContext->SlowestCount; Index++) {
+        if (WallTimeInMs > ExecContext->Slowest[Index].WallTimeInMs) {
+            break;
+        }
+    }
+
+    if (Index >= FOR_SLOWEST_ITEM_COUNT) {
+        return;
+    }
+
+    if (ExecContext->SlowestCount == FOR_SLOWEST_ITEM_COUNT) {
+        YoriLibFreeStringContents(&ExecContext->Slowest[FOR_SLOWEST_ITEM_COUNT - 1].Match);
+        ExecContext->SlowestCount--;
+    }
+
+    if (Index < ExecContext->SlowestCount) {
+        memmove(&ExecContext->Slowest[Index + 1], &ExecContext->Slowest[Index], (ExecContext->SlowestCount - Index) * sizeof(FOR_SLOW_ITEM));
+    }
+
+    YoriLibCloneString(&ExecContext->Slowest[Index].Match, &Item->Match);
+    ExecContext->Slowest[Index].WallTimeInMs = WallTimeInMs;
+    ExecContext->SlowestCount++;
+}
+
+/**
+ Display the number of commands executed, their wall time, and the slowest
+ commands.
+
+ @param ExecContext Pointer to the for exec context.
+ */
+VOID
+ForDisplaySummary(
+    __in PFOR_EXEC_CONTEXT ExecContext
+    )
+{
+    DWORD Index;
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Commands executed: %i\n"), ExecContext->CompletedCount);
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Total wall time: %lli ms\n"), ExecContext->TotalWallTimeInMs);
+    if (ExecContext->CompletedCount > 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Average wall time: %lli ms\n"), ExecContext->TotalWallTimeInMs / ExecContext->CompletedCount);
+    }
+
+    if (ExecContext->SlowestCount > 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Slowest commands:\n"));
+        for (Index = 0; Index < ExecContext->SlowestCount; Index++) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%10lli ms %y\n"), ExecContext->Slowest[Index].WallTimeInMs, &ExecContext->Slowest[Index].Match);
+        }
+    }
+}
+
+/**
+ Free the summary information.
+
+ @param ExecContext Pointer to the for exec context.
+ */
+VOID
+ForFreeSummary(
+    __in PFOR_EXEC_CONTEXT ExecContext
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < ExecContext->SlowestCount; Index++) {
+        YoriLibFreeStringContents(&ExecContext->Slowest[Index].Match);
+    }
+    ExecContext->SlowestCount = 0;
+}
+
+/**
+ Indicate that a command has completed.  If output is not being displayed in
+ order, the command is retired immediately.  If it is, any completed commands
+ at the front of the list have their output displayed and are retired.
+
+ @param ExecContext Pointer to the for exec context.
+
+ @param Item Pointer to the command which has completed.
+ */
+VOID
+ForCompleteItem(
+    __in PFOR_EXEC_CONTEXT ExecContext,
+    __in PFOR_EXEC_ITEM Item
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+
+    ASSERT(!Item->Completed);
+    Item->Completed = TRUE;
+    ExecContext->CurrentConcurrentCount--;
+    ExecContext->CompletedCount++;
+
+    if (ExecContext->DisplaySummary) {
+        ForRecordItemTime(ExecContext, Item);
+    }
+
+    if (!ExecContext->OrderedOutput) {
+        YoriLibRemoveListItem(&Item->ListEntry);
+        ForFreeItem(Item);
+        return;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&ExecContext->Items, NULL);
+    while (ListEntry != NULL) {
+        Item = CONTAINING_RECORD(ListEntry, FOR_EXEC_ITEM, ListEntry);
+        if (!Item->Completed) {
+            break;
+        }
+
+        ListEntry = YoriLibGetNextListEntry(&ExecContext->Items, ListEntry);
+        if (Item->OutputFile != NULL) {
+            ForOutputBufferedItem(Item);
+        }
+        YoriLibRemoveListItem(&Item->ListEntry);
+        ForFreeItem(Item);
+    }
+}
+
+/**
+ Check each running command to see if it has completed.
+
+ @param ExecContext Pointer to the for exec context.
+
+ @return TRUE if any command was found to have completed, FALSE if not.
+ */
+BOOL
+ForPollForCompletedItems(
+    __in PFOR_EXEC_CONTEXT ExecContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PFOR_EXEC_ITEM Item;
+    BOOL Found;
+
+    Found = FALSE;
+    ListEntry = YoriLibGetNextListEntry(&ExecContext->Items, NULL);
+    while (ListEntry != NULL) {
+        Item = CONTAINING_RECORD(ListEntry, FOR_EXEC_ITEM, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&ExecContext->Items, ListEntry);
+        if (!Item->Completed &&
+            WaitForSingleObject(Item->ProcessHandle, 0) == WAIT_OBJECT_0) {
+
+            //
+            //  Completing an item can retire items after it, so restart
+            //  from the beginning of the list.
+            //
+
+            ForCompleteItem(ExecContext, Item);
+            Found = TRUE;
+            ListEntry = YoriLibGetNextListEntry(&ExecContext->Items, NULL);
+        }
+    }
+
+    return Found;
+}
+
 /**
  Wait for any single process to complete.
 
@@ -138,23 +594,249 @@ ForWaitForProcessToComplete(
     __in PFOR_EXEC_CONTEXT ExecContext
     )
 {
-    DWORD Result;
-    DWORD Index;
+    PYORI_LIST_ENTRY ListEntry;
+    PFOR_EXEC_ITEM Item;
+    PFOR_EXEC_ITEM WaitItems[MAXIMUM_WAIT_OBJECTS];
+    HANDLE WaitHandles[MAXIMUM_WAIT_OBJECTS];
     DWORD Count;
+    DWORD Result;
+    DWORD Message;
+    DWORD ProcessId;
+    DWORD_PTR Key;
+    LPOVERLAPPED Overlapped;
 
-    Result = WaitForMultipleObjects(ExecContext->CurrentConcurrentCount, ExecContext->HandleArray, FALSE, INFINITE);
+    if (ExecContext->CompletionPort != NULL) {
 
-    ASSERT(Result >= WAIT_OBJECT_0 && Result < (WAIT_OBJECT_0 + ExecContext->CurrentConcurrentCount));
+        while (TRUE) {
+            Overlapped = NULL;
+            if (!DllKernel32.pGetQueuedCompletionStatus(ExecContext->CompletionPort, &Message, &Key, &Overlapped, FOR_POLL_INTERVAL)) {
+                if (ForPollForCompletedItems(ExecContext)) {
+                    return;
+                }
+                continue;
+            }
 
-    Index = Result - WAIT_OBJECT_0;
+            if (Message != YORI_JOB_MSG_EXIT_PROCESS &&
+                Message != YORI_JOB_MSG_ABNORMAL_EXIT_PROCESS) {
+                continue;
+            }
 
-    CloseHandle(ExecContext->HandleArray[Index]);
+            ProcessId = (DWORD)(DWORD_PTR)Overlapped;
+            ListEntry = YoriLibGetNextListEntry(&ExecContext->Items, NULL);
+            while (ListEntry != NULL) {
+                Item = CONTAINING_RECORD(ListEntry, FOR_EXEC_ITEM, ListEntry);
+                if (!Item->Completed && Item->ProcessId == ProcessId) {
+                    WaitForSingleObject(Item->ProcessHandle, INFINITE);
+                    ForCompleteItem(ExecContext, Item);
+                    return;
+                }
+                ListEntry = YoriLibGetNextListEntry(&ExecContext->Items, ListEntry);
+            }
+        }
+    }
 
-    for (Count = Index; Count < ExecContext->CurrentConcurrentCount - 1; Count++) {
-        ExecContext->HandleArray[Count] = ExecContext->HandleArray[Count + 1];
+    Count = 0;
+    ListEntry = YoriLibGetNextListEntry(&ExecContext->Items, NULL);
+    while (ListEntry != NULL && Count < MAXIMUM_WAIT_OBJECTS) {
+        Item = CONTAINING_RECORD(ListEntry, FOR_EXEC_ITEM, ListEntry);
+        if (!Item->Completed) {
+            WaitItems[Count] = Item;
+            WaitHandles[Count] = Item->ProcessHandle;
+            Count++;
+        }
+        ListEntry = YoriLibGetNextListEntry(&ExecContext->Items, ListEntry);
     }
 
-    ExecContext->CurrentConcurrentCount--;
+    ASSERT(Count > 0);
+    if (Count == 0) {
+        return;
+    }
+
+    Result = WaitForMultipleObjects(Count, WaitHandles, FALSE, INFINITE);
+
+    ASSERT(Result >= WAIT_OBJECT_0 && Result < (WAIT_OBJECT_0 + Count));
+
+    ForCompleteItem(ExecContext, WaitItems[Result - WAIT_OBJECT_0]);
+}
+
+/**
+ Create a temporary file to buffer the output of a command.  The file is
+ deleted when it is closed.
+
+ @param ExecContext Pointer to the for exec context.
+
+ @return Handle to the temporary file, or NULL on failure.
+ */
+HANDLE
+ForCreateOutputFile(
+    __in PFOR_EXEC_CONTEXT ExecContext
+    )
+{
+    TCHAR TempFileName[MAX_PATH];
+    HANDLE FileHandle;
+    DWORD LastError;
+    LPTSTR ErrText;
+
+    if (ExecContext->TempPath.LengthInChars == 0) {
+        ExecContext->TempPath.LengthAllocated = GetTempPath(0, NULL);
+        if (!YoriLibAllocateString(&ExecContext->TempPath, ExecContext->TempPath.LengthAllocated)) {
+            return NULL;
+        }
+        ExecContext->TempPath.LengthInChars = GetTempPath(ExecContext->TempPath.LengthAllocated, ExecContext->TempPath.StartOfString);
+        if (ExecContext->TempPath.LengthInChars == 0 ||
+            ExecContext->TempPath.LengthInChars >= ExecContext->TempPath.LengthAllocated) {
+
+            YoriLibFreeStringContents(&ExecContext->TempPath);
+            return NULL;
+        }
+    }
+
+    if (GetTempFileName(ExecContext->TempPath.StartOfString, _T("yfo"), 0, TempFileName) == 0) {
+        LastError = GetLastError();
+        ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("for: could not create temporary file: %s"), ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        return NULL;
+    }
+
+    FileHandle = CreateFile(TempFileName,
+                            GENERIC_READ | GENERIC_WRITE,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        LastError = GetLastError();
+        ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("for: could not create temporary file: %s"), ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        DeleteFile(TempFileName);
+        return NULL;
+    }
+
+    return FileHandle;
+}
+
+/**
+ Launch a process to execute a command for a match, and track it until it
+ completes.
+
+ @param Match The match that was found from the set.
+
+ @param CmdLine The command line to execute.
+
+ @param ExecContext The current state of child processes.
+ */
+VOID
+ForLaunchItem(
+    __in PYORI_STRING Match,
+    __in PYORI_STRING CmdLine,
+    __in PFOR_EXEC_CONTEXT ExecContext
+    )
+{
+    PFOR_EXEC_ITEM Item;
+    HANDLE InheritableOutput;
+    PROCESS_INFORMATION ProcessInfo;
+    STARTUPINFO StartupInfo;
+    DWORD CreationFlags;
+    BOOL Result;
+
+    Item = YoriLibReferencedMalloc(sizeof(FOR_EXEC_ITEM) + (Match->LengthInChars + 1) * sizeof(TCHAR));
+    if (Item == NULL) {
+        return;
+    }
+
+    ZeroMemory(Item, sizeof(FOR_EXEC_ITEM));
+    YoriLibReference(Item);
+    Item->Match.MemoryToFree = Item;
+    Item->Match.StartOfString = (LPTSTR)(Item + 1);
+    Item->Match.LengthAllocated = Match->LengthInChars + 1;
+    Item->Match.LengthInChars = Match->LengthInChars;
+    memcpy(Item->Match.StartOfString, Match->StartOfString, Match->LengthInChars * sizeof(TCHAR));
+    Item->Match.StartOfString[Match->LengthInChars] = '\0';
+
+    memset(&StartupInfo, 0, sizeof(StartupInfo));
+    StartupInfo.cb = sizeof(StartupInfo);
+
+    //
+    //  If output is being buffered, give the child an inheritable handle
+    //  to a temporary file.  The handle kept by this process is not
+    //  inheritable so that it is not leaked into later children.
+    //
+
+    InheritableOutput = NULL;
+    if (ExecContext->OrderedOutput) {
+        Item->OutputFile = ForCreateOutputFile(ExecContext);
+        if (Item->OutputFile == NULL) {
+            ForFreeItem(Item);
+            return;
+        }
+
+        if (!DuplicateHandle(GetCurrentProcess(), Item->OutputFile, GetCurrentProcess(), &InheritableOutput, 0, TRUE, DUPLICATE_SAME_ACCESS)) {
+            ForFreeItem(Item);
+            return;
+        }
+
+        StartupInfo.dwFlags = STARTF_USESTDHANDLES;
+        StartupInfo.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+        StartupInfo.hStdOutput = InheritableOutput;
+        StartupInfo.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+    }
+
+    //
+    //  If the process will be tracked by the job, start it suspended so
+    //  that it cannot exit before it is in the job.
+    //
+
+    CreationFlags = 0;
+    if (ExecContext->Job != NULL) {
+        CreationFlags = CREATE_SUSPENDED;
+    }
+
+    Result = CreateProcess(NULL, CmdLine->StartOfString, NULL, NULL, TRUE, CreationFlags, NULL, NULL, &StartupInfo, &ProcessInfo);
+
+    if (InheritableOutput != NULL) {
+        CloseHandle(InheritableOutput);
+    }
+
+    if (!Result) {
+        DWORD LastError = GetLastError();
+        LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("for: execution failed: %s"), ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        ForFreeItem(Item);
+        return;
+    }
+
+    //
+    //  If the process can't be placed in the job, and no process has ever
+    //  been, assume the system doesn't support it (eg. this process is
+    //  already in a job on a system without nested jobs) and wait on
+    //  processes directly.  If some processes have been placed in the job,
+    //  this one is found by polling.
+    //
+
+    if (ExecContext->Job != NULL) {
+        if (YoriLibAssignProcessToJobObject(ExecContext->Job, ProcessInfo.hProcess)) {
+            ExecContext->JobAssignmentSucceeded = TRUE;
+        } else if (!ExecContext->JobAssignmentSucceeded) {
+            ForCloseCompletionPort(ExecContext);
+        }
+        ResumeThread(ProcessInfo.hThread);
+    }
+
+    CloseHandle(ProcessInfo.hThread);
+
+    Item->ProcessHandle = ProcessInfo.hProcess;
+    Item->ProcessId = ProcessInfo.dwProcessId;
+    YoriLibAppendList(&ExecContext->Items, &Item->ListEntry);
+    ExecContext->CurrentConcurrentCount++;
+
+    while (ExecContext->CurrentConcurrentCount >= ExecContext->TargetConcurrentCount) {
+        ForWaitForProcessToComplete(ExecContext);
+    }
 }
 
 /**
@@ -181,8 +863,6 @@ ForExecuteCommand(
     YORI_STRING NewArgWritePoint;
     PYORI_STRING NewArgArray;
     YORI_STRING CmdLine;
-    PROCESS_INFORMATION ProcessInfo;
-    STARTUPINFO StartupInfo;
 
     YoriLibInitEmptyString(&CmdLine);
 
@@ -303,25 +983,7 @@ ForExecuteCommand(
     }
 #endif
 
-    memset(&StartupInfo, 0, sizeof(StartupInfo));
-    StartupInfo.cb = sizeof(StartupInfo);
-
-    if (!CreateProcess(NULL, CmdLine.StartOfString, NULL, NULL, TRUE, 0, NULL, NULL, &StartupInfo, &ProcessInfo)) {
-        DWORD LastError = GetLastError();
-        LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("for: execution failed: %s"), ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        goto Cleanup;
-    }
-
-    CloseHandle(ProcessInfo.hThread);
-
-    ExecContext->HandleArray[ExecContext->CurrentConcurrentCount] = ProcessInfo.hProcess;
-    ExecContext->CurrentConcurrentCount++;
-
-    if (ExecContext->CurrentConcurrentCount == ExecContext->TargetConcurrentCount) {
-        ForWaitForProcessToComplete(ExecContext);
-    }
+    ForLaunchItem(Match, &CmdLine, ExecContext);
 
 Cleanup:
 
@@ -422,6 +1084,8 @@ ENTRYPOINT(
 
     ExecContext.TargetConcurrentCount = 1;
     ExecContext.CurrentConcurrentCount = 0;
+    YoriLibInitializeListHead(&ExecContext.Items);
+    YoriLibLoadKernel32Functions();
     MatchDirectories = FALSE;
     Recurse = FALSE;
     StepMode = FALSE;
@@ -468,6 +1132,9 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("l")) == 0) {
                 StepMode = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("o")) == 0) {
+                ExecContext.OrderedOutput = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("p")) == 0) {
                 if (i + 1 < ArgC) {
                     LONGLONG LlNumberProcesses = 0;
@@ -483,6 +1150,9 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("r")) == 0) {
                 Recurse = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("s")) == 0) {
+                ExecContext.DisplaySummary = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("-")) == 0) {
                 ArgumentUnderstood = TRUE;
                 StartArg = i + 1;
@@ -564,9 +1234,20 @@ ENTRYPOINT(
 
     ExecContext.ArgC = ArgC - CmdArg;
     ExecContext.ArgV = &ArgV[CmdArg];
-    ExecContext.HandleArray = YoriLibMalloc(ExecContext.TargetConcurrentCount * sizeof(HANDLE));
-    if (ExecContext.HandleArray == NULL) {
-        goto cleanup_and_exit;
+
+    //
+    //  Without a completion port, processes are waited on directly, which
+    //  can only wait on a limited number at once.
+    //
+
+    if (ExecContext.TargetConcurrentCount > 1) {
+        ForInitializeCompletionPort(&ExecContext);
+    }
+
+    if (ExecContext.CompletionPort == NULL &&
+        ExecContext.TargetConcurrentCount > MAXIMUM_WAIT_OBJECTS) {
+
+        ExecContext.TargetConcurrentCount = MAXIMUM_WAIT_OBJECTS;
     }
 
     MatchFlags = 0;
@@ -764,13 +1445,26 @@ ENTRYPOINT(
         ForWaitForProcessToComplete(&ExecContext);
     }
 
+    if (ExecContext.DisplaySummary) {
+        ForDisplaySummary(&ExecContext);
+    }
+
+    ForFreeSummary(&ExecContext);
+    ForCloseCompletionPort(&ExecContext);
+    YoriLibFreeStringContents(&ExecContext.TempPath);
     YoriLibFileFiltFreeFilter(&ExecContext.Filter);
-    YoriLibFree(ExecContext.HandleArray);
 
     return EXIT_SUCCESS;
 
 cleanup_and_exit:
 
+    while (ExecContext.CurrentConcurrentCount > 0) {
+        ForWaitForProcessToComplete(&ExecContext);
+    }
+
+    ForFreeSummary(&ExecContext);
+    ForCloseCompletionPort(&ExecContext);
+    YoriLibFreeStringContents(&ExecContext.TempPath);
     YoriLibFileFiltFreeFilter(&ExecContext.Filter);
 
     return EXIT_FAILURE;
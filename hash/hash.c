@@ -27,16 +27,6 @@
 #include <yoripch.h>
 #include <yorilib.h>
 
-/**
- Specifies the builtin Microsoft hash provider.
- */
-#define MS_PRIMITIVE_PROVIDER L"Microsoft Primitive Provider"
-
-/**
- Specifies the NT success error code.
- */
-#define STATUS_SUCCESS (0)
-
 /**
  Help text to display to the user.
  */
@@ -78,33 +68,22 @@ typedef struct _HASH_CONTEXT {
     BOOL Recursive;
 
     /**
-     BCrypt handle to the algorithm provider.  If NULL, the algorithm provider
-     has not been initialized.
+     The hash algorithm provider.
      */
-    PVOID Algorithm;
+    YORI_LIB_FILE_HASH_ALGORITHM Algorithm;
 
     /**
      Pointer to an opaque blob of memory which is used by BCrypt to generate
-     the hash.
+     the hash.  This is Algorithm.ScratchBufferLength bytes.
      */
     PVOID ScratchBuffer;
 
-    /**
-     Specifies the number of bytes in ScratchBuffer.
-     */
-    DWORD ScratchBufferLength;
-
     /**
      Pointer to a blob of memory containing the result of the hash calculation
-     for each file.
+     for each file.  This is Algorithm.HashLength bytes.
      */
     PUCHAR HashBuffer;
 
-    /**
-     Specifies the number of bytes in HashBuffer.
-     */
-    DWORD HashLength;
-
     /**
      Pointer to a buffer to read data from the file into.
      */
@@ -150,49 +129,22 @@ HashProcessStream(
     __in PHASH_CONTEXT HashContext
     )
 {
-    LONG Status;
-    PVOID hHash;
-    DWORD BytesRead;
-
     HashContext->FilesFound++;
     HashContext->FilesFoundThisArg++;
 
-    Status = DllBCrypt.pBCryptCreateHash(HashContext->Algorithm, &hHash, HashContext->ScratchBuffer, HashContext->ScratchBufferLength, NULL, 0, 0);
+    if (!YoriLibFileHashStream(&HashContext->Algorithm,
+                               hSource,
+                               (DWORDLONG)-1,
+                               HashContext->ScratchBuffer,
+                               HashContext->ReadBuffer,
+                               HashContext->ReadBufferLength,
+                               HashContext->HashBuffer,
+                               NULL)) {
 
-    if (Status != STATUS_SUCCESS) {
         return FALSE;
     }
 
-    Status = STATUS_SUCCESS;
-
-    while (TRUE) {
-        if (!ReadFile(hSource, HashContext->ReadBuffer, HashContext->ReadBufferLength, &BytesRead, NULL)) {
-            break;
-        }
-
-        if (BytesRead == 0) {
-            break;
-        }
-
-        Status = DllBCrypt.pBCryptHashData(hHash, HashContext->ReadBuffer, BytesRead, 0);
-        if (Status != STATUS_SUCCESS) {
-            break;
-        }
-
-    }
-
-    if (Status == STATUS_SUCCESS) {
-        Status = DllBCrypt.pBCryptFinishHash(hHash, HashContext->HashBuffer, HashContext->HashLength, 0);
-        if (Status == STATUS_SUCCESS) {
-            if (!YoriLibHexBufferToString(HashContext->HashBuffer, HashContext->HashLength, &HashContext->HashString)) {
-                Status = !(STATUS_SUCCESS);
-            }
-        }
-    }
-
-    DllBCrypt.pBCryptDestroyHash(hHash);
-
-    if (Status != STATUS_SUCCESS) {
+    if (!YoriLibHexBufferToString(HashContext->HashBuffer, HashContext->Algorithm.HashLength, &HashContext->HashString)) {
         return FALSE;
     }
 
@@ -286,8 +238,6 @@ HashCleanupContext(
     __in PHASH_CONTEXT HashContext
     )
 {
-    LONG Status;
-
     if (HashContext->ScratchBuffer != NULL) {
         YoriLibFree(HashContext->ScratchBuffer);
         HashContext->ScratchBuffer = NULL;
@@ -304,12 +254,7 @@ HashCleanupContext(
     }
 
     YoriLibFreeStringContents(&HashContext->HashString);
-
-    if (HashContext->Algorithm != NULL) {
-        Status = DllBCrypt.pBCryptCloseAlgorithmProvider(HashContext->Algorithm, 0);
-        ASSERT(Status == STATUS_SUCCESS);
-        HashContext->Algorithm = NULL;
-    }
+    YoriLibFileHashCloseAlgorithm(&HashContext->Algorithm);
 }
 
 /**
@@ -330,42 +275,27 @@ HashInitializeContext(
     )
 {
     LONG Status;
-    DWORD BytesReturned;
 
-    Status = DllBCrypt.pBCryptOpenAlgorithmProvider(&HashContext->Algorithm, Algorithm, MS_PRIMITIVE_PROVIDER, 0);
-    if (Status != STATUS_SUCCESS) {
+    Status = YoriLibFileHashOpenAlgorithm(Algorithm, &HashContext->Algorithm);
+    if (Status != 0) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: algorithm provider not functional, status 0x%08x\n"), Status);
         HashCleanupContext(HashContext);
         return FALSE;
     }
 
-    Status = DllBCrypt.pBCryptGetProperty(HashContext->Algorithm, L"HashDigestLength", &HashContext->HashLength, sizeof(HashContext->HashLength), &BytesReturned, 0);
-    if (Status != STATUS_SUCCESS) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: algorithm provider did not return required hash length, status 0x%08x\n"), Status);
-        HashCleanupContext(HashContext);
-        return FALSE;
-    }
-
-    HashContext->HashBuffer = YoriLibMalloc(HashContext->HashLength);
+    HashContext->HashBuffer = YoriLibMalloc(HashContext->Algorithm.HashLength);
     if (HashContext->HashBuffer == NULL) {
         HashCleanupContext(HashContext);
         return FALSE;
     }
 
-    Status = DllBCrypt.pBCryptGetProperty(HashContext->Algorithm, L"ObjectLength", &HashContext->ScratchBufferLength, sizeof(HashContext->ScratchBufferLength), &BytesReturned, 0);
-    if (Status != STATUS_SUCCESS) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: algorithm provider did not return required scratch space, status 0x%08x\n"), Status);
-        HashCleanupContext(HashContext);
-        return FALSE;
-    }
-
-    HashContext->ScratchBuffer = YoriLibMalloc(HashContext->ScratchBufferLength);
+    HashContext->ScratchBuffer = YoriLibMalloc(HashContext->Algorithm.ScratchBufferLength);
     if (HashContext->ScratchBuffer == NULL) {
         HashCleanupContext(HashContext);
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&HashContext->HashString, HashContext->HashLength * 2 + 1)) {
+    if (!YoriLibAllocateString(&HashContext->HashString, HashContext->Algorithm.HashLength * 2 + 1)) {
         HashCleanupContext(HashContext);
         return FALSE;
     }
@@ -75,6 +75,7 @@ CHAR strHelpHelpText1[] =
         "CUT       Outputs a portion of an input buffer of text\n"
         "CVTVT     Converts text with VT100 color escapes into another format\n"
         "DATE      Outputs the system date and time in a specified format\n"
+        "DEDUPE    Find files with identical contents\n"
         "DF        Display disk free space\n"
         "DIR       Enumerate the contents of directories in a traditional way\n"
         "DU        Display disk space used within a directory tree\n"
@@ -94,6 +95,7 @@ CHAR strHelpHelpText2[] =
         "EXIT      Exits the shell\n"
         "EXPR      Evaluate simple arithmetic expressions\n"
         "FALSE     Return false\n"
+        "FFIND     Find files on a volume by name using the change journal\n"
         "FINFO     Output information about file metadata\n"
         "FG        Display the output of a background job in the foreground\n"
         "FOR       Enumerates through a list of strings or files\n"
@@ -0,0 +1,872 @@
+/**
+ * @file lib/copyrng.c
+ *
+ * Yori copy a range of data between files, preserving sparse regions and
+ * sharing clusters where the file system allows it.
+ *
+ * Copyright (c) 2019 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+/**
+ The size of each buffer used when copying data through memory.
+ */
+#define YORI_LIB_COPY_RANGE_BUFFER_SIZE (1024 * 1024)
+
+/**
+ The largest number of bytes to ask the file system to share in a single
+ request.
+ */
+#define YORI_LIB_COPY_RANGE_CLONE_CHUNK (1024 * 1024 * 1024)
+
+/**
+ The largest cluster size that a file system supporting block cloning is
+ expected to use.  Ranges which are a multiple of this size satisfy any
+ alignment requirement.
+ */
+#define YORI_LIB_COPY_RANGE_CLONE_ALIGNMENT (64 * 1024)
+
+/**
+ State shared between the thread reading from the source and the thread
+ writing to the destination when copying through memory.  Two buffers are
+ used, so one can be filled while the other is written.
+ */
+typedef struct _YORI_LIB_COPY_PIPELINE {
+
+    /**
+     Handle to the destination.
+     */
+    HANDLE DestHandle;
+
+    /**
+     TRUE if the destination is a file and writes should be positioned at
+     an explicit offset.  FALSE if the destination is a pipe or device
+     that can only be written sequentially.
+     */
+    BOOL DestIsFile;
+
+    /**
+     The buffers used to move data.
+     */
+    PVOID Buffers[2];
+
+    /**
+     The size of each buffer, in bytes.
+     */
+    DWORD BufferSize;
+
+    /**
+     The number of bytes of data in each buffer.  A value of zero in a full
+     buffer indicates there is no more data.
+     */
+    DWORD BytesInBuffer[2];
+
+    /**
+     The offset in the destination to write each buffer to.
+     */
+    LONGLONG DestOffset[2];
+
+    /**
+     Events signalled by the reader when a buffer has been populated.
+     */
+    HANDLE BufferFull[2];
+
+    /**
+     Events signalled by the writer when a buffer is available to be
+     populated.
+     */
+    HANDLE BufferEmpty[2];
+
+    /**
+     The index of the next buffer for the reader to populate.
+     */
+    DWORD NextBuffer;
+
+    /**
+     The thread writing to the destination, or NULL if all I/O is being
+     performed by the calling thread.
+     */
+    HANDLE WriterThread;
+
+    /**
+     If nonzero, the error encountered writing to the destination.  Once
+     set, no further writes are attempted.
+     */
+    DWORD WriteError;
+
+} YORI_LIB_COPY_PIPELINE, *PYORI_LIB_COPY_PIPELINE;
+
+/**
+ Set the file pointer of a handle to an absolute offset.
+
+ @param Handle The handle to reposition.
+
+ @param Offset The offset to move to, in bytes.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibCopyRangeSetPosition(
+    __in HANDLE Handle,
+    __in LONGLONG Offset
+    )
+{
+    LARGE_INTEGER Position;
+
+    Position.QuadPart = Offset;
+    Position.LowPart = SetFilePointer(Handle, Position.LowPart, &Position.HighPart, FILE_BEGIN);
+    if (Position.LowPart == (DWORD)-1 && GetLastError() != NO_ERROR) {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ Return the current file pointer of a handle.
+
+ @param Handle The handle to query.
+
+ @param Offset On successful completion, populated with the current offset.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibCopyRangeGetPosition(
+    __in HANDLE Handle,
+    __out PLONGLONG Offset
+    )
+{
+    LARGE_INTEGER Position;
+
+    Position.HighPart = 0;
+    Position.LowPart = SetFilePointer(Handle, 0, &Position.HighPart, FILE_CURRENT);
+    if (Position.LowPart == (DWORD)-1 && GetLastError() != NO_ERROR) {
+        return FALSE;
+    }
+    *Offset = Position.QuadPart;
+    return TRUE;
+}
+
+/**
+ Write a buffer to a handle, looping until all of it has been written.
+
+ @param Handle The handle to write to.
+
+ @param Buffer Pointer to the data to write.
+
+ @param BytesToWrite The number of bytes to write.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibCopyRangeWriteAll(
+    __in HANDLE Handle,
+    __in PVOID Buffer,
+    __in DWORD BytesToWrite
+    )
+{
+    DWORD BytesSent;
+    DWORD BytesWritten;
+
+    BytesSent = 0;
+    while (BytesSent < BytesToWrite) {
+        if (!WriteFile(Handle, YoriLibAddToPointer(Buffer, BytesSent), BytesToWrite - BytesSent, &BytesWritten, NULL)) {
+            return FALSE;
+        }
+        if (BytesWritten == 0) {
+            SetLastError(ERROR_WRITE_FAULT);
+            return FALSE;
+        }
+        BytesSent += BytesWritten;
+    }
+
+    return TRUE;
+}
+
+/**
+ Write a single buffer from the pipeline to the destination, recording any
+ error in the pipeline.
+
+ @param Pipeline Pointer to the pipeline.
+
+ @param Index The index of the buffer to write.
+ */
+VOID
+YoriLibCopyRangeWriteBuffer(
+    __in PYORI_LIB_COPY_PIPELINE Pipeline,
+    __in DWORD Index
+    )
+{
+    if (Pipeline->WriteError != ERROR_SUCCESS) {
+        return;
+    }
+
+    if (Pipeline->DestIsFile &&
+        !YoriLibCopyRangeSetPosition(Pipeline->DestHandle, Pipeline->DestOffset[Index])) {
+
+        Pipeline->WriteError = GetLastError();
+        return;
+    }
+
+    if (!YoriLibCopyRangeWriteAll(Pipeline->DestHandle, Pipeline->Buffers[Index], Pipeline->BytesInBuffer[Index])) {
+        Pipeline->WriteError = GetLastError();
+    }
+}
+
+/**
+ A background thread which writes buffers to the destination as the reader
+ populates them.
+
+ @param Context Pointer to the pipeline.
+
+ @return Zero.
+ */
+DWORD WINAPI
+YoriLibCopyRangeWriter(
+    __in PVOID Context
+    )
+{
+    PYORI_LIB_COPY_PIPELINE Pipeline = (PYORI_LIB_COPY_PIPELINE)Context;
+    DWORD Index;
+
+    Index = 0;
+    while (TRUE) {
+        WaitForSingleObject(Pipeline->BufferFull[Index], INFINITE);
+        if (Pipeline->BytesInBuffer[Index] == 0) {
+            break;
+        }
+
+        YoriLibCopyRangeWriteBuffer(Pipeline, Index);
+        SetEvent(Pipeline->BufferEmpty[Index]);
+        Index = Index ^ 1;
+    }
+
+    return 0;
+}
+
+/**
+ Free the resources associated with a pipeline.
+
+ @param Pipeline Pointer to the pipeline.
+ */
+VOID
+YoriLibCopyRangeCleanupPipeline(
+    __in PYORI_LIB_COPY_PIPELINE Pipeline
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < 2; Index++) {
+        if (Pipeline->BufferFull[Index] != NULL) {
+            CloseHandle(Pipeline->BufferFull[Index]);
+            Pipeline->BufferFull[Index] = NULL;
+        }
+        if (Pipeline->BufferEmpty[Index] != NULL) {
+            CloseHandle(Pipeline->BufferEmpty[Index]);
+            Pipeline->BufferEmpty[Index] = NULL;
+        }
+    }
+
+    if (Pipeline->Buffers[0] != NULL) {
+        YoriLibFree(Pipeline->Buffers[0]);
+        Pipeline->Buffers[0] = NULL;
+        Pipeline->Buffers[1] = NULL;
+    }
+}
+
+/**
+ Prepare a pipeline to copy data through memory.  If the data fits in a
+ single buffer, the calling thread performs the read and write using a
+ buffer sized to the data.  Otherwise, if a writer thread can be created,
+ reads and writes are overlapped; failing that the calling thread performs
+ both.
+
+ @param Pipeline Pointer to the pipeline to initialize.
+
+ @param DestHandle Handle to the destination.
+
+ @param DestIsFile TRUE if writes to the destination should be positioned at
+        explicit offsets.
+
+ @param Length The number of bytes that will be copied, or
+        YORI_LIB_COPY_RANGE_TO_END if this is not known.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibCopyRangeInitializePipeline(
+    __out PYORI_LIB_COPY_PIPELINE Pipeline,
+    __in HANDLE DestHandle,
+    __in BOOL DestIsFile,
+    __in LONGLONG Length
+    )
+{
+    DWORD Index;
+    DWORD ThreadId;
+
+    ZeroMemory(Pipeline, sizeof(YORI_LIB_COPY_PIPELINE));
+    Pipeline->DestHandle = DestHandle;
+    Pipeline->DestIsFile = DestIsFile;
+
+    if (Length != YORI_LIB_COPY_RANGE_TO_END &&
+        Length <= YORI_LIB_COPY_RANGE_BUFFER_SIZE) {
+
+        Pipeline->BufferSize = (DWORD)Length;
+        Pipeline->Buffers[0] = YoriLibMalloc(Pipeline->BufferSize);
+        if (Pipeline->Buffers[0] == NULL) {
+            return FALSE;
+        }
+        Pipeline->Buffers[1] = Pipeline->Buffers[0];
+        return TRUE;
+    }
+
+    Pipeline->BufferSize = YORI_LIB_COPY_RANGE_BUFFER_SIZE;
+    Pipeline->Buffers[0] = YoriLibMalloc(YORI_LIB_COPY_RANGE_BUFFER_SIZE * 2);
+    if (Pipeline->Buffers[0] == NULL) {
+        return FALSE;
+    }
+    Pipeline->Buffers[1] = YoriLibAddToPointer(Pipeline->Buffers[0], YORI_LIB_COPY_RANGE_BUFFER_SIZE);
+
+    for (Index = 0; Index < 2; Index++) {
+        Pipeline->BufferFull[Index] = CreateEvent(NULL, FALSE, FALSE, NULL);
+        Pipeline->BufferEmpty[Index] = CreateEvent(NULL, FALSE, TRUE, NULL);
+        if (Pipeline->BufferFull[Index] == NULL ||
+            Pipeline->BufferEmpty[Index] == NULL) {
+
+            YoriLibCopyRangeCleanupPipeline(Pipeline);
+            return FALSE;
+        }
+    }
+
+    Pipeline->WriterThread = CreateThread(NULL, 0, YoriLibCopyRangeWriter, Pipeline, 0, &ThreadId);
+    return TRUE;
+}
+
+/**
+ Read a range of the source into the pipeline.
+
+ @param Pipeline Pointer to the pipeline.
+
+ @param SourceHandle Handle to the source.
+
+ @param SourceOffset If not YORI_LIB_COPY_RANGE_CURRENT_OFFSET, the offset in
+        the source to read from.
+
+ @param DestOffset The offset in the destination to write the data to.  This
+        is ignored if the destination is not a file.
+
+ @param Length The number of bytes to copy, or YORI_LIB_COPY_RANGE_TO_END to
+        copy until the source indicates no more data.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibCopyRangeFeedPipeline(
+    __in PYORI_LIB_COPY_PIPELINE Pipeline,
+    __in HANDLE SourceHandle,
+    __in LONGLONG SourceOffset,
+    __in LONGLONG DestOffset,
+    __in LONGLONG Length
+    )
+{
+    DWORD Index;
+    DWORD ReadSize;
+    DWORD BytesToRead;
+    DWORD BytesRead;
+    DWORD Err;
+
+    if (SourceOffset != YORI_LIB_COPY_RANGE_CURRENT_OFFSET &&
+        !YoriLibCopyRangeSetPosition(SourceHandle, SourceOffset)) {
+
+        return FALSE;
+    }
+
+    ReadSize = Pipeline->BufferSize;
+
+    while (Length == YORI_LIB_COPY_RANGE_TO_END || Length > 0) {
+
+        Index = Pipeline->NextBuffer;
+        if (Pipeline->WriterThread != NULL) {
+            WaitForSingleObject(Pipeline->BufferEmpty[Index], INFINITE);
+        }
+
+        if (Pipeline->WriteError != ERROR_SUCCESS) {
+            SetEvent(Pipeline->BufferEmpty[Index]);
+            SetLastError(Pipeline->WriteError);
+            return FALSE;
+        }
+
+        BytesToRead = ReadSize;
+        if (Length != YORI_LIB_COPY_RANGE_TO_END && (LONGLONG)BytesToRead > Length) {
+            BytesToRead = (DWORD)Length;
+        }
+
+        if (!ReadFile(SourceHandle, Pipeline->Buffers[Index], BytesToRead, &BytesRead, NULL)) {
+            Err = GetLastError();
+            SetEvent(Pipeline->BufferEmpty[Index]);
+
+            //
+            //  When copying to the end of a device, reads which extend
+            //  beyond the end of the device fail rather than returning
+            //  partial data, so retry with smaller reads to obtain the
+            //  final sectors.  A pipe whose writer has closed reports an
+            //  error rather than returning zero bytes.  Either way, once
+            //  no more data can be read, the copy is complete.
+            //
+
+            if (Length == YORI_LIB_COPY_RANGE_TO_END) {
+                if (Err != ERROR_BROKEN_PIPE && ReadSize > 512) {
+                    ReadSize = ReadSize / 2;
+                    continue;
+                }
+                break;
+            }
+            SetLastError(Err);
+            return FALSE;
+        }
+
+        if (BytesRead == 0) {
+            SetEvent(Pipeline->BufferEmpty[Index]);
+            if (Length == YORI_LIB_COPY_RANGE_TO_END) {
+                break;
+            }
+            SetLastError(ERROR_HANDLE_EOF);
+            return FALSE;
+        }
+
+        Pipeline->BytesInBuffer[Index] = BytesRead;
+        Pipeline->DestOffset[Index] = DestOffset;
+
+        if (Pipeline->WriterThread != NULL) {
+            SetEvent(Pipeline->BufferFull[Index]);
+            Pipeline->NextBuffer = Index ^ 1;
+        } else {
+            YoriLibCopyRangeWriteBuffer(Pipeline, Index);
+        }
+
+        DestOffset += BytesRead;
+        if (Length != YORI_LIB_COPY_RANGE_TO_END) {
+            Length -= BytesRead;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Indicate that no more data will be added to the pipeline, wait for all
+ outstanding writes to complete, and free the pipeline's resources.
+
+ @param Pipeline Pointer to the pipeline.
+
+ @return TRUE if all writes succeeded, FALSE if any write failed.
+ */
+BOOL
+YoriLibCopyRangeCompletePipeline(
+    __in PYORI_LIB_COPY_PIPELINE Pipeline
+    )
+{
+    DWORD Index;
+
+    if (Pipeline->WriterThread != NULL) {
+        Index = Pipeline->NextBuffer;
+        WaitForSingleObject(Pipeline->BufferEmpty[Index], INFINITE);
+        Pipeline->BytesInBuffer[Index] = 0;
+        SetEvent(Pipeline->BufferFull[Index]);
+        WaitForSingleObject(Pipeline->WriterThread, INFINITE);
+        CloseHandle(Pipeline->WriterThread);
+        Pipeline->WriterThread = NULL;
+    }
+
+    YoriLibCopyRangeCleanupPipeline(Pipeline);
+
+    if (Pipeline->WriteError != ERROR_SUCCESS) {
+        SetLastError(Pipeline->WriteError);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Attempt to have the file system share clusters between the source and
+ destination rather than copying data.  This is supported by file systems
+ with block cloning, and requires both files to be on the same volume and
+ ranges to be aligned to clusters, except for a range ending at the end of
+ the source.
+
+ @param SourceHandle Handle to the source file.
+
+ @param SourceOffset The offset in the source file.
+
+ @param DestHandle Handle to the destination file, which must already be
+        large enough to contain the range.
+
+ @param DestOffset The offset in the destination file.
+
+ @param Length The number of bytes to share.
+
+ @return The number of bytes from the beginning of the range which have been
+         shared.  The caller is expected to copy any remainder.
+ */
+LONGLONG
+YoriLibCopyRangeClone(
+    __in HANDLE SourceHandle,
+    __in LONGLONG SourceOffset,
+    __in HANDLE DestHandle,
+    __in LONGLONG DestOffset,
+    __in LONGLONG Length
+    )
+{
+    DUPLICATE_EXTENTS_DATA Extents;
+    LONGLONG BytesCloned;
+    LONGLONG ChunkLength;
+    DWORD BytesReturned;
+
+    if ((SourceOffset % YORI_LIB_COPY_RANGE_CLONE_ALIGNMENT) != 0 ||
+        (DestOffset % YORI_LIB_COPY_RANGE_CLONE_ALIGNMENT) != 0) {
+
+        return 0;
+    }
+
+    BytesCloned = 0;
+    while (BytesCloned < Length) {
+        ChunkLength = Length - BytesCloned;
+        if (ChunkLength > YORI_LIB_COPY_RANGE_CLONE_CHUNK) {
+            ChunkLength = YORI_LIB_COPY_RANGE_CLONE_CHUNK;
+        }
+
+        Extents.FileHandle = SourceHandle;
+        Extents.SourceFileOffset.QuadPart = SourceOffset + BytesCloned;
+        Extents.TargetFileOffset.QuadPart = DestOffset + BytesCloned;
+        Extents.ByteCount.QuadPart = ChunkLength;
+
+        if (!DeviceIoControl(DestHandle, FSCTL_DUPLICATE_EXTENTS_TO_FILE, &Extents, sizeof(Extents), NULL, 0, &BytesReturned, NULL)) {
+
+            //
+            //  The final range may fail because it is not a multiple of
+            //  the cluster size.  Share the aligned portion and leave the
+            //  tail to be copied.
+            //
+
+            ChunkLength = ChunkLength - (ChunkLength % YORI_LIB_COPY_RANGE_CLONE_ALIGNMENT);
+            if (ChunkLength == 0 || ChunkLength == Extents.ByteCount.QuadPart) {
+                break;
+            }
+
+            Extents.ByteCount.QuadPart = ChunkLength;
+            if (!DeviceIoControl(DestHandle, FSCTL_DUPLICATE_EXTENTS_TO_FILE, &Extents, sizeof(Extents), NULL, 0, &BytesReturned, NULL)) {
+                break;
+            }
+            BytesCloned += ChunkLength;
+            break;
+        }
+
+        BytesCloned += ChunkLength;
+    }
+
+    return BytesCloned;
+}
+
+/**
+ Copy a range of a sparse source file, copying allocated ranges through the
+ pipeline and zeroing the corresponding ranges of the destination for
+ regions of the source that are not allocated.
+
+ @param Pipeline Pointer to the pipeline.
+
+ @param SourceHandle Handle to the source file.
+
+ @param SourceOffset The offset in the source file.
+
+ @param DestHandle Handle to the destination file.
+
+ @param DestOffset The offset in the destination file.
+
+ @param Length The number of bytes to copy.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibCopyRangeSparse(
+    __in PYORI_LIB_COPY_PIPELINE Pipeline,
+    __in HANDLE SourceHandle,
+    __in LONGLONG SourceOffset,
+    __in HANDLE DestHandle,
+    __in LONGLONG DestOffset,
+    __in LONGLONG Length
+    )
+{
+    FILE_ALLOCATED_RANGE_BUFFER StartBuffer;
+    FILE_ZERO_DATA_INFORMATION ZeroData;
+    union {
+        FILE_ALLOCATED_RANGE_BUFFER Extents[1];
+        UCHAR Buffer[2048];
+    } u;
+    DWORD BytesReturned;
+    DWORD ElementCount;
+    DWORD Index;
+    LONGLONG EndOffset;
+    LONGLONG CurrentOffset;
+    LONGLONG RangeStart;
+    LONGLONG RangeEnd;
+
+    EndOffset = SourceOffset + Length;
+    CurrentOffset = SourceOffset;
+
+    while (CurrentOffset < EndOffset) {
+        StartBuffer.FileOffset.QuadPart = CurrentOffset;
+        StartBuffer.Length.QuadPart = EndOffset - CurrentOffset;
+
+        if (!DeviceIoControl(SourceHandle, FSCTL_QUERY_ALLOCATED_RANGES, &StartBuffer, sizeof(StartBuffer), &u.Extents, sizeof(u), &BytesReturned, NULL) &&
+            GetLastError() != ERROR_MORE_DATA) {
+
+            //
+            //  If the ranges can't be determined, copy the remainder as
+            //  though it were allocated.
+            //
+
+            return YoriLibCopyRangeFeedPipeline(Pipeline, SourceHandle, CurrentOffset, DestOffset + (CurrentOffset - SourceOffset), EndOffset - CurrentOffset);
+        }
+
+        ElementCount = BytesReturned / sizeof(FILE_ALLOCATED_RANGE_BUFFER);
+
+        //
+        //  If nothing more is allocated, the remainder is a hole.  Pretend
+        //  an empty allocation exists at the end so it's zeroed below.
+        //
+
+        if (ElementCount == 0) {
+            u.Extents[0].FileOffset.QuadPart = EndOffset;
+            u.Extents[0].Length.QuadPart = 0;
+            ElementCount = 1;
+        }
+
+        for (Index = 0; Index < ElementCount; Index++) {
+            RangeStart = u.Extents[Index].FileOffset.QuadPart;
+            RangeEnd = RangeStart + u.Extents[Index].Length.QuadPart;
+            if (RangeStart < CurrentOffset) {
+                RangeStart = CurrentOffset;
+            }
+            if (RangeEnd > EndOffset) {
+                RangeEnd = EndOffset;
+            }
+            if (RangeStart > EndOffset) {
+                RangeStart = EndOffset;
+            }
+
+            //
+            //  Zero the hole preceding this range.  If the destination
+            //  can't zero a range, copy the zeroes from the source.
+            //
+
+            if (RangeStart > CurrentOffset) {
+                ZeroData.FileOffset.QuadPart = DestOffset + (CurrentOffset - SourceOffset);
+                ZeroData.BeyondFinalZero.QuadPart = DestOffset + (RangeStart - SourceOffset);
+                if (!DeviceIoControl(DestHandle, FSCTL_SET_ZERO_DATA, &ZeroData, sizeof(ZeroData), NULL, 0, &BytesReturned, NULL)) {
+                    if (!YoriLibCopyRangeFeedPipeline(Pipeline, SourceHandle, CurrentOffset, ZeroData.FileOffset.QuadPart, RangeStart - CurrentOffset)) {
+                        return FALSE;
+                    }
+                }
+                CurrentOffset = RangeStart;
+            }
+
+            if (RangeEnd > CurrentOffset) {
+                if (!YoriLibCopyRangeFeedPipeline(Pipeline, SourceHandle, CurrentOffset, DestOffset + (CurrentOffset - SourceOffset), RangeEnd - CurrentOffset)) {
+                    return FALSE;
+                }
+                CurrentOffset = RangeEnd;
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Copy a range of data from one handle to another.  If both handles refer to
+ files and the length is known, this will:
+
+  - Ask the file system to share clusters between the files, which completes
+    without moving any data on file systems supporting block cloning.
+
+  - Preserve sparse regions of the source, marking the destination sparse
+    and only copying allocated ranges.
+
+  - Extend the destination to its final size before copying.
+
+ Any data that is not handled by these is copied through memory, with
+ reading from the source overlapped with writing to the destination.
+
+ @param SourceHandle Handle to the source.  This can be a file, device or
+        pipe.
+
+ @param SourceOffset The offset in the source to copy from, or
+        YORI_LIB_COPY_RANGE_CURRENT_OFFSET to copy from the current position.
+
+ @param DestHandle Handle to the destination.  This can be a file, device or
+        pipe.
+
+ @param DestOffset The offset in the destination to copy to, or
+        YORI_LIB_COPY_RANGE_CURRENT_OFFSET to copy to the current position.
+
+ @param Length The number of bytes to copy, or YORI_LIB_COPY_RANGE_TO_END to
+        copy until the source indicates no more data is available.
+
+ @return TRUE to indicate success, FALSE to indicate failure.  On failure,
+         the reason is available from GetLastError.
+ */
+BOOL
+YoriLibCopyRange(
+    __in HANDLE SourceHandle,
+    __in LONGLONG SourceOffset,
+    __in HANDLE DestHandle,
+    __in LONGLONG DestOffset,
+    __in LONGLONG Length
+    )
+{
+    YORI_LIB_COPY_PIPELINE Pipeline;
+    BY_HANDLE_FILE_INFORMATION SourceInfo;
+    LARGE_INTEGER DestSize;
+    LONGLONG BytesCloned;
+    BOOL SourceIsFile;
+    BOOL DestIsFile;
+    BOOL SourceIsSparse;
+    BOOL Result;
+    DWORD BytesReturned;
+    DWORD Err;
+
+    SourceIsFile = FALSE;
+    DestIsFile = FALSE;
+    if (GetFileType(SourceHandle) == FILE_TYPE_DISK) {
+        SourceIsFile = TRUE;
+    }
+    if (GetFileType(DestHandle) == FILE_TYPE_DISK) {
+        DestIsFile = TRUE;
+    }
+
+    //
+    //  Convert the current position of any file into an explicit offset,
+    //  since later operations may move the file pointer.
+    //
+
+    if (SourceIsFile && SourceOffset == YORI_LIB_COPY_RANGE_CURRENT_OFFSET) {
+        if (!YoriLibCopyRangeGetPosition(SourceHandle, &SourceOffset)) {
+            return FALSE;
+        }
+    }
+
+    //
+    //  A file opened only for append, such as the target of a shell
+    //  redirection, may not support querying its position.  Write to it
+    //  sequentially instead.
+    //
+
+    if (DestIsFile && DestOffset == YORI_LIB_COPY_RANGE_CURRENT_OFFSET) {
+        if (!YoriLibCopyRangeGetPosition(DestHandle, &DestOffset)) {
+            DestIsFile = FALSE;
+        }
+    }
+
+    if (Length == 0) {
+        return TRUE;
+    }
+
+    SourceIsSparse = FALSE;
+    if (SourceIsFile && DestIsFile && Length != YORI_LIB_COPY_RANGE_TO_END) {
+
+        //
+        //  If the source is sparse, mark the destination sparse before
+        //  extending it, so the extension is not allocated.
+        //
+
+        if (GetFileInformationByHandle(SourceHandle, &SourceInfo) &&
+            (SourceInfo.dwFileAttributes & FILE_ATTRIBUTE_SPARSE_FILE) != 0) {
+
+            SourceIsSparse = TRUE;
+            DeviceIoControl(DestHandle, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &BytesReturned, NULL);
+        }
+
+        //
+        //  If the destination can't be extended, which happens when it was
+        //  opened only for append, write to it sequentially from the
+        //  requested offset instead.  Writes to an append only handle go to
+        //  the end of the file regardless of position.
+        //
+
+        DestSize.LowPart = GetFileSize(DestHandle, (LPDWORD)&DestSize.HighPart);
+        if (DestSize.LowPart == (DWORD)-1 && GetLastError() != NO_ERROR) {
+            DestIsFile = FALSE;
+        } else if (DestSize.QuadPart < DestOffset + Length) {
+            if (!YoriLibCopyRangeSetPosition(DestHandle, DestOffset + Length) ||
+                !SetEndOfFile(DestHandle)) {
+
+                DestIsFile = FALSE;
+            }
+        }
+
+        if (!DestIsFile) {
+            SourceIsSparse = FALSE;
+            YoriLibCopyRangeSetPosition(DestHandle, DestOffset);
+        } else {
+            BytesCloned = YoriLibCopyRangeClone(SourceHandle, SourceOffset, DestHandle, DestOffset, Length);
+            SourceOffset += BytesCloned;
+            DestOffset += BytesCloned;
+            Length -= BytesCloned;
+
+            if (Length == 0) {
+                return TRUE;
+            }
+        }
+    }
+
+    if (!YoriLibCopyRangeInitializePipeline(&Pipeline, DestHandle, DestIsFile, Length)) {
+        return FALSE;
+    }
+
+    if (SourceIsSparse) {
+        Result = YoriLibCopyRangeSparse(&Pipeline, SourceHandle, SourceOffset, DestHandle, DestOffset, Length);
+    } else {
+        Result = YoriLibCopyRangeFeedPipeline(&Pipeline, SourceHandle, SourceOffset, DestOffset, Length);
+    }
+
+    Err = ERROR_SUCCESS;
+    if (!Result) {
+        Err = GetLastError();
+    }
+
+    if (!YoriLibCopyRangeCompletePipeline(&Pipeline)) {
+        if (Result) {
+            Err = GetLastError();
+        }
+        Result = FALSE;
+    }
+
+    if (!Result) {
+        SetLastError(Err);
+    }
+
+    return Result;
+}
+
+// vim:sw=4:ts=4:et:
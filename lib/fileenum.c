@@ -685,113 +685,398 @@ YoriLibForEachFile(
 }
 
 /**
- Compare a file name against a wildcard criteria to see if it matches.
+ Convert a character to uppercase for the purpose of matching file names.
+ This is equivalent to @ref YoriLibUpcaseChar but is expanded inline since
+ it is applied to every character being compared.
+ */
+#define YoriLibFileMatchUpcase(c) ((TCHAR)(((c) >= 'a' && (c) <= 'z')?((c) - 'a' + 'A'):(c)))
 
- @param FileName The file name to compare.
- 
- @param Wildcard The string that may contain wildcards to compare against.
+/**
+ The length of an expression that can be compiled into stack storage when
+ matching an expression which has not been compiled in advance.
+ */
+#define YORI_LIB_FILE_MATCH_STACK_CHARS 64
 
- @return TRUE to indicate a match, FALSE to indicate no match.
+/**
+ The number of segments that an expression of YORI_LIB_FILE_MATCH_STACK_CHARS
+ can contain, since each segment other than an empty expression must be
+ followed by a '*'.
+ */
+#define YORI_LIB_FILE_MATCH_STACK_SEGMENTS (YORI_LIB_FILE_MATCH_STACK_CHARS / 2 + 1)
+
+/**
+ Calculate the storage needed to compile a wildcard expression.
+
+ @param Wildcard The string that may contain wildcards.
+
+ @param SegmentCount On completion, updated to contain the number of
+        segments required.
+
+ @param CharCount On completion, updated to contain the number of characters
+        required.
+ */
+VOID
+YoriLibFileMatchExpressionSize(
+    __in PYORI_STRING Wildcard,
+    __out PDWORD SegmentCount,
+    __out PDWORD CharCount
+    )
+{
+    DWORD Index;
+    BOOL PreviousWasStar;
+
+    *SegmentCount = 0;
+    *CharCount = 0;
+    PreviousWasStar = TRUE;
+
+    for (Index = 0; Index < Wildcard->LengthInChars; Index++) {
+        if (Wildcard->StartOfString[Index] == '*') {
+            PreviousWasStar = TRUE;
+        } else {
+            if (PreviousWasStar) {
+                (*SegmentCount)++;
+            }
+            (*CharCount)++;
+            PreviousWasStar = FALSE;
+        }
+    }
+
+    //
+    //  An empty expression is represented as a single empty segment.  This
+    //  is harmless to reserve for an expression consisting only of '*'.
+    //
+
+    if (*SegmentCount == 0) {
+        *SegmentCount = 1;
+    }
+}
+
+/**
+ Compile a wildcard expression into caller provided storage.
+
+ @param Wildcard The string that may contain wildcards.
+
+ @param Expression On completion, populated with the compiled form of the
+        expression.
+
+ @param Segments Pointer to an array of segments, which must be at least as
+        large as indicated by @ref YoriLibFileMatchExpressionSize .
+
+ @param Chars Pointer to a buffer of characters, which must be at least as
+        large as indicated by @ref YoriLibFileMatchExpressionSize .
+ */
+VOID
+YoriLibCompileFileMatchExpressionToBuffer(
+    __in PYORI_STRING Wildcard,
+    __out PYORI_LIB_FILE_MATCH_EXPRESSION Expression,
+    __out PYORI_LIB_FILE_MATCH_SEGMENT Segments,
+    __out LPTSTR Chars
+    )
+{
+    DWORD Index;
+    DWORD CharIndex;
+    TCHAR Char;
+    PYORI_LIB_FILE_MATCH_SEGMENT CurrentSegment;
+
+    Expression->MemoryToFree = NULL;
+    Expression->Segments = Segments;
+    Expression->SegmentCount = 0;
+    Expression->MinimumLength = 0;
+    Expression->ContainsStar = FALSE;
+    Expression->AnchorStart = TRUE;
+    Expression->AnchorEnd = TRUE;
+
+    CurrentSegment = NULL;
+    CharIndex = 0;
+
+    for (Index = 0; Index < Wildcard->LengthInChars; Index++) {
+        Char = Wildcard->StartOfString[Index];
+        if (Char == '*') {
+            Expression->ContainsStar = TRUE;
+            if (Index == 0) {
+                Expression->AnchorStart = FALSE;
+            }
+            if (Index + 1 == Wildcard->LengthInChars) {
+                Expression->AnchorEnd = FALSE;
+            }
+            CurrentSegment = NULL;
+            continue;
+        }
+
+        if (CurrentSegment == NULL) {
+            CurrentSegment = &Segments[Expression->SegmentCount];
+            Expression->SegmentCount++;
+            CurrentSegment->Text = &Chars[CharIndex];
+            CurrentSegment->Length = 0;
+            CurrentSegment->ContainsAny = FALSE;
+        }
+
+        if (Char == '?') {
+            CurrentSegment->ContainsAny = TRUE;
+        }
+
+        Chars[CharIndex] = YoriLibFileMatchUpcase(Char);
+        CharIndex++;
+        CurrentSegment->Length++;
+        Expression->MinimumLength++;
+    }
+
+    if (Expression->SegmentCount == 0 && !Expression->ContainsStar) {
+        Segments[0].Text = Chars;
+        Segments[0].Length = 0;
+        Segments[0].ContainsAny = FALSE;
+        Expression->SegmentCount = 1;
+    }
+}
+
+/**
+ Compile a wildcard expression so that it can be efficiently compared against
+ many file names.  '*' matches any number of characters, including none, and
+ '?' matches any single character.  Comparisons are case insensitive.
+
+ @param Wildcard The string that may contain wildcards.
+
+ @param Expression On successful completion, populated with the compiled form
+        of the expression.  The caller should free this with
+        @ref YoriLibFreeFileMatchExpression .
+
+ @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
-YoriLibDoesFileMatchExpression (
-    __in PYORI_STRING FileName,
-    __in PYORI_STRING Wildcard
+YoriLibCompileFileMatchExpression(
+    __in PYORI_STRING Wildcard,
+    __out PYORI_LIB_FILE_MATCH_EXPRESSION Expression
     )
 {
-    DWORD FileIndex, WildIndex;
+    DWORD SegmentCount;
+    DWORD CharCount;
+    PYORI_LIB_FILE_MATCH_SEGMENT Segments;
 
-    TCHAR CompareFile;
-    TCHAR CompareWild;
+    YoriLibFileMatchExpressionSize(Wildcard, &SegmentCount, &CharCount);
 
-    FileIndex = 0;
-    WildIndex = 0;
+    Segments = YoriLibReferencedMalloc(SegmentCount * sizeof(YORI_LIB_FILE_MATCH_SEGMENT) + CharCount * sizeof(TCHAR));
+    if (Segments == NULL) {
+        return FALSE;
+    }
 
-    while (FileIndex < FileName->LengthInChars && WildIndex < Wildcard->LengthInChars) {
+    YoriLibCompileFileMatchExpressionToBuffer(Wildcard, Expression, Segments, (LPTSTR)(Segments + SegmentCount));
+    Expression->MemoryToFree = Segments;
+    return TRUE;
+}
 
-        CompareFile = YoriLibUpcaseChar(FileName->StartOfString[FileIndex]);
-        CompareWild = YoriLibUpcaseChar(Wildcard->StartOfString[WildIndex]);
+/**
+ Free a compiled wildcard expression.
 
-        FileIndex++;
-        WildIndex++;
+ @param Expression Pointer to the expression to free.
+ */
+VOID
+YoriLibFreeFileMatchExpression(
+    __inout PYORI_LIB_FILE_MATCH_EXPRESSION Expression
+    )
+{
+    if (Expression->MemoryToFree != NULL) {
+        YoriLibDereference(Expression->MemoryToFree);
+    }
+    ZeroMemory(Expression, sizeof(YORI_LIB_FILE_MATCH_EXPRESSION));
+}
 
-        if (CompareWild == '?') {
+/**
+ Compare characters from a file name against uppercase characters without
+ regard to case.
 
-            //
-            //  '?' matches with everything.  We've already advanced to the next
-            //  char, so continue.
-            //
+ @param FileChars Pointer to the characters from the file name.
 
-        } else if (CompareWild == '*') {
+ @param UpcaseChars Pointer to the uppercase characters to compare against.
 
-            //
-            //  Skip over repeated wildcards.
-            //
+ @param Length The number of characters to compare.
 
-            while (WildIndex < Wildcard->LengthInChars) {
-                CompareWild = YoriLibUpcaseChar(Wildcard->StartOfString[WildIndex]);
-                if (CompareWild != '*' && CompareWild != '?') {
-                    break;
-                }
-                WildIndex++;
-            }
+ @return TRUE if the characters are equal, FALSE if they are not.
+ */
+BOOL
+YoriLibFileMatchCompareUpcase(
+    __in LPTSTR FileChars,
+    __in LPTSTR UpcaseChars,
+    __in DWORD Length
+    )
+{
+    DWORD Index;
 
-            //
-            //  If we're at the end of the string, consisting entirely of
-            //  wildcards, then any file name ending would match.
-            //
+    for (Index = 0; Index < Length; Index++) {
+        if (YoriLibFileMatchUpcase(FileChars[Index]) != UpcaseChars[Index]) {
+            return FALSE;
+        }
+    }
 
-            if (WildIndex == Wildcard->LengthInChars) {
-                return TRUE;
-            }
+    return TRUE;
+}
 
-            //
-            //  If there's a literal after the wildcard, look forward in the
-            //  file name to see if it's there.
-            //
+/**
+ Check whether a segment of a compiled expression matches the characters at
+ a specified location in a file name.
 
-            while (FileIndex < FileName->LengthInChars) {
-                CompareFile = YoriLibUpcaseChar(FileName->StartOfString[FileIndex]);
-                if (CompareFile == CompareWild) {
-                    break;
-                }
-                FileIndex++;
-            }
+ @param FileChars Pointer to the characters in the file name to compare.
+        There must be at least as many characters as the segment.
 
-            //
-            //  There is a literal after the wild but it wasn't found in the
-            //  file name.  This is not a match.
-            //
+ @param Segment Pointer to the segment to compare.
 
-            if (FileIndex == FileName->LengthInChars) {
-                return FALSE;
-            }
+ @return TRUE if the segment matches, FALSE if it does not.
+ */
+BOOL
+YoriLibFileMatchSegmentAt(
+    __in LPTSTR FileChars,
+    __in PYORI_LIB_FILE_MATCH_SEGMENT Segment
+    )
+{
+    DWORD Index;
+    TCHAR Char;
 
-        } else {
-            if (CompareFile != CompareWild) {
-                return FALSE;
-            }
+    if (!Segment->ContainsAny) {
+        return YoriLibFileMatchCompareUpcase(FileChars, Segment->Text, Segment->Length);
+    }
+
+    for (Index = 0; Index < Segment->Length; Index++) {
+        Char = Segment->Text[Index];
+        if (Char != '?' && YoriLibFileMatchUpcase(FileChars[Index]) != Char) {
+            return FALSE;
         }
     }
 
+    return TRUE;
+}
+
+/**
+ Compare a file name against a compiled wildcard expression to see if it
+ matches.  Segments between '*' characters are matched at their earliest
+ position, so the comparison never needs to revisit earlier characters.
+
+ @param FileName The file name to compare.
+
+ @param Expression The compiled expression to compare against.
+
+ @return TRUE to indicate a match, FALSE to indicate no match.
+ */
+BOOL
+YoriLibDoesFileMatchCompiledExpression(
+    __in PYORI_STRING FileName,
+    __in PYORI_LIB_FILE_MATCH_EXPRESSION Expression
+    )
+{
+    PYORI_LIB_FILE_MATCH_SEGMENT Segment;
+    DWORD FirstSegment;
+    DWORD LastSegment;
+    DWORD Start;
+    DWORD End;
+    DWORD Index;
+    TCHAR FirstChar;
+
     //
-    //  Skip over repeated wildcards.
+    //  If there is no '*', the file name must be the same length as the
+    //  expression.
     //
 
-    while (WildIndex < Wildcard->LengthInChars) {
-        ASSERT(FileIndex == FileName->LengthInChars);
-        CompareWild = YoriLibUpcaseChar(Wildcard->StartOfString[WildIndex]);
-        if (CompareWild != '*' && CompareWild != '?') {
-            break;
+    if (!Expression->ContainsStar) {
+        Segment = &Expression->Segments[0];
+        if (FileName->LengthInChars != Segment->Length) {
+            return FALSE;
         }
-        WildIndex++;
+        return YoriLibFileMatchSegmentAt(FileName->StartOfString, Segment);
     }
 
-    if (FileIndex == FileName->LengthInChars && WildIndex == Wildcard->LengthInChars) {
-        return TRUE;
+    if (FileName->LengthInChars < Expression->MinimumLength) {
+        return FALSE;
     }
 
-    return FALSE;
+    //
+    //  Check anything before the first '*' as a prefix, and anything after
+    //  the last '*' as a suffix.  Since the name is at least as long as all
+    //  of the segments, these cannot overlap.
+    //
+
+    Start = 0;
+    End = FileName->LengthInChars;
+    FirstSegment = 0;
+    LastSegment = Expression->SegmentCount;
+
+    if (Expression->AnchorStart) {
+        Segment = &Expression->Segments[0];
+        if (!YoriLibFileMatchSegmentAt(FileName->StartOfString, Segment)) {
+            return FALSE;
+        }
+        Start = Segment->Length;
+        FirstSegment = 1;
+    }
+
+    if (Expression->AnchorEnd && LastSegment > FirstSegment) {
+        LastSegment--;
+        Segment = &Expression->Segments[LastSegment];
+        End = FileName->LengthInChars - Segment->Length;
+        if (!YoriLibFileMatchSegmentAt(&FileName->StartOfString[End], Segment)) {
+            return FALSE;
+        }
+    }
+
+    //
+    //  Find each remaining segment at the earliest position following the
+    //  previous one.
+    //
+
+    for (; FirstSegment < LastSegment; FirstSegment++) {
+        Segment = &Expression->Segments[FirstSegment];
+        FirstChar = Segment->Text[0];
+
+        for (Index = Start; Index + Segment->Length <= End; Index++) {
+            if (FirstChar != '?' &&
+                YoriLibFileMatchUpcase(FileName->StartOfString[Index]) != FirstChar) {
+
+                continue;
+            }
+            if (YoriLibFileMatchSegmentAt(&FileName->StartOfString[Index], Segment)) {
+                break;
+            }
+        }
+
+        if (Index + Segment->Length > End) {
+            return FALSE;
+        }
+
+        Start = Index + Segment->Length;
+    }
+
+    return TRUE;
+}
+
+/**
+ Compare a file name against a wildcard criteria to see if it matches.
+ Callers comparing many file names against the same criteria should use
+ @ref YoriLibCompileFileMatchExpression and
+ @ref YoriLibDoesFileMatchCompiledExpression instead.
+
+ @param FileName The file name to compare.
+ 
+ @param Wildcard The string that may contain wildcards to compare against.
+
+ @return TRUE to indicate a match, FALSE to indicate no match.
+ */
+BOOL
+YoriLibDoesFileMatchExpression (
+    __in PYORI_STRING FileName,
+    __in PYORI_STRING Wildcard
+    )
+{
+    YORI_LIB_FILE_MATCH_EXPRESSION Expression;
+    YORI_LIB_FILE_MATCH_SEGMENT Segments[YORI_LIB_FILE_MATCH_STACK_SEGMENTS];
+    TCHAR Chars[YORI_LIB_FILE_MATCH_STACK_CHARS];
+    BOOL Result;
+
+    if (Wildcard->LengthInChars <= YORI_LIB_FILE_MATCH_STACK_CHARS) {
+        YoriLibCompileFileMatchExpressionToBuffer(Wildcard, &Expression, Segments, Chars);
+    } else if (!YoriLibCompileFileMatchExpression(Wildcard, &Expression)) {
+        return FALSE;
+    }
+
+    Result = YoriLibDoesFileMatchCompiledExpression(FileName, &Expression);
+    YoriLibFreeFileMatchExpression(&Expression);
+    return Result;
 }
 
 /**
@@ -48,6 +48,24 @@ CHAR strFileFiltHelpText[] =
         "\n"
         " Valid attributes are:\n";
 
+/**
+ The collector for an option only uses information returned from directory
+ enumeration.
+ */
+#define YORI_LIB_FILE_FILT_COST_FIND_DATA 0
+
+/**
+ The collector for an option opens the file or queries the file system for
+ metadata about it.
+ */
+#define YORI_LIB_FILE_FILT_COST_METADATA  1
+
+/**
+ The collector for an option reads file contents, enumerates the file's
+ extents, or evaluates its security descriptor.
+ */
+#define YORI_LIB_FILE_FILT_COST_CONTENTS  2
+
 /**
  A single option that files can be filtered against.
  */
@@ -86,6 +104,12 @@ typedef struct _YORI_LIB_FILE_FILT_FILTER_OPT {
      A string containing a description for the option.
      */
     CHAR Help[24];
+
+    /**
+     An indication of how expensive it is to collect the data for the option,
+     being one of the YORI_LIB_FILE_FILT_COST values.
+     */
+    DWORD CollectCost;
 } YORI_LIB_FILE_FILT_FILTER_OPT, *PYORI_LIB_FILE_FILT_FILTER_OPT;
 
 /**
@@ -102,123 +126,153 @@ CONST YORI_LIB_FILE_FILT_FILTER_OPT
 YoriLibFileFiltFilterOptions[] = {
     {_T("ac"),                               YoriLibCollectAllocatedRangeCount,
      YoriLibCompareAllocatedRangeCount,      NULL,
-     YoriLibGenerateAllocatedRangeCount,     "allocated range count"},
+     YoriLibGenerateAllocatedRangeCount,     "allocated range count",
+     YORI_LIB_FILE_FILT_COST_CONTENTS},
 
     {_T("ad"),                               YoriLibCollectAccessTime,
      YoriLibCompareAccessDate,               NULL,
-     YoriLibGenerateAccessDate,              "access date"},
+     YoriLibGenerateAccessDate,              "access date",
+     YORI_LIB_FILE_FILT_COST_FIND_DATA},
 
     {_T("ar"),                               YoriLibCollectArch,
      YoriLibCompareArch,                     NULL,
-     YoriLibGenerateArch,                    "CPU architecture"},
+     YoriLibGenerateArch,                    "CPU architecture",
+     YORI_LIB_FILE_FILT_COST_CONTENTS},
 
     {_T("as"),                               YoriLibCollectAllocationSize,
      YoriLibCompareAllocationSize,           NULL,
-     YoriLibGenerateAllocationSize,          "allocation size"},
+     YoriLibGenerateAllocationSize,          "allocation size",
+     YORI_LIB_FILE_FILT_COST_METADATA},
 
     {_T("at"),                               YoriLibCollectAccessTime,
      YoriLibCompareAccessTime,               NULL,
-     YoriLibGenerateAccessTime,              "access time"},
+     YoriLibGenerateAccessTime,              "access time",
+     YORI_LIB_FILE_FILT_COST_FIND_DATA},
 
     {_T("ca"),                               YoriLibCollectCompressionAlgorithm,
      YoriLibCompareCompressionAlgorithm,     NULL,
-     YoriLibGenerateCompressionAlgorithm,    "compression algorithm"},
+     YoriLibGenerateCompressionAlgorithm,    "compression algorithm",
+     YORI_LIB_FILE_FILT_COST_METADATA},
 
     {_T("cd"),                               YoriLibCollectCreateTime,
      YoriLibCompareCreateDate,               NULL,
-     YoriLibGenerateCreateDate,              "create date"},
+     YoriLibGenerateCreateDate,              "create date",
+     YORI_LIB_FILE_FILT_COST_FIND_DATA},
 
     {_T("cs"),                               YoriLibCollectCompressedFileSize,
      YoriLibCompareCompressedFileSize,       NULL,
-     YoriLibGenerateCompressedFileSize,      "compressed size"},
+     YoriLibGenerateCompressedFileSize,      "compressed size",
+     YORI_LIB_FILE_FILT_COST_METADATA},
 
     {_T("ct"),                               YoriLibCollectCreateTime,
      YoriLibCompareCreateTime,               NULL,
-     YoriLibGenerateCreateTime,              "create time"},
+     YoriLibGenerateCreateTime,              "create time",
+     YORI_LIB_FILE_FILT_COST_FIND_DATA},
 
     {_T("de"),                               YoriLibCollectDescription,
      YoriLibCompareDescription,              NULL,
-     YoriLibGenerateDescription,             "description"},
+     YoriLibGenerateDescription,             "description",
+     YORI_LIB_FILE_FILT_COST_CONTENTS},
 
     {_T("ep"),                               YoriLibCollectEffectivePermissions,
      YoriLibCompareEffectivePermissions,     YoriLibBitwiseEffectivePermissions,
-     YoriLibGenerateEffectivePermissions,    "effective permissions"},
+     YoriLibGenerateEffectivePermissions,    "effective permissions",
+     YORI_LIB_FILE_FILT_COST_CONTENTS},
 
     {_T("fa"),                               YoriLibCollectFileAttributes,
      YoriLibCompareFileAttributes,           YoriLibBitwiseFileAttributes,
-     YoriLibGenerateFileAttributes,          "file attributes"},
+     YoriLibGenerateFileAttributes,          "file attributes",
+     YORI_LIB_FILE_FILT_COST_FIND_DATA},
 
     {_T("fc"),                               YoriLibCollectFragmentCount,
      YoriLibCompareFragmentCount,            NULL,
-     YoriLibGenerateFragmentCount,           "fragment count"},
+     YoriLibGenerateFragmentCount,           "fragment count",
+     YORI_LIB_FILE_FILT_COST_CONTENTS},
 
     {_T("fe"),                               YoriLibCollectFileName,
      YoriLibCompareFileExtension,            NULL,
-     YoriLibGenerateFileExtension,           "file extension"},
+     YoriLibGenerateFileExtension,           "file extension",
+     YORI_LIB_FILE_FILT_COST_FIND_DATA},
 
     {_T("fi"),                               YoriLibCollectFileId,
      YoriLibCompareFileId,                   NULL,
-     YoriLibGenerateFileId,                  "file id"},
+     YoriLibGenerateFileId,                  "file id",
+     YORI_LIB_FILE_FILT_COST_METADATA},
 
     {_T("fn"),                               YoriLibCollectFileName,
      YoriLibCompareFileName,                 YoriLibBitwiseFileName,
-     YoriLibGenerateFileName,                "file name"},
+     YoriLibGenerateFileName,                "file name",
+     YORI_LIB_FILE_FILT_COST_FIND_DATA},
 
     {_T("fs"),                               YoriLibCollectFileSize,
      YoriLibCompareFileSize,                 NULL,
-     YoriLibGenerateFileSize,                "file size"},
+     YoriLibGenerateFileSize,                "file size",
+     YORI_LIB_FILE_FILT_COST_FIND_DATA},
 
     {_T("fv"),                               YoriLibCollectFileVersionString,
      YoriLibCompareFileVersionString,        NULL,
-     YoriLibGenerateFileVersionString,       "file version string"},
+     YoriLibGenerateFileVersionString,       "file version string",
+     YORI_LIB_FILE_FILT_COST_CONTENTS},
 
     {_T("lc"),                               YoriLibCollectLinkCount,
      YoriLibCompareLinkCount,                NULL,
-     YoriLibGenerateLinkCount,               "link count"},
+     YoriLibGenerateLinkCount,               "link count",
+     YORI_LIB_FILE_FILT_COST_METADATA},
 
     {_T("oi"),                               YoriLibCollectObjectId,
      YoriLibCompareObjectId,                 NULL,
-     YoriLibGenerateObjectId,                "object id"},
+     YoriLibGenerateObjectId,                "object id",
+     YORI_LIB_FILE_FILT_COST_METADATA},
 
     {_T("os"),                               YoriLibCollectOsVersion,
      YoriLibCompareOsVersion,                NULL,
-     YoriLibGenerateOsVersion,               "minimum OS version"},
+     YoriLibGenerateOsVersion,               "minimum OS version",
+     YORI_LIB_FILE_FILT_COST_CONTENTS},
 
     {_T("ow"),                               YoriLibCollectOwner,
      YoriLibCompareOwner,                    NULL,
-     YoriLibGenerateOwner,                   "owner"},
+     YoriLibGenerateOwner,                   "owner",
+     YORI_LIB_FILE_FILT_COST_CONTENTS},
 
     {_T("rt"),                               YoriLibCollectReparseTag,
      YoriLibCompareReparseTag,               NULL,
-     YoriLibGenerateReparseTag,              "reparse tag"},
+     YoriLibGenerateReparseTag,              "reparse tag",
+     YORI_LIB_FILE_FILT_COST_FIND_DATA},
 
     {_T("sc"),                               YoriLibCollectStreamCount,
      YoriLibCompareStreamCount,              NULL,
-     YoriLibGenerateStreamCount,             "stream count"},
+     YoriLibGenerateStreamCount,             "stream count",
+     YORI_LIB_FILE_FILT_COST_METADATA},
 
     {_T("sn"),                               YoriLibCollectShortName,
      YoriLibCompareShortName,                NULL,
-     YoriLibGenerateShortName,               "short name"},
+     YoriLibGenerateShortName,               "short name",
+     YORI_LIB_FILE_FILT_COST_FIND_DATA},
 
     {_T("ss"),                               YoriLibCollectSubsystem,
      YoriLibCompareSubsystem,                NULL,
-     YoriLibGenerateSubsystem,               "subsystem"},
+     YoriLibGenerateSubsystem,               "subsystem",
+     YORI_LIB_FILE_FILT_COST_CONTENTS},
 
     {_T("us"),                               YoriLibCollectUsn,
      YoriLibCompareUsn,                      NULL,
-     YoriLibGenerateUsn,                     "USN"},
+     YoriLibGenerateUsn,                     "USN",
+     YORI_LIB_FILE_FILT_COST_METADATA},
 
     {_T("vr"),                               YoriLibCollectVersion,
      YoriLibCompareVersion,                  NULL,
-     YoriLibGenerateVersion,                 "version"},
+     YoriLibGenerateVersion,                 "version",
+     YORI_LIB_FILE_FILT_COST_CONTENTS},
 
     {_T("wd"),                               YoriLibCollectWriteTime,
      YoriLibCompareWriteDate,                NULL,
-     YoriLibGenerateWriteDate,               "write date"},
+     YoriLibGenerateWriteDate,               "write date",
+     YORI_LIB_FILE_FILT_COST_FIND_DATA},
 
     {_T("wt"),                               YoriLibCollectWriteTime,
      YoriLibCompareWriteTime,                NULL,
-     YoriLibGenerateWriteTime,               "write time"},
+     YoriLibGenerateWriteTime,               "write time",
+     YORI_LIB_FILE_FILT_COST_FIND_DATA},
 };
 
 /**
@@ -591,7 +645,6 @@ YoriLibFileFiltParseFilterStringInternal(
     PYORI_LIB_FILE_FILT_MATCH_CRITERIA ThisElement;
     LPTSTR NextStart;
     DWORD ElementCount;
-    DWORD Index;
     DWORD Phase;
 
     ASSERT(AllocationSize >= sizeof(YORI_LIB_FILE_FILT_MATCH_CRITERIA));
@@ -622,26 +675,6 @@ YoriLibFileFiltParseFilterStringInternal(
                         YoriLibFree(Criteria);
                         return FALSE;
                     }
-
-                    //
-                    //  At the expense of being N^2, check if a previous
-                    //  item is already collecting the same data.  If it
-                    //  is, don't collect anything by this item.  The
-                    //  hope is this filter chain is executed across
-                    //  multiple files so the cost of this check will be
-                    //  outweighed by the operations it eliminates.
-                    //
-
-                    if (ThisElement->CollectFn != NULL) {
-                        PYORI_LIB_FILE_FILT_MATCH_CRITERIA PreviousElement;
-                        for (Index = 0; Index < ElementCount; Index++) {
-                            PreviousElement = (PYORI_LIB_FILE_FILT_MATCH_CRITERIA)YoriLibAddToPointer(Criteria, Index * AllocationSize);
-                            if (ThisElement->CollectFn == PreviousElement->CollectFn) {
-                                ThisElement->CollectFn = NULL;
-                                break;
-                            }
-                        }
-                    }
                 }
                 ElementCount++;
             }
@@ -677,6 +710,160 @@ YoriLibFileFiltParseFilterStringInternal(
     Filter->Criteria = Criteria;
     Filter->ElementSize = AllocationSize;
     Filter->NumberCriteria = ElementCount;
+    Filter->Compiled = NULL;
+    return TRUE;
+}
+
+/**
+ Check if a previous criteria is already collecting the same data as each
+ criteria, and if so, don't collect anything for the later one.  This is
+ N^2, but the hope is the filter chain is executed across multiple files so
+ the cost of this check will be outweighed by the operations it eliminates.
+ Note this depends on criteria being evaluated in order, so must be
+ performed after any reordering.
+
+ @param Filter Pointer to the filter whose criteria should be updated.
+ */
+VOID
+YoriLibFileFiltRemoveDuplicateCollection(
+    __inout PYORI_LIB_FILE_FILTER Filter
+    )
+{
+    PYORI_LIB_FILE_FILT_MATCH_CRITERIA ThisElement;
+    PYORI_LIB_FILE_FILT_MATCH_CRITERIA PreviousElement;
+    DWORD Index;
+    DWORD PreviousIndex;
+
+    for (Index = 0; Index < Filter->NumberCriteria; Index++) {
+        ThisElement = (PYORI_LIB_FILE_FILT_MATCH_CRITERIA)YoriLibAddToPointer(Filter->Criteria, Index * Filter->ElementSize);
+        if (ThisElement->CollectFn == NULL) {
+            continue;
+        }
+        for (PreviousIndex = 0; PreviousIndex < Index; PreviousIndex++) {
+            PreviousElement = (PYORI_LIB_FILE_FILT_MATCH_CRITERIA)YoriLibAddToPointer(Filter->Criteria, PreviousIndex * Filter->ElementSize);
+            if (ThisElement->CollectFn == PreviousElement->CollectFn) {
+                ThisElement->CollectFn = NULL;
+                break;
+            }
+        }
+    }
+}
+
+/**
+ Return the cost of collecting the data needed to evaluate a criteria.
+
+ @param Criteria Pointer to the criteria.
+
+ @return One of the YORI_LIB_FILE_FILT_COST values.
+ */
+DWORD
+YoriLibFileFiltGetCriteriaCost(
+    __in PYORI_LIB_FILE_FILT_MATCH_CRITERIA Criteria
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < sizeof(YoriLibFileFiltFilterOptions)/sizeof(YoriLibFileFiltFilterOptions[0]); Index++) {
+        if (Criteria->CompareFn == YoriLibFileFiltFilterOptions[Index].CompareFn ||
+            Criteria->CompareFn == YoriLibFileFiltFilterOptions[Index].BitwiseCompareFn) {
+
+            return YoriLibFileFiltFilterOptions[Index].CollectCost;
+        }
+    }
+
+    ASSERT(FALSE);
+    return YORI_LIB_FILE_FILT_COST_CONTENTS;
+}
+
+/**
+ Reorder the criteria in a filter so that criteria which are cheap to
+ collect are evaluated before those that are expensive.  Since a file must
+ satisfy every criteria in a filter, the result is unchanged, but a file
+ that fails a cheap check will not need to be opened or have its contents
+ read.  Criteria with the same cost retain the order the user specified.
+
+ @param Filter Pointer to the filter whose criteria should be reordered.
+        This must contain criteria whose collection functions have not yet
+        had duplicates removed.
+
+ @return TRUE to indicate the criteria were reordered, FALSE on failure.
+         On failure the criteria are left in their original order.
+ */
+BOOL
+YoriLibFileFiltOrderCriteriaByCost(
+    __inout PYORI_LIB_FILE_FILTER Filter
+    )
+{
+    PYORI_LIB_FILE_FILT_MATCH_CRITERIA SourceElement;
+    PYORI_LIB_FILE_FILT_MATCH_CRITERIA TargetElement;
+    PVOID SavedCriteria;
+    PDWORD Order;
+    PDWORD Costs;
+    DWORD Index;
+    DWORD InsertIndex;
+    DWORD Cost;
+    DWORD SourceIndex;
+
+    if (Filter->NumberCriteria < 2) {
+        return TRUE;
+    }
+
+    SavedCriteria = YoriLibMalloc(Filter->NumberCriteria * (Filter->ElementSize + 2 * sizeof(DWORD)));
+    if (SavedCriteria == NULL) {
+        return FALSE;
+    }
+
+    Order = YoriLibAddToPointer(SavedCriteria, Filter->NumberCriteria * Filter->ElementSize);
+    Costs = Order + Filter->NumberCriteria;
+
+    //
+    //  The number of criteria is small, so perform a stable insertion sort
+    //  on the index of each criteria.
+    //
+
+    for (Index = 0; Index < Filter->NumberCriteria; Index++) {
+        SourceElement = (PYORI_LIB_FILE_FILT_MATCH_CRITERIA)YoriLibAddToPointer(Filter->Criteria, Index * Filter->ElementSize);
+        Costs[Index] = YoriLibFileFiltGetCriteriaCost(SourceElement);
+    }
+
+    for (Index = 0; Index < Filter->NumberCriteria; Index++) {
+        Cost = Costs[Index];
+        for (InsertIndex = Index; InsertIndex > 0; InsertIndex--) {
+            if (Costs[Order[InsertIndex - 1]] <= Cost) {
+                break;
+            }
+            Order[InsertIndex] = Order[InsertIndex - 1];
+        }
+        Order[InsertIndex] = Index;
+    }
+
+    //
+    //  Copy each criteria into its new position.  A file extension criteria
+    //  refers to a string within its own compare entry, so that needs to
+    //  refer to the copy.
+    //
+
+    memcpy(SavedCriteria, Filter->Criteria, Filter->NumberCriteria * Filter->ElementSize);
+
+    for (Index = 0; Index < Filter->NumberCriteria; Index++) {
+        SourceIndex = Order[Index];
+        if (SourceIndex == Index) {
+            continue;
+        }
+
+        SourceElement = (PYORI_LIB_FILE_FILT_MATCH_CRITERIA)YoriLibAddToPointer(SavedCriteria, SourceIndex * Filter->ElementSize);
+        TargetElement = (PYORI_LIB_FILE_FILT_MATCH_CRITERIA)YoriLibAddToPointer(Filter->Criteria, Index * Filter->ElementSize);
+        memcpy(TargetElement, SourceElement, Filter->ElementSize);
+
+        SourceElement = (PYORI_LIB_FILE_FILT_MATCH_CRITERIA)YoriLibAddToPointer(Filter->Criteria, SourceIndex * Filter->ElementSize);
+        if (TargetElement->CompareEntry.Extension >= SourceElement->CompareEntry.FileName &&
+            TargetElement->CompareEntry.Extension <= &SourceElement->CompareEntry.FileName[sizeof(SourceElement->CompareEntry.FileName)/sizeof(SourceElement->CompareEntry.FileName[0])]) {
+
+            TargetElement->CompareEntry.Extension = TargetElement->CompareEntry.FileName + (TargetElement->CompareEntry.Extension - SourceElement->CompareEntry.FileName);
+        }
+    }
+
+    YoriLibFree(SavedCriteria);
     return TRUE;
 }
 
@@ -702,7 +889,366 @@ YoriLibFileFiltParseFilterString(
     __out PYORI_STRING ErrorSubstring
     )
 {
-    return YoriLibFileFiltParseFilterStringInternal(Filter, FilterString, YoriLibFileFiltParseFilterElement, sizeof(YORI_LIB_FILE_FILT_MATCH_CRITERIA), ErrorSubstring);
+    if (!YoriLibFileFiltParseFilterStringInternal(Filter, FilterString, YoriLibFileFiltParseFilterElement, sizeof(YORI_LIB_FILE_FILT_MATCH_CRITERIA), ErrorSubstring)) {
+        return FALSE;
+    }
+
+    //
+    //  A file must meet all criteria in a filter, so the order is
+    //  irrelevant to the result.  Evaluate cheap criteria first so
+    //  expensive data is only collected for files that pass them.
+    //
+
+    YoriLibFileFiltOrderCriteriaByCost(Filter);
+    YoriLibFileFiltRemoveDuplicateCollection(Filter);
+    return TRUE;
+}
+
+/**
+ A set of consecutive color criteria which all compare the same field for
+ exact equality and can therefore be resolved with a single hash lookup.
+ */
+typedef struct _YORI_LIB_FILE_FILT_HASH_GROUP {
+
+    /**
+     The index of the first criteria within the group.
+     */
+    DWORD FirstIndex;
+
+    /**
+     The index of the first criteria following the group.
+     */
+    DWORD EndIndex;
+
+    /**
+     The function to collect the field being compared, or NULL if an earlier
+     criteria has already collected it.
+     */
+    YORI_LIB_FILE_FILT_COLLECT_FN CollectFn;
+
+    /**
+     The function used by every criteria in the group to compare the field.
+     */
+    YORI_LIB_FILE_FILT_COMPARE_FN CompareFn;
+
+    /**
+     A hash table of the values being compared against.  Each entry refers
+     to the first criteria in the group to compare against that value.
+     */
+    PYORI_HASH_TABLE HashTable;
+} YORI_LIB_FILE_FILT_HASH_GROUP, *PYORI_LIB_FILE_FILT_HASH_GROUP;
+
+/**
+ Compiled information about a single color criteria.
+ */
+typedef struct _YORI_LIB_FILE_FILT_COMPILED_CRITERIA {
+
+    /**
+     Pointer to the group containing this criteria, or NULL if this criteria
+     must be evaluated individually.
+     */
+    PYORI_LIB_FILE_FILT_HASH_GROUP Group;
+
+    /**
+     The index of the next criteria in the group comparing against the same
+     value, or (DWORD)-1 if no later criteria compares against it.
+     */
+    DWORD NextWithSameKey;
+
+    /**
+     TRUE if HashEntry has been inserted into the group's hash table.  This
+     is only true for the first criteria comparing against each value.
+     */
+    BOOL HashEntryInserted;
+
+    /**
+     The hash table entry for the value this criteria compares against.
+     */
+    YORI_HASH_ENTRY HashEntry;
+} YORI_LIB_FILE_FILT_COMPILED_CRITERIA, *PYORI_LIB_FILE_FILT_COMPILED_CRITERIA;
+
+/**
+ The compiled form of a set of color criteria.
+ */
+typedef struct _YORI_LIB_FILE_FILT_COMPILED {
+
+    /**
+     The number of groups in the Groups array.
+     */
+    DWORD GroupCount;
+
+    /**
+     An array of groups of criteria which can be resolved by hash lookup.
+     */
+    PYORI_LIB_FILE_FILT_HASH_GROUP Groups;
+
+    /**
+     An array of compiled information, one per color criteria.
+     */
+    PYORI_LIB_FILE_FILT_COMPILED_CRITERIA Criteria;
+} YORI_LIB_FILE_FILT_COMPILED, *PYORI_LIB_FILE_FILT_COMPILED;
+
+/**
+ Return the string within a file information structure that a hashable
+ compare function operates on.
+
+ @param CompareFn The compare function.
+
+ @param Entry Pointer to the file information.
+
+ @param Key On successful completion, updated to point to the string that
+        the compare function would compare.  This is not reallocated and
+        refers to memory within Entry.
+
+ @return TRUE if the string was found and contains only ASCII characters,
+         FALSE if the string cannot be used as a hash key.  Case insensitive
+         comparison of characters outside of ASCII can depend on the
+         locale, so these are not hashed to guarantee results identical to
+         the compare function.
+ */
+BOOL
+YoriLibFileFiltGetHashKey(
+    __in YORI_LIB_FILE_FILT_COMPARE_FN CompareFn,
+    __in PYORI_FILE_INFO Entry,
+    __out PYORI_STRING Key
+    )
+{
+    LPTSTR String;
+    DWORD Index;
+
+    if (CompareFn == YoriLibCompareFileExtension) {
+        String = Entry->Extension;
+    } else {
+        ASSERT(CompareFn == YoriLibCompareFileName);
+        String = Entry->FileName;
+    }
+
+    YoriLibInitEmptyString(Key);
+    if (String == NULL) {
+        return FALSE;
+    }
+
+    for (Index = 0; String[Index] != '\0'; Index++) {
+        if (String[Index] >= 0x80) {
+            return FALSE;
+        }
+    }
+
+    Key->StartOfString = String;
+    Key->LengthInChars = Index;
+    return TRUE;
+}
+
+/**
+ Determine whether a color criteria can be resolved via a hash lookup.  This
+ requires that the criteria compare a file name or extension for equality.
+
+ @param Criteria Pointer to the criteria to check.
+
+ @return TRUE if the criteria can be placed in a hash group, FALSE if it
+         must be evaluated individually.
+ */
+BOOL
+YoriLibFileFiltIsCriteriaHashable(
+    __in PYORI_LIB_FILE_FILT_COLOR_CRITERIA Criteria
+    )
+{
+    YORI_STRING Key;
+
+    if (Criteria->Match.CompareFn != YoriLibCompareFileExtension &&
+        Criteria->Match.CompareFn != YoriLibCompareFileName) {
+
+        return FALSE;
+    }
+
+    if (Criteria->Match.CollectFn != NULL &&
+        Criteria->Match.CollectFn != YoriLibCollectFileName) {
+
+        return FALSE;
+    }
+
+    if (Criteria->Match.TruthStates[YORI_LIB_LESS_THAN] ||
+        Criteria->Match.TruthStates[YORI_LIB_GREATER_THAN] ||
+        !Criteria->Match.TruthStates[YORI_LIB_EQUAL]) {
+
+        return FALSE;
+    }
+
+    return YoriLibFileFiltGetHashKey(Criteria->Match.CompareFn, &Criteria->Match.CompareEntry, &Key);
+}
+
+/**
+ Free the compiled form of a set of color criteria.
+
+ @param Compiled Pointer to the compiled criteria.
+
+ @param NumberCriteria The number of criteria in the filter.
+ */
+VOID
+YoriLibFileFiltFreeCompiled(
+    __in PYORI_LIB_FILE_FILT_COMPILED Compiled,
+    __in DWORD NumberCriteria
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < NumberCriteria; Index++) {
+        if (Compiled->Criteria[Index].HashEntryInserted) {
+            YoriLibHashRemoveByEntry(&Compiled->Criteria[Index].HashEntry);
+            Compiled->Criteria[Index].HashEntryInserted = FALSE;
+        }
+    }
+
+    for (Index = 0; Index < Compiled->GroupCount; Index++) {
+        if (Compiled->Groups[Index].HashTable != NULL) {
+            YoriLibFreeEmptyHashTable(Compiled->Groups[Index].HashTable);
+        }
+    }
+
+    YoriLibFree(Compiled);
+}
+
+/**
+ Compile a set of parsed color criteria so that runs of consecutive exact
+ file name or extension matches can be resolved with a single hash lookup
+ rather than comparing against each criteria in turn.  The default color
+ string consists largely of these, so a file would otherwise be compared
+ against every extension before falling through to later rules.
+
+ Criteria within a group retain their order via a chain of criteria that
+ compare against the same value, so CONTINUE rules combine in the same
+ order as if each criteria were evaluated individually.
+
+ @param Filter Pointer to the filter containing parsed color criteria.  On
+        successful completion, the Compiled member is populated.  On
+        failure, the Compiled member remains NULL and the criteria are
+        evaluated individually.
+
+ @return TRUE to indicate the criteria were compiled, FALSE on failure.
+ */
+BOOL
+YoriLibFileFiltCompileColorCriteria(
+    __inout PYORI_LIB_FILE_FILTER Filter
+    )
+{
+    PYORI_LIB_FILE_FILT_COMPILED Compiled;
+    PYORI_LIB_FILE_FILT_COLOR_CRITERIA ColorCriteria;
+    PYORI_LIB_FILE_FILT_COMPILED_CRITERIA ThisCompiled;
+    PYORI_LIB_FILE_FILT_COMPILED_CRITERIA KeyCompiled;
+    PYORI_LIB_FILE_FILT_HASH_GROUP Group;
+    PYORI_HASH_ENTRY HashEntry;
+    YORI_STRING Key;
+    DWORD Index;
+    DWORD EndIndex;
+    DWORD GroupCount;
+    DWORD AllocSize;
+
+    ASSERT(Filter->Compiled == NULL);
+    ASSERT(Filter->NumberCriteria == 0 ||
+           Filter->ElementSize == sizeof(YORI_LIB_FILE_FILT_COLOR_CRITERIA));
+
+    ColorCriteria = (PYORI_LIB_FILE_FILT_COLOR_CRITERIA)Filter->Criteria;
+
+    //
+    //  Count the number of runs of two or more hashable criteria comparing
+    //  the same field.  If there aren't any, there's nothing to gain by
+    //  compiling.
+    //
+
+    GroupCount = 0;
+    for (Index = 0; Index < Filter->NumberCriteria; Index = EndIndex) {
+        EndIndex = Index + 1;
+        if (!YoriLibFileFiltIsCriteriaHashable(&ColorCriteria[Index])) {
+            continue;
+        }
+        while (EndIndex < Filter->NumberCriteria &&
+               ColorCriteria[EndIndex].Match.CompareFn == ColorCriteria[Index].Match.CompareFn &&
+               YoriLibFileFiltIsCriteriaHashable(&ColorCriteria[EndIndex])) {
+            EndIndex++;
+        }
+        if (EndIndex - Index > 1) {
+            GroupCount++;
+        }
+    }
+
+    if (GroupCount == 0) {
+        return FALSE;
+    }
+
+    AllocSize = sizeof(YORI_LIB_FILE_FILT_COMPILED) +
+                GroupCount * sizeof(YORI_LIB_FILE_FILT_HASH_GROUP) +
+                Filter->NumberCriteria * sizeof(YORI_LIB_FILE_FILT_COMPILED_CRITERIA);
+
+    Compiled = YoriLibMalloc(AllocSize);
+    if (Compiled == NULL) {
+        return FALSE;
+    }
+
+    ZeroMemory(Compiled, AllocSize);
+    Compiled->Groups = (PYORI_LIB_FILE_FILT_HASH_GROUP)(Compiled + 1);
+    Compiled->Criteria = (PYORI_LIB_FILE_FILT_COMPILED_CRITERIA)(Compiled->Groups + GroupCount);
+
+    for (Index = 0; Index < Filter->NumberCriteria; Index++) {
+        Compiled->Criteria[Index].NextWithSameKey = (DWORD)-1;
+    }
+
+    for (Index = 0; Index < Filter->NumberCriteria; Index = EndIndex) {
+        EndIndex = Index + 1;
+        if (!YoriLibFileFiltIsCriteriaHashable(&ColorCriteria[Index])) {
+            continue;
+        }
+        while (EndIndex < Filter->NumberCriteria &&
+               ColorCriteria[EndIndex].Match.CompareFn == ColorCriteria[Index].Match.CompareFn &&
+               YoriLibFileFiltIsCriteriaHashable(&ColorCriteria[EndIndex])) {
+            EndIndex++;
+        }
+        if (EndIndex - Index <= 1) {
+            continue;
+        }
+
+        Group = &Compiled->Groups[Compiled->GroupCount];
+        Compiled->GroupCount++;
+
+        Group->FirstIndex = Index;
+        Group->EndIndex = EndIndex;
+        Group->CompareFn = ColorCriteria[Index].Match.CompareFn;
+        Group->HashTable = YoriLibAllocateHashTable(EndIndex - Index);
+        if (Group->HashTable == NULL) {
+            YoriLibFileFiltFreeCompiled(Compiled, Filter->NumberCriteria);
+            return FALSE;
+        }
+
+        for (; Index < EndIndex; Index++) {
+            ThisCompiled = &Compiled->Criteria[Index];
+            ThisCompiled->Group = Group;
+
+            //
+            //  Only one criteria in a group can collect, since any others
+            //  would have been removed as duplicates when parsing.
+            //
+
+            if (ColorCriteria[Index].Match.CollectFn != NULL) {
+                ASSERT(Group->CollectFn == NULL);
+                Group->CollectFn = ColorCriteria[Index].Match.CollectFn;
+            }
+
+            YoriLibFileFiltGetHashKey(Group->CompareFn, &ColorCriteria[Index].Match.CompareEntry, &Key);
+            HashEntry = YoriLibHashLookupByKey(Group->HashTable, &Key);
+            if (HashEntry == NULL) {
+                YoriLibHashInsertByKey(Group->HashTable, &Key, ThisCompiled, &ThisCompiled->HashEntry);
+                ThisCompiled->HashEntryInserted = TRUE;
+            } else {
+                KeyCompiled = (PYORI_LIB_FILE_FILT_COMPILED_CRITERIA)HashEntry->Context;
+                while (KeyCompiled->NextWithSameKey != (DWORD)-1) {
+                    KeyCompiled = &Compiled->Criteria[KeyCompiled->NextWithSameKey];
+                }
+                KeyCompiled->NextWithSameKey = Index;
+            }
+        }
+    }
+
+    Filter->Compiled = Compiled;
+    return TRUE;
 }
 
 /**
@@ -728,7 +1274,19 @@ YoriLibFileFiltParseColorString(
     __out PYORI_STRING ErrorSubstring
     )
 {
-    return YoriLibFileFiltParseFilterStringInternal(Filter, ColorString, YoriLibFileFiltParseColorElement, sizeof(YORI_LIB_FILE_FILT_COLOR_CRITERIA), ErrorSubstring);
+    if (!YoriLibFileFiltParseFilterStringInternal(Filter, ColorString, YoriLibFileFiltParseColorElement, sizeof(YORI_LIB_FILE_FILT_COLOR_CRITERIA), ErrorSubstring)) {
+        return FALSE;
+    }
+
+    YoriLibFileFiltRemoveDuplicateCollection(Filter);
+
+    //
+    //  Compiling is an optimization.  If it fails, each criteria is
+    //  evaluated individually with the same result.
+    //
+
+    YoriLibFileFiltCompileColorCriteria(Filter);
+    return TRUE;
 }
 
 /**
@@ -782,6 +1340,145 @@ YoriLibFileFiltCheckFilterMatch(
     return TRUE;
 }
 
+/**
+ Find the next criteria within a hash group that matches a file.
+
+ @param Filter Pointer to the filter containing the group.
+
+ @param Group Pointer to the group of criteria to evaluate.
+
+ @param Entry Pointer to file information which has already been collected
+        for the field the group compares.
+
+ @param StartIndex The index of the first criteria to consider.  This must
+        be within the group.
+
+ @return The index of the first matching criteria at or after StartIndex,
+         or the group's EndIndex if no further criteria in the group match.
+ */
+DWORD
+YoriLibFileFiltNextGroupMatch(
+    __in PYORI_LIB_FILE_FILTER Filter,
+    __in PYORI_LIB_FILE_FILT_HASH_GROUP Group,
+    __in PYORI_FILE_INFO Entry,
+    __in DWORD StartIndex
+    )
+{
+    PYORI_LIB_FILE_FILT_COMPILED Compiled;
+    PYORI_LIB_FILE_FILT_COLOR_CRITERIA ColorCriteria;
+    PYORI_LIB_FILE_FILT_COLOR_CRITERIA ThisApply;
+    PYORI_LIB_FILE_FILT_COMPILED_CRITERIA ThisCompiled;
+    PYORI_HASH_ENTRY HashEntry;
+    YORI_STRING Key;
+    DWORD Index;
+
+    ASSERT(StartIndex >= Group->FirstIndex && StartIndex < Group->EndIndex);
+
+    Compiled = (PYORI_LIB_FILE_FILT_COMPILED)Filter->Compiled;
+    ColorCriteria = (PYORI_LIB_FILE_FILT_COLOR_CRITERIA)Filter->Criteria;
+
+    //
+    //  If the file's value can't be hashed, compare against each criteria.
+    //
+
+    if (!YoriLibFileFiltGetHashKey(Group->CompareFn, Entry, &Key)) {
+        for (Index = StartIndex; Index < Group->EndIndex; Index++) {
+            ThisApply = &ColorCriteria[Index];
+            if (ThisApply->Match.TruthStates[ThisApply->Match.CompareFn(Entry, &ThisApply->Match.CompareEntry)]) {
+                return Index;
+            }
+        }
+        return Group->EndIndex;
+    }
+
+    HashEntry = YoriLibHashLookupByKey(Group->HashTable, &Key);
+    if (HashEntry == NULL) {
+        return Group->EndIndex;
+    }
+
+    //
+    //  Walk the criteria comparing against this value in order.  Each is
+    //  still compared normally so the result is exactly what the compare
+    //  function would return.
+    //
+
+    ThisCompiled = (PYORI_LIB_FILE_FILT_COMPILED_CRITERIA)HashEntry->Context;
+    Index = (DWORD)(ThisCompiled - Compiled->Criteria);
+    while (Index < Group->EndIndex) {
+        if (Index >= StartIndex) {
+            ThisApply = &ColorCriteria[Index];
+            if (ThisApply->Match.TruthStates[ThisApply->Match.CompareFn(Entry, &ThisApply->Match.CompareEntry)]) {
+                return Index;
+            }
+        }
+        Index = Compiled->Criteria[Index].NextWithSameKey;
+    }
+
+    return Group->EndIndex;
+}
+
+/**
+ Find the next color criteria that matches a file whose information has
+ already been fully collected.  This is used by callers who collect all
+ information about a file in advance, and allows them to benefit from
+ compiled criteria.
+
+ @param Filter Pointer to the filter object which contains a list of color
+        criteria.
+
+ @param Entry Pointer to the fully collected file information.
+
+ @param StartIndex The index of the first criteria to consider.
+
+ @return The index of the first matching criteria at or after StartIndex,
+         or the number of criteria in the filter if no further criteria
+         match.
+ */
+DWORD
+YoriLibFileFiltNextColorMatch(
+    __in PYORI_LIB_FILE_FILTER Filter,
+    __in PYORI_FILE_INFO Entry,
+    __in DWORD StartIndex
+    )
+{
+    PYORI_LIB_FILE_FILT_COMPILED Compiled;
+    PYORI_LIB_FILE_FILT_COLOR_CRITERIA ColorCriteria;
+    PYORI_LIB_FILE_FILT_COLOR_CRITERIA ThisApply;
+    PYORI_LIB_FILE_FILT_HASH_GROUP Group;
+    DWORD Index;
+
+    ASSERT((Filter->ElementSize == 0 &&
+            Filter->NumberCriteria == 0) ||
+           Filter->ElementSize == sizeof(YORI_LIB_FILE_FILT_COLOR_CRITERIA));
+
+    Compiled = (PYORI_LIB_FILE_FILT_COMPILED)Filter->Compiled;
+    ColorCriteria = (PYORI_LIB_FILE_FILT_COLOR_CRITERIA)Filter->Criteria;
+
+    Index = StartIndex;
+    while (Index < Filter->NumberCriteria) {
+        Group = NULL;
+        if (Compiled != NULL) {
+            Group = Compiled->Criteria[Index].Group;
+        }
+
+        if (Group != NULL) {
+            Index = YoriLibFileFiltNextGroupMatch(Filter, Group, Entry, Index);
+            if (Index < Group->EndIndex) {
+                return Index;
+            }
+            continue;
+        }
+
+        ThisApply = &ColorCriteria[Index];
+        if (ThisApply->Match.TruthStates[ThisApply->Match.CompareFn(Entry, &ThisApply->Match.CompareEntry)]) {
+            return Index;
+        }
+        Index++;
+    }
+
+    return Filter->NumberCriteria;
+}
+
 /**
  Evaluate which color a file should be displayed as based on the user
  supplied filter string.
@@ -813,6 +1510,8 @@ YoriLibFileFiltCheckColorMatch(
     YORILIB_COLOR_ATTRIBUTES PreviousAttributes;
     PYORI_LIB_FILE_FILT_COLOR_CRITERIA ThisApply;
     PYORI_LIB_FILE_FILT_COLOR_CRITERIA ColorsToApply;
+    PYORI_LIB_FILE_FILT_COMPILED Compiled;
+    PYORI_LIB_FILE_FILT_HASH_GROUP Group;
     YORI_FILE_INFO CompareEntry;
 
     ZeroMemory(&CompareEntry, sizeof(CompareEntry));
@@ -830,32 +1529,64 @@ YoriLibFileFiltCheckColorMatch(
            Filter->ElementSize == sizeof(YORI_LIB_FILE_FILT_COLOR_CRITERIA));
 
     ColorsToApply = (PYORI_LIB_FILE_FILT_COLOR_CRITERIA)Filter->Criteria;
-    for (Index = 0; Index < Filter->NumberCriteria; Index++) {
+    Compiled = (PYORI_LIB_FILE_FILT_COMPILED)Filter->Compiled;
+    Index = 0;
+    while (Index < Filter->NumberCriteria) {
         ThisApply = &ColorsToApply[Index];
+        Group = NULL;
+        if (Compiled != NULL) {
+            Group = Compiled->Criteria[Index].Group;
+        }
 
-        if (ThisApply->Match.CollectFn != NULL &&
-            !ThisApply->Match.CollectFn(&CompareEntry, FileInfo, FilePath)) {
+        //
+        //  If this criteria is part of a group, collect the field for the
+        //  group when entering it, and find the next matching criteria in
+        //  the group with a hash lookup.  If nothing else in the group
+        //  matches, move on to the criteria following the group.
+        //
 
-            return FALSE;
-        }
+        if (Group != NULL) {
+            if (Index == Group->FirstIndex &&
+                Group->CollectFn != NULL &&
+                !Group->CollectFn(&CompareEntry, FileInfo, FilePath)) {
 
-        if (ThisApply->Match.TruthStates[ThisApply->Match.CompareFn(&CompareEntry, &ThisApply->Match.CompareEntry)]) {
-            ThisAttribute = YoriLibCombineColors(ThisAttribute, ThisApply->Color);
-            if ((ThisAttribute.Ctrl & YORILIB_ATTRCTRL_CONTINUE) == 0) {
+                return FALSE;
+            }
 
-                ThisAttribute = YoriLibResolveWindowColorComponents(ThisAttribute, PreviousAttributes, TRUE);
+            Index = YoriLibFileFiltNextGroupMatch(Filter, Group, &CompareEntry, Index);
+            if (Index >= Group->EndIndex) {
+                continue;
+            }
+            ThisApply = &ColorsToApply[Index];
+        } else {
+            if (ThisApply->Match.CollectFn != NULL &&
+                !ThisApply->Match.CollectFn(&CompareEntry, FileInfo, FilePath)) {
 
-                if (ThisAttribute.Ctrl & YORILIB_ATTRCTRL_INVERT) {
-                    ThisAttribute.Win32Attr = (UCHAR)(((ThisAttribute.Win32Attr & 0x0F) << 4) + ((ThisAttribute.Win32Attr & 0xF0) >> 4));
-                    ThisAttribute.Ctrl = (UCHAR)(ThisAttribute.Ctrl & ~(YORILIB_ATTRCTRL_INVERT));
-                }
+                return FALSE;
+            }
+
+            if (!ThisApply->Match.TruthStates[ThisApply->Match.CompareFn(&CompareEntry, &ThisApply->Match.CompareEntry)]) {
+                Index++;
+                continue;
+            }
+        }
+
+        ThisAttribute = YoriLibCombineColors(ThisAttribute, ThisApply->Color);
+        if ((ThisAttribute.Ctrl & YORILIB_ATTRCTRL_CONTINUE) == 0) {
+
+            ThisAttribute = YoriLibResolveWindowColorComponents(ThisAttribute, PreviousAttributes, TRUE);
 
-                *Attribute = ThisAttribute;
-                return TRUE;
+            if (ThisAttribute.Ctrl & YORILIB_ATTRCTRL_INVERT) {
+                ThisAttribute.Win32Attr = (UCHAR)(((ThisAttribute.Win32Attr & 0x0F) << 4) + ((ThisAttribute.Win32Attr & 0xF0) >> 4));
+                ThisAttribute.Ctrl = (UCHAR)(ThisAttribute.Ctrl & ~(YORILIB_ATTRCTRL_INVERT));
             }
 
-            ThisAttribute.Ctrl = (UCHAR)(ThisAttribute.Ctrl & ~(YORILIB_ATTRCTRL_CONTINUE));
+            *Attribute = ThisAttribute;
+            return TRUE;
         }
+
+        ThisAttribute.Ctrl = (UCHAR)(ThisAttribute.Ctrl & ~(YORILIB_ATTRCTRL_CONTINUE));
+        Index++;
     }
 
     //
@@ -886,6 +1617,10 @@ YoriLibFileFiltFreeFilter(
     __in PYORI_LIB_FILE_FILTER Filter
     )
 {
+    if (Filter->Compiled != NULL) {
+        YoriLibFileFiltFreeCompiled((PYORI_LIB_FILE_FILT_COMPILED)Filter->Compiled, Filter->NumberCriteria);
+    }
+    Filter->Compiled = NULL;
     if (Filter->Criteria != NULL) {
         YoriLibFree(Filter->Criteria);
     }
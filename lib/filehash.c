@@ -0,0 +1,217 @@
+/**
+ * @file lib/filehash.c
+ *
+ * Yori routines to generate a cryptographic hash of file contents
+ *
+ * Copyright (c) 2019 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+/**
+ Specifies the builtin Microsoft hash provider.
+ */
+#define MS_PRIMITIVE_PROVIDER L"Microsoft Primitive Provider"
+
+/**
+ Specifies the NT success error code.
+ */
+#define STATUS_SUCCESS (0)
+
+#ifndef STATUS_NOT_SUPPORTED
+/**
+ Specifies the NT error code returned if BCrypt is not available.
+ */
+#define STATUS_NOT_SUPPORTED ((LONG)0xC00000BB)
+#endif
+
+/**
+ Open a hash algorithm provider and determine the buffer sizes needed to use
+ it.  The resulting algorithm can be used from multiple threads, provided
+ each thread supplies its own scratch buffer.
+
+ @param AlgorithmName Specifies a NULL terminated string indicating the
+        BCrypt hash algorithm to open, such as L"SHA1".
+
+ @param Algorithm On successful completion, populated with the algorithm
+        provider and its properties.  The caller should close this with
+        @ref YoriLibFileHashCloseAlgorithm.
+
+ @return Zero to indicate success, or an NTSTATUS failure code.  If the
+         operating system does not support BCrypt, STATUS_NOT_SUPPORTED
+         is returned.
+ */
+LONG
+YoriLibFileHashOpenAlgorithm(
+    __in LPCWSTR AlgorithmName,
+    __out PYORI_LIB_FILE_HASH_ALGORITHM Algorithm
+    )
+{
+    LONG Status;
+    DWORD BytesReturned;
+
+    ZeroMemory(Algorithm, sizeof(YORI_LIB_FILE_HASH_ALGORITHM));
+
+    YoriLibLoadBCryptFunctions();
+    if (DllBCrypt.pBCryptCloseAlgorithmProvider == NULL ||
+        DllBCrypt.pBCryptCreateHash == NULL ||
+        DllBCrypt.pBCryptDestroyHash == NULL ||
+        DllBCrypt.pBCryptFinishHash == NULL ||
+        DllBCrypt.pBCryptGetProperty == NULL ||
+        DllBCrypt.pBCryptHashData == NULL ||
+        DllBCrypt.pBCryptOpenAlgorithmProvider == NULL) {
+
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    Status = DllBCrypt.pBCryptOpenAlgorithmProvider(&Algorithm->Algorithm, AlgorithmName, MS_PRIMITIVE_PROVIDER, 0);
+    if (Status != STATUS_SUCCESS) {
+        Algorithm->Algorithm = NULL;
+        return Status;
+    }
+
+    Status = DllBCrypt.pBCryptGetProperty(Algorithm->Algorithm, L"HashDigestLength", &Algorithm->HashLength, sizeof(Algorithm->HashLength), &BytesReturned, 0);
+    if (Status == STATUS_SUCCESS) {
+        Status = DllBCrypt.pBCryptGetProperty(Algorithm->Algorithm, L"ObjectLength", &Algorithm->ScratchBufferLength, sizeof(Algorithm->ScratchBufferLength), &BytesReturned, 0);
+    }
+
+    if (Status != STATUS_SUCCESS) {
+        YoriLibFileHashCloseAlgorithm(Algorithm);
+    }
+
+    return Status;
+}
+
+/**
+ Close a hash algorithm provider opened with
+ @ref YoriLibFileHashOpenAlgorithm.
+
+ @param Algorithm Pointer to the algorithm to close.
+ */
+VOID
+YoriLibFileHashCloseAlgorithm(
+    __inout PYORI_LIB_FILE_HASH_ALGORITHM Algorithm
+    )
+{
+    LONG Status;
+
+    if (Algorithm->Algorithm != NULL) {
+        Status = DllBCrypt.pBCryptCloseAlgorithmProvider(Algorithm->Algorithm, 0);
+        ASSERT(Status == STATUS_SUCCESS);
+        Algorithm->Algorithm = NULL;
+    }
+}
+
+/**
+ Generate a hash of data read from a stream.
+
+ @param Algorithm Pointer to an algorithm opened with
+        @ref YoriLibFileHashOpenAlgorithm.
+
+ @param hSource A handle to the incoming stream, which may be a file or a
+        pipe.  Data is read from the current position.
+
+ @param MaximumLength The maximum number of bytes to hash.  Specify
+        (DWORDLONG)-1 to hash until the end of the stream.
+
+ @param ScratchBuffer Pointer to a buffer of the algorithm's
+        ScratchBufferLength bytes, used by BCrypt while the hash is being
+        generated.
+
+ @param ReadBuffer Pointer to a buffer to read data from the stream into.
+
+ @param ReadBufferLength The number of bytes in ReadBuffer.
+
+ @param HashBuffer On successful completion, populated with the hash.  This
+        must be at least the algorithm's HashLength bytes.
+
+ @param BytesHashed Optionally points to a location to receive the number of
+        bytes of data that were hashed.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibFileHashStream(
+    __in PYORI_LIB_FILE_HASH_ALGORITHM Algorithm,
+    __in HANDLE hSource,
+    __in DWORDLONG MaximumLength,
+    __in PVOID ScratchBuffer,
+    __in PVOID ReadBuffer,
+    __in DWORD ReadBufferLength,
+    __out PUCHAR HashBuffer,
+    __out_opt PDWORDLONG BytesHashed
+    )
+{
+    LONG Status;
+    PVOID hHash;
+    DWORD BytesToRead;
+    DWORD BytesRead;
+    DWORDLONG TotalBytesRead;
+
+    Status = DllBCrypt.pBCryptCreateHash(Algorithm->Algorithm, &hHash, ScratchBuffer, Algorithm->ScratchBufferLength, NULL, 0, 0);
+
+    if (Status != STATUS_SUCCESS) {
+        return FALSE;
+    }
+
+    TotalBytesRead = 0;
+
+    while (TotalBytesRead < MaximumLength) {
+        BytesToRead = ReadBufferLength;
+        if (MaximumLength - TotalBytesRead < BytesToRead) {
+            BytesToRead = (DWORD)(MaximumLength - TotalBytesRead);
+        }
+
+        if (!ReadFile(hSource, ReadBuffer, BytesToRead, &BytesRead, NULL)) {
+            break;
+        }
+
+        if (BytesRead == 0) {
+            break;
+        }
+
+        Status = DllBCrypt.pBCryptHashData(hHash, ReadBuffer, BytesRead, 0);
+        if (Status != STATUS_SUCCESS) {
+            break;
+        }
+
+        TotalBytesRead += BytesRead;
+    }
+
+    if (Status == STATUS_SUCCESS) {
+        Status = DllBCrypt.pBCryptFinishHash(hHash, HashBuffer, Algorithm->HashLength, 0);
+    }
+
+    DllBCrypt.pBCryptDestroyHash(hHash);
+
+    if (Status != STATUS_SUCCESS) {
+        return FALSE;
+    }
+
+    if (BytesHashed != NULL) {
+        *BytesHashed = TotalBytesRead;
+    }
+
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
@@ -464,6 +464,964 @@ YoriLibIsExecutableGui(
     return FALSE;
 }
 
+/**
+ The number of bytes to read from the beginning of a file to find its PE
+ headers and section table.
+ */
+#define YORILIB_PE_HEADER_READ_SIZE     4096
+
+/**
+ The number of bytes to read from the beginning of the resource directory to
+ find the version resource.  Resource directories are placed before resource
+ data, so this normally contains the path to the version resource.  If it
+ does not, the version resource is loaded through version.dll.
+ */
+#define YORILIB_PE_RESOURCE_READ_SIZE   4096
+
+/**
+ The maximum size of a version resource to read directly from a file.
+ Larger resources are loaded through version.dll.
+ */
+#define YORILIB_PE_VERSION_MAX_SIZE     (64 * 1024)
+
+/**
+ The number of files whose PE metadata is retained.  This needs to be at
+ least as large as the number of threads concurrently collecting metadata
+ for the cache to be effective.
+ */
+#define YORILIB_PE_CACHE_SLOTS          32
+
+/**
+ The resource type identifier for version resources, aka RT_VERSION.
+ */
+#define YORILIB_PE_RESOURCE_TYPE_VERSION 16
+
+/**
+ Read a little endian WORD from an arbitrarily aligned offset in a buffer.
+ */
+#define YoriLibPeReadWord(Buf, Ofs) \
+    ((WORD)((Buf)[(Ofs)] | ((Buf)[(Ofs) + 1] << 8)))
+
+/**
+ Read a little endian DWORD from an arbitrarily aligned offset in a buffer.
+ */
+#define YoriLibPeReadDword(Buf, Ofs) \
+    ((DWORD)(Buf)[(Ofs)] | ((DWORD)(Buf)[(Ofs) + 1] << 8) | ((DWORD)(Buf)[(Ofs) + 2] << 16) | ((DWORD)(Buf)[(Ofs) + 3] << 24))
+
+/**
+ Information parsed from a PE image.  This is populated from the contents of
+ the file only, so it can be parsed without relying on any system support.
+ */
+typedef struct _YORILIB_PE_IMAGE_INFO {
+
+    /**
+     The architecture the image was built for.
+     */
+    WORD Machine;
+
+    /**
+     The subsystem the image runs in.
+     */
+    WORD Subsystem;
+
+    /**
+     The major version of the subsystem required to run the image.
+     */
+    WORD MajorSubsystemVersion;
+
+    /**
+     The minor version of the subsystem required to run the image.
+     */
+    WORD MinorSubsystemVersion;
+
+    /**
+     The virtual address of the resource directory, or zero if the image
+     has no resources.
+     */
+    DWORD ResourceRva;
+
+    /**
+     The offset within the file of the resource directory.
+     */
+    DWORD ResourceFileOffset;
+
+    /**
+     The number of bytes within the file following ResourceFileOffset that
+     belong to the section containing the resource directory.
+     */
+    DWORD ResourceFileLength;
+
+    /**
+     TRUE if the resource directory indicates that resources have been
+     moved to language specific files, so version information should be
+     loaded through the system.
+     */
+    BOOL HasMuiResource;
+
+    /**
+     The offset within the file of the version resource, valid if
+     VersionLength is nonzero.
+     */
+    DWORD VersionFileOffset;
+
+    /**
+     The length of the version resource in bytes, or zero if the image does
+     not contain a version resource.
+     */
+    DWORD VersionLength;
+} YORILIB_PE_IMAGE_INFO, *PYORILIB_PE_IMAGE_INFO;
+
+/**
+ Parse the headers of a PE image.  The buffer is untrusted, so every value
+ read from it is checked against the buffer length.
+
+ @param Buffer Pointer to the contents of the beginning of the file.
+
+ @param Length The number of bytes in Buffer.
+
+ @param ImageInfo On successful completion, populated with information from
+        the PE headers.  If the image contains resources, the location of
+        the resource directory is also populated.
+
+ @return TRUE if the buffer contains a PE image, FALSE if it does not.
+ */
+BOOL
+YoriLibPeParseHeaders(
+    __in_bcount(Length) PUCHAR Buffer,
+    __in DWORD Length,
+    __out PYORILIB_PE_IMAGE_INFO ImageInfo
+    )
+{
+    DWORD PeOffset;
+    DWORD OptionalHeaderOffset;
+    DWORD OptionalHeaderSize;
+    DWORD DataDirectoryOffset;
+    DWORD DataDirectoryCount;
+    DWORD SectionOffset;
+    DWORD SectionCount;
+    DWORD Index;
+    DWORD SectionRva;
+    DWORD SectionVirtualSize;
+    DWORD SectionRawSize;
+    DWORD SectionFileOffset;
+    DWORD ResourceSize;
+
+    ZeroMemory(ImageInfo, sizeof(YORILIB_PE_IMAGE_INFO));
+
+    //
+    //  Check for a DOS header and find the PE signature from it.
+    //
+
+    if (Length < 0x40 || YoriLibPeReadWord(Buffer, 0) != IMAGE_DOS_SIGNATURE) {
+        return FALSE;
+    }
+
+    PeOffset = YoriLibPeReadDword(Buffer, 0x3c);
+    if (PeOffset == 0 || PeOffset > Length || Length - PeOffset < 24) {
+        return FALSE;
+    }
+
+    if (YoriLibPeReadDword(Buffer, PeOffset) != IMAGE_NT_SIGNATURE) {
+        return FALSE;
+    }
+
+    //
+    //  The file header follows the signature, and the optional header
+    //  follows the file header.  Fields up to and including the subsystem
+    //  are at the same offsets for 32 and 64 bit images.
+    //
+
+    ImageInfo->Machine = YoriLibPeReadWord(Buffer, PeOffset + 4);
+    SectionCount = YoriLibPeReadWord(Buffer, PeOffset + 6);
+    OptionalHeaderSize = YoriLibPeReadWord(Buffer, PeOffset + 20);
+    OptionalHeaderOffset = PeOffset + 24;
+
+    if (OptionalHeaderSize < 70 || Length - OptionalHeaderOffset < 70) {
+        return FALSE;
+    }
+
+    ImageInfo->MajorSubsystemVersion = YoriLibPeReadWord(Buffer, OptionalHeaderOffset + 48);
+    ImageInfo->MinorSubsystemVersion = YoriLibPeReadWord(Buffer, OptionalHeaderOffset + 50);
+    ImageInfo->Subsystem = YoriLibPeReadWord(Buffer, OptionalHeaderOffset + 68);
+
+    //
+    //  Find the resource directory.  Any failure from here on means the
+    //  headers are valid but the resources can't be found, which is
+    //  indicated by leaving ResourceRva as zero.
+    //
+
+    switch(YoriLibPeReadWord(Buffer, OptionalHeaderOffset)) {
+        case 0x10b:
+            DataDirectoryOffset = 96;
+            break;
+        case 0x20b:
+            DataDirectoryOffset = 112;
+            break;
+        default:
+            return TRUE;
+    }
+
+    if (OptionalHeaderSize < DataDirectoryOffset ||
+        Length - OptionalHeaderOffset < DataDirectoryOffset) {
+
+        return TRUE;
+    }
+
+    DataDirectoryCount = YoriLibPeReadDword(Buffer, OptionalHeaderOffset + DataDirectoryOffset - 4);
+    if (DataDirectoryCount <= IMAGE_DIRECTORY_ENTRY_RESOURCE ||
+        OptionalHeaderSize < DataDirectoryOffset + (IMAGE_DIRECTORY_ENTRY_RESOURCE + 1) * 8 ||
+        Length - OptionalHeaderOffset < DataDirectoryOffset + (IMAGE_DIRECTORY_ENTRY_RESOURCE + 1) * 8) {
+
+        return TRUE;
+    }
+
+    DataDirectoryOffset = OptionalHeaderOffset + DataDirectoryOffset + IMAGE_DIRECTORY_ENTRY_RESOURCE * 8;
+    ImageInfo->ResourceRva = YoriLibPeReadDword(Buffer, DataDirectoryOffset);
+    ResourceSize = YoriLibPeReadDword(Buffer, DataDirectoryOffset + 4);
+    if (ImageInfo->ResourceRva == 0 || ResourceSize == 0) {
+        ImageInfo->ResourceRva = 0;
+        return TRUE;
+    }
+
+    //
+    //  Find the section containing the resource directory to determine
+    //  where it is in the file.
+    //
+
+    SectionOffset = OptionalHeaderOffset + OptionalHeaderSize;
+    for (Index = 0; Index < SectionCount; Index++) {
+        if (SectionOffset > Length || Length - SectionOffset < 40) {
+            break;
+        }
+
+        SectionVirtualSize = YoriLibPeReadDword(Buffer, SectionOffset + 8);
+        SectionRva = YoriLibPeReadDword(Buffer, SectionOffset + 12);
+        SectionRawSize = YoriLibPeReadDword(Buffer, SectionOffset + 16);
+        SectionFileOffset = YoriLibPeReadDword(Buffer, SectionOffset + 20);
+        if (SectionVirtualSize < SectionRawSize) {
+            SectionVirtualSize = SectionRawSize;
+        }
+
+        if (ImageInfo->ResourceRva >= SectionRva &&
+            ImageInfo->ResourceRva - SectionRva < SectionVirtualSize) {
+
+            if (ImageInfo->ResourceRva - SectionRva >= SectionRawSize ||
+                SectionFileOffset + SectionRawSize < SectionFileOffset) {
+
+                break;
+            }
+
+            ImageInfo->ResourceFileOffset = SectionFileOffset + ImageInfo->ResourceRva - SectionRva;
+            ImageInfo->ResourceFileLength = SectionRawSize - (ImageInfo->ResourceRva - SectionRva);
+            return TRUE;
+        }
+
+        SectionOffset += 40;
+    }
+
+    ImageInfo->ResourceRva = 0;
+    return TRUE;
+}
+
+/**
+ Find the data for the first entry within a resource directory.  If the
+ first entry is a further directory, its first entry is found, to a
+ maximum depth.
+
+ @param Buffer Pointer to the contents of the resource directory.
+
+ @param Length The number of bytes in Buffer.
+
+ @param DirectoryOffset The offset within Buffer of the resource directory.
+
+ @param Depth The number of levels of subdirectories to traverse.
+
+ @param DataEntryOffset On successful completion, populated with the offset
+        within Buffer of the resource data entry.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibPeFindFirstResourceData(
+    __in_bcount(Length) PUCHAR Buffer,
+    __in DWORD Length,
+    __in DWORD DirectoryOffset,
+    __in DWORD Depth,
+    __out PDWORD DataEntryOffset
+    )
+{
+    DWORD EntryCount;
+    DWORD OffsetToData;
+
+    while (TRUE) {
+        if (DirectoryOffset > Length || Length - DirectoryOffset < 24) {
+            return FALSE;
+        }
+
+        EntryCount = YoriLibPeReadWord(Buffer, DirectoryOffset + 12) + YoriLibPeReadWord(Buffer, DirectoryOffset + 14);
+        if (EntryCount == 0) {
+            return FALSE;
+        }
+
+        OffsetToData = YoriLibPeReadDword(Buffer, DirectoryOffset + 20);
+        if ((OffsetToData & 0x80000000) == 0) {
+            *DataEntryOffset = OffsetToData;
+            return TRUE;
+        }
+
+        if (Depth == 0) {
+            return FALSE;
+        }
+
+        Depth--;
+        DirectoryOffset = OffsetToData & 0x7fffffff;
+    }
+}
+
+/**
+ Parse the resource directory of a PE image to find its version resource.
+ The buffer is untrusted, so every value read from it is checked against
+ the buffer length.
+
+ @param Buffer Pointer to the contents of the resource directory.
+
+ @param Length The number of bytes in Buffer.
+
+ @param ImageInfo Pointer to information previously populated from the PE
+        headers.  On successful completion, updated with the location of
+        the version resource within the file, if any, and whether the image
+        has language specific resource files.
+
+ @return TRUE if the resource directory was parsed, FALSE if it could not
+         be parsed.
+ */
+BOOL
+YoriLibPeParseResources(
+    __in_bcount(Length) PUCHAR Buffer,
+    __in DWORD Length,
+    __inout PYORILIB_PE_IMAGE_INFO ImageInfo
+    )
+{
+    DWORD NamedCount;
+    DWORD EntryCount;
+    DWORD Index;
+    DWORD EntryOffset;
+    DWORD Name;
+    DWORD NameOffset;
+    DWORD OffsetToData;
+    DWORD DataEntryOffset;
+    DWORD DataRva;
+    DWORD DataLength;
+
+    ImageInfo->HasMuiResource = FALSE;
+    ImageInfo->VersionFileOffset = 0;
+    ImageInfo->VersionLength = 0;
+
+    if (Length < 16) {
+        return FALSE;
+    }
+
+    NamedCount = YoriLibPeReadWord(Buffer, 12);
+    EntryCount = NamedCount + YoriLibPeReadWord(Buffer, 14);
+    if (EntryCount > (Length - 16) / 8) {
+        return FALSE;
+    }
+
+    OffsetToData = 0;
+    for (Index = 0; Index < EntryCount; Index++) {
+        EntryOffset = 16 + Index * 8;
+        Name = YoriLibPeReadDword(Buffer, EntryOffset);
+
+        //
+        //  Named types come first.  Look for a type called "MUI", which
+        //  indicates resources are in language specific files.
+        //
+
+        if (Index < NamedCount) {
+            NameOffset = Name & 0x7fffffff;
+            if ((Name & 0x80000000) != 0 &&
+                NameOffset <= Length &&
+                Length - NameOffset >= 8 &&
+                YoriLibPeReadWord(Buffer, NameOffset) == 3 &&
+                YoriLibPeReadWord(Buffer, NameOffset + 2) == 'M' &&
+                YoriLibPeReadWord(Buffer, NameOffset + 4) == 'U' &&
+                YoriLibPeReadWord(Buffer, NameOffset + 6) == 'I') {
+
+                ImageInfo->HasMuiResource = TRUE;
+            }
+        } else if (Name == YORILIB_PE_RESOURCE_TYPE_VERSION) {
+            OffsetToData = YoriLibPeReadDword(Buffer, EntryOffset + 4);
+        }
+    }
+
+    //
+    //  If there's no version resource, the resource directory has been
+    //  parsed successfully.  The version resource should be a directory of
+    //  names each containing a directory of languages, so use the first
+    //  language of the first name.
+    //
+
+    if (OffsetToData == 0) {
+        return TRUE;
+    }
+
+    if ((OffsetToData & 0x80000000) == 0 ||
+        !YoriLibPeFindFirstResourceData(Buffer, Length, OffsetToData & 0x7fffffff, 1, &DataEntryOffset)) {
+
+        return FALSE;
+    }
+
+    if (DataEntryOffset > Length || Length - DataEntryOffset < 16) {
+        return FALSE;
+    }
+
+    //
+    //  The data entry refers to the resource by virtual address.  It should
+    //  be in the same section as the resource directory.
+    //
+
+    DataRva = YoriLibPeReadDword(Buffer, DataEntryOffset);
+    DataLength = YoriLibPeReadDword(Buffer, DataEntryOffset + 4);
+    if (DataLength == 0 ||
+        DataRva < ImageInfo->ResourceRva ||
+        DataRva - ImageInfo->ResourceRva > ImageInfo->ResourceFileLength ||
+        ImageInfo->ResourceFileLength - (DataRva - ImageInfo->ResourceRva) < DataLength) {
+
+        return FALSE;
+    }
+
+    ImageInfo->VersionFileOffset = ImageInfo->ResourceFileOffset + DataRva - ImageInfo->ResourceRva;
+    ImageInfo->VersionLength = DataLength;
+    return TRUE;
+}
+
+/**
+ Metadata collected from a PE image that is shared between the functions
+ which collect information from PE headers or version resources.  This is a
+ referenced allocation that also contains the file name and version
+ resource.
+ */
+typedef struct _YORILIB_PE_METADATA {
+
+    /**
+     The full path to the file.
+     */
+    YORI_STRING FullPath;
+
+    /**
+     The last write time of the file when the metadata was collected.
+     */
+    FILETIME LastWriteTime;
+
+    /**
+     The high 32 bits of the file size when the metadata was collected.
+     */
+    DWORD FileSizeHigh;
+
+    /**
+     The low 32 bits of the file size when the metadata was collected.
+     */
+    DWORD FileSizeLow;
+
+    /**
+     TRUE if the file is a PE image and the fields in ImageInfo from its
+     headers are valid.
+     */
+    BOOL HeadersValid;
+
+    /**
+     TRUE if an attempt was made to load the version resource.  If FALSE,
+     only the headers were read.
+     */
+    BOOL VersionLoaded;
+
+    /**
+     Information from the PE headers.
+     */
+    YORILIB_PE_IMAGE_INFO ImageInfo;
+
+    /**
+     Pointer to the version resource in a form that can be passed to
+     VerQueryValue, or NULL if the file has no version resource.
+     */
+    PVOID VersionInfo;
+} YORILIB_PE_METADATA, *PYORILIB_PE_METADATA;
+
+/**
+ A single file's metadata retained in the cache.
+ */
+typedef struct _YORILIB_PE_CACHE_SLOT {
+
+    /**
+     Pointer to the metadata, or NULL if the slot is unused.  The cache
+     holds a reference on the metadata.
+     */
+    PYORILIB_PE_METADATA Metadata;
+
+    /**
+     The value of YoriLibPeCacheUseCount when this slot was last used.
+     */
+    DWORD LastUsed;
+} YORILIB_PE_CACHE_SLOT, *PYORILIB_PE_CACHE_SLOT;
+
+/**
+ Metadata from recently inspected PE images.  Several collection functions
+ need data from the same file, so retaining it avoids opening and parsing
+ the file once per collection function.
+ */
+YORILIB_PE_CACHE_SLOT YoriLibPeCache[YORILIB_PE_CACHE_SLOTS];
+
+/**
+ A counter incremented each time the cache is used, used to determine which
+ slot was least recently used.
+ */
+DWORD YoriLibPeCacheUseCount;
+
+/**
+ A handle to a mutex to synchronize access to the cache, since metadata may
+ be collected on multiple threads.  This is created by
+ @ref YoriLibInitPeMetadataCache .
+ */
+HANDLE YoriLibPeCacheMutex;
+
+/**
+ Set to TRUE once any caller has requested a version resource.  From then
+ on the version resource is loaded along with the headers, so a file is only
+ opened once when both are needed, while callers that only need headers
+ never read resources.
+ */
+BOOL YoriLibPeCacheLoadVersion;
+
+/**
+ Read a range of a file into a buffer.
+
+ @param hFile Handle to the file.
+
+ @param FileOffset The offset within the file to read from.
+
+ @param Buffer Pointer to the buffer to read into.
+
+ @param Length The number of bytes to read.
+
+ @param BytesRead On successful completion, populated with the number of
+        bytes read, which may be less than Length at the end of the file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibPeReadFileRange(
+    __in HANDLE hFile,
+    __in DWORD FileOffset,
+    __out_bcount(Length) PUCHAR Buffer,
+    __in DWORD Length,
+    __out PDWORD BytesRead
+    )
+{
+    if (SetFilePointer(hFile, FileOffset, NULL, FILE_BEGIN) != FileOffset) {
+        return FALSE;
+    }
+
+    return ReadFile(hFile, Buffer, Length, BytesRead, NULL);
+}
+
+/**
+ Load a file's version resource through version.dll.  This supports images
+ which are not PE files and images whose version resource is in a language
+ specific file.
+
+ @param FullPath Pointer to the full path to the file.
+
+ @param VersionLength On successful completion, populated with the number of
+        bytes in the returned buffer.
+
+ @return Pointer to the version resource, which should be freed with
+         @ref YoriLibFree, or NULL if it could not be loaded.
+ */
+PVOID
+YoriLibPeLoadVersionThroughSystem(
+    __in PYORI_STRING FullPath,
+    __out PDWORD VersionLength
+    )
+{
+    DWORD Junk;
+    DWORD VerSize;
+    PVOID Buffer;
+
+    *VersionLength = 0;
+
+    YoriLibLoadVersionFunctions();
+
+    if (DllVersion.pGetFileVersionInfoSizeW == NULL ||
+        DllVersion.pGetFileVersionInfoW == NULL) {
+
+        return NULL;
+    }
+
+    VerSize = DllVersion.pGetFileVersionInfoSizeW(FullPath->StartOfString, &Junk);
+    if (VerSize == 0) {
+        return NULL;
+    }
+
+    Buffer = YoriLibMalloc(VerSize);
+    if (Buffer == NULL) {
+        return NULL;
+    }
+
+    if (!DllVersion.pGetFileVersionInfoW(FullPath->StartOfString, 0, VerSize, Buffer)) {
+        YoriLibFree(Buffer);
+        return NULL;
+    }
+
+    *VersionLength = VerSize;
+    return Buffer;
+}
+
+/**
+ Open a file and collect the metadata from its PE headers and optionally its
+ version resource.  The file is opened once and only the headers, resource
+ directory and version resource are read.
+
+ @param FindData The directory enumeration information.
+
+ @param FullPath Pointer to the full path to the file.
+
+ @param LoadVersion TRUE if the version resource should be loaded, FALSE if
+        only the headers are needed.
+
+ @return Pointer to a referenced allocation containing the metadata, or NULL
+         on allocation failure.  Files which are not PE images return
+         metadata indicating that no headers or version resource were found.
+ */
+PYORILIB_PE_METADATA
+YoriLibCapturePeMetadata(
+    __in PWIN32_FIND_DATA FindData,
+    __in PYORI_STRING FullPath,
+    __in BOOL LoadVersion
+    )
+{
+    HANDLE hFile;
+    PUCHAR Buffer;
+    DWORD BytesRead;
+    DWORD BufferLength;
+    PVOID Version;
+    DWORD VersionLength;
+    DWORD AllocationLength;
+    DWORD VersionOffset;
+    BOOL HeadersValid;
+    BOOL LoadVersionThroughSystem;
+    YORILIB_PE_IMAGE_INFO ImageInfo;
+    PYORILIB_PE_METADATA Metadata;
+
+    ZeroMemory(&ImageInfo, sizeof(ImageInfo));
+    HeadersValid = FALSE;
+    LoadVersionThroughSystem = FALSE;
+    Version = NULL;
+    VersionLength = 0;
+
+    if ((FindData->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+
+        hFile = CreateFile(FullPath->StartOfString,
+                           FILE_READ_ATTRIBUTES|FILE_READ_DATA,
+                           FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+                           NULL,
+                           OPEN_EXISTING,
+                           FILE_FLAG_BACKUP_SEMANTICS,
+                           NULL);
+
+        if (hFile != INVALID_HANDLE_VALUE) {
+
+            BufferLength = YORILIB_PE_RESOURCE_READ_SIZE;
+            if (BufferLength < YORILIB_PE_HEADER_READ_SIZE) {
+                BufferLength = YORILIB_PE_HEADER_READ_SIZE;
+            }
+
+            Buffer = YoriLibMalloc(BufferLength);
+            if (Buffer != NULL &&
+                ReadFile(hFile, Buffer, YORILIB_PE_HEADER_READ_SIZE, &BytesRead, NULL)) {
+
+                HeadersValid = YoriLibPeParseHeaders(Buffer, BytesRead, &ImageInfo);
+
+                //
+                //  Executables which are not PE images may still have a
+                //  version resource which the system can find.
+                //
+
+                if (!HeadersValid &&
+                    LoadVersion &&
+                    BytesRead >= 2 &&
+                    YoriLibPeReadWord(Buffer, 0) == IMAGE_DOS_SIGNATURE) {
+
+                    LoadVersionThroughSystem = TRUE;
+                }
+            }
+
+            //
+            //  If the image has resources, read the resource directory to
+            //  find the version resource.  If anything about it looks
+            //  unusual, let the system find it instead.
+            //
+
+            if (HeadersValid && LoadVersion && ImageInfo.ResourceRva != 0) {
+                LoadVersionThroughSystem = TRUE;
+
+                BufferLength = YORILIB_PE_RESOURCE_READ_SIZE;
+                if (BufferLength > ImageInfo.ResourceFileLength) {
+                    BufferLength = ImageInfo.ResourceFileLength;
+                }
+
+                if (YoriLibPeReadFileRange(hFile, ImageInfo.ResourceFileOffset, Buffer, BufferLength, &BytesRead) &&
+                    YoriLibPeParseResources(Buffer, BytesRead, &ImageInfo) &&
+                    !ImageInfo.HasMuiResource &&
+                    ImageInfo.VersionLength <= YORILIB_PE_VERSION_MAX_SIZE) {
+
+                    LoadVersionThroughSystem = FALSE;
+                }
+            }
+
+            //
+            //  Older versions of version.dll write to the buffer while
+            //  parsing it, so allocate twice the resource size, which is
+            //  what GetFileVersionInfoSize would request.
+            //
+
+            if (HeadersValid && !LoadVersionThroughSystem && ImageInfo.VersionLength > 0) {
+                VersionLength = ImageInfo.VersionLength * 2;
+                Version = YoriLibMalloc(VersionLength);
+                if (Version != NULL) {
+                    ZeroMemory(Version, VersionLength);
+                    if (!YoriLibPeReadFileRange(hFile, ImageInfo.VersionFileOffset, Version, ImageInfo.VersionLength, &BytesRead) ||
+                        BytesRead != ImageInfo.VersionLength) {
+
+                        YoriLibFree(Version);
+                        Version = NULL;
+                        VersionLength = 0;
+                    }
+                } else {
+                    VersionLength = 0;
+                }
+            }
+
+            if (Buffer != NULL) {
+                YoriLibFree(Buffer);
+            }
+            CloseHandle(hFile);
+        }
+    }
+
+    if (LoadVersionThroughSystem) {
+        Version = YoriLibPeLoadVersionThroughSystem(FullPath, &VersionLength);
+    }
+
+    //
+    //  Allocate the metadata along with the version resource and file
+    //  name so they are freed when the last reference is released.  The
+    //  version resource follows the structure, aligned for parsing.
+    //
+
+    VersionOffset = (sizeof(YORILIB_PE_METADATA) + 7) & ~7;
+    AllocationLength = VersionOffset + ((VersionLength + 7) & ~7) + (FullPath->LengthInChars + 1) * sizeof(TCHAR);
+    Metadata = YoriLibReferencedMalloc(AllocationLength);
+    if (Metadata == NULL) {
+        if (Version != NULL) {
+            YoriLibFree(Version);
+        }
+        return NULL;
+    }
+
+    ZeroMemory(Metadata, sizeof(YORILIB_PE_METADATA));
+    Metadata->HeadersValid = HeadersValid;
+    Metadata->VersionLoaded = LoadVersion;
+    memcpy(&Metadata->ImageInfo, &ImageInfo, sizeof(ImageInfo));
+    memcpy(&Metadata->LastWriteTime, &FindData->ftLastWriteTime, sizeof(FILETIME));
+    Metadata->FileSizeHigh = FindData->nFileSizeHigh;
+    Metadata->FileSizeLow = FindData->nFileSizeLow;
+
+    if (Version != NULL) {
+        Metadata->VersionInfo = (PUCHAR)Metadata + VersionOffset;
+        memcpy(Metadata->VersionInfo, Version, VersionLength);
+        YoriLibFree(Version);
+    }
+
+    YoriLibInitEmptyString(&Metadata->FullPath);
+    Metadata->FullPath.StartOfString = (LPTSTR)((PUCHAR)Metadata + VersionOffset + ((VersionLength + 7) & ~7));
+    memcpy(Metadata->FullPath.StartOfString, FullPath->StartOfString, FullPath->LengthInChars * sizeof(TCHAR));
+    Metadata->FullPath.StartOfString[FullPath->LengthInChars] = '\0';
+    Metadata->FullPath.LengthInChars = FullPath->LengthInChars;
+    Metadata->FullPath.LengthAllocated = FullPath->LengthInChars + 1;
+
+    return Metadata;
+}
+
+/**
+ Release a reference to PE metadata returned by @ref YoriLibGetPeMetadata .
+ The reference count is not updated atomically, and the same metadata can
+ be referenced by the cache and collectors on multiple threads, so it is
+ only modified while holding the cache lock.
+
+ @param Metadata Pointer to the metadata to release.
+ */
+VOID
+YoriLibReleasePeMetadata(
+    __in PYORILIB_PE_METADATA Metadata
+    )
+{
+    if (YoriLibPeCacheMutex == NULL) {
+        YoriLibDereference(Metadata);
+        return;
+    }
+
+    WaitForSingleObject(YoriLibPeCacheMutex, INFINITE);
+    YoriLibDereference(Metadata);
+    ReleaseMutex(YoriLibPeCacheMutex);
+}
+
+/**
+ Return the PE metadata for a file, from the cache if it has been collected
+ recently, or by collecting it and adding it to the cache.  Cached metadata
+ is only used if the file's size and last write time are unchanged.
+
+ @param FindData The directory enumeration information.
+
+ @param FullPath Pointer to the full path to the file.
+
+ @param NeedVersion TRUE if the caller needs the version resource, FALSE if
+        it only needs information from the headers.
+
+ @return Pointer to the metadata, which the caller should release with
+         @ref YoriLibReleasePeMetadata, or NULL on allocation failure.
+ */
+PYORILIB_PE_METADATA
+YoriLibGetPeMetadata(
+    __in PWIN32_FIND_DATA FindData,
+    __in PYORI_STRING FullPath,
+    __in BOOL NeedVersion
+    )
+{
+    DWORD Index;
+    DWORD SlotToUse;
+    PYORILIB_PE_METADATA Metadata;
+
+    ASSERT(YoriLibIsStringNullTerminated(FullPath));
+
+    if (NeedVersion) {
+        YoriLibPeCacheLoadVersion = TRUE;
+    }
+
+    if (!YoriLibInitPeMetadataCache()) {
+        return YoriLibCapturePeMetadata(FindData, FullPath, NeedVersion);
+    }
+
+    WaitForSingleObject(YoriLibPeCacheMutex, INFINITE);
+    YoriLibPeCacheUseCount++;
+    for (Index = 0; Index < YORILIB_PE_CACHE_SLOTS; Index++) {
+        Metadata = YoriLibPeCache[Index].Metadata;
+        if (Metadata != NULL &&
+            Metadata->FileSizeHigh == FindData->nFileSizeHigh &&
+            Metadata->FileSizeLow == FindData->nFileSizeLow &&
+            Metadata->LastWriteTime.dwHighDateTime == FindData->ftLastWriteTime.dwHighDateTime &&
+            Metadata->LastWriteTime.dwLowDateTime == FindData->ftLastWriteTime.dwLowDateTime &&
+            YoriLibCompareString(&Metadata->FullPath, FullPath) == 0 &&
+            (Metadata->VersionLoaded || !NeedVersion)) {
+
+            YoriLibPeCache[Index].LastUsed = YoriLibPeCacheUseCount;
+            YoriLibReference(Metadata);
+            ReleaseMutex(YoriLibPeCacheMutex);
+            return Metadata;
+        }
+    }
+    ReleaseMutex(YoriLibPeCacheMutex);
+
+    //
+    //  Collect the metadata without holding the lock so other threads can
+    //  continue while this file is read.
+    //
+
+    Metadata = YoriLibCapturePeMetadata(FindData, FullPath, YoriLibPeCacheLoadVersion);
+    if (Metadata == NULL) {
+        return NULL;
+    }
+
+    //
+    //  Replace any previous metadata for the same file, which may not have
+    //  included the version resource.  Otherwise use an empty slot or the
+    //  least recently used one.
+    //
+
+    WaitForSingleObject(YoriLibPeCacheMutex, INFINITE);
+    SlotToUse = 0;
+    for (Index = 0; Index < YORILIB_PE_CACHE_SLOTS; Index++) {
+        if (YoriLibPeCache[Index].Metadata == NULL ||
+            YoriLibCompareString(&YoriLibPeCache[Index].Metadata->FullPath, FullPath) == 0) {
+
+            SlotToUse = Index;
+            break;
+        }
+        if (YoriLibPeCacheUseCount - YoriLibPeCache[Index].LastUsed >
+            YoriLibPeCacheUseCount - YoriLibPeCache[SlotToUse].LastUsed) {
+
+            SlotToUse = Index;
+        }
+    }
+
+    if (YoriLibPeCache[SlotToUse].Metadata != NULL) {
+        YoriLibDereference(YoriLibPeCache[SlotToUse].Metadata);
+    }
+    YoriLibReference(Metadata);
+    YoriLibPeCache[SlotToUse].Metadata = Metadata;
+    YoriLibPeCache[SlotToUse].LastUsed = YoriLibPeCacheUseCount;
+    ReleaseMutex(YoriLibPeCacheMutex);
+
+    return Metadata;
+}
+
+/**
+ Prepare the cache of metadata from PE images for use.  Applications that
+ collect file information on multiple threads must call this before
+ creating those threads.  Single threaded callers need not call it, since it
+ is performed on first use.
+
+ @return TRUE if the cache can be used, FALSE if it cannot, in which case
+         metadata is collected without caching.
+ */
+BOOL
+YoriLibInitPeMetadataCache()
+{
+    if (YoriLibPeCacheMutex == NULL) {
+        YoriLibPeCacheMutex = CreateMutex(NULL, FALSE, NULL);
+    }
+
+    if (YoriLibPeCacheMutex == NULL) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Free any metadata retained from PE images.  This should be called once
+ an application has finished collecting file information.
+ */
+VOID
+YoriLibFreePeMetadataCache()
+{
+    DWORD Index;
+
+    if (YoriLibPeCacheMutex == NULL) {
+        return;
+    }
+
+    WaitForSingleObject(YoriLibPeCacheMutex, INFINITE);
+    for (Index = 0; Index < YORILIB_PE_CACHE_SLOTS; Index++) {
+        if (YoriLibPeCache[Index].Metadata != NULL) {
+            YoriLibDereference(YoriLibPeCache[Index].Metadata);
+            YoriLibPeCache[Index].Metadata = NULL;
+        }
+    }
+    ReleaseMutex(YoriLibPeCacheMutex);
+    CloseHandle(YoriLibPeCacheMutex);
+    YoriLibPeCacheMutex = NULL;
+}
+
 /**
  Collect information from a directory enumerate and full file name relating
  to the executable's architecture.
@@ -483,18 +1441,19 @@ YoriLibCollectArch (
     __in PYORI_STRING FullPath
     )
 {
-    YORILIB_PE_HEADERS PeHeaders;
+    PYORILIB_PE_METADATA Metadata;
 
     ASSERT(YoriLibIsStringNullTerminated(FullPath));
 
-    UNREFERENCED_PARAMETER(FindData);
-
     Entry->OsVersionHigh = 0;
     Entry->OsVersionLow = 0;
 
-    if (YoriLibCapturePeHeaders(FullPath, &PeHeaders)) {
-
-        Entry->Architecture = PeHeaders.ImageHeader.Machine;
+    Metadata = YoriLibGetPeMetadata(FindData, FullPath, FALSE);
+    if (Metadata != NULL) {
+        if (Metadata->HeadersValid) {
+            Entry->Architecture = Metadata->ImageInfo.Machine;
+        }
+        YoriLibReleasePeMetadata(Metadata);
     }
 
     return TRUE;
@@ -668,28 +1627,23 @@ YoriLibCollectDescription (
 {
     DWORD Junk;
     PVOID Buffer;
-    DWORD VerSize;
     PWORD TranslationBlock;
+    PYORILIB_PE_METADATA Metadata;
 
-    UNREFERENCED_PARAMETER(FindData);
     ASSERT(YoriLibIsStringNullTerminated(FullPath));
 
     Entry->Description[0] = '\0';
 
     YoriLibLoadVersionFunctions();
 
-    if (DllVersion.pGetFileVersionInfoSizeW == NULL ||
-        DllVersion.pGetFileVersionInfoW == NULL ||
-        DllVersion.pVerQueryValueW == NULL) {
-
+    if (DllVersion.pVerQueryValueW == NULL) {
         return TRUE;
     }
 
-    VerSize = DllVersion.pGetFileVersionInfoSizeW(FullPath->StartOfString, &Junk);
-
-    Buffer = YoriLibMalloc(VerSize);
-    if (Buffer != NULL) {
-        if (DllVersion.pGetFileVersionInfoW(FullPath->StartOfString, 0, VerSize, Buffer)) {
+    Metadata = YoriLibGetPeMetadata(FindData, FullPath, TRUE);
+    if (Metadata != NULL) {
+        Buffer = Metadata->VersionInfo;
+        if (Buffer != NULL) {
             TCHAR TranslationBlockString[sizeof("\\VarFileInfo\\Translation")];
 
             //
@@ -714,7 +1668,7 @@ YoriLibCollectDescription (
                 }
             }
         }
-        YoriLibFree(Buffer);
+        YoriLibReleasePeMetadata(Metadata);
     }
     return TRUE;
 }
@@ -1030,28 +1984,23 @@ YoriLibCollectFileVersionString (
 {
     DWORD Junk;
     PVOID Buffer;
-    DWORD VerSize;
     PWORD TranslationBlock;
+    PYORILIB_PE_METADATA Metadata;
 
-    UNREFERENCED_PARAMETER(FindData);
     ASSERT(YoriLibIsStringNullTerminated(FullPath));
 
     Entry->FileVersionString[0] = '\0';
 
     YoriLibLoadVersionFunctions();
 
-    if (DllVersion.pGetFileVersionInfoSizeW == NULL ||
-        DllVersion.pGetFileVersionInfoW == NULL ||
-        DllVersion.pVerQueryValueW == NULL) {
-
+    if (DllVersion.pVerQueryValueW == NULL) {
         return TRUE;
     }
 
-    VerSize = DllVersion.pGetFileVersionInfoSizeW(FullPath->StartOfString, &Junk);
-
-    Buffer = YoriLibMalloc(VerSize);
-    if (Buffer != NULL) {
-        if (DllVersion.pGetFileVersionInfoW(FullPath->StartOfString, 0, VerSize, Buffer)) {
+    Metadata = YoriLibGetPeMetadata(FindData, FullPath, TRUE);
+    if (Metadata != NULL) {
+        Buffer = Metadata->VersionInfo;
+        if (Buffer != NULL) {
             TCHAR TranslationBlockString[sizeof("\\VarFileInfo\\Translation")];
 
             //
@@ -1076,7 +2025,7 @@ YoriLibCollectFileVersionString (
                 }
             }
         }
-        YoriLibFree(Buffer);
+        YoriLibReleasePeMetadata(Metadata);
     }
     return TRUE;
 }
@@ -1276,18 +2225,20 @@ YoriLibCollectOsVersion (
     __in PYORI_STRING FullPath
     )
 {
-    YORILIB_PE_HEADERS PeHeaders;
+    PYORILIB_PE_METADATA Metadata;
 
-    UNREFERENCED_PARAMETER(FindData);
     ASSERT(YoriLibIsStringNullTerminated(FullPath));
 
     Entry->OsVersionHigh = 0;
     Entry->OsVersionLow = 0;
 
-    if (YoriLibCapturePeHeaders(FullPath, &PeHeaders)) {
-
-        Entry->OsVersionHigh = PeHeaders.OptionalHeader.MajorSubsystemVersion;
-        Entry->OsVersionLow = PeHeaders.OptionalHeader.MinorSubsystemVersion;
+    Metadata = YoriLibGetPeMetadata(FindData, FullPath, FALSE);
+    if (Metadata != NULL) {
+        if (Metadata->HeadersValid) {
+            Entry->OsVersionHigh = Metadata->ImageInfo.MajorSubsystemVersion;
+            Entry->OsVersionLow = Metadata->ImageInfo.MinorSubsystemVersion;
+        }
+        YoriLibReleasePeMetadata(Metadata);
     }
 
     return TRUE;
@@ -1442,16 +2393,18 @@ YoriLibCollectSubsystem (
     __in PYORI_STRING FullPath
     )
 {
-    YORILIB_PE_HEADERS PeHeaders;
+    PYORILIB_PE_METADATA Metadata;
 
-    UNREFERENCED_PARAMETER(FindData);
     ASSERT(YoriLibIsStringNullTerminated(FullPath));
 
     Entry->Subsystem = 0;
 
-    if (YoriLibCapturePeHeaders(FullPath, &PeHeaders)) {
-
-        Entry->Subsystem = PeHeaders.OptionalHeader.Subsystem;
+    Metadata = YoriLibGetPeMetadata(FindData, FullPath, FALSE);
+    if (Metadata != NULL) {
+        if (Metadata->HeadersValid) {
+            Entry->Subsystem = Metadata->ImageInfo.Subsystem;
+        }
+        YoriLibReleasePeMetadata(Metadata);
     }
 
     return TRUE;
@@ -1574,10 +2527,9 @@ YoriLibCollectVersion (
 {
     DWORD Junk;
     PVOID Buffer;
-    DWORD VerSize;
     VS_FIXEDFILEINFO * RootBlock;
+    PYORILIB_PE_METADATA Metadata;
 
-    UNREFERENCED_PARAMETER(FindData);
     ASSERT(YoriLibIsStringNullTerminated(FullPath));
 
     Entry->FileVersion.QuadPart = 0;
@@ -1585,18 +2537,14 @@ YoriLibCollectVersion (
 
     YoriLibLoadVersionFunctions();
 
-    if (DllVersion.pGetFileVersionInfoSizeW == NULL ||
-        DllVersion.pGetFileVersionInfoW == NULL ||
-        DllVersion.pVerQueryValueW == NULL) {
-
+    if (DllVersion.pVerQueryValueW == NULL) {
         return TRUE;
     }
 
-    VerSize = DllVersion.pGetFileVersionInfoSizeW(FullPath->StartOfString, &Junk);
-
-    Buffer = YoriLibMalloc(VerSize);
-    if (Buffer != NULL) {
-        if (DllVersion.pGetFileVersionInfoW(FullPath->StartOfString, 0, VerSize, Buffer)) {
+    Metadata = YoriLibGetPeMetadata(FindData, FullPath, TRUE);
+    if (Metadata != NULL) {
+        Buffer = Metadata->VersionInfo;
+        if (Buffer != NULL) {
             TCHAR BlockString[sizeof("\\")];
 
             //
@@ -1611,7 +2559,7 @@ YoriLibCollectVersion (
                 Entry->FileVersionFlags = RootBlock->dwFileFlags & RootBlock->dwFileFlagsMask;
             }
         }
-        YoriLibFree(Buffer);
+        YoriLibReleasePeMetadata(Metadata);
     }
     return TRUE;
 }
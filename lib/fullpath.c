@@ -964,112 +964,66 @@ YoriLibFullPathNormalize(
 }
 
 /**
- Take a combined string that contains a full path, convert all forward slashes
- to backslashes, remove any "\.\" components, remove any "\blah\..\"
- components up to the effective root of the path, and optionally return the
- part of the path that contains the final file component.
-
- @param Buffer Pointer to a string which contains a full path that may still
-        have . or .. components.
-
- @param PathType Pointer to information describing the type of path.
-
- @param ReturnEscapedPath If TRUE, the path to return should be in a "\\?\"
-        prefixed form.
-
- @param lpFilePart If specified, on successful completion, updated to point
-        to the beginning of the file name component of the path, in the same
-        allocation as lpBuffer.
-
- @return A win32 error code, including ERROR_SUCCESS to indicate successful
-         completion.
+ Remove duplicate seperators, "\.\" components and "\blah\..\" components
+ from a full path which has already had forward slashes converted to
+ backslashes, and optionally return the part of the path that contains the
+ final file component.  Everything in the buffer before StartOffset is
+ assumed to already be in this form, which allows a caller that appended a
+ child to an already processed parent to only process the child.
+
+ @param Buffer Pointer to a NULL terminated string containing the full path.
+        This is modified in place.
+
+ @param EffectiveRootLength The number of characters in the buffer that
+        form the root of the path which cannot be traversed above.  This must
+        be less than the length of the string.
+
+ @param StartOffset The offset within the buffer to commence processing.
+        This must be at least EffectiveRootLength.
+
+ @param lpFilePart If specified, on completion, updated to point to the
+        beginning of the file name component of the path, in the same
+        allocation as Buffer.
  */
-DWORD
-YoriLibGetFullPathSquashRelativeComponents(
+VOID
+YoriLibGetFullPathSquashFrom(
     __inout PYORI_STRING Buffer,
-    __in PYORI_LIB_FULL_PATH_TYPE PathType,
-    __in BOOL ReturnEscapedPath,
+    __in DWORD EffectiveRootLength,
+    __in DWORD StartOffset,
     __deref_opt_out LPTSTR* lpFilePart
     )
 {
-
-    DWORD Result;
     LPTSTR EffectiveRoot;
-    YORI_STRING EffectiveRootSubstring;
     LPTSTR CurrentReadChar;
     LPTSTR CurrentWriteChar;
     BOOLEAN PreviousWasSeperator;
 
-    //
-    //  Convert forward slashes to backslashes across the entire path
-    //
-
-    for (Result = 0; Result < Buffer->LengthInChars; Result++) {
-
-        if (Buffer->StartOfString[Result] == '/') {
-            Buffer->StartOfString[Result] = '\\';
-        }
-    }
-
-    //
-    //  At this point we should have an allocated, "absolute" name.  We still
-    //  need to process relative components, and as we do so, there's a point
-    //  we can't traverse back through.  Eg. we don't do relative paths
-    //  before \\?\X:\ or \\?\UNC\server\share.
-    //
-
-    if (ReturnEscapedPath) {
-        if (YoriLibIsFullPathUnc(Buffer)) {
-            PathType->Flags.UncPath = TRUE;
-        } else {
-            PathType->Flags.UncPath = FALSE;
-        }
-    } else {
-        if (Buffer->StartOfString[0] == '\\' && Buffer->StartOfString[1] == '\\') {
-            PathType->Flags.UncPath = TRUE;
-        } else {
-            PathType->Flags.UncPath = FALSE;
-        }
-    }
-
-    if (!YoriLibFindEffectiveRootInternal(Buffer, ReturnEscapedPath, PathType->Flags.UncPath, &EffectiveRootSubstring)) {
-        return ERROR_BAD_PATHNAME;
-    }
-
-    //
-    //  If the root is the whole string, there are no more operations we
-    //  can perform, so return.
-    //
-
-    if (EffectiveRootSubstring.LengthInChars == Buffer->LengthInChars) {
-        if (lpFilePart != NULL) {
-            *lpFilePart = NULL;
-        }
-        ASSERT(Buffer->StartOfString[Buffer->LengthInChars] == '\0');
-        return ERROR_SUCCESS;
-    }
+    ASSERT(EffectiveRootLength < Buffer->LengthInChars);
+    ASSERT(StartOffset >= EffectiveRootLength && StartOffset <= Buffer->LengthInChars);
+    ASSERT(Buffer->StartOfString[Buffer->LengthInChars] == '\0');
 
     //
-    //  Check if the effective root ends with a backslash or not.
+    //  Check if the text preceding the starting point ends with a
+    //  backslash or not.
     //
 
     PreviousWasSeperator = FALSE;
-    if (EffectiveRootSubstring.LengthInChars > 0 &&
-        EffectiveRootSubstring.StartOfString[EffectiveRootSubstring.LengthInChars - 1] == '\\') {
+    if (StartOffset > 0 &&
+        Buffer->StartOfString[StartOffset - 1] == '\\') {
 
         PreviousWasSeperator = TRUE;
     }
 
-    EffectiveRoot = &EffectiveRootSubstring.StartOfString[EffectiveRootSubstring.LengthInChars];
+    EffectiveRoot = &Buffer->StartOfString[EffectiveRootLength];
 
     //
     //  Now process the path to remove duplicate slashes, remove .
     //  components, and process .. components.
     //
 
-    CurrentWriteChar = EffectiveRoot;
+    CurrentWriteChar = &Buffer->StartOfString[StartOffset];
 
-    for (CurrentReadChar = EffectiveRoot; *CurrentReadChar != '\0'; CurrentReadChar++) {
+    for (CurrentReadChar = CurrentWriteChar; *CurrentReadChar != '\0'; CurrentReadChar++) {
 
         //
         //  Strip duplicate backslashes
@@ -1198,6 +1152,91 @@ YoriLibGetFullPathSquashRelativeComponents(
     if (lpFilePart != NULL) {
         *lpFilePart = CurrentWriteChar;
     }
+}
+
+/**
+ Take a combined string that contains a full path, convert all forward slashes
+ to backslashes, remove any "\.\" components, remove any "\blah\..\"
+ components up to the effective root of the path, and optionally return the
+ part of the path that contains the final file component.
+
+ @param Buffer Pointer to a string which contains a full path that may still
+        have . or .. components.
+
+ @param PathType Pointer to information describing the type of path.
+
+ @param ReturnEscapedPath If TRUE, the path to return should be in a "\\?\"
+        prefixed form.
+
+ @param lpFilePart If specified, on successful completion, updated to point
+        to the beginning of the file name component of the path, in the same
+        allocation as lpBuffer.
+
+ @return A win32 error code, including ERROR_SUCCESS to indicate successful
+         completion.
+ */
+DWORD
+YoriLibGetFullPathSquashRelativeComponents(
+    __inout PYORI_STRING Buffer,
+    __in PYORI_LIB_FULL_PATH_TYPE PathType,
+    __in BOOL ReturnEscapedPath,
+    __deref_opt_out LPTSTR* lpFilePart
+    )
+{
+
+    DWORD Result;
+    YORI_STRING EffectiveRootSubstring;
+
+    //
+    //  Convert forward slashes to backslashes across the entire path
+    //
+
+    for (Result = 0; Result < Buffer->LengthInChars; Result++) {
+
+        if (Buffer->StartOfString[Result] == '/') {
+            Buffer->StartOfString[Result] = '\\';
+        }
+    }
+
+    //
+    //  At this point we should have an allocated, "absolute" name.  We still
+    //  need to process relative components, and as we do so, there's a point
+    //  we can't traverse back through.  Eg. we don't do relative paths
+    //  before \\?\X:\ or \\?\UNC\server\share.
+    //
+
+    if (ReturnEscapedPath) {
+        if (YoriLibIsFullPathUnc(Buffer)) {
+            PathType->Flags.UncPath = TRUE;
+        } else {
+            PathType->Flags.UncPath = FALSE;
+        }
+    } else {
+        if (Buffer->StartOfString[0] == '\\' && Buffer->StartOfString[1] == '\\') {
+            PathType->Flags.UncPath = TRUE;
+        } else {
+            PathType->Flags.UncPath = FALSE;
+        }
+    }
+
+    if (!YoriLibFindEffectiveRootInternal(Buffer, ReturnEscapedPath, PathType->Flags.UncPath, &EffectiveRootSubstring)) {
+        return ERROR_BAD_PATHNAME;
+    }
+
+    //
+    //  If the root is the whole string, there are no more operations we
+    //  can perform, so return.
+    //
+
+    if (EffectiveRootSubstring.LengthInChars == Buffer->LengthInChars) {
+        if (lpFilePart != NULL) {
+            *lpFilePart = NULL;
+        }
+        ASSERT(Buffer->StartOfString[Buffer->LengthInChars] == '\0');
+        return ERROR_SUCCESS;
+    }
+
+    YoriLibGetFullPathSquashFrom(Buffer, EffectiveRootSubstring.LengthInChars, EffectiveRootSubstring.LengthInChars, lpFilePart);
 
     return ERROR_SUCCESS;
 }
@@ -1467,6 +1506,190 @@ YoriLibGetFullPathNameRelativeTo(
 }
 
 
+/**
+ Prepare to resolve many child names against a single parent directory.  The
+ parent must already be a full path in the form returned by
+ @ref YoriLibGetFullPathNameReturnAllocation , either escaped or not.  The
+ classification of the parent, which would otherwise be repeated for every
+ child, is performed once here.  This function does not allocate memory.
+
+ @param ParentPath Pointer to the full path of the parent directory.  The
+        context refers to this string, so it must remain valid for as long
+        as the context is used.
+
+ @param Parent On successful completion, populated with information about
+        the parent that can be used with @ref YoriLibFullPathResolveChild .
+
+ @return TRUE to indicate success, FALSE if the parent is not a full path.
+ */
+BOOL
+YoriLibFullPathInitializeParent(
+    __in PYORI_STRING ParentPath,
+    __out PYORI_LIB_FULL_PATH_PARENT Parent
+    )
+{
+    YORI_STRING EffectiveRoot;
+
+    YoriLibInitEmptyString(&Parent->Path);
+    Parent->Path.StartOfString = ParentPath->StartOfString;
+    Parent->Path.LengthInChars = ParentPath->LengthInChars;
+    Parent->PathHasPrefix = FALSE;
+    Parent->PathIsUnc = FALSE;
+    Parent->EffectiveRootLength = YORI_LIB_FULL_PATH_ROOT_PER_CHILD;
+
+    //
+    //  Classify the parent the same way as
+    //  YoriLibGetFullPathSquashRelativeComponents would classify the
+    //  combined string.
+    //
+
+    if (YoriLibIsPathPrefixed(ParentPath)) {
+        Parent->PathHasPrefix = TRUE;
+        if (YoriLibIsFullPathUnc(ParentPath)) {
+            Parent->PathIsUnc = TRUE;
+        }
+    } else if (ParentPath->LengthInChars >= 2 &&
+               ParentPath->StartOfString[0] == '\\' &&
+               ParentPath->StartOfString[1] == '\\') {
+
+        Parent->PathIsUnc = TRUE;
+    } else if (!YoriLibIsDriveLetterWithColon(ParentPath)) {
+        SetLastError(ERROR_BAD_PATHNAME);
+        return FALSE;
+    }
+
+    //
+    //  If the root ends before the end of the parent, appending a child
+    //  can't change it.  If the parent is entirely root, such as "C:" or
+    //  "\\server\share", the root depends on what follows, so it is found
+    //  for each child.
+    //
+
+    if (YoriLibFindEffectiveRootInternal(ParentPath, Parent->PathHasPrefix, Parent->PathIsUnc, &EffectiveRoot) &&
+        EffectiveRoot.LengthInChars < ParentPath->LengthInChars) {
+
+        Parent->EffectiveRootLength = EffectiveRoot.LengthInChars;
+    }
+
+    return TRUE;
+}
+
+/**
+ Resolve a relative child name against a parent directory prepared with
+ @ref YoriLibFullPathInitializeParent , generating the same result as
+ calling @ref YoriLibGetFullPathNameReturnAllocation on the parent, a
+ seperator and the child, in the same form as the parent.  Only the child
+ is processed for "." and ".." components.  This function does not
+ allocate memory; the caller provides the buffer, which may be part of a
+ larger allocation.
+
+ @param Parent Pointer to the prepared parent directory.
+
+ @param ChildName Pointer to the relative name to append to the parent.  This
+        must not begin with a seperator or drive letter.  If empty, the
+        parent is returned.
+
+ @param Buffer Pointer to a string with LengthAllocated and StartOfString
+        describing the buffer to populate.  On successful completion,
+        LengthInChars is updated and the result is NULL terminated.
+
+ @param lpFilePart If specified, on successful completion, updated to point
+        to the beginning of the file name component of the path, in the same
+        allocation as Buffer.
+
+ @return TRUE to indicate success, FALSE to indicate failure.  On failure,
+         ERROR_INSUFFICIENT_BUFFER indicates the buffer is too small, and
+         ERROR_BAD_PATHNAME indicates the child was not a relative name.
+ */
+BOOL
+YoriLibFullPathResolveChild(
+    __in PYORI_LIB_FULL_PATH_PARENT Parent,
+    __in PYORI_STRING ChildName,
+    __inout PYORI_STRING Buffer,
+    __deref_opt_out LPTSTR* lpFilePart
+    )
+{
+    DWORD Index;
+    DWORD CharIndex;
+    DWORD StartOffset;
+    DWORD EffectiveRootLength;
+    YORI_STRING EffectiveRoot;
+
+    if (ChildName->LengthInChars > 0 &&
+        (YoriLibIsSep(ChildName->StartOfString[0]) ||
+         YoriLibIsDriveLetterWithColon(ChildName))) {
+
+        SetLastError(ERROR_BAD_PATHNAME);
+        return FALSE;
+    }
+
+    Index = Parent->Path.LengthInChars;
+    if (ChildName->LengthInChars > 0) {
+        Index = Index + 1 + ChildName->LengthInChars;
+    }
+
+    if (Index >= Buffer->LengthAllocated) {
+        SetLastError(ERROR_INSUFFICIENT_BUFFER);
+        return FALSE;
+    }
+
+    //
+    //  Construct parent, seperator and child, converting forward slashes
+    //  in the child.  The parent has already been converted.
+    //
+
+    memcpy(Buffer->StartOfString, Parent->Path.StartOfString, Parent->Path.LengthInChars * sizeof(TCHAR));
+    Index = Parent->Path.LengthInChars;
+    if (ChildName->LengthInChars > 0) {
+        Buffer->StartOfString[Index] = '\\';
+        Index++;
+        for (CharIndex = 0; CharIndex < ChildName->LengthInChars; CharIndex++) {
+            if (ChildName->StartOfString[CharIndex] == '/') {
+                Buffer->StartOfString[Index] = '\\';
+            } else {
+                Buffer->StartOfString[Index] = ChildName->StartOfString[CharIndex];
+            }
+            Index++;
+        }
+    }
+    Buffer->StartOfString[Index] = '\0';
+    Buffer->LengthInChars = Index;
+
+    EffectiveRootLength = Parent->EffectiveRootLength;
+    if (EffectiveRootLength == YORI_LIB_FULL_PATH_ROOT_PER_CHILD) {
+        if (!YoriLibFindEffectiveRootInternal(Buffer, Parent->PathHasPrefix, Parent->PathIsUnc, &EffectiveRoot)) {
+            SetLastError(ERROR_BAD_PATHNAME);
+            return FALSE;
+        }
+        EffectiveRootLength = EffectiveRoot.LengthInChars;
+    }
+
+    //
+    //  If the root is the whole string, there are no more operations we
+    //  can perform, so return.
+    //
+
+    if (EffectiveRootLength == Buffer->LengthInChars) {
+        if (lpFilePart != NULL) {
+            *lpFilePart = NULL;
+        }
+        return TRUE;
+    }
+
+    //
+    //  The parent is already in final form, so only the child needs to be
+    //  processed.
+    //
+
+    StartOffset = Parent->Path.LengthInChars;
+    if (StartOffset < EffectiveRootLength) {
+        StartOffset = EffectiveRootLength;
+    }
+
+    YoriLibGetFullPathSquashFrom(Buffer, EffectiveRootLength, StartOffset, lpFilePart);
+    return TRUE;
+}
+
 /**
  Convert a specified shell folder, by a known folder GUID, into its string
  form.  This function is only available in Vista+.
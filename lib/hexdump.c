@@ -27,10 +27,18 @@
 #include "yoripch.h"
 #include "yorilib.h"
 
+/**
+ The number of characters to allocate for the text of a single word,
+ including any highlighting escapes.
+ */
+#define YORI_LIB_HEXDUMP_WORD_TEXT_LENGTH (32)
+
 /**
  Display a line of up to YORI_LIB_HEXDUMP_BYTES_PER_LINE in units of one
  UCHAR.
 
+ @param OutputBuffer Pointer to the buffered output stream to write to.
+
  @param Buffer Pointer to the start of the buffer.
 
  @param BytesToDisplay Number of bytes to display, can be equal to or less
@@ -47,6 +55,7 @@
  */
 BOOL
 YoriLibHexByteLine(
+    __inout PYORI_LIB_OUTPUT_BUFFER OutputBuffer,
     __in UCHAR CONST * Buffer,
     __in DWORD BytesToDisplay,
     __in DWORD HilightBits,
@@ -58,15 +67,36 @@ YoriLibHexByteLine(
     BOOL DisplayWord;
     DWORD ByteIndex;
     DWORD CurrentBit = (0x1 << (YORI_LIB_HEXDUMP_BYTES_PER_LINE - sizeof(WordToDisplay)));
+    PYORI_LIB_PRINTF_FORMAT WordFormat;
+    YORI_STRING WordText;
+    TCHAR WordTextBuffer[YORI_LIB_HEXDUMP_WORD_TEXT_LENGTH];
 
     if (BytesToDisplay > YORI_LIB_HEXDUMP_BYTES_PER_LINE) {
         return FALSE;
     }
 
+    //
+    //  Parse the format for each word once, rather than for every word on
+    //  the line.  The text for a word always fits in a stack buffer.
+    //
+
+    if (HilightBits) {
+        WordFormat = YoriLibPrintfCompileFormat(_T("%c[0%sm%02x%c[0m "));
+    } else {
+        WordFormat = YoriLibPrintfCompileFormat(_T("%02x "));
+    }
+    if (WordFormat == NULL) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&WordText);
+    WordText.StartOfString = WordTextBuffer;
+    WordText.LengthAllocated = sizeof(WordTextBuffer) / sizeof(WordTextBuffer[0]);
+
     for (WordIndex = 0; WordIndex < YORI_LIB_HEXDUMP_BYTES_PER_LINE / sizeof(WordToDisplay); WordIndex++) {
 
         if (DisplaySeperator && WordIndex == YORI_LIB_HEXDUMP_BYTES_PER_LINE / (sizeof(WordToDisplay) * 2)) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T(": "));
+            YoriLibOutputBuffered(OutputBuffer, _T(": "));
         }
 
         WordToDisplay = 0;
@@ -81,24 +111,27 @@ YoriLibHexByteLine(
 
         if (DisplayWord) {
             if (HilightBits) {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
-                              _T("%c[0%sm%02x%c[0m "),
-                              27,
-                              (HilightBits & CurrentBit)?_T(";1"):_T(""),
-                              WordToDisplay,
-                              27);
+                YoriLibYPrintfCompiled(&WordText,
+                                       WordFormat,
+                                       27,
+                                       (HilightBits & CurrentBit)?_T(";1"):_T(""),
+                                       WordToDisplay,
+                                       27);
             } else {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
-                              _T("%02x "),
-                              WordToDisplay);
+                YoriLibYPrintfCompiled(&WordText,
+                                       WordFormat,
+                                       WordToDisplay);
             }
+            YoriLibOutputBufferString(OutputBuffer, &WordText);
         } else {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("   "));
+            YoriLibOutputBuffered(OutputBuffer, _T("   "));
         }
 
         CurrentBit = CurrentBit >> sizeof(WordToDisplay);
     }
 
+    YoriLibPrintfFreeFormat(WordFormat);
+    YoriLibFreeStringContents(&WordText);
     return TRUE;
 }
 
@@ -106,6 +139,8 @@ YoriLibHexByteLine(
  Display a line of up to YORI_LIB_HEXDUMP_BYTES_PER_LINE in units of one
  WORD.
 
+ @param OutputBuffer Pointer to the buffered output stream to write to.
+
  @param Buffer Pointer to the start of the buffer.
 
  @param BytesToDisplay Number of bytes to display, can be equal to or less
@@ -122,6 +157,7 @@ YoriLibHexByteLine(
  */
 BOOL
 YoriLibHexWordLine(
+    __inout PYORI_LIB_OUTPUT_BUFFER OutputBuffer,
     __in UCHAR CONST * Buffer,
     __in DWORD BytesToDisplay,
     __in DWORD HilightBits,
@@ -133,15 +169,36 @@ YoriLibHexWordLine(
     BOOL DisplayWord;
     DWORD ByteIndex;
     DWORD CurrentBit = (0x3 << (YORI_LIB_HEXDUMP_BYTES_PER_LINE - sizeof(WordToDisplay)));
+    PYORI_LIB_PRINTF_FORMAT WordFormat;
+    YORI_STRING WordText;
+    TCHAR WordTextBuffer[YORI_LIB_HEXDUMP_WORD_TEXT_LENGTH];
 
     if (BytesToDisplay > YORI_LIB_HEXDUMP_BYTES_PER_LINE) {
         return FALSE;
     }
 
+    //
+    //  Parse the format for each word once, rather than for every word on
+    //  the line.  The text for a word always fits in a stack buffer.
+    //
+
+    if (HilightBits) {
+        WordFormat = YoriLibPrintfCompileFormat(_T("%c[0%sm%04x%c[0m "));
+    } else {
+        WordFormat = YoriLibPrintfCompileFormat(_T("%04x "));
+    }
+    if (WordFormat == NULL) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&WordText);
+    WordText.StartOfString = WordTextBuffer;
+    WordText.LengthAllocated = sizeof(WordTextBuffer) / sizeof(WordTextBuffer[0]);
+
     for (WordIndex = 0; WordIndex < YORI_LIB_HEXDUMP_BYTES_PER_LINE / sizeof(WordToDisplay); WordIndex++) {
 
         if (DisplaySeperator && WordIndex == YORI_LIB_HEXDUMP_BYTES_PER_LINE / (sizeof(WordToDisplay) * 2)) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T(": "));
+            YoriLibOutputBuffered(OutputBuffer, _T(": "));
         }
 
         WordToDisplay = 0;
@@ -156,24 +213,27 @@ YoriLibHexWordLine(
 
         if (DisplayWord) {
             if (HilightBits) {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
-                              _T("%c[0%sm%04x%c[0m "),
-                              27,
-                              (HilightBits & CurrentBit)?_T(";1"):_T(""),
-                              WordToDisplay,
-                              27);
+                YoriLibYPrintfCompiled(&WordText,
+                                       WordFormat,
+                                       27,
+                                       (HilightBits & CurrentBit)?_T(";1"):_T(""),
+                                       WordToDisplay,
+                                       27);
             } else {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
-                              _T("%04x "),
-                              WordToDisplay);
+                YoriLibYPrintfCompiled(&WordText,
+                                       WordFormat,
+                                       WordToDisplay);
             }
+            YoriLibOutputBufferString(OutputBuffer, &WordText);
         } else {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("     "));
+            YoriLibOutputBuffered(OutputBuffer, _T("     "));
         }
 
         CurrentBit = CurrentBit >> sizeof(WordToDisplay);
     }
 
+    YoriLibPrintfFreeFormat(WordFormat);
+    YoriLibFreeStringContents(&WordText);
     return TRUE;
 }
 
@@ -182,6 +242,8 @@ YoriLibHexWordLine(
  Display a line of up to YORI_LIB_HEXDUMP_BYTES_PER_LINE in units of one
  DWORD.
 
+ @param OutputBuffer Pointer to the buffered output stream to write to.
+
  @param Buffer Pointer to the start of the buffer.
 
  @param BytesToDisplay Number of bytes to display, can be equal to or less
@@ -198,6 +260,7 @@ YoriLibHexWordLine(
  */
 BOOL
 YoriLibHexDwordLine(
+    __inout PYORI_LIB_OUTPUT_BUFFER OutputBuffer,
     __in UCHAR CONST * Buffer,
     __in DWORD BytesToDisplay,
     __in DWORD HilightBits,
@@ -209,15 +272,36 @@ YoriLibHexDwordLine(
     BOOL DisplayWord;
     DWORD ByteIndex;
     DWORD CurrentBit = (0xf << (YORI_LIB_HEXDUMP_BYTES_PER_LINE - sizeof(WordToDisplay)));
+    PYORI_LIB_PRINTF_FORMAT WordFormat;
+    YORI_STRING WordText;
+    TCHAR WordTextBuffer[YORI_LIB_HEXDUMP_WORD_TEXT_LENGTH];
 
     if (BytesToDisplay > YORI_LIB_HEXDUMP_BYTES_PER_LINE) {
         return FALSE;
     }
 
+    //
+    //  Parse the format for each word once, rather than for every word on
+    //  the line.  The text for a word always fits in a stack buffer.
+    //
+
+    if (HilightBits) {
+        WordFormat = YoriLibPrintfCompileFormat(_T("%c[0%sm%08x%c[0m "));
+    } else {
+        WordFormat = YoriLibPrintfCompileFormat(_T("%08x "));
+    }
+    if (WordFormat == NULL) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&WordText);
+    WordText.StartOfString = WordTextBuffer;
+    WordText.LengthAllocated = sizeof(WordTextBuffer) / sizeof(WordTextBuffer[0]);
+
     for (WordIndex = 0; WordIndex < YORI_LIB_HEXDUMP_BYTES_PER_LINE / sizeof(WordToDisplay); WordIndex++) {
 
         if (DisplaySeperator && WordIndex == YORI_LIB_HEXDUMP_BYTES_PER_LINE / (sizeof(WordToDisplay) * 2)) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T(": "));
+            YoriLibOutputBuffered(OutputBuffer, _T(": "));
         }
 
         WordToDisplay = 0;
@@ -232,24 +316,27 @@ YoriLibHexDwordLine(
 
         if (DisplayWord) {
             if (HilightBits) {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
-                              _T("%c[0%sm%08x%c[0m "),
-                              27,
-                              (HilightBits & CurrentBit)?_T(";1"):_T(""),
-                              WordToDisplay,
-                              27);
+                YoriLibYPrintfCompiled(&WordText,
+                                       WordFormat,
+                                       27,
+                                       (HilightBits & CurrentBit)?_T(";1"):_T(""),
+                                       WordToDisplay,
+                                       27);
             } else {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
-                              _T("%08x "),
-                              WordToDisplay);
+                YoriLibYPrintfCompiled(&WordText,
+                                       WordFormat,
+                                       WordToDisplay);
             }
+            YoriLibOutputBufferString(OutputBuffer, &WordText);
         } else {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("         "));
+            YoriLibOutputBuffered(OutputBuffer, _T("         "));
         }
 
         CurrentBit = CurrentBit >> sizeof(WordToDisplay);
     }
 
+    YoriLibPrintfFreeFormat(WordFormat);
+    YoriLibFreeStringContents(&WordText);
     return TRUE;
 }
 
@@ -257,6 +344,8 @@ YoriLibHexDwordLine(
  Display a line of up to YORI_LIB_HEXDUMP_BYTES_PER_LINE in units of one
  DWORDLONG.
 
+ @param OutputBuffer Pointer to the buffered output stream to write to.
+
  @param Buffer Pointer to the start of the buffer.
 
  @param BytesToDisplay Number of bytes to display, can be equal to or less
@@ -273,6 +362,7 @@ YoriLibHexDwordLine(
  */
 BOOL
 YoriLibHexDwordLongLine(
+    __inout PYORI_LIB_OUTPUT_BUFFER OutputBuffer,
     __in UCHAR CONST * Buffer,
     __in DWORD BytesToDisplay,
     __in DWORD HilightBits,
@@ -284,15 +374,36 @@ YoriLibHexDwordLongLine(
     BOOL DisplayWord;
     DWORD ByteIndex;
     DWORD CurrentBit = (0xff << (YORI_LIB_HEXDUMP_BYTES_PER_LINE - sizeof(WordToDisplay)));
+    PYORI_LIB_PRINTF_FORMAT WordFormat;
+    YORI_STRING WordText;
+    TCHAR WordTextBuffer[YORI_LIB_HEXDUMP_WORD_TEXT_LENGTH];
 
     if (BytesToDisplay > YORI_LIB_HEXDUMP_BYTES_PER_LINE) {
         return FALSE;
     }
 
+    //
+    //  Parse the format for each word once, rather than for every word on
+    //  the line.  The text for a word always fits in a stack buffer.
+    //
+
+    if (HilightBits) {
+        WordFormat = YoriLibPrintfCompileFormat(_T("%c[0%sm%08x`%08x%c[0m "));
+    } else {
+        WordFormat = YoriLibPrintfCompileFormat(_T("%08x`%08x "));
+    }
+    if (WordFormat == NULL) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&WordText);
+    WordText.StartOfString = WordTextBuffer;
+    WordText.LengthAllocated = sizeof(WordTextBuffer) / sizeof(WordTextBuffer[0]);
+
     for (WordIndex = 0; WordIndex < YORI_LIB_HEXDUMP_BYTES_PER_LINE / sizeof(WordToDisplay); WordIndex++) {
 
         if (DisplaySeperator && WordIndex == YORI_LIB_HEXDUMP_BYTES_PER_LINE / (sizeof(WordToDisplay) * 2)) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T(": "));
+            YoriLibOutputBuffered(OutputBuffer, _T(": "));
         }
 
         WordToDisplay = 0;
@@ -309,25 +420,28 @@ YoriLibHexDwordLongLine(
             LARGE_INTEGER DisplayValue;
             DisplayValue.QuadPart = WordToDisplay;
             if (HilightBits) {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
-                              _T("%c[0%sm%08x`%08x%c[0m "),
-                              27,
-                              (HilightBits & CurrentBit)?_T(";1"):_T(""),
-                              DisplayValue.HighPart,
-                              DisplayValue.LowPart,
-                              27);
+                YoriLibYPrintfCompiled(&WordText,
+                                       WordFormat,
+                                       27,
+                                       (HilightBits & CurrentBit)?_T(";1"):_T(""),
+                                       DisplayValue.HighPart,
+                                       DisplayValue.LowPart,
+                                       27);
             } else {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
-                              _T("%08x`%08x "),
-                              DisplayValue.HighPart,
-                              DisplayValue.LowPart);
+                YoriLibYPrintfCompiled(&WordText,
+                                       WordFormat,
+                                       DisplayValue.HighPart,
+                                       DisplayValue.LowPart);
             }
+            YoriLibOutputBufferString(OutputBuffer, &WordText);
         } else {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("                  "));
+            YoriLibOutputBuffered(OutputBuffer, _T("                  "));
         }
         CurrentBit = CurrentBit >> sizeof(WordToDisplay);
     }
 
+    YoriLibPrintfFreeFormat(WordFormat);
+    YoriLibFreeStringContents(&WordText);
     return TRUE;
 }
 
@@ -364,11 +478,24 @@ YoriLibHexDump(
     DWORD BytesToDisplay;
     CHAR CharToDisplay;
     LARGE_INTEGER DisplayBufferOffset;
+    YORI_LIB_OUTPUT_BUFFER Output;
+    PYORI_LIB_OUTPUT_BUFFER OutputBuffer;
 
     if (BytesPerWord != 1 && BytesPerWord != 2 && BytesPerWord != 4 && BytesPerWord != 8) {
         return FALSE;
     }
 
+    //
+    //  Each line is composed of many small fields.  Accumulate them so the
+    //  device sees a small number of large writes.
+    //
+
+    OutputBuffer = &Output;
+    if (!YoriLibOutputBufferInitialize(OutputBuffer, YORI_LIB_OUTPUT_STDOUT)) {
+        YoriLibOutputBufferCleanup(OutputBuffer);
+        return FALSE;
+    }
+
     DisplayBufferOffset.QuadPart = StartOfBufferOffset;
 
     for (LineIndex = 0; LineIndex < LineCount; LineIndex++) {
@@ -379,10 +506,10 @@ YoriLibHexDump(
         //
 
         if (DumpFlags & YORI_LIB_HEX_FLAG_DISPLAY_LARGE_OFFSET) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%08x`%08x: "), DisplayBufferOffset.HighPart, DisplayBufferOffset.LowPart);
+            YoriLibOutputBuffered(OutputBuffer, _T("%08x`%08x: "), DisplayBufferOffset.HighPart, DisplayBufferOffset.LowPart);
             DisplayBufferOffset.QuadPart += YORI_LIB_HEXDUMP_BYTES_PER_LINE;
         } else if (DumpFlags & YORI_LIB_HEX_FLAG_DISPLAY_OFFSET) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%08x: "), DisplayBufferOffset.LowPart);
+            YoriLibOutputBuffered(OutputBuffer, _T("%08x: "), DisplayBufferOffset.LowPart);
             DisplayBufferOffset.QuadPart += YORI_LIB_HEXDUMP_BYTES_PER_LINE;
         }
 
@@ -400,13 +527,13 @@ YoriLibHexDump(
         //
 
         if (BytesPerWord == 1) {
-            YoriLibHexByteLine((CONST UCHAR *)&Buffer[LineIndex * YORI_LIB_HEXDUMP_BYTES_PER_LINE], BytesToDisplay, 0, FALSE);
+            YoriLibHexByteLine(OutputBuffer, (CONST UCHAR *)&Buffer[LineIndex * YORI_LIB_HEXDUMP_BYTES_PER_LINE], BytesToDisplay, 0, FALSE);
         } else if (BytesPerWord == 2) {
-            YoriLibHexWordLine((CONST UCHAR *)&Buffer[LineIndex * YORI_LIB_HEXDUMP_BYTES_PER_LINE], BytesToDisplay, 0, FALSE);
+            YoriLibHexWordLine(OutputBuffer, (CONST UCHAR *)&Buffer[LineIndex * YORI_LIB_HEXDUMP_BYTES_PER_LINE], BytesToDisplay, 0, FALSE);
         } else if (BytesPerWord == 4) {
-            YoriLibHexDwordLine((CONST UCHAR *)&Buffer[LineIndex * YORI_LIB_HEXDUMP_BYTES_PER_LINE], BytesToDisplay, 0, FALSE);
+            YoriLibHexDwordLine(OutputBuffer, (CONST UCHAR *)&Buffer[LineIndex * YORI_LIB_HEXDUMP_BYTES_PER_LINE], BytesToDisplay, 0, FALSE);
         } else if (BytesPerWord == 8) {
-            YoriLibHexDwordLongLine((CONST UCHAR *)&Buffer[LineIndex * YORI_LIB_HEXDUMP_BYTES_PER_LINE], BytesToDisplay, 0, FALSE);
+            YoriLibHexDwordLongLine(OutputBuffer, (CONST UCHAR *)&Buffer[LineIndex * YORI_LIB_HEXDUMP_BYTES_PER_LINE], BytesToDisplay, 0, FALSE);
         }
 
         //
@@ -415,7 +542,7 @@ YoriLibHexDump(
         //
 
         if (DumpFlags & YORI_LIB_HEX_FLAG_DISPLAY_CHARS) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T(" "));
+            YoriLibOutputBuffered(OutputBuffer, _T(" "));
             for (WordIndex = 0; WordIndex < YORI_LIB_HEXDUMP_BYTES_PER_LINE; WordIndex++) {
                 if (WordIndex < BytesToDisplay) {
                     CharToDisplay = Buffer[LineIndex * YORI_LIB_HEXDUMP_BYTES_PER_LINE + WordIndex];
@@ -425,13 +552,14 @@ YoriLibHexDump(
                 } else {
                     CharToDisplay = ' ';
                 }
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%c"), CharToDisplay);
+                YoriLibOutputBuffered(OutputBuffer, _T("%c"), CharToDisplay);
             }
         }
 
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n"));
+        YoriLibOutputBuffered(OutputBuffer, _T("\n"));
     }
 
+    YoriLibOutputBufferCleanup(OutputBuffer);
     return TRUE;
 }
 
@@ -480,11 +608,19 @@ YoriLibHexDiff(
     LPCSTR BufferToDisplay;
     LPCSTR Buffers[2];
     DWORD BufferLengths[2];
+    YORI_LIB_OUTPUT_BUFFER Output;
+    PYORI_LIB_OUTPUT_BUFFER OutputBuffer;
 
     if (BytesPerWord != 1 && BytesPerWord != 2 && BytesPerWord != 4 && BytesPerWord != 8) {
         return FALSE;
     }
 
+    OutputBuffer = &Output;
+    if (!YoriLibOutputBufferInitialize(OutputBuffer, YORI_LIB_OUTPUT_STDOUT)) {
+        YoriLibOutputBufferCleanup(OutputBuffer);
+        return FALSE;
+    }
+
     DisplayBufferOffset.QuadPart = StartOfBufferOffset;
 
     if (Buffer1Length > Buffer2Length) {
@@ -506,10 +642,10 @@ YoriLibHexDiff(
         //
 
         if (DumpFlags & YORI_LIB_HEX_FLAG_DISPLAY_LARGE_OFFSET) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%08x`%08x: "), DisplayBufferOffset.HighPart, DisplayBufferOffset.LowPart);
+            YoriLibOutputBuffered(OutputBuffer, _T("%08x`%08x: "), DisplayBufferOffset.HighPart, DisplayBufferOffset.LowPart);
             DisplayBufferOffset.QuadPart += YORI_LIB_HEXDUMP_BYTES_PER_LINE;
         } else if (DumpFlags & YORI_LIB_HEX_FLAG_DISPLAY_OFFSET) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%08x: "), DisplayBufferOffset.LowPart);
+            YoriLibOutputBuffered(OutputBuffer, _T("%08x: "), DisplayBufferOffset.LowPart);
             DisplayBufferOffset.QuadPart += YORI_LIB_HEXDUMP_BYTES_PER_LINE;
         }
 
@@ -555,13 +691,13 @@ YoriLibHexDiff(
             //
 
             if (BytesPerWord == 1) {
-                YoriLibHexByteLine((CONST UCHAR *)BufferToDisplay, BytesToDisplay, HilightBits, TRUE);
+                YoriLibHexByteLine(OutputBuffer, (CONST UCHAR *)BufferToDisplay, BytesToDisplay, HilightBits, TRUE);
             } else if (BytesPerWord == 2) {
-                YoriLibHexWordLine((CONST UCHAR *)BufferToDisplay, BytesToDisplay, HilightBits, TRUE);
+                YoriLibHexWordLine(OutputBuffer, (CONST UCHAR *)BufferToDisplay, BytesToDisplay, HilightBits, TRUE);
             } else if (BytesPerWord == 4) {
-                YoriLibHexDwordLine((CONST UCHAR *)BufferToDisplay, BytesToDisplay, HilightBits, TRUE);
+                YoriLibHexDwordLine(OutputBuffer, (CONST UCHAR *)BufferToDisplay, BytesToDisplay, HilightBits, TRUE);
             } else if (BytesPerWord == 8) {
-                YoriLibHexDwordLongLine((CONST UCHAR *)BufferToDisplay, BytesToDisplay, HilightBits, TRUE);
+                YoriLibHexDwordLongLine(OutputBuffer, (CONST UCHAR *)BufferToDisplay, BytesToDisplay, HilightBits, TRUE);
             }
 
             //
@@ -570,7 +706,7 @@ YoriLibHexDiff(
             //
 
             if (DumpFlags & YORI_LIB_HEX_FLAG_DISPLAY_CHARS) {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T(" "));
+                YoriLibOutputBuffered(OutputBuffer, _T(" "));
                 CurrentBit = (0x1 << (YORI_LIB_HEXDUMP_BYTES_PER_LINE - sizeof(CharToDisplay)));
                 for (WordIndex = 0; WordIndex < YORI_LIB_HEXDUMP_BYTES_PER_LINE; WordIndex++) {
                     if (WordIndex < BytesToDisplay) {
@@ -581,23 +717,24 @@ YoriLibHexDiff(
                     } else {
                         CharToDisplay = ' ';
                     }
-                    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
-                                  _T("%c[0%sm%c"),
-                                  27,
-                                  (HilightBits & CurrentBit)?_T(";1"):_T(""),
-                                  CharToDisplay);
+                    YoriLibOutputBuffered(OutputBuffer,
+                                          _T("%c[0%sm%c"),
+                                          27,
+                                          (HilightBits & CurrentBit)?_T(";1"):_T(""),
+                                          CharToDisplay);
                     CurrentBit = CurrentBit >> sizeof(CharToDisplay);
                 }
             }
 
             if (BufferIndex == 0) {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T(" | "));
+                YoriLibOutputBuffered(OutputBuffer, _T(" | "));
             }
         }
 
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n"));
+        YoriLibOutputBuffered(OutputBuffer, _T("\n"));
     }
 
+    YoriLibOutputBufferCleanup(OutputBuffer);
     return TRUE;
 }
 
@@ -127,6 +127,286 @@ YoriLibSetMultibyteInputEncoding(
     YoriLibActiveInputEncodingInitialized = TRUE;
 }
 
+/**
+ The character used in place of a sequence which cannot be converted.
+ */
+#define YORI_LIB_REPLACEMENT_CHAR 0xFFFD
+
+/**
+ Convert a UTF16 string into UTF8 without calling the system.  Characters
+ are converted for as long as they fit in the output buffer, and the size
+ of the entire result is returned, so a caller with a large enough buffer
+ can size and convert in a single pass.  A surrogate which is not part of a
+ valid pair is converted to U+FFFD.
+
+ @param InputStringBuffer Pointer to a UTF16 string.
+
+ @param InputBufferLength The length of InputStringBuffer, in characters.
+
+ @param OutputStringBuffer Optionally points to a buffer to be populated
+        with the UTF8 form of the string.
+
+ @param OutputBufferLength The length of OutputStringBuffer, in bytes.
+
+ @return The number of bytes needed to contain the entire UTF8 string.  If
+         this is less than or equal to OutputBufferLength, the entire
+         string has been converted.
+ */
+DWORD
+YoriLibUtf16ToUtf8(
+    __in LPCWSTR InputStringBuffer,
+    __in DWORD InputBufferLength,
+    __out_opt LPSTR OutputStringBuffer,
+    __in DWORD OutputBufferLength
+    )
+{
+    DWORD InIndex;
+    DWORD OutIndex;
+    DWORD CodePoint;
+    DWORD BytesThisChar;
+    UCHAR Encoded[4];
+
+    if (OutputStringBuffer == NULL) {
+        OutputBufferLength = 0;
+    }
+
+    InIndex = 0;
+    OutIndex = 0;
+
+    while (InIndex < InputBufferLength) {
+
+        //
+        //  Most text is ASCII.  Check four characters at a time, and if
+        //  they're all ASCII, copy them without further decoding.
+        //
+
+        while (InIndex + 4 <= InputBufferLength &&
+               (InputStringBuffer[InIndex] |
+                InputStringBuffer[InIndex + 1] |
+                InputStringBuffer[InIndex + 2] |
+                InputStringBuffer[InIndex + 3]) < 0x80) {
+
+            if (OutIndex + 4 <= OutputBufferLength) {
+                OutputStringBuffer[OutIndex] = (CHAR)InputStringBuffer[InIndex];
+                OutputStringBuffer[OutIndex + 1] = (CHAR)InputStringBuffer[InIndex + 1];
+                OutputStringBuffer[OutIndex + 2] = (CHAR)InputStringBuffer[InIndex + 2];
+                OutputStringBuffer[OutIndex + 3] = (CHAR)InputStringBuffer[InIndex + 3];
+            } else {
+                OutputBufferLength = 0;
+            }
+            InIndex += 4;
+            OutIndex += 4;
+        }
+
+        if (InIndex >= InputBufferLength) {
+            break;
+        }
+
+        CodePoint = InputStringBuffer[InIndex];
+        InIndex++;
+
+        if (CodePoint >= 0xD800 && CodePoint <= 0xDFFF) {
+            if (CodePoint <= 0xDBFF &&
+                InIndex < InputBufferLength &&
+                InputStringBuffer[InIndex] >= 0xDC00 &&
+                InputStringBuffer[InIndex] <= 0xDFFF) {
+
+                CodePoint = 0x10000 + ((CodePoint - 0xD800) << 10) + (InputStringBuffer[InIndex] - 0xDC00);
+                InIndex++;
+            } else {
+                CodePoint = YORI_LIB_REPLACEMENT_CHAR;
+            }
+        }
+
+        if (CodePoint < 0x80) {
+            Encoded[0] = (UCHAR)CodePoint;
+            BytesThisChar = 1;
+        } else if (CodePoint < 0x800) {
+            Encoded[0] = (UCHAR)(0xC0 | (CodePoint >> 6));
+            Encoded[1] = (UCHAR)(0x80 | (CodePoint & 0x3F));
+            BytesThisChar = 2;
+        } else if (CodePoint < 0x10000) {
+            Encoded[0] = (UCHAR)(0xE0 | (CodePoint >> 12));
+            Encoded[1] = (UCHAR)(0x80 | ((CodePoint >> 6) & 0x3F));
+            Encoded[2] = (UCHAR)(0x80 | (CodePoint & 0x3F));
+            BytesThisChar = 3;
+        } else {
+            Encoded[0] = (UCHAR)(0xF0 | (CodePoint >> 18));
+            Encoded[1] = (UCHAR)(0x80 | ((CodePoint >> 12) & 0x3F));
+            Encoded[2] = (UCHAR)(0x80 | ((CodePoint >> 6) & 0x3F));
+            Encoded[3] = (UCHAR)(0x80 | (CodePoint & 0x3F));
+            BytesThisChar = 4;
+        }
+
+        if (OutIndex + BytesThisChar <= OutputBufferLength) {
+            memcpy(&OutputStringBuffer[OutIndex], Encoded, BytesThisChar);
+        } else {
+
+            //
+            //  Once the output is full, stop writing so a partial
+            //  character is never generated, but keep counting.
+            //
+
+            OutputBufferLength = 0;
+        }
+        OutIndex += BytesThisChar;
+    }
+
+    return OutIndex;
+}
+
+/**
+ Convert a UTF8 string into UTF16 without calling the system.  Characters
+ are converted for as long as they fit in the output buffer, and the size
+ of the entire result is returned, so a caller with a large enough buffer
+ can size and convert in a single pass.  Each invalid, overlong or
+ truncated sequence, or encoded surrogate, is converted to a single U+FFFD.
+
+ @param InputStringBuffer Pointer to a UTF8 string.
+
+ @param InputBufferLength The length of InputStringBuffer, in bytes.
+
+ @param OutputStringBuffer Optionally points to a buffer to be populated
+        with the UTF16 form of the string.
+
+ @param OutputBufferLength The length of OutputStringBuffer, in characters.
+
+ @return The number of characters needed to contain the entire UTF16
+         string.  If this is less than or equal to OutputBufferLength, the
+         entire string has been converted.
+ */
+DWORD
+YoriLibUtf8ToUtf16(
+    __in LPCSTR InputStringBuffer,
+    __in DWORD InputBufferLength,
+    __out_opt LPWSTR OutputStringBuffer,
+    __in DWORD OutputBufferLength
+    )
+{
+    UCHAR CONST * Input;
+    DWORD InIndex;
+    DWORD OutIndex;
+    DWORD CodePoint;
+    DWORD Needed;
+    DWORD Index;
+    UCHAR LowerBound;
+    UCHAR UpperBound;
+    UCHAR Byte;
+
+    if (OutputStringBuffer == NULL) {
+        OutputBufferLength = 0;
+    }
+
+    Input = (UCHAR CONST *)InputStringBuffer;
+    InIndex = 0;
+    OutIndex = 0;
+
+    while (InIndex < InputBufferLength) {
+
+        //
+        //  Check four bytes at a time for ASCII.
+        //
+
+        while (InIndex + 4 <= InputBufferLength &&
+               ((Input[InIndex] |
+                 Input[InIndex + 1] |
+                 Input[InIndex + 2] |
+                 Input[InIndex + 3]) & 0x80) == 0) {
+
+            if (OutIndex + 4 <= OutputBufferLength) {
+                OutputStringBuffer[OutIndex] = Input[InIndex];
+                OutputStringBuffer[OutIndex + 1] = Input[InIndex + 1];
+                OutputStringBuffer[OutIndex + 2] = Input[InIndex + 2];
+                OutputStringBuffer[OutIndex + 3] = Input[InIndex + 3];
+            } else {
+                OutputBufferLength = 0;
+            }
+            InIndex += 4;
+            OutIndex += 4;
+        }
+
+        if (InIndex >= InputBufferLength) {
+            break;
+        }
+
+        Byte = Input[InIndex];
+        InIndex++;
+
+        //
+        //  Determine how many continuation bytes are expected and the valid
+        //  range of the first one, which excludes overlong forms, encoded
+        //  surrogates, and values above U+10FFFF.
+        //
+
+        LowerBound = 0x80;
+        UpperBound = 0xBF;
+        if (Byte < 0x80) {
+            CodePoint = Byte;
+            Needed = 0;
+        } else if (Byte >= 0xC2 && Byte <= 0xDF) {
+            CodePoint = Byte & 0x1F;
+            Needed = 1;
+        } else if (Byte >= 0xE0 && Byte <= 0xEF) {
+            CodePoint = Byte & 0x0F;
+            Needed = 2;
+            if (Byte == 0xE0) {
+                LowerBound = 0xA0;
+            } else if (Byte == 0xED) {
+                UpperBound = 0x9F;
+            }
+        } else if (Byte >= 0xF0 && Byte <= 0xF4) {
+            CodePoint = Byte & 0x07;
+            Needed = 3;
+            if (Byte == 0xF0) {
+                LowerBound = 0x90;
+            } else if (Byte == 0xF4) {
+                UpperBound = 0x8F;
+            }
+        } else {
+            CodePoint = YORI_LIB_REPLACEMENT_CHAR;
+            Needed = 0;
+        }
+
+        for (Index = 0; Index < Needed; Index++) {
+            if (InIndex >= InputBufferLength) {
+                break;
+            }
+            Byte = Input[InIndex];
+            if (Byte < LowerBound || Byte > UpperBound) {
+                break;
+            }
+            LowerBound = 0x80;
+            UpperBound = 0xBF;
+            CodePoint = (CodePoint << 6) | (Byte & 0x3F);
+            InIndex++;
+        }
+
+        if (Index < Needed) {
+            CodePoint = YORI_LIB_REPLACEMENT_CHAR;
+        }
+
+        if (CodePoint >= 0x10000) {
+            if (OutIndex + 2 <= OutputBufferLength) {
+                CodePoint -= 0x10000;
+                OutputStringBuffer[OutIndex] = (WCHAR)(0xD800 + (CodePoint >> 10));
+                OutputStringBuffer[OutIndex + 1] = (WCHAR)(0xDC00 + (CodePoint & 0x3FF));
+            } else {
+                OutputBufferLength = 0;
+            }
+            OutIndex += 2;
+        } else {
+            if (OutIndex + 1 <= OutputBufferLength) {
+                OutputStringBuffer[OutIndex] = (WCHAR)CodePoint;
+            } else {
+                OutputBufferLength = 0;
+            }
+            OutIndex++;
+        }
+    }
+
+    return OutIndex;
+}
+
 /**
  Returns the number of bytes needed to store a specified UTF16 string in
  the current output encoding.
@@ -148,6 +428,9 @@ YoriLibGetMultibyteOutputSizeNeeded(
     if (Encoding == CP_UTF16) {
         return BufferLength * sizeof(WCHAR);
     }
+    if (Encoding == CP_UTF8) {
+        return YoriLibUtf16ToUtf8(StringBuffer, BufferLength, NULL, 0);
+    }
     Return = WideCharToMultiByte(Encoding, 0, StringBuffer, BufferLength, NULL, 0, NULL, NULL);
     ASSERT(Return > 0 || BufferLength == 0);
     return Return;
@@ -182,6 +465,11 @@ YoriLibMultibyteOutput(
         }
         return;
     }
+    if (Encoding == CP_UTF8) {
+        Return = YoriLibUtf16ToUtf8(InputStringBuffer, InputBufferLength, OutputStringBuffer, OutputBufferLength);
+        ASSERT(Return <= OutputBufferLength);
+        return;
+    }
     Return = WideCharToMultiByte(Encoding,
                                  0,
                                  InputStringBuffer,
@@ -217,6 +505,9 @@ YoriLibGetMultibyteInputSizeNeeded(
     if (Encoding == CP_UTF16) {
         return BufferLength;
     }
+    if (Encoding == CP_UTF8) {
+        return YoriLibUtf8ToUtf16(StringBuffer, BufferLength, NULL, 0);
+    }
     return MultiByteToWideChar(Encoding, 0, StringBuffer, BufferLength, NULL, 0);
 }
 
@@ -249,6 +540,11 @@ YoriLibMultibyteInput(
         }
         return;
     }
+    if (Encoding == CP_UTF8) {
+        Return = YoriLibUtf8ToUtf16(InputStringBuffer, InputBufferLength, OutputStringBuffer, OutputBufferLength);
+        ASSERT(Return <= OutputBufferLength);
+        return;
+    }
     Return = MultiByteToWideChar(Encoding,
                                  0,
                                  InputStringBuffer,
@@ -259,4 +555,129 @@ YoriLibMultibyteInput(
     ASSERT(Return != 0);
 }
 
+/**
+ Convert a UTF16 string into the output encoding if it fits in the supplied
+ buffer, and return the size of the complete result.  For the common
+ encodings this performs a single pass, so callers which usually have a
+ large enough buffer avoid a separate sizing call.
+
+ @param InputStringBuffer Pointer to a UTF16 string.
+
+ @param InputBufferLength The size of InputStringBuffer, in characters.
+
+ @param OutputStringBuffer Optionally points to a buffer to be populated
+        with the string in the current output encoding.
+
+ @param OutputBufferLength The length of the output buffer, in bytes.
+
+ @return The number of bytes needed to store the output form.  If this is
+         less than or equal to OutputBufferLength, the conversion is
+         complete.  Otherwise the contents of OutputStringBuffer are
+         undefined and the caller should retry with a larger buffer.
+ */
+DWORD
+YoriLibMultibyteOutputSizeAndConvert(
+    __in LPCTSTR InputStringBuffer,
+    __in DWORD InputBufferLength,
+    __out_opt LPSTR OutputStringBuffer,
+    __in DWORD OutputBufferLength
+    )
+{
+    DWORD Return;
+    DWORD Encoding = YoriLibGetMultibyteOutputEncoding();
+
+    if (OutputStringBuffer == NULL) {
+        OutputBufferLength = 0;
+    }
+
+    if (Encoding == CP_UTF16) {
+        Return = InputBufferLength * sizeof(WCHAR);
+        if (Return <= OutputBufferLength) {
+            memcpy(OutputStringBuffer, InputStringBuffer, Return);
+        }
+        return Return;
+    }
+    if (Encoding == CP_UTF8) {
+        return YoriLibUtf16ToUtf8(InputStringBuffer, InputBufferLength, OutputStringBuffer, OutputBufferLength);
+    }
+
+    if (OutputBufferLength > 0) {
+        Return = WideCharToMultiByte(Encoding,
+                                     0,
+                                     InputStringBuffer,
+                                     InputBufferLength,
+                                     OutputStringBuffer,
+                                     OutputBufferLength,
+                                     NULL,
+                                     NULL);
+        if (Return > 0 || InputBufferLength == 0) {
+            return Return;
+        }
+    }
+
+    return WideCharToMultiByte(Encoding, 0, InputStringBuffer, InputBufferLength, NULL, 0, NULL, NULL);
+}
+
+/**
+ Convert a string from the input encoding into UTF16 if it fits in the
+ supplied buffer, and return the size of the complete result.  For the
+ common encodings this performs a single pass, so callers which usually
+ have a large enough buffer avoid a separate sizing call.
+
+ @param InputStringBuffer Pointer to a string in input encoding form.
+
+ @param InputBufferLength The size of InputStringBuffer, in bytes.  If the
+        input encoding is UTF16, this is in characters, matching
+        @ref YoriLibMultibyteInput.
+
+ @param OutputStringBuffer Optionally points to a buffer to be populated
+        with the string in UTF16 format.
+
+ @param OutputBufferLength The length of the output buffer, in characters.
+
+ @return The number of characters needed to store the UTF16 form.  If this
+         is less than or equal to OutputBufferLength, the conversion is
+         complete.  Otherwise the contents of OutputStringBuffer are
+         undefined and the caller should retry with a larger buffer.
+ */
+DWORD
+YoriLibMultibyteInputSizeAndConvert(
+    __in LPCSTR InputStringBuffer,
+    __in DWORD InputBufferLength,
+    __out_opt LPTSTR OutputStringBuffer,
+    __in DWORD OutputBufferLength
+    )
+{
+    DWORD Return;
+    DWORD Encoding = YoriLibGetMultibyteInputEncoding();
+
+    if (OutputStringBuffer == NULL) {
+        OutputBufferLength = 0;
+    }
+
+    if (Encoding == CP_UTF16) {
+        if (InputBufferLength <= OutputBufferLength) {
+            memcpy(OutputStringBuffer, InputStringBuffer, InputBufferLength * sizeof(WCHAR));
+        }
+        return InputBufferLength;
+    }
+    if (Encoding == CP_UTF8) {
+        return YoriLibUtf8ToUtf16(InputStringBuffer, InputBufferLength, OutputStringBuffer, OutputBufferLength);
+    }
+
+    if (OutputBufferLength > 0) {
+        Return = MultiByteToWideChar(Encoding,
+                                     0,
+                                     InputStringBuffer,
+                                     InputBufferLength,
+                                     OutputStringBuffer,
+                                     OutputBufferLength);
+        if (Return > 0 || InputBufferLength == 0) {
+            return Return;
+        }
+    }
+
+    return MultiByteToWideChar(Encoding, 0, InputStringBuffer, InputBufferLength, NULL, 0);
+}
+
 // vim:sw=4:ts=4:et:
@@ -84,4 +84,59 @@ YoriLibLimitJobObjectPriority(
     return DllKernel32.pSetInformationJobObject(hJob, 2, &LimitInfo, sizeof(LimitInfo));
 }
 
+/**
+ Allow processes launched by processes within a job object to be created
+ outside of the job.  This allows the job to be used to track the processes
+ assigned to it without preventing those processes from using job objects
+ on systems that don't support nested jobs.  If this functionality is not
+ supported by the host OS, returns FALSE.
+
+ @param hJob Handle to the job object.
+
+ @return TRUE on success, FALSE on failure.
+ */
+BOOL
+YoriLibAllowSilentJobObjectBreakaway(
+    __in HANDLE hJob
+    )
+{
+    YORI_JOB_BASIC_LIMIT_INFORMATION LimitInfo;
+    if (DllKernel32.pSetInformationJobObject == NULL) {
+        return FALSE;
+    }
+    ZeroMemory(&LimitInfo, sizeof(LimitInfo));
+    LimitInfo.Flags = 0x1000;
+    return DllKernel32.pSetInformationJobObject(hJob, 2, &LimitInfo, sizeof(LimitInfo));
+}
+
+/**
+ Associate a job object with a completion port, so that notifications about
+ processes within the job are delivered to the port.  If this functionality
+ is not supported by the host OS, returns FALSE.
+
+ @param hJob Handle to the job object.
+
+ @param hPort Handle to the completion port.
+
+ @param Key A context pointer to associate with messages arriving on the
+        completion port.
+
+ @return TRUE on success, FALSE on failure.
+ */
+BOOL
+YoriLibAssociateJobObjectWithCompletionPort(
+    __in HANDLE hJob,
+    __in HANDLE hPort,
+    __in PVOID Key
+    )
+{
+    YORI_JOB_ASSOCIATE_COMPLETION_PORT AssociateInfo;
+    if (DllKernel32.pSetInformationJobObject == NULL) {
+        return FALSE;
+    }
+    AssociateInfo.Key = Key;
+    AssociateInfo.Port = hPort;
+    return DllKernel32.pSetInformationJobObject(hJob, YORI_JOB_INFO_ASSOCIATE_COMPLETION_PORT, &AssociateInfo, sizeof(AssociateInfo));
+}
+
 // vim:sw=4:ts=4:et:
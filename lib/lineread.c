@@ -103,11 +103,25 @@ YoriLibCopyLineToUserBufferW(
     )
 {
     DWORD CharsNeeded;
+    DWORD CharsAvailable;
+
+    //
+    //  Convert directly into the user's buffer, leaving space for the
+    //  NULL terminator.  In the common case where the buffer is already
+    //  large enough this requires a single pass over the line.
+    //
 
     if (CharsToCopy == 0) {
         CharsNeeded = 1;
     } else {
-        CharsNeeded = YoriLibGetMultibyteInputSizeNeeded(SourceBuffer, CharsToCopy) + 1;
+        CharsAvailable = 0;
+        if (UserString->LengthAllocated > 0) {
+            CharsAvailable = UserString->LengthAllocated - 1;
+        }
+        CharsNeeded = YoriLibMultibyteInputSizeAndConvert(SourceBuffer,
+                                                          CharsToCopy,
+                                                          UserString->StartOfString,
+                                                          CharsAvailable) + 1;
     }
 
     if (CharsNeeded > UserString->LengthAllocated) {
@@ -115,13 +129,13 @@ YoriLibCopyLineToUserBufferW(
         if (!YoriLibReallocateString(UserString, CharsNeeded + 64)) {
             return FALSE;
         }
-    }
 
-    if (CharsToCopy > 0) {
-        YoriLibMultibyteInput(SourceBuffer,
-                              CharsToCopy,
-                              UserString->StartOfString,
-                              UserString->LengthAllocated);
+        if (CharsToCopy > 0) {
+            YoriLibMultibyteInput(SourceBuffer,
+                                  CharsToCopy,
+                                  UserString->StartOfString,
+                                  UserString->LengthAllocated);
+        }
     }
 
     UserString->LengthInChars = CharsNeeded - 1;
@@ -620,4 +634,22 @@ YoriLibLineReadClose(
     }
 }
 
+/**
+ Indicate that a stream which previously reached its end may have had more
+ data appended, so the next read should attempt to read from the stream
+ again.  Any partial line that has already been read is retained.
+
+ @param Context Pointer to the context to resume.
+ */
+VOID
+YoriLibLineReadResume(
+    __in PVOID Context
+    )
+{
+    PYORI_LIB_LINE_READ_CONTEXT ReadContext = (PYORI_LIB_LINE_READ_CONTEXT)Context;
+    if (ReadContext != NULL) {
+        ReadContext->Terminated = FALSE;
+    }
+}
+
 // vim:sw=4:ts=4:et:
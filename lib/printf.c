@@ -46,6 +46,211 @@
  */
 #define PRINTF_SIZEONLY 1
 #include "printf.inc"
+#undef PRINTF_SIZEONLY
+
+/**
+ Indicate that the printf routine should generate YoriLibVYPrintf, which
+ formats into a Yori string and reallocates it as needed.
+ */
+#define PRINTF_GROWABLE 1
+#include "printf.inc"
+
+/**
+ Indicate that the printf routine should generate YoriLibVYPrintfCompiled,
+ which formats from a previously parsed format string.
+ */
+#define PRINTF_COMPILED 1
+#include "printf.inc"
+#undef PRINTF_COMPILED
+#undef PRINTF_GROWABLE
+
+/**
+ Reallocate the buffer of a Yori string that printf is formatting into
+ because the buffer has been filled.  Any characters already generated are
+ preserved.
+
+ @param Dest The string being populated.
+
+ @param CharsUsed The number of characters already generated into the
+        string.
+
+ @param Buffer On successful completion, updated to point to the new buffer.
+
+ @param BufferLength On successful completion, updated to contain the length
+        of the new buffer, in characters.
+
+ @return TRUE to indicate the buffer was reallocated, FALSE if it could not
+         be.
+ */
+BOOL
+YoriLibPrintfGrowDest(
+    __inout PYORI_STRING Dest,
+    __in DWORD CharsUsed,
+    __out LPTSTR * Buffer,
+    __out PDWORD BufferLength
+    )
+{
+    DWORD NewLength;
+    LPTSTR NewBuffer;
+
+    if (Dest->LengthAllocated >= 0x10000000) {
+        return FALSE;
+    }
+
+    NewLength = Dest->LengthAllocated * 2;
+    if (NewLength < 64) {
+        NewLength = 64;
+    }
+
+    NewBuffer = YoriLibReferencedMalloc(NewLength * sizeof(TCHAR));
+    if (NewBuffer == NULL) {
+        return FALSE;
+    }
+
+    if (CharsUsed > 0) {
+        memcpy(NewBuffer, Dest->StartOfString, CharsUsed * sizeof(TCHAR));
+    }
+
+    if (Dest->MemoryToFree != NULL) {
+        YoriLibDereference(Dest->MemoryToFree);
+    }
+
+    Dest->MemoryToFree = NewBuffer;
+    Dest->StartOfString = NewBuffer;
+    Dest->LengthAllocated = NewLength;
+
+    *Buffer = NewBuffer;
+    *BufferLength = NewLength;
+    return TRUE;
+}
+
+/**
+ Parse a printf format string into a form that can be applied repeatedly
+ without parsing the string again.  The format string is copied, so the
+ caller does not need to keep it valid.
+
+ @param szFmt The format string to parse.
+
+ @return Pointer to the compiled format, which should be freed with
+         @ref YoriLibPrintfFreeFormat, or NULL on allocation failure.
+ */
+PYORI_LIB_PRINTF_FORMAT
+YoriLibPrintfCompileFormat(
+    __in LPCTSTR szFmt
+    )
+{
+    PYORI_LIB_PRINTF_FORMAT Format;
+    PYORI_LIB_PRINTF_ELEMENT Element;
+    LPTSTR FormatCopy;
+    DWORD FormatLength;
+    DWORD MaxElements;
+    DWORD src_offset;
+
+    //
+    //  Each substitution generates one element, and there can be at most
+    //  one run of literal text before each substitution and after the last.
+    //
+
+    MaxElements = 1;
+    for (FormatLength = 0; szFmt[FormatLength] != '\0'; FormatLength++) {
+        if (szFmt[FormatLength] == '%') {
+            MaxElements += 2;
+        }
+    }
+
+    Format = YoriLibMalloc(sizeof(YORI_LIB_PRINTF_FORMAT) +
+                           MaxElements * sizeof(YORI_LIB_PRINTF_ELEMENT) +
+                           (FormatLength + 1) * sizeof(TCHAR));
+    if (Format == NULL) {
+        return NULL;
+    }
+
+    Format->ElementCount = 0;
+    Format->Elements = (PYORI_LIB_PRINTF_ELEMENT)(Format + 1);
+    FormatCopy = (LPTSTR)(Format->Elements + MaxElements);
+    memcpy(FormatCopy, szFmt, (FormatLength + 1) * sizeof(TCHAR));
+
+    src_offset = 0;
+    while (FormatCopy[src_offset] != '\0') {
+        Element = &Format->Elements[Format->ElementCount];
+        ZeroMemory(Element, sizeof(YORI_LIB_PRINTF_ELEMENT));
+
+        if (FormatCopy[src_offset] != '%') {
+            Element->Literal = &FormatCopy[src_offset];
+            while (FormatCopy[src_offset] != '\0' && FormatCopy[src_offset] != '%') {
+                Element->LiteralLength++;
+                src_offset++;
+            }
+            Format->ElementCount++;
+            continue;
+        }
+
+        //
+        //  This mirrors the parsing in printf.inc.
+        //
+
+        src_offset++;
+        if (FormatCopy[src_offset] == '-') {
+            Element->LeftAlign = TRUE;
+            src_offset++;
+        }
+        if (FormatCopy[src_offset] == '0') {
+            Element->LeadingZero = TRUE;
+            src_offset++;
+        }
+        while (FormatCopy[src_offset] >= '0' && FormatCopy[src_offset] <= '9') {
+            Element->ElementLength = Element->ElementLength * 10 + FormatCopy[src_offset] - '0';
+            src_offset++;
+        }
+        if (FormatCopy[src_offset] == 'h') {
+            Element->ShortPrefix = TRUE;
+            src_offset++;
+        } else if (FormatCopy[src_offset] == 'l' && FormatCopy[src_offset + 1] == 'l') {
+            Element->LongLongPrefix = TRUE;
+            src_offset += 2;
+        } else if (FormatCopy[src_offset] == 'l') {
+            Element->LongPrefix = TRUE;
+            src_offset++;
+        }
+
+        if (Element->ElementLength == 0) {
+            Element->ElementLength = (DWORD)-1;
+        }
+
+        if (FormatCopy[src_offset] == 'p' && sizeof(PVOID) == sizeof(DWORDLONG)) {
+            Element->LongLongPrefix = TRUE;
+        }
+
+        //
+        //  A format string that ends in the middle of a substitution has
+        //  nothing to substitute.
+        //
+
+        if (FormatCopy[src_offset] == '\0') {
+            break;
+        }
+
+        Element->Specifier = FormatCopy[src_offset];
+        src_offset++;
+        Format->ElementCount++;
+    }
+
+    return Format;
+}
+
+/**
+ Free a format string previously parsed with
+ @ref YoriLibPrintfCompileFormat .
+
+ @param Format Pointer to the compiled format to free.
+ */
+VOID
+YoriLibPrintfFreeFormat(
+    __in PYORI_LIB_PRINTF_FORMAT Format
+    )
+{
+    YoriLibFree(Format);
+}
 
 /**
  Process a printf format string and output the result into a NULL terminated
@@ -125,30 +330,7 @@ YoriLibYPrintfInternal(
     __in va_list marker
     )
 {
-    int required_len;
-    int out_len;
-
-    required_len = YoriLibVSPrintfSize(szFmt, marker);
-    if (required_len < 0) {
-        return required_len;
-    }
-    if ((DWORD)required_len > Dest->LengthAllocated) {
-        YoriLibFreeStringContents(Dest);
-
-        Dest->MemoryToFree = YoriLibReferencedMalloc(required_len * sizeof(TCHAR));
-        if (Dest->MemoryToFree == NULL) {
-            return -1;
-        }
-
-        Dest->StartOfString = Dest->MemoryToFree;
-        Dest->LengthAllocated = required_len;
-    }
-
-    out_len = YoriLibVSPrintf(Dest->StartOfString, Dest->LengthAllocated, szFmt, marker);
-    if (out_len >= 0) {
-        Dest->LengthInChars = out_len;
-    }
-    return out_len;
+    return YoriLibVYPrintf(Dest, szFmt, marker);
 }
 
 /**
@@ -179,6 +361,34 @@ YoriLibYPrintf(
     return out_len;
 }
 
+/**
+ Apply a previously compiled printf format and output the result into a Yori
+ string.  If the string is not large enough to contain the result, it is
+ reallocated internally.
+
+ @param Dest The string to populate with the result.
+
+ @param Format The compiled format to apply.
+
+ @return The number of characters successfully populated into the buffer, or
+         -1 on error.
+ */
+int
+YoriLibYPrintfCompiled(
+    __inout PYORI_STRING Dest,
+    __in PYORI_LIB_PRINTF_FORMAT Format,
+    ...
+    )
+{
+    va_list marker;
+    int out_len;
+
+    va_start( marker, Format );
+    out_len = YoriLibVYPrintfCompiled(Dest, Format, marker);
+    va_end( marker );
+    return out_len;
+}
+
 /**
  Process a printf format string and count the number of characters required
  to contain the result, including the NULL terminator character.
@@ -29,19 +29,27 @@
 
 
 /**
- Attempt to send an object to the recycle bin.
+ Attempt to send a set of objects to the recycle bin in a single operation.
+ If the operation fails, some objects may have been recycled and others not,
+ so callers should check which objects remain.
 
- @param FilePath Pointer to the file path to delete.
+ @param FileCount The number of elements in the FilePaths array.
 
- @return TRUE if the object was sent to the recycle bin, FALSE if not.
+ @param FilePaths An array of file paths to delete.
+
+ @return TRUE if the objects were sent to the recycle bin, FALSE if not.
  */
 BOOL
-YoriLibRecycleBinFile(
-    __in PYORI_STRING FilePath
+YoriLibRecycleBinFiles(
+    __in DWORD FileCount,
+    __in PYORI_STRING FilePaths
     )
 {
     YORI_SHFILEOP FileOp;
-    YORI_STRING FilePathWithDoubleNull;
+    YORI_STRING FileList;
+    YORI_STRING UnescapedPath;
+    DWORD Index;
+    DWORD LengthNeeded;
     INT Result;
 
     YoriLibLoadShell32Functions();
@@ -56,11 +64,18 @@ YoriLibRecycleBinFile(
     }
 
     //
-    //  Create a double NULL terminated file name.
+    //  Shell takes a list of NULL terminated file names, terminated by an
+    //  additional NULL.  Unescaping a path never makes it longer, so the
+    //  escaped lengths are enough to hold it.
     //
 
-    YoriLibInitEmptyString(&FilePathWithDoubleNull);
-    if (!YoriLibAllocateString(&FilePathWithDoubleNull, FilePath->LengthInChars + 2)) {
+    LengthNeeded = 1;
+    for (Index = 0; Index < FileCount; Index++) {
+        LengthNeeded += FilePaths[Index].LengthInChars + 1;
+    }
+
+    YoriLibInitEmptyString(&FileList);
+    if (!YoriLibAllocateString(&FileList, LengthNeeded)) {
         return FALSE;
     }
 
@@ -69,23 +84,34 @@ YoriLibRecycleBinFile(
     //  Win32 limited paths.
     //
 
-    YoriLibUnescapePath(FilePath, &FilePathWithDoubleNull);
+    for (Index = 0; Index < FileCount; Index++) {
+        YoriLibInitEmptyString(&UnescapedPath);
+        UnescapedPath.StartOfString = &FileList.StartOfString[FileList.LengthInChars];
+        UnescapedPath.LengthAllocated = FileList.LengthAllocated - FileList.LengthInChars;
+        if (!YoriLibUnescapePath(&FilePaths[Index], &UnescapedPath)) {
+            YoriLibFreeStringContents(&FileList);
+            return FALSE;
+        }
+        ASSERT(UnescapedPath.StartOfString == &FileList.StartOfString[FileList.LengthInChars]);
+        FileList.LengthInChars += UnescapedPath.LengthInChars;
+        FileList.StartOfString[FileList.LengthInChars] = '\0';
+        FileList.LengthInChars++;
+    }
 
-    ASSERT(FilePathWithDoubleNull.LengthAllocated >= FilePathWithDoubleNull.LengthInChars + 2);
-    FilePathWithDoubleNull.StartOfString[FilePathWithDoubleNull.LengthInChars] = '\0';
-    FilePathWithDoubleNull.StartOfString[FilePathWithDoubleNull.LengthInChars + 1] = '\0';
+    ASSERT(FileList.LengthAllocated > FileList.LengthInChars);
+    FileList.StartOfString[FileList.LengthInChars] = '\0';
 
     //
-    //  Ask shell to send the object to the recycle bin.
+    //  Ask shell to send the objects to the recycle bin.
     //
 
     ZeroMemory(&FileOp, sizeof(FileOp));
     FileOp.Function = YORI_SHFILEOP_DELETE;
-    FileOp.Source = FilePathWithDoubleNull.StartOfString;
+    FileOp.Source = FileList.StartOfString;
     FileOp.Flags = YORI_SHFILEOP_FLAG_SILENT|YORI_SHFILEOP_FLAG_NOCONFIRMATION|YORI_SHFILEOP_FLAG_ALLOWUNDO|YORI_SHFILEOP_FLAG_NOERRORUI;
 
     Result = DllShell32.pSHFileOperationW(&FileOp);
-    YoriLibFreeStringContents(&FilePathWithDoubleNull);
+    YoriLibFreeStringContents(&FileList);
 
     if (Result == 0) {
         return TRUE;
@@ -93,4 +119,19 @@ YoriLibRecycleBinFile(
     return FALSE;
 }
 
+/**
+ Attempt to send an object to the recycle bin.
+
+ @param FilePath Pointer to the file path to delete.
+
+ @return TRUE if the object was sent to the recycle bin, FALSE if not.
+ */
+BOOL
+YoriLibRecycleBinFile(
+    __in PYORI_STRING FilePath
+    )
+{
+    return YoriLibRecycleBinFiles(1, FilePath);
+}
+
 // vim:sw=4:ts=4:et:
@@ -52,6 +52,12 @@ typedef struct _YORI_LIB_STREAM_ENUM_CONTEXT {
      */
     YORI_STRING TrailingStreamName;
 
+    /**
+     The compiled form of TrailingStreamName, used to check each stream
+     found when StreamNameHasWild is TRUE.
+     */
+    YORI_LIB_FILE_MATCH_EXPRESSION TrailingStreamExpression;
+
     /**
      A temporary buffer used for each stream found out of a single
      allocation.
@@ -193,7 +199,7 @@ YoriLibStreamEnumFileFoundCallback(
                 //  Check if it matches the specified criteria
                 //
 
-                if (YoriLibDoesFileMatchExpression(&FoundStreamName, &StreamContext->TrailingStreamName)) {
+                if (YoriLibDoesFileMatchCompiledExpression(&FoundStreamName, &StreamContext->TrailingStreamExpression)) {
 
                     if (FoundStreamName.LengthInChars == 0) {
                         Result = StreamContext->UserCallback(FilePath,
@@ -409,6 +415,14 @@ YoriLibForEachStream(
         StreamContext.StreamNameHasWild = FALSE;
     }
 
+    ZeroMemory(&StreamContext.TrailingStreamExpression, sizeof(StreamContext.TrailingStreamExpression));
+    if (StreamContext.StreamNameHasWild) {
+        if (!YoriLibCompileFileMatchExpression(&StreamContext.TrailingStreamName, &StreamContext.TrailingStreamExpression)) {
+            YoriLibFreeStringContents(&FileSpecNoStream);
+            return FALSE;
+        }
+    }
+
     Result = YoriLibForEachFile(&FileSpecNoStream,
                                 MatchFlags,
                                 Depth,
@@ -416,6 +430,7 @@ YoriLibForEachStream(
                                 YoriLibStreamEnumErrorCallback,
                                 &StreamContext);
 
+    YoriLibFreeFileMatchExpression(&StreamContext.TrailingStreamExpression);
     YoriLibFreeStringContents(&StreamContext.FullPathWithStream);
     YoriLibFreeStringContents(&FileSpecNoStream);
     return Result;
@@ -112,20 +112,26 @@ YoriLibOutputTextToMultibyteDevice(
         DWORD AnsiBytesNeeded;
         LPSTR ansi_buf;
 
-        AnsiBytesNeeded = YoriLibGetMultibyteOutputSizeNeeded(StringBuffer, BufferLength);
-    
-        if (AnsiBytesNeeded > (int)sizeof(ansi_stack_buf)) {
+        //
+        //  Try to convert into the stack buffer, which for short strings
+        //  means the text is only traversed once.  If it doesn't fit,
+        //  the size of the result is known, so allocate and convert again.
+        //
+
+        ansi_buf = ansi_stack_buf;
+        AnsiBytesNeeded = YoriLibMultibyteOutputSizeAndConvert(StringBuffer, BufferLength, ansi_buf, sizeof(ansi_stack_buf));
+
+        if (AnsiBytesNeeded > sizeof(ansi_stack_buf)) {
             ansi_buf = YoriLibMalloc(AnsiBytesNeeded);
-        } else {
-            ansi_buf = ansi_stack_buf;
+            if (ansi_buf != NULL) {
+                YoriLibMultibyteOutput(StringBuffer,
+                                       BufferLength,
+                                       ansi_buf,
+                                       AnsiBytesNeeded);
+            }
         }
 
         if (ansi_buf != NULL) {
-            YoriLibMultibyteOutput(StringBuffer,
-                                   BufferLength,
-                                   ansi_buf,
-                                   AnsiBytesNeeded);
-
             Result = WriteFile(hOutput, ansi_buf, AnsiBytesNeeded, &BytesTransferred, NULL);
 
             if (ansi_buf != ansi_stack_buf) {
@@ -801,10 +807,9 @@ YoriLibOutputInternal(
     __in va_list marker
     )
 {
-    va_list savedmarker = marker;
     int len;
     TCHAR stack_buf[64];
-    TCHAR * buf;
+    YORI_STRING buf;
     YORI_LIB_VT_CALLBACK_FUNCTIONS Callbacks;
     DWORD CurrentMode;
     BOOL Result;
@@ -826,25 +831,24 @@ YoriLibOutputInternal(
         YoriLibUtf8TextWithEscapesSetFunctions(&Callbacks);
     }
 
-    len = YoriLibVSPrintfSize(szFmt, marker);
+    //
+    //  Format in a single pass, starting in a stack buffer and moving to
+    //  the heap only if the result doesn't fit.
+    //
 
-    if (len>(int)(sizeof(stack_buf)/sizeof(stack_buf[0]))) {
-        buf = YoriLibMalloc(len * sizeof(TCHAR));
-        if (buf == NULL) {
-            return 0;
-        }
-    } else {
-        buf = stack_buf;
-    }
+    YoriLibInitEmptyString(&buf);
+    buf.StartOfString = stack_buf;
+    buf.LengthAllocated = sizeof(stack_buf)/sizeof(stack_buf[0]);
 
-    marker = savedmarker;
-    len = YoriLibVSPrintf(buf, len, szFmt, marker);
+    len = YoriLibVYPrintf(&buf, szFmt, marker);
+    if (len < 0) {
+        YoriLibFreeStringContents(&buf);
+        return FALSE;
+    }
 
-    Result = YoriLibProcessVtEscapesOnNewStream(buf, len, hOut, &Callbacks);
+    Result = YoriLibProcessVtEscapesOnNewStream(buf.StartOfString, len, hOut, &Callbacks);
 
-    if (buf != stack_buf) {
-        YoriLibFree(buf);
-    }
+    YoriLibFreeStringContents(&buf);
     return Result;
 }
 
@@ -957,6 +961,357 @@ YoriLibOutputToDevice(
     return Result;
 }
 
+/**
+ Prepare a buffered output stream for use.  The capabilities of the device
+ are queried once here rather than on every write.
+
+ @param OutputBuffer Pointer to the buffered output stream to initialize.
+
+ @param Flags Flags, indicating the output stream and its behavior.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibOutputBufferInitialize(
+    __out PYORI_LIB_OUTPUT_BUFFER OutputBuffer,
+    __in DWORD Flags
+    )
+{
+    DWORD CurrentMode;
+
+    ZeroMemory(OutputBuffer, sizeof(YORI_LIB_OUTPUT_BUFFER));
+
+    if ((Flags & YORI_LIB_OUTPUT_STDERR) != 0) {
+        OutputBuffer->hOutput = GetStdHandle(STD_ERROR_HANDLE);
+    } else {
+        OutputBuffer->hOutput = GetStdHandle(STD_OUTPUT_HANDLE);
+    }
+    OutputBuffer->Flags = Flags;
+
+    if (GetConsoleMode(OutputBuffer->hOutput, &CurrentMode)) {
+        OutputBuffer->OutputIsConsole = TRUE;
+        if ((Flags & YORI_LIB_OUTPUT_STRIP_VT) != 0) {
+            YoriLibConsoleNoEscapeSetFunctions(&OutputBuffer->Callbacks);
+        } else {
+            YoriLibConsoleSetFunctions(&OutputBuffer->Callbacks);
+        }
+    }
+
+    if (!YoriLibAllocateString(&OutputBuffer->Buffer, YORI_LIB_OUTPUT_BUFFER_CHARS)) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Write the contents of a buffered output stream to a device which is not a
+ console.  Line endings are converted to CRLF and escapes are removed if
+ requested, then the entire buffer is converted to the output encoding and
+ written with a single call.
+
+ @param OutputBuffer Pointer to the buffered output stream.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibOutputBufferFlushToDevice(
+    __inout PYORI_LIB_OUTPUT_BUFFER OutputBuffer
+    )
+{
+    PYORI_STRING Source;
+    PYORI_STRING Dest;
+    DWORD Index;
+    DWORD EscapeEnd;
+    DWORD BytesTransferred;
+    TCHAR Char;
+    BOOL StripEscapes;
+#ifdef UNICODE
+    DWORD BytesNeeded;
+#endif
+
+    Source = &OutputBuffer->Buffer;
+    Dest = &OutputBuffer->DeviceText;
+
+    //
+    //  In the worst case every character is a lone line ending that needs
+    //  to become two characters.
+    //
+
+    if (Dest->LengthAllocated < Source->LengthInChars * 2) {
+        YoriLibFreeStringContents(Dest);
+        if (!YoriLibAllocateString(Dest, Source->LengthAllocated * 2)) {
+            return FALSE;
+        }
+    }
+
+    StripEscapes = FALSE;
+    if ((OutputBuffer->Flags & YORI_LIB_OUTPUT_STRIP_VT) != 0) {
+        StripEscapes = TRUE;
+    }
+
+    Dest->LengthInChars = 0;
+    for (Index = 0; Index < Source->LengthInChars; Index++) {
+        Char = Source->StartOfString[Index];
+        if (Char == '\r') {
+            if (Index + 1 < Source->LengthInChars &&
+                Source->StartOfString[Index + 1] == '\n') {
+
+                Index++;
+            }
+            Dest->StartOfString[Dest->LengthInChars++] = '\r';
+            Dest->StartOfString[Dest->LengthInChars++] = '\n';
+        } else if (Char == '\n') {
+            Dest->StartOfString[Dest->LengthInChars++] = '\r';
+            Dest->StartOfString[Dest->LengthInChars++] = '\n';
+        } else if (Char == 27 && StripEscapes &&
+                   Index + 1 < Source->LengthInChars &&
+                   Source->StartOfString[Index + 1] == '[') {
+
+            //
+            //  Skip the numeric parameters and the final character.  An
+            //  incomplete escape at the end of the buffer is discarded,
+            //  consistent with unbuffered output.
+            //
+
+            for (EscapeEnd = Index + 2; EscapeEnd < Source->LengthInChars; EscapeEnd++) {
+                Char = Source->StartOfString[EscapeEnd];
+                if ((Char < '0' || Char > '9') && Char != ';') {
+                    break;
+                }
+            }
+            Index = EscapeEnd;
+        } else {
+            Dest->StartOfString[Dest->LengthInChars++] = Char;
+        }
+    }
+
+    if (Dest->LengthInChars == 0) {
+        return TRUE;
+    }
+
+#ifdef UNICODE
+    //
+    //  Convert directly into the persistent multibyte buffer.  This
+    //  normally succeeds in one pass; only when the buffer is too small
+    //  is it reallocated and the conversion repeated.
+    //
+
+    BytesNeeded = YoriLibMultibyteOutputSizeAndConvert(Dest->StartOfString,
+                                                       Dest->LengthInChars,
+                                                       OutputBuffer->MultibyteBuffer,
+                                                       OutputBuffer->MultibyteBufferLength);
+
+    if (BytesNeeded > OutputBuffer->MultibyteBufferLength) {
+        if (OutputBuffer->MultibyteBuffer != NULL) {
+            YoriLibFree(OutputBuffer->MultibyteBuffer);
+            OutputBuffer->MultibyteBufferLength = 0;
+        }
+        OutputBuffer->MultibyteBuffer = YoriLibMalloc(BytesNeeded);
+        if (OutputBuffer->MultibyteBuffer == NULL) {
+            return FALSE;
+        }
+        OutputBuffer->MultibyteBufferLength = BytesNeeded;
+
+        YoriLibMultibyteOutput(Dest->StartOfString,
+                               Dest->LengthInChars,
+                               OutputBuffer->MultibyteBuffer,
+                               BytesNeeded);
+    }
+
+    return WriteFile(OutputBuffer->hOutput, OutputBuffer->MultibyteBuffer, BytesNeeded, &BytesTransferred, NULL);
+#else
+    return WriteFile(OutputBuffer->hOutput, Dest->StartOfString, Dest->LengthInChars * sizeof(TCHAR), &BytesTransferred, NULL);
+#endif
+}
+
+/**
+ Write any text accumulated in a buffered output stream to its device.
+
+ @param OutputBuffer Pointer to the buffered output stream.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibOutputBufferFlush(
+    __inout PYORI_LIB_OUTPUT_BUFFER OutputBuffer
+    )
+{
+    BOOL Result;
+
+    if (OutputBuffer->Buffer.LengthInChars == 0) {
+        return TRUE;
+    }
+
+    if (OutputBuffer->OutputIsConsole) {
+        Result = YoriLibProcessVtEscapesOnOpenStream(OutputBuffer->Buffer.StartOfString,
+                                                     OutputBuffer->Buffer.LengthInChars,
+                                                     OutputBuffer->hOutput,
+                                                     &OutputBuffer->Callbacks);
+    } else {
+        Result = YoriLibOutputBufferFlushToDevice(OutputBuffer);
+    }
+
+    OutputBuffer->Buffer.LengthInChars = 0;
+    return Result;
+}
+
+/**
+ Write any text accumulated in a buffered output stream to its device and
+ free the resources associated with the stream.
+
+ @param OutputBuffer Pointer to the buffered output stream.
+ */
+VOID
+YoriLibOutputBufferCleanup(
+    __inout PYORI_LIB_OUTPUT_BUFFER OutputBuffer
+    )
+{
+    YoriLibOutputBufferFlush(OutputBuffer);
+    YoriLibFreeStringContents(&OutputBuffer->Buffer);
+    YoriLibFreeStringContents(&OutputBuffer->DeviceText);
+    if (OutputBuffer->MultibyteBuffer != NULL) {
+        YoriLibFree(OutputBuffer->MultibyteBuffer);
+        OutputBuffer->MultibyteBuffer = NULL;
+    }
+    OutputBuffer->MultibyteBufferLength = 0;
+}
+
+/**
+ Called after text has been added to a buffered output stream.  If the
+ device is a console and the new text completes a line, the buffer is
+ flushed so that the user sees output as it is generated.
+
+ @param OutputBuffer Pointer to the buffered output stream.
+
+ @param FirstNewChar The offset within the buffer of the first character
+        that was just added.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibOutputBufferCheckLineFlush(
+    __inout PYORI_LIB_OUTPUT_BUFFER OutputBuffer,
+    __in DWORD FirstNewChar
+    )
+{
+    DWORD Index;
+
+    if (!OutputBuffer->OutputIsConsole) {
+        return TRUE;
+    }
+
+    for (Index = OutputBuffer->Buffer.LengthInChars; Index > FirstNewChar; Index--) {
+        if (OutputBuffer->Buffer.StartOfString[Index - 1] == '\n') {
+            return YoriLibOutputBufferFlush(OutputBuffer);
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Output a printf-style formatted string to a buffered output stream.  The
+ string is formatted directly into the stream's buffer, and is only written
+ to the device when the buffer is full, when a line is completed on a
+ console, or when the stream is flushed.
+
+ @param OutputBuffer Pointer to the buffered output stream.
+
+ @param szFmt The format string, followed by appropriate arguments.
+
+ @return TRUE for success, FALSE for failure.
+ */
+BOOL
+YoriLibOutputBuffered(
+    __inout PYORI_LIB_OUTPUT_BUFFER OutputBuffer,
+    __in LPCTSTR szFmt,
+    ...
+    )
+{
+    va_list marker;
+    va_list savedmarker;
+    PYORI_STRING Buffer;
+    DWORD FirstNewChar;
+    int len;
+
+    Buffer = &OutputBuffer->Buffer;
+    va_start(marker, szFmt);
+    savedmarker = marker;
+
+    //
+    //  Try to format into the space remaining.  If it doesn't fit, flush
+    //  what's there and try again with the whole buffer.  If it still
+    //  doesn't fit, this is a single large string, so send it directly.
+    //
+
+    len = -1;
+    if (Buffer->LengthAllocated - Buffer->LengthInChars > 1) {
+        len = YoriLibVSPrintf(&Buffer->StartOfString[Buffer->LengthInChars],
+                              Buffer->LengthAllocated - Buffer->LengthInChars,
+                              szFmt,
+                              marker);
+    }
+
+    if (len < 0) {
+        if (!YoriLibOutputBufferFlush(OutputBuffer)) {
+            va_end(marker);
+            return FALSE;
+        }
+        marker = savedmarker;
+        len = YoriLibVSPrintf(Buffer->StartOfString, Buffer->LengthAllocated, szFmt, marker);
+        if (len < 0) {
+            BOOL Result;
+            marker = savedmarker;
+            Result = YoriLibOutputInternal(OutputBuffer->hOutput, OutputBuffer->Flags, szFmt, marker);
+            va_end(marker);
+            return Result;
+        }
+    }
+    va_end(marker);
+
+    FirstNewChar = Buffer->LengthInChars;
+    Buffer->LengthInChars += len;
+
+    return YoriLibOutputBufferCheckLineFlush(OutputBuffer, FirstNewChar);
+}
+
+/**
+ Output a Yori string to a buffered output stream.
+
+ @param OutputBuffer Pointer to the buffered output stream.
+
+ @param String The string to output.
+
+ @return TRUE for success, FALSE for failure.
+ */
+BOOL
+YoriLibOutputBufferString(
+    __inout PYORI_LIB_OUTPUT_BUFFER OutputBuffer,
+    __in PYORI_STRING String
+    )
+{
+    PYORI_STRING Buffer;
+    DWORD FirstNewChar;
+
+    Buffer = &OutputBuffer->Buffer;
+
+    if (String->LengthInChars > Buffer->LengthAllocated - Buffer->LengthInChars) {
+        if (!YoriLibOutputBufferFlush(OutputBuffer)) {
+            return FALSE;
+        }
+        if (String->LengthInChars > Buffer->LengthAllocated) {
+            return YoriLibOutputString(OutputBuffer->hOutput, OutputBuffer->Flags, String);
+        }
+    }
+
+    FirstNewChar = Buffer->LengthInChars;
+    memcpy(&Buffer->StartOfString[Buffer->LengthInChars], String->StartOfString, String->LengthInChars * sizeof(TCHAR));
+    Buffer->LengthInChars += String->LengthInChars;
+
+    return YoriLibOutputBufferCheckLineFlush(OutputBuffer, FirstNewChar);
+}
+
 /**
  Generate a string that is the VT100 representation for the specified Win32
  attribute.
@@ -1036,6 +1036,14 @@ typedef struct _YORI_MEMORYSTATUSEX {
 #define IO_REPARSE_TAG_SYMLINK     (0xA000000C)
 #endif
 
+#ifndef REPLACEFILE_IGNORE_MERGE_ERRORS
+/**
+ Flag to ReplaceFile indicating that failure to merge attributes or ACLs
+ from the replaced file should not prevent the replacement.
+ */
+#define REPLACEFILE_IGNORE_MERGE_ERRORS 0x00000002
+#endif
+
 #ifndef FILE_FLAG_OPEN_REPARSE_POINT
 /**
  The open flag to open a reparse point rather than any link target.
@@ -1383,6 +1391,78 @@ typedef struct _FILE_ALLOCATED_RANGE_BUFFER {
 
 #endif
 
+#ifndef FSCTL_SET_SPARSE
+/**
+ Specifies the FSCTL_SET_SPARSE numerical representation if the compilation
+ environment doesn't provide it.
+ */
+#define FSCTL_SET_SPARSE                CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 49, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#endif
+
+#ifndef FSCTL_SET_ZERO_DATA
+/**
+ Specifies the FSCTL_SET_ZERO_DATA numerical representation if the
+ compilation environment doesn't provide it.
+ */
+#define FSCTL_SET_ZERO_DATA             CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 50, METHOD_BUFFERED, FILE_WRITE_DATA)
+
+/**
+ Specifies a range of a file to set to zero, deallocating it if the file is
+ sparse.
+ */
+typedef struct _FILE_ZERO_DATA_INFORMATION {
+
+    /**
+     The beginning of the range, in bytes.
+     */
+    LARGE_INTEGER FileOffset;
+
+    /**
+     The first byte following the range, in bytes.
+     */
+    LARGE_INTEGER BeyondFinalZero;
+
+} FILE_ZERO_DATA_INFORMATION, *PFILE_ZERO_DATA_INFORMATION;
+
+#endif
+
+#ifndef FSCTL_DUPLICATE_EXTENTS_TO_FILE
+/**
+ Specifies the FSCTL_DUPLICATE_EXTENTS_TO_FILE numerical representation if
+ the compilation environment doesn't provide it.
+ */
+#define FSCTL_DUPLICATE_EXTENTS_TO_FILE CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 209, METHOD_BUFFERED, FILE_WRITE_DATA)
+
+/**
+ Describes a range of a source file whose clusters should be shared with a
+ range of the file that the request is sent to.
+ */
+typedef struct _DUPLICATE_EXTENTS_DATA {
+
+    /**
+     A handle to the source file.
+     */
+    HANDLE FileHandle;
+
+    /**
+     The offset in the source file, in bytes.
+     */
+    LARGE_INTEGER SourceFileOffset;
+
+    /**
+     The offset in the target file, in bytes.
+     */
+    LARGE_INTEGER TargetFileOffset;
+
+    /**
+     The number of bytes to share.
+     */
+    LARGE_INTEGER ByteCount;
+
+} DUPLICATE_EXTENTS_DATA, *PDUPLICATE_EXTENTS_DATA;
+
+#endif
+
 #ifndef FSCTL_GET_OBJECT_ID
 /**
  Specifies the FSCTL_GET_OBJECT_ID numerical representation if the
@@ -1570,6 +1650,51 @@ typedef USN_JOURNAL_DATA *PUSN_JOURNAL_DATA;
 
 #endif
 
+#ifndef FSCTL_ENUM_USN_DATA
+
+/**
+ Specifies the FSCTL_ENUM_USN_DATA numerical representation if the
+ compilation environment doesn't provide it.
+ */
+#define FSCTL_ENUM_USN_DATA             CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 44,  METHOD_NEITHER, FILE_ANY_ACCESS)
+#endif
+
+#ifndef FSCTL_READ_USN_JOURNAL
+
+/**
+ Specifies the FSCTL_READ_USN_JOURNAL numerical representation if the
+ compilation environment doesn't provide it.
+ */
+#define FSCTL_READ_USN_JOURNAL          CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 46,  METHOD_NEITHER, FILE_ANY_ACCESS)
+#endif
+
+#ifndef USN_REASON_FILE_DELETE
+
+/**
+ Indicates a USN record describes a file being deleted, if the compilation
+ environment doesn't provide it.
+ */
+#define USN_REASON_FILE_DELETE          (0x00000200)
+#endif
+
+#ifndef USN_REASON_RENAME_OLD_NAME
+
+/**
+ Indicates a USN record describes the name of a file before it was renamed,
+ if the compilation environment doesn't provide it.
+ */
+#define USN_REASON_RENAME_OLD_NAME      (0x00001000)
+#endif
+
+#ifndef ERROR_JOURNAL_NOT_ACTIVE
+
+/**
+ Indicates the change journal is not active on a volume, if the compilation
+ environment doesn't provide it.
+ */
+#define ERROR_JOURNAL_NOT_ACTIVE        1179L
+#endif
+
 
 #ifndef FSCTL_GET_EXTERNAL_BACKING
 
@@ -1819,6 +1944,42 @@ typedef struct _FILE_STORAGE_INFO {
 
 #endif
 
+#ifndef FILE_DISPOSITION_FLAG_POSIX_SEMANTICS
+
+/**
+ A structure used to request deletion of a file with extended options.
+ */
+typedef struct _FILE_DISPOSITION_INFO_EX {
+
+    /**
+     A combination of FILE_DISPOSITION_FLAG_* values.
+     */
+    DWORD Flags;
+} FILE_DISPOSITION_INFO_EX, *PFILE_DISPOSITION_INFO_EX;
+
+/**
+ The identifier of the request type that accepts the above structure.
+ */
+#define FileDispositionInfoEx (0x000000015)
+
+/**
+ Specifies that the file should be deleted.
+ */
+#define FILE_DISPOSITION_FLAG_DELETE                    0x00000001
+
+/**
+ Specifies that the file name should be removed as soon as the handle is
+ closed, even if other handles remain open to the file.
+ */
+#define FILE_DISPOSITION_FLAG_POSIX_SEMANTICS           0x00000002
+
+/**
+ Specifies that the file should be deleted even if it is read only.
+ */
+#define FILE_DISPOSITION_FLAG_IGNORE_READONLY_ATTRIBUTE 0x00000010
+
+#endif
+
 #ifndef IMAGE_FILE_MACHINE_AMD64
 /**
  If the compilation environment doesn't provide it, the value for an
@@ -2302,6 +2463,24 @@ typedef struct _YORI_JOB_ASSOCIATE_COMPLETION_PORT {
     HANDLE Port;
 } YORI_JOB_ASSOCIATE_COMPLETION_PORT, *PYORI_JOB_ASSOCIATE_COMPLETION_PORT;
 
+/**
+ The information class to associate a job object with a completion port.
+ */
+#define YORI_JOB_INFO_ASSOCIATE_COMPLETION_PORT (7)
+
+/**
+ A message delivered to a job's completion port indicating that a process
+ within the job has exited.  The overlapped pointer contains the process ID.
+ */
+#define YORI_JOB_MSG_EXIT_PROCESS (7)
+
+/**
+ A message delivered to a job's completion port indicating that a process
+ within the job has exited due to an unhandled exception.  The overlapped
+ pointer contains the process ID.
+ */
+#define YORI_JOB_MSG_ABNORMAL_EXIT_PROCESS (8)
+
 #ifndef HSHELL_RUDEAPPACTIVATED
 /**
  A definition for HSHELL_RUDEAPPACTIVATED if it is not defined by the current
@@ -4197,6 +4376,18 @@ CREATE_HARD_LINKW(LPWSTR, LPWSTR, PVOID);
  */
 typedef CREATE_HARD_LINKW *PCREATE_HARD_LINKW;
 
+/**
+ A prototype for the CreateIoCompletionPort function.
+ */
+typedef
+HANDLE WINAPI
+CREATE_IO_COMPLETION_PORT(HANDLE, HANDLE, DWORD_PTR, DWORD);
+
+/**
+ A prototype for a pointer to the CreateIoCompletionPort function.
+ */
+typedef CREATE_IO_COMPLETION_PORT *PCREATE_IO_COMPLETION_PORT;
+
 /**
  A prototype for the CreateJobObjectW function.
  */
@@ -4461,6 +4652,18 @@ GET_PRODUCT_INFO(DWORD, DWORD, DWORD, DWORD, PDWORD);
  */
 typedef GET_PRODUCT_INFO *PGET_PRODUCT_INFO;
 
+/**
+ A prototype for the GetQueuedCompletionStatus function.
+ */
+typedef
+BOOL WINAPI
+GET_QUEUED_COMPLETION_STATUS(HANDLE, LPDWORD, DWORD_PTR *, LPOVERLAPPED *, DWORD);
+
+/**
+ A prototype for a pointer to the GetQueuedCompletionStatus function.
+ */
+typedef GET_QUEUED_COMPLETION_STATUS *PGET_QUEUED_COMPLETION_STATUS;
+
 /**
  A prototype for the GetVersionExW function.
  */
@@ -4557,6 +4760,18 @@ REGISTER_APPLICATION_RESTART(LPCWSTR, DWORD);
  */
 typedef REGISTER_APPLICATION_RESTART *PREGISTER_APPLICATION_RESTART;
 
+/**
+ A prototype for the ReplaceFileW function.
+ */
+typedef
+BOOL WINAPI
+REPLACE_FILEW(LPCWSTR, LPCWSTR, LPCWSTR, DWORD, LPVOID, LPVOID);
+
+/**
+ A prototype for a pointer to the ReplaceFileW function.
+ */
+typedef REPLACE_FILEW *PREPLACE_FILEW;
+
 /**
  A prototype for the SetConsoleScreenBufferEx function.
  */
@@ -4581,6 +4796,18 @@ SET_CURRENT_CONSOLE_FONT_EX(HANDLE, BOOL, PYORI_CONSOLE_FONT_INFOEX);
  */
 typedef SET_CURRENT_CONSOLE_FONT_EX *PSET_CURRENT_CONSOLE_FONT_EX;
 
+/**
+ A prototype for the SetFileInformationByHandle function.
+ */
+typedef
+BOOL WINAPI
+SET_FILE_INFORMATION_BY_HANDLE(HANDLE, DWORD, PVOID, DWORD);
+
+/**
+ A prototype for a pointer to the SetFileInformationByHandle function.
+ */
+typedef SET_FILE_INFORMATION_BY_HANDLE *PSET_FILE_INFORMATION_BY_HANDLE;
+
 /**
  A prototype for the SetInformationJobObject function.
  */
@@ -4655,6 +4882,11 @@ typedef struct _YORI_KERNEL32_FUNCTIONS {
      */
     PCREATE_HARD_LINKW pCreateHardLinkW;
 
+    /**
+     If it's available on the current system, a pointer to CreateIoCompletionPort.
+     */
+    PCREATE_IO_COMPLETION_PORT pCreateIoCompletionPort;
+
     /**
      If it's available on the current system, a pointer to CreateJobObjectW.
      */
@@ -4765,6 +4997,11 @@ typedef struct _YORI_KERNEL32_FUNCTIONS {
      */
     PGET_PRODUCT_INFO pGetProductInfo;
 
+    /**
+     If it's available on the current system, a pointer to GetQueuedCompletionStatus.
+     */
+    PGET_QUEUED_COMPLETION_STATUS pGetQueuedCompletionStatus;
+
     /**
      If it's available on the current system, a pointer to GetVersionExW.
      */
@@ -4805,6 +5042,11 @@ typedef struct _YORI_KERNEL32_FUNCTIONS {
      */
     PREGISTER_APPLICATION_RESTART pRegisterApplicationRestart;
 
+    /**
+     If it's available on the current system, a pointer to ReplaceFileW.
+     */
+    PREPLACE_FILEW pReplaceFileW;
+
     /**
      If it's available on the current system, a pointer to SetConsoleScreenBufferInfoEx.
      */
@@ -4815,6 +5057,11 @@ typedef struct _YORI_KERNEL32_FUNCTIONS {
      */
     PSET_CURRENT_CONSOLE_FONT_EX pSetCurrentConsoleFontEx;
 
+    /**
+     If it's available on the current system, a pointer to SetFileInformationByHandle.
+     */
+    PSET_FILE_INFORMATION_BY_HANDLE pSetFileInformationByHandle;
+
     /**
      If it's available on the current system, a pointer to SetInformationJobObject.
      */
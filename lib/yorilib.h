@@ -665,6 +665,29 @@ YoriLibGetMetadataColor(
     __out PYORILIB_COLOR_ATTRIBUTES Color
     );
 
+// *** COPYRNG.C ***
+
+/**
+ An offset to YoriLibCopyRange indicating that the copy should begin at the
+ current position of the handle.
+ */
+#define YORI_LIB_COPY_RANGE_CURRENT_OFFSET ((LONGLONG)-1)
+
+/**
+ A length to YoriLibCopyRange indicating that data should be copied until
+ the source indicates no more is available.
+ */
+#define YORI_LIB_COPY_RANGE_TO_END ((LONGLONG)-1)
+
+BOOL
+YoriLibCopyRange(
+    __in HANDLE SourceHandle,
+    __in LONGLONG SourceOffset,
+    __in HANDLE DestHandle,
+    __in LONGLONG DestOffset,
+    __in LONGLONG Length
+    );
+
 // *** CSHOT.C ***
 
 BOOL
@@ -1047,6 +1070,95 @@ YoriLibForEachFile(
     __in PVOID Context
     );
 
+/**
+ A run of characters within a compiled file match expression which does not
+ contain any '*' characters.
+ */
+typedef struct _YORI_LIB_FILE_MATCH_SEGMENT {
+
+    /**
+     Pointer to the characters in the segment, converted to uppercase.
+     */
+    LPTSTR Text;
+
+    /**
+     The number of characters in the segment.
+     */
+    DWORD Length;
+
+    /**
+     TRUE if the segment contains a '?' which matches any character.
+     */
+    BOOL ContainsAny;
+
+} YORI_LIB_FILE_MATCH_SEGMENT, *PYORI_LIB_FILE_MATCH_SEGMENT;
+
+/**
+ A wildcard expression which has been parsed so that it can be compared
+ against many file names.
+ */
+typedef struct _YORI_LIB_FILE_MATCH_EXPRESSION {
+
+    /**
+     The referenced allocation backing the segments, or NULL if the segments
+     are not allocated.
+     */
+    PVOID MemoryToFree;
+
+    /**
+     An array of segments, being the runs of characters between '*'
+     characters.
+     */
+    PYORI_LIB_FILE_MATCH_SEGMENT Segments;
+
+    /**
+     The number of elements in Segments.
+     */
+    DWORD SegmentCount;
+
+    /**
+     The minimum length of a file name that can match the expression, being
+     the total length of all segments.
+     */
+    DWORD MinimumLength;
+
+    /**
+     TRUE if the expression contains any '*'.  If FALSE, the expression
+     consists of a single segment which must match the entire name.
+     */
+    BOOLEAN ContainsStar;
+
+    /**
+     TRUE if the expression does not begin with '*', so the first segment
+     must match at the beginning of the name.
+     */
+    BOOLEAN AnchorStart;
+
+    /**
+     TRUE if the expression does not end with '*', so the final segment must
+     match at the end of the name.
+     */
+    BOOLEAN AnchorEnd;
+
+} YORI_LIB_FILE_MATCH_EXPRESSION, *PYORI_LIB_FILE_MATCH_EXPRESSION;
+
+BOOL
+YoriLibCompileFileMatchExpression(
+    __in PYORI_STRING Wildcard,
+    __out PYORI_LIB_FILE_MATCH_EXPRESSION Expression
+    );
+
+VOID
+YoriLibFreeFileMatchExpression(
+    __inout PYORI_LIB_FILE_MATCH_EXPRESSION Expression
+    );
+
+BOOL
+YoriLibDoesFileMatchCompiledExpression(
+    __in PYORI_STRING FileName,
+    __in PYORI_LIB_FILE_MATCH_EXPRESSION Expression
+    );
+
 BOOL
 YoriLibDoesFileMatchExpression (
     __in PYORI_STRING FileName,
@@ -1075,6 +1187,13 @@ typedef struct _YORI_LIB_FILE_FILTER {
      An array of criteria to apply.
      */
     PVOID Criteria;
+
+    /**
+     For color filters, an opaque compiled form of the criteria which allows
+     runs of exact file name or extension matches to be resolved with a
+     single hash lookup.  This is NULL if no criteria could be compiled.
+     */
+    PVOID Compiled;
 } YORI_LIB_FILE_FILTER, *PYORI_LIB_FILE_FILTER;
 
 /**
@@ -1176,6 +1295,13 @@ YoriLibFileFiltCheckColorMatch(
     __out PYORILIB_COLOR_ATTRIBUTES Attribute
     );
 
+DWORD
+YoriLibFileFiltNextColorMatch(
+    __in PYORI_LIB_FILE_FILTER Filter,
+    __in PYORI_FILE_INFO Entry,
+    __in DWORD StartIndex
+    );
+
 VOID
 YoriLibFileFiltFreeFilter(
     __in PYORI_LIB_FILE_FILTER Filter
@@ -1188,6 +1314,55 @@ YoriLibUpdateFindDataFromFileInformation (
     __in BOOL CopyName
     );
 
+// *** FILEHASH.C ***
+
+/**
+ A hash algorithm provider which can be used to hash file contents.
+ */
+typedef struct _YORI_LIB_FILE_HASH_ALGORITHM {
+
+    /**
+     BCrypt handle to the algorithm provider.  If NULL, the algorithm
+     provider has not been initialized.
+     */
+    PVOID Algorithm;
+
+    /**
+     The number of bytes in a hash generated by this algorithm.
+     */
+    DWORD HashLength;
+
+    /**
+     The number of bytes of scratch space that BCrypt needs while generating
+     a hash.  Each concurrent hash requires its own scratch space.
+     */
+    DWORD ScratchBufferLength;
+
+} YORI_LIB_FILE_HASH_ALGORITHM, *PYORI_LIB_FILE_HASH_ALGORITHM;
+
+LONG
+YoriLibFileHashOpenAlgorithm(
+    __in LPCWSTR AlgorithmName,
+    __out PYORI_LIB_FILE_HASH_ALGORITHM Algorithm
+    );
+
+VOID
+YoriLibFileHashCloseAlgorithm(
+    __inout PYORI_LIB_FILE_HASH_ALGORITHM Algorithm
+    );
+
+BOOL
+YoriLibFileHashStream(
+    __in PYORI_LIB_FILE_HASH_ALGORITHM Algorithm,
+    __in HANDLE hSource,
+    __in DWORDLONG MaximumLength,
+    __in PVOID ScratchBuffer,
+    __in PVOID ReadBuffer,
+    __in DWORD ReadBufferLength,
+    __out PUCHAR HashBuffer,
+    __out_opt PDWORDLONG BytesHashed
+    );
+
 // *** FILEINFO.C ***
 
 /**
@@ -1260,6 +1435,12 @@ YoriLibIsExecutableGui(
     __in PYORI_STRING FullPath
     );
 
+BOOL
+YoriLibInitPeMetadataCache();
+
+VOID
+YoriLibFreePeMetadataCache();
+
 BOOL
 YoriLibCollectAccessTime (
     __inout PYORI_FILE_INFO Entry,
@@ -1858,6 +2039,42 @@ YoriLibGenerateWriteTime(
  */
 #define YoriLibIsSep(x) ((x) == '\\' || (x) == '/')
 
+/**
+ A value for EffectiveRootLength indicating that the root of a parent path
+ depends on the child appended to it.
+ */
+#define YORI_LIB_FULL_PATH_ROOT_PER_CHILD ((DWORD)-1)
+
+/**
+ Information about a full path parent directory that many child names will
+ be resolved against.
+ */
+typedef struct _YORI_LIB_FULL_PATH_PARENT {
+
+    /**
+     The full path of the parent.  This refers to the caller's string and
+     does not hold a reference on it.
+     */
+    YORI_STRING Path;
+
+    /**
+     TRUE if the parent is in \\?\ form.
+     */
+    BOOL PathHasPrefix;
+
+    /**
+     TRUE if the parent refers to a UNC share.
+     */
+    BOOL PathIsUnc;
+
+    /**
+     The number of characters at the start of the path that cannot be
+     traversed above, or YORI_LIB_FULL_PATH_ROOT_PER_CHILD.
+     */
+    DWORD EffectiveRootLength;
+
+} YORI_LIB_FULL_PATH_PARENT, *PYORI_LIB_FULL_PATH_PARENT;
+
 BOOL
 YoriLibGetCurrentDirectoryOnDrive(
     __in TCHAR Drive,
@@ -1918,6 +2135,20 @@ YoriLibGetFullPathNameRelativeTo(
     __deref_opt_out LPTSTR* lpFilePart
     );
 
+BOOL
+YoriLibFullPathInitializeParent(
+    __in PYORI_STRING ParentPath,
+    __out PYORI_LIB_FULL_PATH_PARENT Parent
+    );
+
+BOOL
+YoriLibFullPathResolveChild(
+    __in PYORI_LIB_FULL_PATH_PARENT Parent,
+    __in PYORI_STRING ChildName,
+    __inout PYORI_STRING Buffer,
+    __deref_opt_out LPTSTR* lpFilePart
+    );
+
 BOOL
 YoriLibExpandHomeDirectories(
     __in PYORI_STRING FileString,
@@ -2131,6 +2362,38 @@ YoriLibMultibyteInput(
     __in DWORD OutputBufferLength
     );
 
+DWORD
+YoriLibMultibyteOutputSizeAndConvert(
+    __in LPCTSTR InputStringBuffer,
+    __in DWORD InputBufferLength,
+    __out_opt LPSTR OutputStringBuffer,
+    __in DWORD OutputBufferLength
+    );
+
+DWORD
+YoriLibMultibyteInputSizeAndConvert(
+    __in LPCSTR InputStringBuffer,
+    __in DWORD InputBufferLength,
+    __out_opt LPTSTR OutputStringBuffer,
+    __in DWORD OutputBufferLength
+    );
+
+DWORD
+YoriLibUtf16ToUtf8(
+    __in LPCWSTR InputStringBuffer,
+    __in DWORD InputBufferLength,
+    __out_opt LPSTR OutputStringBuffer,
+    __in DWORD OutputBufferLength
+    );
+
+DWORD
+YoriLibUtf8ToUtf16(
+    __in LPCSTR InputStringBuffer,
+    __in DWORD InputBufferLength,
+    __out_opt LPWSTR OutputStringBuffer,
+    __in DWORD OutputBufferLength
+    );
+
 // *** JOBOBJ.C ***
 
 HANDLE
@@ -2149,6 +2412,18 @@ YoriLibLimitJobObjectPriority(
     __in DWORD Priority
     );
 
+BOOL
+YoriLibAllowSilentJobObjectBreakaway(
+    __in HANDLE hJob
+    );
+
+BOOL
+YoriLibAssociateJobObjectWithCompletionPort(
+    __in HANDLE hJob,
+    __in HANDLE hPort,
+    __in PVOID Key
+    );
+
 // *** LICENSE.C ***
 
 BOOL
@@ -2187,6 +2462,11 @@ YoriLibLineReadClose(
     __in PVOID Context
     );
 
+VOID
+YoriLibLineReadResume(
+    __in PVOID Context
+    );
+
 // *** LIST.C ***
 
 VOID
@@ -2279,6 +2559,12 @@ YoriLibDoesProcessHave32BitPeb(
 
 // *** RECYCLE.C ***
 
+BOOL
+YoriLibRecycleBinFiles(
+    __in DWORD FileCount,
+    __in PYORI_STRING FilePaths
+    );
+
 BOOL
 YoriLibRecycleBinFile(
     __in PYORI_STRING FilePath
@@ -2402,6 +2688,65 @@ typedef struct _YORI_LIB_VT_CALLBACK_FUNCTIONS {
 
 } YORI_LIB_VT_CALLBACK_FUNCTIONS, *PYORI_LIB_VT_CALLBACK_FUNCTIONS;
 
+/**
+ The number of characters to accumulate in a buffered output stream before
+ writing it to the underlying device.
+ */
+#define YORI_LIB_OUTPUT_BUFFER_CHARS (32 * 1024)
+
+/**
+ A buffered output stream.  This records the capabilities of a device once
+ so that many small formatted writes can be combined into a single write to
+ the device.
+ */
+typedef struct _YORI_LIB_OUTPUT_BUFFER {
+
+    /**
+     Handle to the device to write to.
+     */
+    HANDLE hOutput;
+
+    /**
+     YORI_LIB_OUTPUT_* flags describing the behavior of the stream.
+     */
+    DWORD Flags;
+
+    /**
+     TRUE if the device is a console.  Output to a console is flushed at the
+     end of each line so that it is visible in a timely manner.
+     */
+    BOOL OutputIsConsole;
+
+    /**
+     The callback functions used to output text to a console.  For other
+     devices, text is converted in a single pass when the buffer is flushed.
+     */
+    YORI_LIB_VT_CALLBACK_FUNCTIONS Callbacks;
+
+    /**
+     Formatted text which has not yet been written to the device.
+     */
+    YORI_STRING Buffer;
+
+    /**
+     A buffer used when flushing to a non-console device to hold the text
+     after line endings have been normalized and any escapes removed.
+     */
+    YORI_STRING DeviceText;
+
+    /**
+     A buffer used when flushing to a non-console device to hold the text
+     after conversion to the output encoding.
+     */
+    LPSTR MultibyteBuffer;
+
+    /**
+     The size of MultibyteBuffer, in bytes.
+     */
+    DWORD MultibyteBufferLength;
+
+} YORI_LIB_OUTPUT_BUFFER, *PYORI_LIB_OUTPUT_BUFFER;
+
 BOOL
 YoriLibConsoleSetFunctions(
     __out PYORI_LIB_VT_CALLBACK_FUNCTIONS CallbackFunctions
@@ -2452,6 +2797,35 @@ YoriLibOutputString(
     __in PYORI_STRING String
     );
 
+BOOL
+YoriLibOutputBufferInitialize(
+    __out PYORI_LIB_OUTPUT_BUFFER OutputBuffer,
+    __in DWORD Flags
+    );
+
+BOOL
+YoriLibOutputBufferFlush(
+    __inout PYORI_LIB_OUTPUT_BUFFER OutputBuffer
+    );
+
+VOID
+YoriLibOutputBufferCleanup(
+    __inout PYORI_LIB_OUTPUT_BUFFER OutputBuffer
+    );
+
+BOOL
+YoriLibOutputBuffered(
+    __inout PYORI_LIB_OUTPUT_BUFFER OutputBuffer,
+    __in LPCTSTR szFmt,
+    ...
+    );
+
+BOOL
+YoriLibOutputBufferString(
+    __inout PYORI_LIB_OUTPUT_BUFFER OutputBuffer,
+    __in PYORI_STRING String
+    );
+
 BOOL
 YoriLibVtSetConsoleTextAttributeOnDevice(
     __in HANDLE hOut,
@@ -2558,6 +2932,78 @@ YoriLibLocateExecutableInPath(
 
 // *** PRINTF.C ***
 
+/**
+ A single element of a compiled printf format string.  An element is either
+ a run of literal text, or a single substitution with its modifiers.
+ */
+typedef struct _YORI_LIB_PRINTF_ELEMENT {
+
+    /**
+     If Specifier is zero, points to literal text to copy into the output.
+     */
+    LPCTSTR Literal;
+
+    /**
+     If Specifier is zero, the number of characters of literal text.
+     */
+    DWORD LiteralLength;
+
+    /**
+     The field width of the substitution, or (DWORD)-1 if no width was
+     specified.
+     */
+    DWORD ElementLength;
+
+    /**
+     The format character of the substitution, such as 'i' or 'y', or zero
+     if this element describes literal text.
+     */
+    TCHAR Specifier;
+
+    /**
+     TRUE if numeric values should be padded with zeroes rather than spaces.
+     */
+    BOOLEAN LeadingZero;
+
+    /**
+     TRUE if the value should be aligned to the left of its field.
+     */
+    BOOLEAN LeftAlign;
+
+    /**
+     TRUE if the 'h' modifier was specified.
+     */
+    BOOLEAN ShortPrefix;
+
+    /**
+     TRUE if the 'l' modifier was specified.
+     */
+    BOOLEAN LongPrefix;
+
+    /**
+     TRUE if the 'll' modifier was specified, or the value is a 64 bit
+     pointer.
+     */
+    BOOLEAN LongLongPrefix;
+} YORI_LIB_PRINTF_ELEMENT, *PYORI_LIB_PRINTF_ELEMENT;
+
+/**
+ A printf format string which has been parsed once so that it can be
+ applied repeatedly without parsing it again.
+ */
+typedef struct _YORI_LIB_PRINTF_FORMAT {
+
+    /**
+     The number of elements in the Elements array.
+     */
+    DWORD ElementCount;
+
+    /**
+     An array of elements describing the format string.
+     */
+    PYORI_LIB_PRINTF_ELEMENT Elements;
+} YORI_LIB_PRINTF_FORMAT, *PYORI_LIB_PRINTF_FORMAT;
+
 int
 YoriLibSPrintf(
     __out LPTSTR szDest,
@@ -2635,6 +3081,74 @@ YoriLibYPrintf(
     ...
     );
 
+BOOL
+YoriLibPrintfGrowDest(
+    __inout PYORI_STRING Dest,
+    __in DWORD CharsUsed,
+    __out LPTSTR * Buffer,
+    __out PDWORD BufferLength
+    );
+
+/**
+ Process a printf format string and output the result into a Yori string,
+ reallocating the string as needed so the result is generated in a single
+ pass.
+
+ @param Dest The string to populate with the result.
+
+ @param szFmt The format string to process.
+
+ @param marker The existing va_args context to use to find variables to 
+        substitute in the format string.
+
+ @return The number of characters successfully populated into the buffer, or
+         -1 on error.
+ */
+int
+YoriLibVYPrintf(
+    __inout PYORI_STRING Dest,
+    __in LPCTSTR szFmt,
+    __in va_list marker
+    );
+
+/**
+ Apply a previously compiled printf format to a set of arguments and output
+ the result into a Yori string, reallocating the string as needed.
+
+ @param Dest The string to populate with the result.
+
+ @param Format The compiled format to apply.
+
+ @param marker The existing va_args context to use to find variables to 
+        substitute in the format string.
+
+ @return The number of characters successfully populated into the buffer, or
+         -1 on error.
+ */
+int
+YoriLibVYPrintfCompiled(
+    __inout PYORI_STRING Dest,
+    __in PYORI_LIB_PRINTF_FORMAT Format,
+    __in va_list marker
+    );
+
+PYORI_LIB_PRINTF_FORMAT
+YoriLibPrintfCompileFormat(
+    __in LPCTSTR szFmt
+    );
+
+VOID
+YoriLibPrintfFreeFormat(
+    __in PYORI_LIB_PRINTF_FORMAT Format
+    );
+
+int
+YoriLibYPrintfCompiled(
+    __inout PYORI_STRING Dest,
+    __in PYORI_LIB_PRINTF_FORMAT Format,
+    ...
+    );
+
 // *** ENV.C ***
 
 BOOL
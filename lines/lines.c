@@ -91,6 +91,12 @@ typedef struct _LINES_CONTEXT {
      Records the total number of lines processed for all files.
      */
     LONGLONG TotalLinesFound;
+
+    /**
+     Buffered output stream used to combine per file results into larger
+     writes.
+     */
+    YORI_LIB_OUTPUT_BUFFER Output;
 } LINES_CONTEXT, *PLINES_CONTEXT;
 
 /**
@@ -196,7 +202,7 @@ LinesFileFoundCallback(
             YoriLibNumberToString(&StringFormOfLineCount, LinesContext->FileLinesFound, 10, 3, ',');
             YoriLibInitEmptyString(&UnescapedFilePath);
             YoriLibUnescapePath(FilePath, &UnescapedFilePath);
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%16y %y\n"), &StringFormOfLineCount, &UnescapedFilePath);
+            YoriLibOutputBuffered(&LinesContext->Output, _T("%16y %y\n"), &StringFormOfLineCount, &UnescapedFilePath);
             YoriLibFreeStringContents(&StringFormOfLineCount);
             YoriLibFreeStringContents(&UnescapedFilePath);
         }
@@ -348,6 +354,12 @@ ENTRYPOINT(
     YoriLibCancelEnable();
 #endif
 
+    if (!YoriLibOutputBufferInitialize(&LinesContext.Output, YORI_LIB_OUTPUT_STDOUT)) {
+        YoriLibOutputBufferCleanup(&LinesContext.Output);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("lines: out of memory\n"));
+        return EXIT_FAILURE;
+    }
+
     //
     //  If no file name is specified, use stdin; otherwise open
     //  the file and use that
@@ -355,6 +367,7 @@ ENTRYPOINT(
 
     if (StartArg == 0 || StartArg == ArgC) {
         if (YoriLibIsStdInConsole()) {
+            YoriLibOutputBufferCleanup(&LinesContext.Output);
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("No file or pipe for input\n"));
             return EXIT_FAILURE;
         }
@@ -393,6 +406,8 @@ ENTRYPOINT(
         }
     }
 
+    YoriLibOutputBufferCleanup(&LinesContext.Output);
+
     if (LinesContext.FilesFound == 0) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("lines: no matching files found\n"));
         return EXIT_FAILURE;
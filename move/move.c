@@ -66,6 +66,18 @@ typedef struct _MOVE_CONTEXT {
      */
     YORI_STRING Dest;
 
+    /**
+     Information about Dest, when it is a directory, allowing the names of
+     each object to be resolved against it without reparsing it.  Only
+     meaningful if DestParentValid is TRUE.
+     */
+    YORI_LIB_FULL_PATH_PARENT DestParent;
+
+    /**
+     If TRUE, DestParent has been initialized from Dest.
+     */
+    BOOL DestParentValid;
+
     /**
      The file system attributes of the destination.  Used to determine if
      the destination exists and is a directory.
@@ -117,14 +129,32 @@ MoveFileFoundCallback(
 
     if (MoveContext->DestAttributes & FILE_ATTRIBUTE_DIRECTORY) {
         YORI_STRING DestWithFile;
-        if (!YoriLibAllocateString(&DestWithFile, MoveContext->Dest.LengthInChars + 1 + _tcslen(FileInfo->cFileName) + 1)) {
-            return FALSE;
+        YORI_STRING FileName;
+
+        //
+        //  If the destination is already a full path, resolve the file name
+        //  against it directly into the target buffer.
+        //
+
+        YoriLibConstantString(&FileName, FileInfo->cFileName);
+        if (MoveContext->DestParentValid) {
+            if (YoriLibAllocateString(&FullDest, MoveContext->Dest.LengthInChars + 1 + FileName.LengthInChars + 1) &&
+                !YoriLibFullPathResolveChild(&MoveContext->DestParent, &FileName, &FullDest, NULL)) {
+
+                YoriLibFreeStringContents(&FullDest);
+            }
         }
-        DestWithFile.LengthInChars = YoriLibSPrintf(DestWithFile.StartOfString, _T("%y\\%s"), &MoveContext->Dest, FileInfo->cFileName);
-        if (!YoriLibGetFullPathNameReturnAllocation(&DestWithFile, TRUE, &FullDest, NULL)) {
-            return FALSE;
+
+        if (FullDest.StartOfString == NULL) {
+            if (!YoriLibAllocateString(&DestWithFile, MoveContext->Dest.LengthInChars + 1 + FileName.LengthInChars + 1)) {
+                return FALSE;
+            }
+            DestWithFile.LengthInChars = YoriLibSPrintf(DestWithFile.StartOfString, _T("%y\\%y"), &MoveContext->Dest, &FileName);
+            if (!YoriLibGetFullPathNameReturnAllocation(&DestWithFile, TRUE, &FullDest, NULL)) {
+                return FALSE;
+            }
+            YoriLibFreeStringContents(&DestWithFile);
         }
-        YoriLibFreeStringContents(&DestWithFile);
     } else {
         if (!YoriLibGetFullPathNameReturnAllocation(&MoveContext->Dest, TRUE, &FullDest, NULL)) {
             return FALSE;
@@ -326,6 +356,12 @@ ENTRYPOINT(
     if (MoveContext.DestAttributes == 0xFFFFFFFF) {
         MoveContext.DestAttributes = 0;
     }
+    MoveContext.DestParentValid = FALSE;
+    if ((MoveContext.DestAttributes & FILE_ATTRIBUTE_DIRECTORY) &&
+        YoriLibIsPathPrefixed(&MoveContext.Dest)) {
+
+        MoveContext.DestParentValid = YoriLibFullPathInitializeParent(&MoveContext.Dest, &MoveContext.DestParent);
+    }
     MoveContext.FilesMoved = 0;
     FilesProcessed = 0;
 
@@ -227,10 +227,10 @@ typedef struct _YORIPKG_MATCH_ITEM {
     YORI_LIST_ENTRY MatchList;
 
     /**
-     A string describing the object to match, which may include
+     The compiled form of the object to match, which may include
      wildcards.
      */
-    YORI_STRING MatchCriteria;
+    YORI_LIB_FILE_MATCH_EXPRESSION MatchCriteria;
 } YORIPKG_MATCH_ITEM, *PYORIPKG_MATCH_ITEM;
 
 /**
@@ -283,18 +283,17 @@ YoriPkgCreateSourceAddMatch(
     )
 {
     PYORIPKG_MATCH_ITEM MatchItem;
-    MatchItem = YoriLibReferencedMalloc(sizeof(YORIPKG_MATCH_ITEM) + (NewCriteria->LengthInChars + 1) * sizeof(TCHAR));
+    MatchItem = YoriLibReferencedMalloc(sizeof(YORIPKG_MATCH_ITEM));
 
     if (MatchItem == NULL) {
         return FALSE;
     }
 
     ZeroMemory(MatchItem, sizeof(YORIPKG_MATCH_ITEM));
-    MatchItem->MatchCriteria.StartOfString = (LPTSTR)(MatchItem + 1);
-    MatchItem->MatchCriteria.LengthInChars = NewCriteria->LengthInChars;
-    MatchItem->MatchCriteria.LengthAllocated = NewCriteria->LengthInChars + 1;
-    memcpy(MatchItem->MatchCriteria.StartOfString, NewCriteria->StartOfString, MatchItem->MatchCriteria.LengthInChars * sizeof(TCHAR));
-    MatchItem->MatchCriteria.StartOfString[MatchItem->MatchCriteria.LengthInChars] = '\0';
+    if (!YoriLibCompileFileMatchExpression(NewCriteria, &MatchItem->MatchCriteria)) {
+        YoriLibDereference(MatchItem);
+        return FALSE;
+    }
     YoriLibAppendList(List, &MatchItem->MatchList);
     return TRUE;
 }
@@ -317,6 +316,7 @@ YoriPkgCreateSourceFreeMatchLists(
     while (ListEntry != NULL) {
         MatchItem = CONTAINING_RECORD(ListEntry, YORIPKG_MATCH_ITEM, MatchList);
         YoriLibRemoveListItem(&MatchItem->MatchList);
+        YoriLibFreeFileMatchExpression(&MatchItem->MatchCriteria);
         YoriLibDereference(MatchItem);
         ListEntry = YoriLibGetNextListEntry(&CreateSourceContext->ExcludeList, NULL);
     }
@@ -325,6 +325,7 @@ YoriPkgCreateSourceFreeMatchLists(
     while (ListEntry != NULL) {
         MatchItem = CONTAINING_RECORD(ListEntry, YORIPKG_MATCH_ITEM, MatchList);
         YoriLibRemoveListItem(&MatchItem->MatchList);
+        YoriLibFreeFileMatchExpression(&MatchItem->MatchCriteria);
         YoriLibDereference(MatchItem);
         ListEntry = YoriLibGetNextListEntry(&CreateSourceContext->IncludeList, NULL);
     }
@@ -354,12 +355,12 @@ YoriPkgCreateSourceShouldExclude(
     ListEntry = YoriLibGetNextListEntry(&CreateSourceContext->ExcludeList, NULL);
     while (ListEntry != NULL) {
         MatchItem = CONTAINING_RECORD(ListEntry, YORIPKG_MATCH_ITEM, MatchList);
-        if (YoriLibDoesFileMatchExpression(RelativeSourcePath, &MatchItem->MatchCriteria)) {
+        if (YoriLibDoesFileMatchCompiledExpression(RelativeSourcePath, &MatchItem->MatchCriteria)) {
 
             ListEntry = YoriLibGetNextListEntry(&CreateSourceContext->IncludeList, NULL);
             while (ListEntry != NULL) {
                 MatchItem = CONTAINING_RECORD(ListEntry, YORIPKG_MATCH_ITEM, MatchList);
-                if (YoriLibDoesFileMatchExpression(RelativeSourcePath, &MatchItem->MatchCriteria)) {
+                if (YoriLibDoesFileMatchCompiledExpression(RelativeSourcePath, &MatchItem->MatchCriteria)) {
                     return FALSE;
                 }
                 ListEntry = YoriLibGetNextListEntry(&CreateSourceContext->IncludeList, ListEntry);
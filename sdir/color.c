@@ -451,24 +451,31 @@ SdirApplyAttribute(
                 SdirGlobal.FileColorCriteria.NumberCriteria == 0) ||
                SdirGlobal.FileColorCriteria.ElementSize == sizeof(YORI_LIB_FILE_FILT_COLOR_CRITERIA));
         ColorsToApply = (PYORI_LIB_FILE_FILT_COLOR_CRITERIA)SdirGlobal.FileColorCriteria.Criteria;
-        for (Index = 0; Index < SdirGlobal.FileColorCriteria.NumberCriteria; Index++) {
+
+        //
+        //  All information about the file has already been collected, so
+        //  let the library find each matching criteria, which allows it to
+        //  use its compiled form of the criteria.
+        //
+
+        Index = YoriLibFileFiltNextColorMatch(&SdirGlobal.FileColorCriteria, DirEnt, 0);
+        while (Index < SdirGlobal.FileColorCriteria.NumberCriteria) {
             ThisApply = &ColorsToApply[Index];
-            if (ThisApply->Match.TruthStates[ThisApply->Match.CompareFn(DirEnt, &ThisApply->Match.CompareEntry)]) {
-                ThisAttribute = YoriLibCombineColors(ThisAttribute, ThisApply->Color);
-                if ((ThisAttribute.Ctrl & YORILIB_ATTRCTRL_CONTINUE) == 0) {
-    
-                    ThisAttribute = YoriLibResolveWindowColorComponents(ThisAttribute, Opts->PreviousAttributes, FALSE);
-    
-                    if (ThisAttribute.Ctrl & YORILIB_ATTRCTRL_INVERT) {
-                        ThisAttribute.Win32Attr = (UCHAR)(((ThisAttribute.Win32Attr & 0x0F) << 4) + ((ThisAttribute.Win32Attr & 0xF0) >> 4));
-                    }
-    
-                    *Attribute = ThisAttribute;
-                    return TRUE;
+            ThisAttribute = YoriLibCombineColors(ThisAttribute, ThisApply->Color);
+            if ((ThisAttribute.Ctrl & YORILIB_ATTRCTRL_CONTINUE) == 0) {
+
+                ThisAttribute = YoriLibResolveWindowColorComponents(ThisAttribute, Opts->PreviousAttributes, FALSE);
+
+                if (ThisAttribute.Ctrl & YORILIB_ATTRCTRL_INVERT) {
+                    ThisAttribute.Win32Attr = (UCHAR)(((ThisAttribute.Win32Attr & 0x0F) << 4) + ((ThisAttribute.Win32Attr & 0xF0) >> 4));
                 }
-    
-                ThisAttribute.Ctrl = (UCHAR)(ThisAttribute.Ctrl & ~(YORILIB_ATTRCTRL_CONTINUE));
+
+                *Attribute = ThisAttribute;
+                return TRUE;
             }
+
+            ThisAttribute.Ctrl = (UCHAR)(ThisAttribute.Ctrl & ~(YORILIB_ATTRCTRL_CONTINUE));
+            Index = YoriLibFileFiltNextColorMatch(&SdirGlobal.FileColorCriteria, DirEnt, Index + 1);
         }
     }
 
@@ -36,7 +36,10 @@
 //
 
 /**
- Write a specified number of characters to the output device.
+ Write a specified number of characters to the output device.  Text is
+ accumulated in a buffered output stream and written to the device when
+ the buffer fills, when a line is completed on a console, or when
+ SdirFlushOutput is called.
 
  @param hConsole Handle to the output device.
 
@@ -54,11 +57,38 @@ SdirWriteRawStringToOutputDevice(
     )
 {
     YORI_STRING String;
+    PYORI_LIB_OUTPUT_BUFFER OutputBuffer;
+
     YoriLibInitEmptyString(&String);
     String.StartOfString = (LPTSTR)OutputString;
     String.LengthInChars = Length;
 
-    return YoriLibOutputString(hConsole, 0, &String);
+    OutputBuffer = &SdirGlobal.OutputBuffer;
+    if (OutputBuffer->Buffer.StartOfString == NULL) {
+        if (!YoriLibOutputBufferInitialize(OutputBuffer, YORI_LIB_OUTPUT_STDOUT)) {
+            YoriLibOutputBufferCleanup(OutputBuffer);
+        }
+    }
+
+    if (OutputBuffer->Buffer.StartOfString == NULL ||
+        OutputBuffer->hOutput != hConsole) {
+
+        return YoriLibOutputString(hConsole, 0, &String);
+    }
+
+    return YoriLibOutputBufferString(OutputBuffer, &String);
+}
+
+/**
+ Write any text which has been buffered to the output device.  This is
+ required before querying the state of the console or waiting for input.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+SdirFlushOutput()
+{
+    return YoriLibOutputBufferFlush(&SdirGlobal.OutputBuffer);
 }
 
 /**
@@ -89,7 +119,25 @@ SdirSetConsoleTextAttribute(
 
     SdirCurrentAttribute = Attribute;
 
-    return YoriLibVtSetConsoleTextAttributeOnDevice(hConsole, 0, 0, Attribute.Win32Attr);
+    {
+        TCHAR OutputStringBuffer[YORI_MAX_INTERNAL_VT_ESCAPE_CHARS];
+        YORI_STRING OutputString;
+
+        YoriLibInitEmptyString(&OutputString);
+        OutputString.StartOfString = OutputStringBuffer;
+        OutputString.LengthAllocated = sizeof(OutputStringBuffer)/sizeof(OutputStringBuffer[0]);
+
+        //
+        //  Generate the escape and send it through the same buffer as the
+        //  text so that the two remain in order.
+        //
+
+        if (!YoriLibVtStringForTextAttribute(&OutputString, 0, Attribute.Win32Attr)) {
+            return FALSE;
+        }
+
+        return SdirWriteRawStringToOutputDevice(hConsole, OutputString.StartOfString, OutputString.LengthInChars);
+    }
 }
 
 /**
@@ -183,6 +231,7 @@ SdirWriteStringWithAttribute (
 
     if (Opts->OutputHasAutoLineWrap) {
 
+        SdirFlushOutput();
         GetConsoleScreenBufferInfo(hConsole, &ScreenInfo);
 
         while (str[TCharsInBuffer] != '\0') {
@@ -407,6 +456,7 @@ SdirPressAnyKey ()
     DWORD NumRead;
 
     SdirWriteString(_T("Press any key to continue..."));
+    SdirFlushOutput();
 
     //
     //  Loop throwing away events until we get a key pressed
@@ -351,6 +351,12 @@ SdirParseOpt (
                 OptParsed = TRUE;
             }
         }
+    } else if (Opt[0] == 'j') {
+        Opts->MaxCollectionThreads = SdirStringToNum32(&Opt[1], NULL);
+        if (Opts->MaxCollectionThreads == 0) {
+            Opts->MaxCollectionThreads = 1;
+        }
+        OptParsed = TRUE;
     } else if (Opt[0] == 'l') {
         if (Opt[1] == 'n') {
             Opts->TraverseLinks = FALSE;
@@ -409,6 +415,14 @@ SdirParseOpt (
 
         } else {
         }
+    } else if (Opt[0] == 'n') {
+        Opts->StreamSampleSize = SdirStringToNum32(&Opt[1], NULL);
+        if (Opts->StreamSampleSize == 0) {
+            Opts->StreamSampleSize = SDIR_STREAM_DEFAULT_SAMPLE;
+        } else if (Opts->StreamSampleSize > SDIR_STREAM_MAX_SAMPLE) {
+            Opts->StreamSampleSize = SDIR_STREAM_MAX_SAMPLE;
+        }
+        OptParsed = TRUE;
     } else if (Opt[0] == 'p') {
         if (Opt[1] == 'n') {
             Opts->EnablePause = FALSE;
@@ -617,6 +631,8 @@ SdirAppCleanup()
 
     YoriLibFileFiltFreeFilter(&SdirGlobal.FileColorCriteria);
     YoriLibFileFiltFreeFilter(&SdirGlobal.FileHideCriteria);
+    YoriLibOutputBufferCleanup(&SdirGlobal.OutputBuffer);
+    YoriLibFreePeMetadataCache();
 
     if (SdirDirCollection != NULL) {
         YoriLibFree(SdirDirCollection);
@@ -84,12 +84,145 @@ PSDIR_SUMMARY Summary;
  */
 SDIR_GLOBAL SdirGlobal;
 
+/**
+ The maximum number of threads to use when collecting metadata that requires
+ opening each file.
+ */
+#define SDIR_MAX_COLLECTION_THREADS 16
+
+/**
+ A file found during enumeration whose metadata has not yet been collected.
+ */
+typedef struct _SDIR_PENDING_ENTRY {
+
+    /**
+     Information returned by the system when enumerating the file.
+     */
+    WIN32_FIND_DATA FindData;
+
+    /**
+     A copy of the full path to the file.  If this could not be allocated,
+     the entry was collected when it was found and this string is empty.
+     */
+    YORI_STRING FullPath;
+} SDIR_PENDING_ENTRY, *PSDIR_PENDING_ENTRY;
+
+/**
+ Pointer to an array of files found during enumeration whose metadata has
+ not yet been collected, with one element per allocated directory entry.
+ This is NULL unless metadata is being collected on multiple threads.
+ */
+PSDIR_PENDING_ENTRY SdirPendingCollection;
+
+/**
+ Describes the work performed by a single thread collecting metadata for
+ pending entries.  Each thread processes every Stride'th entry so that no
+ synchronization is needed between threads.
+ */
+typedef struct _SDIR_COLLECT_WORKER {
+
+    /**
+     The index of the first entry for this thread to collect.
+     */
+    DWORD FirstIndex;
+
+    /**
+     The index of the entry following the last entry to collect.
+     */
+    DWORD EndIndex;
+
+    /**
+     The number of entries to advance after collecting each entry.
+     */
+    DWORD Stride;
+} SDIR_COLLECT_WORKER, *PSDIR_COLLECT_WORKER;
+
+/**
+ Describes how entries are arranged on the display.
+ */
+typedef struct _SDIR_LAYOUT {
+
+    /**
+     The number of entries displayed on each line.
+     */
+    DWORD Columns;
+
+    /**
+     The number of characters in each column, including the grid line that
+     separates it from the next column.
+     */
+    DWORD ColumnWidth;
+
+    /**
+     The number of characters available to display each file name.  Names
+     longer than this are truncated.
+     */
+    DWORD LongestDisplayedFileName;
+} SDIR_LAYOUT, *PSDIR_LAYOUT;
+
+/**
+ State for displaying entries as they are found rather than collecting and
+ sorting every entry before displaying any.
+ */
+typedef struct _SDIR_STREAM_STATE {
+
+    /**
+     TRUE if entries are being displayed as they are found.
+     */
+    BOOL Active;
+
+    /**
+     TRUE once enough entries have been found to determine the layout and
+     display has begun.  Until this point entries are retained in the
+     collection.
+     */
+    BOOL LayoutComputed;
+
+    /**
+     The layout used to display entries, valid once LayoutComputed is TRUE.
+     */
+    SDIR_LAYOUT Layout;
+
+    /**
+     The column that the next entry will be displayed in.
+     */
+    DWORD ActiveColumn;
+
+    /**
+     The number of characters populated in Line.
+     */
+    DWORD CurrentChar;
+
+    /**
+     The number of entries found that were not hidden.
+     */
+    DWORD EntriesFound;
+
+    /**
+     The line currently being populated, which is written once the final
+     column has been populated.
+     */
+    SDIR_FMTCHAR Line[SDIR_MAX_WIDTH];
+} SDIR_STREAM_STATE, *PSDIR_STREAM_STATE;
+
+/**
+ State for displaying entries as they are found.
+ */
+SDIR_STREAM_STATE SdirStream;
+
 BOOL
 SdirDisplayCollection();
 
+BOOL
+SdirStreamCollectedEntry(
+    __in PYORI_FILE_INFO CurrentEntry
+    );
+
 /**
  Capture all required information from a file found by the system into a
- directory entry.
+ directory entry.  This does not determine the color to display the entry
+ with, and may be called on multiple threads concurrently for different
+ entries.
 
  @param CurrentEntry Pointer to a directory entry to populate with
         information.
@@ -101,7 +234,7 @@ SdirDisplayCollection();
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
-SdirCaptureFoundItemIntoDirent (
+SdirCollectFeatures (
     __out PYORI_FILE_INFO CurrentEntry,
     __in PWIN32_FIND_DATA FindData,
     __in PYORI_STRING FullPath
@@ -129,6 +262,31 @@ SdirCaptureFoundItemIntoDirent (
         }
     }
 
+    return TRUE;
+}
+
+/**
+ Capture all required information from a file found by the system into a
+ directory entry, and determine the color to display it with.
+
+ @param CurrentEntry Pointer to a directory entry to populate with
+        information.
+
+ @param FindData Information returned by the system when enumerating files.
+
+ @param FullPath Pointer to a string referring to the full path to the file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+SdirCaptureFoundItemIntoDirent (
+    __out PYORI_FILE_INFO CurrentEntry,
+    __in PWIN32_FIND_DATA FindData,
+    __in PYORI_STRING FullPath
+    ) 
+{
+    SdirCollectFeatures(CurrentEntry, FindData, FullPath);
+
     //
     //  Determine the color to display each entry from extensions and attributes.
     //  If we're asked to hide, just walk away from the entry we created and
@@ -184,37 +342,25 @@ SdirRenderAttributesFromPath (
 }
 
 /**
- Add a single found object to the set of files found so far.
-
- @param FindData Pointer to the block of data returned from the directory as
-        part of the enumeration.
+ Add a directory entry whose information has been fully captured to the set
+ of files found so far.  This hides the entry if requested, updates
+ statistics for the collection, and inserts the entry into the sorted
+ array.
 
- @param FullPath Pointer to a fully specified file name for the file.
+ @param CurrentEntry Pointer to the directory entry.  This must be the final
+        entry in the collection.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
-SdirAddToCollection (
-    __in PWIN32_FIND_DATA FindData,
-    __in PYORI_STRING FullPath
-    ) 
+SdirInsertCollectedEntry (
+    __in PYORI_FILE_INFO CurrentEntry
+    )
 {
-    PYORI_FILE_INFO CurrentEntry;
     DWORD i, j;
     DWORD CompareResult = 0;
 
-    if (SdirDirCollectionCurrent >= SdirAllocatedDirents) {
-        if (SdirDirCollectionCurrent < UINT_MAX) {
-            SdirDirCollectionCurrent++;
-        }
-        return FALSE;
-    }
-
-    CurrentEntry = &SdirDirCollection[SdirDirCollectionCurrent];
-
-    SdirDirCollectionCurrent++;
-
-    SdirCaptureFoundItemIntoDirent(CurrentEntry, FindData, FullPath);
+    ASSERT(CurrentEntry == &SdirDirCollection[SdirDirCollectionCurrent - 1]);
 
     if (CurrentEntry->RenderAttributes.Ctrl & YORILIB_ATTRCTRL_HIDE) {
 
@@ -276,6 +422,290 @@ SdirAddToCollection (
     return TRUE;
 }
 
+/**
+ Add a single found object to the set of files found so far.
+
+ @param FindData Pointer to the block of data returned from the directory as
+        part of the enumeration.
+
+ @param FullPath Pointer to a fully specified file name for the file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+SdirAddToCollection (
+    __in PWIN32_FIND_DATA FindData,
+    __in PYORI_STRING FullPath
+    ) 
+{
+    PYORI_FILE_INFO CurrentEntry;
+
+    if (SdirDirCollectionCurrent >= SdirAllocatedDirents) {
+        if (SdirDirCollectionCurrent < UINT_MAX) {
+            SdirDirCollectionCurrent++;
+        }
+        return FALSE;
+    }
+
+    CurrentEntry = &SdirDirCollection[SdirDirCollectionCurrent];
+
+    //
+    //  If metadata is being collected on multiple threads, record what is
+    //  needed to collect it later.  The entry is added to the collection
+    //  when collection is complete.  If the path can't be saved, collect
+    //  the metadata now.
+    //
+
+    if (SdirPendingCollection != NULL) {
+        PSDIR_PENDING_ENTRY PendingEntry;
+
+        PendingEntry = &SdirPendingCollection[SdirDirCollectionCurrent];
+        memcpy(&PendingEntry->FindData, FindData, sizeof(WIN32_FIND_DATA));
+        if (YoriLibAllocateString(&PendingEntry->FullPath, FullPath->LengthInChars + 1)) {
+            memcpy(PendingEntry->FullPath.StartOfString, FullPath->StartOfString, FullPath->LengthInChars * sizeof(TCHAR));
+            PendingEntry->FullPath.StartOfString[FullPath->LengthInChars] = '\0';
+            PendingEntry->FullPath.LengthInChars = FullPath->LengthInChars;
+        } else {
+            SdirCollectFeatures(CurrentEntry, FindData, FullPath);
+        }
+        SdirDirCollectionCurrent++;
+        return TRUE;
+    }
+
+    SdirDirCollectionCurrent++;
+
+    SdirCaptureFoundItemIntoDirent(CurrentEntry, FindData, FullPath);
+
+    if (SdirStream.Active) {
+        return SdirStreamCollectedEntry(CurrentEntry);
+    }
+
+    return SdirInsertCollectedEntry(CurrentEntry);
+}
+
+/**
+ Determine the number of threads to use to collect metadata.  Metadata which
+ is returned from directory enumeration is collected as files are found, and
+ only metadata that requires opening each file is worth collecting on
+ multiple threads.
+
+ @return The number of threads to use.  If this is one, metadata is
+         collected as files are found.
+ */
+DWORD
+SdirGetCollectionThreadCount()
+{
+    DWORD Index;
+    DWORD ThreadCount;
+    PSDIR_FEATURE Feature;
+    SDIR_COLLECT_FN CollectFn;
+    SYSTEM_INFO SystemInfo;
+    BOOL OpensFile;
+
+    //
+    //  If entries are displayed as they are found, collect metadata as
+    //  each is found so display doesn't wait for enumeration to complete.
+    //
+
+    if (SdirStream.Active) {
+        return 1;
+    }
+
+    OpensFile = FALSE;
+    for (Index = 0; Index < SdirGetNumSdirOptions(); Index++) {
+        Feature = SdirFeatureByOptionNumber(Index);
+        CollectFn = SdirOptions[Index].CollectFn;
+        if ((Feature->Flags & SDIR_FEATURE_COLLECT) &&
+            CollectFn != NULL &&
+            CollectFn != YoriLibCollectAccessTime &&
+            CollectFn != YoriLibCollectCreateTime &&
+            CollectFn != YoriLibCollectFileAttributes &&
+            CollectFn != YoriLibCollectFileExtension &&
+            CollectFn != YoriLibCollectFileName &&
+            CollectFn != YoriLibCollectFileSize &&
+            CollectFn != YoriLibCollectReparseTag &&
+            CollectFn != YoriLibCollectShortName &&
+            CollectFn != YoriLibCollectWriteTime) {
+
+            OpensFile = TRUE;
+            break;
+        }
+    }
+
+    if (!OpensFile) {
+        return 1;
+    }
+
+    //
+    //  Collection is generally bound by IO latency rather than processor
+    //  time, so use more threads than processors.  The user can lower this,
+    //  which is useful for network shares.
+    //
+
+    GetSystemInfo(&SystemInfo);
+    ThreadCount = SystemInfo.dwNumberOfProcessors * 2;
+    if (Opts->MaxCollectionThreads != 0 &&
+        ThreadCount > Opts->MaxCollectionThreads) {
+
+        ThreadCount = Opts->MaxCollectionThreads;
+    }
+    if (ThreadCount > SDIR_MAX_COLLECTION_THREADS) {
+        ThreadCount = SDIR_MAX_COLLECTION_THREADS;
+    }
+    if (ThreadCount == 0) {
+        ThreadCount = 1;
+    }
+
+    return ThreadCount;
+}
+
+/**
+ A worker thread which collects metadata for a set of pending entries.
+
+ @param Context Pointer to an SDIR_COLLECT_WORKER structure describing the
+        entries to collect.
+
+ @return Zero.
+ */
+DWORD WINAPI
+SdirCollectWorker(
+    __in LPVOID Context
+    )
+{
+    PSDIR_COLLECT_WORKER Worker = (PSDIR_COLLECT_WORKER)Context;
+    PSDIR_PENDING_ENTRY PendingEntry;
+    DWORD Index;
+
+    for (Index = Worker->FirstIndex; Index < Worker->EndIndex; Index += Worker->Stride) {
+        PendingEntry = &SdirPendingCollection[Index];
+        if (PendingEntry->FullPath.StartOfString != NULL) {
+            SdirCollectFeatures(&SdirDirCollection[Index], &PendingEntry->FindData, &PendingEntry->FullPath);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ Collect metadata for all pending entries using multiple threads, then add
+ each entry to the collection in the order it was found, so the result is
+ the same as collecting each entry as it was found.
+
+ @param FirstIndex The index of the first pending entry.
+
+ @param EndIndex The index following the final pending entry.
+
+ @param ThreadCount The maximum number of threads to use.
+ */
+VOID
+SdirCollectPendingEntries(
+    __in DWORD FirstIndex,
+    __in DWORD EndIndex,
+    __in DWORD ThreadCount
+    )
+{
+    HANDLE Threads[SDIR_MAX_COLLECTION_THREADS];
+    SDIR_COLLECT_WORKER Workers[SDIR_MAX_COLLECTION_THREADS];
+    PYORI_FILE_INFO CurrentEntry;
+    PYORI_FILE_INFO FoundEntry;
+    DWORD ThreadsCreated;
+    DWORD ThreadId;
+    DWORD Index;
+
+    if (ThreadCount > SDIR_MAX_COLLECTION_THREADS) {
+        ThreadCount = SDIR_MAX_COLLECTION_THREADS;
+    }
+    if (ThreadCount > EndIndex - FirstIndex) {
+        ThreadCount = EndIndex - FirstIndex;
+    }
+
+    //
+    //  Load version functions and create the lock for cached PE metadata
+    //  before creating threads so that no two threads attempt to initialize
+    //  them at the same time.
+    //
+
+    YoriLibLoadVersionFunctions();
+    YoriLibInitPeMetadataCache();
+
+    for (Index = 0; Index < ThreadCount; Index++) {
+        Workers[Index].FirstIndex = FirstIndex + Index;
+        Workers[Index].EndIndex = EndIndex;
+        Workers[Index].Stride = ThreadCount;
+    }
+
+    //
+    //  The current thread is one of the workers, so only create threads
+    //  beyond the first.  If a thread can't be created, the current thread
+    //  processes its entries.
+    //
+
+    ThreadsCreated = 0;
+    for (Index = 1; Index < ThreadCount; Index++) {
+        Threads[ThreadsCreated] = CreateThread(NULL, 0, SdirCollectWorker, &Workers[Index], 0, &ThreadId);
+        if (Threads[ThreadsCreated] == NULL) {
+            SdirCollectWorker(&Workers[Index]);
+        } else {
+            ThreadsCreated++;
+        }
+    }
+
+    if (ThreadCount > 0) {
+        SdirCollectWorker(&Workers[0]);
+    }
+
+    if (ThreadsCreated > 0) {
+        WaitForMultipleObjects(ThreadsCreated, Threads, TRUE, INFINITE);
+        for (Index = 0; Index < ThreadsCreated; Index++) {
+            CloseHandle(Threads[Index]);
+        }
+    }
+
+    //
+    //  Add each entry in order.  Hidden entries are not retained, so later
+    //  entries are moved down to fill the gap.  The extension refers to
+    //  the entry's own file name, so it needs to be updated when moving.
+    //
+
+    SdirDirCollectionCurrent = FirstIndex;
+    for (Index = FirstIndex; Index < EndIndex; Index++) {
+        FoundEntry = &SdirDirCollection[Index];
+        CurrentEntry = &SdirDirCollection[SdirDirCollectionCurrent];
+        if (CurrentEntry != FoundEntry) {
+            memcpy(CurrentEntry, FoundEntry, sizeof(YORI_FILE_INFO));
+            if (FoundEntry->Extension >= FoundEntry->FileName &&
+                FoundEntry->Extension <= &FoundEntry->FileName[sizeof(FoundEntry->FileName)/sizeof(FoundEntry->FileName[0])]) {
+
+                CurrentEntry->Extension = CurrentEntry->FileName + (FoundEntry->Extension - FoundEntry->FileName);
+            }
+        }
+
+        SdirDirCollectionCurrent++;
+        SdirApplyAttribute(CurrentEntry, &CurrentEntry->RenderAttributes);
+        SdirInsertCollectedEntry(CurrentEntry);
+    }
+}
+
+/**
+ Free the paths saved for pending entries.
+
+ @param FirstIndex The index of the first pending entry.
+
+ @param EndIndex The index following the final pending entry.
+ */
+VOID
+SdirFreePendingEntries(
+    __in DWORD FirstIndex,
+    __in DWORD EndIndex
+    )
+{
+    DWORD Index;
+
+    for (Index = FirstIndex; Index < EndIndex; Index++) {
+        YoriLibFreeStringContents(&SdirPendingCollection[Index].FullPath);
+    }
+}
+
 /**
  A context structure passed around through all files found as part of a single
  enumerate request.
@@ -543,6 +973,9 @@ SdirEnumeratePathWithDepth (
     PYORI_FILE_INFO * NewSdirDirSorted;
     SDIR_ITEM_FOUND_CONTEXT ItemFoundContext;
     DWORD MatchFlags;
+    DWORD ThreadCount;
+    DWORD PendingEnd;
+    BOOL Result;
 
     //
     //  At this point we should have a directory and an enumeration criteria.
@@ -626,11 +1059,14 @@ SdirEnumeratePathWithDepth (
     //  enough though, we count the number of entries, loop back, and allocate
     //  a large enough buffer to hold the result, then enumerate it again.
     //  Because we sort the output, we must keep the entire set in memory to
-    //  be able to meaningfully process it.
+    //  be able to meaningfully process it.  When entries are displayed as
+    //  they are found, the collection only holds the entries used to
+    //  determine the layout, so it is never reallocated.
     //
 
     DirEntsToPreserve = SdirDirCollectionCurrent;
     memcpy(&SummaryToPreserve, Summary, sizeof(SummaryToPreserve));
+    ThreadCount = SdirGetCollectionThreadCount();
 
     do {
 
@@ -713,13 +1149,47 @@ SdirEnumeratePathWithDepth (
         YoriLibInitEmptyString(&ItemFoundContext.StreamFullPath);
         ItemFoundContext.Error = ERROR_SUCCESS;
 
-        if (!YoriLibForEachFile(FindStr,
-                                MatchFlags,
-                                0,
-                                SdirItemFoundCallback,
-                                SdirEnumerateErrorCallback,
-                                &ItemFoundContext)) {
-
+        //
+        //  If metadata is being collected on multiple threads, allocate
+        //  space to record each file found so its metadata can be collected
+        //  once enumeration is complete.  If this can't be allocated,
+        //  collect metadata as each file is found.
+        //
+
+        if (ThreadCount > 1) {
+            SdirPendingCollection = YoriLibMalloc(SdirAllocatedDirents * sizeof(SDIR_PENDING_ENTRY));
+            if (SdirPendingCollection != NULL) {
+                ZeroMemory(SdirPendingCollection, SdirAllocatedDirents * sizeof(SDIR_PENDING_ENTRY));
+            }
+        }
+
+        Result = YoriLibForEachFile(FindStr,
+                                    MatchFlags,
+                                    0,
+                                    SdirItemFoundCallback,
+                                    SdirEnumerateErrorCallback,
+                                    &ItemFoundContext);
+
+        //
+        //  If everything found fits in the collection, collect metadata for
+        //  it.  If not, the collection will be reallocated and enumerated
+        //  again.
+        //
+
+        if (SdirPendingCollection != NULL) {
+            PendingEnd = SdirDirCollectionCurrent;
+            if (PendingEnd < SdirAllocatedDirents) {
+                SdirCollectPendingEntries(DirEntsToPreserve, PendingEnd, ThreadCount);
+            } else {
+                PendingEnd = SdirAllocatedDirents;
+            }
+            SdirFreePendingEntries(DirEntsToPreserve, PendingEnd);
+            YoriLibFree(SdirPendingCollection);
+            SdirPendingCollection = NULL;
+        }
+
+        if (!Result) {
+
             if (!Opts->Recursive) {
                 if (ItemFoundContext.Error == ERROR_SUCCESS) {
                     ItemFoundContext.Error = GetLastError();
@@ -855,32 +1325,37 @@ SdirNewlineThroughDisplay()
 
 
 /**
- Display the loaded set of files.
+ Return the set of characters to use when drawing grid lines.
+
+ @return Pointer to an array of characters indexed by SDIR_LINE_ELEMENT_*.
+ */
+LPTSTR
+SdirGetLineElements()
+{
+#ifdef UNICODE
+    if (Opts->OutputExtendedCharacters) {
+        return SdirLineElementsRich;
+    }
+#endif
+    return SdirLineElementsText;
+}
+
+/**
+ Determine the number and width of columns to display from the entries that
+ are currently in the collection.
+
+ @param Layout On successful completion, populated with the layout to use.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
-SdirDisplayCollection()
+SdirComputeLayout(
+    __out PSDIR_LAYOUT Layout
+    )
 {
-    PYORI_FILE_INFO CurrentEntry;
-    DWORD Index, Ext;
-    YORILIB_COLOR_ATTRIBUTES Attributes;
-    YORILIB_COLOR_ATTRIBUTES FeatureColor;
     DWORD Columns;
     DWORD ColumnWidth;
-    DWORD ActiveColumn = 0;
-    SDIR_FMTCHAR Line[SDIR_MAX_WIDTH];
-    DWORD CurrentChar = 0;
-    DWORD BufferRows;
     DWORD LongestDisplayedFileName = SdirDirCollectionLongest;
-    LPTSTR LineElements = SdirLineElementsText;
-    PSDIR_FEATURE Feature;
-
-#ifdef UNICODE
-    if (Opts->OutputExtendedCharacters) {
-        LineElements = SdirLineElementsRich;
-    }
-#endif
 
     //
     //  If we're allowed to shorten names to make the display more
@@ -890,7 +1365,7 @@ SdirDisplayCollection()
     //  a meaningful length to start with (currently 10.)
     //
 
-    if (Opts->EnableNameTruncation) {
+    if (Opts->EnableNameTruncation && SdirDirCollectionCurrent > 0) {
         ULONG AverageNameLength;
 
         AverageNameLength = SdirDirCollectionTotalNameLength / SdirDirCollectionCurrent;
@@ -940,15 +1415,41 @@ SdirDisplayCollection()
         return FALSE;
     }
 
-    BufferRows = (SdirDirCollectionCurrent + Columns - 1) / Columns;
+    Layout->Columns = Columns;
+    Layout->ColumnWidth = ColumnWidth;
+    Layout->LongestDisplayedFileName = LongestDisplayedFileName;
+    return TRUE;
+}
+
+/**
+ Draw a horizontal grid line above or below the entries.
 
-    //
-    //  Draw the top grid line.
-    //
+ @param Layout Pointer to the layout of entries.
+
+ @param Line Pointer to a buffer to populate with the line.
 
-    for (Index = 0; Index < ColumnWidth * Columns; Index++) {
-        if (Index % ColumnWidth == ColumnWidth - 1 && Index < (ColumnWidth*Columns-1)) {
-            Line[Index].Char = LineElements[SDIR_LINE_ELEMENT_TOP_T];
+ @param Joiner The line element to use where the line meets a vertical grid
+        line, being SDIR_LINE_ELEMENT_TOP_T or SDIR_LINE_ELEMENT_BOTTOM_T.
+
+ @return TRUE to indicate success, FALSE to indicate failure or that the
+         user requested display to stop.
+ */
+BOOL
+SdirDisplayGridLine(
+    __in PSDIR_LAYOUT Layout,
+    __out PSDIR_FMTCHAR Line,
+    __in DWORD Joiner
+    )
+{
+    DWORD Index;
+    DWORD LineWidth;
+    LPTSTR LineElements = SdirGetLineElements();
+
+    LineWidth = Layout->ColumnWidth * Layout->Columns;
+
+    for (Index = 0; Index < LineWidth; Index++) {
+        if (Index % Layout->ColumnWidth == Layout->ColumnWidth - 1 && Index < (LineWidth - 1)) {
+            Line[Index].Char = LineElements[Joiner];
             Line[Index].Attr = Opts->FtGrid.HighlightColor;
         } else {
             Line[Index].Char = LineElements[SDIR_LINE_ELEMENT_HORIZ];
@@ -958,7 +1459,7 @@ SdirDisplayCollection()
 
     SdirWrite(Line, Index);
 
-    if (ColumnWidth * Columns != Opts->ConsoleBufferWidth || !Opts->OutputHasAutoLineWrap) {
+    if (LineWidth != Opts->ConsoleBufferWidth || !Opts->OutputHasAutoLineWrap) {
         SdirNewlineThroughDisplay();
     }
 
@@ -966,11 +1467,220 @@ SdirDisplayCollection()
         return FALSE;
     }
 
+    return TRUE;
+}
+
+/**
+ Render a single entry into the line being populated.
+
+ @param Layout Pointer to the layout of entries.
+
+ @param CurrentEntry Pointer to the entry to render.  If NULL, an empty cell
+        is rendered.
+
+ @param Line Pointer to the line being populated.
+
+ @param CurrentChar On input, the number of characters populated in Line.
+        On output, updated to include the characters for this entry.
+ */
+VOID
+SdirDisplayCell(
+    __in PSDIR_LAYOUT Layout,
+    __in_opt PYORI_FILE_INFO CurrentEntry,
+    __inout PSDIR_FMTCHAR Line,
+    __inout PDWORD CurrentChar
+    )
+{
+    DWORD Ext;
+    DWORD ColumnWidth = Layout->ColumnWidth;
+    DWORD LongestDisplayedFileName = Layout->LongestDisplayedFileName;
+    DWORD Char = *CurrentChar;
+    YORILIB_COLOR_ATTRIBUTES Attributes;
+    YORILIB_COLOR_ATTRIBUTES FeatureColor;
+    PSDIR_FEATURE Feature;
+
+    //
+    //  Render the empty cell.  Or, if we have contents, render that too.
+    //
+
+    if (CurrentEntry == NULL) {
+        SdirPasteStrAndPad(&Line[Char], NULL, SdirDefaultColor, 0, ColumnWidth - 1);
+        Char += ColumnWidth - 1;
+    } else {
+
+        Attributes = CurrentEntry->RenderAttributes;
+
+        //
+        //  Paste file name into buffer
+        //
+
+        if (Opts->FtFileName.Flags & SDIR_FEATURE_DISPLAY) {
+            FeatureColor = SdirFeatureColor(&Opts->FtFileName, Attributes);
+            if (CurrentEntry->FileNameLengthInChars > LongestDisplayedFileName) {
+                ULONG ExtractedLength = (LongestDisplayedFileName - 3) / 2;
+
+                SdirPasteStr(&Line[Char], CurrentEntry->FileName, Attributes, ExtractedLength);
+                Char += ExtractedLength;
+
+                SdirPasteStr(&Line[Char], _T("..."), Attributes, ExtractedLength);
+                Char += 3;
+
+                SdirPasteStrAndPad(&Line[Char],
+                                   CurrentEntry->FileName + CurrentEntry->FileNameLengthInChars - ExtractedLength,
+                                   FeatureColor,
+                                   ExtractedLength,
+                                   ColumnWidth - Opts->MetadataWidth - ExtractedLength - 3);
+
+                Char += ColumnWidth - Opts->MetadataWidth - ExtractedLength - 3;
+            } else {
+                SdirPasteStrAndPad(&Line[Char],
+                                   CurrentEntry->FileName,
+                                   FeatureColor,
+                                   CurrentEntry->FileNameLengthInChars,
+                                   ColumnWidth - Opts->MetadataWidth);
+                Char += ColumnWidth - Opts->MetadataWidth;
+            }
+        }
+
+        if (Opts->FtShortName.Flags & SDIR_FEATURE_DISPLAY) {
+            FeatureColor = SdirFeatureColor(&Opts->FtShortName, Attributes);
+            Char += SdirDisplayShortName(&Line[Char], FeatureColor, CurrentEntry);
+
+            if (!(Opts->FtFileName.Flags & SDIR_FEATURE_DISPLAY)) {
+
+                //
+                //  If file name is hidden, we may need to align things, because
+                //  our columns may contain padding (they're essentially justified.)
+                //
+
+                SdirPasteStrAndPad(&Line[Char], NULL, FeatureColor, 0, ColumnWidth - Opts->MetadataWidth);
+                Char += ColumnWidth - Opts->MetadataWidth;
+            }
+        }
+
+        //
+        //  If file names or short names are being displayed, column
+        //  justification has already been performed.  If neither
+        //  are displayed, force manual justification here.
+        //
+
+        if (!(Opts->FtShortName.Flags & SDIR_FEATURE_DISPLAY || Opts->FtFileName.Flags & SDIR_FEATURE_DISPLAY)) {
+            SdirPasteStrAndPad(&Line[Char],
+                               NULL,
+                               Attributes,
+                               0,
+                               ColumnWidth - Opts->MetadataWidth);
+            Char += ColumnWidth - Opts->MetadataWidth;
+        }
+
+        //
+        //  Paste any metadata options into the buffer.
+        //
+
+        for (Ext = 0; Ext < SdirGetNumSdirExec(); Ext++) {
+            Feature = (PSDIR_FEATURE)((PUCHAR)Opts + SdirExec[Ext].FtOffset);
+            if (Feature->Flags & SDIR_FEATURE_DISPLAY) {
+                FeatureColor = SdirFeatureColor(Feature, Attributes);
+                Char += SdirExec[Ext].Function(&Line[Char], FeatureColor, CurrentEntry);
+            }
+        }
+    }
+
+    *CurrentChar = Char;
+}
+
+/**
+ Complete a cell after it has been rendered.  If it is the final column, the
+ line is written, otherwise a grid line is added to separate it from the
+ next column.
+
+ @param Layout Pointer to the layout of entries.
+
+ @param Line Pointer to the line being populated.
+
+ @param CurrentChar On input, the number of characters populated in Line.
+        On output, updated to include any grid line, or zero if the line
+        was written.
+
+ @param ActiveColumn On input, the column that was just rendered.  On
+        output, the column that the next cell will be rendered into.
+
+ @return TRUE to indicate success, FALSE to indicate failure or that the
+         user requested display to stop.
+ */
+BOOL
+SdirDisplayCellEnd(
+    __in PSDIR_LAYOUT Layout,
+    __inout PSDIR_FMTCHAR Line,
+    __inout PDWORD CurrentChar,
+    __inout PDWORD ActiveColumn
+    )
+{
+    LPTSTR LineElements = SdirGetLineElements();
+
+    //
+    //  We're starting a new column.  If it's the final one we might want a newline,
+    //  otherwise we might want a gridline.  Do this manually so we only write the
+    //  line once.
+    //
+
+    (*ActiveColumn)++;
+    if (*ActiveColumn % Layout->Columns == 0) {
+
+        Line[*CurrentChar].Char = '\n';
+        Line[*CurrentChar].Attr = SdirDefaultColor;
+        (*CurrentChar)++;
+        SdirWrite(Line, *CurrentChar);
+
+        *CurrentChar = 0;
+        *ActiveColumn = 0;
+        if (!SdirRowDisplayed()) {
+            return FALSE;
+        }
+    } else {
+        Line[*CurrentChar].Char = LineElements[SDIR_LINE_ELEMENT_VERT];
+        Line[*CurrentChar].Attr = Opts->FtGrid.HighlightColor;
+        (*CurrentChar)++;
+    }
+
+    return TRUE;
+}
+
+/**
+ Display the loaded set of files.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+SdirDisplayCollection()
+{
+    PYORI_FILE_INFO CurrentEntry;
+    DWORD Index, Ext;
+    SDIR_LAYOUT Layout;
+    DWORD ActiveColumn = 0;
+    SDIR_FMTCHAR Line[SDIR_MAX_WIDTH];
+    DWORD CurrentChar = 0;
+    DWORD BufferRows;
+
+    if (!SdirComputeLayout(&Layout)) {
+        return FALSE;
+    }
+
+    BufferRows = (SdirDirCollectionCurrent + Layout.Columns - 1) / Layout.Columns;
+
+    //
+    //  Draw the top grid line.
+    //
+
+    if (!SdirDisplayGridLine(&Layout, Line, SDIR_LINE_ELEMENT_TOP_T)) {
+        return FALSE;
+    }
+
     //
     //  Enumerate through the entries.
     //
 
-    for (Index = 0; Index < BufferRows * Columns && !Opts->Cancelled; Index++) {
+    for (Index = 0; Index < BufferRows * Layout.Columns && !Opts->Cancelled; Index++) {
 
         //
         //  Because we're sorting down columns first, but rendering a row at a time,
@@ -978,149 +1688,174 @@ SdirDisplayCollection()
         //  Some cells in the bottom right might be empty.
         //
 
-        Ext = ActiveColumn * BufferRows + Index / Columns;
+        Ext = ActiveColumn * BufferRows + Index / Layout.Columns;
         if (Ext < SdirDirCollectionCurrent) {
             CurrentEntry = SdirDirSorted[Ext];
         } else {
             CurrentEntry = NULL;
         }
 
-        //
-        //  Render the empty cell.  Or, if we have contents, render that too.
-        //
+        SdirDisplayCell(&Layout, CurrentEntry, Line, &CurrentChar);
+        if (!SdirDisplayCellEnd(&Layout, Line, &CurrentChar, &ActiveColumn)) {
+            return FALSE;
+        }
+    }
 
-        if (CurrentEntry == NULL) {
-            SdirPasteStrAndPad(&Line[CurrentChar], NULL, SdirDefaultColor, 0, ColumnWidth - 1);
-            CurrentChar += ColumnWidth - 1;
-        } else {
+    //
+    //  Render the bottom gridline.
+    //
 
-            Attributes = CurrentEntry->RenderAttributes;
-    
-            //
-            //  Paste file name into buffer
-            //
-    
-            if (Opts->FtFileName.Flags & SDIR_FEATURE_DISPLAY) {
-                FeatureColor = SdirFeatureColor(&Opts->FtFileName, Attributes);
-                if (CurrentEntry->FileNameLengthInChars > LongestDisplayedFileName) {
-                    ULONG ExtractedLength = (LongestDisplayedFileName - 3) / 2;
+    if (!SdirDisplayGridLine(&Layout, Line, SDIR_LINE_ELEMENT_BOTTOM_T)) {
+        return FALSE;
+    }
 
-                    SdirPasteStr(&Line[CurrentChar], CurrentEntry->FileName, Attributes, ExtractedLength);
-                    CurrentChar += ExtractedLength;
+    return TRUE;
+}
 
-                    SdirPasteStr(&Line[CurrentChar], _T("..."), Attributes, ExtractedLength);
-                    CurrentChar += 3;
+/**
+ Display a single entry when entries are displayed as they are found.
+ Because entries are not sorted, they are displayed across each row rather
+ than down each column.  If the user has requested display to stop, the
+ entry is discarded.
 
-                    SdirPasteStrAndPad(&Line[CurrentChar],
-                                       CurrentEntry->FileName + CurrentEntry->FileNameLengthInChars - ExtractedLength,
-                                       FeatureColor,
-                                       ExtractedLength,
-                                       ColumnWidth - Opts->MetadataWidth - ExtractedLength - 3);
+ @param CurrentEntry Pointer to the entry to display.  If NULL, an empty cell
+        is displayed.
 
-                    CurrentChar += ColumnWidth - Opts->MetadataWidth - ExtractedLength - 3;
-                } else {
-                    SdirPasteStrAndPad(&Line[CurrentChar],
-                                       CurrentEntry->FileName,
-                                       FeatureColor,
-                                       CurrentEntry->FileNameLengthInChars,
-                                       ColumnWidth - Opts->MetadataWidth);
-                    CurrentChar += ColumnWidth - Opts->MetadataWidth;
-                }
-            }
+ @return TRUE to indicate success, FALSE to indicate failure or that the
+         user requested display to stop.
+ */
+BOOL
+SdirStreamDisplayEntry(
+    __in_opt PYORI_FILE_INFO CurrentEntry
+    )
+{
+    if (Opts->Cancelled) {
+        return FALSE;
+    }
 
-            if (Opts->FtShortName.Flags & SDIR_FEATURE_DISPLAY) {
-                FeatureColor = SdirFeatureColor(&Opts->FtShortName, Attributes);
-                CurrentChar += SdirDisplayShortName(&Line[CurrentChar], FeatureColor, CurrentEntry);
+    SdirDisplayCell(&SdirStream.Layout, CurrentEntry, SdirStream.Line, &SdirStream.CurrentChar);
+    if (!SdirDisplayCellEnd(&SdirStream.Layout, SdirStream.Line, &SdirStream.CurrentChar, &SdirStream.ActiveColumn)) {
+        Opts->Cancelled = TRUE;
+        return FALSE;
+    }
 
-                if (!(Opts->FtFileName.Flags & SDIR_FEATURE_DISPLAY)) {
+    return TRUE;
+}
 
-                    //
-                    //  If file name is hidden, we may need to align things, because
-                    //  our columns may contain padding (they're essentially justified.)
-                    //
+/**
+ Determine the layout from the entries found so far, draw the top grid line,
+ and display the entries found so far.  After this point the collection is
+ empty and each entry is displayed as it is found.
 
-                    SdirPasteStrAndPad(&Line[CurrentChar], NULL, FeatureColor, 0, ColumnWidth - Opts->MetadataWidth);
-                    CurrentChar += ColumnWidth - Opts->MetadataWidth;
-                }
-            }
+ @return TRUE to indicate success, FALSE to indicate failure or that the
+         user requested display to stop.
+ */
+BOOL
+SdirStreamBeginDisplay()
+{
+    DWORD Index;
 
-            //
-            //  If file names or short names are being displayed, column
-            //  justification has already been performed.  If neither
-            //  are displayed, force manual justification here.
-            //
+    SdirStream.LayoutComputed = TRUE;
 
-            if (!(Opts->FtShortName.Flags & SDIR_FEATURE_DISPLAY || Opts->FtFileName.Flags & SDIR_FEATURE_DISPLAY)) {
-                SdirPasteStrAndPad(&Line[CurrentChar],
-                                   NULL,
-                                   Attributes,
-                                   0,
-                                   ColumnWidth - Opts->MetadataWidth);
-                CurrentChar += ColumnWidth - Opts->MetadataWidth;
-            }
+    if (!SdirComputeLayout(&SdirStream.Layout) ||
+        !SdirDisplayGridLine(&SdirStream.Layout, SdirStream.Line, SDIR_LINE_ELEMENT_TOP_T)) {
 
-            //
-            //  Paste any metadata options into the buffer.
-            //
+        Opts->Cancelled = TRUE;
+        SdirDirCollectionCurrent = 0;
+        return FALSE;
+    }
 
-            for (Ext = 0; Ext < SdirGetNumSdirExec(); Ext++) {
-                Feature = (PSDIR_FEATURE)((PUCHAR)Opts + SdirExec[Ext].FtOffset);
-                if (Feature->Flags & SDIR_FEATURE_DISPLAY) {
-                    FeatureColor = SdirFeatureColor(Feature, Attributes);
-                    CurrentChar += SdirExec[Ext].Function(&Line[CurrentChar], FeatureColor, CurrentEntry);
-                }
-            }
+    for (Index = 0; Index < SdirDirCollectionCurrent; Index++) {
+        if (!SdirStreamDisplayEntry(&SdirDirCollection[Index])) {
+            break;
         }
-    
-        //
-        //  We're starting a new column.  If it's the final one we might want a newline,
-        //  otherwise we might want a gridline.  Do this manually so we only write the
-        //  line once.
-        //
+    }
 
-        ActiveColumn++;
-        if (ActiveColumn % Columns == 0) {
+    SdirDirCollectionCurrent = 0;
+    return !Opts->Cancelled;
+}
 
-            Line[CurrentChar].Char = '\n';
-            Line[CurrentChar].Attr = SdirDefaultColor;
-            CurrentChar++;
-            SdirWrite(Line, CurrentChar);
+/**
+ Add a directory entry whose information has been fully captured when
+ entries are displayed as they are found.  Until enough entries have been
+ found to determine the layout, entries are retained in the collection in
+ the order they were found.  After that, each entry is displayed
+ immediately and its space in the collection is reused.
 
-            CurrentChar = 0;
-            ActiveColumn = 0;
-            if (!SdirRowDisplayed()) {
-                return FALSE;
-            }
-        } else {
-            Line[CurrentChar].Char = LineElements[SDIR_LINE_ELEMENT_VERT];
-            Line[CurrentChar].Attr = Opts->FtGrid.HighlightColor;
-            CurrentChar++;
+ @param CurrentEntry Pointer to the directory entry.  This must be the final
+        entry in the collection.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+SdirStreamCollectedEntry(
+    __in PYORI_FILE_INFO CurrentEntry
+    )
+{
+    ASSERT(CurrentEntry == &SdirDirCollection[SdirDirCollectionCurrent - 1]);
+
+    if (CurrentEntry->RenderAttributes.Ctrl & YORILIB_ATTRCTRL_HIDE) {
+
+        SdirDirCollectionCurrent--;
+        return TRUE;
+    }
+
+    SdirStream.EntriesFound++;
+
+    if (Opts->FtSummary.Flags & SDIR_FEATURE_COLLECT) {
+        SdirCollectSummary(CurrentEntry);
+    }
+
+    if (!SdirStream.LayoutComputed) {
+        if (CurrentEntry->FileNameLengthInChars > SdirDirCollectionLongest) {
+            SdirDirCollectionLongest = CurrentEntry->FileNameLengthInChars;
         }
+
+        SdirDirCollectionTotalNameLength += CurrentEntry->FileNameLengthInChars;
+
+        if (SdirDirCollectionCurrent >= Opts->StreamSampleSize) {
+            SdirStreamBeginDisplay();
+        }
+        return TRUE;
     }
 
-    //
-    //  Render the bottom gridline.
-    //
+    SdirDirCollectionCurrent--;
+    SdirStreamDisplayEntry(CurrentEntry);
+    return TRUE;
+}
 
-    for (Index = 0; Index < ColumnWidth * Columns; Index++) {
-        if (Index % ColumnWidth == ColumnWidth - 1 && Index < (ColumnWidth*Columns-1)) {
-            Line[Index].Char = LineElements[SDIR_LINE_ELEMENT_BOTTOM_T];
-            Line[Index].Attr = Opts->FtGrid.HighlightColor;
-        } else {
-            Line[Index].Char = LineElements[SDIR_LINE_ELEMENT_HORIZ];
-            Line[Index].Attr = Opts->FtGrid.HighlightColor;
+/**
+ Complete display of entries that are displayed as they are found.  If not
+ enough entries were found to determine the layout, the layout is determined
+ from the entries that were found and they are displayed now.  The final row
+ is padded with empty cells and the bottom grid line is drawn.
+
+ @return TRUE to indicate success, FALSE to indicate failure or that the
+         user requested display to stop.
+ */
+BOOL
+SdirStreamEndDisplay()
+{
+    if (!SdirStream.LayoutComputed) {
+        if (SdirDirCollectionCurrent == 0) {
+            return TRUE;
+        }
+        if (!SdirStreamBeginDisplay()) {
+            return FALSE;
         }
     }
 
-    SdirWrite(Line, Index);
-    CurrentChar = 0;
+    if (Opts->Cancelled) {
+        return FALSE;
+    }
 
-    if (ColumnWidth * Columns != Opts->ConsoleBufferWidth || !Opts->OutputHasAutoLineWrap) {
-        SdirNewlineThroughDisplay();
-        CurrentChar = 0;
+    while (SdirStream.ActiveColumn != 0) {
+        if (!SdirStreamDisplayEntry(NULL)) {
+            return FALSE;
+        }
     }
 
-    if (!SdirRowDisplayed()) {
+    if (!SdirDisplayGridLine(&SdirStream.Layout, SdirStream.Line, SDIR_LINE_ELEMENT_BOTTOM_T)) {
         return FALSE;
     }
 
@@ -1269,10 +2004,23 @@ SdirEnumerateAndDisplay (
     __in YORI_STRING ArgV[]
     )
 {
+    if (Opts->StreamSampleSize != 0) {
+        SdirStream.Active = TRUE;
+    }
+
     if (!SdirForEachPathSpec(ArgC, ArgV, SdirEnumeratePath)) {
         return FALSE;
     }
 
+    if (SdirStream.Active) {
+        if (SdirStream.EntriesFound == 0) {
+            SdirDisplayError(ERROR_FILE_NOT_FOUND, NULL);
+            return FALSE;
+        }
+
+        return SdirStreamEndDisplay();
+    }
+
     if (SdirDirCollectionCurrent == 0) {
         SdirDisplayError(ERROR_FILE_NOT_FOUND, NULL);
         return FALSE;
@@ -1578,7 +2326,7 @@ ENTRYPOINT(
     __in YORI_STRING ArgV[]
     )
 {
-    SdirAllocatedDirents = 1000;
+    SdirAllocatedDirents = SDIR_INITIAL_DIRENTS;
     SdirDirCollection = NULL;
     SdirDirSorted = NULL;
     SdirDirCollectionCurrent = 0;
@@ -39,6 +39,25 @@
  */
 #define SDIR_MAX_WIDTH   500
 
+/**
+ The number of entries used to determine column widths when displaying
+ entries as they are found, if the user didn't specify a number.
+ */
+#define SDIR_STREAM_DEFAULT_SAMPLE 100
+
+/**
+ The number of entries allocated in the collection before any are found.
+ */
+#define SDIR_INITIAL_DIRENTS       1000
+
+/**
+ The maximum number of entries used to determine column widths when
+ displaying entries as they are found.  This must not exceed the number of
+ entries initially allocated, so display begins once the final allocated
+ entry is populated and the collection is never reallocated.
+ */
+#define SDIR_STREAM_MAX_SAMPLE     SDIR_INITIAL_DIRENTS
+
 /**
  Fallback color for when all else fails.
  */
@@ -268,6 +287,20 @@ typedef struct _SDIR_OPTS {
      */
     DWORD           OsVersion;
 
+    /**
+     Specifies the maximum number of threads to use when collecting file
+     metadata that requires opening each file.  Zero indicates the number
+     should be determined from the number of processors.
+     */
+    DWORD           MaxCollectionThreads;
+
+    /**
+     If nonzero, entries are displayed in the order they are found rather
+     than being sorted, and this specifies the number of entries used to
+     determine column widths before display begins.
+     */
+    DWORD           StreamSampleSize;
+
     /**
      The volatile configuration for a file's last access date.
      */
@@ -656,6 +689,12 @@ typedef struct _SDIR_GLOBAL {
      which files to hide.
      */
     YORI_LIB_FILE_FILTER FileHideCriteria;
+
+    /**
+     Buffered output stream used to combine many small writes of text and
+     color changes into larger writes.  This is initialized on first use.
+     */
+    YORI_LIB_OUTPUT_BUFFER OutputBuffer;
 } SDIR_GLOBAL, *PSDIR_GLOBAL;
 
 extern SDIR_GLOBAL SdirGlobal;
@@ -685,6 +724,9 @@ SdirSetConsoleTextAttribute(
     __in YORILIB_COLOR_ATTRIBUTES Attribute
     );
 
+BOOL
+SdirFlushOutput();
+
 BOOL
 SdirWrite (
     __in_ecount(count) PSDIR_FMTCHAR str,
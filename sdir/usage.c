@@ -207,7 +207,9 @@ CHAR strCmdLineOpts[] =
                    "   -cw[num]     Width of console when writing to files\n"
                    "   -fc[string]  Apply custom file color string, see file color section\n"
                    "   -fe[string]  Exclude files matching criteria, see file color section\n"
+                   "   -j[num]      Open at most num files concurrently to collect metadata\n"
                    "   -l/-ln       Traverse symbolic links and mount points when recursing\n"
+                   "   -n[num]      Display unsorted as found, sizing columns from first num files\n"
                    "   -p/-pn       Pause/no pause after each screen\n"
                    "   -r           Recurse through directories when enumerating\n"
                    "   -t/-tn       Truncate/no truncate of very long file names\n"
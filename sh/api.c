@@ -126,6 +126,7 @@ YoriApiClearHistoryStrings(
     )
 {
     YoriShClearAllHistory();
+    YoriShAddRemovalToHistoryFile(NULL);
     return TRUE;
 }
 
@@ -98,8 +98,7 @@ YoriShPerformHistoryTabCompletion(
     )
 {
     LPTSTR FoundPath;
-    DWORD CompareLength;
-    PYORI_LIST_ENTRY ListEntry;
+    YORI_STRING Prefix;
     PYORI_SH_HISTORY_ENTRY HistoryEntry;
     PYORI_SH_TAB_COMPLETE_MATCH Match;
 
@@ -109,52 +108,50 @@ YoriShPerformHistoryTabCompletion(
     //  Set up state necessary for different types of searching.
     //
 
+    YoriLibInitEmptyString(&Prefix);
+    Prefix.StartOfString = TabContext->SearchString.StartOfString;
     FoundPath = _tcschr(TabContext->SearchString.StartOfString, '*');
     if (FoundPath != NULL) {
-        CompareLength = (DWORD)(FoundPath - TabContext->SearchString.StartOfString);
+        Prefix.LengthInChars = (DWORD)(FoundPath - TabContext->SearchString.StartOfString);
     } else {
-        CompareLength = TabContext->SearchString.LengthInChars;
+        Prefix.LengthInChars = TabContext->SearchString.LengthInChars;
     }
     FoundPath = NULL;
 
     //
-    //  Search the list of history.
+    //  Search the history index for entries beginning with the prefix.
     //
 
-    ListEntry = YoriLibGetPreviousListEntry(&YoriShGlobal.CommandHistory, NULL);
-    while (ListEntry != NULL) {
-        HistoryEntry = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
-
-        if (YoriLibCompareStringInsensitiveCount(&HistoryEntry->CmdLine, &TabContext->SearchString, CompareLength) == 0) {
+    HistoryEntry = YoriShFindPreviousHistoryMatch(&Prefix, TRUE, NULL);
+    while (HistoryEntry != NULL) {
 
-            //
-            //  Allocate a match entry for this file.
-            //
+        //
+        //  Allocate a match entry for this file.
+        //
 
-            Match = YoriLibReferencedMalloc(sizeof(YORI_SH_TAB_COMPLETE_MATCH) + (HistoryEntry->CmdLine.LengthInChars + 1) * sizeof(TCHAR));
-            if (Match == NULL) {
-                return;
-            }
+        Match = YoriLibReferencedMalloc(sizeof(YORI_SH_TAB_COMPLETE_MATCH) + (HistoryEntry->CmdLine.LengthInChars + 1) * sizeof(TCHAR));
+        if (Match == NULL) {
+            return;
+        }
 
-            //
-            //  Populate the file into the entry.
-            //
+        //
+        //  Populate the file into the entry.
+        //
 
-            YoriLibInitEmptyString(&Match->Value);
-            Match->Value.StartOfString = (LPTSTR)(Match + 1);
-            YoriLibReference(Match);
-            Match->Value.MemoryToFree = Match;
-            YoriLibSPrintf(Match->Value.StartOfString, _T("%y"), &HistoryEntry->CmdLine);
-            Match->Value.LengthInChars = HistoryEntry->CmdLine.LengthInChars;
+        YoriLibInitEmptyString(&Match->Value);
+        Match->Value.StartOfString = (LPTSTR)(Match + 1);
+        YoriLibReference(Match);
+        Match->Value.MemoryToFree = Match;
+        YoriLibSPrintf(Match->Value.StartOfString, _T("%y"), &HistoryEntry->CmdLine);
+        Match->Value.LengthInChars = HistoryEntry->CmdLine.LengthInChars;
 
-            //
-            //  Append to the list.
-            //
+        //
+        //  Append to the list.
+        //
 
-            YoriShAddMatchToTabContext(TabContext, NULL, Match);
+        YoriShAddMatchToTabContext(TabContext, NULL, Match);
 
-        }
-        ListEntry = YoriLibGetPreviousListEntry(&YoriShGlobal.CommandHistory, ListEntry);
+        HistoryEntry = YoriShFindPreviousHistoryMatch(&Prefix, TRUE, HistoryEntry);
     }
 }
 
@@ -507,6 +504,12 @@ typedef struct _YORI_SH_FILE_COMPLETE_CONTEXT {
      */
     DWORD CharsToFinalSlash;
 
+    /**
+     The compiled form of the search string following the final slash.  This
+     is compiled when first needed, and freed after each enumerate.
+     */
+    YORI_LIB_FILE_MATCH_EXPRESSION SearchExpression;
+
     /**
      The number of files that have been found.
      */
@@ -725,11 +728,16 @@ YoriShFileTabCompletionCallback(
         if (ShortFileName.LengthInChars == 0) {
             FileNameToUse = &LongFileName;
         } else {
-            YoriLibConstantString(&SearchAfterFinalSlash, &FileCompleteContext->SearchString[FileCompleteContext->CharsToFinalSlash]);
-            ASSERT(SearchAfterFinalSlash.LengthInChars > 0);
-            if (YoriLibDoesFileMatchExpression(&LongFileName, &SearchAfterFinalSlash)) {
+            if (FileCompleteContext->SearchExpression.Segments == NULL) {
+                YoriLibConstantString(&SearchAfterFinalSlash, &FileCompleteContext->SearchString[FileCompleteContext->CharsToFinalSlash]);
+                ASSERT(SearchAfterFinalSlash.LengthInChars > 0);
+                if (!YoriLibCompileFileMatchExpression(&SearchAfterFinalSlash, &FileCompleteContext->SearchExpression)) {
+                    return FALSE;
+                }
+            }
+            if (YoriLibDoesFileMatchCompiledExpression(&LongFileName, &FileCompleteContext->SearchExpression)) {
                 FileNameToUse = &LongFileName;
-            } else if (YoriLibDoesFileMatchExpression(&ShortFileName, &SearchAfterFinalSlash)) {
+            } else if (YoriLibDoesFileMatchCompiledExpression(&ShortFileName, &FileCompleteContext->SearchExpression)) {
                 FileNameToUse = &ShortFileName;
             } else {
 
@@ -923,6 +931,7 @@ YoriShPerformFileTabCompletion(
     EnumContext.SearchString = SearchString.StartOfString;
     EnumContext.TabContext = TabContext;
     EnumContext.FilesFound = 0;
+    ZeroMemory(&EnumContext.SearchExpression, sizeof(EnumContext.SearchExpression));
 
     //
     //  Set flags indicating what to find
@@ -964,6 +973,7 @@ YoriShPerformFileTabCompletion(
         (SearchString.StartOfString[0] != '>' && SearchString.StartOfString[0] != '<')) {
 
         YoriLibForEachStream(&SearchString, MatchFlags, 0, YoriShFileTabCompletionCallback, NULL, &EnumContext);
+        YoriLibFreeFileMatchExpression(&EnumContext.SearchExpression);
     }
 
     //
@@ -1076,6 +1086,7 @@ YoriShPerformFileTabCompletion(
         EnumContext.SearchString = SearchString.StartOfString;
 
         YoriLibForEachStream(&SearchString, MatchFlags, 0, YoriShFileTabCompletionCallback, NULL, &EnumContext);
+        YoriLibFreeFileMatchExpression(&EnumContext.SearchExpression);
 
         YoriLibFree(MatchArray);
     }
@@ -48,6 +48,618 @@ HANDLE YoriShHistoryLock;
  */
 BOOL YoriShHistoryInitialized;
 
+/**
+ If TRUE, adding a command which is already in history removes the earlier
+ instance, so each command appears once at its most recent position.
+ */
+BOOL YoriShHistoryDedupe;
+
+/**
+ The number of characters in each fragment of a command that is recorded in
+ the history search index.
+ */
+#define YORI_SH_HISTORY_GRAM_LENGTH (3)
+
+/**
+ A character used to pad the beginning of each command before it is broken
+ into fragments.  This allows fragments at the start of a command to be
+ distinguished from the same characters occurring later, so a prefix search
+ only needs to consider commands that begin with the prefix.
+ */
+#define YORI_SH_HISTORY_GRAM_ANCHOR ((TCHAR)1)
+
+/**
+ A fragment of command text, along with the sequence numbers of every
+ history entry that contains it.
+ */
+typedef struct _YORI_SH_HISTORY_GRAM {
+
+    /**
+     The hash entry for this fragment within the fragment table.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The upper case characters of the fragment.
+     */
+    TCHAR Chars[YORI_SH_HISTORY_GRAM_LENGTH];
+
+    /**
+     The number of elements populated in the Sequences array.
+     */
+    DWORD SequenceCount;
+
+    /**
+     The number of elements allocated in the Sequences array.
+     */
+    DWORD SequencesAllocated;
+
+    /**
+     An array of sequence numbers of history entries containing this
+     fragment, in ascending order.  This may refer to entries which have
+     since been removed from history.
+     */
+    PDWORD Sequences;
+} YORI_SH_HISTORY_GRAM, *PYORI_SH_HISTORY_GRAM;
+
+/**
+ An index over history entries, allowing entries to be found by prefix or
+ substring without comparing against every entry, and allowing duplicate
+ commands to be found.
+ */
+typedef struct _YORI_SH_HISTORY_INDEX {
+
+    /**
+     A hash table of fragments, each of which refers to a
+     YORI_SH_HISTORY_GRAM.
+     */
+    PYORI_HASH_TABLE GramTable;
+
+    /**
+     A hash table of complete commands, each of which refers to a
+     YORI_SH_HISTORY_ENTRY.
+     */
+    PYORI_HASH_TABLE CommandTable;
+
+    /**
+     An array of history entries indexed by sequence number.  Entries which
+     have been removed from history are NULL.
+     */
+    PYORI_SH_HISTORY_ENTRY * SequenceMap;
+
+    /**
+     The number of elements allocated in SequenceMap.
+     */
+    DWORD SequenceMapAllocated;
+
+    /**
+     The sequence number to assign to the next entry that is indexed.
+     */
+    DWORD NextSequence;
+
+    /**
+     The number of sequence numbers recorded across all fragments.
+     */
+    DWORD TotalPostings;
+
+    /**
+     The number of sequence numbers recorded across all fragments which
+     refer to entries that are still in history.
+     */
+    DWORD LivePostings;
+
+    /**
+     TRUE if every entry in history has been indexed.  If FALSE, searches
+     need to check each entry.
+     */
+    BOOL Valid;
+} YORI_SH_HISTORY_INDEX, *PYORI_SH_HISTORY_INDEX;
+
+/**
+ The index over command history.
+ */
+YORI_SH_HISTORY_INDEX YoriShHistoryIndex;
+
+/**
+ Generate the fragment of a command which ends at a specified character.  If
+ the fragment would begin before the start of the command, it is padded with
+ anchor characters.
+
+ @param String Pointer to the command to generate a fragment from.
+
+ @param EndIndex The offset of the final character in the fragment.
+
+ @param Gram On completion, populated with the upper case characters of the
+        fragment.
+ */
+VOID
+YoriShBuildHistoryGram(
+    __in PYORI_STRING String,
+    __in DWORD EndIndex,
+    __out_ecount(YORI_SH_HISTORY_GRAM_LENGTH) LPTSTR Gram
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < YORI_SH_HISTORY_GRAM_LENGTH; Index++) {
+        if (EndIndex + Index + 1 < YORI_SH_HISTORY_GRAM_LENGTH) {
+            Gram[Index] = YORI_SH_HISTORY_GRAM_ANCHOR;
+        } else {
+            Gram[Index] = YoriLibUpcaseChar(String->StartOfString[EndIndex + Index + 1 - YORI_SH_HISTORY_GRAM_LENGTH]);
+        }
+    }
+}
+
+/**
+ Find a fragment within the history index.
+
+ @param Gram Pointer to the upper case characters of the fragment.
+
+ @return Pointer to the fragment, or NULL if no history entry contains it.
+ */
+PYORI_SH_HISTORY_GRAM
+YoriShLookupHistoryGram(
+    __in_ecount(YORI_SH_HISTORY_GRAM_LENGTH) LPTSTR Gram
+    )
+{
+    YORI_STRING Key;
+    PYORI_HASH_ENTRY HashEntry;
+
+    YoriLibInitEmptyString(&Key);
+    Key.StartOfString = Gram;
+    Key.LengthInChars = YORI_SH_HISTORY_GRAM_LENGTH;
+
+    HashEntry = YoriLibHashLookupByKey(YoriShHistoryIndex.GramTable, &Key);
+    if (HashEntry == NULL) {
+        return NULL;
+    }
+
+    return HashEntry->Context;
+}
+
+/**
+ Record that a history entry contains a fragment.
+
+ @param Gram Pointer to the upper case characters of the fragment.
+
+ @param Sequence The sequence number of the history entry.  This must be
+        greater than or equal to any sequence number previously recorded.
+
+ @param Added On successful completion, set to TRUE if the sequence number
+        was recorded, or FALSE if it had already been recorded because the
+        fragment occurs more than once in the entry.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+BOOL
+YoriShAddHistoryGram(
+    __in_ecount(YORI_SH_HISTORY_GRAM_LENGTH) LPTSTR Gram,
+    __in DWORD Sequence,
+    __out PBOOL Added
+    )
+{
+    PYORI_SH_HISTORY_GRAM HistoryGram;
+    PDWORD NewSequences;
+    DWORD NewAllocated;
+    YORI_STRING Key;
+
+    *Added = FALSE;
+    HistoryGram = YoriShLookupHistoryGram(Gram);
+    if (HistoryGram == NULL) {
+        HistoryGram = YoriLibMalloc(sizeof(YORI_SH_HISTORY_GRAM));
+        if (HistoryGram == NULL) {
+            return FALSE;
+        }
+
+        ZeroMemory(HistoryGram, sizeof(YORI_SH_HISTORY_GRAM));
+        memcpy(HistoryGram->Chars, Gram, YORI_SH_HISTORY_GRAM_LENGTH * sizeof(TCHAR));
+
+        YoriLibInitEmptyString(&Key);
+        Key.StartOfString = HistoryGram->Chars;
+        Key.LengthInChars = YORI_SH_HISTORY_GRAM_LENGTH;
+        YoriLibHashInsertByKey(YoriShHistoryIndex.GramTable, &Key, HistoryGram, &HistoryGram->HashEntry);
+    }
+
+    if (HistoryGram->SequenceCount > 0 &&
+        HistoryGram->Sequences[HistoryGram->SequenceCount - 1] == Sequence) {
+
+        return TRUE;
+    }
+
+    if (HistoryGram->SequenceCount == HistoryGram->SequencesAllocated) {
+        NewAllocated = HistoryGram->SequencesAllocated * 2;
+        if (NewAllocated < 4) {
+            NewAllocated = 4;
+        }
+
+        NewSequences = YoriLibMalloc(NewAllocated * sizeof(DWORD));
+        if (NewSequences == NULL) {
+            return FALSE;
+        }
+
+        if (HistoryGram->Sequences != NULL) {
+            memcpy(NewSequences, HistoryGram->Sequences, HistoryGram->SequenceCount * sizeof(DWORD));
+            YoriLibFree(HistoryGram->Sequences);
+        }
+
+        HistoryGram->Sequences = NewSequences;
+        HistoryGram->SequencesAllocated = NewAllocated;
+    }
+
+    HistoryGram->Sequences[HistoryGram->SequenceCount] = Sequence;
+    HistoryGram->SequenceCount++;
+    *Added = TRUE;
+    return TRUE;
+}
+
+/**
+ Insert a history entry into the history index.  The entry is assigned the
+ next sequence number, so it is treated as more recent than every entry
+ indexed previously.
+
+ @param HistoryEntry Pointer to the entry to insert.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+         On failure the index no longer describes all of history, and the
+         caller is expected to discard it.
+ */
+BOOL
+YoriShIndexHistoryEntry(
+    __in PYORI_SH_HISTORY_ENTRY HistoryEntry
+    )
+{
+    PYORI_SH_HISTORY_ENTRY * NewSequenceMap;
+    DWORD NewAllocated;
+    DWORD Index;
+    BOOL Added;
+    TCHAR Gram[YORI_SH_HISTORY_GRAM_LENGTH];
+
+    if (YoriShHistoryIndex.NextSequence == YoriShHistoryIndex.SequenceMapAllocated) {
+        NewAllocated = YoriShHistoryIndex.SequenceMapAllocated * 2;
+        if (NewAllocated < 256) {
+            NewAllocated = 256;
+        }
+
+        NewSequenceMap = YoriLibMalloc(NewAllocated * sizeof(PYORI_SH_HISTORY_ENTRY));
+        if (NewSequenceMap == NULL) {
+            return FALSE;
+        }
+
+        if (YoriShHistoryIndex.SequenceMap != NULL) {
+            memcpy(NewSequenceMap, YoriShHistoryIndex.SequenceMap, YoriShHistoryIndex.NextSequence * sizeof(PYORI_SH_HISTORY_ENTRY));
+            YoriLibFree(YoriShHistoryIndex.SequenceMap);
+        }
+
+        YoriShHistoryIndex.SequenceMap = NewSequenceMap;
+        YoriShHistoryIndex.SequenceMapAllocated = NewAllocated;
+    }
+
+    HistoryEntry->Sequence = YoriShHistoryIndex.NextSequence;
+    HistoryEntry->IndexedGramCount = 0;
+    YoriShHistoryIndex.SequenceMap[HistoryEntry->Sequence] = HistoryEntry;
+    YoriShHistoryIndex.NextSequence++;
+
+    YoriLibHashInsertByKey(YoriShHistoryIndex.CommandTable, &HistoryEntry->CmdLine, HistoryEntry, &HistoryEntry->HashEntry);
+    HistoryEntry->Indexed = TRUE;
+
+    for (Index = 0; Index < HistoryEntry->CmdLine.LengthInChars; Index++) {
+        YoriShBuildHistoryGram(&HistoryEntry->CmdLine, Index, Gram);
+        if (!YoriShAddHistoryGram(Gram, HistoryEntry->Sequence, &Added)) {
+            return FALSE;
+        }
+        if (Added) {
+            HistoryEntry->IndexedGramCount++;
+            YoriShHistoryIndex.TotalPostings++;
+            YoriShHistoryIndex.LivePostings++;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Remove a history entry from the history index.  Fragments continue to refer
+ to the entry's sequence number, but the sequence number no longer resolves
+ to an entry.
+
+ @param HistoryEntry Pointer to the entry to remove.
+ */
+VOID
+YoriShUnindexHistoryEntry(
+    __in PYORI_SH_HISTORY_ENTRY HistoryEntry
+    )
+{
+    if (!HistoryEntry->Indexed) {
+        return;
+    }
+
+    YoriShHistoryIndex.SequenceMap[HistoryEntry->Sequence] = NULL;
+    YoriShHistoryIndex.LivePostings -= HistoryEntry->IndexedGramCount;
+    YoriLibHashRemoveByEntry(&HistoryEntry->HashEntry);
+    HistoryEntry->Indexed = FALSE;
+}
+
+/**
+ Discard the history index, so that searches check each entry.
+ */
+VOID
+YoriShFreeHistoryIndex()
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_SH_HISTORY_ENTRY HistoryEntry;
+    PYORI_SH_HISTORY_GRAM HistoryGram;
+    PYORI_HASH_ENTRY HashEntry;
+    DWORD BucketIndex;
+
+    if (YoriShGlobal.CommandHistory.Next != NULL) {
+        ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, NULL);
+        while (ListEntry != NULL) {
+            HistoryEntry = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
+            if (HistoryEntry->Indexed) {
+                YoriLibHashRemoveByEntry(&HistoryEntry->HashEntry);
+                HistoryEntry->Indexed = FALSE;
+            }
+            ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, ListEntry);
+        }
+    }
+
+    if (YoriShHistoryIndex.GramTable != NULL) {
+        for (BucketIndex = 0; BucketIndex < YoriShHistoryIndex.GramTable->NumberBuckets; BucketIndex++) {
+            ListEntry = YoriLibGetNextListEntry(&YoriShHistoryIndex.GramTable->Buckets[BucketIndex].ListHead, NULL);
+            while (ListEntry != NULL) {
+                HashEntry = CONTAINING_RECORD(ListEntry, YORI_HASH_ENTRY, ListEntry);
+                ListEntry = YoriLibGetNextListEntry(&YoriShHistoryIndex.GramTable->Buckets[BucketIndex].ListHead, ListEntry);
+                HistoryGram = HashEntry->Context;
+                YoriLibHashRemoveByEntry(HashEntry);
+                if (HistoryGram->Sequences != NULL) {
+                    YoriLibFree(HistoryGram->Sequences);
+                }
+                YoriLibFree(HistoryGram);
+            }
+        }
+        YoriLibFreeEmptyHashTable(YoriShHistoryIndex.GramTable);
+    }
+
+    if (YoriShHistoryIndex.CommandTable != NULL) {
+        YoriLibFreeEmptyHashTable(YoriShHistoryIndex.CommandTable);
+    }
+
+    if (YoriShHistoryIndex.SequenceMap != NULL) {
+        YoriLibFree(YoriShHistoryIndex.SequenceMap);
+    }
+
+    ZeroMemory(&YoriShHistoryIndex, sizeof(YoriShHistoryIndex));
+}
+
+/**
+ Construct the history index from the current contents of history.  Entries
+ are assigned sequence numbers in the order they occur in history, and any
+ state describing entries which have been removed is discarded.
+
+ @return TRUE to indicate the index was constructed, FALSE if it could not
+         be, in which case searches check each entry.
+ */
+BOOL
+YoriShBuildHistoryIndex()
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_SH_HISTORY_ENTRY HistoryEntry;
+    DWORD BucketCount;
+
+    YoriShFreeHistoryIndex();
+
+    //
+    //  The hash only generates 16 bits, so there's no value in having more
+    //  buckets than that.
+    //
+
+    BucketCount = YoriShCommandHistoryMax / 4;
+    if (BucketCount < 127) {
+        BucketCount = 127;
+    } else if (BucketCount > 0xFFFF) {
+        BucketCount = 0xFFFF;
+    }
+
+    YoriShHistoryIndex.GramTable = YoriLibAllocateHashTable(BucketCount);
+    YoriShHistoryIndex.CommandTable = YoriLibAllocateHashTable(BucketCount);
+    if (YoriShHistoryIndex.GramTable == NULL ||
+        YoriShHistoryIndex.CommandTable == NULL) {
+
+        YoriShFreeHistoryIndex();
+        return FALSE;
+    }
+
+    if (YoriShGlobal.CommandHistory.Next != NULL) {
+        ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, NULL);
+        while (ListEntry != NULL) {
+            HistoryEntry = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
+            if (!YoriShIndexHistoryEntry(HistoryEntry)) {
+                YoriShFreeHistoryIndex();
+                return FALSE;
+            }
+            ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, ListEntry);
+        }
+    }
+
+    YoriShHistoryIndex.Valid = TRUE;
+    return TRUE;
+}
+
+/**
+ Remove a history entry from history and the history index, and free it.
+ The caller is expected to hold the history lock.
+
+ @param HistoryEntry Pointer to the entry to free.
+ */
+VOID
+YoriShFreeHistoryEntry(
+    __in PYORI_SH_HISTORY_ENTRY HistoryEntry
+    )
+{
+    YoriShUnindexHistoryEntry(HistoryEntry);
+    YoriLibRemoveListItem(&HistoryEntry->ListEntry);
+    YoriLibFreeStringContents(&HistoryEntry->CmdLine);
+    YoriLibFree(HistoryEntry);
+    YoriShCommandHistoryCount--;
+}
+
+/**
+ Check whether a history entry matches a search string without regard to
+ case.
+
+ @param HistoryEntry Pointer to the entry to check.
+
+ @param SearchString Pointer to the string to search for.
+
+ @param PrefixMatch If TRUE, the entry must begin with the search string.
+        If FALSE, the search string may occur anywhere within the entry.
+
+ @return TRUE if the entry matches, FALSE if it does not.
+ */
+BOOL
+YoriShDoesHistoryEntryMatch(
+    __in PYORI_SH_HISTORY_ENTRY HistoryEntry,
+    __in PYORI_STRING SearchString,
+    __in BOOL PrefixMatch
+    )
+{
+    if (PrefixMatch) {
+        if (YoriLibCompareStringInsensitiveCount(&HistoryEntry->CmdLine, SearchString, SearchString->LengthInChars) == 0) {
+            return TRUE;
+        }
+        return FALSE;
+    }
+
+    if (SearchString->LengthInChars == 0 ||
+        YoriLibFindFirstMatchingSubstringInsensitive(&HistoryEntry->CmdLine, 1, SearchString, NULL) != NULL) {
+
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/**
+ Find the most recent history entry which is older than a specified entry and
+ matches a search string without regard to case.  Where possible the history
+ index is used to find the entries which contain the least common fragment
+ of the search string, so only those entries are compared.
+
+ @param SearchString Pointer to the string to search for.
+
+ @param PrefixMatch If TRUE, the entry must begin with the search string.
+        If FALSE, the search string may occur anywhere within the entry.
+
+ @param CurrentEntry If specified, the search begins with the entry prior to
+        this one.  If NULL, the search begins with the most recent entry.
+
+ @return Pointer to the matching entry, or NULL if no further match exists.
+ */
+PYORI_SH_HISTORY_ENTRY
+YoriShFindPreviousHistoryMatch(
+    __in PYORI_STRING SearchString,
+    __in BOOL PrefixMatch,
+    __in_opt PYORI_SH_HISTORY_ENTRY CurrentEntry
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_SH_HISTORY_ENTRY HistoryEntry;
+    PYORI_SH_HISTORY_GRAM HistoryGram;
+    PYORI_SH_HISTORY_GRAM BestGram;
+    TCHAR Gram[YORI_SH_HISTORY_GRAM_LENGTH];
+    DWORD Index;
+    DWORD Limit;
+    DWORD Start;
+    DWORD End;
+    DWORD Middle;
+
+    if (YoriShGlobal.CommandHistory.Next == NULL) {
+        return NULL;
+    }
+
+    //
+    //  If the index can't narrow the search, check each entry.  This occurs
+    //  for substrings that are shorter than a fragment, since fragments
+    //  for substrings don't include the anchor characters.
+    //
+
+    if (!YoriShHistoryIndex.Valid ||
+        SearchString->LengthInChars == 0 ||
+        (!PrefixMatch && SearchString->LengthInChars < YORI_SH_HISTORY_GRAM_LENGTH) ||
+        (CurrentEntry != NULL && !CurrentEntry->Indexed)) {
+
+        if (CurrentEntry != NULL) {
+            ListEntry = YoriLibGetPreviousListEntry(&YoriShGlobal.CommandHistory, &CurrentEntry->ListEntry);
+        } else {
+            ListEntry = YoriLibGetPreviousListEntry(&YoriShGlobal.CommandHistory, NULL);
+        }
+        while (ListEntry != NULL) {
+            HistoryEntry = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
+            if (YoriShDoesHistoryEntryMatch(HistoryEntry, SearchString, PrefixMatch)) {
+                return HistoryEntry;
+            }
+            ListEntry = YoriLibGetPreviousListEntry(&YoriShGlobal.CommandHistory, ListEntry);
+        }
+        return NULL;
+    }
+
+    //
+    //  Every fragment of the search string must be in a matching entry, so
+    //  find the fragment contained in the fewest entries.  If any fragment
+    //  is not found, nothing can match.
+    //
+
+    BestGram = NULL;
+    if (PrefixMatch) {
+        Index = 0;
+    } else {
+        Index = YORI_SH_HISTORY_GRAM_LENGTH - 1;
+    }
+    for (; Index < SearchString->LengthInChars; Index++) {
+        YoriShBuildHistoryGram(SearchString, Index, Gram);
+        HistoryGram = YoriShLookupHistoryGram(Gram);
+        if (HistoryGram == NULL) {
+            return NULL;
+        }
+        if (BestGram == NULL || HistoryGram->SequenceCount < BestGram->SequenceCount) {
+            BestGram = HistoryGram;
+        }
+    }
+
+    //
+    //  Find the first sequence number that is not older than the current
+    //  entry, and check each older entry from there.
+    //
+
+    if (CurrentEntry != NULL) {
+        Limit = CurrentEntry->Sequence;
+    } else {
+        Limit = YoriShHistoryIndex.NextSequence;
+    }
+
+    Start = 0;
+    End = BestGram->SequenceCount;
+    while (Start < End) {
+        Middle = Start + (End - Start) / 2;
+        if (BestGram->Sequences[Middle] < Limit) {
+            Start = Middle + 1;
+        } else {
+            End = Middle;
+        }
+    }
+
+    while (Start > 0) {
+        Start--;
+        HistoryEntry = YoriShHistoryIndex.SequenceMap[BestGram->Sequences[Start]];
+        if (HistoryEntry != NULL &&
+            YoriShDoesHistoryEntryMatch(HistoryEntry, SearchString, PrefixMatch)) {
+
+            return HistoryEntry;
+        }
+    }
+
+    return NULL;
+}
+
 /**
  Add an entered command into the command history buffer.
 
@@ -80,11 +692,27 @@ YoriShAddToHistory(
         }
 
         YoriLibCloneString(&NewHistoryEntry->CmdLine, NewCmd);
+        NewHistoryEntry->Indexed = FALSE;
 
         if (YoriShGlobal.CommandHistory.Next == NULL) {
             YoriLibInitializeListHead(&YoriShGlobal.CommandHistory);
         }
 
+        //
+        //  If duplicates should be removed, remove any earlier instance of
+        //  this command.  Commands that differ only by case are treated as
+        //  duplicates, and the most recent form is retained.
+        //
+
+        if (YoriShHistoryDedupe && YoriShHistoryIndex.Valid) {
+            PYORI_HASH_ENTRY HashEntry;
+
+            HashEntry = YoriLibHashLookupByKey(YoriShHistoryIndex.CommandTable, NewCmd);
+            if (HashEntry != NULL) {
+                YoriShFreeHistoryEntry(HashEntry->Context);
+            }
+        }
+
         YoriLibAppendList(&YoriShGlobal.CommandHistory, &NewHistoryEntry->ListEntry);
         YoriShCommandHistoryCount++;
         while (YoriShCommandHistoryCount > YoriShCommandHistoryMax) {
@@ -93,10 +721,28 @@ YoriShAddToHistory(
 
             ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, NULL);
             OldHistoryEntry = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
-            YoriLibRemoveListItem(ListEntry);
-            YoriLibFreeStringContents(&OldHistoryEntry->CmdLine);
-            YoriLibFree(OldHistoryEntry);
-            YoriShCommandHistoryCount--;
+            YoriShFreeHistoryEntry(OldHistoryEntry);
+        }
+
+        //
+        //  Index the new entry if it's still in history.  It is the most
+        //  recent entry so will not have been removed above unless history
+        //  is configured to hold nothing.  If the index
+        //  refers to many removed entries, rebuild it rather than letting
+        //  it grow indefinitely.
+        //
+
+        if (YoriShHistoryIndex.Valid &&
+            YoriShHistoryIndex.NextSequence <= 2 * YoriShCommandHistoryCount + 256 &&
+            YoriShHistoryIndex.TotalPostings <= 2 * YoriShHistoryIndex.LivePostings + 4096) {
+
+            if (YoriShCommandHistoryCount > 0 &&
+                !YoriShIndexHistoryEntry(NewHistoryEntry)) {
+
+                YoriShFreeHistoryIndex();
+            }
+        } else {
+            YoriShBuildHistoryIndex();
         }
         ReleaseMutex(YoriShHistoryLock);
     }
@@ -105,7 +751,8 @@ YoriShAddToHistory(
 }
 
 /**
- Remove a single command from the history buffer.
+ Remove a single command from the history buffer, and record its removal in
+ the history file so it is not loaded again.
 
  @param HistoryEntry Pointer to the entry to remove.
  */
@@ -115,10 +762,8 @@ YoriShRemoveOneHistoryEntry(
     )
 {
     if (WaitForSingleObject(YoriShHistoryLock, 0) == WAIT_OBJECT_0) {
-        YoriLibRemoveListItem(&HistoryEntry->ListEntry);
-        YoriLibFreeStringContents(&HistoryEntry->CmdLine);
-        YoriLibFree(HistoryEntry);
-        YoriShCommandHistoryCount--;
+        YoriShAddRemovalToHistoryFile(&HistoryEntry->CmdLine);
+        YoriShFreeHistoryEntry(HistoryEntry);
         ReleaseMutex(YoriShHistoryLock);
     }
 }
@@ -137,94 +782,379 @@ YoriShClearAllHistory()
         while (ListEntry != NULL) {
             HistoryEntry = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
             ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, ListEntry);
-            YoriLibRemoveListItem(&HistoryEntry->ListEntry);
-            YoriLibFreeStringContents(&HistoryEntry->CmdLine);
-            YoriLibFree(HistoryEntry);
-            YoriShCommandHistoryCount--;
+            YoriShFreeHistoryEntry(HistoryEntry);
         }
+        YoriShBuildHistoryIndex();
         ReleaseMutex(YoriShHistoryLock);
     }
 }
 
-/**
- Configure the maximum amount of history to retain if the user has requested
- this behavior by setting YORIHISTSIZE.
+/**
+ Configure the maximum amount of history to retain if the user has requested
+ this behavior by setting YORIHISTSIZE.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriShInitHistory()
+{
+    DWORD EnvVarLength;
+
+    if (YoriShHistoryInitialized) {
+        return FALSE;
+    }
+
+    if (YoriShHistoryLock == NULL) {
+        YoriShHistoryLock = CreateMutex(NULL, FALSE, NULL);
+    }
+
+    if (YoriShHistoryLock == NULL) {
+        return FALSE;
+    }
+
+    //
+    //  Default the history buffer size to something sane.
+    //
+
+    YoriShCommandHistoryMax = 250;
+
+    if (YoriShGlobal.CommandHistory.Next == NULL) {
+        YoriLibInitializeListHead(&YoriShGlobal.CommandHistory);
+    }
+
+    //
+    //  See if the user has other ideas.
+    //
+
+    EnvVarLength = YoriShGetEnvironmentVariableWithoutSubstitution(_T("YORIHISTSIZE"), NULL, 0, NULL);
+    if (EnvVarLength != 0) {
+        YORI_STRING HistSizeString;
+        DWORD CharsConsumed;
+        LONGLONG HistSize;
+
+        if (!YoriLibAllocateString(&HistSizeString, EnvVarLength)) {
+            return FALSE;
+        }
+
+        HistSizeString.LengthInChars = YoriShGetEnvironmentVariableWithoutSubstitution(_T("YORIHISTSIZE"), HistSizeString.StartOfString, HistSizeString.LengthAllocated, NULL);
+
+        if (HistSizeString.LengthInChars == 0 || HistSizeString.LengthInChars >= HistSizeString.LengthAllocated) {
+            return FALSE;
+        }
+
+        if (YoriLibStringToNumber(&HistSizeString, TRUE, &HistSize, &CharsConsumed) && CharsConsumed > 0) {
+            YoriShCommandHistoryMax = (DWORD)HistSize;
+        }
+
+        YoriLibFreeStringContents(&HistSizeString);
+    }
+
+    //
+    //  Check if the user wants repeated commands to replace earlier
+    //  instances.
+    //
+
+    YoriShHistoryDedupe = FALSE;
+    EnvVarLength = YoriShGetEnvironmentVariableWithoutSubstitution(_T("YORIHISTDEDUPE"), NULL, 0, NULL);
+    if (EnvVarLength != 0) {
+        YORI_STRING DedupeString;
+        DWORD CharsConsumed;
+        LONGLONG Dedupe;
+
+        if (!YoriLibAllocateString(&DedupeString, EnvVarLength)) {
+            return FALSE;
+        }
+
+        DedupeString.LengthInChars = YoriShGetEnvironmentVariableWithoutSubstitution(_T("YORIHISTDEDUPE"), DedupeString.StartOfString, DedupeString.LengthAllocated, NULL);
+
+        if (DedupeString.LengthInChars > 0 &&
+            DedupeString.LengthInChars < DedupeString.LengthAllocated &&
+            YoriLibStringToNumber(&DedupeString, TRUE, &Dedupe, &CharsConsumed) &&
+            CharsConsumed > 0 &&
+            Dedupe != 0) {
+
+            YoriShHistoryDedupe = TRUE;
+        }
+
+        YoriLibFreeStringContents(&DedupeString);
+    }
+
+    YoriShBuildHistoryIndex();
+    YoriShHistoryInitialized = TRUE;
+    return TRUE;
+}
+
+/**
+ The high 32 bits of the offset within the history file of a byte that is
+ locked by any shell modifying the file.  This is far beyond the end of any
+ history file, so locking it serializes modifications without preventing
+ any process from reading the file's contents.
+ */
+#define YORI_SH_HISTORY_LOCK_OFFSET_HIGH (0x7FFFFFFF)
+
+/**
+ The size of each block to read when scanning backwards through the history
+ file to find the most recent commands.
+ */
+#define YORI_SH_HISTORY_REVERSE_READ_SIZE (64 * 1024)
+
+/**
+ A character which begins a record in the history file that removes
+ commands rather than adding one.  A record consisting of only this
+ character clears all history loaded before it, and a record consisting of
+ this character followed by a command removes the most recent instance of
+ that command.  Removals are appended like commands, so the file is never
+ rewritten to record them.
+ */
+#define YORI_SH_HISTORY_REMOVE_MARKER ((TCHAR)0x01)
+
+/**
+ Resolve the name of the history file, if the user has requested history be
+ saved by configuring the YORIHISTFILE environment variable.
+
+ @param FilePath On successful completion, populated with the full path to
+        the history file.  If no history file is configured, this is
+        returned as an empty string.  The caller should free this with
+        @ref YoriLibFreeStringContents .
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriShGetHistoryFileName(
+    __out PYORI_STRING FilePath
+    )
+{
+    DWORD EnvVarLength;
+    YORI_STRING UserHistFileName;
+
+    YoriLibInitEmptyString(FilePath);
+
+    EnvVarLength = YoriShGetEnvironmentVariableWithoutSubstitution(_T("YORIHISTFILE"), NULL, 0, NULL);
+    if (EnvVarLength == 0) {
+        return TRUE;
+    }
+
+    if (!YoriLibAllocateString(&UserHistFileName, EnvVarLength)) {
+        return FALSE;
+    }
+
+    UserHistFileName.LengthInChars = YoriShGetEnvironmentVariableWithoutSubstitution(_T("YORIHISTFILE"), UserHistFileName.StartOfString, UserHistFileName.LengthAllocated, NULL);
+
+    if (UserHistFileName.LengthInChars == 0 || UserHistFileName.LengthInChars >= UserHistFileName.LengthAllocated) {
+        YoriLibFreeStringContents(&UserHistFileName);
+        return FALSE;
+    }
+
+    if (!YoriLibUserStringToSingleFilePath(&UserHistFileName, TRUE, FilePath)) {
+        YoriLibFreeStringContents(&UserHistFileName);
+        return FALSE;
+    }
+
+    YoriLibFreeStringContents(&UserHistFileName);
+    return TRUE;
+}
+
+/**
+ Acquire exclusive access to modify the history file.  This only excludes
+ other shells that are modifying the file, and waits briefly for them to
+ complete.
+
+ @param FileHandle Handle to the history file.  This must have been opened
+        with read or write access.
+
+ @return TRUE to indicate the lock was acquired, FALSE if it was not.
+ */
+BOOL
+YoriShLockHistoryFile(
+    __in HANDLE FileHandle
+    )
+{
+    DWORD Attempts;
+
+    for (Attempts = 0; Attempts < 100; Attempts++) {
+        if (LockFile(FileHandle, 0, YORI_SH_HISTORY_LOCK_OFFSET_HIGH, 1, 0)) {
+            return TRUE;
+        }
+        if (GetLastError() != ERROR_LOCK_VIOLATION) {
+            return FALSE;
+        }
+        Sleep(10);
+    }
+
+    return FALSE;
+}
+
+/**
+ Release exclusive access to modify the history file.
+
+ @param FileHandle Handle to the history file which was previously locked
+        with @ref YoriShLockHistoryFile .
+ */
+VOID
+YoriShUnlockHistoryFile(
+    __in HANDLE FileHandle
+    )
+{
+    UnlockFile(FileHandle, 0, YORI_SH_HISTORY_LOCK_OFFSET_HIGH, 1, 0);
+}
+
+/**
+ Find the offset within the history file where the final lines begin.  This
+ reads fixed size blocks backwards from the end of the file, so the amount
+ of data read depends on the number of lines requested rather than the size
+ of the file.
+
+ @param FileHandle Handle to the history file, opened for read access.
+
+ @param LinesNeeded The number of lines at the end of the file to find.
+
+ @param TailOffset On successful completion, populated with the offset of
+        the first of the final lines.  If the file contains fewer lines than
+        requested, this is zero.
+
+ @param FileSize On successful completion, populated with the size of the
+        file.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
-YoriShInitHistory()
+YoriShFindHistoryFileTail(
+    __in HANDLE FileHandle,
+    __in DWORD LinesNeeded,
+    __out PLARGE_INTEGER TailOffset,
+    __out PLARGE_INTEGER FileSize
+    )
 {
-    DWORD EnvVarLength;
-
-    if (YoriShHistoryInitialized) {
+    PUCHAR Block;
+    LARGE_INTEGER BlockOffset;
+    DWORD BlockLength;
+    DWORD BytesRead;
+    DWORD Index;
+    DWORD LinesFound;
+
+    TailOffset->QuadPart = 0;
+    FileSize->LowPart = GetFileSize(FileHandle, (PDWORD)&FileSize->HighPart);
+    if (FileSize->LowPart == INVALID_FILE_SIZE && GetLastError() != NO_ERROR) {
         return FALSE;
     }
 
-    if (YoriShHistoryLock == NULL) {
-        YoriShHistoryLock = CreateMutex(NULL, FALSE, NULL);
+    if (LinesNeeded == 0) {
+        TailOffset->QuadPart = FileSize->QuadPart;
+        return TRUE;
     }
 
-    if (YoriShHistoryLock == NULL) {
+    Block = YoriLibMalloc(YORI_SH_HISTORY_REVERSE_READ_SIZE);
+    if (Block == NULL) {
         return FALSE;
     }
 
-    //
-    //  Default the history buffer size to something sane.
-    //
+    LinesFound = 0;
+    BlockOffset.QuadPart = FileSize->QuadPart;
+    while (BlockOffset.QuadPart > 0) {
+        if (BlockOffset.QuadPart > YORI_SH_HISTORY_REVERSE_READ_SIZE) {
+            BlockLength = YORI_SH_HISTORY_REVERSE_READ_SIZE;
+        } else {
+            BlockLength = BlockOffset.LowPart;
+        }
+        BlockOffset.QuadPart = BlockOffset.QuadPart - BlockLength;
 
-    YoriShCommandHistoryMax = 250;
+        SetFilePointer(FileHandle, BlockOffset.LowPart, &BlockOffset.HighPart, FILE_BEGIN);
+        if (!ReadFile(FileHandle, Block, BlockLength, &BytesRead, NULL) ||
+            BytesRead != BlockLength) {
 
-    if (YoriShGlobal.CommandHistory.Next == NULL) {
-        YoriLibInitializeListHead(&YoriShGlobal.CommandHistory);
-    }
+            YoriLibFree(Block);
+            return FALSE;
+        }
 
-    //
-    //  See if the user has other ideas.
-    //
+        for (Index = BlockLength; Index > 0; Index--) {
+            if (Block[Index - 1] == '\n') {
 
-    EnvVarLength = YoriShGetEnvironmentVariableWithoutSubstitution(_T("YORIHISTSIZE"), NULL, 0, NULL);
-    if (EnvVarLength != 0) {
-        YORI_STRING HistSizeString;
-        DWORD CharsConsumed;
-        LONGLONG HistSize;
+                //
+                //  A newline at the end of the file terminates the final
+                //  line rather than beginning another one.
+                //
 
-        if (!YoriLibAllocateString(&HistSizeString, EnvVarLength)) {
-            return FALSE;
+                if (BlockOffset.QuadPart + Index == FileSize->QuadPart) {
+                    continue;
+                }
+
+                LinesFound++;
+                if (LinesFound == LinesNeeded) {
+                    TailOffset->QuadPart = BlockOffset.QuadPart + Index;
+                    YoriLibFree(Block);
+                    return TRUE;
+                }
+            }
         }
+    }
 
-        HistSizeString.LengthInChars = YoriShGetEnvironmentVariableWithoutSubstitution(_T("YORIHISTSIZE"), HistSizeString.StartOfString, HistSizeString.LengthAllocated, NULL);
+    YoriLibFree(Block);
+    return TRUE;
+}
 
-        if (HistSizeString.LengthInChars == 0 || HistSizeString.LengthInChars >= HistSizeString.LengthAllocated) {
-            return FALSE;
-        }
+/**
+ Apply a removal record read from the history file to the history that has
+ been loaded so far.
 
-        if (YoriLibStringToNumber(&HistSizeString, TRUE, &HistSize, &CharsConsumed) && CharsConsumed > 0) {
-            YoriShCommandHistoryMax = (DWORD)HistSize;
-        }
+ @param Record Pointer to the record, beginning with
+        @ref YORI_SH_HISTORY_REMOVE_MARKER .
+ */
+VOID
+YoriShApplyHistoryRemoval(
+    __in PYORI_STRING Record
+    )
+{
+    YORI_STRING CmdLine;
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_SH_HISTORY_ENTRY HistoryEntry;
 
-        YoriLibFreeStringContents(&HistSizeString);
+    if (Record->LengthInChars == 1) {
+        YoriShClearAllHistory();
+        return;
     }
-    YoriShHistoryInitialized = TRUE;
-    return TRUE;
+
+    YoriLibInitEmptyString(&CmdLine);
+    CmdLine.StartOfString = &Record->StartOfString[1];
+    CmdLine.LengthInChars = Record->LengthInChars - 1;
+
+    if (YoriShGlobal.CommandHistory.Next == NULL ||
+        WaitForSingleObject(YoriShHistoryLock, 0) != WAIT_OBJECT_0) {
+
+        return;
+    }
+
+    ListEntry = YoriLibGetPreviousListEntry(&YoriShGlobal.CommandHistory, NULL);
+    while (ListEntry != NULL) {
+        HistoryEntry = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
+        if (YoriLibCompareString(&HistoryEntry->CmdLine, &CmdLine) == 0) {
+            YoriShFreeHistoryEntry(HistoryEntry);
+            break;
+        }
+        ListEntry = YoriLibGetPreviousListEntry(&YoriShGlobal.CommandHistory, ListEntry);
+    }
+
+    ReleaseMutex(YoriShHistoryLock);
 }
 
 /**
  Load history from a file if the user has requested this behavior by
  setting YORIHISTFILE.  Configure the maximum amount of history to retain
- if the user has requested this behavior by setting YORIHISTSIZE.
+ if the user has requested this behavior by setting YORIHISTSIZE.  Only the
+ end of the file that can be retained in history is read, so the time taken
+ does not depend on the size of the file.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
 YoriShLoadHistoryFromFile()
 {
-    DWORD EnvVarLength;
-    YORI_STRING UserHistFileName;
     YORI_STRING FilePath;
     HANDLE FileHandle;
     PVOID LineContext = NULL;
     YORI_STRING LineString;
+    LARGE_INTEGER TailOffset;
+    LARGE_INTEGER FileSize;
+    BOOL Locked;
 
     if (YoriShHistoryInitialized) {
         return TRUE;
@@ -236,29 +1166,14 @@ YoriShLoadHistoryFromFile()
     //  Check if there's a file to load saved history from.
     //
 
-    EnvVarLength = YoriShGetEnvironmentVariableWithoutSubstitution(_T("YORIHISTFILE"), NULL, 0, NULL);
-    if (EnvVarLength == 0) {
-        return TRUE;
-    }
-
-    if (!YoriLibAllocateString(&UserHistFileName, EnvVarLength)) {
-        return FALSE;
-    }
-
-    UserHistFileName.LengthInChars = YoriShGetEnvironmentVariableWithoutSubstitution(_T("YORIHISTFILE"), UserHistFileName.StartOfString, UserHistFileName.LengthAllocated, NULL);
-
-    if (UserHistFileName.LengthInChars == 0 || UserHistFileName.LengthInChars >= UserHistFileName.LengthAllocated) {
-        YoriLibFreeStringContents(&UserHistFileName);
+    if (!YoriShGetHistoryFileName(&FilePath)) {
         return FALSE;
     }
 
-    if (!YoriLibUserStringToSingleFilePath(&UserHistFileName, TRUE, &FilePath)) {
-        YoriLibFreeStringContents(&UserHistFileName);
-        return FALSE;
+    if (FilePath.LengthInChars == 0) {
+        return TRUE;
     }
 
-    YoriLibFreeStringContents(&UserHistFileName);
-
     FileHandle = CreateFile(FilePath.StartOfString,
                             GENERIC_READ,
                             FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
@@ -273,13 +1188,37 @@ YoriShLoadHistoryFromFile()
             LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("yori: open of %y failed: %s"), &FilePath, ErrText);
             YoriLibFreeWinErrorText(ErrText);
-            YoriLibFreeStringContents(&FilePath);
         }
+        YoriLibFreeStringContents(&FilePath);
         return FALSE;
     }
 
     YoriLibFreeStringContents(&FilePath);
 
+    //
+    //  Hold the lock used by shells modifying the file, so the file is not
+    //  read while a record is being appended.  If the lock can't be
+    //  obtained, load it anyway, since a partial history is better than
+    //  none.
+    //
+
+    Locked = YoriShLockHistoryFile(FileHandle);
+
+    //
+    //  Skip to the lines that can be retained in history.  Lines are found
+    //  by looking for single byte newlines, which doesn't work for UTF16, so
+    //  in that case read the whole file.
+    //
+
+    TailOffset.QuadPart = 0;
+    if (YoriLibGetMultibyteInputEncoding() != CP_UTF16 &&
+        !YoriShFindHistoryFileTail(FileHandle, YoriShCommandHistoryMax, &TailOffset, &FileSize)) {
+
+        TailOffset.QuadPart = 0;
+    }
+
+    SetFilePointer(FileHandle, TailOffset.LowPart, &TailOffset.HighPart, FILE_BEGIN);
+
     YoriLibInitEmptyString(&LineString);
 
     while (TRUE) {
@@ -288,6 +1227,13 @@ YoriShLoadHistoryFromFile()
             break;
         }
 
+        if (LineString.LengthInChars > 0 &&
+            LineString.StartOfString[0] == YORI_SH_HISTORY_REMOVE_MARKER) {
+
+            YoriShApplyHistoryRemoval(&LineString);
+            continue;
+        }
+
         //
         //  If we fail to add to history, stop.  If it is added to history,
         //  that string is now owned by the history buffer, so reinitialize
@@ -304,86 +1250,395 @@ YoriShLoadHistoryFromFile()
 
     YoriLibLineReadClose(LineContext);
     YoriLibFreeStringContents(&LineString);
+
+    if (Locked) {
+        YoriShUnlockHistoryFile(FileHandle);
+    }
     CloseHandle(FileHandle);
     return TRUE;
 }
 
 /**
- Write the current command history buffer to a file, if the user has requested
- this behavior by configuring the YORIHISTFILE environment variable.
+ Check whether a handle to the history file still refers to the file named
+ by its path.  Compaction replaces the file, so a shell which opened the
+ file before it was replaced needs to reopen it before appending.
+
+ @param FileHandle Handle to the history file.
+
+ @param FilePath Pointer to the name of the history file.
+
+ @return TRUE if the handle refers to the file currently at the path, FALSE
+         if it does not.
+ */
+BOOL
+YoriShIsHistoryFileCurrent(
+    __in HANDLE FileHandle,
+    __in PYORI_STRING FilePath
+    )
+{
+    HANDLE PathHandle;
+    BY_HANDLE_FILE_INFORMATION HandleInfo;
+    BY_HANDLE_FILE_INFORMATION PathInfo;
+    BOOL Result;
+
+    PathHandle = CreateFile(FilePath->StartOfString,
+                            FILE_READ_ATTRIBUTES,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
+
+    if (PathHandle == NULL || PathHandle == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    Result = FALSE;
+    if (GetFileInformationByHandle(FileHandle, &HandleInfo) &&
+        GetFileInformationByHandle(PathHandle, &PathInfo) &&
+        HandleInfo.dwVolumeSerialNumber == PathInfo.dwVolumeSerialNumber &&
+        HandleInfo.nFileIndexHigh == PathInfo.nFileIndexHigh &&
+        HandleInfo.nFileIndexLow == PathInfo.nFileIndexLow) {
+
+        Result = TRUE;
+    }
+
+    CloseHandle(PathHandle);
+    return Result;
+}
+
+/**
+ The number of times to reopen the history file when appending to it, if it
+ was replaced between being opened and being locked.
+ */
+#define YORI_SH_HISTORY_APPEND_ATTEMPTS (3)
+
+/**
+ Append a record to the history file, if the user has requested this
+ behavior by configuring the YORIHISTFILE environment variable.  The record
+ is written with a single append so that records from concurrently
+ executing shells are all retained.
+
+ @param Removal If TRUE, the record removes a command from history rather
+        than adding one.
+
+ @param CmdLine Pointer to the command to add or remove.  For a removal
+        record, this can be NULL to indicate that all history is cleared.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
-YoriShSaveHistoryToFile()
+YoriShAppendHistoryRecord(
+    __in BOOL Removal,
+    __in_opt PYORI_STRING CmdLine
+    )
 {
-    DWORD FileNameLength;
-    YORI_STRING UserHistFileName;
     YORI_STRING FilePath;
     HANDLE FileHandle;
-    PYORI_LIST_ENTRY ListEntry;
-    PYORI_SH_HISTORY_ENTRY HistoryEntry;
+    LPTSTR Line;
+    LPSTR EncodedLine;
+    DWORD LineLength;
+    DWORD CmdLength;
+    DWORD BytesNeeded;
+    DWORD BytesWritten;
+    DWORD Attempt;
+    BOOL Locked;
+    BOOL Result;
+
+    if (!YoriShGetHistoryFileName(&FilePath)) {
+        return FALSE;
+    }
 
-    FileNameLength = YoriShGetEnvironmentVariableWithoutSubstitution(_T("YORIHISTFILE"), NULL, 0, NULL);
-    if (FileNameLength == 0) {
+    if (FilePath.LengthInChars == 0) {
         return TRUE;
     }
 
-    if (!YoriLibAllocateString(&UserHistFileName, FileNameLength)) {
+    CmdLength = 0;
+    if (CmdLine != NULL) {
+        CmdLength = CmdLine->LengthInChars;
+    }
+
+    Line = YoriLibMalloc((CmdLength + 2) * sizeof(TCHAR));
+    if (Line == NULL) {
+        YoriLibFreeStringContents(&FilePath);
         return FALSE;
     }
 
-    UserHistFileName.LengthInChars = YoriShGetEnvironmentVariableWithoutSubstitution(_T("YORIHISTFILE"), UserHistFileName.StartOfString, UserHistFileName.LengthAllocated, NULL);
+    LineLength = 0;
+    if (Removal) {
+        Line[LineLength] = YORI_SH_HISTORY_REMOVE_MARKER;
+        LineLength++;
+    }
+    if (CmdLength > 0) {
+        memcpy(&Line[LineLength], CmdLine->StartOfString, CmdLength * sizeof(TCHAR));
+        LineLength = LineLength + CmdLength;
+    }
+    Line[LineLength] = '\n';
+    LineLength++;
 
-    if (UserHistFileName.LengthInChars == 0 || UserHistFileName.LengthInChars >= UserHistFileName.LengthAllocated) {
-        YoriLibFreeStringContents(&UserHistFileName);
+    BytesNeeded = YoriLibGetMultibyteOutputSizeNeeded(Line, LineLength);
+    EncodedLine = YoriLibMalloc(BytesNeeded);
+    if (EncodedLine == NULL) {
+        YoriLibFree(Line);
+        YoriLibFreeStringContents(&FilePath);
         return FALSE;
     }
 
-    if (!YoriLibUserStringToSingleFilePath(&UserHistFileName, TRUE, &FilePath)) {
-        YoriLibFreeStringContents(&UserHistFileName);
+    YoriLibMultibyteOutput(Line, LineLength, EncodedLine, BytesNeeded);
+    YoriLibFree(Line);
+
+    Result = FALSE;
+    for (Attempt = 0; Attempt < YORI_SH_HISTORY_APPEND_ATTEMPTS; Attempt++) {
+        FileHandle = CreateFile(FilePath.StartOfString,
+                                GENERIC_READ | FILE_APPEND_DATA,
+                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                NULL,
+                                OPEN_ALWAYS,
+                                FILE_ATTRIBUTE_NORMAL,
+                                NULL);
+
+        if (FileHandle == NULL || FileHandle == INVALID_HANDLE_VALUE) {
+            break;
+        }
+
+        //
+        //  If the lock can't be obtained, append anyway.  The lock only
+        //  exists to prevent this record being discarded by a concurrent
+        //  compaction, and not writing it guarantees it will be lost.  If
+        //  the file was replaced by a compaction before the lock was
+        //  obtained, this handle refers to the file that was replaced, so
+        //  open the new one.
+        //
+
+        Locked = YoriShLockHistoryFile(FileHandle);
+        if (Locked &&
+            Attempt + 1 < YORI_SH_HISTORY_APPEND_ATTEMPTS &&
+            !YoriShIsHistoryFileCurrent(FileHandle, &FilePath)) {
+
+            YoriShUnlockHistoryFile(FileHandle);
+            CloseHandle(FileHandle);
+            continue;
+        }
+
+        Result = WriteFile(FileHandle, EncodedLine, BytesNeeded, &BytesWritten, NULL);
+        if (Locked) {
+            YoriShUnlockHistoryFile(FileHandle);
+        }
+        CloseHandle(FileHandle);
+        break;
+    }
+
+    YoriLibFree(EncodedLine);
+    YoriLibFreeStringContents(&FilePath);
+    return Result;
+}
+
+/**
+ Append a newly entered command to the history file, if the user has
+ requested this behavior by configuring the YORIHISTFILE environment
+ variable.
+
+ @param NewCmd Pointer to the command to append.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriShAddToHistoryFile(
+    __in PYORI_STRING NewCmd
+    )
+{
+    if (NewCmd->LengthInChars == 0) {
+        return TRUE;
+    }
+
+    return YoriShAppendHistoryRecord(FALSE, NewCmd);
+}
+
+/**
+ Append a record to the history file indicating that a command has been
+ removed from history, or that history has been cleared, so that the
+ command is not loaded from the file again.
+
+ @param CmdLine Pointer to the command that was removed.  If NULL, all
+        history has been cleared.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriShAddRemovalToHistoryFile(
+    __in_opt PYORI_STRING CmdLine
+    )
+{
+    return YoriShAppendHistoryRecord(TRUE, CmdLine);
+}
+
+/**
+ Discard records from the history file that would not be loaded into
+ history, if the user has requested history be saved by configuring the
+ YORIHISTFILE environment variable.  Since commands and removals are
+ appended to the file as they occur, this is the only maintenance the file
+ requires.  The file is only compacted once the records to discard occupy
+ at least as much space as the records to keep, so the cost is amortized
+ across the records that were appended.  The records to keep are read from
+ the file under its lock, including any appended by other processes, and
+ written to a new file which then replaces the original, so the original is
+ never truncated.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriShCompactHistoryFile()
+{
+    YORI_STRING FilePath;
+    YORI_STRING TempPath;
+    HANDLE FileHandle;
+    HANDLE TempHandle;
+    LARGE_INTEGER TailOffset;
+    LARGE_INTEGER FileSize;
+    LARGE_INTEGER BytesToKeep;
+    PUCHAR Buffer;
+    DWORD BytesRead;
+    DWORD BytesWritten;
+    DWORD LastError;
+    BOOL Written;
+    BOOL Replaced;
+    BOOL Result;
+
+    if (!YoriShGetHistoryFileName(&FilePath)) {
         return FALSE;
     }
 
-    YoriLibFreeStringContents(&UserHistFileName);
+    if (FilePath.LengthInChars == 0) {
+        return TRUE;
+    }
+
+    if (YoriLibGetMultibyteInputEncoding() == CP_UTF16) {
+        YoriLibFreeStringContents(&FilePath);
+        return FALSE;
+    }
 
     FileHandle = CreateFile(FilePath.StartOfString,
-                            GENERIC_WRITE,
+                            GENERIC_READ,
                             FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
                             NULL,
-                            CREATE_ALWAYS,
+                            OPEN_EXISTING,
                             FILE_ATTRIBUTE_NORMAL,
                             NULL);
 
     if (FileHandle == NULL || FileHandle == INVALID_HANDLE_VALUE) {
-        DWORD LastError = GetLastError();
-        LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("yori: open of %y failed: %s"), &FilePath, ErrText);
-        YoriLibFreeWinErrorText(ErrText);
+        LastError = GetLastError();
         YoriLibFreeStringContents(&FilePath);
+        if (LastError == ERROR_FILE_NOT_FOUND) {
+            return TRUE;
+        }
         return FALSE;
     }
 
-    YoriLibFreeStringContents(&FilePath);
+    if (!YoriShLockHistoryFile(FileHandle)) {
+        CloseHandle(FileHandle);
+        YoriLibFreeStringContents(&FilePath);
+        return FALSE;
+    }
 
     //
-    //  Search the list of history.
+    //  If another process compacted the file after it was opened, there's
+    //  nothing left to do.
     //
 
-    if (WaitForSingleObject(YoriShHistoryLock, 0) == WAIT_OBJECT_0) {
-        ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, NULL);
-        while (ListEntry != NULL) {
-            HistoryEntry = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
+    YoriLibInitEmptyString(&TempPath);
+    Buffer = NULL;
+    Result = FALSE;
+    if (!YoriShIsHistoryFileCurrent(FileHandle, &FilePath)) {
+        Result = TRUE;
+        goto Exit;
+    }
 
-            YoriLibOutputToDevice(FileHandle, 0, _T("%y\n"), &HistoryEntry->CmdLine);
+    if (!YoriShFindHistoryFileTail(FileHandle, YoriShCommandHistoryMax, &TailOffset, &FileSize)) {
+        goto Exit;
+    }
 
-            ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, ListEntry);
+    BytesToKeep.QuadPart = FileSize.QuadPart - TailOffset.QuadPart;
+    if (TailOffset.QuadPart < BytesToKeep.QuadPart || BytesToKeep.HighPart != 0) {
+        Result = TRUE;
+        goto Exit;
+    }
+
+    Buffer = YoriLibMalloc(BytesToKeep.LowPart + 1);
+    if (Buffer == NULL) {
+        goto Exit;
+    }
+
+    SetFilePointer(FileHandle, TailOffset.LowPart, &TailOffset.HighPart, FILE_BEGIN);
+    if (!ReadFile(FileHandle, Buffer, BytesToKeep.LowPart, &BytesRead, NULL) ||
+        BytesRead != BytesToKeep.LowPart) {
+
+        goto Exit;
+    }
+
+    if (YoriLibYPrintf(&TempPath, _T("%y.new"), &FilePath) == 0) {
+        goto Exit;
+    }
+
+    TempHandle = CreateFile(TempPath.StartOfString,
+                            GENERIC_WRITE,
+                            0,
+                            NULL,
+                            CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
+
+    if (TempHandle == NULL || TempHandle == INVALID_HANDLE_VALUE) {
+        goto Exit;
+    }
+
+    Written = FALSE;
+    if (WriteFile(TempHandle, Buffer, BytesToKeep.LowPart, &BytesWritten, NULL) &&
+        BytesWritten == BytesToKeep.LowPart) {
+
+        Written = TRUE;
+    }
+    CloseHandle(TempHandle);
+
+    //
+    //  Swap the new file in while still holding the lock on the original,
+    //  so nothing can be appended to the original after it was read.
+    //  ReplaceFile isn't available on older systems, so fall back to a
+    //  superseding rename, which is equally unable to leave a partially
+    //  written file behind.
+    //
+
+    Replaced = FALSE;
+    if (Written) {
+        YoriLibLoadKernel32Functions();
+        if (DllKernel32.pReplaceFileW != NULL) {
+            Replaced = DllKernel32.pReplaceFileW(FilePath.StartOfString,
+                                                 TempPath.StartOfString,
+                                                 NULL,
+                                                 REPLACEFILE_IGNORE_MERGE_ERRORS,
+                                                 NULL,
+                                                 NULL);
+        } else {
+            Replaced = MoveFileEx(TempPath.StartOfString,
+                                  FilePath.StartOfString,
+                                  MOVEFILE_REPLACE_EXISTING);
         }
-        ReleaseMutex(YoriShHistoryLock);
     }
 
+    if (Replaced) {
+        Result = TRUE;
+    } else {
+        DeleteFile(TempPath.StartOfString);
+    }
+
+Exit:
+    if (Buffer != NULL) {
+        YoriLibFree(Buffer);
+    }
+    YoriShUnlockHistoryFile(FileHandle);
     CloseHandle(FileHandle);
-    return TRUE;
+    YoriLibFreeStringContents(&TempPath);
+    YoriLibFreeStringContents(&FilePath);
+    return Result;
 }
 
 /**
@@ -413,15 +1668,23 @@ YoriShGetHistoryStrings(
     PYORI_LIST_ENTRY StartReturningFrom = NULL;
 
     if (YoriShGlobal.CommandHistory.Next != NULL) {
-        DWORD EntriesToSkip = 0;
+        DWORD EntriesToReturn;
+
+        //
+        //  Walk back from the most recent entry to find the first one to
+        //  return, so the cost depends on the number of entries requested
+        //  rather than the size of history.
+        //
+
         if (YoriShCommandHistoryCount > MaximumNumber && MaximumNumber > 0) {
-            EntriesToSkip = YoriShCommandHistoryCount - MaximumNumber;
-            while (EntriesToSkip > 0) {
-                ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, ListEntry);
-                EntriesToSkip--;
+            EntriesToReturn = MaximumNumber;
+            ListEntry = NULL;
+            while (EntriesToReturn > 0) {
+                ListEntry = YoriLibGetPreviousListEntry(&YoriShGlobal.CommandHistory, ListEntry);
+                EntriesToReturn--;
             }
 
-            StartReturningFrom = ListEntry;
+            StartReturningFrom = YoriLibGetPreviousListEntry(&YoriShGlobal.CommandHistory, ListEntry);
         }
 
         ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, StartReturningFrom);
@@ -498,6 +1761,13 @@ YoriShAddToHistoryAndReallocate(
         return FALSE;
     }
 
+    //
+    //  Commands added this way weren't entered, so they need to be appended
+    //  to the history file here to be retained.
+    //
+
+    YoriShAddToHistoryFile(&NewString);
+
     YoriLibFreeStringContents(&NewString);
     return TRUE;
 }
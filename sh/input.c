@@ -300,8 +300,347 @@ YoriShPostKeyPress(
     }
 }
 
+/**
+ Ensure the buffers used to track the cells displayed for the input line are
+ large enough to describe a specified number of cells.  If they are not,
+ reallocate them, preserving the cells that are currently displayed.
+
+ @param Buffer Pointer to the input buffer.
+
+ @param CellsNeeded The number of cells that must be describable.
+
+ @return TRUE to indicate the buffers are large enough, FALSE to indicate
+         allocation failure.
+ */
+BOOL
+YoriShEnsureDisplayCellsAllocated(
+    __inout PYORI_SH_INPUT_BUFFER Buffer,
+    __in DWORD CellsNeeded
+    )
+{
+    PCHAR_INFO NewDisplayedCells;
+    PCHAR_INFO NewPendingCells;
+    DWORD NewAllocated;
+
+    if (CellsNeeded <= Buffer->DisplayCellsAllocated) {
+        return TRUE;
+    }
+
+    NewAllocated = Buffer->DisplayCellsAllocated * 2;
+    if (NewAllocated < CellsNeeded + 256) {
+        NewAllocated = CellsNeeded + 256;
+    }
+
+    NewDisplayedCells = YoriLibMalloc(NewAllocated * sizeof(CHAR_INFO));
+    if (NewDisplayedCells == NULL) {
+        return FALSE;
+    }
+
+    NewPendingCells = YoriLibMalloc(NewAllocated * sizeof(CHAR_INFO));
+    if (NewPendingCells == NULL) {
+        YoriLibFree(NewDisplayedCells);
+        return FALSE;
+    }
+
+    if (Buffer->DisplayedCells != NULL) {
+        memcpy(NewDisplayedCells, Buffer->DisplayedCells, Buffer->DisplayedCellsValid * sizeof(CHAR_INFO));
+        YoriLibFree(Buffer->DisplayedCells);
+    }
+
+    if (Buffer->PendingCells != NULL) {
+        YoriLibFree(Buffer->PendingCells);
+    }
+
+    Buffer->DisplayedCells = NewDisplayedCells;
+    Buffer->PendingCells = NewPendingCells;
+    Buffer->DisplayCellsAllocated = NewAllocated;
+    return TRUE;
+}
+
+/**
+ Free the buffers used to track the cells displayed for the input line.
+
+ @param Buffer Pointer to the input buffer.
+ */
+VOID
+YoriShFreeDisplayCells(
+    __inout PYORI_SH_INPUT_BUFFER Buffer
+    )
+{
+    if (Buffer->DisplayedCells != NULL) {
+        YoriLibFree(Buffer->DisplayedCells);
+        Buffer->DisplayedCells = NULL;
+    }
+    if (Buffer->PendingCells != NULL) {
+        YoriLibFree(Buffer->PendingCells);
+        Buffer->PendingCells = NULL;
+    }
+    Buffer->DisplayCellsAllocated = 0;
+    Buffer->DisplayedCellsValid = 0;
+}
+
+/**
+ Compare the cells currently displayed for the input line against the cells
+ that should be displayed, and generate the set of ranges that need to be
+ written.  This routine performs no console operations so it can operate
+ against any simulated screen contents.
+
+ @param OldCells Pointer to the cells currently displayed.
+
+ @param OldCellsValid The number of elements in OldCells which are known to
+        be displayed.  Any cell beyond this point is considered changed.
+
+ @param NewCells Pointer to the cells that should be displayed.
+
+ @param NewCellCount The number of elements in NewCells.
+
+ @param MergeGap The number of unchanged cells that can separate two changed
+        ranges and still have the ranges combined into one.
+
+ @param Runs Pointer to an array of runs to populate.
+
+ @param MaxRuns The number of elements in the Runs array.  This must be
+        nonzero.  If more changed ranges are found than can be described,
+        the final run is extended to include all subsequent changes.
+
+ @return The number of runs populated.
+ */
+DWORD
+YoriShGenerateDisplayRuns(
+    __in PCHAR_INFO OldCells,
+    __in DWORD OldCellsValid,
+    __in PCHAR_INFO NewCells,
+    __in DWORD NewCellCount,
+    __in DWORD MergeGap,
+    __out PYORI_SH_DISPLAY_RUN Runs,
+    __in DWORD MaxRuns
+    )
+{
+    DWORD Index;
+    DWORD RunCount;
+    DWORD RunEnd;
+    PYORI_SH_DISPLAY_RUN CurrentRun;
+
+    ASSERT(MaxRuns > 0);
+
+    RunCount = 0;
+    CurrentRun = NULL;
+
+    for (Index = 0; Index < NewCellCount; Index++) {
+        if (Index < OldCellsValid &&
+            OldCells[Index].Char.UnicodeChar == NewCells[Index].Char.UnicodeChar &&
+            OldCells[Index].Attributes == NewCells[Index].Attributes) {
+
+            continue;
+        }
+
+        //
+        //  If this change is close enough to the previous one, or if there
+        //  is no space to describe another range, extend the previous range
+        //  to include it.
+        //
+
+        if (CurrentRun != NULL) {
+            RunEnd = CurrentRun->Offset + CurrentRun->Length;
+            if (Index - RunEnd <= MergeGap || RunCount == MaxRuns) {
+                CurrentRun->Length = Index - CurrentRun->Offset + 1;
+                continue;
+            }
+        }
+
+        CurrentRun = &Runs[RunCount];
+        RunCount++;
+        CurrentRun->Offset = Index;
+        CurrentRun->Length = 1;
+    }
+
+    return RunCount;
+}
+
+/**
+ Check whether a range of cells within the input line can be written to the
+ console as a single rectangle.  This is possible if the range is within a
+ single row, or if it can be extended to begin and end on row boundaries
+ without including any cell that is not part of the input line.  If the
+ range can be extended in this way, it is updated to describe the extended
+ range.  This routine performs no console operations.
+
+ @param ScreenWidth The number of cells in each console row.
+
+ @param LineStart The linear offset within the console buffer of the first
+        cell of the input line.
+
+ @param CellCount The number of cells in the input line.
+
+ @param Offset On input, points to the offset within the input line of the
+        range.  On successful completion, updated to contain the offset of
+        the extended range.
+
+ @param Length On input, points to the number of cells in the range.  On
+        successful completion, updated to contain the number of cells in the
+        extended range.
+
+ @return TRUE to indicate the range can be written as a single rectangle,
+         FALSE if it cannot.
+ */
+BOOL
+YoriShExpandDisplayRangeToRectangle(
+    __in DWORD ScreenWidth,
+    __in DWORD LineStart,
+    __in DWORD CellCount,
+    __inout PDWORD Offset,
+    __inout PDWORD Length
+    )
+{
+    DWORD RangeStart;
+    DWORD RangeEnd;
+
+    RangeStart = LineStart + *Offset;
+    RangeEnd = RangeStart + *Length;
+
+    if (RangeStart / ScreenWidth == (RangeEnd - 1) / ScreenWidth) {
+        return TRUE;
+    }
+
+    RangeStart = RangeStart - (RangeStart % ScreenWidth);
+    if (RangeStart < LineStart) {
+        return FALSE;
+    }
+
+    RangeEnd = ((RangeEnd - 1) / ScreenWidth + 1) * ScreenWidth;
+    if (RangeEnd > LineStart + CellCount) {
+        return FALSE;
+    }
+
+    *Offset = RangeStart - LineStart;
+    *Length = RangeEnd - RangeStart;
+    return TRUE;
+}
+
+/**
+ Write a rectangular range of cells from the input line to the console.  The
+ range must either be within a single row or begin and end on row
+ boundaries.
+
+ @param hConsole Handle to the console output.
+
+ @param ScreenWidth The number of cells in each console row.
+
+ @param LineStart The linear offset within the console buffer of the first
+        cell of the input line.
+
+ @param Cells Pointer to the cells of the input line.
+
+ @param Offset The offset within the input line of the first cell to write.
+
+ @param Length The number of cells to write.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriShWriteDisplayRectangle(
+    __in HANDLE hConsole,
+    __in DWORD ScreenWidth,
+    __in DWORD LineStart,
+    __in PCHAR_INFO Cells,
+    __in DWORD Offset,
+    __in DWORD Length
+    )
+{
+    COORD BufferSize;
+    COORD BufferOrigin;
+    SMALL_RECT WriteRect;
+    DWORD RangeStart;
+
+    RangeStart = LineStart + Offset;
+    BufferOrigin.X = 0;
+    BufferOrigin.Y = 0;
+    WriteRect.Left = (SHORT)(RangeStart % ScreenWidth);
+    WriteRect.Top = (SHORT)(RangeStart / ScreenWidth);
+
+    if (Length <= ScreenWidth - WriteRect.Left) {
+        BufferSize.X = (SHORT)Length;
+        BufferSize.Y = 1;
+    } else {
+        ASSERT(WriteRect.Left == 0 && (Length % ScreenWidth) == 0);
+        BufferSize.X = (SHORT)ScreenWidth;
+        BufferSize.Y = (SHORT)(Length / ScreenWidth);
+    }
+
+    WriteRect.Right = (SHORT)(WriteRect.Left + BufferSize.X - 1);
+    WriteRect.Bottom = (SHORT)(WriteRect.Top + BufferSize.Y - 1);
+
+    return WriteConsoleOutput(hConsole, &Cells[Offset], BufferSize, BufferOrigin, &WriteRect);
+}
+
+/**
+ Write a range of cells from the input line to the console.  The range is
+ contiguous within the input line but may wrap across console rows, so it is
+ written with as few rectangular writes as possible: a partial leading row,
+ any complete rows, and a partial trailing row.
+
+ @param hConsole Handle to the console output.
+
+ @param ScreenWidth The number of cells in each console row.
+
+ @param LineStart The linear offset within the console buffer of the first
+        cell of the input line.
+
+ @param CellCount The number of cells in the input line.
+
+ @param Cells Pointer to the cells of the input line.
+
+ @param Offset The offset within the input line of the first cell to write.
+
+ @param Length The number of cells to write.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriShWriteDisplayRange(
+    __in HANDLE hConsole,
+    __in DWORD ScreenWidth,
+    __in DWORD LineStart,
+    __in DWORD CellCount,
+    __in PCHAR_INFO Cells,
+    __in DWORD Offset,
+    __in DWORD Length
+    )
+{
+    DWORD ThisLength;
+    DWORD Column;
+
+    if (YoriShExpandDisplayRangeToRectangle(ScreenWidth, LineStart, CellCount, &Offset, &Length)) {
+        return YoriShWriteDisplayRectangle(hConsole, ScreenWidth, LineStart, Cells, Offset, Length);
+    }
+
+    while (Length > 0) {
+        Column = (LineStart + Offset) % ScreenWidth;
+        if (Column != 0 || Length < ScreenWidth) {
+            ThisLength = ScreenWidth - Column;
+            if (ThisLength > Length) {
+                ThisLength = Length;
+            }
+        } else {
+            ThisLength = Length - (Length % ScreenWidth);
+        }
+
+        if (!YoriShWriteDisplayRectangle(hConsole, ScreenWidth, LineStart, Cells, Offset, ThisLength)) {
+            return FALSE;
+        }
+
+        Offset += ThisLength;
+        Length -= ThisLength;
+    }
+
+    return TRUE;
+}
+
 /**
  After a key has been pressed and processed, display the resulting buffer.
+ The cells that should be displayed are compared against a shadow copy of
+ the cells that were previously displayed, and only the ranges that differ
+ are written to the console.
 
  @param Buffer Pointer to the input buffer to display.
 
@@ -312,13 +651,21 @@ YoriShDisplayAfterKeyPress(
     __in PYORI_SH_INPUT_BUFFER Buffer
     )
 {
-    DWORD NumberWritten;
-    DWORD NumberToWrite = 0;
-    DWORD NumberToFill = 0;
-    COORD WritePosition;
-    COORD FillPosition;
-    COORD SuggestionPosition;
+    DWORD Index;
+    DWORD CellCount;
+    DWORD CellsToDisplay;
+    DWORD LineStart;
+    DWORD ScreenWidth;
+    DWORD RunCount;
+    DWORD SpanOffset;
+    DWORD SpanLength;
+    WORD SuggestionAttributes;
+    PCHAR_INFO Cells;
+    PCHAR_INFO SwapCells;
+    BOOL AllWritten;
+    COORD LineStartPosition;
     CONSOLE_SCREEN_BUFFER_INFO ScreenInfo;
+    YORI_SH_DISPLAY_RUN Runs[YORI_SH_MAX_DISPLAY_RUNS];
     HANDLE hConsole;
 
     //
@@ -355,13 +702,6 @@ YoriShDisplayAfterKeyPress(
     YoriLibRedrawSelection(&Buffer->Selection);
     YoriLibRedrawSelection(&Buffer->Mouseover);
 
-    WritePosition.X = 0;
-    WritePosition.Y = 0;
-    SuggestionPosition.X = 0;
-    SuggestionPosition.Y = 0;
-    FillPosition.X = 0;
-    FillPosition.Y = 0;
-
     //
     //  Re-render the text if part of the input string has changed,
     //  or if the location of the cursor in the input string has changed
@@ -377,98 +717,111 @@ YoriShDisplayAfterKeyPress(
         }
 
         //
-        //  Calculate the number of characters truncated from the currently
-        //  displayed buffer.
+        //  Any cells that were previously displayed beyond the end of the
+        //  new text need to be erased, so they are included as blank cells.
         //
 
-        if (Buffer->PreviousCharsDisplayed > Buffer->String.LengthInChars + Buffer->SuggestionString.LengthInChars) {
-            NumberToFill = Buffer->PreviousCharsDisplayed - Buffer->String.LengthInChars - Buffer->SuggestionString.LengthInChars;
+        CellCount = Buffer->String.LengthInChars + Buffer->SuggestionString.LengthInChars;
+        CellsToDisplay = CellCount;
+        if (Buffer->PreviousCharsDisplayed > CellsToDisplay) {
+            CellsToDisplay = Buffer->PreviousCharsDisplayed;
+        }
+
+        if (!YoriShEnsureDisplayCellsAllocated(Buffer, CellsToDisplay)) {
+            return FALSE;
+        }
+
+        Cells = Buffer->PendingCells;
+        for (Index = 0; Index < Buffer->String.LengthInChars; Index++) {
+            Cells[Index].Char.UnicodeChar = Buffer->String.StartOfString[Index];
+            Cells[Index].Attributes = ScreenInfo.wAttributes;
+        }
+
+        SuggestionAttributes = (WORD)((ScreenInfo.wAttributes & 0xF0) | FOREGROUND_INTENSITY);
+        for (Index = 0; Index < Buffer->SuggestionString.LengthInChars; Index++) {
+            Cells[Buffer->String.LengthInChars + Index].Char.UnicodeChar = Buffer->SuggestionString.StartOfString[Index];
+            Cells[Buffer->String.LengthInChars + Index].Attributes = SuggestionAttributes;
+        }
+
+        for (Index = CellCount; Index < CellsToDisplay; Index++) {
+            Cells[Index].Char.UnicodeChar = ' ';
+            Cells[Index].Attributes = ScreenInfo.wAttributes;
         }
 
-        //
-        //  Calculate the locations to write both the new text as well as where
-        //  to erase any previous text.
         //
         //  Calculate where the buffer will end in order to force the display
-        //  to scroll so the whole output has somewhere to go.  The suggestion
-        //  is scrolled first because it must be longer than the buffer alone,
-        //  so doing this ensures sufficient scrolling has performed for both
-        //  WritePosition and SelectionPosition to be valid.
+        //  to scroll so the whole output has somewhere to go, then find
+        //  where the input line begins after any scrolling.
         //
 
-        if (Buffer->SuggestionString.LengthInChars > 0) {
-            if (!YoriShDetermineCellLocationIfMovedCacheResult(hConsole, &ScreenInfo, -1 * Buffer->PreviousCurrentOffset + Buffer->String.LengthInChars + Buffer->SuggestionString.LengthInChars, NULL)) {
-                return FALSE;
-            }
-            if (!YoriShDetermineCellLocationIfMovedCacheResult(hConsole, &ScreenInfo, -1 * Buffer->PreviousCurrentOffset + Buffer->String.LengthInChars, &SuggestionPosition)) {
-                return FALSE;
-            }
+        if (!YoriShDetermineCellLocationIfMovedCacheResult(hConsole, &ScreenInfo, -1 * Buffer->PreviousCurrentOffset + CellsToDisplay, NULL)) {
+            return FALSE;
+        }
+        if (!YoriShDetermineCellLocationIfMovedCacheResult(hConsole, &ScreenInfo, -1 * Buffer->PreviousCurrentOffset, &LineStartPosition)) {
+            return FALSE;
         }
 
-        if (Buffer->DirtyBeginOffset < Buffer->String.LengthInChars && Buffer->DirtyLength > 0) {
-            if (Buffer->DirtyBeginOffset + Buffer->DirtyLength > Buffer->String.LengthInChars) {
-                NumberToWrite = Buffer->String.LengthInChars - Buffer->DirtyBeginOffset;
-            } else {
-                NumberToWrite = Buffer->DirtyLength;
-            }
+        ScreenWidth = ScreenInfo.dwSize.X;
+        LineStart = LineStartPosition.Y * ScreenWidth + LineStartPosition.X;
 
-            if (!YoriShDetermineCellLocationIfMovedCacheResult(hConsole, &ScreenInfo, (-1 * Buffer->PreviousCurrentOffset) + Buffer->DirtyBeginOffset + NumberToWrite, NULL)) {
-                return FALSE;
-            }
-            if (!YoriShDetermineCellLocationIfMovedCacheResult(hConsole, &ScreenInfo, (-1 * Buffer->PreviousCurrentOffset) + Buffer->DirtyBeginOffset, &WritePosition)) {
-                return FALSE;
-            }
-        }
+        RunCount = YoriShGenerateDisplayRuns(Buffer->DisplayedCells, Buffer->DisplayedCellsValid, Cells, CellsToDisplay, YORI_SH_DISPLAY_RUN_MERGE_GAP, Runs, sizeof(Runs)/sizeof(Runs[0]));
 
+        //
+        //  If there are multiple changed ranges but everything between them
+        //  can be described as one rectangle, write it all at once.
+        //
 
-        if (NumberToFill) {
-            if (!YoriShDetermineCellLocationIfMovedCacheResult(hConsole, &ScreenInfo, -1 * Buffer->PreviousCurrentOffset + Buffer->String.LengthInChars + Buffer->SuggestionString.LengthInChars + NumberToFill, NULL)) {
-                return FALSE;
-            }
-            if (!YoriShDetermineCellLocationIfMovedCacheResult(hConsole, &ScreenInfo, -1 * Buffer->PreviousCurrentOffset + Buffer->String.LengthInChars + Buffer->SuggestionString.LengthInChars, &FillPosition)) {
-                return FALSE;
+        if (RunCount > 1) {
+            SpanOffset = Runs[0].Offset;
+            SpanLength = Runs[RunCount - 1].Offset + Runs[RunCount - 1].Length - SpanOffset;
+            if (YoriShExpandDisplayRangeToRectangle(ScreenWidth, LineStart, CellsToDisplay, &SpanOffset, &SpanLength)) {
+                Runs[0].Offset = SpanOffset;
+                Runs[0].Length = SpanLength;
+                RunCount = 1;
             }
         }
 
-        if (NumberToWrite > 0 ||
-            Buffer->SuggestionString.LengthInChars > 0 ||
-            Buffer->CurrentOffset != Buffer->PreviousCurrentOffset) {
-
-            //
-            //  Now that we know where the text should go, advance the cursor
-            //  and render the text.
-            //
-
+        if (Buffer->CurrentOffset != Buffer->PreviousCurrentOffset) {
             if (!YoriShMoveCursorCacheResult(hConsole, &ScreenInfo, Buffer->CurrentOffset - Buffer->PreviousCurrentOffset)) {
                 return FALSE;
             }
+        }
 
-            if (NumberToWrite) {
-                WriteConsoleOutputCharacter(hConsole, &Buffer->String.StartOfString[Buffer->DirtyBeginOffset], NumberToWrite, WritePosition, &NumberWritten);
-                FillConsoleOutputAttribute(hConsole, ScreenInfo.wAttributes, NumberToWrite, WritePosition, &NumberWritten);
-            }
-
-            if (Buffer->SuggestionString.LengthInChars > 0) {
-                WriteConsoleOutputCharacter(hConsole, Buffer->SuggestionString.StartOfString, Buffer->SuggestionString.LengthInChars, SuggestionPosition, &NumberWritten);
-                FillConsoleOutputAttribute(hConsole, (USHORT)((ScreenInfo.wAttributes & 0xF0) | FOREGROUND_INTENSITY), Buffer->SuggestionString.LengthInChars, SuggestionPosition, &NumberWritten);
+        AllWritten = TRUE;
+        for (Index = 0; Index < RunCount; Index++) {
+            if (!YoriShWriteDisplayRange(hConsole, ScreenWidth, LineStart, CellsToDisplay, Cells, Runs[Index].Offset, Runs[Index].Length)) {
+                AllWritten = FALSE;
             }
         }
 
         //
-        //  If there are additional cells to empty due to truncation, display
-        //  those now.
+        //  If everything was written, the cells just constructed now
+        //  describe the console.  The blank cells past the end of the text
+        //  don't need to be tracked since they will not be considered
+        //  displayed.  If anything failed, the console contents are not
+        //  known, so discard the shadow copy so the next display writes
+        //  every cell, including any that may need to be erased.
         //
 
-        if (NumberToFill) {
-            FillConsoleOutputCharacter(hConsole, ' ', NumberToFill, FillPosition, &NumberWritten);
-            FillConsoleOutputAttribute(hConsole, ScreenInfo.wAttributes, NumberToFill, FillPosition, &NumberWritten);
+        if (AllWritten) {
+            SwapCells = Buffer->DisplayedCells;
+            Buffer->DisplayedCells = Buffer->PendingCells;
+            Buffer->PendingCells = SwapCells;
+            Buffer->DisplayedCellsValid = CellCount;
+            Buffer->PreviousCharsDisplayed = CellCount;
+        } else {
+            Buffer->DisplayedCellsValid = 0;
+            Buffer->PreviousCharsDisplayed = CellsToDisplay;
         }
 
         Buffer->PreviousCurrentOffset = Buffer->CurrentOffset;
-        Buffer->PreviousCharsDisplayed = Buffer->String.LengthInChars + Buffer->SuggestionString.LengthInChars;
         Buffer->DirtyBeginOffset = 0;
         Buffer->DirtyLength = 0;
         Buffer->SuggestionDirty = FALSE;
+
+        if (!AllWritten) {
+            return FALSE;
+        }
     }
 
     return TRUE;
@@ -585,7 +938,7 @@ YoriShAppCloseCtrlHandler(
         CtrlType == CTRL_LOGOFF_EVENT ||
         CtrlType == CTRL_SHUTDOWN_EVENT) {
 
-        YoriShSaveHistoryToFile();
+        YoriShCompactHistoryFile();
         return FALSE;
     }
 
@@ -620,6 +973,7 @@ YoriShTerminateInput(
     YoriShClearTabCompletionMatches(Buffer);
     YoriLibCleanupSelection(&Buffer->Selection);
     YoriLibCleanupSelection(&Buffer->Mouseover);
+    YoriShFreeDisplayCells(Buffer);
     Buffer->String.StartOfString[Buffer->String.LengthInChars] = '\0';
     YoriShMoveCursor(Buffer->String.LengthInChars - Buffer->CurrentOffset);
     YoriShConfigureMouseForPrograms(Buffer->ConsoleInputHandle);
@@ -1426,6 +1780,7 @@ YoriShClearScreen(
     Buffer->PreviousCurrentOffset = 0;
     Buffer->DirtyBeginOffset = 0;
     Buffer->DirtyLength = Buffer->String.LengthInChars;
+    Buffer->DisplayedCellsValid = 0;
 }
 
 /**
@@ -2467,6 +2822,13 @@ YoriShGetExpressionFromConsole(
                 }
 
             } else if (InputRecord->EventType == WINDOW_BUFFER_SIZE_EVENT) {
+
+                //
+                //  The console may have reflowed the input line, so the
+                //  cells it contains are no longer known.
+                //
+
+                Buffer.DisplayedCellsValid = 0;
                 ReDisplayRequired |= YoriShClearInputSelections(&Buffer);
             } else if (InputRecord->EventType == FOCUS_EVENT) {
                 if (InputRecord->Event.FocusEvent.bSetFocus) {
@@ -2480,6 +2842,7 @@ YoriShGetExpressionFromConsole(
                 ReadConsoleInput(InputHandle, InputRecords, CurrentRecordIndex + 1, &ActuallyRead);
                 if (Buffer.String.LengthInChars > 0) {
                     YoriShAddToHistory(&Buffer.String);
+                    YoriShAddToHistoryFile(&Buffer.String);
                 }
                 memcpy(Expression, &Buffer.String, sizeof(YORI_STRING));
                 return TRUE;
@@ -672,7 +672,7 @@ ymain (
             YoriLibFreeStringContents(&CurrentExpression);
         }
 
-        YoriShSaveHistoryToFile();
+        YoriShCompactHistoryFile();
     }
 
     YoriShScanProcessBuffersForTeardown(TRUE);
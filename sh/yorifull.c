@@ -91,6 +91,11 @@ YORI_CMD_BUILTIN YoriCmd_YCUT;
  */
 YORI_CMD_BUILTIN YoriCmd_CVTVT;
 
+/**
+ Declaration for the builtin command.
+ */
+YORI_CMD_BUILTIN YoriCmd_DEDUPE;
+
 /**
  Declaration for the builtin command.
  */
@@ -146,6 +151,11 @@ YORI_CMD_BUILTIN YoriCmd_YEXPR;
  */
 YORI_CMD_BUILTIN YoriCmd_FALSE;
 
+/**
+ Declaration for the builtin command.
+ */
+YORI_CMD_BUILTIN YoriCmd_FFIND;
+
 /**
  Declaration for the builtin command.
  */
@@ -479,9 +489,11 @@ YoriShBuiltins[] = {
                     {_T("COLOR"),     YoriCmd_COLOR},
                     {_T("CSHOT"),     YoriCmd_CSHOT},
                     {_T("CVTVT"),     YoriCmd_CVTVT},
+                    {_T("DEDUPE"),    YoriCmd_DEDUPE},
                     {_T("EXIT"),      YoriCmd_EXIT},
                     {_T("FALSE"),     YoriCmd_FALSE},
                     {_T("FG"),        YoriCmd_FG},
+                    {_T("FFIND"),     YoriCmd_FFIND},
                     {_T("FINFO"),     YoriCmd_FINFO},
                     {_T("FOR"),       YoriCmd_FOR},
                     {_T("FSCMP"),     YoriCmd_FSCMP},
@@ -351,7 +351,17 @@ BOOL
 YoriShLoadHistoryFromFile();
 
 BOOL
-YoriShSaveHistoryToFile();
+YoriShAddToHistoryFile(
+    __in PYORI_STRING NewCmd
+    );
+
+BOOL
+YoriShAddRemovalToHistoryFile(
+    __in_opt PYORI_STRING CmdLine
+    );
+
+BOOL
+YoriShCompactHistoryFile();
 
 BOOL
 YoriShGetHistoryStrings(
@@ -359,6 +369,13 @@ YoriShGetHistoryStrings(
     __inout PYORI_STRING HistoryStrings
     );
 
+PYORI_SH_HISTORY_ENTRY
+YoriShFindPreviousHistoryMatch(
+    __in PYORI_STRING SearchString,
+    __in BOOL PrefixMatch,
+    __in_opt PYORI_SH_HISTORY_ENTRY CurrentEntry
+    );
+
 // *** INPUT.C ***
 
 BOOL
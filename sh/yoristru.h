@@ -378,6 +378,29 @@ typedef struct _YORI_SH_HISTORY_ENTRY {
      The command that was executed by the user.
      */
     YORI_STRING CmdLine;
+
+    /**
+     The hash entry for this command, used to find earlier instances of
+     the same command so that duplicates can be removed.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     A monotonically increasing number describing the order in which this
+     entry was indexed.  More recent entries have higher numbers.
+     */
+    DWORD Sequence;
+
+    /**
+     The number of entries in the search index that refer to this history
+     entry.
+     */
+    DWORD IndexedGramCount;
+
+    /**
+     TRUE if this entry has been inserted into the search index.
+     */
+    BOOLEAN Indexed;
 } YORI_SH_HISTORY_ENTRY, *PYORI_SH_HISTORY_ENTRY;
 
 /**
@@ -622,8 +645,66 @@ typedef struct _YORI_SH_INPUT_BUFFER {
      */
     YORI_STRING SearchString;
 
+    /**
+     A shadow copy of the cells most recently written to the console for
+     the input line, including any suggestion.  This is used to determine
+     which cells need to be written on redisplay.
+     */
+    PCHAR_INFO DisplayedCells;
+
+    /**
+     A buffer used to construct the cells that should be displayed.  Once
+     the console has been updated, this is exchanged with DisplayedCells.
+     */
+    PCHAR_INFO PendingCells;
+
+    /**
+     The number of elements allocated in both DisplayedCells and
+     PendingCells.
+     */
+    DWORD DisplayCellsAllocated;
+
+    /**
+     The number of elements in DisplayedCells which are known to reflect
+     the contents of the console.  Cells beyond this point must be written
+     unconditionally.
+     */
+    DWORD DisplayedCellsValid;
+
 } YORI_SH_INPUT_BUFFER, *PYORI_SH_INPUT_BUFFER;
 
+/**
+ The maximum number of distinct changed regions that will be tracked when
+ comparing the displayed input line against its new contents.  If more
+ regions than this are changed, the final region is extended to cover all
+ later changes.
+ */
+#define YORI_SH_MAX_DISPLAY_RUNS (16)
+
+/**
+ The number of unchanged cells that can separate two changed regions and
+ still have them rewritten as a single region.  Rewriting a few unchanged
+ cells is cheaper than issuing another console call.
+ */
+#define YORI_SH_DISPLAY_RUN_MERGE_GAP (8)
+
+/**
+ A contiguous range of cells, in terms of offsets from the beginning of the
+ input line, which need to be written to the console.
+ */
+typedef struct _YORI_SH_DISPLAY_RUN {
+
+    /**
+     The offset of the first cell to write.
+     */
+    DWORD Offset;
+
+    /**
+     The number of cells to write.
+     */
+    DWORD Length;
+} YORI_SH_DISPLAY_RUN, *PYORI_SH_DISPLAY_RUN;
+
 /**
  A structure defining a mapping between a command name and a function to
  execute.  This is used to populate builtin commands.
@@ -56,6 +56,17 @@ SplitHelp()
     return TRUE;
 }
 
+/**
+ The number of bytes to read or write at a time when copying data between
+ a combined file and its parts.
+ */
+#define SPLIT_COPY_BUFFER_SIZE (1024 * 1024)
+
+/**
+ The maximum number of threads to use when copying parts concurrently.
+ */
+#define SPLIT_MAX_THREADS 8
+
 /**
  Context passed to the callback which is invoked for each file found.
  */
@@ -89,8 +100,161 @@ typedef struct _SPLIT_CONTEXT {
      */
     YORI_STRING Prefix;
 
+    /**
+     If the input is a file, the full path to the file.  This allows parts
+     to be generated concurrently, each with its own handle to the source.
+     If the input is a pipe, this is NULL.
+     */
+    PYORI_STRING SourceFileName;
+
 } SPLIT_CONTEXT, *PSPLIT_CONTEXT;
 
+/**
+ Information about a single part of a combined file.
+ */
+typedef struct _SPLIT_PART {
+
+    /**
+     The full path to the part file.
+     */
+    YORI_STRING FileName;
+
+    /**
+     The offset within the combined file where this part begins.
+     */
+    LONGLONG Offset;
+
+    /**
+     The number of bytes in this part.
+     */
+    LONGLONG Length;
+
+} SPLIT_PART, *PSPLIT_PART;
+
+/**
+ A set of parts to copy to or from a combined file, which can be processed
+ by multiple threads.
+ */
+typedef struct _SPLIT_COPY_JOB {
+
+    /**
+     If TRUE, the parts are copied into the combined file.  If FALSE, the
+     combined file is copied into the parts.
+     */
+    BOOL Join;
+
+    /**
+     Pointer to the full path of the combined file.
+     */
+    PYORI_STRING CombinedFileName;
+
+    /**
+     An array of parts to process.  If NULL, each part is generated as it is
+     processed from Prefix, FirstPartNumber, BytesPerPart and CombinedLength.
+     */
+    PSPLIT_PART Parts;
+
+    /**
+     The number of parts to process.
+     */
+    DWORD PartCount;
+
+    /**
+     If Parts is NULL, pointer to the prefix of part files.
+     */
+    PYORI_STRING Prefix;
+
+    /**
+     If Parts is NULL, the number of the first part.
+     */
+    LONGLONG FirstPartNumber;
+
+    /**
+     If Parts is NULL, the number of bytes in each part other than the last.
+     */
+    LONGLONG BytesPerPart;
+
+    /**
+     If Parts is NULL, the number of bytes in the combined file.
+     */
+    LONGLONG CombinedLength;
+
+    /**
+     The index of the next part for a worker to process.  This is protected
+     by Mutex.
+     */
+    DWORD NextPart;
+
+    /**
+     Set to TRUE if any part failed to be copied.  This is protected by
+     Mutex.
+     */
+    BOOL Failed;
+
+    /**
+     A mutex synchronizing workers.
+     */
+    HANDLE Mutex;
+
+} SPLIT_COPY_JOB, *PSPLIT_COPY_JOB;
+
+/**
+ Display an error from a file operation.
+
+ @param Operation A string describing the operation that failed.
+
+ @param FileName The file that the operation failed on.
+
+ @param LastError The Win32 error code describing the failure.
+ */
+VOID
+SplitDisplayError(
+    __in LPCTSTR Operation,
+    __in PYORI_STRING FileName,
+    __in DWORD LastError
+    )
+{
+    LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: %s of %y failed: %s"), Operation, FileName, ErrText);
+    YoriLibFreeWinErrorText(ErrText);
+}
+
+/**
+ Generate the file name of a part from the prefix and the part number.
+
+ @param Prefix Pointer to the prefix of part files.
+
+ @param PartNumber The number of the part.
+
+ @param FileName On successful completion, populated with a newly allocated
+        NULL terminated file name.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+SplitBuildPartFileName(
+    __in PYORI_STRING Prefix,
+    __in LONGLONG PartNumber,
+    __out PYORI_STRING FileName
+    )
+{
+    YORI_STRING NumberString;
+
+    YoriLibInitEmptyString(&NumberString);
+    if (!YoriLibNumberToString(&NumberString, PartNumber, 10, 0, '\0')) {
+        return FALSE;
+    }
+
+    if (!YoriLibAllocateString(FileName, Prefix->LengthInChars + NumberString.LengthInChars + 1)) {
+        YoriLibFreeStringContents(&NumberString);
+        return FALSE;
+    }
+
+    FileName->LengthInChars = YoriLibSPrintf(FileName->StartOfString, _T("%y%y"), Prefix, &NumberString);
+    YoriLibFreeStringContents(&NumberString);
+    return TRUE;
+}
+
 /**
  Open a file in which to output the result of a fragment of the split
  operation.
@@ -105,138 +269,586 @@ SplitOpenTargetForCurrentPart(
     __in PSPLIT_CONTEXT SplitContext
     )
 {
-    LPTSTR NewFileName;
-    YORI_STRING NumberString;
+    YORI_STRING NewFileName;
     HANDLE hDestFile;
 
-    YoriLibInitEmptyString(&NumberString);
-    if (!YoriLibNumberToString(&NumberString, SplitContext->CurrentPartNumber, 10, 0, '\0')) {
+    if (!SplitBuildPartFileName(&SplitContext->Prefix, SplitContext->CurrentPartNumber, &NewFileName)) {
         return NULL;
     }
 
-    NewFileName = YoriLibMalloc((SplitContext->Prefix.LengthInChars + NumberString.LengthInChars + 1) * sizeof(TCHAR));
-    if (NewFileName == NULL) {
-        YoriLibFreeStringContents(&NumberString);
+    hDestFile = CreateFile(NewFileName.StartOfString, GENERIC_WRITE, FILE_SHARE_READ|FILE_SHARE_DELETE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hDestFile == INVALID_HANDLE_VALUE) {
+        SplitDisplayError(_T("open"), &NewFileName, GetLastError());
+        YoriLibFreeStringContents(&NewFileName);
         return NULL;
     }
+    YoriLibFreeStringContents(&NewFileName);
 
-    YoriLibSPrintf(NewFileName, _T("%y%y"), &SplitContext->Prefix, &NumberString);
-    YoriLibFreeStringContents(&NumberString);
+    return hDestFile;
+}
 
-    hDestFile = CreateFile(NewFileName, GENERIC_WRITE, FILE_SHARE_READ|FILE_SHARE_DELETE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
-    if (hDestFile == INVALID_HANDLE_VALUE) {
-        DWORD LastError = GetLastError();
-        LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: open of %s failed: %s"), NewFileName, ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        YoriLibFree(NewFileName);
-        return NULL;
+/**
+ Write a block of data to a file, looping until all of it is written.
+
+ @param hTarget Handle to the file to write to.
+
+ @param Buffer Pointer to the data to write.
+
+ @param BytesToWrite The number of bytes in Buffer.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+SplitWriteAll(
+    __in HANDLE hTarget,
+    __in PVOID Buffer,
+    __in DWORD BytesToWrite
+    )
+{
+    DWORD BytesSent;
+    DWORD BytesWritten;
+
+    BytesSent = 0;
+    while (BytesSent < BytesToWrite) {
+        if (!WriteFile(hTarget, YoriLibAddToPointer(Buffer, BytesSent), BytesToWrite - BytesSent, &BytesWritten, NULL)) {
+            return FALSE;
+        }
+        BytesSent += BytesWritten;
     }
-    YoriLibFree(NewFileName);
 
-    return hDestFile;
+    return TRUE;
 }
 
 /**
- Take a single incoming stream and break it into pieces.
+ A worker thread which copies parts to or from a combined file until no
+ parts remain.  Each worker opens its own handles so that it can position
+ and copy independently of other workers.
+
+ @param Context Pointer to the copy job.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+DWORD WINAPI
+SplitCopyWorker(
+    __in PVOID Context
+    )
+{
+    PSPLIT_COPY_JOB Job = (PSPLIT_COPY_JOB)Context;
+    PSPLIT_PART Part;
+    SPLIT_PART LocalPart;
+    DWORD PartIndex;
+    HANDLE hCombined;
+    HANDLE hPart;
+    DWORD Error;
+    BOOL Result;
+
+    if (Job->Join) {
+        hCombined = CreateFile(Job->CombinedFileName->StartOfString,
+                               GENERIC_READ | GENERIC_WRITE,
+                               FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                               NULL,
+                               OPEN_EXISTING,
+                               FILE_ATTRIBUTE_NORMAL,
+                               NULL);
+    } else {
+        hCombined = CreateFile(Job->CombinedFileName->StartOfString,
+                               GENERIC_READ,
+                               FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                               NULL,
+                               OPEN_EXISTING,
+                               FILE_FLAG_SEQUENTIAL_SCAN,
+                               NULL);
+    }
+
+    if (hCombined == INVALID_HANDLE_VALUE) {
+        Error = GetLastError();
+        SplitDisplayError(_T("open"), Job->CombinedFileName, Error);
+        WaitForSingleObject(Job->Mutex, INFINITE);
+        Job->Failed = TRUE;
+        ReleaseMutex(Job->Mutex);
+        return FALSE;
+    }
+
+    while (TRUE) {
+
+        WaitForSingleObject(Job->Mutex, INFINITE);
+        if (Job->Failed || Job->NextPart >= Job->PartCount) {
+            ReleaseMutex(Job->Mutex);
+            break;
+        }
+        PartIndex = Job->NextPart;
+        Job->NextPart++;
+        ReleaseMutex(Job->Mutex);
+
+        //
+        //  If the parts weren't supplied by the caller, generate this one
+        //  now, so the cost of preparing parts is spread across workers and
+        //  memory is only needed for the parts in progress.
+        //
+
+        if (Job->Parts != NULL) {
+            Part = &Job->Parts[PartIndex];
+        } else {
+            Part = &LocalPart;
+            if (!SplitBuildPartFileName(Job->Prefix, Job->FirstPartNumber + PartIndex, &Part->FileName)) {
+                WaitForSingleObject(Job->Mutex, INFINITE);
+                Job->Failed = TRUE;
+                ReleaseMutex(Job->Mutex);
+                break;
+            }
+            Part->Offset = PartIndex * Job->BytesPerPart;
+            Part->Length = Job->BytesPerPart;
+            if (Part->Offset + Part->Length > Job->CombinedLength) {
+                Part->Length = Job->CombinedLength - Part->Offset;
+            }
+        }
+
+        if (Job->Join) {
+            hPart = CreateFile(Part->FileName.StartOfString, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        } else {
+            hPart = CreateFile(Part->FileName.StartOfString, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        }
+
+        if (hPart == INVALID_HANDLE_VALUE) {
+            Error = GetLastError();
+            SplitDisplayError(_T("open"), &Part->FileName, Error);
+        } else {
+            if (Job->Join) {
+                Result = YoriLibCopyRange(hPart, 0, hCombined, Part->Offset, Part->Length);
+            } else {
+                Result = YoriLibCopyRange(hCombined, Part->Offset, hPart, 0, Part->Length);
+            }
+            Error = ERROR_SUCCESS;
+            if (!Result) {
+                Error = GetLastError();
+            }
+            CloseHandle(hPart);
+
+            if (Error != ERROR_SUCCESS) {
+                SplitDisplayError(_T("copy"), &Part->FileName, Error);
+            }
+        }
+
+        if (Job->Parts == NULL) {
+            YoriLibFreeStringContents(&LocalPart.FileName);
+        }
+
+        if (Error != ERROR_SUCCESS) {
+            WaitForSingleObject(Job->Mutex, INFINITE);
+            Job->Failed = TRUE;
+            ReleaseMutex(Job->Mutex);
+            break;
+        }
+    }
+
+    CloseHandle(hCombined);
+    return TRUE;
+}
+
+/**
+ Copy a set of parts to or from a combined file, using multiple threads
+ where more than one part exists and the system has more than one
+ processor.  The calling thread also processes parts.
+
+ @param Job Pointer to the copy job.  The caller is expected to have
+        populated the Join, CombinedFileName, Parts and PartCount members,
+        and if Parts is NULL, the members describing how to generate parts.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+SplitRunCopyJob(
+    __inout PSPLIT_COPY_JOB Job
+    )
+{
+    HANDLE Threads[SPLIT_MAX_THREADS];
+    DWORD ThreadCount;
+    DWORD MaxThreads;
+    DWORD ThreadId;
+    DWORD Index;
+    SYSTEM_INFO SystemInfo;
+
+    Job->NextPart = 0;
+    Job->Failed = FALSE;
+    Job->Mutex = CreateMutex(NULL, FALSE, NULL);
+    if (Job->Mutex == NULL) {
+        return FALSE;
+    }
+
+    GetSystemInfo(&SystemInfo);
+    MaxThreads = SystemInfo.dwNumberOfProcessors;
+    if (MaxThreads > SPLIT_MAX_THREADS) {
+        MaxThreads = SPLIT_MAX_THREADS;
+    }
+    if (MaxThreads > Job->PartCount) {
+        MaxThreads = Job->PartCount;
+    }
+
+    //
+    //  The current thread is one of the workers, so only create threads
+    //  beyond the first.
+    //
+
+    ThreadCount = 0;
+    while (ThreadCount + 1 < MaxThreads) {
+        Threads[ThreadCount] = CreateThread(NULL, 0, SplitCopyWorker, Job, 0, &ThreadId);
+        if (Threads[ThreadCount] == NULL) {
+            break;
+        }
+        ThreadCount++;
+    }
+
+    SplitCopyWorker(Job);
+
+    if (ThreadCount > 0) {
+        WaitForMultipleObjects(ThreadCount, Threads, TRUE, INFINITE);
+        for (Index = 0; Index < ThreadCount; Index++) {
+            CloseHandle(Threads[Index]);
+        }
+    }
+
+    CloseHandle(Job->Mutex);
+    Job->Mutex = NULL;
+
+    if (Job->Failed) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Free an array of parts.
+
+ @param Parts Pointer to the array of parts.
+
+ @param PartCount The number of elements in the array which have been
+        initialized.
+ */
+VOID
+SplitFreeParts(
+    __in PSPLIT_PART Parts,
+    __in DWORD PartCount
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < PartCount; Index++) {
+        YoriLibFreeStringContents(&Parts[Index].FileName);
+    }
+    YoriLibFree(Parts);
+}
+
+/**
+ Split a file into parts of a fixed number of bytes.  Since the size of the
+ source and location of every part is known in advance, parts are generated
+ concurrently with each worker reading its own range of the source.  Each
+ worker builds the name of its part when it starts processing it.
+
+ @param hSource A handle to the source file.
+
+ @param SplitContext Pointer to a context describing the actions to perform.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+SplitProcessFileByBytes(
+    __in HANDLE hSource,
+    __in PSPLIT_CONTEXT SplitContext
+    )
+{
+    LARGE_INTEGER FileSize;
+    LONGLONG PartCount;
+    SPLIT_COPY_JOB Job;
+    BOOL Result;
+
+    FileSize.LowPart = GetFileSize(hSource, (LPDWORD)&FileSize.HighPart);
+    if (FileSize.LowPart == (DWORD)-1 && GetLastError() != NO_ERROR) {
+        SplitDisplayError(_T("query size"), SplitContext->SourceFileName, GetLastError());
+        return FALSE;
+    }
+
+    PartCount = (FileSize.QuadPart + SplitContext->BytesPerPart - 1) / SplitContext->BytesPerPart;
+    if (PartCount == 0) {
+        return TRUE;
+    }
+
+    if (PartCount >= (DWORD)-1) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: too many parts\n"));
+        return FALSE;
+    }
+
+    ZeroMemory(&Job, sizeof(Job));
+    Job.Join = FALSE;
+    Job.CombinedFileName = SplitContext->SourceFileName;
+    Job.Parts = NULL;
+    Job.PartCount = (DWORD)PartCount;
+    Job.Prefix = &SplitContext->Prefix;
+    Job.FirstPartNumber = SplitContext->CurrentPartNumber;
+    Job.BytesPerPart = SplitContext->BytesPerPart;
+    Job.CombinedLength = FileSize.QuadPart;
+
+    Result = SplitRunCopyJob(&Job);
+    SplitContext->CurrentPartNumber += PartCount;
+
+    return Result;
+}
+
+/**
+ Split a stream into parts containing a fixed number of lines.  This scans
+ the raw bytes of the input for line terminators and copies ranges of the
+ input to each part without converting encodings, so each part contains
+ exactly the bytes of the source.
 
  @param hSource A handle to the incoming stream, which may be a file or a
         pipe.
- 
+
  @param SplitContext Pointer to a context describing the actions to perform.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
-SplitProcessStream(
+SplitProcessStreamByLines(
     __in HANDLE hSource,
     __in PSPLIT_CONTEXT SplitContext
     )
 {
     HANDLE hDestFile = NULL;
+    PUCHAR Buffer;
+    PUCHAR Found;
+    DWORD UnitSize;
+    DWORD BytesHeld;
+    DWORD BytesRead;
+    DWORD BytesToScan;
+    DWORD Start;
+    DWORD Index;
+    LONGLONG LinesInPart;
+    BOOL Result = FALSE;
+
+    //
+    //  UTF16 input has two byte line terminators, and a byte with the
+    //  value of a newline might be half of a different character.
+    //
+
+    UnitSize = 1;
+    if (YoriLibGetMultibyteInputEncoding() == CP_UTF16) {
+        UnitSize = 2;
+    }
 
-    if (SplitContext->LinesMode) {
-        PVOID LineContext = NULL;
-        YORI_STRING LineString;
-        LONGLONG LineNumber;
-
-        LineNumber = 0;
-        YoriLibInitEmptyString(&LineString);
-        while (TRUE) {
-            if (!YoriLibReadLineToString(&LineString, &LineContext, hSource)) {
-                break;
+    Buffer = YoriLibMalloc(SPLIT_COPY_BUFFER_SIZE);
+    if (Buffer == NULL) {
+        return FALSE;
+    }
+
+    LinesInPart = 0;
+    BytesHeld = 0;
+
+    while (TRUE) {
+        if (!ReadFile(hSource, Buffer + BytesHeld, SPLIT_COPY_BUFFER_SIZE - BytesHeld, &BytesRead, NULL) ||
+            BytesRead == 0) {
+
+            break;
+        }
+
+        BytesHeld += BytesRead;
+        BytesToScan = BytesHeld - (BytesHeld % UnitSize);
+        Start = 0;
+        Index = 0;
+
+        while (Index < BytesToScan) {
+            if (UnitSize == 1) {
+                Found = memchr(Buffer + Index, '\n', BytesToScan - Index);
+                if (Found == NULL) {
+                    break;
+                }
+                Index = (DWORD)(Found - Buffer) + 1;
+            } else {
+                if (Buffer[Index] != '\n' || Buffer[Index + 1] != '\0') {
+                    Index += 2;
+                    continue;
+                }
+                Index += 2;
             }
 
-            if ((LineNumber % SplitContext->LinesPerPart) == 0) {
-                if (hDestFile != NULL) {
-                    CloseHandle(hDestFile);
-                    hDestFile = NULL;
+            LinesInPart++;
+            if (LinesInPart < SplitContext->LinesPerPart) {
+                continue;
+            }
+
+            if (hDestFile == NULL) {
+                hDestFile = SplitOpenTargetForCurrentPart(SplitContext);
+                if (hDestFile == NULL) {
+                    goto Exit;
                 }
+                SplitContext->CurrentPartNumber++;
             }
 
+            if (!SplitWriteAll(hDestFile, Buffer + Start, Index - Start)) {
+                goto WriteFailed;
+            }
+
+            CloseHandle(hDestFile);
+            hDestFile = NULL;
+            LinesInPart = 0;
+            Start = Index;
+        }
+
+        if (Start < BytesToScan) {
             if (hDestFile == NULL) {
                 hDestFile = SplitOpenTargetForCurrentPart(SplitContext);
                 if (hDestFile == NULL) {
-                    YoriLibLineReadClose(LineContext);
-                    YoriLibFreeStringContents(&LineString);
-                    return FALSE;
+                    goto Exit;
                 }
                 SplitContext->CurrentPartNumber++;
             }
 
-            YoriLibOutputToDevice(hDestFile, 0, _T("%y\n"), &LineString);
-            LineNumber++;
+            if (!SplitWriteAll(hDestFile, Buffer + Start, BytesToScan - Start)) {
+                goto WriteFailed;
+            }
         }
 
-        YoriLibLineReadClose(LineContext);
-        YoriLibFreeStringContents(&LineString);
-    } else {
-        PVOID Buffer;
-        ULONG BytesRead;
+        //
+        //  Carry any incomplete character into the next read.
+        //
 
-        Buffer = YoriLibMalloc((DWORD)SplitContext->BytesPerPart);
-        if (Buffer == NULL) {
-            return FALSE;
+        BytesHeld = BytesHeld - BytesToScan;
+        if (BytesHeld > 0) {
+            Buffer[0] = Buffer[BytesToScan];
         }
+    }
 
-        while (TRUE) {
-            if (!ReadFile(hSource, Buffer, (DWORD)SplitContext->BytesPerPart, &BytesRead, NULL)) {
-                break;
+    if (BytesHeld > 0) {
+        if (hDestFile == NULL) {
+            hDestFile = SplitOpenTargetForCurrentPart(SplitContext);
+            if (hDestFile == NULL) {
+                goto Exit;
             }
+            SplitContext->CurrentPartNumber++;
+        }
 
-            if (BytesRead == 0) {
-                break;
-            }
+        if (!SplitWriteAll(hDestFile, Buffer, BytesHeld)) {
+            goto WriteFailed;
+        }
+    }
+
+    Result = TRUE;
+    goto Exit;
+
+WriteFailed:
+    {
+        DWORD LastError = GetLastError();
+        LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: write failed: %s"), ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+    }
+
+Exit:
+    if (hDestFile != NULL) {
+        CloseHandle(hDestFile);
+    }
+    YoriLibFree(Buffer);
+    return Result;
+}
+
+/**
+ Take a single incoming stream and break it into pieces.
+
+ @param hSource A handle to the incoming stream, which may be a file or a
+        pipe.
+ 
+ @param SplitContext Pointer to a context describing the actions to perform.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+SplitProcessStream(
+    __in HANDLE hSource,
+    __in PSPLIT_CONTEXT SplitContext
+    )
+{
+    HANDLE hDestFile = NULL;
+    PVOID Buffer;
+    DWORD BytesRead;
+    DWORD BytesToRead;
+    LONGLONG BytesInPart;
+
+    if (SplitContext->LinesMode) {
+        return SplitProcessStreamByLines(hSource, SplitContext);
+    }
+
+    if (SplitContext->SourceFileName != NULL &&
+        GetFileType(hSource) == FILE_TYPE_DISK) {
+
+        return SplitProcessFileByBytes(hSource, SplitContext);
+    }
+
+    //
+    //  The source is a pipe, so data can only be read sequentially.
+    //  Fill each part before moving to the next, since a pipe can return
+    //  less data than requested.
+    //
+
+    Buffer = YoriLibMalloc(SPLIT_COPY_BUFFER_SIZE);
+    if (Buffer == NULL) {
+        return FALSE;
+    }
+
+    BytesInPart = 0;
+
+    while (TRUE) {
+        BytesToRead = SPLIT_COPY_BUFFER_SIZE;
+        if ((LONGLONG)BytesToRead > SplitContext->BytesPerPart - BytesInPart) {
+            BytesToRead = (DWORD)(SplitContext->BytesPerPart - BytesInPart);
+        }
+
+        if (!ReadFile(hSource, Buffer, BytesToRead, &BytesRead, NULL)) {
+            break;
+        }
 
+        if (BytesRead == 0) {
+            break;
+        }
+
+        if (hDestFile == NULL) {
             hDestFile = SplitOpenTargetForCurrentPart(SplitContext);
             if (hDestFile == NULL) {
                 YoriLibFree(Buffer);
                 return FALSE;
             }
             SplitContext->CurrentPartNumber++;
+        }
 
-            if (!WriteFile(hDestFile, Buffer, BytesRead, &BytesRead, NULL)) {
-                DWORD LastError = GetLastError();
-                LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
-                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: write failed: %s"), ErrText);
-                YoriLibFreeWinErrorText(ErrText);
-                CloseHandle(hDestFile);
-                YoriLibFree(Buffer);
-                return FALSE;
-            }
+        if (!SplitWriteAll(hDestFile, Buffer, BytesRead)) {
+            DWORD LastError = GetLastError();
+            LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: write failed: %s"), ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            CloseHandle(hDestFile);
+            YoriLibFree(Buffer);
+            return FALSE;
+        }
 
+        BytesInPart += BytesRead;
+        if (BytesInPart >= SplitContext->BytesPerPart) {
             CloseHandle(hDestFile);
+            hDestFile = NULL;
+            BytesInPart = 0;
         }
+    }
 
-        YoriLibFree(Buffer);
+    if (hDestFile != NULL) {
+        CloseHandle(hDestFile);
     }
 
+    YoriLibFree(Buffer);
     return TRUE;
 }
 
 /**
  Join a series of files with a given prefix back into a single file.  This is
- the inverse of split.
+ the inverse of split.  The size of every part is determined first, so the
+ target can be allocated at its final size and each part copied to its
+ offset concurrently.
 
  @param Prefix Pointer to the string containing the prefix name of the set of
         files.
@@ -254,121 +866,145 @@ SplitJoin(
 {
     HANDLE SourceHandle;
     HANDLE TargetHandle;
-    PUCHAR Buffer;
-    DWORD BytesRead;
-    DWORD BytesAllocated;
-    LONGLONG CurrentFragment;
-    LPTSTR FragmentFileName;
-    YORI_STRING NumberString;
+    PSPLIT_PART Parts;
+    PSPLIT_PART NewParts;
+    DWORD PartCount;
+    DWORD PartsAllocated;
+    LARGE_INTEGER FileSize;
+    BY_HANDLE_FILE_INFORMATION FileInfo;
+    BOOL AnyPartSparse;
+    LONGLONG TotalSize;
+    YORI_STRING FragmentFileName;
+    SPLIT_COPY_JOB Job;
     DWORD LastError;
-    LPTSTR ErrText;
+    BOOL Result;
 
     ASSERT(YoriLibIsStringNullTerminated(OutputFile));
 
-    BytesAllocated = 256 * 1024;
-
-    Buffer = YoriLibMalloc(BytesAllocated);
-    if (Buffer == NULL) {
-        return FALSE;
-    }
-
-    TargetHandle = CreateFile(OutputFile->StartOfString,
-                              GENERIC_WRITE,
-                              FILE_SHARE_READ | FILE_SHARE_DELETE,
-                              NULL,
-                              CREATE_ALWAYS,
-                              FILE_ATTRIBUTE_NORMAL,
-                              NULL);
+    //
+    //  Find all of the parts and their sizes.
+    //
 
-    if (TargetHandle == NULL || TargetHandle == INVALID_HANDLE_VALUE) {
-        LastError = GetLastError();
-        ErrText = YoriLibGetWinErrorText(LastError);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: open of %y failed: %s"), OutputFile, ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        YoriLibFree(Buffer);
-        return FALSE;
-    }
-
-    CurrentFragment = 0;
+    PartCount = 0;
+    PartsAllocated = 0;
+    Parts = NULL;
+    TotalSize = 0;
+    AnyPartSparse = FALSE;
 
     while(TRUE) {
 
-        YoriLibInitEmptyString(&NumberString);
-        if (!YoriLibNumberToString(&NumberString, CurrentFragment, 10, 0, '\0')) {
-            CloseHandle(TargetHandle);
-            YoriLibFree(Buffer);
+        if (!SplitBuildPartFileName(Prefix, PartCount, &FragmentFileName)) {
+            if (Parts != NULL) {
+                SplitFreeParts(Parts, PartCount);
+            }
             return FALSE;
         }
 
-        FragmentFileName = YoriLibMalloc((Prefix->LengthInChars + NumberString.LengthInChars + 1) * sizeof(TCHAR));
-        if (FragmentFileName == NULL) {
-            YoriLibFreeStringContents(&NumberString);
-            CloseHandle(TargetHandle);
-            YoriLibFree(Buffer);
+        SourceHandle = CreateFile(FragmentFileName.StartOfString, GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (SourceHandle == INVALID_HANDLE_VALUE) {
+            LastError = GetLastError();
+            if (LastError == ERROR_FILE_NOT_FOUND && PartCount > 0) {
+                YoriLibFreeStringContents(&FragmentFileName);
+                break;
+            }
+            SplitDisplayError(_T("open"), &FragmentFileName, LastError);
+            YoriLibFreeStringContents(&FragmentFileName);
+            if (Parts != NULL) {
+                SplitFreeParts(Parts, PartCount);
+            }
             return FALSE;
         }
 
-        YoriLibSPrintf(FragmentFileName, _T("%y%y"), Prefix, &NumberString);
-        YoriLibFreeStringContents(&NumberString);
-
-        SourceHandle = CreateFile(FragmentFileName, GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-        if (SourceHandle == INVALID_HANDLE_VALUE) {
+        if (!GetFileInformationByHandle(SourceHandle, &FileInfo)) {
             LastError = GetLastError();
-            if (LastError == ERROR_FILE_NOT_FOUND && CurrentFragment > 0) {
-                YoriLibFree(FragmentFileName);
-                break;
+            CloseHandle(SourceHandle);
+            SplitDisplayError(_T("query size"), &FragmentFileName, LastError);
+            YoriLibFreeStringContents(&FragmentFileName);
+            if (Parts != NULL) {
+                SplitFreeParts(Parts, PartCount);
             }
-            ErrText = YoriLibGetWinErrorText(LastError);
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: open of %s failed: %s"), FragmentFileName, ErrText);
-            YoriLibFreeWinErrorText(ErrText);
-            YoriLibFree(FragmentFileName);
-            CloseHandle(TargetHandle);
-            YoriLibFree(Buffer);
             return FALSE;
         }
 
-        while(TRUE) {
+        CloseHandle(SourceHandle);
+        FileSize.LowPart = FileInfo.nFileSizeLow;
+        FileSize.HighPart = FileInfo.nFileSizeHigh;
+        if (FileInfo.dwFileAttributes & FILE_ATTRIBUTE_SPARSE_FILE) {
+            AnyPartSparse = TRUE;
+        }
 
-            if (!ReadFile(SourceHandle, Buffer, BytesAllocated, &BytesRead, NULL)) {
-                LastError = GetLastError();
-                if (LastError == ERROR_HANDLE_EOF) {
-                    break;
+        if (PartCount >= PartsAllocated) {
+            PartsAllocated = PartsAllocated * 2 + 16;
+            NewParts = YoriLibMalloc(PartsAllocated * sizeof(SPLIT_PART));
+            if (NewParts == NULL) {
+                YoriLibFreeStringContents(&FragmentFileName);
+                if (Parts != NULL) {
+                    SplitFreeParts(Parts, PartCount);
                 }
-                ErrText = YoriLibGetWinErrorText(LastError);
-                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: read of %s failed: %s"), FragmentFileName, ErrText);
-                YoriLibFreeWinErrorText(ErrText);
-                YoriLibFree(FragmentFileName);
-                CloseHandle(TargetHandle);
-                CloseHandle(SourceHandle);
-                YoriLibFree(Buffer);
                 return FALSE;
             }
-
-            if (BytesRead == 0) {
-                break;
-            }
-
-            if (!WriteFile(TargetHandle, Buffer, BytesRead, &BytesRead, NULL)) {
-                LastError = GetLastError();
-                ErrText = YoriLibGetWinErrorText(LastError);
-                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: write to %y failed: %s"), OutputFile, ErrText);
-                YoriLibFreeWinErrorText(ErrText);
-                YoriLibFree(FragmentFileName);
-                CloseHandle(TargetHandle);
-                CloseHandle(SourceHandle);
-                YoriLibFree(Buffer);
-                return FALSE;
+            if (Parts != NULL) {
+                memcpy(NewParts, Parts, PartCount * sizeof(SPLIT_PART));
+                YoriLibFree(Parts);
             }
+            Parts = NewParts;
         }
 
-        CloseHandle(SourceHandle);
-        YoriLibFree(FragmentFileName);
-        CurrentFragment++;
+        memcpy(&Parts[PartCount].FileName, &FragmentFileName, sizeof(YORI_STRING));
+        Parts[PartCount].Offset = TotalSize;
+        Parts[PartCount].Length = FileSize.QuadPart;
+        TotalSize += FileSize.QuadPart;
+        PartCount++;
+    }
+
+    //
+    //  Create the target at its final size.  Each worker opens its own
+    //  handle to write to its range.  If any part is sparse, the target
+    //  is marked sparse before extending it so that holes in the parts
+    //  can remain unallocated.
+    //
+
+    TargetHandle = CreateFile(OutputFile->StartOfString,
+                              GENERIC_WRITE,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              NULL,
+                              CREATE_ALWAYS,
+                              FILE_ATTRIBUTE_NORMAL,
+                              NULL);
+
+    if (TargetHandle == NULL || TargetHandle == INVALID_HANDLE_VALUE) {
+        SplitDisplayError(_T("open"), OutputFile, GetLastError());
+        SplitFreeParts(Parts, PartCount);
+        return FALSE;
+    }
+
+    if (AnyPartSparse) {
+        DeviceIoControl(TargetHandle, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &LastError, NULL);
+    }
+
+    FileSize.QuadPart = TotalSize;
+    if ((SetFilePointer(TargetHandle, FileSize.LowPart, &FileSize.HighPart, FILE_BEGIN) == (DWORD)-1 &&
+         GetLastError() != NO_ERROR) ||
+        !SetEndOfFile(TargetHandle)) {
+
+        SplitDisplayError(_T("extend"), OutputFile, GetLastError());
+        CloseHandle(TargetHandle);
+        SplitFreeParts(Parts, PartCount);
+        return FALSE;
     }
 
-    YoriLibFree(Buffer);
     CloseHandle(TargetHandle);
-    return TRUE;
+
+    ZeroMemory(&Job, sizeof(Job));
+    Job.Join = TRUE;
+    Job.CombinedFileName = OutputFile;
+    Job.Parts = Parts;
+    Job.PartCount = PartCount;
+
+    Result = SplitRunCopyJob(&Job);
+
+    SplitFreeParts(Parts, PartCount);
+    return Result;
 }
 
 #ifdef YORI_BUILTIN
@@ -502,7 +1138,7 @@ ENTRYPOINT(
                 return EXIT_FAILURE;
             }
         } else {
-            if (SplitContext.BytesPerPart == 0 || SplitContext.BytesPerPart >= (DWORD)-1) {
+            if (SplitContext.BytesPerPart <= 0) {
                 YoriLibFreeStringContents(&SplitContext.Prefix);
                 YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: invalid bytes per part\n"));
                 return EXIT_FAILURE;
@@ -548,14 +1184,16 @@ ENTRYPOINT(
                 return TRUE;
             }
 
-            YoriLibFreeStringContents(&FilePath);
+            SplitContext.SourceFileName = &FilePath;
 
             if (!SplitProcessStream(FileHandle, &SplitContext)) {
                 CloseHandle(FileHandle);
+                YoriLibFreeStringContents(&FilePath);
                 YoriLibFreeStringContents(&SplitContext.Prefix);
                 return EXIT_FAILURE;
             }
             CloseHandle(FileHandle);
+            YoriLibFreeStringContents(&FilePath);
         }
         YoriLibFreeStringContents(&SplitContext.Prefix);
     }
@@ -36,7 +36,9 @@ CHAR strSpongeHelpText[] =
         "Read input into memory and output once all input is read,\n"
         "  allowing the output to modify the source stream.\n"
         "\n"
-        "SPONGE [-license] [file]\n"
+        "SPONGE [-license] [-m size] [file]\n"
+        "\n"
+        "   -m             Memory to use before spilling input to a temporary file\n"
         ;
 
 /**
@@ -53,6 +55,12 @@ SpongeHelp()
     return TRUE;
 }
 
+/**
+ The default amount of input to hold in memory before writing it to a
+ temporary file.
+ */
+#define SPONGE_DEFAULT_MEMORY_LIMIT (16 * 1024 * 1024)
+
 /**
  A buffer for a single data stream.
  */
@@ -68,11 +76,37 @@ typedef struct _SPONGE_BUFFER {
      */
     DWORD BytesPopulated;
 
+    /**
+     The maximum number of bytes to allocate for the in memory buffer.
+     Once the buffer is full at this size, its contents are written to a
+     temporary file.
+     */
+    DWORD MemoryLimit;
+
     /**
      A handle to a pipe which is the source of data for this buffer.
      */
     HANDLE hSource;
 
+    /**
+     A handle to a temporary file containing data that did not fit in
+     memory, or NULL if no temporary file has been created.
+     */
+    HANDLE hSpill;
+
+    /**
+     The full path to the temporary file.  When the output is a file, this
+     is in the same directory as the target so that it can be renamed over
+     it once input is complete.
+     */
+    YORI_STRING SpillFileName;
+
+    /**
+     If the output is to a file, the full path to that file.  If output is
+     to standard output, this is empty.
+     */
+    PYORI_STRING TargetFileName;
+
     /**
      The data buffer.
      */
@@ -81,7 +115,209 @@ typedef struct _SPONGE_BUFFER {
 } SPONGE_BUFFER, *PSPONGE_BUFFER;
 
 /**
- Populate data from stdin into an in memory buffer.
+ Display an error encountered while operating on a temporary file.
+
+ @param Operation A string describing the operation that failed.
+
+ @param FileName The file that the operation failed on.
+
+ @param LastError The Win32 error code describing the failure.
+ */
+VOID
+SpongeDisplayError(
+    __in LPCTSTR Operation,
+    __in PYORI_STRING FileName,
+    __in DWORD LastError
+    )
+{
+    LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sponge: %s %y failed: %s"), Operation, FileName, ErrText);
+    YoriLibFreeWinErrorText(ErrText);
+}
+
+/**
+ Create a temporary file to hold data that does not fit in memory.  If the
+ output is to a file, the temporary file is created alongside it, so it can
+ later replace the target with a rename.  If the output is to standard
+ output, the temporary file is in the temporary directory and is deleted
+ when it is closed.
+
+ @param ThisBuffer Pointer to the buffer to create a temporary file for.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+SpongeCreateSpillFile(
+    __inout PSPONGE_BUFFER ThisBuffer
+    )
+{
+    DWORD ProbeIndex;
+    DWORD LastError;
+    YORI_STRING TempPath;
+
+    ASSERT(ThisBuffer->hSpill == NULL);
+
+    if (ThisBuffer->TargetFileName != NULL) {
+
+        //
+        //  Generate a name from the target name.  This keeps the file on
+        //  the same volume and works with long paths, which GetTempFileName
+        //  does not.
+        //
+
+        if (!YoriLibAllocateString(&ThisBuffer->SpillFileName, ThisBuffer->TargetFileName->LengthInChars + sizeof(".sponge.") + 10)) {
+            return FALSE;
+        }
+
+        for (ProbeIndex = 0; ProbeIndex < 100; ProbeIndex++) {
+            ThisBuffer->SpillFileName.LengthInChars = YoriLibSPrintf(ThisBuffer->SpillFileName.StartOfString, _T("%y.sponge.%i"), ThisBuffer->TargetFileName, ProbeIndex);
+            ThisBuffer->hSpill = CreateFile(ThisBuffer->SpillFileName.StartOfString,
+                                            GENERIC_READ | GENERIC_WRITE,
+                                            FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                            NULL,
+                                            CREATE_NEW,
+                                            FILE_ATTRIBUTE_NORMAL,
+                                            NULL);
+            if (ThisBuffer->hSpill != INVALID_HANDLE_VALUE) {
+                return TRUE;
+            }
+
+            LastError = GetLastError();
+            if (LastError != ERROR_FILE_EXISTS && LastError != ERROR_ALREADY_EXISTS) {
+                break;
+            }
+        }
+
+        ThisBuffer->hSpill = NULL;
+        SpongeDisplayError(_T("create temporary file for"), ThisBuffer->TargetFileName, LastError);
+        YoriLibFreeStringContents(&ThisBuffer->SpillFileName);
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&TempPath);
+    TempPath.LengthAllocated = GetTempPath(0, NULL);
+    if (!YoriLibAllocateString(&TempPath, TempPath.LengthAllocated)) {
+        return FALSE;
+    }
+    TempPath.LengthInChars = GetTempPath(TempPath.LengthAllocated, TempPath.StartOfString);
+    if (TempPath.LengthInChars == 0 ||
+        TempPath.LengthInChars >= TempPath.LengthAllocated) {
+
+        YoriLibFreeStringContents(&TempPath);
+        return FALSE;
+    }
+
+    if (!YoriLibAllocateString(&ThisBuffer->SpillFileName, MAX_PATH)) {
+        YoriLibFreeStringContents(&TempPath);
+        return FALSE;
+    }
+
+    if (GetTempFileName(TempPath.StartOfString, _T("spg"), 0, ThisBuffer->SpillFileName.StartOfString) == 0) {
+        SpongeDisplayError(_T("create temporary file in"), &TempPath, GetLastError());
+        YoriLibFreeStringContents(&TempPath);
+        YoriLibFreeStringContents(&ThisBuffer->SpillFileName);
+        return FALSE;
+    }
+    YoriLibFreeStringContents(&TempPath);
+    ThisBuffer->SpillFileName.LengthInChars = _tcslen(ThisBuffer->SpillFileName.StartOfString);
+
+    ThisBuffer->hSpill = CreateFile(ThisBuffer->SpillFileName.StartOfString,
+                                    GENERIC_READ | GENERIC_WRITE,
+                                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                    NULL,
+                                    CREATE_ALWAYS,
+                                    FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE,
+                                    NULL);
+
+    if (ThisBuffer->hSpill == INVALID_HANDLE_VALUE) {
+        ThisBuffer->hSpill = NULL;
+        SpongeDisplayError(_T("open temporary file"), &ThisBuffer->SpillFileName, GetLastError());
+        DeleteFile(ThisBuffer->SpillFileName.StartOfString);
+        YoriLibFreeStringContents(&ThisBuffer->SpillFileName);
+        return FALSE;
+    }
+
+    //
+    //  The file is deleted on close, so there's nothing for cleanup to
+    //  remove.
+    //
+
+    YoriLibFreeStringContents(&ThisBuffer->SpillFileName);
+    return TRUE;
+}
+
+/**
+ Write a block of data to a stream, looping until all of it is written.
+
+ @param hTarget Handle to the stream to write to.
+
+ @param Buffer Pointer to the data to write.
+
+ @param BytesToSend The number of bytes in Buffer.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+SpongeWriteAll(
+    __in HANDLE hTarget,
+    __in PVOID Buffer,
+    __in DWORD BytesToSend
+    )
+{
+    DWORD BytesSent;
+    DWORD BytesWritten;
+
+    BytesSent = 0;
+
+    while (BytesSent < BytesToSend) {
+        if (!WriteFile(hTarget,
+                       YoriLibAddToPointer(Buffer, BytesSent),
+                       BytesToSend - BytesSent,
+                       &BytesWritten,
+                       NULL)) {
+
+            return FALSE;
+        }
+
+        BytesSent += BytesWritten;
+        ASSERT(BytesSent <= BytesToSend);
+    }
+
+    return TRUE;
+}
+
+/**
+ Write the contents of the in memory buffer to the temporary file, creating
+ the temporary file if it does not yet exist, and mark the in memory buffer
+ as empty so it can be reused for further input.
+
+ @param ThisBuffer Pointer to the buffer to write to the temporary file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+SpongeSpillBuffer(
+    __inout PSPONGE_BUFFER ThisBuffer
+    )
+{
+    if (ThisBuffer->hSpill == NULL) {
+        if (!SpongeCreateSpillFile(ThisBuffer)) {
+            return FALSE;
+        }
+    }
+
+    if (!SpongeWriteAll(ThisBuffer->hSpill, ThisBuffer->Buffer, ThisBuffer->BytesPopulated)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sponge: write to temporary file failed\n"));
+        return FALSE;
+    }
+
+    ThisBuffer->BytesPopulated = 0;
+    return TRUE;
+}
+
+/**
+ Populate data from stdin into an in memory buffer.  If the data exceeds the
+ memory limit, it is moved to a temporary file.
 
  @param ThisBuffer A pointer to the process buffer set.
 
@@ -114,21 +350,33 @@ SpongeBufferPump(
                 DWORD NewBytesAllocated;
                 PCHAR NewBuffer;
 
-                if (ThisBuffer->BytesAllocated >= ((DWORD)-1) / 4) {
-                    break;
+                //
+                //  If the buffer can't grow any more, write its contents
+                //  to the temporary file and start filling it again.
+                //
+
+                NewBuffer = NULL;
+                NewBytesAllocated = 0;
+                if (ThisBuffer->BytesAllocated < ThisBuffer->MemoryLimit &&
+                    ThisBuffer->BytesAllocated < ((DWORD)-1) / 4) {
+
+                    NewBytesAllocated = ThisBuffer->BytesAllocated * 4;
+                    if (NewBytesAllocated > ThisBuffer->MemoryLimit) {
+                        NewBytesAllocated = ThisBuffer->MemoryLimit;
+                    }
+                    NewBuffer = YoriLibMalloc(NewBytesAllocated);
                 }
 
-                NewBytesAllocated = ThisBuffer->BytesAllocated * 4;
-
-                NewBuffer = YoriLibMalloc(NewBytesAllocated);
                 if (NewBuffer == NULL) {
-                    break;
+                    if (!SpongeSpillBuffer(ThisBuffer)) {
+                        break;
+                    }
+                } else {
+                    memcpy(NewBuffer, ThisBuffer->Buffer, ThisBuffer->BytesAllocated);
+                    YoriLibFree(ThisBuffer->Buffer);
+                    ThisBuffer->Buffer = NewBuffer;
+                    ThisBuffer->BytesAllocated = NewBytesAllocated;
                 }
-
-                memcpy(NewBuffer, ThisBuffer->Buffer, ThisBuffer->BytesAllocated);
-                YoriLibFree(ThisBuffer->Buffer);
-                ThisBuffer->Buffer = NewBuffer;
-                ThisBuffer->BytesAllocated = NewBytesAllocated;
             }
         } else {
             Result = TRUE;
@@ -140,7 +388,9 @@ SpongeBufferPump(
 }
 
 /**
- Output the collected buffer to a stream.
+ Output the collected buffer to a stream.  If part of the data was written
+ to a temporary file, that is output first, followed by the data that
+ remains in memory.
 
  @param ThisBuffer Pointer to the buffer to output.
 
@@ -154,35 +404,100 @@ SpongeBufferForward(
     __in HANDLE hTarget
     )
 {
-    DWORD BytesSent;
-    BOOL Result;
+    LARGE_INTEGER SpillSize;
 
-    BytesSent = 0;
-    Result = TRUE;
-
-    while (BytesSent < ThisBuffer->BytesPopulated) {
-        DWORD BytesToWrite;
-        DWORD BytesWritten;
-        BytesToWrite = 4096;
-        if (BytesSent + BytesToWrite > ThisBuffer->BytesPopulated) {
-            BytesToWrite = ThisBuffer->BytesPopulated - BytesSent;
+    if (ThisBuffer->hSpill != NULL) {
+
+        //
+        //  Append the data remaining in memory to the temporary file, so
+        //  the whole stream can be copied from the file.
+        //
+
+        if (!SpongeSpillBuffer(ThisBuffer)) {
+            return FALSE;
         }
 
-        if (WriteFile(hTarget,
-                      YoriLibAddToPointer(ThisBuffer->Buffer, BytesSent),
-                      BytesToWrite,
-                      &BytesWritten,
-                      NULL)) {
+        SpillSize.LowPart = GetFileSize(ThisBuffer->hSpill, (LPDWORD)&SpillSize.HighPart);
+        if (SpillSize.LowPart == (DWORD)-1 && GetLastError() != NO_ERROR) {
+            return FALSE;
+        }
 
-            BytesSent += BytesWritten;
-        } else {
-            Result = FALSE;
+        return YoriLibCopyRange(ThisBuffer->hSpill,
+                                0,
+                                hTarget,
+                                YORI_LIB_COPY_RANGE_CURRENT_OFFSET,
+                                SpillSize.QuadPart);
+    }
+
+    return SpongeWriteAll(hTarget, ThisBuffer->Buffer, ThisBuffer->BytesPopulated);
+}
+
+/**
+ Write the collected data to the target file.  All of the data is written
+ to a temporary file next to the target, which then replaces the target.
+ This means the target is updated atomically and does not need to be
+ written a second time when the input was too large to hold in memory.
+
+ @param ThisBuffer Pointer to the buffer to output.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+SpongeBufferCommitToFile(
+    __in PSPONGE_BUFFER ThisBuffer
+    )
+{
+    DWORD LastError;
+    BOOL Replaced;
+
+    ASSERT(ThisBuffer->TargetFileName != NULL);
+
+    if (!SpongeSpillBuffer(ThisBuffer)) {
+        return FALSE;
+    }
+
+    CloseHandle(ThisBuffer->hSpill);
+    ThisBuffer->hSpill = NULL;
+
+    //
+    //  ReplaceFile preserves the attributes, security and identity of the
+    //  target.  It fails if there's no target to replace, and isn't
+    //  available on older systems, so fall back to a superseding rename.
+    //
+
+    Replaced = FALSE;
+    LastError = ERROR_SUCCESS;
+    YoriLibLoadKernel32Functions();
+    if (DllKernel32.pReplaceFileW != NULL) {
+        Replaced = DllKernel32.pReplaceFileW(ThisBuffer->TargetFileName->StartOfString,
+                                             ThisBuffer->SpillFileName.StartOfString,
+                                             NULL,
+                                             REPLACEFILE_IGNORE_MERGE_ERRORS,
+                                             NULL,
+                                             NULL);
+        if (!Replaced) {
+            LastError = GetLastError();
         }
+    }
 
-        ASSERT(BytesSent <= ThisBuffer->BytesPopulated);
+    if (!Replaced &&
+        (LastError == ERROR_SUCCESS || LastError == ERROR_FILE_NOT_FOUND)) {
+
+        Replaced = MoveFileEx(ThisBuffer->SpillFileName.StartOfString,
+                              ThisBuffer->TargetFileName->StartOfString,
+                              MOVEFILE_REPLACE_EXISTING);
+        if (!Replaced) {
+            LastError = GetLastError();
+        }
     }
 
-    return Result;
+    if (!Replaced) {
+        SpongeDisplayError(_T("replace"), ThisBuffer->TargetFileName, LastError);
+        return FALSE;
+    }
+
+    YoriLibFreeStringContents(&ThisBuffer->SpillFileName);
+    return TRUE;
 }
 
 /**
@@ -207,7 +522,8 @@ SpongeAllocateBuffer(
 }
 
 /**
- Free structures associated with a single input stream.
+ Free structures associated with a single input stream.  If a temporary
+ file was created and has not been moved over the target, it is deleted.
 
  @param ThisBuffer Pointer to the single stream's buffers to deallocate.
  */
@@ -216,6 +532,14 @@ SpongeFreeBuffer(
     __in PSPONGE_BUFFER ThisBuffer
     )
 {
+    if (ThisBuffer->hSpill != NULL) {
+        CloseHandle(ThisBuffer->hSpill);
+        ThisBuffer->hSpill = NULL;
+    }
+    if (ThisBuffer->SpillFileName.LengthInChars > 0) {
+        DeleteFile(ThisBuffer->SpillFileName.StartOfString);
+    }
+    YoriLibFreeStringContents(&ThisBuffer->SpillFileName);
     if (ThisBuffer->Buffer != NULL) {
         YoriLibFree(ThisBuffer->Buffer);
     }
@@ -256,8 +580,11 @@ ENTRYPOINT(
     SPONGE_BUFFER SpongeBuffer;
     YORI_STRING FullFilePath;
     HANDLE hTarget;
+    LARGE_INTEGER MemoryLimit;
+    BOOL Result;
 
     ZeroMemory(&SpongeBuffer, sizeof(SpongeBuffer));
+    SpongeBuffer.MemoryLimit = SPONGE_DEFAULT_MEMORY_LIMIT;
 
     for (i = 1; i < ArgC; i++) {
 
@@ -271,6 +598,19 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("license")) == 0) {
                 YoriLibDisplayMitLicense(_T("2019"));
                 return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("m")) == 0) {
+                if (i + 1 < ArgC) {
+                    MemoryLimit = YoriLibStringToFileSize(&ArgV[i + 1]);
+                    if (MemoryLimit.HighPart != 0) {
+                        SpongeBuffer.MemoryLimit = (DWORD)-1;
+                    } else if (MemoryLimit.LowPart < 1024) {
+                        SpongeBuffer.MemoryLimit = 1024;
+                    } else {
+                        SpongeBuffer.MemoryLimit = MemoryLimit.LowPart;
+                    }
+                    ArgumentUnderstood = TRUE;
+                    i++;
+                }
             } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("-")) == 0) {
                 ArgumentUnderstood = TRUE;
                 StartArg = i + 1;
@@ -309,41 +649,28 @@ ENTRYPOINT(
             SpongeFreeBuffer(&SpongeBuffer);
             return EXIT_FAILURE;
         }
+        SpongeBuffer.TargetFileName = &FullFilePath;
     }
 
     if (!SpongeBufferPump(&SpongeBuffer)) {
         SpongeFreeBuffer(&SpongeBuffer);
+        YoriLibFreeStringContents(&FullFilePath);
         return EXIT_FAILURE;
     }
 
     if (FullFilePath.LengthInChars > 0) {
-        hTarget = CreateFile(FullFilePath.StartOfString,
-                             GENERIC_WRITE,
-                             FILE_SHARE_READ | FILE_SHARE_DELETE,
-                             NULL,
-                             CREATE_ALWAYS,
-                             0,
-                             NULL);
-        if (hTarget == INVALID_HANDLE_VALUE) {
-            DWORD LastError = GetLastError();
-            LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
-            SpongeFreeBuffer(&SpongeBuffer);
-            YoriLibFreeStringContents(&FullFilePath);
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sponge: open file failed: %s"), ErrText);
-            YoriLibFreeWinErrorText(ErrText);
-            return EXIT_FAILURE;
-        }
+        Result = SpongeBufferCommitToFile(&SpongeBuffer);
+    } else {
+        Result = SpongeBufferForward(&SpongeBuffer, hTarget);
     }
 
-    SpongeBufferForward(&SpongeBuffer, hTarget);
+    SpongeFreeBuffer(&SpongeBuffer);
+    YoriLibFreeStringContents(&FullFilePath);
 
-    if (FullFilePath.LengthInChars > 0) {
-        CloseHandle(hTarget);
-        YoriLibFreeStringContents(&FullFilePath);
+    if (!Result) {
+        return EXIT_FAILURE;
     }
 
-    SpongeFreeBuffer(&SpongeBuffer);
-
     return EXIT_SUCCESS;
 }
 
@@ -41,7 +41,8 @@ CHAR strTailHelpText[] =
         "\n"
         "   -b             Use basic search criteria for files only\n"
         "   -c             Specify a line to display context around instead of EOF\n"
-        "   -f             Wait for new output and continue outputting\n"
+        "   -f             Wait for new output and continue outputting, following\n"
+        "                    files that are truncated or replaced\n"
         "   -n             Specify the number of lines to display\n"
         "   -s             Process files from all subdirectories\n";
 
@@ -59,6 +60,82 @@ TailHelp()
     return TRUE;
 }
 
+/**
+ The size of each block read when searching backwards from the end of a file
+ for the final lines.
+ */
+#define TAIL_REVERSE_BLOCK_SIZE (64 * 1024)
+
+/**
+ The maximum time in milliseconds to wait for a change notification before
+ checking followed files anyway.  Directory change notifications for a file
+ which is held open by its writer may be deferred until the writer's
+ handle is flushed or closed, which may not happen for a long running
+ writer, so this is the same interval tail used when polling.
+ */
+#define TAIL_FOLLOW_FALLBACK_DELAY (200)
+
+/**
+ A directory containing one or more files which are being followed.
+ */
+typedef struct _TAIL_FOLLOW_DIRECTORY {
+
+    /**
+     The full path to the directory.
+     */
+    YORI_STRING DirectoryPath;
+
+    /**
+     A change notification handle which is signalled when a file within the
+     directory is modified, created or renamed.  This can be NULL if the
+     notification could not be created.
+     */
+    HANDLE ChangeHandle;
+} TAIL_FOLLOW_DIRECTORY, *PTAIL_FOLLOW_DIRECTORY;
+
+/**
+ A file which is being followed.
+ */
+typedef struct _TAIL_FOLLOW_FILE {
+
+    /**
+     The full path to the file.  This is used to reopen the file if it is
+     replaced, and as a prefix to lines when following multiple files.
+     */
+    YORI_STRING FilePath;
+
+    /**
+     A handle to the file currently being read.
+     */
+    HANDLE FileHandle;
+
+    /**
+     The line read context used to read from FileHandle.
+     */
+    PVOID LineContext;
+
+    /**
+     The index of the directory containing the file within the array of
+     directories being monitored.
+     */
+    DWORD DirectoryIndex;
+
+    /**
+     The serial number of the volume containing the file being read.
+     */
+    DWORD VolumeSerialNumber;
+
+    /**
+     The high 32 bits of the file index of the file being read.
+     */
+    DWORD FileIndexHigh;
+
+    /**
+     The low 32 bits of the file index of the file being read.
+     */
+    DWORD FileIndexLow;
+} TAIL_FOLLOW_FILE, *PTAIL_FOLLOW_FILE;
+
 /**
  Context passed to the callback which is invoked for each file found.
  */
@@ -109,8 +186,145 @@ typedef struct _TAIL_CONTEXT {
      */
     BOOL Recursive;
 
+    /**
+     An array of files to continue outputting once the initial lines of all
+     files have been displayed.
+     */
+    PTAIL_FOLLOW_FILE FollowFiles;
+
+    /**
+     The number of elements in the FollowFiles array.
+     */
+    DWORD FollowFileCount;
+
+    /**
+     An array of directories containing the files being followed.
+     */
+    PTAIL_FOLLOW_DIRECTORY FollowDirectories;
+
+    /**
+     The number of elements in the FollowDirectories array.
+     */
+    DWORD FollowDirectoryCount;
+
 } TAIL_CONTEXT, *PTAIL_CONTEXT;
 
+/**
+ Scan backwards from the end of a file, one block at a time, counting line
+ terminators until the requested number of lines has been found.  Line
+ endings are interpreted the same way as the line reading routines, so a
+ carriage return, a line feed, or a carriage return followed by a line feed
+ each end a line, and a terminator at the end of the file does not begin a
+ new line.
+
+ @param hSource The opened source file.  The file pointer is moved by this
+        function.
+
+ @param LinesToDisplay The number of lines to find.
+
+ @param StartOffset On successful completion, updated to contain the offset
+        of the first line to display.  This is zero if the file contains
+        fewer lines than were requested.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+TailFindFinalLinesOffset(
+    __in HANDLE hSource,
+    __in DWORD LinesToDisplay,
+    __out PLONGLONG StartOffset
+    )
+{
+    PUCHAR Buffer;
+    LARGE_INTEGER FileSize;
+    LARGE_INTEGER BlockStart;
+    LONGLONG FileEnd;
+    LONGLONG BlockEnd;
+    LONGLONG TerminatorEnd;
+    DWORD BlockLength;
+    DWORD BytesRead;
+    DWORD Index;
+    DWORD UnitSize;
+    DWORD Unit;
+    DWORD LinesFound;
+    BOOL NextUnitIsLineFeed;
+
+    UnitSize = sizeof(UCHAR);
+    if (YoriLibGetMultibyteInputEncoding() == CP_UTF16) {
+        UnitSize = sizeof(WCHAR);
+    }
+
+    FileSize.LowPart = GetFileSize(hSource, (LPDWORD)&FileSize.HighPart);
+    if (FileSize.LowPart == (DWORD)-1 && GetLastError() != NO_ERROR) {
+        return FALSE;
+    }
+
+    Buffer = YoriLibMalloc(TAIL_REVERSE_BLOCK_SIZE);
+    if (Buffer == NULL) {
+        return FALSE;
+    }
+
+    FileEnd = FileSize.QuadPart - (FileSize.QuadPart % UnitSize);
+    BlockEnd = FileEnd;
+    LinesFound = 0;
+    NextUnitIsLineFeed = FALSE;
+
+    while (BlockEnd > 0) {
+        BlockLength = TAIL_REVERSE_BLOCK_SIZE;
+        if (BlockEnd < BlockLength) {
+            BlockLength = (DWORD)BlockEnd;
+        }
+        BlockStart.QuadPart = BlockEnd - BlockLength;
+
+        BlockStart.LowPart = SetFilePointer(hSource, BlockStart.LowPart, &BlockStart.HighPart, FILE_BEGIN);
+        if (BlockStart.LowPart == (DWORD)-1 && GetLastError() != NO_ERROR) {
+            YoriLibFree(Buffer);
+            return FALSE;
+        }
+
+        if (!ReadFile(hSource, Buffer, BlockLength, &BytesRead, NULL) ||
+            BytesRead != BlockLength) {
+
+            YoriLibFree(Buffer);
+            return FALSE;
+        }
+
+        Index = BlockLength;
+        while (Index >= UnitSize) {
+            Index -= UnitSize;
+            if (UnitSize == sizeof(WCHAR)) {
+                Unit = *(PWCHAR)&Buffer[Index];
+            } else {
+                Unit = Buffer[Index];
+            }
+
+            //
+            //  A carriage return followed by a line feed was counted when
+            //  the line feed was found.
+            //
+
+            if (Unit == '\n' || (Unit == '\r' && !NextUnitIsLineFeed)) {
+                TerminatorEnd = BlockStart.QuadPart + Index + UnitSize;
+                if (TerminatorEnd != FileEnd) {
+                    LinesFound++;
+                    if (LinesFound == LinesToDisplay) {
+                        *StartOffset = TerminatorEnd;
+                        YoriLibFree(Buffer);
+                        return TRUE;
+                    }
+                }
+            }
+            NextUnitIsLineFeed = (BOOL)(Unit == '\n');
+        }
+
+        BlockEnd = BlockStart.QuadPart;
+    }
+
+    *StartOffset = 0;
+    YoriLibFree(Buffer);
+    return TRUE;
+}
+
 /**
  Process a single opened stream, enumerating through all lines and displaying
  the set requested by the user.
@@ -119,43 +333,73 @@ typedef struct _TAIL_CONTEXT {
 
  @param TailContext Pointer to context information specifying which lines to
         display.
+
+ @param FollowLineContext If specified, the stream will be followed by the
+        caller, so on return this is updated to contain the line read
+        context which should be used to continue reading.  If not specified
+        and the user requested that output be followed, this function
+        continues to output from the stream until the operation is
+        cancelled.
  
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
 TailProcessStream(
     __in HANDLE hSource,
-    __in PTAIL_CONTEXT TailContext
+    __in PTAIL_CONTEXT TailContext,
+    __out_opt PVOID * FollowLineContext
     )
 {
     PVOID LineContext = NULL;
     LONGLONG StartLine = 0;
     LONGLONG CurrentLine;
+    LARGE_INTEGER StartOffset;
     PYORI_STRING LineString;
     BOOL LineTerminated;
     BOOL TimeoutReached;
-    DWORD SeekToEndOffset = 0;
+    BOOL FoundFromEnd = FALSE;
 
     DWORD FileType = GetFileType(hSource);
     FileType = FileType & ~(FILE_TYPE_REMOTE);
 
+    TailContext->FilesFound++;
+    TailContext->FilesFoundThisArg++;
+
     //
-    //  If it's a file and we want the final few lines, start searching
-    //  from the end, assuming an average line size of 256 bytes.
+    //  If it's a file and we want the final few lines, search backwards
+    //  from the end to find where they start, then output everything from
+    //  that point.
     //
 
     if (FileType == FILE_TYPE_DISK && TailContext->FinalLine == 0) {
-        SeekToEndOffset = 256 * TailContext->LinesToDisplay;
+        if (TailFindFinalLinesOffset(hSource, TailContext->LinesToDisplay, &StartOffset.QuadPart)) {
+            StartOffset.LowPart = SetFilePointer(hSource, StartOffset.LowPart, &StartOffset.HighPart, FILE_BEGIN);
+            if (StartOffset.LowPart != (DWORD)-1 || GetLastError() == NO_ERROR) {
+                FoundFromEnd = TRUE;
+            }
+        }
+
+        if (!FoundFromEnd) {
+            SetFilePointer(hSource, 0, NULL, FILE_BEGIN);
+        }
     }
 
-    TailContext->FilesFound++;
-    TailContext->FilesFoundThisArg++;
+    if (FoundFromEnd) {
+        LineString = &TailContext->LinesArray[0];
+        while (TRUE) {
+            if (!YoriLibReadLineToStringEx(LineString, &LineContext, !TailContext->WaitForMore, INFINITE, hSource, &LineTerminated, &TimeoutReached)) {
+                break;
+            }
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), LineString);
+        }
+    } else {
 
-    while (TRUE) {
+        //
+        //  Otherwise read every line, keeping the most recent ones, and
+        //  display them once the stream ends or the requested final line
+        //  has been reached.
+        //
 
-        if (SeekToEndOffset != 0) {
-            SetFilePointer(hSource, -1 * SeekToEndOffset, NULL, FILE_END);
-        }
         TailContext->LinesFound = 0;
 
         while (TRUE) {
@@ -173,32 +417,17 @@ TailProcessStream(
 
         if (TailContext->LinesFound > TailContext->LinesToDisplay) {
             StartLine = TailContext->LinesFound - TailContext->LinesToDisplay;
-            break;
-        } else if (SeekToEndOffset != 0) {
-
-            //
-            //  If we didn't get enough lines and we have a file that
-            //  supports arbitrary seeks, try to grab more data.  If
-            //  we've already hit our arbitrary maximum (a 4Kb average
-            //  line size) start scanning from the top.
-            //
+        }
 
-            if (SeekToEndOffset < 4096 * TailContext->LinesToDisplay) {
-                SeekToEndOffset = 4096 * TailContext->LinesToDisplay;
-            } else {
-                SeekToEndOffset = 0;
-                SetFilePointer(hSource, 0, NULL, FILE_BEGIN);
-            }
-            continue;
-        } else {
-            StartLine = 0;
-            break;
+        for (CurrentLine = StartLine; CurrentLine < TailContext->LinesFound; CurrentLine++) {
+            LineString = &TailContext->LinesArray[CurrentLine % TailContext->LinesToDisplay];
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), LineString);
         }
     }
 
-    for (CurrentLine = StartLine; CurrentLine < TailContext->LinesFound; CurrentLine++) {
-        LineString = &TailContext->LinesArray[CurrentLine % TailContext->LinesToDisplay];
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), LineString);
+    if (FollowLineContext != NULL) {
+        *FollowLineContext = LineContext;
+        return TRUE;
     }
 
     if (TailContext->WaitForMore) {
@@ -209,6 +438,7 @@ TailProcessStream(
                     break;
                 }
                 Sleep(200);
+                YoriLibLineReadResume(LineContext);
                 continue;
             }
             YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &TailContext->LinesArray[0]);
@@ -219,6 +449,420 @@ TailProcessStream(
     return TRUE;
 }
 
+/**
+ Record the identity of an opened file, so that a file which is later found
+ at the same path can be checked to see if it has been replaced.
+
+ @param FileHandle The opened file.
+
+ @param FollowFile The followed file to update with the identity.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+TailGetFileIdentity(
+    __in HANDLE FileHandle,
+    __out PTAIL_FOLLOW_FILE FollowFile
+    )
+{
+    BY_HANDLE_FILE_INFORMATION FileInfo;
+
+    if (!GetFileInformationByHandle(FileHandle, &FileInfo)) {
+        return FALSE;
+    }
+
+    FollowFile->VolumeSerialNumber = FileInfo.dwVolumeSerialNumber;
+    FollowFile->FileIndexHigh = FileInfo.nFileIndexHigh;
+    FollowFile->FileIndexLow = FileInfo.nFileIndexLow;
+    return TRUE;
+}
+
+/**
+ Find or create a change notification for the directory containing a file
+ being followed.
+
+ @param TailContext Pointer to the context containing the set of directories
+        being monitored.
+
+ @param FilePath Pointer to the full path of the file being followed.
+
+ @param DirectoryIndex On successful completion, updated to contain the index
+        of the directory within the array of monitored directories.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+TailAddFollowDirectory(
+    __inout PTAIL_CONTEXT TailContext,
+    __in PYORI_STRING FilePath,
+    __out PDWORD DirectoryIndex
+    )
+{
+    YORI_STRING DirName;
+    LPTSTR FilePart;
+    PTAIL_FOLLOW_DIRECTORY NewDirectories;
+    PTAIL_FOLLOW_DIRECTORY Directory;
+    DWORD Index;
+
+    YoriLibInitEmptyString(&DirName);
+    DirName.StartOfString = FilePath->StartOfString;
+    FilePart = YoriLibFindRightMostCharacter(FilePath, '\\');
+    if (FilePart != NULL) {
+        DirName.LengthInChars = (DWORD)(FilePart - DirName.StartOfString);
+    } else {
+        DirName.LengthInChars = FilePath->LengthInChars;
+    }
+
+    for (Index = 0; Index < TailContext->FollowDirectoryCount; Index++) {
+        if (YoriLibCompareStringInsensitive(&TailContext->FollowDirectories[Index].DirectoryPath, &DirName) == 0) {
+            *DirectoryIndex = Index;
+            return TRUE;
+        }
+    }
+
+    NewDirectories = YoriLibMalloc((TailContext->FollowDirectoryCount + 1) * sizeof(TAIL_FOLLOW_DIRECTORY));
+    if (NewDirectories == NULL) {
+        return FALSE;
+    }
+
+    if (TailContext->FollowDirectoryCount > 0) {
+        memcpy(NewDirectories, TailContext->FollowDirectories, TailContext->FollowDirectoryCount * sizeof(TAIL_FOLLOW_DIRECTORY));
+        YoriLibFree(TailContext->FollowDirectories);
+    }
+    TailContext->FollowDirectories = NewDirectories;
+
+    Directory = &NewDirectories[TailContext->FollowDirectoryCount];
+    if (!YoriLibAllocateString(&Directory->DirectoryPath, DirName.LengthInChars + 1)) {
+        return FALSE;
+    }
+    memcpy(Directory->DirectoryPath.StartOfString, DirName.StartOfString, DirName.LengthInChars * sizeof(TCHAR));
+    Directory->DirectoryPath.LengthInChars = DirName.LengthInChars;
+    Directory->DirectoryPath.StartOfString[DirName.LengthInChars] = '\0';
+
+    //
+    //  If a change notification can't be created, files in this directory
+    //  are still checked whenever the wait times out.
+    //
+
+    Directory->ChangeHandle = FindFirstChangeNotification(Directory->DirectoryPath.StartOfString, FALSE, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE);
+    if (Directory->ChangeHandle == INVALID_HANDLE_VALUE) {
+        Directory->ChangeHandle = NULL;
+    }
+
+    *DirectoryIndex = TailContext->FollowDirectoryCount;
+    TailContext->FollowDirectoryCount++;
+    return TRUE;
+}
+
+/**
+ Add a file to the set of files to follow once the initial lines from all
+ files have been displayed.  On success, the file handle and line read
+ context are owned by the follow list.  On failure, they are closed.
+
+ @param TailContext Pointer to the context containing the set of followed
+        files.
+
+ @param FilePath Pointer to the full path of the file.
+
+ @param FileHandle The opened file, positioned after the data that has
+        already been displayed.
+
+ @param LineContext The line read context used to read from the file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+TailAddFollowFile(
+    __inout PTAIL_CONTEXT TailContext,
+    __in PYORI_STRING FilePath,
+    __in HANDLE FileHandle,
+    __in PVOID LineContext
+    )
+{
+    PTAIL_FOLLOW_FILE NewFiles;
+    PTAIL_FOLLOW_FILE FollowFile;
+    DWORD DirectoryIndex;
+
+    if (!TailAddFollowDirectory(TailContext, FilePath, &DirectoryIndex)) {
+        YoriLibLineReadClose(LineContext);
+        CloseHandle(FileHandle);
+        return FALSE;
+    }
+
+    NewFiles = YoriLibMalloc((TailContext->FollowFileCount + 1) * sizeof(TAIL_FOLLOW_FILE));
+    if (NewFiles == NULL) {
+        YoriLibLineReadClose(LineContext);
+        CloseHandle(FileHandle);
+        return FALSE;
+    }
+
+    if (TailContext->FollowFileCount > 0) {
+        memcpy(NewFiles, TailContext->FollowFiles, TailContext->FollowFileCount * sizeof(TAIL_FOLLOW_FILE));
+        YoriLibFree(TailContext->FollowFiles);
+    }
+    TailContext->FollowFiles = NewFiles;
+
+    FollowFile = &NewFiles[TailContext->FollowFileCount];
+    ZeroMemory(FollowFile, sizeof(TAIL_FOLLOW_FILE));
+    if (!YoriLibAllocateString(&FollowFile->FilePath, FilePath->LengthInChars + 1)) {
+        YoriLibLineReadClose(LineContext);
+        CloseHandle(FileHandle);
+        return FALSE;
+    }
+    memcpy(FollowFile->FilePath.StartOfString, FilePath->StartOfString, FilePath->LengthInChars * sizeof(TCHAR));
+    FollowFile->FilePath.LengthInChars = FilePath->LengthInChars;
+    FollowFile->FilePath.StartOfString[FilePath->LengthInChars] = '\0';
+
+    FollowFile->FileHandle = FileHandle;
+    FollowFile->LineContext = LineContext;
+    FollowFile->DirectoryIndex = DirectoryIndex;
+    TailGetFileIdentity(FileHandle, FollowFile);
+
+    TailContext->FollowFileCount++;
+    return TRUE;
+}
+
+/**
+ Output any complete lines that have been added to a followed file.
+
+ @param TailContext Pointer to the tail context.
+
+ @param FollowFile The file to output lines from.
+
+ @param ReturnFinalNonTerminatedLine If TRUE, output any partial line at the
+        end of the file.  This is used when the file has been replaced and
+        no more data is expected.
+ */
+VOID
+TailOutputFollowFileLines(
+    __in PTAIL_CONTEXT TailContext,
+    __in PTAIL_FOLLOW_FILE FollowFile,
+    __in BOOL ReturnFinalNonTerminatedLine
+    )
+{
+    PYORI_STRING LineString;
+    BOOL LineTerminated;
+    BOOL TimeoutReached;
+
+    LineString = &TailContext->LinesArray[0];
+    YoriLibLineReadResume(FollowFile->LineContext);
+
+    while (TRUE) {
+        if (!YoriLibReadLineToStringEx(LineString, &FollowFile->LineContext, ReturnFinalNonTerminatedLine, INFINITE, FollowFile->FileHandle, &LineTerminated, &TimeoutReached)) {
+            break;
+        }
+
+        if (TailContext->FollowFileCount > 1) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y: %y\n"), &FollowFile->FilePath, LineString);
+        } else {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), LineString);
+        }
+    }
+}
+
+/**
+ Check a followed file for new data, truncation, or replacement, and output
+ any new lines.
+
+ @param TailContext Pointer to the tail context.
+
+ @param FollowFile The file to check.
+ */
+VOID
+TailCheckFollowFile(
+    __in PTAIL_CONTEXT TailContext,
+    __in PTAIL_FOLLOW_FILE FollowFile
+    )
+{
+    HANDLE NewHandle;
+    TAIL_FOLLOW_FILE NewIdentity;
+    LARGE_INTEGER FileSize;
+    LARGE_INTEGER CurrentOffset;
+
+    //
+    //  If a different file now exists at the path, the followed file has
+    //  been rotated.  Output whatever remains in the old file, then switch
+    //  to the new one from its beginning.  If nothing exists at the path,
+    //  the file has been renamed and not yet recreated, so keep reading the
+    //  old file.
+    //
+
+    NewHandle = CreateFile(FollowFile->FilePath.StartOfString,
+                           GENERIC_READ,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                           NULL,
+                           OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL,
+                           NULL);
+
+    if (NewHandle != INVALID_HANDLE_VALUE) {
+        if (TailGetFileIdentity(NewHandle, &NewIdentity) &&
+            (NewIdentity.VolumeSerialNumber != FollowFile->VolumeSerialNumber ||
+             NewIdentity.FileIndexHigh != FollowFile->FileIndexHigh ||
+             NewIdentity.FileIndexLow != FollowFile->FileIndexLow)) {
+
+            TailOutputFollowFileLines(TailContext, FollowFile, TRUE);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tail: %y has been replaced, following new file\n"), &FollowFile->FilePath);
+
+            YoriLibLineReadClose(FollowFile->LineContext);
+            FollowFile->LineContext = NULL;
+            CloseHandle(FollowFile->FileHandle);
+            FollowFile->FileHandle = NewHandle;
+            FollowFile->VolumeSerialNumber = NewIdentity.VolumeSerialNumber;
+            FollowFile->FileIndexHigh = NewIdentity.FileIndexHigh;
+            FollowFile->FileIndexLow = NewIdentity.FileIndexLow;
+        } else {
+            CloseHandle(NewHandle);
+        }
+    }
+
+    //
+    //  If the file is now smaller than the amount that has been read, it
+    //  has been truncated.  Discard anything buffered and start again from
+    //  the beginning.
+    //
+
+    FileSize.LowPart = GetFileSize(FollowFile->FileHandle, (LPDWORD)&FileSize.HighPart);
+    if (FileSize.LowPart != (DWORD)-1 || GetLastError() == NO_ERROR) {
+        CurrentOffset.HighPart = 0;
+        CurrentOffset.LowPart = SetFilePointer(FollowFile->FileHandle, 0, &CurrentOffset.HighPart, FILE_CURRENT);
+        if ((CurrentOffset.LowPart != (DWORD)-1 || GetLastError() == NO_ERROR) &&
+            FileSize.QuadPart < CurrentOffset.QuadPart) {
+
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tail: %y has been truncated\n"), &FollowFile->FilePath);
+            YoriLibLineReadClose(FollowFile->LineContext);
+            FollowFile->LineContext = NULL;
+            SetFilePointer(FollowFile->FileHandle, 0, NULL, FILE_BEGIN);
+        }
+    }
+
+    TailOutputFollowFileLines(TailContext, FollowFile, FALSE);
+}
+
+/**
+ Wait for changes to any of the followed files and output new lines as they
+ arrive.  This waits on change notifications for the directories containing
+ the files, so it only wakes when something has changed, or when
+ TAIL_FOLLOW_FALLBACK_DELAY elapses.  This returns when the operation is
+ cancelled.
+
+ @param TailContext Pointer to the context containing the files to follow.
+ */
+VOID
+TailFollowFiles(
+    __in PTAIL_CONTEXT TailContext
+    )
+{
+    HANDLE WaitHandles[MAXIMUM_WAIT_OBJECTS];
+    DWORD WaitDirectories[MAXIMUM_WAIT_OBJECTS];
+    DWORD HandleCount;
+    DWORD FirstDirectoryHandle;
+    DWORD WaitResult;
+    DWORD DirectoryIndex;
+    DWORD Index;
+
+    //
+    //  Build the set of handles to wait on.  If there are more directories
+    //  than can be waited on, the remaining ones are checked when the wait
+    //  times out.
+    //
+
+    HandleCount = 0;
+    if (YoriLibCancelGetEvent() != NULL) {
+        WaitHandles[HandleCount] = YoriLibCancelGetEvent();
+        HandleCount++;
+    }
+    FirstDirectoryHandle = HandleCount;
+
+    for (Index = 0; Index < TailContext->FollowDirectoryCount && HandleCount < MAXIMUM_WAIT_OBJECTS; Index++) {
+        if (TailContext->FollowDirectories[Index].ChangeHandle != NULL) {
+            WaitHandles[HandleCount] = TailContext->FollowDirectories[Index].ChangeHandle;
+            WaitDirectories[HandleCount] = Index;
+            HandleCount++;
+        }
+    }
+
+    //
+    //  Catch anything written between the initial display and the
+    //  notifications being established.
+    //
+
+    for (Index = 0; Index < TailContext->FollowFileCount; Index++) {
+        TailCheckFollowFile(TailContext, &TailContext->FollowFiles[Index]);
+    }
+
+    while (TRUE) {
+
+        if (HandleCount > 0) {
+            WaitResult = WaitForMultipleObjects(HandleCount, WaitHandles, FALSE, TAIL_FOLLOW_FALLBACK_DELAY);
+        } else {
+            Sleep(TAIL_FOLLOW_FALLBACK_DELAY);
+            WaitResult = WAIT_TIMEOUT;
+        }
+
+        if (YoriLibIsOperationCancelled()) {
+            break;
+        }
+
+        if (WaitResult >= WAIT_OBJECT_0 + FirstDirectoryHandle &&
+            WaitResult < WAIT_OBJECT_0 + HandleCount) {
+
+            FindNextChangeNotification(WaitHandles[WaitResult - WAIT_OBJECT_0]);
+            DirectoryIndex = WaitDirectories[WaitResult - WAIT_OBJECT_0];
+            for (Index = 0; Index < TailContext->FollowFileCount; Index++) {
+                if (TailContext->FollowFiles[Index].DirectoryIndex == DirectoryIndex) {
+                    TailCheckFollowFile(TailContext, &TailContext->FollowFiles[Index]);
+                }
+            }
+        } else {
+            if (WaitResult == WAIT_FAILED) {
+                Sleep(TAIL_FOLLOW_FALLBACK_DELAY);
+            }
+            for (Index = 0; Index < TailContext->FollowFileCount; Index++) {
+                TailCheckFollowFile(TailContext, &TailContext->FollowFiles[Index]);
+            }
+        }
+    }
+}
+
+/**
+ Close all files and change notifications used to follow files.
+
+ @param TailContext Pointer to the context containing the files to follow.
+ */
+VOID
+TailFreeFollowFiles(
+    __in PTAIL_CONTEXT TailContext
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < TailContext->FollowFileCount; Index++) {
+        YoriLibLineReadClose(TailContext->FollowFiles[Index].LineContext);
+        CloseHandle(TailContext->FollowFiles[Index].FileHandle);
+        YoriLibFreeStringContents(&TailContext->FollowFiles[Index].FilePath);
+    }
+
+    for (Index = 0; Index < TailContext->FollowDirectoryCount; Index++) {
+        if (TailContext->FollowDirectories[Index].ChangeHandle != NULL) {
+            FindCloseChangeNotification(TailContext->FollowDirectories[Index].ChangeHandle);
+        }
+        YoriLibFreeStringContents(&TailContext->FollowDirectories[Index].DirectoryPath);
+    }
+
+    if (TailContext->FollowFiles != NULL) {
+        YoriLibFree(TailContext->FollowFiles);
+        TailContext->FollowFiles = NULL;
+    }
+    TailContext->FollowFileCount = 0;
+
+    if (TailContext->FollowDirectories != NULL) {
+        YoriLibFree(TailContext->FollowDirectories);
+        TailContext->FollowDirectories = NULL;
+    }
+    TailContext->FollowDirectoryCount = 0;
+}
+
 /**
  A callback that is invoked when a file is found that matches a search criteria
  specified in the set of strings to enumerate.
@@ -269,9 +913,19 @@ TailFileFoundCallback(
             return TRUE;
         }
 
-        TailProcessStream(FileHandle, TailContext);
+        //
+        //  When following, display the final lines of every file first, and
+        //  follow all of them once enumeration is complete.
+        //
 
-        CloseHandle(FileHandle);
+        if (TailContext->WaitForMore) {
+            PVOID LineContext = NULL;
+            TailProcessStream(FileHandle, TailContext, &LineContext);
+            TailAddFollowFile(TailContext, FilePath, FileHandle, LineContext);
+        } else {
+            TailProcessStream(FileHandle, TailContext, NULL);
+            CloseHandle(FileHandle);
+        }
     }
 
     return TRUE;
@@ -465,7 +1119,7 @@ ENTRYPOINT(
             return EXIT_FAILURE;
         }
 
-        TailProcessStream(GetStdHandle(STD_INPUT_HANDLE), &TailContext);
+        TailProcessStream(GetStdHandle(STD_INPUT_HANDLE), &TailContext, NULL);
     } else {
         MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_DIRECTORY_CONTENTS;
         if (TailContext.Recursive) {
@@ -495,6 +1149,11 @@ ENTRYPOINT(
                 }
             }
         }
+
+        if (TailContext.FollowFileCount > 0) {
+            TailFollowFiles(&TailContext);
+        }
+        TailFreeFollowFiles(&TailContext);
     }
 
     for (Count = 0; Count < TailContext.LinesToDisplay; Count++) {
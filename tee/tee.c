@@ -1,7 +1,7 @@
 /**
  * @file tee/tee.c
  *
- * Yori shell output to a file and stdout
+ * Yori shell output to files and stdout
  *
  * Copyright (c) 2017-2018 Malcolm J. Smith
  *
@@ -33,11 +33,13 @@
 const
 CHAR strTeeHelpText[] =
         "\n"
-        "Output the contents of standard input to standard output and a file.\n"
+        "Output the contents of standard input to standard output and files.\n"
         "\n"
-        "TEE [-license] [-a] <file>\n"
+        "TEE [-license] [-a] [-d] [-v] <file> [<file>...]\n"
         "\n"
-        "   -a             Append to the file\n";
+        "   -a             Append to the files\n"
+        "   -d             Drop output to files which cannot keep up rather than wait\n"
+        "   -v             Display the bytes written and time spent waiting per file\n";
 
 /**
  Display usage text to the user.
@@ -53,6 +55,134 @@ TeeHelp()
     return TRUE;
 }
 
+/**
+ The size of the buffer used to read from standard input.
+ */
+#define TEE_READ_BUFFER_SIZE (256 * 1024)
+
+/**
+ The size of the ring buffer between the reader and each file's writer
+ thread.
+ */
+#define TEE_RING_BUFFER_SIZE (1024 * 1024)
+
+/**
+ Writes at least this large are handed to the writer thread directly rather
+ than being copied into the ring buffer, when waiting for slow files is
+ allowed.
+ */
+#define TEE_DIRECT_WRITE_THRESHOLD (64 * 1024)
+
+/**
+ A single file receiving output, with the thread that writes to it.
+ */
+typedef struct _TEE_TARGET {
+
+    /**
+     The full path to the file.
+     */
+    YORI_STRING FileName;
+
+    /**
+     Handle to the file.
+     */
+    HANDLE hFile;
+
+    /**
+     Handle to the thread writing to the file.
+     */
+    HANDLE hThread;
+
+    /**
+     A mutex protecting the ring buffer state and the pending direct write.
+     */
+    HANDLE Mutex;
+
+    /**
+     An event signalled when data is added, a direct write is requested,
+     or the target is closing.
+     */
+    HANDLE DataAvailable;
+
+    /**
+     An event signalled by the writer thread when it has made space in the
+     ring buffer.
+     */
+    HANDLE SpaceAvailable;
+
+    /**
+     An event signalled by the writer thread when a direct write has
+     completed.
+     */
+    HANDLE DirectComplete;
+
+    /**
+     The ring buffer of data waiting to be written.
+     */
+    PUCHAR Buffer;
+
+    /**
+     The offset within the ring buffer of the next byte to write.
+     */
+    DWORD ReadOffset;
+
+    /**
+     The number of bytes in the ring buffer waiting to be written.
+     */
+    DWORD BytesInBuffer;
+
+    /**
+     If nonzero, points to data supplied by the reader which should be
+     written without being copied into the ring buffer.
+     */
+    PUCHAR DirectData;
+
+    /**
+     The number of bytes in DirectData.
+     */
+    DWORD DirectLength;
+
+    /**
+     Set to TRUE by the reader when it has handed a buffer to the writer
+     thread directly and must wait for it to complete before reusing the
+     buffer.
+     */
+    BOOL DirectPending;
+
+    /**
+     Set to TRUE when no more data will be supplied, so the writer thread
+     should exit once the ring buffer is empty.
+     */
+    BOOL Closing;
+
+    /**
+     Set to TRUE if a write to the file has failed.  Subsequent data is
+     discarded.
+     */
+    BOOL WriteFailed;
+
+    /**
+     The Win32 error from the failing write, if WriteFailed is TRUE.
+     */
+    DWORD WriteError;
+
+    /**
+     The number of bytes written to the file.
+     */
+    DWORDLONG BytesWritten;
+
+    /**
+     The number of bytes discarded because the ring buffer was full.
+     */
+    DWORDLONG BytesDropped;
+
+    /**
+     The number of milliseconds the reader spent waiting for this file.
+     */
+    DWORDLONG StallTime;
+
+} TEE_TARGET, *PTEE_TARGET;
+
 /**
  Context passed to the callback which is invoked for each source stream
  processed.
@@ -60,25 +190,534 @@ TeeHelp()
 typedef struct _TEE_CONTEXT {
 
     /**
-     Handle to a file which will receive all output in addition to standard
+     An array of files which will receive all output in addition to standard
      output.
      */
-    HANDLE hFile;
+    PTEE_TARGET Targets;
+
+    /**
+     The number of elements in the Targets array.
+     */
+    DWORD TargetCount;
+
+    /**
+     If TRUE, data for a file whose ring buffer is full is discarded and
+     counted.  If FALSE, the reader waits for the file to catch up.
+     */
+    BOOL DropWhenFull;
+
+    /**
+     If TRUE, display the bytes written and time spent waiting for each file
+     on exit.
+     */
+    BOOL Verbose;
 
 } TEE_CONTEXT, *PTEE_CONTEXT;
 
 /**
- Process a single stream.
+ Write a buffer to a handle, retrying until all of it has been written.
+
+ @param hTarget The handle to write to.
+
+ @param Data Pointer to the data to write.
+
+ @param Length The number of bytes to write.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+TeeWriteAll(
+    __in HANDLE hTarget,
+    __in PUCHAR Data,
+    __in DWORD Length
+    )
+{
+    DWORD BytesWritten;
+
+    while (Length > 0) {
+        if (!WriteFile(hTarget, Data, Length, &BytesWritten, NULL)) {
+            return FALSE;
+        }
+        if (BytesWritten == 0) {
+            SetLastError(ERROR_WRITE_FAULT);
+            return FALSE;
+        }
+        Data += BytesWritten;
+        Length -= BytesWritten;
+    }
+    return TRUE;
+}
+
+/**
+ Write data on behalf of a writer thread, recording the result.
+
+ @param Target The target to write to.
+
+ @param Data Pointer to the data to write.
+
+ @param Length The number of bytes to write.
+ */
+VOID
+TeeTargetWriteData(
+    __in PTEE_TARGET Target,
+    __in PUCHAR Data,
+    __in DWORD Length
+    )
+{
+    if (Target->WriteFailed) {
+        return;
+    }
+
+    if (TeeWriteAll(Target->hFile, Data, Length)) {
+        Target->BytesWritten += Length;
+    } else {
+        Target->WriteError = GetLastError();
+        Target->WriteFailed = TRUE;
+    }
+}
+
+/**
+ The thread which writes data for a single target.  It writes any direct
+ write it is handed, then drains the ring buffer, and exits when the target
+ is closing and no data remains.
+
+ @param Context Pointer to the target.
+
+ @return Zero.
+ */
+DWORD WINAPI
+TeeTargetWriterThread(
+    __in LPVOID Context
+    )
+{
+    PTEE_TARGET Target = (PTEE_TARGET)Context;
+    PUCHAR Data;
+    DWORD Length;
+
+    while (TRUE) {
+        WaitForSingleObject(Target->Mutex, INFINITE);
+
+        if (Target->DirectData != NULL) {
+            Data = Target->DirectData;
+            Length = Target->DirectLength;
+            ReleaseMutex(Target->Mutex);
+
+            TeeTargetWriteData(Target, Data, Length);
+
+            WaitForSingleObject(Target->Mutex, INFINITE);
+            Target->DirectData = NULL;
+            Target->DirectLength = 0;
+            ReleaseMutex(Target->Mutex);
+            SetEvent(Target->DirectComplete);
+            continue;
+        }
+
+        if (Target->BytesInBuffer > 0) {
+
+            //
+            //  Write the contiguous region up to the end of the ring.  Any
+            //  wrapped data is written on the next pass.
+            //
+
+            Data = &Target->Buffer[Target->ReadOffset];
+            Length = Target->BytesInBuffer;
+            if (Length > TEE_RING_BUFFER_SIZE - Target->ReadOffset) {
+                Length = TEE_RING_BUFFER_SIZE - Target->ReadOffset;
+            }
+            ReleaseMutex(Target->Mutex);
+
+            TeeTargetWriteData(Target, Data, Length);
+
+            WaitForSingleObject(Target->Mutex, INFINITE);
+            Target->ReadOffset = (Target->ReadOffset + Length) % TEE_RING_BUFFER_SIZE;
+            Target->BytesInBuffer -= Length;
+            ReleaseMutex(Target->Mutex);
+            SetEvent(Target->SpaceAvailable);
+            continue;
+        }
+
+        if (Target->Closing) {
+            ReleaseMutex(Target->Mutex);
+            break;
+        }
+
+        ReleaseMutex(Target->Mutex);
+        WaitForSingleObject(Target->DataAvailable, INFINITE);
+    }
+
+    return 0;
+}
+
+/**
+ Queue data to be written to a target.  If the ring buffer does not have
+ space, this either waits for the writer thread or discards the data,
+ depending on the policy requested by the user.  A large write may be handed
+ to the writer thread directly, in which case the caller must call
+ TeeTargetWaitForDirectWrite before reusing the buffer.
+
+ @param TeeContext Pointer to the context describing the policy to apply.
+
+ @param Target The target to write to.
+
+ @param Data Pointer to the data to write.
+
+ @param Length The number of bytes to write.
+
+ @param AllowDirect If TRUE, the data may be handed to the writer thread
+        without being copied.  If FALSE, the data is always copied, so the
+        caller can reuse the buffer immediately.
+
+ @return TRUE if the data was handed to the writer thread directly, FALSE
+         if it was copied or discarded.
+ */
+BOOL
+TeeTargetQueue(
+    __in PTEE_CONTEXT TeeContext,
+    __in PTEE_TARGET Target,
+    __in PUCHAR Data,
+    __in DWORD Length,
+    __in BOOL AllowDirect
+    )
+{
+    DWORD StartTime;
+    DWORD WriteOffset;
+    DWORD BytesThisPass;
+
+    WaitForSingleObject(Target->Mutex, INFINITE);
+
+    //
+    //  If the file can't be written, don't wait for it.
+    //
+
+    if (Target->WriteFailed) {
+        ReleaseMutex(Target->Mutex);
+        return FALSE;
+    }
+
+    if (TeeContext->DropWhenFull) {
+        if (TEE_RING_BUFFER_SIZE - Target->BytesInBuffer < Length) {
+            Target->BytesDropped += Length;
+            ReleaseMutex(Target->Mutex);
+            return FALSE;
+        }
+    } else if (AllowDirect && Length >= TEE_DIRECT_WRITE_THRESHOLD) {
+
+        //
+        //  Wait for anything already queued so the file is written in
+        //  order, then hand the caller's buffer to the writer.
+        //
+
+        while (Target->BytesInBuffer > 0 && !Target->WriteFailed) {
+            ReleaseMutex(Target->Mutex);
+            StartTime = GetTickCount();
+            WaitForSingleObject(Target->SpaceAvailable, INFINITE);
+            Target->StallTime += GetTickCount() - StartTime;
+            WaitForSingleObject(Target->Mutex, INFINITE);
+        }
+
+        Target->DirectData = Data;
+        Target->DirectLength = Length;
+        ReleaseMutex(Target->Mutex);
+        SetEvent(Target->DataAvailable);
+        return TRUE;
+    }
+
+    while (Length > 0) {
+        if (Target->BytesInBuffer == TEE_RING_BUFFER_SIZE) {
+            if (Target->WriteFailed) {
+                break;
+            }
+            ReleaseMutex(Target->Mutex);
+            StartTime = GetTickCount();
+            WaitForSingleObject(Target->SpaceAvailable, INFINITE);
+            Target->StallTime += GetTickCount() - StartTime;
+            WaitForSingleObject(Target->Mutex, INFINITE);
+            continue;
+        }
+
+        WriteOffset = (Target->ReadOffset + Target->BytesInBuffer) % TEE_RING_BUFFER_SIZE;
+        BytesThisPass = TEE_RING_BUFFER_SIZE - Target->BytesInBuffer;
+        if (BytesThisPass > TEE_RING_BUFFER_SIZE - WriteOffset) {
+            BytesThisPass = TEE_RING_BUFFER_SIZE - WriteOffset;
+        }
+        if (BytesThisPass > Length) {
+            BytesThisPass = Length;
+        }
+
+        memcpy(&Target->Buffer[WriteOffset], Data, BytesThisPass);
+        Target->BytesInBuffer += BytesThisPass;
+        Data += BytesThisPass;
+        Length -= BytesThisPass;
+        SetEvent(Target->DataAvailable);
+    }
+
+    ReleaseMutex(Target->Mutex);
+    return FALSE;
+}
+
+/**
+ Wait for a write handed directly to a target's writer thread to complete.
+
+ @param Target The target to wait for.
+ */
+VOID
+TeeTargetWaitForDirectWrite(
+    __in PTEE_TARGET Target
+    )
+{
+    DWORD StartTime;
+
+    StartTime = GetTickCount();
+    WaitForSingleObject(Target->DirectComplete, INFINITE);
+    Target->StallTime += GetTickCount() - StartTime;
+}
+
+/**
+ Send data to every target.  On return, the caller can reuse the buffer.
+
+ @param TeeContext Pointer to the context containing the targets.
+
+ @param Data Pointer to the data to write.
+
+ @param Length The number of bytes to write.
+
+ @param AllowDirect If TRUE, large writes may be handed to writer threads
+        without being copied.
+ */
+VOID
+TeeWriteToTargets(
+    __in PTEE_CONTEXT TeeContext,
+    __in PUCHAR Data,
+    __in DWORD Length,
+    __in BOOL AllowDirect
+    )
+{
+    DWORD Index;
+    BOOL DirectPending = FALSE;
+
+    for (Index = 0; Index < TeeContext->TargetCount; Index++) {
+        if (TeeTargetQueue(TeeContext, &TeeContext->Targets[Index], Data, Length, AllowDirect)) {
+            TeeContext->Targets[Index].DirectPending = TRUE;
+            DirectPending = TRUE;
+        }
+    }
+
+    //
+    //  If any writer is using the caller's buffer, wait for them all.  The
+    //  writes to each file proceed in parallel.
+    //
+
+    if (DirectPending) {
+        for (Index = 0; Index < TeeContext->TargetCount; Index++) {
+            if (TeeContext->Targets[Index].DirectPending) {
+                TeeTargetWaitForDirectWrite(&TeeContext->Targets[Index]);
+                TeeContext->Targets[Index].DirectPending = FALSE;
+            }
+        }
+    }
+}
+
+/**
+ Open a file to receive output and start the thread which writes to it.
+
+ @param Target The target to initialize.  FileName should be populated on
+        entry.
+
+ @param Append If TRUE, data is appended to any existing file contents.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+TeeTargetOpen(
+    __inout PTEE_TARGET Target,
+    __in BOOL Append
+    )
+{
+    DWORD ThreadId;
+    DWORD LastError;
+    LPTSTR ErrText;
+
+    Target->hFile = CreateFile(Target->FileName.StartOfString,
+                               (Append?FILE_APPEND_DATA:FILE_WRITE_DATA) | SYNCHRONIZE,
+                               FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+                               NULL,
+                               OPEN_ALWAYS,
+                               FILE_ATTRIBUTE_NORMAL,
+                               NULL);
+
+    if (Target->hFile == INVALID_HANDLE_VALUE || Target->hFile == NULL) {
+        LastError = GetLastError();
+        ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tee: open of %y failed: %s"), &Target->FileName, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        Target->hFile = NULL;
+        return FALSE;
+    }
+
+    Target->Buffer = YoriLibMalloc(TEE_RING_BUFFER_SIZE);
+    Target->Mutex = CreateMutex(NULL, FALSE, NULL);
+    Target->DataAvailable = CreateEvent(NULL, FALSE, FALSE, NULL);
+    Target->SpaceAvailable = CreateEvent(NULL, FALSE, FALSE, NULL);
+    Target->DirectComplete = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+    if (Target->Buffer == NULL ||
+        Target->Mutex == NULL ||
+        Target->DataAvailable == NULL ||
+        Target->SpaceAvailable == NULL ||
+        Target->DirectComplete == NULL) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tee: allocation failure\n"));
+        return FALSE;
+    }
+
+    Target->hThread = CreateThread(NULL, 0, TeeTargetWriterThread, Target, 0, &ThreadId);
+    if (Target->hThread == NULL) {
+        LastError = GetLastError();
+        ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tee: create thread failed: %s"), ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Wait for a target's writer thread to write all queued data, then close the
+ target, reporting its statistics if requested.
+
+ @param TeeContext Pointer to the context indicating whether statistics
+        should be displayed.
+
+ @param Target The target to close.
+
+ @return TRUE if all data was written to the target, FALSE if it was not.
+ */
+BOOL
+TeeTargetClose(
+    __in PTEE_CONTEXT TeeContext,
+    __inout PTEE_TARGET Target
+    )
+{
+    BOOL Result = TRUE;
+    LPTSTR ErrText;
+
+    if (Target->hThread != NULL) {
+        WaitForSingleObject(Target->Mutex, INFINITE);
+        Target->Closing = TRUE;
+        ReleaseMutex(Target->Mutex);
+        SetEvent(Target->DataAvailable);
+        WaitForSingleObject(Target->hThread, INFINITE);
+        CloseHandle(Target->hThread);
+
+        if (Target->WriteFailed) {
+            ErrText = YoriLibGetWinErrorText(Target->WriteError);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tee: write to %y failed: %s"), &Target->FileName, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            Result = FALSE;
+        }
+
+        if (Target->BytesDropped > 0) {
+            Result = FALSE;
+        }
+
+        if (TeeContext->Verbose || Target->BytesDropped > 0) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                          _T("tee: %y: %lli bytes written, %lli bytes dropped, %lli ms waiting\n"),
+                          &Target->FileName,
+                          (LONGLONG)Target->BytesWritten,
+                          (LONGLONG)Target->BytesDropped,
+                          (LONGLONG)Target->StallTime);
+        }
+    }
+
+    if (Target->hFile != NULL) {
+        CloseHandle(Target->hFile);
+    }
+    if (Target->Mutex != NULL) {
+        CloseHandle(Target->Mutex);
+    }
+    if (Target->DataAvailable != NULL) {
+        CloseHandle(Target->DataAvailable);
+    }
+    if (Target->SpaceAvailable != NULL) {
+        CloseHandle(Target->SpaceAvailable);
+    }
+    if (Target->DirectComplete != NULL) {
+        CloseHandle(Target->DirectComplete);
+    }
+    if (Target->Buffer != NULL) {
+        YoriLibFree(Target->Buffer);
+    }
+    YoriLibFreeStringContents(&Target->FileName);
+
+    return Result;
+}
+
+/**
+ Process a single stream by reading it as raw bytes and writing each block
+ to standard output and every target without interpretation.  This is used
+ when standard output is not a console.
 
  @param hSource Handle to the source.
 
- @param TeeContext Pointer to the context for the operation, including a
-        handle to the output stream to write data to.
+ @param TeeContext Pointer to the context for the operation.
 
  @return TRUE to indicate success or FALSE to indicate failure.
  */
 BOOL
-TeeProcessStream(
+TeeProcessStreamBytes(
+    __in HANDLE hSource,
+    __in PTEE_CONTEXT TeeContext
+    )
+{
+    PUCHAR Buffer;
+    DWORD BytesRead;
+    HANDLE hStdOut;
+    BOOL StdOutFailed = FALSE;
+
+    Buffer = YoriLibMalloc(TEE_READ_BUFFER_SIZE);
+    if (Buffer == NULL) {
+        return FALSE;
+    }
+
+    hStdOut = GetStdHandle(STD_OUTPUT_HANDLE);
+
+    while (TRUE) {
+        if (!ReadFile(hSource, Buffer, TEE_READ_BUFFER_SIZE, &BytesRead, NULL) ||
+            BytesRead == 0) {
+
+            break;
+        }
+
+        //
+        //  If standard output goes away, keep feeding the files.
+        //
+
+        if (!StdOutFailed && !TeeWriteAll(hStdOut, Buffer, BytesRead)) {
+            StdOutFailed = TRUE;
+        }
+
+        TeeWriteToTargets(TeeContext, Buffer, BytesRead, TRUE);
+    }
+
+    YoriLibFree(Buffer);
+    return TRUE;
+}
+
+/**
+ Process a single stream by reading it as lines, so that output to a console
+ can be displayed correctly, and writing each line to every target in the
+ output encoding.
+
+ @param hSource Handle to the source.
+
+ @param TeeContext Pointer to the context for the operation.
+
+ @return TRUE to indicate success or FALSE to indicate failure.
+ */
+BOOL
+TeeProcessStreamLines(
     __in HANDLE hSource,
     __in PTEE_CONTEXT TeeContext
     )
@@ -86,6 +725,11 @@ TeeProcessStream(
     PVOID LineContext = NULL;
     CONSOLE_SCREEN_BUFFER_INFO ScreenInfo;
     YORI_STRING LineString;
+    PUCHAR LineBytes = NULL;
+    DWORD LineBytesAllocated = 0;
+    DWORD BytesNeeded;
+    DWORD NewlineBytes;
+    BOOL Result = TRUE;
 
     YoriLibInitEmptyString(&LineString);
 
@@ -100,13 +744,61 @@ TeeProcessStream(
             YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n"));
         }
 
-        YoriLibOutputToDevice(TeeContext->hFile, 0, _T("%y\n"), &LineString);
+        //
+        //  Convert the line once, then queue the same bytes to every file.
+        //
+
+        BytesNeeded = YoriLibMultibyteOutputSizeAndConvert(LineString.StartOfString, LineString.LengthInChars, (LPSTR)LineBytes, LineBytesAllocated);
+        NewlineBytes = YoriLibMultibyteOutputSizeAndConvert(_T("\r\n"), 2, NULL, 0);
+        if (BytesNeeded + NewlineBytes > LineBytesAllocated) {
+            if (LineBytes != NULL) {
+                YoriLibFree(LineBytes);
+            }
+            LineBytesAllocated = BytesNeeded + NewlineBytes + 256;
+            LineBytes = YoriLibMalloc(LineBytesAllocated);
+            if (LineBytes == NULL) {
+                Result = FALSE;
+                break;
+            }
+            YoriLibMultibyteOutputSizeAndConvert(LineString.StartOfString, LineString.LengthInChars, (LPSTR)LineBytes, LineBytesAllocated);
+        }
+        YoriLibMultibyteOutputSizeAndConvert(_T("\r\n"), 2, (LPSTR)&LineBytes[BytesNeeded], NewlineBytes);
+
+        TeeWriteToTargets(TeeContext, LineBytes, BytesNeeded + NewlineBytes, FALSE);
     }
 
     YoriLibLineReadClose(LineContext);
     YoriLibFreeStringContents(&LineString);
+    if (LineBytes != NULL) {
+        YoriLibFree(LineBytes);
+    }
 
-    return TRUE;
+    return Result;
+}
+
+/**
+ Process a single stream.
+
+ @param hSource Handle to the source.
+
+ @param TeeContext Pointer to the context for the operation, including the
+        files to write data to.
+
+ @return TRUE to indicate success or FALSE to indicate failure.
+ */
+BOOL
+TeeProcessStream(
+    __in HANDLE hSource,
+    __in PTEE_CONTEXT TeeContext
+    )
+{
+    DWORD ConsoleMode;
+
+    if (GetConsoleMode(GetStdHandle(STD_OUTPUT_HANDLE), &ConsoleMode)) {
+        return TeeProcessStreamLines(hSource, TeeContext);
+    }
+
+    return TeeProcessStreamBytes(hSource, TeeContext);
 }
 
 #ifdef YORI_BUILTIN
@@ -141,8 +833,8 @@ ENTRYPOINT(
     DWORD i;
     DWORD StartArg = 0;
     BOOL Append = FALSE;
+    BOOL Result;
     TEE_CONTEXT TeeContext;
-    YORI_STRING FileName;
     YORI_STRING Arg;
 
     ZeroMemory(&TeeContext, sizeof(TeeContext));
@@ -163,6 +855,12 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("a")) == 0) {
                 Append = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("d")) == 0) {
+                TeeContext.DropWhenFull = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("v")) == 0) {
+                TeeContext.Verbose = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringWithLiteralInsensitive(&Arg, _T("-")) == 0) {
                 StartArg = i + 1;
                 ArgumentUnderstood = TRUE;
@@ -194,35 +892,48 @@ ENTRYPOINT(
         return EXIT_FAILURE;
     }
 
-    if (!YoriLibUserStringToSingleFilePath(&ArgV[StartArg], TRUE, &FileName)) {
-        DWORD LastError = GetLastError();
-        LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tee: getfullpathname of %y failed: %s"), &ArgV[StartArg], ErrText);
-        YoriLibFreeWinErrorText(ErrText);
+    TeeContext.Targets = YoriLibMalloc((ArgC - StartArg) * sizeof(TEE_TARGET));
+    if (TeeContext.Targets == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tee: allocation failure\n"));
         return EXIT_FAILURE;
     }
+    ZeroMemory(TeeContext.Targets, (ArgC - StartArg) * sizeof(TEE_TARGET));
+
+    Result = TRUE;
+    for (i = StartArg; i < ArgC; i++) {
+        PTEE_TARGET Target = &TeeContext.Targets[TeeContext.TargetCount];
+
+        YoriLibInitEmptyString(&Target->FileName);
+        if (!YoriLibUserStringToSingleFilePath(&ArgV[i], TRUE, &Target->FileName)) {
+            DWORD LastError = GetLastError();
+            LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tee: getfullpathname of %y failed: %s"), &ArgV[i], ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            Result = FALSE;
+            break;
+        }
 
-    TeeContext.hFile = CreateFile(FileName.StartOfString,
-                                  (Append?FILE_APPEND_DATA:FILE_WRITE_DATA) | SYNCHRONIZE,
-                                  FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
-                                  NULL,
-                                  OPEN_ALWAYS,
-                                  FILE_ATTRIBUTE_NORMAL,
-                                  NULL);
+        TeeContext.TargetCount++;
+        if (!TeeTargetOpen(Target, Append)) {
+            Result = FALSE;
+            break;
+        }
+    }
 
-    if (TeeContext.hFile == INVALID_HANDLE_VALUE || TeeContext.hFile == NULL) {
-        DWORD LastError = GetLastError();
-        LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tee: open of %y failed: %s"), &FileName, ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        YoriLibFreeStringContents(&FileName);
-        return EXIT_FAILURE;
+    if (Result) {
+        TeeProcessStream(GetStdHandle(STD_INPUT_HANDLE), &TeeContext);
     }
 
-    TeeProcessStream(GetStdHandle(STD_INPUT_HANDLE), &TeeContext);
+    for (i = 0; i < TeeContext.TargetCount; i++) {
+        if (!TeeTargetClose(&TeeContext, &TeeContext.Targets[i])) {
+            Result = FALSE;
+        }
+    }
+    YoriLibFree(TeeContext.Targets);
 
-    CloseHandle(TeeContext.hFile);
-    YoriLibFreeStringContents(&FileName);
+    if (!Result) {
+        return EXIT_FAILURE;
+    }
 
     return EXIT_SUCCESS;
 }
@@ -92,6 +92,11 @@ typedef struct _TYPE_CONTEXT {
      */
     LONGLONG FileLinesFound;
 
+    /**
+     Buffered output stream used to combine lines into larger writes.
+     */
+    YORI_LIB_OUTPUT_BUFFER Output;
+
 } TYPE_CONTEXT, *PTYPE_CONTEXT;
 
 /**
@@ -114,12 +119,10 @@ TypeProcessStream(
     PVOID LineContext = NULL;
     CONSOLE_SCREEN_BUFFER_INFO ScreenInfo;
     YORI_STRING LineString;
-    BOOL OutputIsConsole;
-    DWORD dwMode;
+    PYORI_LIB_OUTPUT_BUFFER Output;
     DWORD CharactersDisplayed;
-    HANDLE OutputHandle;
 
-    OutputHandle = GetStdHandle(STD_OUTPUT_HANDLE);
+    Output = &TypeContext->Output;
 
     YoriLibInitEmptyString(&LineString);
 
@@ -127,11 +130,6 @@ TypeProcessStream(
     TypeContext->FilesFoundThisArg++;
     TypeContext->FileLinesFound = 0;
 
-    OutputIsConsole = FALSE;
-    if (GetConsoleMode(OutputHandle, &dwMode)) {
-        OutputIsConsole = TRUE;
-    }
-
     while (TRUE) {
 
         if (!YoriLibReadLineToString(&LineString, &LineContext, hSource)) {
@@ -142,18 +140,30 @@ TypeProcessStream(
 
         if ((TypeContext->HeadLines == 0 || TypeContext->FileLinesFound <= TypeContext->HeadLines)) {
             if (TypeContext->DisplayLineNumbers) {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%8lli: %y"), TypeContext->FileLinesFound, &LineString);
+                YoriLibOutputBuffered(Output, _T("%8lli: "), TypeContext->FileLinesFound);
+                YoriLibOutputBufferString(Output, &LineString);
                 CharactersDisplayed = LineString.LengthInChars + 10;
             } else {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &LineString);
+                YoriLibOutputBufferString(Output, &LineString);
                 CharactersDisplayed = LineString.LengthInChars;
             }
+
+            //
+            //  On a console, the line may have wrapped to exactly the width
+            //  of the window, in which case no newline is needed.  This can
+            //  only be checked once the line has been written.
+            //
+
+            if (Output->OutputIsConsole && CharactersDisplayed != 0) {
+                YoriLibOutputBufferFlush(Output);
+            }
+
             if (CharactersDisplayed == 0 ||
-                !OutputIsConsole ||
-                !GetConsoleScreenBufferInfo(OutputHandle, &ScreenInfo) ||
+                !Output->OutputIsConsole ||
+                !GetConsoleScreenBufferInfo(Output->hOutput, &ScreenInfo) ||
                 ScreenInfo.dwCursorPosition.X != 0) {
 
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n"));
+                YoriLibOutputBuffered(Output, _T("\n"));
             }
         } else {
             break;
@@ -162,6 +172,7 @@ TypeProcessStream(
 
     YoriLibLineReadClose(LineContext);
     YoriLibFreeStringContents(&LineString);
+    YoriLibOutputBufferFlush(Output);
 
     return TRUE;
 }
@@ -394,6 +405,12 @@ ENTRYPOINT(
     YoriLibCancelEnable();
 #endif
 
+    if (!YoriLibOutputBufferInitialize(&TypeContext.Output, YORI_LIB_OUTPUT_STDOUT)) {
+        YoriLibOutputBufferCleanup(&TypeContext.Output);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("type: out of memory\n"));
+        return EXIT_FAILURE;
+    }
+
     //
     //  If no file name is specified, use stdin; otherwise open
     //  the file and use that
@@ -401,6 +418,7 @@ ENTRYPOINT(
 
     if (StartArg == 0 || StartArg == ArgC) {
         if (YoriLibIsStdInConsole()) {
+            YoriLibOutputBufferCleanup(&TypeContext.Output);
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("No file or pipe for input\n"));
             return EXIT_FAILURE;
         }
@@ -437,6 +455,8 @@ ENTRYPOINT(
         }
     }
 
+    YoriLibOutputBufferCleanup(&TypeContext.Output);
+
     if (TypeContext.FilesFound == 0) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("type: no matching files found\n"));
         return EXIT_FAILURE;
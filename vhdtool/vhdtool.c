@@ -99,14 +99,9 @@ VhdToolCloneIso(
     HANDLE TargetHandle;
     YORI_STRING FullPath;
     YORI_STRING FullSourcePath;
-    PVOID Buffer;
-    DWORD BufferSize;
-    DWORD BytesRead;
-    DWORD SectorsPerCluster;
-    DWORD BytesPerSector;
-    DWORD FreeClusters;
-    DWORD TotalClusters;
+    DWORD BytesReturned;
     DISK_GEOMETRY DiskGeometry;
+    LARGE_INTEGER SourceSize;
     LPTSTR ErrText;
     DWORD Err;
 
@@ -138,8 +133,8 @@ VhdToolCloneIso(
         return FALSE;
     }
 
-    TargetHandle = CreateFile(FullPath.StartOfString, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
-    if (SourceHandle == INVALID_HANDLE_VALUE) {
+    TargetHandle = CreateFile(FullPath.StartOfString, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (TargetHandle == INVALID_HANDLE_VALUE) {
         Err = GetLastError();
         ErrText = YoriLibGetWinErrorText(Err);
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Open of target failed: %y: %s"), &FullPath, ErrText);
@@ -151,20 +146,26 @@ VhdToolCloneIso(
     }
 
     //
-    //  Try to query the sector size of the source, first as a device, and if
-    //  that fails, as a file.
+    //  If the source is a device, its size can't be determined from the
+    //  handle, so copy until no more data can be read.  If it's a file,
+    //  copy its known size, which allows sparse regions and block cloning
+    //  to be used.
     //
 
-    if (DeviceIoControl(SourceHandle, IOCTL_DISK_GET_DRIVE_GEOMETRY, NULL, 0, &DiskGeometry, sizeof(DiskGeometry), &BytesRead, NULL)) {
-        BytesPerSector = DiskGeometry.BytesPerSector;
-    } else if (!GetDiskFreeSpace(FullSourcePath.StartOfString, &SectorsPerCluster, &BytesPerSector, &FreeClusters, &TotalClusters)) {
-        BytesPerSector = 4096;
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("BytesPerSector could not be detected, using default %i\n"), BytesPerSector);
+    if (DeviceIoControl(SourceHandle, IOCTL_DISK_GET_DRIVE_GEOMETRY, NULL, 0, &DiskGeometry, sizeof(DiskGeometry), &BytesReturned, NULL)) {
+        SourceSize.QuadPart = YORI_LIB_COPY_RANGE_TO_END;
+    } else {
+        SourceSize.LowPart = GetFileSize(SourceHandle, (LPDWORD)&SourceSize.HighPart);
+        if (SourceSize.LowPart == (DWORD)-1 && GetLastError() != NO_ERROR) {
+            SourceSize.QuadPart = YORI_LIB_COPY_RANGE_TO_END;
+        }
     }
 
-    BufferSize = 1024 * 1024;
-    Buffer = YoriLibMalloc(BufferSize);
-    if (Buffer == NULL) {
+    if (!YoriLibCopyRange(SourceHandle, 0, TargetHandle, 0, SourceSize.QuadPart)) {
+        Err = GetLastError();
+        ErrText = YoriLibGetWinErrorText(Err);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Copy to target failed: %y: %s"), &FullPath, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
         YoriLibFreeStringContents(&FullPath);
         YoriLibFreeStringContents(&FullSourcePath);
         CloseHandle(SourceHandle);
@@ -172,31 +173,6 @@ VhdToolCloneIso(
         return FALSE;
     }
 
-    //
-    //  Copy data.  Devices appear to fail outright if the end of the device
-    //  is reached, so the final portion is read one sector at a time.
-    //
-
-    while(TRUE) {
-        if (!ReadFile(SourceHandle, Buffer, BufferSize, &BytesRead, NULL)) {
-            Err = GetLastError();
-            if (Err == ERROR_INVALID_FUNCTION) {
-                if (BufferSize != BytesPerSector) {
-                    BufferSize = BytesPerSector;
-                    continue;
-                }
-            }
-            break;
-        }
-
-        if (BytesRead == 0) {
-            break;
-        }
-
-        WriteFile(TargetHandle, Buffer, BytesRead, &BytesRead, NULL);
-    }
-
-    YoriLibFree(Buffer);
     YoriLibFreeStringContents(&FullPath);
     YoriLibFreeStringContents(&FullSourcePath);
     CloseHandle(SourceHandle);